@@ -39,6 +39,7 @@
 #include "lowmem.h"
 #include "taskres.h"
 #include "hdl.h"
+#include "compositers.h"    /* cceSimdUnitTest */
 
 /**
  * To save a large amount of memory just for block ptrs, re-use block ptrs for
@@ -112,15 +113,21 @@ static low_mem_handler_t bd_backdropPurgeHandler = {
 
 multi_mutex_t backdropLock;
 
+/** Signalled when a low memory purge has finished writing a block to disk. */
+multi_condvar_t backdropPurgeCondvar;
+
 static Bool bd_swinit(SWSTART *params)
 {
   UNUSED_PARAM(SWSTART *, params);
 
   multi_mutex_init(&backdropLock, BACKDROP_LOCK_INDEX, TRUE /*recursive*/,
                    SW_TRACE_COMPOSITE_ACQUIRE, SW_TRACE_COMPOSITE_HOLD);
+  multi_condvar_init(&backdropPurgeCondvar, &backdropLock, SW_TRACE_INVALID);
 
   resourcePool = NULL;
 
+  cceSimdUnitTest();
+
   if ( !bd_contextInit() ||
        !bd_resourceInit() ||
        !low_mem_handler_register(&bd_backdropPurgeHandler) ) {
@@ -149,6 +156,7 @@ static void bd_finish(void)
   low_mem_handler_deregister(&bd_backdropPurgeHandler);
   bd_resourceFinish();
   bd_contextFinish();
+  multi_condvar_finish(&backdropPurgeCondvar);
   multi_mutex_finish(&backdropLock);
 }
 
@@ -312,7 +320,7 @@ Bool bd_sharedNew(DL_STATE *page, uint32 width, uint32 height,
   shared->nTables = shared->blockHeight;
 
   if ( page->imageParams.LowMemImagePurgeToDisk &&
-       !im_filecreatectxt(&shared->imfileCtxt, FALSE) ) {
+       !im_filecreatectxt(&shared->imfileCtxt, TRUE) ) {
     bd_sharedFree(&shared);
     return FALSE;
   }
@@ -1782,7 +1790,6 @@ static Bool bd_backdropPurgeRelease(low_mem_handler_t *handler,
                                     low_mem_offer_t *offer)
 {
   BackdropShared *shared = context->page->backdropShared;
-  Bool result = TRUE;
 
   UNUSED_PARAM(low_mem_handler_t *, handler);
   UNUSED_PARAM(low_mem_offer_t*, offer);
@@ -1791,14 +1798,8 @@ static Bool bd_backdropPurgeRelease(low_mem_handler_t *handler,
   HQASSERT(offer->next == NULL, "Multiple offers");
   HQASSERT(shared != NULL, "No shared");
 
-  if ( !multi_mutex_trylock(&backdropLock) )
-    return TRUE; /* give up if can't get the lock */
-
-  if ( shared->purgeableBlocks != NULL )
-    result = bd_blockPurge(shared, &shared->purgeableBlocks);
-
-  multi_mutex_unlock(&backdropLock);
-  return result;
+  /* The block is written to disk without holding the backdrop lock. */
+  return bd_blockPurge(shared);
 }
 
 #ifdef METRICS_BUILD
@@ -318,6 +318,7 @@ uint32 bd_blockIndex(const Backdrop *backdrop, uint32 bx, uint32 by);
   }
 
 extern multi_mutex_t backdropLock;
+extern multi_condvar_t backdropPurgeCondvar;
 
 #endif /* protection for multiple inclusion */
 
@@ -44,7 +44,13 @@ enum {
       use a resource for the subsequent block read.  The flag is only set if the
       block needs to be retained across bands or frames, and writing to disk is
       allowed. */
-  BLOCKFLAG_PURGEABLE = 4
+  BLOCKFLAG_PURGEABLE = 4,
+
+  /** Indicates the block has been taken off the purgeable list by a low
+      memory purge, which is writing it to disk without holding the backdrop
+      lock.  Other threads must wait on backdropPurgeCondvar before using the
+      block. */
+  BLOCKFLAG_PURGING = 8
 };
 
 struct BackdropBlock {
@@ -162,7 +168,8 @@ static size_t bd_blockTablesSize(BackdropBlock *block)
   return tableBytes;
 }
 
-static Bool bd_blockTablesToDisk(BackdropBlock *block, IM_FILES *file)
+static Bool bd_blockTablesToDisk(BackdropBlock *block, IM_FILES *file,
+                                 int32 foffset)
 {
   BackdropTable *prevTable = NULL;
   uint32 yi;
@@ -172,7 +179,7 @@ static Bool bd_blockTablesToDisk(BackdropBlock *block, IM_FILES *file)
 
     if ( !line->repeat && prevTable != line->table ) {
       prevTable = line->table;
-      if ( !bdt_tableToDisk(prevTable, block->nComps, file) )
+      if ( !bdt_tableToDisk(prevTable, block->nComps, file, &foffset) )
         return FALSE;
     }
   }
@@ -184,7 +191,7 @@ static Bool bd_blockTablesToDisk(BackdropBlock *block, IM_FILES *file)
  * purged during a low memory situation. The tables written into a backdrop
  * resource which is sufficiently large to hold the retained tables.
  */
-static Bool bd_blockTablesFromDisk(BackdropBlock *block)
+static Bool bd_blockTablesFromDisk(BackdropBlock *block, int32 foffset)
 {
   BackdropResource *resource;
   BackdropTable **tables;
@@ -210,7 +217,8 @@ static Bool bd_blockTablesFromDisk(BackdropBlock *block)
         /* This line starts another table. */
         prevTable = line->table;
         currTable = tables[itable++];
-        if ( !bdt_tableFromDisk(currTable, block->nComps, block->file) )
+        if ( !bdt_tableFromDisk(currTable, block->nComps, block->file,
+                                &foffset) )
           return FALSE;
       }
       line->table = currTable;
@@ -578,13 +586,13 @@ size_t bd_blockPurgeSize(BackdropBlock *block)
   return block->dataBytes + block->linesBytes + bd_blockTablesSize(block);
 }
 
-static Bool bd_blockToDisk(const BackdropShared *shared, BackdropBlock *block)
+/** Write a block's data, lines and tables to its own range of the backdrop
+    file.  The block is not changed, so the backdrop lock need not be held. */
+static Bool bd_blockWrite(const BackdropShared *shared, BackdropBlock *block,
+                          IM_FILES **file, int32 *foffset)
 {
   int16 falign = CAST_SIGNED_TO_INT16(BLOCK_MIN_ALIGN);
   size_t totalBytes = bd_blockPurgeSize(block);
-  IM_FILES *file = NULL;
-  int32 foffset = 0;
-  Bool ok;
 
   HQASSERT(bd_isComplete(block), "block must be complete");
   HQASSERT(block->storage == STORAGE_MEMORY, "Unexpected block storage");
@@ -592,40 +600,58 @@ static Bool bd_blockToDisk(const BackdropShared *shared, BackdropBlock *block)
   HQASSERT(block->file == NULL && block->foffset == -1,
            "Already written block to disk");
 
-  multi_mutex_lock(&backdropLock);
-
-  ok = ( im_fileoffset(shared->imfileCtxt, falign, (int32)totalBytes,
-                       &file, &foffset) &&
-         im_fileseek(file, foffset) &&
-         im_filewrite(file, block->data, block->dataBytes) &&
-         im_filewrite(file, (uint8*)block->lines, block->linesBytes) &&
-         bd_blockTablesToDisk(block, file) );
+  /* The image file context allocates each block its own range of a file, and
+     each thread has its own file position, so the write does not need the
+     backdrop lock. */
+  return ( im_fileoffset(shared->imfileCtxt, falign, (int32)totalBytes,
+                         file, foffset) &&
+           im_filepwrite(*file, *foffset, block->data, block->dataBytes) &&
+           im_filepwrite(*file, *foffset + block->dataBytes,
+                         (uint8*)block->lines, block->linesBytes) &&
+           bd_blockTablesToDisk(block, *file,
+                                *foffset + block->dataBytes + block->linesBytes) );
+}
 
-  if ( ok ) {
-    /* Cast away constness and update shared safely. */
-    BackdropShared *sharedSafe = (BackdropShared*)shared;
+/** Record that a block has been written to disk.  The backdrop lock must be
+    held. */
+static void bd_blockOnDisk(const BackdropShared *shared, BackdropBlock *block,
+                           IM_FILES *file, int32 foffset)
+{
+  /* Cast away constness and update shared safely. */
+  BackdropShared *sharedSafe = (BackdropShared*)shared;
 
-    /* Only store this data when the write has succeeded. */
-    block->file = file;
-    block->foffset = foffset;
-    block->storage = STORAGE_DISK;
+  /* Only store this data when the write has succeeded. */
+  block->file = file;
+  block->foffset = foffset;
+  block->storage = STORAGE_DISK;
 
 #if defined(DEBUG_BUILD)
-    if ( sharedSafe->nBlocksToDisk == 0 )
-      monitorf((uint8*)"Starting to purge backdrop\n");
+  if ( sharedSafe->nBlocksToDisk == 0 )
+    monitorf((uint8*)"Starting to purge backdrop\n");
 #endif
 
-    /* nBlocksToDisk is only changed here (besides initialisation) and it is
-       used to decide whether to try allocating a retained block (it's value
-       isn't critical). */
-    ++sharedSafe->nBlocksToDisk;
+  /* nBlocksToDisk is only changed here (besides initialisation) and it is
+     used to decide whether to try allocating a retained block (it's value
+     isn't critical). */
+  ++sharedSafe->nBlocksToDisk;
 #if defined( DEBUG_BUILD ) || defined( METRICS_BUILD )
-    sharedSafe->nBytesToDisk += totalBytes;
+  sharedSafe->nBytesToDisk += bd_blockPurgeSize(block);
 #endif
-  }
+}
+
+static Bool bd_blockToDisk(const BackdropShared *shared, BackdropBlock *block)
+{
+  IM_FILES *file = NULL;
+  int32 foffset = 0;
 
+  if ( !bd_blockWrite(shared, block, &file, &foffset) )
+    return FALSE;
+
+  multi_mutex_lock(&backdropLock);
+  bd_blockOnDisk(shared, block, file, foffset);
   multi_mutex_unlock(&backdropLock);
-  return ok;
+
+  return TRUE;
 }
 
 static Bool bd_blockFromDisk(BackdropBlock *block)
@@ -636,14 +662,14 @@ static Bool bd_blockFromDisk(BackdropBlock *block)
   HQASSERT(block->resource != NULL, "Expected to have a backdrop resource");
   HQASSERT(block->data && block->lines, "data and lines should be present");
 
-  multi_mutex_lock(&backdropLock);
-
-  ok = ( im_fileseek(block->file, block->foffset) &&
-         im_fileread(block->file, block->data, block->dataBytes) &&
-         im_fileread(block->file, (uint8*)block->lines, block->linesBytes) &&
-         bd_blockTablesFromDisk(block) );
-
-  multi_mutex_unlock(&backdropLock);
+  /* Reads use this thread's own file position, so do not need the backdrop
+     lock. */
+  ok = ( im_filepread(block->file, block->foffset,
+                      block->data, block->dataBytes) &&
+         im_filepread(block->file, block->foffset + block->dataBytes,
+                      (uint8*)block->lines, block->linesBytes) &&
+         bd_blockTablesFromDisk(block, block->foffset + block->dataBytes
+                                       + block->linesBytes) );
 
   if ( ok )
     bd_blockCheck(block);
@@ -798,21 +824,51 @@ const dbbox_t *bd_blockReader(CompositeContext *context,
   return bounds;
 }
 
-Bool bd_blockPurge(const BackdropShared *shared, BackdropBlock **blockRef)
+Bool bd_blockPurge(const BackdropShared *shared)
 {
-  BackdropBlock *purgeBlock = *blockRef;
+  /* Cast away constness; modifying shared in a safe way. */
+  BackdropShared *sharedSafe = (BackdropShared*)shared;
+  BackdropBlock *purgeBlock;
+  IM_FILES *file = NULL;
+  int32 foffset = 0;
+  Bool ok;
+
+  if ( !multi_mutex_trylock(&backdropLock) )
+    return TRUE; /* give up if can't get the lock */
+
+  purgeBlock = sharedSafe->purgeableBlocks;
+  if ( purgeBlock == NULL ) {
+    multi_mutex_unlock(&backdropLock);
+    return TRUE;
+  }
 
   HQASSERT(bd_isPurgeable(purgeBlock) && bd_isComplete(purgeBlock) &&
            bd_isStorageMemory(purgeBlock) && bd_blockResource(purgeBlock) == NULL,
            "Block shouldn't be on the purgeable list");
 
-  if ( !bd_blockToDisk(shared, purgeBlock) )
-    return FALSE;
+  /* Detach the block from the purgeable list and mark it as being purged, so
+     the disk write can be done without holding the backdrop lock.  Threads
+     wanting the block meanwhile wait in bd_setPurgeable. */
+  bd_setPurgeable(shared, purgeBlock, FALSE, NULL);
+  purgeBlock->flags |= BLOCKFLAG_PURGING;
+  multi_mutex_unlock(&backdropLock);
 
-  bd_blockFree(shared, blockRef, FALSE);
-  HQASSERT(!bd_isPurgeable(purgeBlock), "Block shouldn't be purgeable now");
+  ok = bd_blockWrite(shared, purgeBlock, &file, &foffset);
 
-  return TRUE;
+  multi_mutex_lock(&backdropLock);
+  purgeBlock->flags &= ~BLOCKFLAG_PURGING;
+  if ( ok ) {
+    bd_blockOnDisk(shared, purgeBlock, file, foffset);
+    bd_blockFree(shared, &purgeBlock, FALSE);
+    HQASSERT(!bd_isPurgeable(purgeBlock), "Block shouldn't be purgeable now");
+  } else {
+    /* Put the block back, it's still in memory. */
+    bd_setPurgeable(shared, purgeBlock, TRUE, NULL);
+  }
+  multi_condvar_broadcast(&backdropPurgeCondvar);
+  multi_mutex_unlock(&backdropLock);
+
+  return ok;
 }
 
 /** If a block is using a resource then release it for the next region set.
@@ -1125,6 +1181,11 @@ void bd_setPurgeable(const BackdropShared *shared, BackdropBlock *block,
 
   multi_mutex_lock(&backdropLock);
 
+  /* A block being written to disk by a purge can't be used until the purge
+     has recorded the result. */
+  while ( (block->flags & BLOCKFLAG_PURGING) != 0 )
+    multi_condvar_wait(&backdropPurgeCondvar);
+
   if ( before )
     *before = bd_isPurgeable(block);
 
@@ -39,7 +39,7 @@ BackdropResource *bd_blockResource(BackdropBlock *block);
 Bool bd_blockLoad(const Backdrop *backdrop, const CompositeContext *context,
                   uint32 bx, uint32 by, BackdropBlock *block);
 size_t bd_blockPurgeSize(BackdropBlock *block);
-Bool bd_blockPurge(const BackdropShared *shared, BackdropBlock **blockRef);
+Bool bd_blockPurge(const BackdropShared *shared);
 Bool bd_blockReclaim(const Backdrop *backdrop, BackdropBlock **pblock,
                      Bool bandclose, Bool result);
 void bd_blockSwap(const Backdrop *backdrop1, const Backdrop *backdrop2,
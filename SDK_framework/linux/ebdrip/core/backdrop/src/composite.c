@@ -753,6 +753,10 @@ static void bd_compositeSpanIntoBlock(CompositeContext *context,
       bd_setMap(line);
     }
 
+    /* Each run writes a different table entry, and only reads entries for
+       xi onwards, so the process colors of the runs can be composited
+       together at the end of the line. */
+    context->batch.enabled = TRUE;
     while ( runLenBlock > 0 ) {
       newIndex = CAST_SIGNED_TO_UINT8(xi + runLen - 1);
       bd_adjustPrecedingRun(data, table, backdrop->inComps, xi);
@@ -767,6 +771,8 @@ static void bd_compositeSpanIntoBlock(CompositeContext *context,
       if ( runLenBlock > 0 )
         runLen = context->loadRun(context, backdrop, xi, runLenBlock);
     }
+    context->batch.enabled = FALSE;
+    bd_compositeBatchFlush(context);
   }
 
   context->xiNext = xi;
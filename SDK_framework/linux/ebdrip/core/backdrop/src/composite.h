@@ -103,6 +103,24 @@ typedef struct CompositeResult {
   COLORINFO       *info;
 } CompositeResult;
 
+/**
+ * Process colors of runs waiting to be composited together, so the compositer
+ * can vectorise across the pixels rather than across the few colorants of
+ * one pixel.  The inputs are copied, because later runs in the same line may
+ * overwrite the table entries they came from.
+ */
+typedef struct CompositeBatch {
+  Bool                enabled;  /**< Runs may be added to the batch. */
+  uint32              nPixels;  /**< Number of runs in the batch. */
+  uint32              nComps;   /**< Process colorants in each run. */
+  CCEPixelsInterface  composite;
+  COLORVALUE         *colorBuf; /**< Source and background color copies. */
+  CCEPixel            pixels[CCE_PIXELS_MAX];
+#if defined( ASSERT_BUILD )
+  COLORVALUE         *alpha[CCE_PIXELS_MAX]; /**< To check the results. */
+#endif
+} CompositeBatch;
+
 /**
  * The final composited backdrop is read block-by-block using the reader.
  */
@@ -208,6 +226,9 @@ struct CompositeContext {
   /** Destination pointers into a table for the compositeColor result. */
   CompositeResult  result;
 
+  /** Runs whose process colors are waiting to be composited. */
+  CompositeBatch   batch;
+
   /** Specialised functions to load inputs to compositeColor. */
   uint32         (*loadRun)(CompositeContext*, const Backdrop*, uint32, uint32);
 
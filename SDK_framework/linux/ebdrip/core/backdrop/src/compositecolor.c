@@ -137,6 +137,72 @@ static void bd_arbitrateColorManagement(COLORINFO *backgroundInfo,
   }
 }
 
+/**
+ * Composites the process colors of the runs in the batch, and empties it.
+ */
+static void bd_compositeBatch(CompositeBatch *batch)
+{
+  if ( batch->nPixels > 0 ) {
+    batch->composite(batch->nComps, batch->nPixels, batch->pixels);
+#if defined( ASSERT_BUILD )
+    {
+      uint32 i;
+      for ( i = 0; i < batch->nPixels; ++i )
+        bd_checkColor(batch->pixels[i].result, *batch->alpha[i],
+                      batch->nComps, TRUE /* premult */);
+    }
+#endif
+    batch->nPixels = 0;
+  }
+}
+
+/**
+ * Adds the process colors of a run to the batch, instead of compositing them
+ * now.  The source and background colors are copied, because the table
+ * entries may be overwritten before the batch is composited.
+ */
+static void bd_compositeBatchAdd(CompositeBatch *batch,
+                                 CCEPixelsInterface composite, uint32 nComps,
+                                 const COLORVALUE *sourceColor,
+                                 COLORVALUE sourceOpacity,
+                                 const COLORVALUE *backgroundColor,
+                                 COLORVALUE backgroundAlpha,
+                                 CompositeResult *result)
+{
+  CCEPixel *pixel = &batch->pixels[batch->nPixels];
+  COLORVALUE *srcBuf = batch->colorBuf + 2 * batch->nPixels * nComps;
+  COLORVALUE *bdBuf = srcBuf + nComps;
+
+  HQASSERT(batch->nPixels == 0 ||
+           (batch->composite == composite && batch->nComps == nComps),
+           "Runs in a batch must use the same compositer");
+  batch->composite = composite;
+  batch->nComps = nComps;
+
+  bd_copyColor(srcBuf, sourceColor, nComps);
+  bd_copyColor(bdBuf, backgroundColor, nComps);
+  pixel->src = srcBuf;
+  pixel->srcAlpha = sourceOpacity;
+  pixel->bd = bdBuf;
+  pixel->bdAlpha = backgroundAlpha;
+  pixel->result = result->color;
+#if defined( ASSERT_BUILD )
+  batch->alpha[batch->nPixels] = result->alpha;
+#endif
+
+  if ( ++batch->nPixels == CCE_PIXELS_MAX )
+    bd_compositeBatch(batch);
+}
+
+/**
+ * Composites any runs still waiting in the batch.  This must be called before
+ * the results are used, and before the source or backdrop line changes.
+ */
+void bd_compositeBatchFlush(CompositeContext *context)
+{
+  bd_compositeBatch(&context->batch);
+}
+
 /**
  * Composites source and mask with the background, storing the composited color
  * in context->result.  By this point all the color inputs have been padded to a
@@ -153,6 +219,7 @@ static Bool bd_compositeColor(CompositeContext *context,
   COLORVALUE *sourceColor = source->color, sourceAlpha = source->alpha;
   COLORVALUE sourceOpacity = source->opacity, sourceShape = source->shape;
   uint32 inComps = backdrop->inComps;
+  Bool batched = FALSE;
 
   HQASSERT(source->info->label != 0,
            "Should have already checked for no pixel label");
@@ -277,8 +344,19 @@ static Bool bd_compositeColor(CompositeContext *context,
     uint32 spotColorCount = inComps - backdrop->inProcessComps;
     CCE *cce = source->cce;
 
-    cce->composite(backdrop->inProcessComps, sourceColor, sourceOpacity,
-                   background->color, background->alpha, result->color);
+    /* Process colors are batched with the following runs if they can be
+       vectorised across pixels.  The shape weighted average needs the result
+       immediately. */
+    if ( context->batch.enabled && cce->compositePixels != NULL &&
+         sourceShape == COLORVALUE_ONE ) {
+      bd_compositeBatchAdd(&context->batch, cce->compositePixels,
+                           backdrop->inProcessComps, sourceColor,
+                           sourceOpacity, background->color,
+                           background->alpha, result);
+      batched = TRUE;
+    } else
+      cce->composite(backdrop->inProcessComps, sourceColor, sourceOpacity,
+                     background->color, background->alpha, result->color);
 
     /* Blend the spot colors (if present) using the spot color compositer. */
     if ( spotColorCount > 0 ) {
@@ -360,12 +438,15 @@ static Bool bd_compositeColor(CompositeContext *context,
        source->overprint && source->info->spotNo != background->info->spotNo )
     bd_mergeSpots(context, backdrop);
 
-  bd_checkColor(result->color, *result->alpha, inComps, TRUE /* premult */);
   COLORTYPE_ASSERT(result->info->colorType, "bd_compositeColor");
   HQASSERT(result->info->spotNo > 0, "Invalid spotNo");
 
-  bd_traceColor(" res", result->color, inComps, *result->alpha,
-                (!backdrop->isolated ? *result->groupAlpha : COLORVALUE_INVALID));
+  /* A batched result is checked when the batch is composited. */
+  if ( !batched ) {
+    bd_checkColor(result->color, *result->alpha, inComps, TRUE /* premult */);
+    bd_traceColor(" res", result->color, inComps, *result->alpha,
+                  (!backdrop->isolated ? *result->groupAlpha : COLORVALUE_INVALID));
+  }
 
   return TRUE; /* draw */
 }
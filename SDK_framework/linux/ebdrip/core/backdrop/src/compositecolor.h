@@ -25,6 +25,8 @@ void bd_sourceColorBackdrop(CompositeContext *context, const Backdrop *backdrop)
 
 void bd_sourceColorComplete(CompositeContext *context, const Backdrop *backdrop);
 
+void bd_compositeBatchFlush(CompositeContext *context);
+
 #if defined( ASSERT_BUILD )
 void bd_checkColor(COLORVALUE *color, COLORVALUE alpha, uint32 nComps,
                    Bool premult);
@@ -73,6 +73,8 @@ static void bd_contextDestroy(resource_pool_t *pool,
   if ( context->source.overprintFlagsBuf != NULL )
     bd_resourceFree(context->source.overprintFlagsBuf,
                     context->inCompsMax * sizeof(blit_channel_state_t));
+  if ( context->batch.colorBuf != NULL )
+    bd_resourceFree(context->batch.colorBuf, 2 * CCE_PIXELS_MAX * bytes);
 
   bd_coalesceFree(&context->coalesce);
 
@@ -143,6 +145,8 @@ static Bool bd_contextNew(resource_pool_t *pool,
   context->source.colorBuf = bd_resourceAllocCost(bytes, cost);
   context->source.overprintFlagsBuf =
     bd_resourceAllocCost(key->inCompsMax * sizeof(blit_channel_state_t), cost);
+  context->batch.colorBuf = bd_resourceAllocCost(2 * CCE_PIXELS_MAX * bytes,
+                                                 cost);
 
   if ( context->fixedResourceIds == NULL ||
        context->fixedResources == NULL ||
@@ -150,7 +154,8 @@ static Bool bd_contextNew(resource_pool_t *pool,
        context->background.colorBuf == NULL ||
        context->backgroundForShape.colorBuf == NULL ||
        context->source.colorBuf == NULL ||
-       context->source.overprintFlagsBuf == NULL ) {
+       context->source.overprintFlagsBuf == NULL ||
+       context->batch.colorBuf == NULL ) {
     bd_contextDestroy(pool, entry);
     return error_handler(VMERROR);
   }
@@ -696,48 +696,71 @@ size_t bdt_getNBytesUsed(BackdropTable *table, uint32 nComps)
   return bdt_size(table->type, nComps, table->nUsedSlots);
 }
 
-Bool bdt_tableToDisk(BackdropTable *table, uint32 nComps, IM_FILES *file)
+/**
+ * Write a table to disk at the given file offset, advancing the offset past
+ * the table.
+ */
+Bool bdt_tableToDisk(BackdropTable *table, uint32 nComps, IM_FILES *file,
+                     int32 *foffset)
 {
-  table->nMaxSlots = table->nUsedSlots;
+  int32 infoBytes = (int32)(table->nUsedSlots * sizeof(COLORINFO));
+  int32 colorBytes;
+  uint8 *color;
 
-  if ( !im_filewrite(file, (uint8*)table, (int32)sizeof(BackdropTable)) ||
-       !im_filewrite(file, (uint8*)table->info,
-                     (int32)(table->nUsedSlots * sizeof(COLORINFO))) )
-    return FALSE;
+  table->nMaxSlots = table->nUsedSlots;
 
   if ( table->type == BDT_OUTPUT8 ) {
-    if ( !im_filewrite(file, (uint8*)table->u.color8,
-                       (int32)(nComps * table->nUsedSlots * sizeof(uint8))) )
-      return FALSE;
+    color = (uint8*)table->u.color8;
+    colorBytes = (int32)(nComps * table->nUsedSlots * sizeof(uint8));
   } else {
-    if ( !im_filewrite(file, (uint8*)table->u.color,
-                       (int32)(nComps * table->nUsedSlots * sizeof(COLORVALUE))) )
-      return FALSE;
+    color = (uint8*)table->u.color;
+    colorBytes = (int32)(nComps * table->nUsedSlots * sizeof(COLORVALUE));
   }
+
+  if ( !im_filepwrite(file, *foffset, (uint8*)table,
+                      (int32)sizeof(BackdropTable)) ||
+       !im_filepwrite(file, *foffset + (int32)sizeof(BackdropTable),
+                      (uint8*)table->info, infoBytes) ||
+       !im_filepwrite(file, *foffset + (int32)sizeof(BackdropTable) + infoBytes,
+                      color, colorBytes) )
+    return FALSE;
+
+  *foffset += (int32)sizeof(BackdropTable) + infoBytes + colorBytes;
   return TRUE;
 }
 
-Bool bdt_tableFromDisk(BackdropTable *table, uint32 nComps, IM_FILES *file)
+/**
+ * Read a table back from disk at the given file offset, advancing the offset
+ * past the table.
+ */
+Bool bdt_tableFromDisk(BackdropTable *table, uint32 nComps, IM_FILES *file,
+                       int32 *foffset)
 {
-  if ( !im_fileread(file, (uint8*)table, (int32)sizeof(BackdropTable)) )
+  int32 infoBytes, colorBytes;
+  uint8 *color;
+
+  if ( !im_filepread(file, *foffset, (uint8*)table,
+                     (int32)sizeof(BackdropTable)) )
     return FALSE;
 
   bdt_reset(table, nComps);
 
-  if ( !im_fileread(file, (uint8*)table->info,
-                    (int32)(table->nUsedSlots * sizeof(COLORINFO))) )
-    return FALSE;
-
+  infoBytes = (int32)(table->nUsedSlots * sizeof(COLORINFO));
   if ( table->type == BDT_OUTPUT8 ) {
-    if ( !im_fileread(file, (uint8*)table->u.color8,
-                      (int32)(nComps * table->nUsedSlots * sizeof(uint8))) )
-      return FALSE;
+    color = (uint8*)table->u.color8;
+    colorBytes = (int32)(nComps * table->nUsedSlots * sizeof(uint8));
   } else {
-    if ( !im_fileread(file, (uint8*)table->u.color,
-                      (int32)(nComps * table->nUsedSlots * sizeof(COLORVALUE))) )
-      return FALSE;
+    color = (uint8*)table->u.color;
+    colorBytes = (int32)(nComps * table->nUsedSlots * sizeof(COLORVALUE));
   }
 
+  if ( !im_filepread(file, *foffset + (int32)sizeof(BackdropTable),
+                     (uint8*)table->info, infoBytes) ||
+       !im_filepread(file, *foffset + (int32)sizeof(BackdropTable) + infoBytes,
+                     color, colorBytes) )
+    return FALSE;
+
+  *foffset += (int32)sizeof(BackdropTable) + infoBytes + colorBytes;
   return TRUE;
 }
 
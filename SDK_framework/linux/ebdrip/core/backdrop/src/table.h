@@ -172,9 +172,11 @@ size_t bdt_getNBytesUsed(BackdropTable *table, uint32 nComps);
  * then we may need to write the tables to disk in low memory.
  */
 struct IM_FILES;
-Bool bdt_tableToDisk(BackdropTable *table, uint32 nComps, struct IM_FILES *file);
+Bool bdt_tableToDisk(BackdropTable *table, uint32 nComps, struct IM_FILES *file,
+                     int32 *foffset);
 
-Bool bdt_tableFromDisk(BackdropTable *table, uint32 nComps, struct IM_FILES *file);
+Bool bdt_tableFromDisk(BackdropTable *table, uint32 nComps, struct IM_FILES *file,
+                       int32 *foffset);
 
 #endif /* __BACKDROPTABLE_H__ */
 
@@ -52,11 +52,35 @@ typedef void (*CCEInterface)(uint32 count,
                              COLORVALUE bdAlpha,
                              COLORVALUE* result);
 
+/** Largest number of pixels composited by one call of a
+    CCEPixelsInterface. */
+#define CCE_PIXELS_MAX 8
+
+/** One pixel of a batch composited by a CCEPixelsInterface. */
+typedef struct CCEPixel {
+  const COLORVALUE *src;
+  COLORVALUE srcAlpha;
+  const COLORVALUE *bd;
+  COLORVALUE bdAlpha;
+  COLORVALUE *result;
+} CCEPixel;
+
+/** Composite  count colorants of each of  nPixels pixels, as the
+    matching CCEInterface would one pixel at a time. A result may overwrite
+    the backdrop of its own pixel, but not the inputs of another pixel. */
+typedef void (*CCEPixelsInterface)(uint32 count,
+                                   uint32 nPixels,
+                                   const CCEPixel *pixels);
+
 /** Color Compositing Engine object */
 typedef struct CCE {
   /* Process color compositers */
   CCEInterface composite;
   CCEInterface compositePreMult;
+  /* Process color compositer for batches of pixels, vectorised across the
+     pixels. This is NULL if it would be no faster than calling composite
+     for each pixel. */
+  CCEPixelsInterface compositePixels;
 
   /* Spot color compositers */
   CCEInterface compositeSpot;
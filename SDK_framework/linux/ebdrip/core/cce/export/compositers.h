@@ -125,6 +125,14 @@ void cceRemoveBackdropContribution(uint32 count,
                                    const COLORVALUE *src, COLORVALUE srcAlpha,
                                    const COLORVALUE *bdPremult, COLORVALUE bdAlpha,
                                    COLORVALUE* result);
+
+#if defined(ASSERT_BUILD)
+/** Unit test asserts that the SIMD compositers match the scalar ones. */
+void cceSimdUnitTest(void);
+#else
+#define cceSimdUnitTest() EMPTY_STATEMENT()
+#endif
+
 /* --Description--
 
 Interfaces to all compositers supported by the CCE.
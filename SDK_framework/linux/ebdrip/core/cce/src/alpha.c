@@ -13,6 +13,7 @@
 #include "core.h"
 
 #include "compositeMacros.h"
+#include "simdCompositers.h"
 
 /* --Separate/Premultiplied conversions-- */
 
@@ -24,9 +25,12 @@ void cceMultiplyAlpha(uint32 count,
                       COLORVALUE alpha,
                       COLORVALUE* result)
 {
-  uint32 i;
+  uint32 i = 0;
 
-  for (i = 0; i < count; i ++)
+#ifdef CCE_SIMD
+  i = cceSimdMultiplyAlpha(count, src, alpha, result);
+#endif
+  for (; i < count; i ++)
     result[i] = Multiply(src[i], alpha);
 }
 
@@ -48,7 +52,11 @@ void cceDivideAlpha(uint32 count,
       result[i] = src[i];
   }
   else {
-    for (i = 0; i < count; i ++)
+    i = 0;
+#ifdef CCE_SIMD
+    i = cceSimdDivideAlpha(count, src, alpha, result);
+#endif
+    for (; i < count; i ++)
       result[i] = Divide(src[i], alpha);
   }
 }
@@ -14,6 +14,7 @@
 #include "mmcompat.h"
 
 #include "compositers.h"
+#include "simdCompositers.h"
 
 /* --Private prototypes-- */
 
@@ -96,6 +97,7 @@ CCE* cceNew(mm_pool_t memoryPool)
   /* Null function interfaces. */
   self->composite = cceCompositeError;
   self->compositePreMult = cceCompositeError;
+  self->compositePixels = NULL;
   self->compositeSpot = cceCompositeError;
   self->compositeSpotPreMult = cceCompositeError;
 
@@ -150,14 +152,15 @@ Returns 'TRUE' if blend mode was linked successfully.
 */
 #define SET_PROCESS_COMPOSITER(self_, NAME_) \
   if ((self_) != NULL) { \
-    (self_)->composite = cce##NAME_; \
-    (self_)->compositePreMult = cce##NAME_##PreMult; \
+    (self_)->composite = cceSimdCompositer(cce##NAME_); \
+    (self_)->compositePreMult = cceSimdCompositer(cce##NAME_##PreMult); \
+    (self_)->compositePixels = cceSimdPixelsCompositer(cce##NAME_); \
   }
 
 #define SET_SPOT_COMPOSITER(self_, NAME_) \
   if ((self_) != NULL) { \
-    (self_)->compositeSpot = cce##NAME_; \
-    (self_)->compositeSpotPreMult = cce##NAME_##PreMult; \
+    (self_)->compositeSpot = cceSimdCompositer(cce##NAME_); \
+    (self_)->compositeSpotPreMult = cceSimdCompositer(cce##NAME_##PreMult); \
   }
 
 static Bool linkBlendMode(CCE* self, CCEBlendMode mode)
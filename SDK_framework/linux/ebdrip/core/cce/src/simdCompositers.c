@@ -0,0 +1,522 @@
+/** \file
+ * \ingroup cce
+ *
+ * $HopeName: COREcce!src:simdCompositers.c(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * SSE4.1 and AVX2 versions of the separable compositers and alpha
+ * converters. The compositers are called with the colorants of one pixel, so
+ * the vectors run across colorants: four at a time with SSE4.1, and eight at
+ * a time with AVX2. Colorants left over are passed on to the next narrower
+ * version. That leaves most of each vector unused for RGB or gray, so the
+ * pixels compositers run across pixels instead, taking one colorant from
+ * each of four or eight pixels at a time. The instruction set is chosen at
+ * runtime, so the RIP still runs on processors without SSE4.1.
+ */
+
+#include "core.h"
+#include "compositers.h"
+#include "compositeMacros.h"
+#include "simdCompositers.h"
+#include "hqmemcpy.h"
+
+#ifdef CCE_SIMD
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#define SIMD_TARGET_SSE41
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/** Instruction sets the compositers can use. */
+enum {
+  CCE_SIMD_UNKNOWN = -1,
+  CCE_SIMD_NONE,
+  CCE_SIMD_SSE41,
+  CCE_SIMD_AVX2
+};
+
+/** The best instruction set supported by this processor. This is set the
+    first time it is needed; every thread would set it to the same value. */
+static int cceSimdSupported = CCE_SIMD_UNKNOWN;
+
+static int cceSimdLevel(void)
+{
+  int level = cceSimdSupported;
+
+  if ( level == CCE_SIMD_UNKNOWN ) {
+#if defined(_MSC_VER)
+    int info[4];
+
+    level = CCE_SIMD_NONE;
+    __cpuid(info, 0);
+    if ( info[0] >= 1 ) {
+      __cpuid(info, 1);
+      if ( (info[2] & (1 << 19)) != 0 ) {
+        level = CCE_SIMD_SSE41;
+        /* AVX2 needs the OS to save the YMM registers. */
+        if ( (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 &&
+             (_xgetbv(0) & 6) == 6 ) {
+          __cpuid(info, 0);
+          if ( info[0] >= 7 ) {
+            __cpuidex(info, 7, 0);
+            if ( (info[1] & (1 << 5)) != 0 )
+              level = CCE_SIMD_AVX2;
+          }
+        }
+      }
+    }
+#else
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") )
+      level = CCE_SIMD_AVX2;
+    else if ( __builtin_cpu_supports("sse4.1") )
+      level = CCE_SIMD_SSE41;
+    else
+      level = CCE_SIMD_NONE;
+#endif
+    cceSimdSupported = level;
+  }
+
+  return level;
+}
+
+#define CCE_SIMD_PASTE2(a_, b_) a_##b_
+#define CCE_SIMD_PASTE(a_, b_) CCE_SIMD_PASTE2(a_, b_)
+
+/* --SSE4.1 versions-- */
+
+#define SIMD_TARGET SIMD_TARGET_SSE41
+#define SIMD_NAME(name_) CCE_SIMD_PASTE(name_, Sse41)
+#define SIMD_WIDTH 4
+#define SIMD_FALLBACK(name_) cce##name_
+
+#define V __m128i
+#define VF __m128
+#define V_LOAD(p_) _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(p_)))
+#define V_STORE(p_, v_) \
+  _mm_storel_epi64((__m128i *)(p_), _mm_packus_epi32((v_), _mm_setzero_si128()))
+#define V_LOAD32(p_) _mm_loadu_si128((const __m128i *)(p_))
+#define V_STORE32(p_, v_) _mm_storeu_si128((__m128i *)(p_), (v_))
+#define V_SET1(x_) _mm_set1_epi32((int)(x_))
+#define V_ADD(a_, b_) _mm_add_epi32((a_), (b_))
+#define V_SUB(a_, b_) _mm_sub_epi32((a_), (b_))
+#define V_MULLO(a_, b_) _mm_mullo_epi32((a_), (b_))
+#define V_MULEPU32(a_, b_) _mm_mul_epu32((a_), (b_))
+#define V_SRLI32(a_, n_) _mm_srli_epi32((a_), (n_))
+#define V_SRLI64(a_, n_) _mm_srli_epi64((a_), (n_))
+#define V_SLLI64(a_, n_) _mm_slli_epi64((a_), (n_))
+#define V_BLENDODD(even_, odd_) _mm_blend_epi16((even_), (odd_), 0xcc)
+#define V_AND(a_, b_) _mm_and_si128((a_), (b_))
+#define V_OR(a_, b_) _mm_or_si128((a_), (b_))
+#define V_CMPGT(a_, b_) _mm_cmpgt_epi32((a_), (b_))
+#define V_CMPEQ(a_, b_) _mm_cmpeq_epi32((a_), (b_))
+#define V_BLENDV(a_, b_, m_) _mm_blendv_epi8((a_), (b_), (m_))
+#define V_TOF(a_) _mm_cvtepi32_ps(a_)
+#define VF_TOI(a_) _mm_cvttps_epi32(a_)
+#define VF_SET1(x_) _mm_set1_ps(x_)
+#define VF_ADD(a_, b_) _mm_add_ps((a_), (b_))
+#define VF_SUB(a_, b_) _mm_sub_ps((a_), (b_))
+#define VF_MUL(a_, b_) _mm_mul_ps((a_), (b_))
+#define VF_DIV(a_, b_) _mm_div_ps((a_), (b_))
+#define VF_SQRT(a_) _mm_sqrt_ps(a_)
+#define VF_CMPLE(a_, b_) _mm_cmple_ps((a_), (b_))
+#define VF_BLENDV(a_, b_, m_) _mm_blendv_ps((a_), (b_), (m_))
+
+#include "simdCompositersImpl.h"
+
+#undef SIMD_TARGET
+#undef SIMD_NAME
+#undef SIMD_WIDTH
+#undef SIMD_FALLBACK
+#undef V
+#undef VF
+#undef V_LOAD
+#undef V_STORE
+#undef V_LOAD32
+#undef V_STORE32
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_MULLO
+#undef V_MULEPU32
+#undef V_SRLI32
+#undef V_SRLI64
+#undef V_SLLI64
+#undef V_BLENDODD
+#undef V_AND
+#undef V_OR
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_BLENDV
+#undef V_TOF
+#undef VF_TOI
+#undef VF_SET1
+#undef VF_ADD
+#undef VF_SUB
+#undef VF_MUL
+#undef VF_DIV
+#undef VF_SQRT
+#undef VF_CMPLE
+#undef VF_BLENDV
+
+/* --AVX2 versions-- */
+
+#define SIMD_TARGET SIMD_TARGET_AVX2
+#define SIMD_NAME(name_) CCE_SIMD_PASTE(name_, Avx2)
+#define SIMD_WIDTH 8
+#define SIMD_FALLBACK(name_) cce##name_##Sse41
+
+#define V __m256i
+#define VF __m256
+#define V_LOAD(p_) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p_)))
+/* Packing works within each 128-bit half, so gather the low quadwords. */
+#define V_STORE(p_, v_) \
+  _mm_storeu_si128((__m128i *)(p_), _mm256_castsi256_si128( \
+    _mm256_permute4x64_epi64(_mm256_packus_epi32((v_), _mm256_setzero_si256()), \
+                             0x08)))
+#define V_LOAD32(p_) _mm256_loadu_si256((const __m256i *)(p_))
+#define V_STORE32(p_, v_) _mm256_storeu_si256((__m256i *)(p_), (v_))
+#define V_SET1(x_) _mm256_set1_epi32((int)(x_))
+#define V_ADD(a_, b_) _mm256_add_epi32((a_), (b_))
+#define V_SUB(a_, b_) _mm256_sub_epi32((a_), (b_))
+#define V_MULLO(a_, b_) _mm256_mullo_epi32((a_), (b_))
+#define V_MULEPU32(a_, b_) _mm256_mul_epu32((a_), (b_))
+#define V_SRLI32(a_, n_) _mm256_srli_epi32((a_), (n_))
+#define V_SRLI64(a_, n_) _mm256_srli_epi64((a_), (n_))
+#define V_SLLI64(a_, n_) _mm256_slli_epi64((a_), (n_))
+#define V_BLENDODD(even_, odd_) _mm256_blend_epi16((even_), (odd_), 0xcc)
+#define V_AND(a_, b_) _mm256_and_si256((a_), (b_))
+#define V_OR(a_, b_) _mm256_or_si256((a_), (b_))
+#define V_CMPGT(a_, b_) _mm256_cmpgt_epi32((a_), (b_))
+#define V_CMPEQ(a_, b_) _mm256_cmpeq_epi32((a_), (b_))
+#define V_BLENDV(a_, b_, m_) _mm256_blendv_epi8((a_), (b_), (m_))
+#define V_TOF(a_) _mm256_cvtepi32_ps(a_)
+#define VF_TOI(a_) _mm256_cvttps_epi32(a_)
+#define VF_SET1(x_) _mm256_set1_ps(x_)
+#define VF_ADD(a_, b_) _mm256_add_ps((a_), (b_))
+#define VF_SUB(a_, b_) _mm256_sub_ps((a_), (b_))
+#define VF_MUL(a_, b_) _mm256_mul_ps((a_), (b_))
+#define VF_DIV(a_, b_) _mm256_div_ps((a_), (b_))
+#define VF_SQRT(a_) _mm256_sqrt_ps(a_)
+#define VF_CMPLE(a_, b_) _mm256_cmp_ps((a_), (b_), _CMP_LE_OQ)
+#define VF_BLENDV(a_, b_, m_) _mm256_blendv_ps((a_), (b_), (m_))
+
+#include "simdCompositersImpl.h"
+
+#undef SIMD_TARGET
+#undef SIMD_NAME
+#undef SIMD_WIDTH
+#undef SIMD_FALLBACK
+#undef V
+#undef VF
+#undef V_LOAD
+#undef V_STORE
+#undef V_LOAD32
+#undef V_STORE32
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_MULLO
+#undef V_MULEPU32
+#undef V_SRLI32
+#undef V_SRLI64
+#undef V_SLLI64
+#undef V_BLENDODD
+#undef V_AND
+#undef V_OR
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_BLENDV
+#undef V_TOF
+#undef VF_TOI
+#undef VF_SET1
+#undef VF_ADD
+#undef VF_SUB
+#undef VF_MUL
+#undef VF_DIV
+#undef VF_SQRT
+#undef VF_CMPLE
+#undef VF_BLENDV
+
+/** The vector versions of each scalar compositer, and the largest
+    difference allowed from the scalar result. */
+static const struct {
+  CCEInterface scalar, sse41, avx2;
+  uint32 tolerance;
+} cceSimdCompositers[] = {
+#define CCE_SIMD_ENTRY(NAME_, TOLERANCE_) \
+  { cce##NAME_, cce##NAME_##Sse41, cce##NAME_##Avx2, TOLERANCE_ }, \
+  { cce##NAME_##PreMult, cce##NAME_##PreMultSse41, \
+    cce##NAME_##PreMultAvx2, TOLERANCE_ }
+  CCE_SIMD_ENTRY(Normal, 0),
+  CCE_SIMD_ENTRY(Multiply, 0),
+  CCE_SIMD_ENTRY(Screen, 0),
+  CCE_SIMD_ENTRY(Overlay, 0),
+  CCE_SIMD_ENTRY(SoftLight, 1),
+  CCE_SIMD_ENTRY(HardLight, 0),
+  CCE_SIMD_ENTRY(ColorDodge, 0),
+  CCE_SIMD_ENTRY(ColorBurn, 0),
+  CCE_SIMD_ENTRY(Darken, 0),
+  CCE_SIMD_ENTRY(Lighten, 0),
+  CCE_SIMD_ENTRY(Difference, 0),
+  CCE_SIMD_ENTRY(Exclusion, 0)
+#undef CCE_SIMD_ENTRY
+};
+
+/** The versions of each separate source compositer vectorised across
+    pixels. */
+static const struct {
+  CCEInterface scalar;
+  CCEPixelsInterface sse41, avx2;
+  uint32 tolerance;
+} cceSimdPixelsCompositers[] = {
+#define CCE_SIMD_ENTRY(NAME_, TOLERANCE_) \
+  { cce##NAME_, cce##NAME_##PixelsSse41, cce##NAME_##PixelsAvx2, TOLERANCE_ }
+  CCE_SIMD_ENTRY(Normal, 0),
+  CCE_SIMD_ENTRY(Multiply, 0),
+  CCE_SIMD_ENTRY(Screen, 0),
+  CCE_SIMD_ENTRY(Overlay, 0),
+  CCE_SIMD_ENTRY(SoftLight, 1),
+  CCE_SIMD_ENTRY(HardLight, 0),
+  CCE_SIMD_ENTRY(ColorDodge, 0),
+  CCE_SIMD_ENTRY(ColorBurn, 0),
+  CCE_SIMD_ENTRY(Darken, 0),
+  CCE_SIMD_ENTRY(Lighten, 0),
+  CCE_SIMD_ENTRY(Difference, 0),
+  CCE_SIMD_ENTRY(Exclusion, 0)
+#undef CCE_SIMD_ENTRY
+};
+
+CCEInterface cceSimdCompositer(CCEInterface compositer)
+{
+  int level = cceSimdLevel();
+  uint32 i;
+
+  if ( level == CCE_SIMD_NONE )
+    return compositer;
+
+  for ( i = 0; i < NUM_ARRAY_ITEMS(cceSimdCompositers); ++i ) {
+    if ( cceSimdCompositers[i].scalar == compositer )
+      return level == CCE_SIMD_AVX2 ? cceSimdCompositers[i].avx2
+                                    : cceSimdCompositers[i].sse41;
+  }
+
+  return compositer;
+}
+
+CCEPixelsInterface cceSimdPixelsCompositer(CCEInterface compositer)
+{
+  int level = cceSimdLevel();
+  uint32 i;
+
+  if ( level == CCE_SIMD_NONE )
+    return NULL;
+
+  for ( i = 0; i < NUM_ARRAY_ITEMS(cceSimdPixelsCompositers); ++i ) {
+    if ( cceSimdPixelsCompositers[i].scalar == compositer )
+      return level == CCE_SIMD_AVX2 ? cceSimdPixelsCompositers[i].avx2
+                                    : cceSimdPixelsCompositers[i].sse41;
+  }
+
+  return NULL;
+}
+
+uint32 cceSimdMultiplyAlpha(uint32 count, const COLORVALUE *src,
+                            COLORVALUE alpha, COLORVALUE *result)
+{
+  switch ( cceSimdLevel() ) {
+  case CCE_SIMD_AVX2:
+    return cceMultiplyAlphaAvx2(count, src, alpha, result);
+  case CCE_SIMD_SSE41:
+    return cceMultiplyAlphaSse41(count, src, alpha, result);
+  }
+  return 0;
+}
+
+uint32 cceSimdDivideAlpha(uint32 count, const COLORVALUE *src,
+                          COLORVALUE alpha, COLORVALUE *result)
+{
+  switch ( cceSimdLevel() ) {
+  case CCE_SIMD_AVX2:
+    return cceDivideAlphaAvx2(count, src, alpha, result);
+  case CCE_SIMD_SSE41:
+    return cceDivideAlphaSse41(count, src, alpha, result);
+  }
+  return 0;
+}
+
+#endif /* CCE_SIMD */
+
+#if defined(ASSERT_BUILD)
+#define CCE_TEST_COLORANTS 19 /* Enough for two AVX2 vectors and a tail */
+#define CCE_TEST_PIXELS 19    /* And the same for the pixels compositers */
+#define CCE_TEST_PIXEL_COLORANTS 5
+
+/** Pick a color value for the compositer test, favouring the values where
+    the blend functions change behaviour. */
+static COLORVALUE cceTestValue(uint32 *seed)
+{
+  static const COLORVALUE special[] = {
+    0, 1, COLORVALUE_HALF - 1, COLORVALUE_HALF, COLORVALUE_HALF + 1,
+    COLORVALUE_ONE / 4, COLORVALUE_ONE - 1, COLORVALUE_ONE
+  };
+
+  *seed = *seed * 1664525u + 1013904223u;
+  if ( (*seed >> 28) < 4 )
+    return special[(*seed >> 8) % NUM_ARRAY_ITEMS(special)];
+  return (COLORVALUE)((*seed >> 8) % (COLORVALUE_ONE + 1));
+}
+
+#ifdef CCE_SIMD
+/* Compare the pixels compositers for one instruction set against the
+   scalar compositers, for every number of pixels up to CCE_TEST_PIXELS. */
+static void cceSimdPixelsTest(int level, uint32 *seed)
+{
+  COLORVALUE src[CCE_TEST_PIXELS][CCE_TEST_PIXEL_COLORANTS];
+  COLORVALUE bd[CCE_TEST_PIXELS][CCE_TEST_PIXEL_COLORANTS];
+  COLORVALUE expected[CCE_TEST_PIXELS][CCE_TEST_PIXEL_COLORANTS];
+  COLORVALUE actual[CCE_TEST_PIXELS][CCE_TEST_PIXEL_COLORANTS];
+  CCEPixel pixels[CCE_TEST_PIXELS];
+  uint32 i, n, p, count, nPixels;
+
+  for ( p = 0; p < CCE_TEST_PIXELS; ++p ) {
+    pixels[p].src = src[p];
+    pixels[p].srcAlpha = cceTestValue(seed);
+    pixels[p].bd = bd[p];
+    pixels[p].bdAlpha = cceTestValue(seed);
+    pixels[p].result = actual[p];
+    for ( n = 0; n < CCE_TEST_PIXEL_COLORANTS; ++n ) {
+      src[p][n] = cceTestValue(seed);
+      bd[p][n] = cceTestValue(seed);
+    }
+  }
+
+  for ( count = 1; count <= CCE_TEST_PIXEL_COLORANTS; ++count ) {
+    for ( nPixels = 1; nPixels <= CCE_TEST_PIXELS; ++nPixels ) {
+      for ( i = 0; i < NUM_ARRAY_ITEMS(cceSimdPixelsCompositers); ++i ) {
+        CCEPixelsInterface simd = level == CCE_SIMD_AVX2
+          ? cceSimdPixelsCompositers[i].avx2
+          : cceSimdPixelsCompositers[i].sse41;
+        uint32 pass;
+
+        for ( p = 0; p < nPixels; ++p )
+          cceSimdPixelsCompositers[i].scalar(count, src[p],
+                                             pixels[p].srcAlpha, bd[p],
+                                             pixels[p].bdAlpha, expected[p]);
+
+        /* The results may overwrite the backdrops. */
+        for ( pass = 0; pass < 2; ++pass ) {
+          for ( p = 0; p < nPixels; ++p ) {
+            if ( pass > 0 ) {
+              HqMemCpy(actual[p], bd[p], count * sizeof(COLORVALUE));
+              pixels[p].bd = actual[p];
+            } else
+              pixels[p].bd = bd[p];
+          }
+          simd(count, nPixels, pixels);
+          for ( p = 0; p < nPixels; ++p ) {
+            for ( n = 0; n < count; ++n ) {
+              uint32 diff = expected[p][n] > actual[p][n]
+                ? expected[p][n] - actual[p][n]
+                : actual[p][n] - expected[p][n];
+              HQASSERT(diff <= cceSimdPixelsCompositers[i].tolerance,
+                       "SIMD pixels compositer does not match scalar compositer");
+            }
+          }
+        }
+      }
+    }
+  }
+}
+#endif /* CCE_SIMD */
+
+/* Unit test function for the compositers. The SIMD compositers and alpha
+   converters are compared against the scalar versions for every instruction
+   set this processor supports, using random colors and alphas and every
+   number of colorants up to CCE_TEST_COLORANTS. The pixels compositers are
+   also compared, with different alphas for each pixel. */
+void cceSimdUnitTest(void)
+{
+#ifdef CCE_SIMD
+  COLORVALUE src[CCE_TEST_COLORANTS], bd[CCE_TEST_COLORANTS];
+  COLORVALUE expected[CCE_TEST_COLORANTS], actual[CCE_TEST_COLORANTS];
+  int level, maxlevel = cceSimdLevel();
+  uint32 seed = 1, i, n, count, trial;
+
+  for ( level = CCE_SIMD_SSE41; level <= maxlevel; ++level ) {
+    for ( trial = 0; trial < 20; ++trial )
+      cceSimdPixelsTest(level, &seed);
+
+    for ( trial = 0; trial < 200; ++trial ) {
+      COLORVALUE srcAlpha = cceTestValue(&seed);
+      COLORVALUE bdAlpha = cceTestValue(&seed);
+
+      for ( n = 0; n < CCE_TEST_COLORANTS; ++n ) {
+        src[n] = cceTestValue(&seed);
+        bd[n] = cceTestValue(&seed);
+      }
+
+      for ( count = 1; count <= CCE_TEST_COLORANTS; ++count ) {
+        uint32 done;
+
+        for ( i = 0; i < NUM_ARRAY_ITEMS(cceSimdCompositers); ++i ) {
+          CCEInterface simd = level == CCE_SIMD_AVX2
+            ? cceSimdCompositers[i].avx2 : cceSimdCompositers[i].sse41;
+
+          cceSimdCompositers[i].scalar(count, src, srcAlpha, bd, bdAlpha,
+                                       expected);
+          simd(count, src, srcAlpha, bd, bdAlpha, actual);
+          for ( n = 0; n < count; ++n ) {
+            uint32 diff = expected[n] > actual[n] ? expected[n] - actual[n]
+                                                  : actual[n] - expected[n];
+            HQASSERT(diff <= cceSimdCompositers[i].tolerance,
+                     "SIMD compositer does not match scalar compositer");
+          }
+
+          /* The result may overwrite the backdrop. */
+          HqMemCpy(actual, bd, count * sizeof(COLORVALUE));
+          simd(count, src, srcAlpha, actual, bdAlpha, actual);
+          for ( n = 0; n < count; ++n ) {
+            uint32 diff = expected[n] > actual[n] ? expected[n] - actual[n]
+                                                  : actual[n] - expected[n];
+            HQASSERT(diff <= cceSimdCompositers[i].tolerance,
+                     "In-place SIMD compositer does not match scalar compositer");
+          }
+        }
+
+        for ( n = 0; n < count; ++n )
+          expected[n] = Multiply(src[n], srcAlpha);
+        done = level == CCE_SIMD_AVX2
+          ? cceMultiplyAlphaAvx2(count, src, srcAlpha, actual)
+          : cceMultiplyAlphaSse41(count, src, srcAlpha, actual);
+        for ( n = 0; n < done; ++n )
+          HQASSERT(actual[n] == expected[n],
+                   "SIMD alpha multiply does not match scalar");
+
+        for ( n = 0; n < count; ++n )
+          expected[n] = Divide(src[n], srcAlpha);
+        done = level == CCE_SIMD_AVX2
+          ? cceDivideAlphaAvx2(count, src, srcAlpha, actual)
+          : cceDivideAlphaSse41(count, src, srcAlpha, actual);
+        for ( n = 0; n < done; ++n )
+          HQASSERT(actual[n] == expected[n],
+                   "SIMD alpha divide does not match scalar");
+      }
+    }
+  }
+#endif /* CCE_SIMD */
+}
+#endif /* ASSERT_BUILD */
+
+/* Log stripped */
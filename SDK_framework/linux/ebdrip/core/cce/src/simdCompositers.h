@@ -0,0 +1,75 @@
+/** \file
+ * \ingroup cce
+ *
+ * $HopeName: COREcce!src:simdCompositers.h(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * SSE4.1 and AVX2 versions of the separable compositers and alpha
+ * converters, selected at runtime by CPU feature detection.
+ */
+
+#ifndef __SIMDCOMPOSITERS_H__
+#define __SIMDCOMPOSITERS_H__
+
+#include "cce.h"
+
+/* The SIMD compositers are built for x86 compilers that can target
+   instruction sets beyond the baseline on a per-function basis. */
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define CCE_SIMD 1
+#elif (defined(_M_IX86) || defined(_M_X64)) && defined(_MSC_VER) && _MSC_VER >= 1800
+#define CCE_SIMD 1
+#endif
+
+#ifdef CCE_SIMD
+
+/** \brief Return the fastest available version of a compositer.
+
+    \param compositer A scalar compositer, as named in compositers.h.
+
+    \returns The SSE4.1 or AVX2 version of a separable compositer if the CPU
+    supports it, otherwise \a compositer itself.
+*/
+CCEInterface cceSimdCompositer(CCEInterface compositer);
+
+/** \brief Return a version of a compositer that is vectorised across pixels.
+
+    \param compositer A scalar separate source compositer, as named in
+    compositers.h.
+
+    \returns The SSE4.1 or AVX2 pixels version of a separable compositer if
+    the CPU supports it, otherwise NULL.
+*/
+CCEPixelsInterface cceSimdPixelsCompositer(CCEInterface compositer);
+
+/** \brief Multiply color values by alpha, as many as possible at a time.
+
+    \returns The number of color values converted; the caller converts the
+    remainder.
+*/
+uint32 cceSimdMultiplyAlpha(uint32 count, const COLORVALUE *src,
+                            COLORVALUE alpha, COLORVALUE *result);
+
+/** \brief Divide color values by alpha, as many as possible at a time.
+
+    \returns The number of color values converted; the caller converts the
+    remainder.
+*/
+uint32 cceSimdDivideAlpha(uint32 count, const COLORVALUE *src,
+                          COLORVALUE alpha, COLORVALUE *result);
+
+#else /* !CCE_SIMD */
+
+#define cceSimdCompositer(compositer_) (compositer_)
+#define cceSimdPixelsCompositer(compositer_) ((CCEPixelsInterface)NULL)
+
+#endif /* !CCE_SIMD */
+
+#endif /* __SIMDCOMPOSITERS_H__ */
+
+/* Log stripped */
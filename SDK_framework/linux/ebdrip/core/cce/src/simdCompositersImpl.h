@@ -0,0 +1,451 @@
+/** \file
+ * \ingroup cce
+ *
+ * $HopeName: COREcce!src:simdCompositersImpl.h(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * Vector versions of the separable compositers and alpha converters. Each
+ * function computes exactly what the scalar function in compositers.c or
+ * alpha.c computes, except for SoftLight, which uses single precision
+ * floats throughout and may differ from the scalar result by one.
+ *
+ * On inclusion, these macros should be defined:
+ *
+ * SIMD_TARGET expands to the attribute that allows a function to use the
+ * instruction set.
+ *
+ * SIMD_NAME(name) expands to the name of the version of a function for the
+ * instruction set.
+ *
+ * SIMD_WIDTH is the number of color values processed at a time.
+ *
+ * SIMD_FALLBACK(name) expands to the compositer to call for the color values
+ * left over after the last full vector.
+ *
+ * V and VF are the integer and float vector types, with SIMD_WIDTH 32-bit
+ * lanes. V_LOAD and V_STORE convert COLORVALUEs; V_LOAD32 and V_STORE32
+ * move 32-bit lanes unchanged. The V_ and VF_ macros are the vector operations used, on signed
+ * 32-bit lanes unless noted otherwise.
+ *
+ * This file is included multiple times, so should NOT have a guard around
+ * it.
+ */
+
+/** Uniform values used by all of the compositers. */
+typedef struct SIMD_NAME(simd_alphas_t) {
+  V sA, bA;       /**< Source and backdrop alpha. */
+  V omsA, ombA;   /**< One minus source and backdrop alpha. */
+  V sAbA;         /**< Multiply(srcAlpha, bdAlpha). */
+  V one, half;    /**< COLORVALUE_ONE and COLORVALUE_HALF. */
+  V zero;
+} SIMD_NAME(simd_alphas_t);
+
+/** Multiply() of color values. The product is divided by 65280 as
+    ((a * b) >> 8) / 255, and the division by 255 is done exactly for
+    products below 2^24 by multiplying by ceil(2^31 / 255) and shifting.
+    The 32 by 32 bit multiplies only use the even lanes, so the odd lanes
+    are done separately and merged back in. */
+static SIMD_TARGET inline V SIMD_NAME(vmul)(V a, V b)
+{
+  V y = V_SRLI32(V_MULLO(a, b), 8);
+  V m = V_SET1(8421505);
+  V even = V_SRLI64(V_MULEPU32(y, m), 31);
+  V odd = V_SLLI64(V_MULEPU32(V_SRLI64(y, 32), m), 1);
+  return V_BLENDODD(even, odd);
+}
+
+/** Divide() of color values. The quotient is estimated in single precision,
+    which is within one of the exact quotient, and then corrected using the
+    exact remainder. Lanes where the result is not a quotient are replaced
+    afterwards, so it does not matter what the estimate is there. */
+static SIMD_TARGET inline V SIMD_NAME(vdiv)(V a, V d,
+                                            const SIMD_NAME(simd_alphas_t) *k)
+{
+  VF qf = VF_DIV(VF_MUL(V_TOF(a), VF_SET1((float)COLORVALUE_ONE)), V_TOF(d));
+  V q = VF_TOI(qf);
+  V r = V_SUB(V_MULLO(a, k->one), V_MULLO(q, d));
+  V notzero;
+
+  q = V_ADD(q, V_CMPGT(k->zero, r));                   /* r < 0: q - 1 */
+  r = V_BLENDV(r, V_ADD(r, d), V_CMPGT(k->zero, r));
+  q = V_SUB(q, V_CMPGT(r, V_SUB(d, V_SET1(1))));       /* r >= d: q + 1 */
+
+  q = V_BLENDV(q, k->one, V_CMPGT(V_ADD(a, V_SET1(1)), d)); /* d <= a */
+  notzero = V_CMPGT(V_OR(a, d), k->zero);
+  return V_AND(q, notzero);
+}
+
+/** Truncate to a COLORVALUE, as the casts in the scalar code do. */
+#define VU16(v_) V_AND((v_), V_SET1(0xffff))
+
+/** TranCalcPart() */
+#define VTRANPART(k_, ps_, pb_) \
+  VU16(V_ADD(SIMD_NAME(vmul)((k_)->omsA, (pb_)), \
+             SIMD_NAME(vmul)((k_)->ombA, (ps_))))
+
+/** TranCalcFull() */
+#define VTRANFULL(k_, ps_, pb_, br_) \
+  VU16(V_ADD(V_ADD(SIMD_NAME(vmul)((k_)->omsA, (pb_)), \
+                   SIMD_NAME(vmul)((k_)->ombA, (ps_))), \
+             SIMD_NAME(vmul)((k_)->sAbA, (br_))))
+
+static SIMD_TARGET inline void SIMD_NAME(alphas)(SIMD_NAME(simd_alphas_t) *k,
+                                                 COLORVALUE srcAlpha,
+                                                 COLORVALUE bdAlpha)
+{
+  k->sA = V_SET1(srcAlpha);
+  k->bA = V_SET1(bdAlpha);
+  k->omsA = V_SET1(COLORVALUE_ONE - srcAlpha);
+  k->ombA = V_SET1(COLORVALUE_ONE - bdAlpha);
+  k->sAbA = V_SET1(Multiply(srcAlpha, bdAlpha));
+  k->one = V_SET1(COLORVALUE_ONE);
+  k->half = V_SET1(COLORVALUE_HALF);
+  k->zero = V_SET1(0);
+}
+
+/* --Pixel lanes--
+
+   The pixels compositers put one pixel in each lane, so the alphas vary
+   across the vector and each colorant is gathered from SIMD_WIDTH pixels. */
+
+static SIMD_TARGET inline void SIMD_NAME(alphasPixels)(SIMD_NAME(simd_alphas_t) *k,
+                                                       const CCEPixel *pixels)
+{
+  int32 sA[SIMD_WIDTH], bA[SIMD_WIDTH];
+  uint32 j;
+
+  for ( j = 0 ; j < SIMD_WIDTH ; ++j ) {
+    sA[j] = pixels[j].srcAlpha;
+    bA[j] = pixels[j].bdAlpha;
+  }
+  k->one = V_SET1(COLORVALUE_ONE);
+  k->half = V_SET1(COLORVALUE_HALF);
+  k->zero = V_SET1(0);
+  k->sA = V_LOAD32(sA);
+  k->bA = V_LOAD32(bA);
+  k->omsA = V_SUB(k->one, k->sA);
+  k->ombA = V_SUB(k->one, k->bA);
+  k->sAbA = SIMD_NAME(vmul)(k->sA, k->bA);
+}
+
+static SIMD_TARGET inline V SIMD_NAME(gatherSrc)(const CCEPixel *pixels,
+                                                 uint32 i)
+{
+  int32 lanes[SIMD_WIDTH];
+  uint32 j;
+
+  for ( j = 0 ; j < SIMD_WIDTH ; ++j )
+    lanes[j] = pixels[j].src[i];
+  return V_LOAD32(lanes);
+}
+
+static SIMD_TARGET inline V SIMD_NAME(gatherBd)(const CCEPixel *pixels,
+                                                uint32 i)
+{
+  int32 lanes[SIMD_WIDTH];
+  uint32 j;
+
+  for ( j = 0 ; j < SIMD_WIDTH ; ++j )
+    lanes[j] = pixels[j].bd[i];
+  return V_LOAD32(lanes);
+}
+
+static SIMD_TARGET inline void SIMD_NAME(scatter)(const CCEPixel *pixels,
+                                                  uint32 i, V v)
+{
+  int32 lanes[SIMD_WIDTH];
+  uint32 j;
+
+  V_STORE32(lanes, v);
+  for ( j = 0 ; j < SIMD_WIDTH ; ++j )
+    pixels[j].result[i] = (COLORVALUE)lanes[j];
+}
+
+/* --Blend kernels--
+
+   Each kernel is passed the separate and premultiplied source colors and
+   the premultiplied backdrop color. Unused values are optimised away. */
+
+static SIMD_TARGET inline V SIMD_NAME(blendNormal)(V s, V ps, V pb,
+                                                   const SIMD_NAME(simd_alphas_t) *k)
+{
+  UNUSED_PARAM(V, s);
+  return VU16(V_ADD(SIMD_NAME(vmul)(k->omsA, pb), ps));
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendMultiply)(V s, V ps, V pb,
+                                                     const SIMD_NAME(simd_alphas_t) *k)
+{
+  UNUSED_PARAM(V, s);
+  return VU16(V_ADD(V_ADD(SIMD_NAME(vmul)(k->omsA, pb),
+                          SIMD_NAME(vmul)(k->ombA, ps)),
+                    SIMD_NAME(vmul)(ps, pb)));
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendScreen)(V s, V ps, V pb,
+                                                   const SIMD_NAME(simd_alphas_t) *k)
+{
+  UNUSED_PARAM(V, s);
+  UNUSED_PARAM(const SIMD_NAME(simd_alphas_t) *, k);
+  return VU16(V_SUB(V_ADD(ps, pb), SIMD_NAME(vmul)(ps, pb)));
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendOverlay)(V s, V ps, V pb,
+                                                    const SIMD_NAME(simd_alphas_t) *k)
+{
+  V bd = SIMD_NAME(vdiv)(pb, k->bA, k);
+  V light = VU16(V_SUB(V_ADD(V_ADD(V_SUB(V_ADD(pb, ps), k->sAbA),
+                                   SIMD_NAME(vmul)(k->bA, ps)),
+                             SIMD_NAME(vmul)(k->sA, pb)),
+                       V_ADD(SIMD_NAME(vmul)(ps, pb),
+                             SIMD_NAME(vmul)(ps, pb))));
+  V br = SIMD_NAME(vmul)(s, bd);
+  V dark = VTRANFULL(k, ps, pb, V_ADD(br, br));
+  return V_BLENDV(dark, light, V_CMPGT(bd, k->half));
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendSoftLight)(V s, V ps, V pb,
+                                                      const SIMD_NAME(simd_alphas_t) *k)
+{
+  VF inverse = VF_SET1((float)COLORVALUE_INVERSE);
+  VF src = VF_MUL(V_TOF(s), inverse);
+  VF bd = VF_MUL(V_TOF(SIMD_NAME(vdiv)(pb, k->bA, k)), inverse);
+  VF one = VF_SET1(1.0f), two = VF_SET1(2.0f);
+  VF low, high, d, result;
+
+  /* bd - (1 - 2 * src) * bd * (1 - bd) */
+  low = VF_SUB(bd, VF_MUL(VF_MUL(VF_SUB(one, VF_MUL(two, src)), bd),
+                          VF_SUB(one, bd)));
+
+  /* ((16 * bd - 12) * bd + 4) * bd, or sqrt(bd) */
+  d = VF_MUL(VF_ADD(VF_MUL(VF_SUB(VF_MUL(VF_SET1(16.0f), bd), VF_SET1(12.0f)),
+                           bd), VF_SET1(4.0f)), bd);
+  d = VF_BLENDV(VF_SQRT(bd), d, VF_CMPLE(bd, VF_SET1(0.25f)));
+
+  /* bd + (2 * src - 1) * (d - bd) */
+  high = VF_ADD(bd, VF_MUL(VF_SUB(VF_MUL(two, src), one), VF_SUB(d, bd)));
+
+  result = VF_BLENDV(high, low, VF_CMPLE(src, VF_SET1(0.5f)));
+  result = VF_ADD(VF_MUL(result, VF_SET1((float)COLORVALUE_ONE)),
+                  VF_SET1(0.5f));
+
+  return VTRANFULL(k, ps, pb, VU16(VF_TOI(result)));
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendHardLight)(V s, V ps, V pb,
+                                                      const SIMD_NAME(simd_alphas_t) *k)
+{
+  V bd = SIMD_NAME(vdiv)(pb, k->bA, k);
+  V s2 = V_ADD(s, s);
+  V s2m1 = V_SUB(s2, k->one);
+  V multiply = SIMD_NAME(vmul)(s2, bd);
+  V screen = VU16(V_SUB(V_ADD(bd, s2m1), SIMD_NAME(vmul)(bd, s2m1)));
+  V br = V_BLENDV(multiply, screen, V_CMPGT(s, k->half));
+  return VTRANFULL(k, ps, pb, br);
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendColorDodge)(V s, V ps, V pb,
+                                                       const SIMD_NAME(simd_alphas_t) *k)
+{
+  V bd = SIMD_NAME(vdiv)(pb, k->bA, k);
+  V omSrc = V_SUB(k->one, s);
+  V br = SIMD_NAME(vdiv)(bd, omSrc, k);
+
+  br = V_BLENDV(br, k->one, V_CMPGT(V_ADD(bd, V_SET1(1)), omSrc));
+  /* The blend term disappears where the backdrop is zero. */
+  br = V_BLENDV(br, k->zero, V_CMPEQ(pb, k->zero));
+  return VTRANFULL(k, ps, pb, br);
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendColorBurn)(V s, V ps, V pb,
+                                                      const SIMD_NAME(simd_alphas_t) *k)
+{
+  V bd = SIMD_NAME(vdiv)(pb, k->bA, k);
+  V omBd = V_SUB(k->one, bd);
+  V br = V_SUB(k->one, SIMD_NAME(vdiv)(omBd, s, k));
+
+  br = V_BLENDV(br, k->zero, V_CMPGT(V_ADD(omBd, V_SET1(1)), s));
+  br = V_BLENDV(br, k->one, V_CMPEQ(bd, k->one));
+  return VTRANFULL(k, ps, pb, br);
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendDarken)(V s, V ps, V pb,
+                                                   const SIMD_NAME(simd_alphas_t) *k)
+{
+  V bd = SIMD_NAME(vdiv)(pb, k->bA, k);
+  V br = V_BLENDV(SIMD_NAME(vmul)(ps, k->bA), SIMD_NAME(vmul)(pb, k->sA),
+                  V_CMPGT(V_ADD(s, V_SET1(1)), bd));
+  return VU16(V_ADD(VTRANPART(k, ps, pb), br));
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendLighten)(V s, V ps, V pb,
+                                                    const SIMD_NAME(simd_alphas_t) *k)
+{
+  V bd = SIMD_NAME(vdiv)(pb, k->bA, k);
+  V br = V_BLENDV(SIMD_NAME(vmul)(ps, k->bA), SIMD_NAME(vmul)(pb, k->sA),
+                  V_CMPGT(bd, s));
+  return VU16(V_ADD(VTRANPART(k, ps, pb), br));
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendDifference)(V s, V ps, V pb,
+                                                       const SIMD_NAME(simd_alphas_t) *k)
+{
+  V bd = SIMD_NAME(vdiv)(pb, k->bA, k);
+  V sum = V_ADD(pb, ps);
+  V darker = SIMD_NAME(vmul)(k->bA, ps);
+  V lighter = SIMD_NAME(vmul)(k->sA, pb);
+  V sub = V_BLENDV(lighter, darker, V_CMPGT(bd, s));
+  return VU16(V_SUB(sum, V_ADD(sub, sub)));
+}
+
+static SIMD_TARGET inline V SIMD_NAME(blendExclusion)(V s, V ps, V pb,
+                                                      const SIMD_NAME(simd_alphas_t) *k)
+{
+  V product = SIMD_NAME(vmul)(ps, pb);
+  UNUSED_PARAM(V, s);
+  UNUSED_PARAM(const SIMD_NAME(simd_alphas_t) *, k);
+  return VU16(V_SUB(V_ADD(ps, pb), V_ADD(product, product)));
+}
+
+/* --Compositers--
+
+   The separate source variant premultiplies the source by the source alpha.
+   The premultiplied variant recovers the separate source by dividing by
+   SDIV_, which is the source alpha for every blend mode except SoftLight,
+   which uses the backdrop alpha as the scalar compositer does. */
+
+#define SIMD_COMPOSITERS(NAME_, SDIV_)                                  \
+static SIMD_TARGET void SIMD_NAME(cce##NAME_)(CCE_ARGS)                 \
+{                                                                       \
+  SIMD_NAME(simd_alphas_t) k;                                           \
+  uint32 i;                                                             \
+                                                                        \
+  SIMD_NAME(alphas)(&k, srcAlpha, bdAlpha);                             \
+  for ( i = 0 ; i + SIMD_WIDTH <= count ; i += SIMD_WIDTH ) {           \
+    V s = V_LOAD(&src[i]);                                              \
+    V ps = SIMD_NAME(vmul)(s, k.sA);                                    \
+    V pb = V_LOAD(&bd[i]);                                              \
+    V_STORE(&result[i], SIMD_NAME(blend##NAME_)(s, ps, pb, &k));        \
+  }                                                                     \
+  if ( i < count )                                                      \
+    SIMD_FALLBACK(NAME_)(count - i, src + i, srcAlpha, bd + i, bdAlpha, \
+                         result + i);                                   \
+}                                                                       \
+                                                                        \
+static SIMD_TARGET void SIMD_NAME(cce##NAME_##PreMult)(CCE_ARGS)        \
+{                                                                       \
+  SIMD_NAME(simd_alphas_t) k;                                           \
+  uint32 i;                                                             \
+                                                                        \
+  SIMD_NAME(alphas)(&k, srcAlpha, bdAlpha);                             \
+  for ( i = 0 ; i + SIMD_WIDTH <= count ; i += SIMD_WIDTH ) {           \
+    V ps = V_LOAD(&src[i]);                                             \
+    V s = SIMD_NAME(vdiv)(ps, k.SDIV_, &k);                             \
+    V pb = V_LOAD(&bd[i]);                                              \
+    V_STORE(&result[i], SIMD_NAME(blend##NAME_)(s, ps, pb, &k));        \
+  }                                                                     \
+  if ( i < count )                                                      \
+    SIMD_FALLBACK(NAME_##PreMult)(count - i, src + i, srcAlpha, bd + i, \
+                                  bdAlpha, result + i);                 \
+}
+
+/* The pixels variant does each colorant of SIMD_WIDTH pixels at a time.
+   All of the lanes of a colorant are loaded before any are stored, so a
+   result may overwrite its own backdrop. Pixels left over are composited
+   one at a time, vectorised across their colorants. */
+#define SIMD_PIXELS_COMPOSITER(NAME_)                                   \
+static SIMD_TARGET void SIMD_NAME(cce##NAME_##Pixels)(uint32 count,     \
+                                                      uint32 nPixels,   \
+                                                      const CCEPixel *pixels) \
+{                                                                       \
+  uint32 p, i;                                                          \
+                                                                        \
+  for ( p = 0 ; p + SIMD_WIDTH <= nPixels ; p += SIMD_WIDTH ) {         \
+    const CCEPixel *lanes = pixels + p;                                 \
+    SIMD_NAME(simd_alphas_t) k;                                         \
+                                                                        \
+    SIMD_NAME(alphasPixels)(&k, lanes);                                 \
+    for ( i = 0 ; i < count ; ++i ) {                                   \
+      V s = SIMD_NAME(gatherSrc)(lanes, i);                             \
+      V ps = SIMD_NAME(vmul)(s, k.sA);                                  \
+      V pb = SIMD_NAME(gatherBd)(lanes, i);                             \
+      SIMD_NAME(scatter)(lanes, i, SIMD_NAME(blend##NAME_)(s, ps, pb, &k)); \
+    }                                                                   \
+  }                                                                     \
+  for ( ; p < nPixels ; ++p )                                           \
+    SIMD_NAME(cce##NAME_)(count, pixels[p].src, pixels[p].srcAlpha,     \
+                          pixels[p].bd, pixels[p].bdAlpha,              \
+                          pixels[p].result);                            \
+}
+
+SIMD_COMPOSITERS(Normal, sA)
+SIMD_COMPOSITERS(Multiply, sA)
+SIMD_COMPOSITERS(Screen, sA)
+SIMD_COMPOSITERS(Overlay, sA)
+SIMD_COMPOSITERS(SoftLight, bA)
+SIMD_COMPOSITERS(HardLight, sA)
+SIMD_COMPOSITERS(ColorDodge, sA)
+SIMD_COMPOSITERS(ColorBurn, sA)
+SIMD_COMPOSITERS(Darken, sA)
+SIMD_COMPOSITERS(Lighten, sA)
+SIMD_COMPOSITERS(Difference, sA)
+SIMD_COMPOSITERS(Exclusion, sA)
+
+SIMD_PIXELS_COMPOSITER(Normal)
+SIMD_PIXELS_COMPOSITER(Multiply)
+SIMD_PIXELS_COMPOSITER(Screen)
+SIMD_PIXELS_COMPOSITER(Overlay)
+SIMD_PIXELS_COMPOSITER(SoftLight)
+SIMD_PIXELS_COMPOSITER(HardLight)
+SIMD_PIXELS_COMPOSITER(ColorDodge)
+SIMD_PIXELS_COMPOSITER(ColorBurn)
+SIMD_PIXELS_COMPOSITER(Darken)
+SIMD_PIXELS_COMPOSITER(Lighten)
+SIMD_PIXELS_COMPOSITER(Difference)
+SIMD_PIXELS_COMPOSITER(Exclusion)
+
+#undef SIMD_COMPOSITERS
+#undef SIMD_PIXELS_COMPOSITER
+
+/* --Alpha converters--
+
+   These return the number of values converted, leaving the remainder to
+   the scalar loop. */
+
+static SIMD_TARGET uint32 SIMD_NAME(cceMultiplyAlpha)(uint32 count,
+                                                      const COLORVALUE *src,
+                                                      COLORVALUE alpha,
+                                                      COLORVALUE *result)
+{
+  V a = V_SET1(alpha);
+  uint32 i;
+
+  for ( i = 0 ; i + SIMD_WIDTH <= count ; i += SIMD_WIDTH )
+    V_STORE(&result[i], SIMD_NAME(vmul)(V_LOAD(&src[i]), a));
+
+  return i;
+}
+
+static SIMD_TARGET uint32 SIMD_NAME(cceDivideAlpha)(uint32 count,
+                                                    const COLORVALUE *src,
+                                                    COLORVALUE alpha,
+                                                    COLORVALUE *result)
+{
+  SIMD_NAME(simd_alphas_t) k;
+  uint32 i;
+
+  SIMD_NAME(alphas)(&k, alpha, alpha);
+  for ( i = 0 ; i + SIMD_WIDTH <= count ; i += SIMD_WIDTH )
+    V_STORE(&result[i], SIMD_NAME(vdiv)(V_LOAD(&src[i]), k.sA, &k));
+
+  return i;
+}
+
+#undef VTRANFULL
+#undef VTRANPART
+#undef VU16
+
+/* Log stripped */
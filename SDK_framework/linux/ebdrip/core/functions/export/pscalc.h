@@ -33,6 +33,16 @@ struct PSCALC_OBJ *pscalc_create(OBJECT *proc);
 void pscalc_destroy(struct PSCALC_OBJ *func);
 int32 pscalc_exec(struct PSCALC_OBJ *func, int32 n_in, int32 n_out,
                   USERVALUE *in, USERVALUE *out);
+int32 pscalc_exec_block(struct PSCALC_OBJ *func, int32 n_in, int32 n_out,
+                        int32 n, USERVALUE **in, USERVALUE **out);
+
+struct PSCALC_LUT;
+
+struct PSCALC_LUT *pscalc_lut_create(struct PSCALC_OBJ *func, int32 n_out,
+                                     USERVALUE lo, USERVALUE hi,
+                                     USERVALUE tolerance);
+void pscalc_lut_destroy(struct PSCALC_LUT *lut);
+void pscalc_lut_lookup(struct PSCALC_LUT *lut, USERVALUE in, USERVALUE *out);
 
 #endif /* __PSCALC_H__ */
 
@@ -24,6 +24,7 @@
 #include "functns.h"
 #include "pathops.h"
 #include "execops.h"
+#include "pscalc.h"
 
 #include "fnpriv.h"
 #include "fntype4.h"
@@ -31,8 +32,14 @@
 /*----------------------------------------------------------------------------*/
 typedef struct fntype4 {
   OBJECT ps_proc ;
+  struct PSCALC_OBJ *pscalc_func ; /* ps_proc compiled by pscalc, or NULL */
+  struct PSCALC_LUT *pscalc_lut ;  /* pscalc_func sampled to a table, or NULL */
 } FNTYPE4 ;
 
+/* Largest error allowed when sampling a function into a table, as a
+   fraction of its narrowest output range. */
+#define FNTYPE4_LUT_TOLERANCE ( 1.0 / 262144.0 )
+
 /*----------------------------------------------------------------------------*/
 static void  fntype4_freecache( FUNCTIONCACHE *fn ) ;
 static Bool fntype4_evaluate_function( FUNCTIONCACHE *fn , Bool upwards ,
@@ -43,6 +50,15 @@ static Bool fntype4_find_discontinuity( FUNCTIONCACHE *fn ,
                                         SYSTEMVALUE *discontinuity , int32 *order ) ;
 
 
+/*----------------------------------------------------------------------------*/
+static void fntype4_freecalc( FNTYPE4 *t4 )
+{
+  pscalc_lut_destroy( t4->pscalc_lut ) ;
+  t4->pscalc_lut = NULL ;
+  pscalc_destroy( t4->pscalc_func ) ;
+  t4->pscalc_func = NULL ;
+}
+
 /*----------------------------------------------------------------------------*/
 Bool fntype4_initcache( FUNCTIONCACHE *fn )
 {
@@ -57,6 +73,9 @@ Bool fntype4_initcache( FUNCTIONCACHE *fn )
   if ( t4 == NULL )
     return error_handler( VMERROR ) ;
 
+  t4->pscalc_func = NULL ;
+  t4->pscalc_lut = NULL ;
+
   fn->specific = ( fn_type_specific )t4 ;
   fn->evalproc = fntype4_evaluate_function ;
   fn->discontproc = fntype4_find_discontinuity ;
@@ -88,6 +107,7 @@ Bool fntype4_unpack( FUNCTIONCACHE *fn , OBJECT *thes )
   HQASSERT( t4 , "t4 is null in fntype4_unpack" ) ;
 
   t4->ps_proc = onothing;   /* Struct copy to set slot properties */
+  fntype4_freecalc( t4 ) ;
 
   /* Enforce presence of Range */
   if ( fn->out_dim == 0 )
@@ -137,6 +157,29 @@ Bool fntype4_unpack( FUNCTIONCACHE *fn , OBJECT *thes )
        (Hq32x2CompareInt32(&filepos, 0) != 0) )
     return error_handler(IOERROR);
 
+  /* Compile the procedure so it can be evaluated without the interpreter.
+   * A single input function which turns out to be piecewise linear is also
+   * sampled into a table. Neither is an error if it fails: evaluation just
+   * falls back to the interpreter.
+   */
+  if ( fn->in_dim <= 4 && fn->out_dim <= 4 ) {
+    t4->pscalc_func = pscalc_create( &t4->ps_proc ) ;
+
+    if ( t4->pscalc_func != NULL && fn->in_dim == 1 ) {
+      SYSTEMVALUE width = fn->s_range[1] - fn->s_range[0] ;
+      int32 i ;
+
+      for ( i = 1 ; i < fn->out_dim ; ++i ) {
+        if ( fn->s_range[2 * i + 1] - fn->s_range[2 * i] < width )
+          width = fn->s_range[2 * i + 1] - fn->s_range[2 * i] ;
+      }
+      t4->pscalc_lut = pscalc_lut_create( t4->pscalc_func , fn->out_dim ,
+                                          ( USERVALUE )fn->s_domain[0] ,
+                                          ( USERVALUE )fn->s_domain[1] ,
+                                          ( USERVALUE )( width * FNTYPE4_LUT_TOLERANCE )) ;
+    }
+  }
+
   return TRUE ;
 }
 
@@ -148,6 +191,7 @@ static void fntype4_freecache( FUNCTIONCACHE *fn )
   FNTYPE4 *t4 ;
   HQASSERT( fn , "fn is null in fntype4_freecache" ) ;
   t4 = ( FNTYPE4 * )fn->specific ;
+  fntype4_freecalc( t4 ) ;
   mm_free( mm_pool_temp , ( mm_addr_t ) t4 , sizeof( FNTYPE4 )) ;
   fn->specific = NULL ;
   fn_invalidate_entry( fn ) ;
@@ -155,6 +199,49 @@ static void fntype4_freecache( FUNCTIONCACHE *fn )
 
 /*----------------------------------------------------------------------------*/
 
+/* Evaluate a function using its compiled or sampled form. Returns FALSE,
+   without raising an error, if the compiled procedure fails. */
+static Bool fntype4_calculate( FUNCTIONCACHE *fn , FNTYPE4 *t4 ,
+                               SYSTEMVALUE *input , SYSTEMVALUE *output )
+{
+  USERVALUE calc_in[ 4 ] , calc_out[ 4 ] ;
+  SYSTEMVALUE *domain = fn->s_domain ;
+  SYSTEMVALUE *rng_ptr = fn->s_range ;
+  SYSTEMVALUE tmp , lb , ub ;
+  int32 i ;
+
+  HQASSERT( fn->in_dim <= 4 && fn->out_dim <= 4 ,
+            "Too many dimensions for compiled type 4 function" ) ;
+
+  for ( i = 0 ; i < fn->in_dim ; ++i ) {
+    tmp = input[i] ;
+    lb = domain[0] ;
+    ub = domain[1] ;
+    domain += 2 ;
+    fn_cliptointerval( tmp , lb , ub ) ;
+    calc_in[i] = ( USERVALUE )tmp ;
+  }
+
+  if ( t4->pscalc_lut != NULL )
+    pscalc_lut_lookup( t4->pscalc_lut , calc_in[0] , calc_out ) ;
+  else if ( pscalc_exec( t4->pscalc_func , fn->in_dim , fn->out_dim ,
+                         calc_in , calc_out ) != PSCALC_noerr )
+    return FALSE ;
+
+  for ( i = 0 ; i < fn->out_dim ; ++i ) {
+    tmp = calc_out[i] ;
+    lb = rng_ptr[0] ;
+    ub = rng_ptr[1] ;
+    rng_ptr += 2 ;
+    fn_cliptointerval( tmp , lb , ub ) ;
+    output[i] = tmp ;
+  }
+
+  return TRUE ;
+}
+
+/*----------------------------------------------------------------------------*/
+
 static Bool fntype4_evaluate_function( FUNCTIONCACHE *fn , Bool upwards ,
                                        SYSTEMVALUE *input , SYSTEMVALUE *output )
 {
@@ -174,6 +261,11 @@ static Bool fntype4_evaluate_function( FUNCTIONCACHE *fn , Bool upwards ,
   t4 = ( FNTYPE4 * )fn->specific ;
   HQASSERT( t4 , "t4 is null in fntype4_evaluate_function" ) ;
 
+  /* Use the compiled procedure if there is one. If that fails, the
+     interpreter is left to raise the error. */
+  if ( t4->pscalc_func != NULL && fntype4_calculate( fn , t4 , input , output ))
+    return TRUE ;
+
   /* need to setup the postscript dictionaries:
    * input variables -> initial operand stack
    * output variables -> items remaining on operand stack after execution
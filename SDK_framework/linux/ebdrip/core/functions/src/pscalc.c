@@ -41,6 +41,11 @@
  *
  * So we will either need to alter these last two bits of usage, or enhance
  * pscalc to include this extra functionality.
+ *
+ * As well as running a procedure on a single set of inputs, pscalc can run
+ * it over a block of input tuples at once (pscalc_exec_block), and can
+ * sample a one-input procedure which is piecewise linear into a lookup
+ * table (pscalc_lut_create), so that it need not be run at all.
  */
 
 #include "core.h"
@@ -325,35 +330,44 @@ static int32 pscalc_err(int32 err, int32 opcode)
 }
 
 /**
- * Check that the given argument means the restrcitions in type we have
- * placed upon it. Also if it happens to be a number (int or real), return
- * its value converted to a format suitable for use in internal calculations.
+ * Check that an object of the given type meets the restrictions in type we
+ * have placed upon an argument.
  */
-static Bool pscalc_checkarg(PSCALC_OBJ *obj, int32 allowed, SYSTEMVALUE *val)
+static Bool pscalc_checktype(int32 type, int32 allowed)
 {
-  (void)pscalc_getnum(obj, val);
-
   if ( allowed == PSCALC_ARG_ANY )
     return TRUE;
-  if ( allowed == PSCALC_ARG_REAL && obj->type != PSCALC_REAL )
+  if ( allowed == PSCALC_ARG_REAL && type != PSCALC_REAL )
     return FALSE;
-  if ( allowed == PSCALC_ARG_INT && obj->type != PSCALC_INT )
+  if ( allowed == PSCALC_ARG_INT && type != PSCALC_INT )
     return FALSE;
-  if ( allowed == PSCALC_ARG_BOOL && obj->type != PSCALC_BOOL )
+  if ( allowed == PSCALC_ARG_BOOL && type != PSCALC_BOOL )
     return FALSE;
-  if ( allowed == PSCALC_ARG_PROC && obj->type != PSCALC_PROC )
+  if ( allowed == PSCALC_ARG_PROC && type != PSCALC_PROC )
     return FALSE;
   if ( allowed == PSCALC_ARG_NUM ) {
-    if ( !(obj->type == PSCALC_INT || obj->type == PSCALC_REAL) )
+    if ( !(type == PSCALC_INT || type == PSCALC_REAL) )
       return FALSE;
   }
   if ( allowed == PSCALC_ARG_IOB ) {
-    if ( !(obj->type == PSCALC_INT || obj->type == PSCALC_BOOL) )
+    if ( !(type == PSCALC_INT || type == PSCALC_BOOL) )
       return FALSE;
   }
   return TRUE;
 }
 
+/**
+ * Check that the given argument means the restrcitions in type we have
+ * placed upon it. Also if it happens to be a number (int or real), return
+ * its value converted to a format suitable for use in internal calculations.
+ */
+static Bool pscalc_checkarg(PSCALC_OBJ *obj, int32 allowed, SYSTEMVALUE *val)
+{
+  (void)pscalc_getnum(obj, val);
+
+  return pscalc_checktype(obj->type, allowed);
+}
+
 /**
  * Are two PS-Calculator objects equal. Note ints can be equal to reals if they
  * have the same value.
@@ -881,6 +895,1177 @@ int32 pscalc_exec(PSCALC_OBJ *func, int32 n_in, int32 n_out,
   return PSCALC_noerr;
 }
 
+/*---------------------------------------------------------------------------*/
+
+/**
+ * Number of input tuples run through a PS-Calculator procedure together by
+ * pscalc_exec_block().
+ */
+#define PSCALC_LANES 16
+
+/**
+ * Internal status from the lane evaluator, meaning the tuples in a batch
+ * need different treatment (e.g. they take different branches of an
+ * "ifelse", or one of them would raise an error). The batch is then re-run
+ * a tuple at a time.
+ */
+#define PSCALC_diverged (-1)
+
+/**
+ * A PS-Calculator object holding one value per lane. The object type is
+ * shared by all the lanes: it depends only on the procedure and not on the
+ * input values, so long as every lane follows the same path through it.
+ */
+typedef struct PSCALC_LANEOBJ {
+  int32 type;       /**< Object type, common to all lanes */
+  PSCALC_OBJ proc;  /**< Procedure header, for PSCALC_PROC objects only */
+  union {
+    int32 integer[PSCALC_LANES];        /**< Values for integer objects */
+    PSCALC_OBJREAL real[PSCALC_LANES];  /**< Values for real objects */
+    Bool  boolean[PSCALC_LANES];        /**< Values for boolean objects */
+  } val;            /**< Union of per-lane object values */
+} PSCALC_LANEOBJ;
+
+/**
+ * The object stack used by the PS-Calculator lane evaluator.
+ */
+typedef struct PSCALC_LANESTACK {
+  int32 size;   /**< Total number of elements in the stack */
+  int32 top;    /**< Index of the next free space on the stack */
+  int32 nlanes; /**< Number of lanes in use, at most PSCALC_LANES */
+  PSCALC_LANEOBJ obj[PSCALC_MAXSTACK+10]; /**< Stack plus safety overhead */
+} PSCALC_LANESTACK;
+
+/** Get lane \a l_ of the number \a obj_ as a SYSTEMVALUE, given its type. */
+#define PSCALC_LANENUM(obj_, type_, l_) ((type_) == PSCALC_REAL ? \
+  (SYSTEMVALUE)(obj_)->val.real[l_] : (SYSTEMVALUE)(obj_)->val.integer[l_])
+
+/**
+ * Do all the lanes of an integer, real or boolean object hold the same
+ * value? Reals are compared by their bit patterns, which is good enough
+ * for deciding whether lanes can share a path through the procedure.
+ */
+static Bool pscalc_lane_uniform(PSCALC_LANEOBJ *obj, int32 nlanes)
+{
+  int32 l;
+
+  for ( l = 1; l < nlanes; l++ ) {
+    if ( obj->val.integer[l] != obj->val.integer[0] )
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * Push a (scalar) PS-Calculator object onto every lane of the stack.
+ */
+static void pscalc_lane_push(PSCALC_LANESTACK *stack, PSCALC_OBJ *obj)
+{
+  PSCALC_LANEOBJ *lobj = &stack->obj[stack->top++];
+  int32 l;
+
+  lobj->type = obj->type;
+  switch ( obj->type ) {
+    case PSCALC_INT:
+      for ( l = 0; l < stack->nlanes; l++ )
+        lobj->val.integer[l] = obj->val.integer;
+      break;
+    case PSCALC_REAL:
+      for ( l = 0; l < stack->nlanes; l++ )
+        lobj->val.real[l] = obj->val.real;
+      break;
+    case PSCALC_BOOL:
+      for ( l = 0; l < stack->nlanes; l++ )
+        lobj->val.boolean[l] = obj->val.boolean;
+      break;
+    case PSCALC_PROC:
+      lobj->proc = *obj;
+      break;
+  }
+}
+
+/**
+ * Lane version of pscalc_equalobjs(), leaving the result in \a obj2.
+ */
+static void pscalc_lane_equal(PSCALC_LANEOBJ *obj1, PSCALC_LANEOBJ *obj2,
+                              int32 nlanes, Bool equal)
+{
+  int32 l, t1 = obj1->type, t2 = obj2->type;
+
+  if ( t1 == PSCALC_INT && t2 == PSCALC_INT ) {
+    for ( l = 0; l < nlanes; l++ )
+      obj2->val.boolean[l] =
+        (obj1->val.integer[l] == obj2->val.integer[l]) == equal;
+  } else if ( (t1 == PSCALC_INT || t1 == PSCALC_REAL) &&
+              (t2 == PSCALC_INT || t2 == PSCALC_REAL) ) {
+    for ( l = 0; l < nlanes; l++ ) {
+      PSCALC_OBJREAL r1 = t1 == PSCALC_REAL ? obj1->val.real[l]
+                                            : (PSCALC_OBJREAL)obj1->val.integer[l];
+      PSCALC_OBJREAL r2 = t2 == PSCALC_REAL ? obj2->val.real[l]
+                                            : (PSCALC_OBJREAL)obj2->val.integer[l];
+      obj2->val.boolean[l] = (r1 == r2) == equal;
+    }
+  } else if ( t1 == PSCALC_BOOL && t2 == PSCALC_BOOL ) {
+    for ( l = 0; l < nlanes; l++ )
+      obj2->val.boolean[l] =
+        (obj1->val.boolean[l] == obj2->val.boolean[l]) == equal;
+  } else {
+    for ( l = 0; l < nlanes; l++ )
+      obj2->val.boolean[l] = !equal;
+  }
+  obj2->type = PSCALC_BOOL;
+}
+
+static int32 pscalc_lane_op(int32 opcode, PSCALC_OBJ *pso,
+                            PSCALC_LANESTACK *stack);
+
+/**
+ * Run the given PS-Calculator procedure over all the lanes of the stack.
+ */
+static int32 pscalc_lane_run(PSCALC_OBJ *pso, PSCALC_LANESTACK *stack,
+                             PSCALC_OBJ *proc)
+{
+  int32 i, err, starti = proc->val.range.starti, endi = proc->val.range.endi;
+
+  HQASSERT(proc->type == PSCALC_PROC &&
+           starti > 0 && starti < PSCALC_MAXOBJS && endi > 0 &&
+           endi < PSCALC_MAXOBJS && starti < endi,
+           "Corrupt pscalc procedure\n");
+
+  for ( i = starti; i < endi; i++ ) {
+    PSCALC_OBJ *obj = pso+i;
+
+    if ( stack->top >= stack->size )
+      return pscalc_err(PSCALC_stackoverflow, PSCALC_invalid);
+
+    if ( obj->type == PSCALC_OPERATOR ) {
+      if ((err = pscalc_lane_op(obj->val.opcode, pso, stack)) != PSCALC_noerr)
+        return err;
+    } else {
+      pscalc_lane_push(stack, obj);
+      if ( obj->type == PSCALC_PROC )
+        i = obj->val.range.endi - 1;
+    }
+  }
+  return PSCALC_noerr;
+}
+
+/**
+ * Execute a single PS-Calculator operator object on all the lanes of the
+ * stack.
+ *
+ * This mirrors pscalc_do_op(), and must give the same answers for each
+ * lane. Anything which depends on the values in the lanes rather than on
+ * their types (the branch taken, a count for a stack operator, an error
+ * such as division by zero) has to be the same for every lane, otherwise
+ * PSCALC_diverged is returned and the caller runs the lanes one at a time.
+ */
+static int32 pscalc_lane_op(int32 opcode, PSCALC_OBJ *pso,
+                            PSCALC_LANESTACK *stack)
+{
+  PSCALC_LANEOBJ *op1 = stack->top < 1 ? NULL : &(stack->obj[stack->top-1]);
+  PSCALC_LANEOBJ *op2 = stack->top < 2 ? NULL : &(stack->obj[stack->top-2]);
+  PSCALC_LANEOBJ tmp;
+  int32 nlanes = stack->nlanes;
+  int32 t1 = 0, t2 = 0;
+  int32 i, l, n, m, err;
+
+  if ( pscalc_opargs[opcode].nargs > stack->top )
+    return pscalc_err(PSCALC_stackunderflow, opcode);
+
+  if ( pscalc_opargs[opcode].nargs >= 1 ) {
+    t1 = op1->type;
+    if ( !pscalc_checktype(t1, pscalc_opargs[opcode].arg1) )
+      return pscalc_err(PSCALC_typecheck, opcode);
+  }
+  if ( pscalc_opargs[opcode].nargs >= 2 ) {
+    t2 = op2->type;
+    if ( !pscalc_checktype(t2, pscalc_opargs[opcode].arg2) )
+      return pscalc_err(PSCALC_typecheck, opcode);
+
+    if ( pscalc_opargs[opcode].arg1 == PSCALC_ARG_IOB &&
+         pscalc_opargs[opcode].arg2 == PSCALC_ARG_IOB )
+      if ( t1 != t2 )
+        return pscalc_err(PSCALC_typecheck, opcode);
+  }
+
+  switch ( opcode ) {
+    /* All the arithmetic operators */
+    case PSCALC_abs:
+      if ( t1 == PSCALC_INT ) {
+        for ( l = 0; l < nlanes; l++ )
+          if ( op1->val.integer[l] < 0 )
+            op1->val.integer[l] = -op1->val.integer[l];
+      } else {
+        for ( l = 0; l < nlanes; l++ )
+          if ( op1->val.real[l] < 0.0 )
+            op1->val.real[l] = -op1->val.real[l];
+      }
+      break;
+    case PSCALC_add:
+      if ( t1 == PSCALC_INT && t2 == PSCALC_INT ) {
+        for ( l = 0; l < nlanes; l++ )
+          op2->val.integer[l] += op1->val.integer[l];
+      } else {
+        for ( l = 0; l < nlanes; l++ )
+          op2->val.real[l] = (PSCALC_OBJREAL)(PSCALC_LANENUM(op1, t1, l) +
+                                              PSCALC_LANENUM(op2, t2, l));
+        op2->type = PSCALC_REAL;
+      }
+      stack->top--;
+      break;
+    case PSCALC_atan:
+      for ( l = 0; l < nlanes; l++ )
+        if ( PSCALC_LANENUM(op1, t1, l) == 0.0 &&
+             PSCALC_LANENUM(op2, t2, l) == 0.0 )
+          return PSCALC_diverged;
+      for ( l = 0; l < nlanes; l++ ) {
+        PSCALC_OBJREAL r = (PSCALC_OBJREAL)
+          (RAD_TO_DEG * atan2(PSCALC_LANENUM(op2, t2, l),
+                              PSCALC_LANENUM(op1, t1, l)));
+        if ( r < 0.0 )
+          r += 360.0;
+        op2->val.real[l] = r;
+      }
+      op2->type = PSCALC_REAL;
+      stack->top--;
+      break;
+    case PSCALC_ceiling:
+      if ( t1 == PSCALC_REAL ) {
+        for ( l = 0; l < nlanes; l++ ) {
+          n = (int32)op1->val.real[l];
+          if ( n >= 0 && (PSCALC_OBJREAL)n - op1->val.real[l] != 0.0 )
+            n++;
+          op1->val.real[l] = (PSCALC_OBJREAL)n;
+        }
+      }
+      break;
+    case PSCALC_cos:
+      for ( l = 0; l < nlanes; l++ )
+        op1->val.real[l] =
+          (PSCALC_OBJREAL)cos(PSCALC_LANENUM(op1, t1, l)*DEG_TO_RAD);
+      op1->type = PSCALC_REAL;
+      break;
+    case PSCALC_cvi:
+      if ( t1 == PSCALC_REAL ) {
+        for ( l = 0; l < nlanes; l++ )
+          op1->val.integer[l] = (int32)op1->val.real[l];
+        op1->type = PSCALC_INT;
+      }
+      break;
+    case PSCALC_cvr:
+      if ( t1 == PSCALC_INT ) {
+        for ( l = 0; l < nlanes; l++ )
+          op1->val.real[l] = (PSCALC_OBJREAL)op1->val.integer[l];
+        op1->type = PSCALC_REAL;
+      }
+      break;
+    case PSCALC_div:
+      for ( l = 0; l < nlanes; l++ )
+        if ( PSCALC_LANENUM(op1, t1, l) == 0.0 )
+          return PSCALC_diverged;
+      for ( l = 0; l < nlanes; l++ )
+        op2->val.real[l] = (PSCALC_OBJREAL)(PSCALC_LANENUM(op2, t2, l) /
+                                            PSCALC_LANENUM(op1, t1, l));
+      op2->type = PSCALC_REAL;
+      stack->top--;
+      break;
+    case PSCALC_exp:
+      for ( l = 0; l < nlanes; l++ ) {
+        SYSTEMVALUE v1 = PSCALC_LANENUM(op1, t1, l);
+        if ( PSCALC_LANENUM(op2, t2, l) < 0.0 && v1 != (int32)v1 )
+          return PSCALC_diverged;
+      }
+      for ( l = 0; l < nlanes; l++ )
+        op2->val.real[l] = (PSCALC_OBJREAL)pow(PSCALC_LANENUM(op2, t2, l),
+                                               PSCALC_LANENUM(op1, t1, l));
+      op2->type = PSCALC_REAL;
+      stack->top--;
+      break;
+    case PSCALC_floor:
+      if ( t1 == PSCALC_REAL ) {
+        for ( l = 0; l < nlanes; l++ ) {
+          n = (int32)op1->val.real[l];
+          if ( n <= 0 && (PSCALC_OBJREAL)n - op1->val.real[l] != 0.0 )
+            n--;
+          op1->val.real[l] = (PSCALC_OBJREAL)n;
+        }
+      }
+      break;
+    case PSCALC_idiv:
+    case PSCALC_mod:
+      for ( l = 0; l < nlanes; l++ )
+        if ( op1->val.integer[l] == 0 )
+          return PSCALC_diverged;
+      if ( opcode == PSCALC_idiv ) {
+        for ( l = 0; l < nlanes; l++ )
+          op2->val.integer[l] = op2->val.integer[l] / op1->val.integer[l];
+      } else {
+        for ( l = 0; l < nlanes; l++ )
+          op2->val.integer[l] = op2->val.integer[l] % op1->val.integer[l];
+      }
+      stack->top--;
+      break;
+    case PSCALC_ln:
+    case PSCALC_log:
+      for ( l = 0; l < nlanes; l++ )
+        if ( PSCALC_LANENUM(op1, t1, l) <= 0.0 )
+          return PSCALC_diverged;
+      if ( opcode == PSCALC_ln ) {
+        for ( l = 0; l < nlanes; l++ )
+          op1->val.real[l] = (PSCALC_OBJREAL)log(PSCALC_LANENUM(op1, t1, l));
+      } else {
+        for ( l = 0; l < nlanes; l++ )
+          op1->val.real[l] = (PSCALC_OBJREAL)log10(PSCALC_LANENUM(op1, t1, l));
+      }
+      op1->type = PSCALC_REAL;
+      break;
+    case PSCALC_mul:
+      if ( t1 == PSCALC_INT && t2 == PSCALC_INT ) {
+        for ( l = 0; l < nlanes; l++ )
+          op2->val.integer[l] *= op1->val.integer[l];
+      } else {
+        for ( l = 0; l < nlanes; l++ )
+          op2->val.real[l] = (PSCALC_OBJREAL)(PSCALC_LANENUM(op1, t1, l) *
+                                              PSCALC_LANENUM(op2, t2, l));
+        op2->type = PSCALC_REAL;
+      }
+      stack->top--;
+      break;
+    case PSCALC_neg:
+      if ( t1 == PSCALC_INT ) {
+        for ( l = 0; l < nlanes; l++ )
+          op1->val.integer[l] = -op1->val.integer[l];
+      } else {
+        for ( l = 0; l < nlanes; l++ )
+          op1->val.real[l] = -op1->val.real[l];
+      }
+      break;
+    case PSCALC_round:
+      if ( t1 == PSCALC_REAL ) {
+        for ( l = 0; l < nlanes; l++ ) {
+          n = (int32)(op1->val.real[l] + 0.5);
+          if ( n <= 0 && (PSCALC_OBJREAL)n - op1->val.real[l] != 0.5 )
+            n--;
+          op1->val.real[l] = (PSCALC_OBJREAL)n;
+        }
+      }
+      break;
+    case PSCALC_sin:
+      for ( l = 0; l < nlanes; l++ )
+        op1->val.real[l] =
+          (PSCALC_OBJREAL)sin(PSCALC_LANENUM(op1, t1, l)*DEG_TO_RAD);
+      op1->type = PSCALC_REAL;
+      break;
+    case PSCALC_sqrt:
+      for ( l = 0; l < nlanes; l++ )
+        if ( PSCALC_LANENUM(op1, t1, l) < 0.0 )
+          return PSCALC_diverged;
+      for ( l = 0; l < nlanes; l++ )
+        op1->val.real[l] = (PSCALC_OBJREAL)sqrt(PSCALC_LANENUM(op1, t1, l));
+      op1->type = PSCALC_REAL;
+      break;
+    case PSCALC_sub:
+      if ( t1 == PSCALC_INT && t2 == PSCALC_INT ) {
+        for ( l = 0; l < nlanes; l++ )
+          op2->val.integer[l] -= op1->val.integer[l];
+      } else {
+        for ( l = 0; l < nlanes; l++ )
+          op2->val.real[l] = (PSCALC_OBJREAL)(PSCALC_LANENUM(op2, t2, l) -
+                                              PSCALC_LANENUM(op1, t1, l));
+        op2->type = PSCALC_REAL;
+      }
+      stack->top--;
+      break;
+    case PSCALC_truncate:
+      if ( t1 == PSCALC_REAL ) {
+        for ( l = 0; l < nlanes; l++ )
+          op1->val.real[l] = (PSCALC_OBJREAL)(int32)op1->val.real[l];
+      }
+      break;
+
+    /* Relational. Booleans and integers share the same representation, so
+       the bitwise operators do not need to distinguish them. */
+    case PSCALC_and:
+      for ( l = 0; l < nlanes; l++ )
+        op2->val.integer[l] &= op1->val.integer[l];
+      stack->top--;
+      break;
+    case PSCALC_bitshift:
+      for ( l = 0; l < nlanes; l++ ) {
+        n = op1->val.integer[l];
+        if ( n < 0 )
+          op2->val.integer[l] = (op2->val.integer[l] >> (-n));
+        else if ( n > 0 )
+          op2->val.integer[l] = (op2->val.integer[l] << n);
+      }
+      stack->top--;
+      break;
+    case PSCALC_eq:
+    case PSCALC_ne:
+      pscalc_lane_equal(op1, op2, nlanes, opcode == PSCALC_eq);
+      stack->top--;
+      break;
+    case PSCALC_false:
+    case PSCALC_true: {
+      PSCALC_OBJ b;
+
+      if ( stack->top >= stack->size )
+        return pscalc_err(PSCALC_stackoverflow, opcode);
+      b.type = PSCALC_BOOL;
+      b.val.boolean = (opcode == PSCALC_true);
+      pscalc_lane_push(stack, &b);
+      break;
+    }
+    case PSCALC_ge:
+      for ( l = 0; l < nlanes; l++ )
+        op2->val.boolean[l] = (Bool)(PSCALC_LANENUM(op2, t2, l) >=
+                                     PSCALC_LANENUM(op1, t1, l));
+      op2->type = PSCALC_BOOL;
+      stack->top--;
+      break;
+    case PSCALC_gt:
+      for ( l = 0; l < nlanes; l++ )
+        op2->val.boolean[l] = (Bool)(PSCALC_LANENUM(op2, t2, l) >
+                                     PSCALC_LANENUM(op1, t1, l));
+      op2->type = PSCALC_BOOL;
+      stack->top--;
+      break;
+    case PSCALC_le:
+      for ( l = 0; l < nlanes; l++ )
+        op2->val.boolean[l] = (Bool)(PSCALC_LANENUM(op2, t2, l) <=
+                                     PSCALC_LANENUM(op1, t1, l));
+      op2->type = PSCALC_BOOL;
+      stack->top--;
+      break;
+    case PSCALC_lt:
+      for ( l = 0; l < nlanes; l++ )
+        op2->val.boolean[l] = (Bool)(PSCALC_LANENUM(op2, t2, l) <
+                                     PSCALC_LANENUM(op1, t1, l));
+      op2->type = PSCALC_BOOL;
+      stack->top--;
+      break;
+    case PSCALC_not:
+      if ( t1 == PSCALC_INT ) {
+        for ( l = 0; l < nlanes; l++ )
+          op1->val.integer[l] = ~op1->val.integer[l];
+      } else {
+        for ( l = 0; l < nlanes; l++ )
+          op1->val.boolean[l] = !op1->val.boolean[l];
+      }
+      break;
+    case PSCALC_or:
+      for ( l = 0; l < nlanes; l++ )
+        op2->val.integer[l] |= op1->val.integer[l];
+      stack->top--;
+      break;
+    case PSCALC_xor:
+      for ( l = 0; l < nlanes; l++ )
+        op2->val.integer[l] ^= op1->val.integer[l];
+      stack->top--;
+      break;
+
+    /* Conditional */
+    case PSCALC_if:
+      if ( !pscalc_lane_uniform(op2, nlanes) )
+        return PSCALC_diverged;
+      stack->top -= 2;
+      if ( op2->val.boolean[0] ) {
+        if ((err = pscalc_lane_run(pso, stack, &op1->proc)) != PSCALC_noerr)
+          return err;
+      }
+      break;
+    case PSCALC_ifelse:
+      if ( stack->obj[stack->top-3].type != PSCALC_BOOL )
+        return pscalc_err(PSCALC_typecheck, opcode);
+      if ( !pscalc_lane_uniform(&stack->obj[stack->top-3], nlanes) )
+        return PSCALC_diverged;
+      stack->top -= 3;
+      if ( stack->obj[stack->top].val.boolean[0] ) {
+        if ((err = pscalc_lane_run(pso, stack, &op2->proc)) != PSCALC_noerr)
+          return err;
+      } else {
+        if ((err = pscalc_lane_run(pso, stack, &op1->proc)) != PSCALC_noerr)
+          return err;
+      }
+      break;
+    case PSCALC_repeat: {
+      PSCALC_OBJ proc = op1->proc;
+
+      if ( !pscalc_lane_uniform(op2, nlanes) )
+        return PSCALC_diverged;
+      stack->top -= 2;
+      n = op2->val.integer[0];
+      while ( n-- > 0 ) {
+        if ((err = pscalc_lane_run(pso, stack, &proc)) != PSCALC_noerr)
+          return err;
+      }
+      break;
+    }
+    case PSCALC_exec:
+      stack->top--;
+      if ((err = pscalc_lane_run(pso, stack, &op1->proc)) != PSCALC_noerr)
+        return err;
+      break;
+
+    case PSCALC_for: {
+      SYSTEMVALUE ff, f[3];
+      Bool use_ints = TRUE;
+      PSCALC_OBJ proc = op1->proc, ctrl;
+
+      for ( i = 0; i < 3; i++ ) {
+        PSCALC_LANEOBJ *fobj = &stack->obj[stack->top-4+i];
+
+        if ( fobj->type != PSCALC_INT && fobj->type != PSCALC_REAL )
+          return pscalc_err(PSCALC_typecheck, opcode);
+        if ( !pscalc_lane_uniform(fobj, nlanes) )
+          return PSCALC_diverged;
+        f[i] = PSCALC_LANENUM(fobj, fobj->type, 0);
+        if ( fobj->type != PSCALC_INT )
+          use_ints = FALSE;
+      }
+      stack->top -= 4;
+
+      for ( ff = f[0]; (f[2] > 0.0) ? (ff <= f[1]) : (ff >= f[1]); ff += f[2] ) {
+        if ( stack->top + 1 >= stack->size )
+          return pscalc_err(PSCALC_stackoverflow, opcode);
+        if ( use_ints ) {
+          ctrl.type = PSCALC_INT;
+          ctrl.val.integer = (int32)(ff + 0.5);
+        } else {
+          ctrl.type = PSCALC_REAL;
+          ctrl.val.real = (PSCALC_OBJREAL)ff;
+        }
+        pscalc_lane_push(stack, &ctrl);
+        if ((err = pscalc_lane_run(pso, stack, &proc)) != PSCALC_noerr)
+          return err;
+      }
+      break;
+    }
+
+    /* Stack */
+    case PSCALC_copy:
+      if ( !pscalc_lane_uniform(op1, nlanes) )
+        return PSCALC_diverged;
+      if ( (n = op1->val.integer[0]) < 0 )
+        return pscalc_err(PSCALC_rangecheck, opcode);
+      stack->top--;
+      if ( stack->top < n )
+        return pscalc_err(PSCALC_stackunderflow, opcode);
+      if ( stack->top + n >= stack->size )
+        return pscalc_err(PSCALC_stackoverflow, opcode);
+      for ( i = 0; i < n; i++ ) {
+        stack->obj[stack->top] = stack->obj[stack->top - n];
+        stack->top++;
+      }
+      break;
+    case PSCALC_dup:
+      if ( stack->top >= stack->size )
+        return pscalc_err(PSCALC_stackoverflow, opcode);
+      op1[1] = op1[0];
+      stack->top++;
+      break;
+    case PSCALC_exch:
+      tmp = *op1;
+      *op1 = *op2;
+      *op2 = tmp;
+      break;
+    case PSCALC_index:
+      if ( !pscalc_lane_uniform(op1, nlanes) )
+        return PSCALC_diverged;
+      if ( (n = op1->val.integer[0]) < 0 )
+        return pscalc_err(PSCALC_rangecheck, opcode);
+      if ( n >= stack->top  - 1 )
+        return pscalc_err(PSCALC_stackunderflow, opcode);
+      op1[0] = op1[-n-1];
+      break;
+    case PSCALC_pop:
+      stack->top--;
+      break;
+    case PSCALC_roll:
+      if ( !pscalc_lane_uniform(op1, nlanes) ||
+           !pscalc_lane_uniform(op2, nlanes) )
+        return PSCALC_diverged;
+      m = op1->val.integer[0];
+      if ( (n = op2->val.integer[0])  < 0 )
+        return pscalc_err(PSCALC_rangecheck, opcode);
+
+      stack->top -= 2;
+      if ( stack->top < n )
+        return pscalc_err(PSCALC_stackunderflow, opcode);
+      while ( m != 0 ) {
+        if ( m > 0 ) {
+          tmp = stack->obj[stack->top - 1];
+          for ( i = stack->top - 1; i > stack->top - n; i-- ) {
+            stack->obj[i] = stack->obj[i-1];
+          }
+          stack->obj[stack->top - n] = tmp;
+          m--;
+        } else {
+          tmp = stack->obj[stack->top - n];
+          for ( i = stack->top - n; i < stack->top -1; i++ ) {
+            stack->obj[i] = stack->obj[i+1];
+          }
+          stack->obj[stack->top - 1] = tmp;
+          m++;
+        }
+      }
+      break;
+  }
+  return PSCALC_noerr;
+}
+
+/**
+ * Execute the given bit of 'compiled' PS-Calculator code over a number of
+ * input tuples.
+ *
+ * The tuples are passed in structure-of-arrays form: \a in[i][j] is input
+ * \a i of tuple \a j, and \a out[i][j] receives output \a i of tuple \a j.
+ * Up to PSCALC_LANES tuples are run through the procedure at once, with a
+ * stack holding one value per tuple, so each operator is dispatched once
+ * per batch rather than once per tuple. Batches whose tuples need different
+ * paths through the procedure are run a tuple at a time with pscalc_exec(),
+ * so the results and any error are exactly what pscalc_exec() would give.
+ */
+int32 pscalc_exec_block(PSCALC_OBJ *func, int32 n_in, int32 n_out, int32 n,
+                        USERVALUE **in, USERVALUE **out)
+{
+  PSCALC_LANESTACK stack;
+  int32 base, i, l, err;
+
+  HQASSERT(n_in >= 0 && n_out >= 0 && n >= 0, "Invalid pscalc block size");
+
+  if ( n_in > PSCALC_MAXSTACK || n_out > PSCALC_MAXSTACK )
+    return pscalc_err(PSCALC_stackoverflow, PSCALC_invalid);
+
+  for ( base = 0; base < n; base += PSCALC_LANES ) {
+    stack.size   = PSCALC_MAXSTACK;
+    stack.top    = 0;
+    stack.nlanes = min(n - base, PSCALC_LANES);
+
+    for ( i = 0; i < n_in; i++ ) {
+      PSCALC_LANEOBJ *obj = &stack.obj[stack.top++];
+
+      obj->type = PSCALC_REAL;
+      for ( l = 0; l < stack.nlanes; l++ )
+        obj->val.real[l] = (PSCALC_OBJREAL)in[i][base + l];
+    }
+
+    err = pscalc_lane_run(func, &stack, func);
+
+    if ( err == PSCALC_noerr ) {
+      if ( stack.top != n_out )
+        return pscalc_err(PSCALC_rangecheck, PSCALC_invalid);
+      for ( i = 0; i < n_out; i++ ) {
+        PSCALC_LANEOBJ *obj = &stack.obj[i];
+        USERVALUE *dst = out[i] + base;
+
+        if ( obj->type == PSCALC_REAL ) {
+          for ( l = 0; l < stack.nlanes; l++ )
+            dst[l] = (USERVALUE)obj->val.real[l];
+        } else if ( obj->type == PSCALC_INT ) {
+          for ( l = 0; l < stack.nlanes; l++ )
+            dst[l] = (USERVALUE)obj->val.integer[l];
+        } else
+          return pscalc_err(PSCALC_typecheck, PSCALC_invalid);
+      }
+    } else if ( err == PSCALC_diverged ) {
+      USERVALUE tin[PSCALC_MAXSTACK], tout[PSCALC_MAXSTACK];
+
+      for ( l = 0; l < stack.nlanes; l++ ) {
+        for ( i = 0; i < n_in; i++ )
+          tin[i] = in[i][base + l];
+        if ( (err = pscalc_exec(func, n_in, n_out, tin, tout)) != PSCALC_noerr )
+          return err;
+        for ( i = 0; i < n_out; i++ )
+          out[i][base + l] = tout[i];
+      }
+    } else
+      return err;
+  }
+  return PSCALC_noerr;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/**
+ * Number of intervals in a PS-Calculator lookup table.
+ */
+#define PSCALC_LUT_SIZE 256
+
+/**
+ * Maximum number of outputs sampled into a PS-Calculator lookup table.
+ */
+#define PSCALC_LUT_MAXOUT 16
+
+/**
+ * A one-input PS-Calculator procedure sampled into a table which is
+ * linearly interpolated.
+ */
+typedef struct PSCALC_LUT {
+  int32 n_out;          /**< Number of outputs */
+  USERVALUE lo;         /**< Input value of the first table entry */
+  USERVALUE scale;      /**< Maps input values to table intervals */
+  USERVALUE maxerr;     /**< Largest interpolation error found checking */
+  USERVALUE values[1];  /**< n_out rows of PSCALC_LUT_SIZE+1 samples */
+} PSCALC_LUT;
+
+#define PSCALC_LUT_BYTES(n_out_) \
+  (sizeof(PSCALC_LUT) + ((n_out_) * (PSCALC_LUT_SIZE + 1) - 1) * sizeof(USERVALUE))
+
+/**
+ * What is known about an object on the stack while checking the shape of a
+ * procedure. Integers and reals are not distinguished: the check is only
+ * interested in how values vary with the input.
+ */
+typedef struct PSCALC_SHAPE {
+  int32 type;     /**< PSCALC_REAL for any number, PSCALC_BOOL or PSCALC_PROC */
+  int32 degree;   /**< 0 if constant, 1 if piecewise linear in the input */
+  Bool  known;    /**< Is this an integer whose value is known? */
+  int32 integer;  /**< The value of a known integer */
+  PSCALC_OBJ proc; /**< Procedure header, for PSCALC_PROC objects */
+} PSCALC_SHAPE;
+
+typedef struct PSCALC_SHAPESTACK {
+  int32 top;
+  PSCALC_SHAPE obj[PSCALC_MAXSTACK];
+} PSCALC_SHAPESTACK;
+
+/**
+ * Limit on the iterations of "repeat" and "for" followed while checking the
+ * shape of a procedure.
+ */
+#define PSCALC_SHAPE_MAXLOOP 256
+
+static Bool pscalc_shape_run(PSCALC_OBJ *pso, PSCALC_SHAPESTACK *stack,
+                             PSCALC_OBJ *proc);
+
+/**
+ * Merge the stacks left by the two paths through a conditional. The stack
+ * layout must not depend on the path taken.
+ */
+static Bool pscalc_shape_merge(PSCALC_SHAPESTACK *stack,
+                               PSCALC_SHAPESTACK *other)
+{
+  int32 i;
+
+  if ( stack->top != other->top )
+    return FALSE;
+  for ( i = 0; i < stack->top; i++ ) {
+    PSCALC_SHAPE *s1 = &stack->obj[i], *s2 = &other->obj[i];
+
+    if ( s1->type != s2->type )
+      return FALSE;
+    if ( s1->type == PSCALC_PROC ) {
+      if ( s1->proc.val.range.starti != s2->proc.val.range.starti )
+        return FALSE;
+    }
+    s1->degree = max(s1->degree, s2->degree);
+    s1->known = s1->known && s2->known && s1->integer == s2->integer;
+  }
+  return TRUE;
+}
+
+/**
+ * Follow a single operator while checking the shape of a procedure.
+ */
+static Bool pscalc_shape_op(int32 opcode, PSCALC_OBJ *pso,
+                            PSCALC_SHAPESTACK *stack)
+{
+  PSCALC_SHAPE *op1 = stack->top < 1 ? NULL : &stack->obj[stack->top-1];
+  PSCALC_SHAPE *op2 = stack->top < 2 ? NULL : &stack->obj[stack->top-2];
+  PSCALC_SHAPE tmp;
+  int32 i, n, m;
+
+  if ( pscalc_opargs[opcode].nargs > stack->top )
+    return FALSE;
+
+  switch ( opcode ) {
+    case PSCALC_abs:
+    case PSCALC_neg:
+    case PSCALC_cvr:
+      op1->known = FALSE;
+      break;
+    case PSCALC_add:
+    case PSCALC_sub:
+      op2->degree = max(op1->degree, op2->degree);
+      op2->known = FALSE;
+      stack->top--;
+      break;
+    case PSCALC_mul:
+      op2->degree += op1->degree;
+      op2->known = FALSE;
+      stack->top--;
+      return op2->degree <= 1;
+    case PSCALC_div:
+      op2->known = FALSE;
+      stack->top--;
+      return op1->degree == 0;
+
+    /* Non-linear or discontinuous functions of their arguments. */
+    case PSCALC_atan:
+    case PSCALC_exp:
+    case PSCALC_idiv:
+    case PSCALC_mod:
+    case PSCALC_bitshift:
+      if ( op1->degree != 0 || op2->degree != 0 )
+        return FALSE;
+      op2->known = FALSE;
+      stack->top--;
+      break;
+    case PSCALC_ceiling:
+    case PSCALC_cos:
+    case PSCALC_cvi:
+    case PSCALC_floor:
+    case PSCALC_ln:
+    case PSCALC_log:
+    case PSCALC_round:
+    case PSCALC_sin:
+    case PSCALC_sqrt:
+    case PSCALC_truncate:
+      if ( op1->degree != 0 )
+        return FALSE;
+      op1->known = FALSE;
+      break;
+
+    /* Relational */
+    case PSCALC_and:
+    case PSCALC_or:
+    case PSCALC_xor:
+      if ( op1->type != PSCALC_BOOL &&
+           (op1->degree != 0 || op2->degree != 0) )
+        return FALSE;
+      op2->known = FALSE;
+      stack->top--;
+      break;
+    case PSCALC_not:
+      if ( op1->type != PSCALC_BOOL && op1->degree != 0 )
+        return FALSE;
+      op1->known = FALSE;
+      break;
+    case PSCALC_eq:
+    case PSCALC_ne:
+    case PSCALC_ge:
+    case PSCALC_gt:
+    case PSCALC_le:
+    case PSCALC_lt:
+      op2->type = PSCALC_BOOL;
+      op2->degree = 0;
+      op2->known = FALSE;
+      stack->top--;
+      break;
+    case PSCALC_false:
+    case PSCALC_true:
+      if ( stack->top >= PSCALC_MAXSTACK )
+        return FALSE;
+      op1 = &stack->obj[stack->top++];
+      op1->type = PSCALC_BOOL;
+      op1->degree = 0;
+      op1->known = FALSE;
+      break;
+
+    /* Conditional: follow both paths, and merge the results. */
+    case PSCALC_if:
+    case PSCALC_ifelse: {
+      PSCALC_SHAPESTACK other;
+      PSCALC_OBJ proc1, proc2;
+
+      if ( opcode == PSCALC_if ) {
+        if ( op1->type != PSCALC_PROC )
+          return FALSE;
+        proc1 = op1->proc;
+        stack->top -= 2;
+        other = *stack;
+      } else {
+        if ( stack->top < 3 || op1->type != PSCALC_PROC ||
+             op2->type != PSCALC_PROC )
+          return FALSE;
+        proc1 = op2->proc;
+        proc2 = op1->proc;
+        stack->top -= 3;
+        other = *stack;
+        if ( !pscalc_shape_run(pso, &other, &proc2) )
+          return FALSE;
+      }
+      if ( !pscalc_shape_run(pso, stack, &proc1) )
+        return FALSE;
+      return pscalc_shape_merge(stack, &other);
+    }
+    case PSCALC_repeat: {
+      PSCALC_OBJ proc;
+
+      if ( op1->type != PSCALC_PROC || !op2->known ||
+           op2->integer > PSCALC_SHAPE_MAXLOOP )
+        return FALSE;
+      proc = op1->proc;
+      n = op2->integer;
+      stack->top -= 2;
+      while ( n-- > 0 ) {
+        if ( !pscalc_shape_run(pso, stack, &proc) )
+          return FALSE;
+      }
+      break;
+    }
+    case PSCALC_exec: {
+      PSCALC_OBJ proc;
+
+      if ( op1->type != PSCALC_PROC )
+        return FALSE;
+      proc = op1->proc;
+      stack->top--;
+      return pscalc_shape_run(pso, stack, &proc);
+    }
+    case PSCALC_for: {
+      PSCALC_OBJ proc;
+      int32 f1, f2, f3;
+
+      if ( op1->type != PSCALC_PROC ||
+           !stack->obj[stack->top-4].known ||
+           !stack->obj[stack->top-3].known ||
+           !stack->obj[stack->top-2].known )
+        return FALSE;
+      f1 = stack->obj[stack->top-4].integer;
+      f2 = stack->obj[stack->top-3].integer;
+      f3 = stack->obj[stack->top-2].integer;
+      if ( f3 == 0 )
+        return FALSE;
+      proc = op1->proc;
+      stack->top -= 4;
+      for ( i = 0; (f3 > 0) ? (f1 <= f2) : (f1 >= f2); f1 += f3 ) {
+        if ( ++i > PSCALC_SHAPE_MAXLOOP || stack->top >= PSCALC_MAXSTACK )
+          return FALSE;
+        op1 = &stack->obj[stack->top++];
+        op1->type = PSCALC_REAL;
+        op1->degree = 0;
+        op1->known = TRUE;
+        op1->integer = f1;
+        if ( !pscalc_shape_run(pso, stack, &proc) )
+          return FALSE;
+      }
+      break;
+    }
+
+    /* Stack */
+    case PSCALC_copy:
+      if ( !op1->known || (n = op1->integer) < 0 )
+        return FALSE;
+      stack->top--;
+      if ( stack->top < n || stack->top + n >= PSCALC_MAXSTACK )
+        return FALSE;
+      for ( i = 0; i < n; i++ ) {
+        stack->obj[stack->top] = stack->obj[stack->top - n];
+        stack->top++;
+      }
+      break;
+    case PSCALC_dup:
+      if ( stack->top >= PSCALC_MAXSTACK )
+        return FALSE;
+      op1[1] = op1[0];
+      stack->top++;
+      break;
+    case PSCALC_exch:
+      tmp = *op1;
+      *op1 = *op2;
+      *op2 = tmp;
+      break;
+    case PSCALC_index:
+      if ( !op1->known || (n = op1->integer) < 0 || n >= stack->top - 1 )
+        return FALSE;
+      op1[0] = op1[-n-1];
+      break;
+    case PSCALC_pop:
+      stack->top--;
+      break;
+    case PSCALC_roll:
+      if ( !op1->known || !op2->known || (n = op2->integer) < 0 )
+        return FALSE;
+      m = op1->integer;
+      stack->top -= 2;
+      if ( stack->top < n )
+        return FALSE;
+      if ( n > 0 ) {
+        m %= n;
+        if ( m < 0 )
+          m += n;
+        while ( m-- > 0 ) {
+          tmp = stack->obj[stack->top - 1];
+          for ( i = stack->top - 1; i > stack->top - n; i-- )
+            stack->obj[i] = stack->obj[i-1];
+          stack->obj[stack->top - n] = tmp;
+        }
+      }
+      break;
+    default:
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * Follow a procedure, tracking how the values on the stack vary with the
+ * input, to see whether its outputs are piecewise linear in the input.
+ */
+static Bool pscalc_shape_run(PSCALC_OBJ *pso, PSCALC_SHAPESTACK *stack,
+                             PSCALC_OBJ *proc)
+{
+  int32 i, starti = proc->val.range.starti, endi = proc->val.range.endi;
+
+  for ( i = starti; i < endi; i++ ) {
+    PSCALC_OBJ *obj = pso+i;
+    PSCALC_SHAPE *shape;
+
+    if ( obj->type == PSCALC_OPERATOR ) {
+      if ( !pscalc_shape_op(obj->val.opcode, pso, stack) )
+        return FALSE;
+      continue;
+    }
+
+    if ( stack->top >= PSCALC_MAXSTACK )
+      return FALSE;
+    shape = &stack->obj[stack->top++];
+    shape->type = obj->type == PSCALC_INT ? PSCALC_REAL : obj->type;
+    shape->degree = 0;
+    shape->known = (obj->type == PSCALC_INT);
+    shape->integer = obj->val.integer;
+    if ( obj->type == PSCALC_PROC ) {
+      shape->proc = *obj;
+      i = obj->val.range.endi - 1;
+    }
+  }
+  return TRUE;
+}
+
+/**
+ * Attempt to sample a one-input PS-Calculator procedure into a lookup table.
+ *
+ * This is only done if the procedure's outputs are piecewise linear in its
+ * input: it uses nothing but additions, multiplications by constants,
+ * comparisons, conditionals and so on. The table is then checked by running
+ * the procedure at points between the table entries, and is rejected if
+ * interpolating the table differs from the procedure by more than
+ * \a tolerance at any of them.
+ *
+ * As with pscalc_create(), failure just returns NULL without raising an
+ * error, and the client carries on with pscalc_exec().
+ */
+PSCALC_LUT *pscalc_lut_create(PSCALC_OBJ *func, int32 n_out,
+                              USERVALUE lo, USERVALUE hi, USERVALUE tolerance)
+{
+  PSCALC_SHAPESTACK shapes;
+  PSCALC_LUT *lut;
+  USERVALUE grid[PSCALC_LUT_SIZE + 1];
+  USERVALUE *in[1], *out[PSCALC_LUT_MAXOUT];
+  USERVALUE step;
+  int32 i, o;
+
+  if ( func == NULL || n_out <= 0 || n_out > PSCALC_LUT_MAXOUT || hi <= lo )
+    return NULL;
+
+  shapes.top = 1;
+  shapes.obj[0].type = PSCALC_REAL;
+  shapes.obj[0].degree = 1;
+  shapes.obj[0].known = FALSE;
+  if ( !pscalc_shape_run(func, &shapes, func) || shapes.top != n_out )
+    return NULL;
+  for ( i = 0; i < n_out; i++ ) {
+    if ( shapes.obj[i].type != PSCALC_REAL )
+      return NULL;
+  }
+
+  lut = mm_alloc(mm_pool_temp, PSCALC_LUT_BYTES(n_out),
+                 MM_ALLOC_CLASS_FUNCTIONS);
+  if ( lut == NULL )
+    return NULL;
+
+  lut->n_out = n_out;
+  lut->lo = lo;
+  lut->scale = PSCALC_LUT_SIZE / (hi - lo);
+  lut->maxerr = 0.0f;
+
+  step = (hi - lo) / PSCALC_LUT_SIZE;
+  for ( i = 0; i <= PSCALC_LUT_SIZE; i++ )
+    grid[i] = lo + step * i;
+  grid[PSCALC_LUT_SIZE] = hi;
+
+  in[0] = grid;
+  for ( o = 0; o < n_out; o++ )
+    out[o] = lut->values + o * (PSCALC_LUT_SIZE + 1);
+  if ( pscalc_exec_block(func, 1, n_out, PSCALC_LUT_SIZE + 1,
+                         in, out) != PSCALC_noerr ) {
+    pscalc_lut_destroy(lut);
+    return NULL;
+  }
+
+  /* Check the quarter points of each interval, which between them catch a
+     breakpoint or step anywhere inside it. */
+  for ( i = 0; i < PSCALC_LUT_SIZE; i += PSCALC_LANES ) {
+    USERVALUE check[3 * PSCALC_LANES], result[PSCALC_LUT_MAXOUT][3 * PSCALC_LANES];
+    USERVALUE interp[PSCALC_LUT_MAXOUT];
+    int32 j, nchecks = 3 * min(PSCALC_LANES, PSCALC_LUT_SIZE - i);
+
+    for ( j = 0; j < nchecks; j++ )
+      check[j] = grid[i + j / 3] + step * (USERVALUE)(j % 3 + 1) * 0.25f;
+
+    in[0] = check;
+    for ( o = 0; o < n_out; o++ )
+      out[o] = result[o];
+    if ( pscalc_exec_block(func, 1, n_out, nchecks, in, out) != PSCALC_noerr ) {
+      pscalc_lut_destroy(lut);
+      return NULL;
+    }
+
+    for ( j = 0; j < nchecks; j++ ) {
+      pscalc_lut_lookup(lut, check[j], interp);
+      for ( o = 0; o < n_out; o++ ) {
+        USERVALUE err = (USERVALUE)fabs(interp[o] - result[o][j]);
+
+        if ( err > lut->maxerr )
+          lut->maxerr = err;
+      }
+    }
+    if ( lut->maxerr > tolerance ) {
+      pscalc_lut_destroy(lut);
+      return NULL;
+    }
+  }
+
+  return lut;
+}
+
+/**
+ * Free a PS-Calculator lookup table.
+ */
+void pscalc_lut_destroy(PSCALC_LUT *lut)
+{
+  if ( lut != NULL )
+    mm_free(mm_pool_temp, lut, PSCALC_LUT_BYTES(lut->n_out));
+}
+
+/**
+ * Interpolate a PS-Calculator lookup table. Inputs outside the sampled
+ * range are clipped to it.
+ */
+void pscalc_lut_lookup(PSCALC_LUT *lut, USERVALUE in, USERVALUE *out)
+{
+  USERVALUE x = (in - lut->lo) * lut->scale, frac;
+  USERVALUE *row = lut->values;
+  int32 i, o;
+
+  if ( x <= 0.0f ) {
+    i = 0;
+    frac = 0.0f;
+  } else if ( x >= PSCALC_LUT_SIZE ) {
+    i = PSCALC_LUT_SIZE - 1;
+    frac = 1.0f;
+  } else {
+    i = (int32)x;
+    frac = x - (USERVALUE)i;
+  }
+
+  for ( o = 0; o < lut->n_out; o++, row += PSCALC_LUT_SIZE + 1 )
+    out[o] = row[i] + frac * (row[i + 1] - row[i]);
+}
+
 /**
  * Add a PS procedure to our array of 'compiled' PS-Calculator objects.
  *
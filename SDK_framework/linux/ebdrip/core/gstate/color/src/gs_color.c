@@ -699,6 +699,63 @@ void gsc_copycolorinfo(GS_COLORinfo *dst, GS_COLORinfo *src)
   check_colorInfoHead(list);
 }
 
+/* gsc_sameColorInfo compares the chains and info structures that two
+ * colorInfos refer to, rather than their contents. The structures are
+ * copied on write once shared, so a colorInfo holding a claim on them (from
+ * gsc_copycolorinfo) keeps them unchanged. Identical references therefore
+ * give identical color state, though equivalent states made separately will
+ * compare different.
+ */
+Bool gsc_sameColorInfo(GS_COLORinfo *colorInfo1, GS_COLORinfo *colorInfo2)
+{
+  int32 nChain;
+
+  HQASSERT(colorInfo1 != NULL && colorInfo2 != NULL,
+           "gsc_sameColorInfo: colorInfo is NULL");
+
+  if ( colorInfo1 == colorInfo2 )
+    return TRUE;
+
+  for (nChain = 0; nChain < GSC_N_COLOR_TYPES; nChain++) {
+    if ( colorInfo1->chainInfo[nChain] != colorInfo2->chainInfo[nChain] ||
+         colorInfo1->chainCache[nChain] != colorInfo2->chainCache[nChain] )
+      return FALSE;
+  }
+
+  return (colorInfo1->deviceRS == colorInfo2->deviceRS &&
+          colorInfo1->targetRS == colorInfo2->targetRS &&
+          colorInfo1->crdInfo == colorInfo2->crdInfo &&
+          colorInfo1->rgbtocmykInfo == colorInfo2->rgbtocmykInfo &&
+          colorInfo1->transferInfo == colorInfo2->transferInfo &&
+          colorInfo1->calibrationInfo == colorInfo2->calibrationInfo &&
+          colorInfo1->halftoneInfo == colorInfo2->halftoneInfo &&
+          colorInfo1->hcmsInfo == colorInfo2->hcmsInfo &&
+          colorInfo1->devicecodeInfo == colorInfo2->devicecodeInfo &&
+          colorInfo1->colorState == colorInfo2->colorState &&
+          colorInfo1->params.convertAllSeparation ==
+            colorInfo2->params.convertAllSeparation &&
+          colorInfo1->params.enableColorCache ==
+            colorInfo2->params.enableColorCache &&
+          OBJECTS_IDENTICAL(colorInfo1->params.excludedSeparations,
+                            colorInfo2->params.excludedSeparations) &&
+          colorInfo1->params.photoshopInput ==
+            colorInfo2->params.photoshopInput &&
+          colorInfo1->params.adobeProcessSeparations ==
+            colorInfo2->params.adobeProcessSeparations &&
+          colorInfo1->params.useFastRGBToCMYK ==
+            colorInfo2->params.useFastRGBToCMYK &&
+          colorInfo1->params.rgbToCMYKMethod ==
+            colorInfo2->params.rgbToCMYKMethod &&
+          colorInfo1->gstate.opaqueNonStroke ==
+            colorInfo2->gstate.opaqueNonStroke &&
+          colorInfo1->gstate.opaqueStroke == colorInfo2->gstate.opaqueStroke &&
+          colorInfo1->gstate.halftonePhaseX ==
+            colorInfo2->gstate.halftonePhaseX &&
+          colorInfo1->gstate.halftonePhaseY ==
+            colorInfo2->gstate.halftonePhaseY &&
+          colorInfo1->gstate.screenRotate == colorInfo2->gstate.screenRotate);
+}
+
 Bool gsc_copycolorinfo_withstate(GS_COLORinfo *dst, GS_COLORinfo *src,
                                  COLOR_STATE *colorState)
 {
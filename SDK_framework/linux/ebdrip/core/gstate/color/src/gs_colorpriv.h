@@ -235,6 +235,7 @@ typedef struct CLINKcustomconversion {
   int32         n_oColorants;
   OBJECT        customprocedure;
   struct PSCALC_OBJ *pscalc_func;
+  struct PSCALC_LUT *pscalc_lut;
 } CLINKcustomconversion;
 
 struct CLINKblock {
@@ -23,6 +23,7 @@
 #include "monitor.h"            /* monitorf */
 #include "namedef_.h"           /* NAME_* */
 #include "swerrors.h"           /* error_handler */
+#include "hqmemcpy.h"
 #include "hqmemset.h"
 #include "timing.h"
 
@@ -33,9 +34,16 @@
 #include "gscparamspriv.h"      /* colorUserParams */
 #include "gsctintpriv.h"        /* cc_tinttransformiscomplex */
 #include "mlock.h"
+#include "hqspin.h"             /* spinlock_counter */
 #include "swtrace.h"
 #include "objnamer.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GST_SSE2 1
+#include <emmintrin.h>
+#endif
+
 
 /**
  * How many bits are allocated to the fractional part of the numbers coming in
@@ -206,6 +214,19 @@ MACRO_END
 #define DEBUG_DECREMENT(_num, _inc) MACRO_START MACRO_END
 #endif
 
+/* Hit and miss counts reported through the metrics. The counts in a table
+ * are only updated while the table is in use, which is serialised by
+ * gst_mutex for back end tables and by the interpreter thread for front end
+ * tables, so they don't need atomic updates. */
+#ifdef METRICS_BUILD
+#define METRIC_INCREMENT(_num, _inc)  \
+MACRO_START                           \
+  _num += _inc;                       \
+MACRO_END
+#else
+#define METRIC_INCREMENT(_num, _inc) MACRO_START MACRO_END
+#endif
+
 /*----------------------------------------------------------------------------*/
 typedef struct colorTableNd {
   int32         incomps ;       /* Dimension of input components (AFTER RCB TINT). */
@@ -270,6 +291,7 @@ typedef struct colorTableNd {
   /* Copies of values from CoreContext.page */
   int           fasterColorMethod;
   USERVALUE     fasterColorSmoothness;
+  Bool          fasterColorPrefill;
 
   mm_pool_t     mm_pool_table ; /* Memory pool used for cube/table allocations. */
   Bool purgeable; /* Any purgeable objects in the table? */
@@ -298,6 +320,13 @@ typedef struct colorTableNd {
   int32 nInterpolateError ;     /* Sum of interpolation errors */
 #endif
 
+#ifdef METRICS_BUILD
+  double nHits ;                /* Colors converted without visiting the color chain. */
+  double nMisses ;              /* Colors needing mini-cube corners to be found. */
+  int32 nPopulated ;            /* Grid points populated on demand. */
+  int32 nPrefilled ;            /* Grid points populated by gst_prefill(). */
+#endif
+
 } colorTableNd ;
 
 /*----------------------------------------------------------------------------*/
@@ -367,6 +396,9 @@ static inline void extractCorners_4(colorCubeNd *pcn,
                                     int32       *incIndices,
                                     COLORVALUE  **cols);
 static void checkIndices(colorTableNd *colorTable);
+static inline void gst_blendVertices(COLORVALUE *poColorValues, int32 oncomps,
+                                     COLORVALUE **verts, int32 *facs,
+                                     int32 nverts);
 static Bool gst_interpolate1( colorTableNd *colorTable ,
                               COLORVALUE *poColorValues ) ;
 static Bool gst_interpolate2( colorTableNd *colorTable ,
@@ -419,6 +451,9 @@ static Bool gst_getIndicesWithCache4C(colorTableNd *colorTable , int32 *piColorV
 
 static int32 maxTableIndex(COLOR_PAGE_PARAMS *colorPageParams);
 
+static Bool gst_prefill(colorTableNd *colorTable,
+                        GS_COLORinfo *colorInfo, int32 colorType);
+
 /*----------------------------------------------------------------------------*/
 
 
@@ -429,16 +464,45 @@ static struct gst_metrics {
   size_t gst_pool_max_size;
   int32 gst_pool_max_objects;
   size_t gst_pool_max_frag;
+  /* Counts over the whole job, which would overflow 32 bits. */
+  double gst_hits;
+  double gst_misses;
+  double gst_populated;
+  double gst_prefilled;
 } gst_metrics;
 
+/* Front end tables are destroyed without holding gst_mutex, so the job totals
+ * are updated under this spinlock instead. */
+static hq_atomic_counter_t gst_metrics_lock;
+
 static Bool gst_metrics_update(sw_metrics_group *metrics)
 {
+  struct gst_metrics totals;
+
+  spinlock_counter(&gst_metrics_lock, 1);
+  totals = gst_metrics;
+  spinunlock_counter(&gst_metrics_lock);
+
   if ( !sw_metrics_open_group(&metrics, METRIC_NAME_AND_LENGTH("MM")) ||
        !sw_metrics_open_group(&metrics, METRIC_NAME_AND_LENGTH("ColorTable")) )
     return FALSE;
-  SW_METRIC_INTEGER("PeakPoolSize", (int32)gst_metrics.gst_pool_max_size);
-  SW_METRIC_INTEGER("PeakPoolObjects", gst_metrics.gst_pool_max_objects);
-  SW_METRIC_INTEGER("PeakPoolFragmentation", (int32)gst_metrics.gst_pool_max_frag);
+  SW_METRIC_INTEGER("PeakPoolSize", (int32)totals.gst_pool_max_size);
+  SW_METRIC_INTEGER("PeakPoolObjects", totals.gst_pool_max_objects);
+  SW_METRIC_INTEGER("PeakPoolFragmentation", (int32)totals.gst_pool_max_frag);
+  sw_metrics_close_group(&metrics);
+  sw_metrics_close_group(&metrics);
+
+  if ( !sw_metrics_open_group(&metrics, METRIC_NAME_AND_LENGTH("Color")) ||
+       !sw_metrics_open_group(&metrics, METRIC_NAME_AND_LENGTH("TomsTables")) )
+    return FALSE;
+  SW_METRIC_FLOAT("Hits", (float)totals.gst_hits);
+  SW_METRIC_FLOAT("Misses", (float)totals.gst_misses);
+  if ( totals.gst_hits + totals.gst_misses > 0 )
+    SW_METRIC_FLOAT("HitRate",
+                    (float)(totals.gst_hits /
+                            (totals.gst_hits + totals.gst_misses)));
+  SW_METRIC_FLOAT("GridPointsPopulated", (float)totals.gst_populated);
+  SW_METRIC_FLOAT("GridPointsPrefilled", (float)totals.gst_prefilled);
   sw_metrics_close_group(&metrics);
   sw_metrics_close_group(&metrics);
   return TRUE;
@@ -448,7 +512,9 @@ static void gst_metrics_reset(int reason)
 {
   struct gst_metrics init = { 0 };
   UNUSED_PARAM(int, reason);
+  spinlock_counter(&gst_metrics_lock, 1);
   gst_metrics = init;
+  spinunlock_counter(&gst_metrics_lock);
 }
 
 static sw_metrics_callbacks gst_metrics_hook = {
@@ -672,6 +738,22 @@ GSC_TABLE *cc_createTomsTable(GS_COLORinfo *colorInfo, int32 colorType)
     break;
   }
 
+#ifdef METRICS_BUILD
+  colorTable->nHits = 0 ;
+  colorTable->nMisses = 0 ;
+  colorTable->nPopulated = 0 ;
+  colorTable->nPrefilled = 0 ;
+#endif
+
+  /* The table isn't visible to low memory handling yet, so the prefill
+   * doesn't have to worry about grid points being purged under it. */
+  if ( colorTable->fasterColorPrefill &&
+       !gst_prefill(colorTable, colorInfo, colorType) ) {
+    mm_free(mm_pool_color, cornerPtrsAlloc1, sizeof(ptrsEntry *));
+    gst_freeTable(&colorTable);
+    return NULL ;
+  }
+
 #ifdef GST_DEBUG_VARIABLES
   colorTable->nLookupHits = 0 ;
   colorTable->nLookupMisses = 0 ;
@@ -827,12 +909,20 @@ void cc_destroyTomsTable( GSC_TABLE *gst )
           all_max_frag = max_frag;
         tgst = tgst->next ;
       }
+
+      spinlock_counter(&gst_metrics_lock, 1);
       if (gst_metrics.gst_pool_max_size < total_max_size) {
         gst_metrics.gst_pool_max_size = total_max_size;
         gst_metrics.gst_pool_max_objects = total_max_objects;
       }
       if (gst_metrics.gst_pool_max_frag < all_max_frag)
         gst_metrics.gst_pool_max_frag = all_max_frag;
+
+      gst_metrics.gst_hits += colorTable->nHits;
+      gst_metrics.gst_misses += colorTable->nMisses;
+      gst_metrics.gst_populated += colorTable->nPopulated;
+      gst_metrics.gst_prefilled += colorTable->nPrefilled;
+      spinunlock_counter(&gst_metrics_lock);
     }
 #endif
 
@@ -1071,6 +1161,7 @@ static Bool do_tt_generic(colorTableNd *colorTable, GS_COLORinfo *colorInfo,
     if ( useLast ) {
       for (i = 0; i < oncomps; i ++)
         out[i] = out[i - oncomps];
+      METRIC_INCREMENT(colorTable->nHits, 1);
     } else {
       /* Calculate the indices required for the mini-cube, then go get
        * all the points in the mini-cube & interpolate.
@@ -1078,14 +1169,17 @@ static Bool do_tt_generic(colorTableNd *colorTable, GS_COLORinfo *colorInfo,
       if ( !(*gfunc)(colorTable, in) && !gst_iscachedColorN(colorTable, &ok) ) {
         if ( ok ) {
           DEBUG_INCREMENT(colorTable->nLookupMisses, 1);
+          METRIC_INCREMENT(colorTable->nMisses, 1);
 
           ok = gst_doColorN(colorTable, colorInfo, colorType, out);
         }
         if ( !ok )
           break;
       }
-      else
+      else {
         DEBUG_INCREMENT(colorTable->nLookupHits, 1);
+        METRIC_INCREMENT(colorTable->nHits, 1);
+      }
 
 #ifdef GST_EVAL_INT_ERROR
         if ( !gst_evaluateColorN(colorTable, colorInfo, colorType, in, out) ) {
@@ -1129,6 +1223,7 @@ static Bool do_tt_34tet4(colorTableNd *colorTable, GS_COLORinfo *colorInfo,
       out[1] = out[-3];
       out[2] = out[-2];
       out[3] = out[-1];
+      METRIC_INCREMENT(colorTable->nHits, 1);
     } else {
       int32 icrdiff, indicesHash, index, value, *indices, *fractns;
       uint32 indicesId;
@@ -1191,20 +1286,25 @@ static Bool do_tt_34tet4(colorTableNd *colorTable, GS_COLORinfo *colorInfo,
          * this code.
          */
         if ( !gst_iscachedColorN(colorTable, &ok) ) {
+          METRIC_INCREMENT(colorTable->nMisses, 1);
           if ( ok )
             ok = gst_doColorN(colorTable, colorInfo, colorType, out);
           if ( !ok )
             return FALSE;
         }
+        else
+          METRIC_INCREMENT(colorTable->nHits, 1);
         if ( colorTable->cornerPtrsCacheBits != 4 ) /* we have had a purge */
           return error_handler(VMERROR); /* fail and retry with generic version */
       }
+      else
+        METRIC_INCREMENT(colorTable->nHits, 1);
       {
-        COLORVALUE  *v1, *v2, *v3, *v4;
-        int32       fac1, fac2, fac3, fac4;
+        COLORVALUE  *v1, *v2, *v3, *v4, *verts[4];
+        int32       fac1, fac2, fac3, fac4, facs[4];
         int32       *fractns = colorTable->fractns;
         int32       xf = fractns[0], yf = fractns[1], zf = fractns[2];
-        uint32      a0, tetrahedron = 0;
+        uint32      tetrahedron = 0;
         COLORVALUE  **cp = colorTable->cornerPtrs;
 
         if ( xf >= yf )
@@ -1279,14 +1379,9 @@ static Bool do_tt_34tet4(colorTableNd *colorTable, GS_COLORinfo *colorInfo,
             HQFAIL("Unexpected tetrahedron");
             return FALSE;
         }
-        a0 = v1[ 3 ] * fac1 + v2[ 3 ] * fac2 + v3[ 3 ] * fac3 + v4[ 3 ] * fac4;
-        out[ 3 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-        a0 = v1[ 2 ] * fac1 + v2[ 2 ] * fac2 + v3[ 2 ] * fac3 + v4[ 2 ] * fac4;
-        out[ 2 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-        a0 = v1[ 1 ] * fac1 + v2[ 1 ] * fac2 + v3[ 1 ] * fac3 + v4[ 1 ] * fac4;
-        out[ 1 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-        a0 = v1[ 0 ] * fac1 + v2[ 0 ] * fac2 + v3[ 0 ] * fac3 + v4[ 0 ] * fac4;
-        out[ 0 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
+        verts[0] = v1; verts[1] = v2; verts[2] = v3; verts[3] = v4;
+        facs[0] = fac1; facs[1] = fac2; facs[2] = fac3; facs[3] = fac4;
+        gst_blendVertices(out, 4, verts, facs, 4);
       }
     }
     last = in;
@@ -2188,6 +2283,7 @@ static Bool gst_populateColorN( colorTableNd *colorTable ,
   HQASSERT( valid , "valid NULL in gst_populateColorN" ) ;
 
   DEBUG_INCREMENT(colorTable->nPopulate, 1) ;
+  METRIC_INCREMENT(colorTable->nPopulated, 1) ;
 
   if (*color == NULL) {
     *color = gst_allocColorN( colorTable, colorTable->oncomps ) ;
@@ -2211,6 +2307,107 @@ static Bool gst_populateColorN( colorTableNd *colorTable ,
   return TRUE ;
 }
 
+/**
+ * This routine populates every grid point of a new table when the
+ * FasterColorPrefill userparam is set, rather than leaving them to be
+ * populated one at a time as the table is used. Each 1d array of grid points
+ * is converted by a single call to the color chain. Only tables with up to 4
+ * input components are filled; larger tables are too big and are sparsely
+ * used. Running out of memory is not an error, the remaining grid points are
+ * just populated on demand as usual.
+ */
+static Bool gst_prefill(colorTableNd *colorTable,
+                        GS_COLORinfo *colorInfo, int32 colorType)
+{
+  int32 incomps = colorTable->incomps;
+  int32 oncomps = colorTable->oncomps;
+  int32 cubeSide = colorTable->cubeSide;
+  int32 indices[4] = { 0 };
+  size_t inputSize, outputSize;
+  float *inputColors;
+  COLORVALUE *outputColors;
+  Bool ok = TRUE;
+
+  HQASSERT(colorInfo, "colorInfo NULL in gst_prefill");
+  HQASSERT(cubeSide <= GSC_BLOCK_MAXCOLORS, "cubeSide too big for a block");
+
+  if ( incomps > 4 )
+    return TRUE;
+
+  inputSize = cubeSide * incomps * sizeof(float);
+  outputSize = cubeSide * oncomps * sizeof(COLORVALUE);
+  inputColors = mm_alloc(mm_pool_color, inputSize, MM_ALLOC_CLASS_COLOR_TABLE);
+  outputColors = mm_alloc(mm_pool_color, outputSize, MM_ALLOC_CLASS_COLOR_TABLE);
+
+  if ( inputColors != NULL && outputColors != NULL ) {
+    float *rangeb = colorTable->rangeb;
+    float *ranges = colorTable->ranges;
+
+    for (;;) {
+      colorNd **pcolor;
+      validMask *valid;
+      int32 i, j;
+
+      if ( !gst_getColorN(colorTable, indices, &pcolor, &valid) ) {
+        ok = FALSE;
+        break;
+      }
+
+      for (i = 0; i < cubeSide; i++) {
+        float *inputColor = &inputColors[i * incomps];
+
+        inputColor[0] = rangeb[0] + ranges[0] * i;
+        for (j = 1; j < incomps; j++)
+          inputColor[j] = rangeb[j] + ranges[j] * indices[j];
+      }
+
+      if ( !gsc_invokeChainBlock(colorInfo, colorType,
+                                 inputColors, outputColors, cubeSide) ) {
+        ok = FALSE;
+        break;
+      }
+
+      for (i = 0; i < cubeSide && ok; i++) {
+        if ( pcolor[i] == NULL ) {
+          pcolor[i] = gst_allocColorN(colorTable, oncomps);
+          if ( pcolor[i] == NULL ) {
+            ok = FALSE;
+            break;
+          }
+        }
+        HqMemCpy(pcolor[i]->color, &outputColors[i * oncomps],
+                 oncomps * sizeof(COLORVALUE));
+        valid[i] |= GST_COLOR_PRESENT;
+        METRIC_INCREMENT(colorTable->nPrefilled, 1);
+      }
+      if ( !ok )
+        break;
+
+      /* Move on to the next 1d array, counting through the higher
+         dimensions. */
+      for (j = SOLID_DIMS; j < incomps; j++) {
+        if ( ++indices[j] < cubeSide )
+          break;
+        indices[j] = 0;
+      }
+      if ( j == incomps )
+        break;
+    }
+  }
+
+  if ( outputColors != NULL )
+    mm_free(mm_pool_color, outputColors, outputSize);
+  if ( inputColors != NULL )
+    mm_free(mm_pool_color, inputColors, inputSize);
+
+  if ( !ok && error_latest() == VMERROR ) {
+    error_clear();
+    ok = TRUE;
+  }
+
+  return ok;
+}
+
 /**
  * This routine evaluates the centre of a mini-cube to see if interpolation
  * is valid at that point. Uses gsc_invokeChainBlock for the evaluation.
@@ -2460,6 +2657,72 @@ static void checkIndices(colorTableNd *colorTable)
   UNUSED_PARAM(colorTableNd *, colorTable);
 }
 
+/*----------------------------------------------------------------------------*/
+/**
+ * Weighted sum of the vertices of a tetrahedron (or its equivalent in other
+ * dimensions), as used by all of the tetrahedral interpolators. The weights
+ * sum to 1 << GST_IFRACBITS, so the sum of each component is rounded back down
+ * to a COLORVALUE.
+ *
+ * With SSE2, four output components are done at a time. Two vertices share
+ * a register, and their components are multiplied by the weights in 16 bits,
+ * keeping both halves of the 32 bit products; the result is identical to the
+ * scalar sum.
+ */
+static inline void gst_blendVertices(COLORVALUE *poColorValues, int32 oncomps,
+                                     COLORVALUE **verts, int32 *facs,
+                                     int32 nverts)
+{
+  int32 i = 0, j;
+
+  HQASSERT(nverts > 1 && nverts <= 5, "Unexpected number of vertices");
+
+#ifdef GST_SSE2
+  {
+    const __m128i round = _mm_set1_epi32(GST_IFRACADDN);
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+
+    for ( ; i + 4 <= oncomps; i += 4 ) {
+      __m128i sum = round;
+
+      for ( j = 0; j < nverts; j += 2 ) {
+        __m128i pair, weights, lo, hi;
+
+        pair = _mm_loadl_epi64((const __m128i *)&verts[j][i]);
+        weights = _mm_set1_epi16((short)facs[j]);
+        if ( j + 1 < nverts ) {
+          pair = _mm_unpacklo_epi64(pair,
+                   _mm_loadl_epi64((const __m128i *)&verts[j + 1][i]));
+          weights = _mm_unpacklo_epi64(weights,
+                                       _mm_set1_epi16((short)facs[j + 1]));
+        }
+        lo = _mm_mullo_epi16(pair, weights);
+        hi = _mm_mulhi_epu16(pair, weights);
+        sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(lo, hi));
+        if ( j + 1 < nverts )
+          sum = _mm_add_epi32(sum, _mm_unpackhi_epi16(lo, hi));
+      }
+
+      /* The rounded sums fit in 16 bits unsigned; bias them to pack with
+         signed saturation. */
+      sum = _mm_srli_epi32(sum, GST_IFRACBITS);
+      sum = _mm_sub_epi32(sum, bias32);
+      sum = _mm_add_epi16(_mm_packs_epi32(sum, sum), bias16);
+      _mm_storel_epi64((__m128i *)&poColorValues[i], sum);
+    }
+  }
+#endif /* GST_SSE2 */
+
+  for ( ; i < oncomps; ++i ) {
+    uint32 a0 = 0;
+
+    for ( j = 0; j < nverts; ++j )
+      a0 += verts[j][i] * facs[j];
+    poColorValues[i] = CAST_TO_COLORVALUE(GST_ROUND(a0));
+  }
+}
+
 /*----------------------------------------------------------------------------*/
 /**
  * These routines interpolate a mini-cube. Common cases of 1-4 input
@@ -2567,7 +2830,7 @@ static Bool gst_interpolate2( colorTableNd *colorTable ,
 static Bool gst_interpolate2_tetrahedral( colorTableNd *colorTable ,
                                           COLORVALUE *poColorValues )
 {
-  int32       n ;
+  COLORVALUE  *verts[3] ;
   COLORVALUE  *v1 ;
   COLORVALUE  *v2 ;
   COLORVALUE  *v3 ;
@@ -2577,7 +2840,7 @@ static Bool gst_interpolate2_tetrahedral( colorTableNd *colorTable ,
   int32       *fractns = colorTable->fractns ;
   int32       xf = fractns[ 0 ] ;
   int32       yf = fractns[ 1 ] ;
-  uint32      a0 ;
+  int32       facs[3] ;
 
   uint32 tetrahedron = 0 ;
 
@@ -2628,34 +2891,9 @@ static Bool gst_interpolate2_tetrahedral( colorTableNd *colorTable ,
     return FALSE;
   }
 
-  n = colorTable->oncomps;
-  for (;;) {
-    switch (n) {
-    default:
-    case 4:
-      a0 = v1[ 3 ] * fac1 + v2[ 3 ] * fac2 + v3[ 3 ] * fac3 ;
-      poColorValues[ 3 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    case 3:
-      a0 = v1[ 2 ] * fac1 + v2[ 2 ] * fac2 + v3[ 2 ] * fac3 ;
-      poColorValues[ 2 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    case 2:
-      a0 = v1[ 1 ] * fac1 + v2[ 1 ] * fac2 + v3[ 1 ] * fac3 ;
-      poColorValues[ 1 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    case 1:
-      a0 = v1[ 0 ] * fac1 + v2[ 0 ] * fac2 + v3[ 0 ] * fac3 ;
-      poColorValues[ 0 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    }
-
-    n -= 4;
-    if (n > 0) {
-      v1 += 4;
-      v2 += 4;
-      v3 += 4;
-      poColorValues += 4;
-    }
-    else
-      break;
-  }
+  verts[0] = v1; verts[1] = v2; verts[2] = v3;
+  facs[0] = fac1; facs[1] = fac2; facs[2] = fac3;
+  gst_blendVertices(poColorValues, colorTable->oncomps, verts, facs, 3);
 
   return TRUE;
 }
@@ -2718,7 +2956,7 @@ static Bool gst_interpolate3_cubic( colorTableNd *colorTable ,
 static Bool gst_interpolate3_tetrahedral( colorTableNd *colorTable ,
                                           COLORVALUE *poColorValues )
 {
-  int32       n ;
+  COLORVALUE  *verts[4] ;
   COLORVALUE  *v1 ;
   COLORVALUE  *v2 ;
   COLORVALUE  *v3 ;
@@ -2731,7 +2969,7 @@ static Bool gst_interpolate3_tetrahedral( colorTableNd *colorTable ,
   int32       xf = fractns[ 0 ] ;
   int32       yf = fractns[ 1 ] ;
   int32       zf = fractns[ 2 ] ;
-  uint32      a0 ;
+  int32       facs[4] ;
 
   uint32 tetrahedron = 0 ;
 
@@ -2808,35 +3046,9 @@ static Bool gst_interpolate3_tetrahedral( colorTableNd *colorTable ,
     return FALSE;
   }
 
-  n = colorTable->oncomps;
-  for (;;) {
-    switch (n) {
-    default:
-    case 4:
-      a0 = v1[ 3 ] * fac1 + v2[ 3 ] * fac2 + v3[ 3 ] * fac3 + v4[ 3 ] * fac4 ;
-      poColorValues[ 3 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    case 3:
-      a0 = v1[ 2 ] * fac1 + v2[ 2 ] * fac2 + v3[ 2 ] * fac3 + v4[ 2 ] * fac4 ;
-      poColorValues[ 2 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    case 2:
-      a0 = v1[ 1 ] * fac1 + v2[ 1 ] * fac2 + v3[ 1 ] * fac3 + v4[ 1 ] * fac4 ;
-      poColorValues[ 1 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    case 1:
-      a0 = v1[ 0 ] * fac1 + v2[ 0 ] * fac2 + v3[ 0 ] * fac3 + v4[ 0 ] * fac4 ;
-      poColorValues[ 0 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    }
-
-    n -= 4;
-    if (n > 0) {
-      v1 += 4;
-      v2 += 4;
-      v3 += 4;
-      v4 += 4;
-      poColorValues += 4;
-    }
-    else
-      break;
-  }
+  verts[0] = v1; verts[1] = v2; verts[2] = v3; verts[3] = v4;
+  facs[0] = fac1; facs[1] = fac2; facs[2] = fac3; facs[3] = fac4;
+  gst_blendVertices(poColorValues, colorTable->oncomps, verts, facs, 4);
 
   return TRUE;
 }
@@ -2910,7 +3122,7 @@ static Bool gst_interpolate4_cubic( colorTableNd *colorTable ,
 static Bool gst_interpolate4_tetrahedral( colorTableNd *colorTable ,
                                           COLORVALUE *poColorValues )
 {
-  int32       n ;
+  COLORVALUE  *verts[5] ;
   COLORVALUE  *v1 ;
   COLORVALUE  *v2 ;
   COLORVALUE  *v3 ;
@@ -2926,7 +3138,7 @@ static Bool gst_interpolate4_tetrahedral( colorTableNd *colorTable ,
   int32       xf = fractns[ 1 ] ;
   int32       yf = fractns[ 2 ] ;
   int32       zf = fractns[ 3 ] ;
-  uint32      a0 ;
+  int32       facs[5] ;
 
   uint32 tetrahedron = 0 ;
 
@@ -3100,36 +3312,9 @@ static Bool gst_interpolate4_tetrahedral( colorTableNd *colorTable ,
     return FALSE;
   }
 
-  n = colorTable->oncomps;
-  for (;;) {
-    switch (n) {
-    default:
-    case 4:
-      a0 = v1[ 3 ] * fac1 + v2[ 3 ] * fac2 + v3[ 3 ] * fac3 + v4[ 3 ] * fac4 + v5[ 3 ] * fac5;
-      poColorValues[ 3 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    case 3:
-      a0 = v1[ 2 ] * fac1 + v2[ 2 ] * fac2 + v3[ 2 ] * fac3 + v4[ 2 ] * fac4 + v5[ 2 ] * fac5;
-      poColorValues[ 2 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    case 2:
-      a0 = v1[ 1 ] * fac1 + v2[ 1 ] * fac2 + v3[ 1 ] * fac3 + v4[ 1 ] * fac4 + v5[ 1 ] * fac5;
-      poColorValues[ 1 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    case 1:
-      a0 = v1[ 0 ] * fac1 + v2[ 0 ] * fac2 + v3[ 0 ] * fac3 + v4[ 0 ] * fac4 + v5[ 0 ] * fac5;
-      poColorValues[ 0 ] = CAST_TO_COLORVALUE(GST_ROUND(a0));
-    }
-
-    n -= 4;
-    if (n > 0) {
-      v1 += 4;
-      v2 += 4;
-      v3 += 4;
-      v4 += 4;
-      v5 += 4;
-      poColorValues += 4;
-    }
-    else
-      break;
-  }
+  verts[0] = v1; verts[1] = v2; verts[2] = v3; verts[3] = v4; verts[4] = v5;
+  facs[0] = fac1; facs[1] = fac2; facs[2] = fac3; facs[3] = fac4; facs[4] = fac5;
+  gst_blendVertices(poColorValues, colorTable->oncomps, verts, facs, 5);
 
   return TRUE;
 }
@@ -3595,6 +3780,7 @@ static colorTableNd *gst_allocTable( int32 incomps , int32 oncomps )
   /* Copies of params from the current page to avoid TLS access */
   colorTable->fasterColorMethod = colorPageParams->fasterColorMethod;
   colorTable->fasterColorSmoothness = colorPageParams->fasterColorSmoothness;
+  colorTable->fasterColorPrefill = colorPageParams->fasterColorPrefill;
 
   colorTable->incomps = incomps ;
   colorTable->oncomps = oncomps ;
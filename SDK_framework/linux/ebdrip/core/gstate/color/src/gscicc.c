@@ -43,6 +43,7 @@
 #include "icmini.h"             /* DATA_ACTION */
 
 #include "gsciccpriv.h"
+#include "gscicccache.h"        /* icc_xform_cache_restore */
 
 struct ps_context_t;
 
@@ -3644,6 +3645,11 @@ Bool cc_iccbased_init(void)
     mps_root_destroy(ICCCacheRoot);
     return FALSE;
   }
+  if ( !icc_xform_cache_init() ) {
+    low_mem_handler_deregister(&gsc_profile_handler);
+    mps_root_destroy(ICCCacheRoot);
+    return FALSE;
+  }
   return TRUE;
 }
 
@@ -3670,6 +3676,7 @@ void cc_iccbased_finish(void)
       profile_discard(frontEndColorState, frontEndColorState->ICC_cacheHead->d, TRUE);
     }
   }
+  icc_xform_cache_finish();
   low_mem_handler_deregister(&gsc_profile_handler);
   if (ICCCacheRoot) {
     mps_root_destroy( ICCCacheRoot );
@@ -5323,6 +5330,7 @@ static CLINKiccbased* get_iccbasedLink( ICC_PROFILE_INFO *pInfo,
   int32 outputType = OUTPUT_NONE;
   int32 inputType = INPUT_NONE;
   uint8 intentUsed;
+  Bool restored;
 
   HQASSERT( pInfo != NULL, "pInfo is NULL in get_iccbasedLink");
   HQASSERT( pInfo->n_device_colors > 0, "Invalid info in get_iccbasedLink" );
@@ -5363,12 +5371,9 @@ static CLINKiccbased* get_iccbasedLink( ICC_PROFILE_INFO *pInfo,
   if ( !set_icc_file( pInfo->filelist_head, pInfo->filelist_head->file ))
     goto tidyup;
 
-  /* Now get more info from the profile */
-  if ( !readTags( pInfo->filelist_head->file, &num_tags, &tags ))
-    goto tidyup;
-
-  /* Fill in the relative white and black points in the cache structure */
-  if ( !get_rel_white_black_info( pInfo, num_tags, tags ))
+  /* The persistent transform cache is keyed by the whole profile MD5 */
+  if ( icc_xform_cache_enabled() && !pInfo->validMD5 &&
+       !calculate_profile_MD5_from_profile_info(pInfo, FALSE) )
     goto tidyup;
 
   /* All OK so far so allocate the CLINKiccbased */
@@ -5398,6 +5403,23 @@ static CLINKiccbased* get_iccbasedLink( ICC_PROFILE_INFO *pInfo,
     pIccBasedInfo->o_dimensions = pInfo->n_device_colors;
   }
 
+  /* If the transform was built in an earlier job or RIP session, there is no
+   * need to read the profile tags again.
+   */
+  if ( !icc_xform_cache_restore( pInfo, isOutput, desiredIntent,
+                                 &pIccBasedInfo, &restored ))
+    goto tidyup;
+  if ( restored )
+    goto finished;
+
+  /* Now get more info from the profile */
+  if ( !readTags( pInfo->filelist_head->file, &num_tags, &tags ))
+    goto tidyup;
+
+  /* Fill in the relative white and black points in the cache structure */
+  if ( !get_rel_white_black_info( pInfo, num_tags, tags ))
+    goto tidyup;
+
   /* Find out what type of scalings to apply before and after the icc profile
    * transforms.  Output profiles also need an inital scaling to the range
    * [0-1] before the first invoke.
@@ -5546,6 +5568,9 @@ static CLINKiccbased* get_iccbasedLink( ICC_PROFILE_INFO *pInfo,
       goto tidyup;
   }
 
+  icc_xform_cache_save( pInfo, isOutput, desiredIntent, pIccBasedInfo );
+
+finished:
   iccbasedInfoAssertions( pIccBasedInfo );
 
   /* For the moment, we are filling the desired slot with a table that may not be
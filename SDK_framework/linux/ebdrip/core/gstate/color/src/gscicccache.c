@@ -0,0 +1,1059 @@
+/** \file
+ * \ingroup color
+ *
+ * $HopeName: COREgstate!color:src:gscicccache.c(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * Persistent cache of ICC transforms.
+ *
+ * Building the CLINKiccbased for an ICC profile means reading and unpacking
+ * its tags, curves and CLUTs, which is a noticeable part of the time taken
+ * by the first page of a job. When the ICCTransformCache system param is
+ * set, each transform built is also saved to a cache file on the %os%
+ * device, and the whole file is read back when the param is next set, so
+ * the transforms for commonly used profiles are ready from startup. The
+ * cache survives RIP restarts, but is only used by the interpreter thread.
+ *
+ * A transform is keyed by the profile MD5, whether it is an input or output
+ * transform, and the intent slot it was built for. The colorspaces and
+ * number of colors of the profile are also part of the key, which covers
+ * the colorant set, since NCLR colorants come from the profile itself.
+ * Color chains and the color cache depend on the rest of the gstate as
+ * well as the profile, so they are not saved.
+ *
+ * The cache file is a sequence of records, each a header of 4 byte words,
+ * least significant byte first, followed by a body. The body holds the
+ * relative white and black points of the profile, then for each
+ * mini-invoke its ICCX_ function code, the size of its data and the data
+ * itself, padded to ICCX_ALIGN bytes. Data is stored in native layout,
+ * so the header records the layout and records from another build are
+ * ignored. Pointers in the data are rebuilt when a transform is restored.
+ *
+ * Record bodies are kept in the color pool, and can be discarded in low
+ * memory, in which case they are read back from the file when next used.
+ */
+
+#include "core.h"
+
+#include "swdevice.h"           /* DEVICELIST */
+#include "devices.h"            /* find_device */
+#include "hq32x2.h"             /* Hq32x2 */
+#include "hqmemcpy.h"           /* HqMemCpy */
+#include "hqmemset.h"           /* HqMemZero */
+#include "lowmem.h"             /* low_mem_handler_t */
+#include "mm.h"                 /* mm_alloc */
+#include "mm_core.h"            /* mm_pool_color */
+#include "objecth.h"            /* OBJECT */
+#include "swerrors.h"           /* VMERROR */
+
+#include "gs_colorpriv.h"       /* CLINK */
+#include "icmini.h"             /* CLINKiccbased */
+#include "gscicccache.h"
+
+/** Identifies a cache record. */
+#define ICCX_MAGIC        0x58434349u
+
+/** Version of the record layout. Records with other versions are ignored. */
+#define ICCX_VERSION      1
+
+/** Name of the cache file on the %os% device. */
+#define ICCX_FILENAME     "iccxform.icx"
+
+/** Alignment of mini-invoke data in a record body. */
+#define ICCX_ALIGN        8
+
+/** Limits on the size of a record and of the whole file. */
+#define ICCX_MAX_BODY     (16 << 20)
+#define ICCX_MAX_FILE     (64 << 20)
+#define ICCX_MAX_ACTIONS  64
+
+/** Bytes before each mini-invoke's data in a record body. */
+#define ICCX_ACTION_BYTES 8
+
+/** Bytes of the white and black points at the start of a record body. */
+#define ICCX_POINTS_BYTES (2 * sizeof(XYZVALUE))
+
+/** Words in a record header. The words from ICCX_MD5_0 to ICCX_PCS_COLORS
+    inclusive are the key of the transform. */
+enum {
+  ICCX_MAGIC_WORD,
+  ICCX_VERSION_WORD,
+  ICCX_LAYOUT,        /**< Native layout of the body. */
+  ICCX_MD5_0,         /**< Profile MD5. */
+  ICCX_MD5_1,
+  ICCX_MD5_2,
+  ICCX_MD5_3,
+  ICCX_SLOT,          /**< Intent slot, plus ICCX_OUTPUT for output. */
+  ICCX_CLASS,         /**< Profile device class. */
+  ICCX_DEVICE_SPACE,
+  ICCX_PCS_SPACE,
+  ICCX_DEVICE_COLORS,
+  ICCX_PCS_COLORS,
+  ICCX_INTENT,        /**< Intent actually used. */
+  ICCX_I_SPACE,       /**< Colorspaces and dimensions of the transform. */
+  ICCX_O_SPACE,
+  ICCX_I_DIMENSIONS,
+  ICCX_O_DIMENSIONS,
+  ICCX_NACTIONS,
+  ICCX_BODY_BYTES,
+  ICCX_CHECKSUM,      /**< Adler-32 of the rest of the header and the body. */
+  ICCX_HEADER_WORDS
+} ;
+
+#define ICCX_HEADER_BYTES (ICCX_HEADER_WORDS * 4)
+
+#define ICCX_OUTPUT 0x100u
+
+/** Function codes of the mini-invokes that can be saved. The order is part
+    of the record layout. */
+enum {
+  ICCX_PIECEWISE_LINEAR,
+  ICCX_INVERSE_LINEAR,
+  ICCX_PARAMETRIC,
+  ICCX_INVERSE_PARAMETRIC,
+  ICCX_FLIP,
+  ICCX_SCALE,
+  ICCX_MATRIX,
+  ICCX_MULTIPLY,
+  ICCX_NEUTRAL_AB,
+  ICCX_CLUT16,
+  ICCX_CLUT8,
+  ICCX_XYZ2XYZ,
+  ICCX_LAB2XYZ,
+  ICCX_XYZ2LAB,
+  ICCX_NFUNCTIONS
+} ;
+
+static MINI_INVOKE const iccx_functions[ICCX_NFUNCTIONS] = {
+  mi_piecewise_linear,
+  mi_inverse_linear,
+  mi_parametric,
+  mi_inverse_parametric,
+  mi_flip,
+  mi_scale,
+  mi_matrix,
+  mi_multiply,
+  mi_neutral_ab,
+  mi_clut16,
+  mi_clut8,
+  mi_xyz2xyz,
+  mi_lab2xyz,
+  mi_xyz2lab
+} ;
+
+/** A transform in the cache. */
+typedef struct ICCX_ENTRY {
+  struct ICCX_ENTRY *next;
+  uint32 header[ICCX_HEADER_WORDS];
+  int32  offset;    /**< File offset of the record, or -1 if not saved. */
+  uint8  *body;     /**< Record body, or NULL if discarded. */
+  uint32 lastUsed;  /**< Value of iccx_clock when last restored. */
+} ICCX_ENTRY;
+
+static Bool iccx_enabled;
+static Bool iccx_loaded;
+static ICCX_ENTRY *iccx_entries;
+static int32 iccx_filesize;
+static uint32 iccx_clock;
+
+
+static void iccx_put(uint8 *p, uint32 value)
+{
+  p[0] = (uint8)value;
+  p[1] = (uint8)(value >> 8);
+  p[2] = (uint8)(value >> 16);
+  p[3] = (uint8)(value >> 24);
+}
+
+static uint32 iccx_get(const uint8 *p)
+{
+  return (uint32)p[0] | ((uint32)p[1] << 8) |
+         ((uint32)p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static uint32 iccx_adler(uint32 adler, const uint8 *p, int32 len)
+{
+  uint32 a = adler & 0xffff, b = adler >> 16;
+
+  while ( len > 0 ) {
+    /* 5552 is the most bytes that can be summed before b overflows. */
+    int32 n = len < 5552 ? len : 5552;
+
+    len -= n;
+    while ( --n >= 0 ) {
+      a += *p++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+
+  return (b << 16) | a;
+}
+
+/** Checksum of a record, given its header words and body. */
+static uint32 iccx_checksum(const uint32 header[ICCX_HEADER_WORDS],
+                            const uint8 *body)
+{
+  uint8 head[ICCX_HEADER_BYTES];
+  int32 i;
+
+  for ( i = 0; i < ICCX_CHECKSUM; ++i )
+    iccx_put(head + i * 4, header[i]);
+
+  return iccx_adler(iccx_adler(1, head, ICCX_CHECKSUM * 4),
+                    body, (int32)header[ICCX_BODY_BYTES]);
+}
+
+/** A word describing the native layout of record bodies. */
+static uint32 iccx_layout(void)
+{
+  uint32 layout = (uint32)(sizeof(ICVALUE) | (sizeof(void *) << 4) |
+                           (sizeof(USERVALUE) << 8) |
+                           (sizeof(SYSTEMVALUE) << 12) |
+                           (offsetof(MI_CLUT16, values[0]) << 16));
+#ifdef highbytefirst
+  layout |= 0x80000000u;
+#endif
+  return layout;
+}
+
+static size_t iccx_align(size_t size)
+{
+  return (size + ICCX_ALIGN - 1) & ~(size_t)(ICCX_ALIGN - 1);
+}
+
+static uint32 iccx_bits(uint32 mask)
+{
+  uint32 n = 0;
+
+  for ( ; mask != 0; mask &= mask - 1 )
+    ++n;
+  return n;
+}
+
+/** Fill in the key words of a record header for a profile and slot.
+    Returns FALSE if the profile has no MD5. */
+static Bool iccx_key(ICC_PROFILE_INFO *pInfo, Bool isOutput,
+                     uint8 desiredIntent, uint32 header[ICCX_HEADER_WORDS])
+{
+  int32 i;
+
+  if ( !pInfo->validMD5 )
+    return FALSE;
+
+  for ( i = 0; i < 4; ++i )
+    header[ICCX_MD5_0 + i] = iccx_get(&pInfo->md5[i * 4]);
+  header[ICCX_SLOT] = desiredIntent | (isOutput ? ICCX_OUTPUT : 0u);
+  header[ICCX_CLASS] = (uint32)pInfo->deviceClass;
+  header[ICCX_DEVICE_SPACE] = (uint32)pInfo->devicespace;
+  header[ICCX_PCS_SPACE] = (uint32)pInfo->pcsspace;
+  header[ICCX_DEVICE_COLORS] = (uint32)pInfo->n_device_colors;
+  header[ICCX_PCS_COLORS] = (uint32)pInfo->n_pcs_colors;
+
+  return TRUE;
+}
+
+static ICCX_ENTRY *iccx_find(const uint32 key[ICCX_HEADER_WORDS])
+{
+  ICCX_ENTRY *entry;
+  int32 i;
+
+  for ( entry = iccx_entries; entry != NULL; entry = entry->next ) {
+    for ( i = ICCX_MD5_0; i <= ICCX_PCS_COLORS; ++i ) {
+      if ( entry->header[i] != key[i] )
+        break;
+    }
+    if ( i > ICCX_PCS_COLORS )
+      return entry;
+  }
+  return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/** Find the function code and data size of a mini-invoke. Returns FALSE if
+    it cannot be saved. */
+static Bool iccx_action_size(DATA_ACTION *action, uint32 *code, size_t *size)
+{
+  uint32 i, n;
+
+  for ( i = 0; i < ICCX_NFUNCTIONS; ++i ) {
+    if ( action->function == iccx_functions[i] )
+      break;
+  }
+  if ( i == ICCX_NFUNCTIONS )
+    return FALSE;
+
+  switch ( i ) {
+  case ICCX_PIECEWISE_LINEAR:
+  case ICCX_INVERSE_LINEAR: {
+    DATA_PIECEWISE_LINEAR *curve = &action->u.piecewise_linear->curves[0];
+
+    *size = MI_PIECEWISE_LINEAR_SIZE;
+    for ( n = iccx_bits(action->u.piecewise_linear->channelmask);
+          n > 0; --n ) {
+      HQASSERT((uint8 *)curve ==
+               (uint8 *)action->u.piecewise_linear + *size,
+               "Piecewise linear curves are not contiguous");
+      *size += DATA_PIECEWISE_LINEAR_SIZE(curve->maxindex + 1);
+      curve = curve->next;
+    }
+    break;
+  }
+  case ICCX_PARAMETRIC:
+    *size = MI_PARAMETRIC_SIZE(iccx_bits(action->u.parametric->channelmask));
+    break;
+  case ICCX_INVERSE_PARAMETRIC:
+    *size = MI_INVERSE_PARAMETRIC_SIZE(
+              iccx_bits(action->u.inverse_parametric->channelmask));
+    break;
+  case ICCX_FLIP:
+    *size = sizeof(MI_FLIP);
+    break;
+  case ICCX_SCALE:
+  case ICCX_MATRIX:
+    *size = sizeof(MI_MATRIX);
+    break;
+  case ICCX_MULTIPLY:
+    *size = sizeof(MI_MULTIPLY);
+    break;
+  case ICCX_NEUTRAL_AB:
+    *size = 0;
+    break;
+  case ICCX_CLUT16:
+    n = action->u.clut16->out;
+    for ( i = 0; i < action->u.clut16->in; ++i )
+      n *= action->u.clut16->maxindex[i] + 1u;
+    *size = MI_CLUT16_SIZE(n);
+    i = ICCX_CLUT16;
+    break;
+  case ICCX_CLUT8:
+    n = action->u.clut8->out;
+    for ( i = 0; i < action->u.clut8->in; ++i )
+      n *= action->u.clut8->maxindex[i] + 1u;
+    *size = MI_CLUT8_SIZE(n);
+    i = ICCX_CLUT8;
+    break;
+  default:
+    *size = sizeof(MI_XYZ);
+    break;
+  }
+
+  *code = i;
+  return TRUE;
+}
+
+/** Size of the CLUT scratch space, checking the CLUT is consistent with the
+    size of its data. Returns 0 if it is not. */
+static size_t iccx_clut_scratch(uint8 in, uint8 out, const uint8 *maxindex,
+                                const uint32 *step, size_t header,
+                                size_t value, size_t size)
+{
+  size_t points = out, scratchSize;
+  int32 i;
+
+  if ( in < 1 || in > MAX_CHANNELS || out < 1 || out > MAX_CHANNELS ||
+       size < header )
+    return 0;
+
+  for ( i = in - 1; i >= 0; --i ) {
+    if ( maxindex[i] < 1 || step[i] != points )
+      return 0;
+    points *= maxindex[i] + 1u;
+  }
+  if ( size != header + points * value )
+    return 0;
+
+  scratchSize = sizeof(ICVALUE) * out << (in - 1);
+  if ( scratchSize > MAX_SCRATCH_SIZE )
+    return 0;
+
+  return scratchSize;
+}
+
+/** Check the mini-invoke data of a record body is consistent, before a
+    transform is built from it. */
+static Bool iccx_validate(const uint32 header[ICCX_HEADER_WORDS],
+                          const uint8 *body)
+{
+  size_t offset = ICCX_POINTS_BYTES, bytes = header[ICCX_BODY_BYTES];
+  uint32 nactions = header[ICCX_NACTIONS], i;
+
+  if ( nactions == 0 || nactions > ICCX_MAX_ACTIONS ||
+       header[ICCX_I_DIMENSIONS] < 1 ||
+       header[ICCX_I_DIMENSIONS] > MAX_CHANNELS ||
+       header[ICCX_O_DIMENSIONS] < 1 ||
+       header[ICCX_O_DIMENSIONS] > MAX_CHANNELS ||
+       header[ICCX_INTENT] > 255 )
+    return FALSE;
+
+  for ( i = 0; i < nactions; ++i ) {
+    uint32 code, size, n;
+    const uint8 *data;
+
+    if ( offset > bytes || bytes - offset < ICCX_ACTION_BYTES )
+      return FALSE;
+    code = iccx_get(body + offset);
+    size = iccx_get(body + offset + 4);
+    offset += ICCX_ACTION_BYTES;
+    if ( code >= ICCX_NFUNCTIONS || size > bytes - offset ||
+         iccx_align(size) > bytes - offset )
+      return FALSE;
+    data = body + offset;
+
+    switch ( code ) {
+    case ICCX_PIECEWISE_LINEAR:
+    case ICCX_INVERSE_LINEAR: {
+      const MI_PIECEWISE_LINEAR *piecewise = (const MI_PIECEWISE_LINEAR *)data;
+      size_t used = MI_PIECEWISE_LINEAR_SIZE;
+
+      if ( size < MI_PIECEWISE_LINEAR_SIZE ||
+           piecewise->channelmask == 0 ||
+           piecewise->channelmask >= (1u << MAX_CHANNELS) )
+        return FALSE;
+      for ( n = iccx_bits(piecewise->channelmask); n > 0; --n ) {
+        const DATA_PIECEWISE_LINEAR *curve =
+          (const DATA_PIECEWISE_LINEAR *)(data + used);
+
+        if ( size - used < DATA_PIECEWISE_LINEAR_SIZE(1) ||
+             curve->maxindex >= (size - used) / sizeof(USERVALUE) )
+          return FALSE;
+        used += DATA_PIECEWISE_LINEAR_SIZE(curve->maxindex + 1);
+        if ( used > size )
+          return FALSE;
+      }
+      if ( used != size )
+        return FALSE;
+      break;
+    }
+    case ICCX_PARAMETRIC:
+      if ( size < MI_PARAMETRIC_SIZE(0) ||
+           ((const MI_PARAMETRIC *)data)->channelmask >= (1u << MAX_CHANNELS) ||
+           (n = iccx_bits(((const MI_PARAMETRIC *)data)->channelmask)) == 0 ||
+           size != MI_PARAMETRIC_SIZE(n) )
+        return FALSE;
+      break;
+    case ICCX_INVERSE_PARAMETRIC:
+      if ( size < MI_INVERSE_PARAMETRIC_SIZE(0) ||
+           ((const MI_INVERSE_PARAMETRIC *)data)->channelmask >=
+             (1u << MAX_CHANNELS) ||
+           (n = iccx_bits(((const MI_INVERSE_PARAMETRIC *)data)->channelmask))
+             == 0 ||
+           size != MI_INVERSE_PARAMETRIC_SIZE(n) )
+        return FALSE;
+      break;
+    case ICCX_FLIP:
+      if ( size != sizeof(MI_FLIP) ||
+           ((const MI_FLIP *)data)->channels > MAX_CHANNELS )
+        return FALSE;
+      break;
+    case ICCX_SCALE:
+    case ICCX_MATRIX:
+      if ( size != sizeof(MI_MATRIX) )
+        return FALSE;
+      break;
+    case ICCX_MULTIPLY:
+      if ( size != sizeof(MI_MULTIPLY) )
+        return FALSE;
+      break;
+    case ICCX_NEUTRAL_AB:
+      if ( size != 0 )
+        return FALSE;
+      break;
+    case ICCX_CLUT16: {
+      const MI_CLUT16 *clut = (const MI_CLUT16 *)data;
+
+      if ( size < MI_CLUT16_SIZE(0) ||
+           iccx_clut_scratch(clut->in, clut->out, clut->maxindex, clut->step,
+                             MI_CLUT16_SIZE(0), sizeof(uint16), size) == 0 )
+        return FALSE;
+      break;
+    }
+    case ICCX_CLUT8: {
+      const MI_CLUT8 *clut = (const MI_CLUT8 *)data;
+
+      if ( size < MI_CLUT8_SIZE(0) ||
+           iccx_clut_scratch(clut->in, clut->out, clut->maxindex, clut->step,
+                             MI_CLUT8_SIZE(0), sizeof(uint8), size) == 0 )
+        return FALSE;
+      break;
+    }
+    default:
+      if ( size != sizeof(MI_XYZ) )
+        return FALSE;
+      break;
+    }
+
+    offset += iccx_align(size);
+  }
+
+  return offset == bytes;
+}
+
+/*----------------------------------------------------------------------------*/
+
+static void iccx_free_body(ICCX_ENTRY *entry)
+{
+  if ( entry->body != NULL ) {
+    mm_free(mm_pool_color, entry->body, entry->header[ICCX_BODY_BYTES]);
+    entry->body = NULL;
+  }
+}
+
+static void iccx_free_entries(void)
+{
+  while ( iccx_entries != NULL ) {
+    ICCX_ENTRY *entry = iccx_entries;
+
+    iccx_entries = entry->next;
+    iccx_free_body(entry);
+    mm_free(mm_pool_color, entry, sizeof(ICCX_ENTRY));
+  }
+}
+
+/** Results of reading a record. */
+enum {
+  ICCX_READ_OK,       /**< Record read, though the body may be NULL. */
+  ICCX_READ_END,      /**< At the end of the file. */
+  ICCX_READ_BAD       /**< Record is damaged or from another build. */
+} ;
+
+/** Read and check a record from the current position of the cache file.
+    The body is left NULL if there was no memory for it. */
+static int32 iccx_read_record(DEVICELIST *dev, DEVICE_FILEDESCRIPTOR fd,
+                              ICCX_ENTRY *entry)
+{
+  uint8 head[ICCX_HEADER_BYTES];
+  int32 i, bytes;
+  Bool ok;
+
+  bytes = (*theIReadFile(dev))(dev, fd, head, ICCX_HEADER_BYTES);
+  if ( bytes == 0 )
+    return ICCX_READ_END;
+  if ( bytes != ICCX_HEADER_BYTES )
+    return ICCX_READ_BAD;
+
+  for ( i = 0; i < ICCX_HEADER_WORDS; ++i )
+    entry->header[i] = iccx_get(head + i * 4);
+
+  if ( entry->header[ICCX_MAGIC_WORD] != ICCX_MAGIC ||
+       entry->header[ICCX_VERSION_WORD] != ICCX_VERSION ||
+       entry->header[ICCX_LAYOUT] != iccx_layout() ||
+       entry->header[ICCX_BODY_BYTES] <= ICCX_POINTS_BYTES ||
+       entry->header[ICCX_BODY_BYTES] > ICCX_MAX_BODY ||
+       entry->header[ICCX_BODY_BYTES] % ICCX_ALIGN != 0 )
+    return ICCX_READ_BAD;
+
+  bytes = (int32)entry->header[ICCX_BODY_BYTES];
+  entry->body = mm_alloc(mm_pool_color, bytes,
+                         MM_ALLOC_CLASS_ICC_PROFILE_CACHE);
+  if ( entry->body == NULL ) {
+    /* Skip the body; it can be read later when there is more memory. */
+    Hq32x2 pos;
+
+    Hq32x2FromInt32(&pos, bytes);
+    return (*theISeekFile(dev))(dev, fd, &pos, SW_INCR) ? ICCX_READ_OK
+                                                        : ICCX_READ_BAD;
+  }
+
+  ok = (*theIReadFile(dev))(dev, fd, entry->body, bytes) == bytes &&
+       iccx_checksum(entry->header, entry->body) ==
+         entry->header[ICCX_CHECKSUM] &&
+       iccx_validate(entry->header, entry->body);
+  if ( !ok ) {
+    iccx_free_body(entry);
+    return ICCX_READ_BAD;
+  }
+
+  return ICCX_READ_OK;
+}
+
+/** Read back the body of an entry discarded in low memory. */
+static Bool iccx_reload(ICCX_ENTRY *entry)
+{
+  DEVICELIST *dev;
+  DEVICE_FILEDESCRIPTOR fd;
+  ICCX_ENTRY copy;
+  Hq32x2 pos;
+  Bool ok;
+
+  HQASSERT(entry->body == NULL, "Reloading a cache entry already present");
+
+  if ( entry->offset < 0 ||
+       (dev = find_device((uint8 *)"os")) == NULL ||
+       (fd = (*theIOpenFile(dev))(dev, (uint8 *)ICCX_FILENAME,
+                                  SW_RDONLY)) < 0 )
+    return FALSE;
+
+  Hq32x2FromInt32(&pos, entry->offset);
+  copy.body = NULL;
+  ok = (*theISeekFile(dev))(dev, fd, &pos, SW_SET) &&
+       iccx_read_record(dev, fd, &copy) == ICCX_READ_OK &&
+       copy.body != NULL;
+  (void)(*theICloseFile(dev))(dev, fd);
+
+  if ( ok ) {
+    int32 i;
+
+    /* The file may have been changed behind our back. */
+    for ( i = 0; ok && i < ICCX_HEADER_WORDS; ++i )
+      ok = copy.header[i] == entry->header[i];
+    if ( ok )
+      entry->body = copy.body;
+    else
+      iccx_free_body(&copy);
+  }
+
+  return ok;
+}
+
+/** Append a record to the cache file. */
+static void iccx_append(DEVICELIST *dev, ICCX_ENTRY *entry)
+{
+  DEVICE_FILEDESCRIPTOR fd;
+  uint8 head[ICCX_HEADER_BYTES];
+  int32 i, bytes = (int32)entry->header[ICCX_BODY_BYTES];
+  Bool ok;
+
+  entry->offset = -1;
+  if ( iccx_filesize < 0 ||
+       iccx_filesize + ICCX_HEADER_BYTES + bytes > ICCX_MAX_FILE )
+    return;
+
+  for ( i = 0; i < ICCX_HEADER_WORDS; ++i )
+    iccx_put(head + i * 4, entry->header[i]);
+
+  if ( (fd = (*theIOpenFile(dev))(dev, (uint8 *)ICCX_FILENAME,
+                                  SW_WRONLY | SW_CREAT | SW_APPEND)) < 0 )
+    return;
+
+  ok = (*theIWriteFile(dev))(dev, fd, head, ICCX_HEADER_BYTES) ==
+         ICCX_HEADER_BYTES &&
+       (*theIWriteFile(dev))(dev, fd, entry->body, bytes) == bytes;
+  ok = (*theICloseFile(dev))(dev, fd) >= 0 && ok;
+
+  if ( ok ) {
+    entry->offset = iccx_filesize;
+    iccx_filesize += ICCX_HEADER_BYTES + bytes;
+  } else {
+    ICCX_ENTRY *other;
+
+    /* Don't leave a truncated record behind, it would hide any records
+       appended after it. Bodies can no longer be read back, so entries
+       discarded in low memory will be dropped instead. */
+    (void)(*theIDeleteFile(dev))(dev, (uint8 *)ICCX_FILENAME);
+    for ( other = iccx_entries; other != NULL; other = other->next )
+      other->offset = -1;
+    iccx_filesize = 0;
+  }
+}
+
+/** Read all of the usable records in the cache file. If any are damaged,
+    the file is rewritten with just the records that were read. */
+static void iccx_load(void)
+{
+  DEVICELIST *dev;
+  DEVICE_FILEDESCRIPTOR fd;
+  Bool rewrite = FALSE;
+  ICCX_ENTRY **tail = &iccx_entries;
+
+  HQASSERT(iccx_entries == NULL, "Loading transform cache twice");
+
+  iccx_loaded = TRUE;
+  iccx_filesize = 0;
+
+  if ( (dev = find_device((uint8 *)"os")) == NULL ) {
+    iccx_filesize = -1;
+    return;
+  }
+  if ( (fd = (*theIOpenFile(dev))(dev, (uint8 *)ICCX_FILENAME,
+                                  SW_RDONLY)) < 0 )
+    return;
+
+  for (;;) {
+    ICCX_ENTRY *entry;
+    int32 result;
+
+    entry = mm_alloc(mm_pool_color, sizeof(ICCX_ENTRY),
+                     MM_ALLOC_CLASS_ICC_PROFILE_CACHE);
+    if ( entry == NULL ) {
+      /* Leave the rest of the file alone; don't append after it. */
+      iccx_filesize = -1;
+      break;
+    }
+    entry->next = NULL;
+    entry->body = NULL;
+    entry->offset = iccx_filesize;
+    entry->lastUsed = 0;
+
+    result = iccx_read_record(dev, fd, entry);
+    if ( result != ICCX_READ_OK || iccx_find(entry->header) != NULL ) {
+      /* Anything other than a clean end of file needs a rewrite. */
+      rewrite = result != ICCX_READ_END;
+      iccx_free_body(entry);
+      mm_free(mm_pool_color, entry, sizeof(ICCX_ENTRY));
+      break;
+    }
+
+    iccx_filesize += ICCX_HEADER_BYTES +
+                     (int32)entry->header[ICCX_BODY_BYTES];
+    *tail = entry;
+    tail = &entry->next;
+  }
+
+  (void)(*theICloseFile(dev))(dev, fd);
+
+  if ( rewrite ) {
+    ICCX_ENTRY **prev = &iccx_entries, *entry;
+
+    (void)(*theIDeleteFile(dev))(dev, (uint8 *)ICCX_FILENAME);
+    iccx_filesize = 0;
+    while ( (entry = *prev) != NULL ) {
+      if ( entry->body == NULL ) {
+        *prev = entry->next;
+        mm_free(mm_pool_color, entry, sizeof(ICCX_ENTRY));
+      } else {
+        iccx_append(dev, entry);
+        prev = &entry->next;
+      }
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Turn the persistent transform cache on or off. When it is turned on, all
+ * of the transforms in the cache file are read, so it should be set early,
+ * such as in the RIP's startup configuration.
+ */
+void icc_xform_cache_enable(Bool enable)
+{
+  iccx_enabled = enable;
+  if ( enable ) {
+    if ( !iccx_loaded )
+      iccx_load();
+  } else {
+    iccx_free_entries();
+    iccx_loaded = FALSE;
+  }
+}
+
+Bool icc_xform_cache_enabled(void)
+{
+  return iccx_enabled;
+}
+
+/**
+ * Restore the mini-invokes of a transform from the persistent cache.
+ *
+ * \param pInfo           The profile, which must have a valid MD5.
+ * \param isOutput        Whether this is an output transform.
+ * \param desiredIntent   The intent slot of the profile being filled.
+ * \param ppIccBasedInfo  A transform with the common part initialised and
+ *                        an empty action list. The intent, colorspaces and
+ *                        mini-invokes are filled in. On failure, any
+ *                        mini-invokes added are left for the caller to free
+ *                        with the transform.
+ * \param found           Set to whether the transform was in the cache.
+ * \return                FALSE on error, which may only be a VMERROR.
+ */
+Bool icc_xform_cache_restore(ICC_PROFILE_INFO *pInfo, Bool isOutput,
+                             uint8 desiredIntent,
+                             CLINKiccbased **ppIccBasedInfo, Bool *found)
+{
+  uint32 key[ICCX_HEADER_WORDS], nactions, i;
+  ICCX_ENTRY *entry;
+  CLINKiccbased *pIccBasedInfo = *ppIccBasedInfo;
+  size_t offset;
+
+  HQASSERT(IS_INTERPRETER(), "Using the transform cache in the back end");
+  HQASSERT(pIccBasedInfo->actions[0].function == NULL,
+           "Restoring into a transform that already has actions");
+
+  *found = FALSE;
+
+  if ( !iccx_enabled || !iccx_key(pInfo, isOutput, desiredIntent, key) ||
+       (entry = iccx_find(key)) == NULL ||
+       (entry->body == NULL && !iccx_reload(entry)) )
+    return TRUE;
+
+  entry->lastUsed = ++iccx_clock;
+
+  HqMemCpy(pInfo->relative_whitepoint, entry->body, sizeof(XYZVALUE));
+  HqMemCpy(pInfo->relative_blackpoint, entry->body + sizeof(XYZVALUE),
+           sizeof(XYZVALUE));
+
+  pIccBasedInfo->intent = (uint8)entry->header[ICCX_INTENT];
+  pIccBasedInfo->iColorSpace = (COLORSPACE_ID)entry->header[ICCX_I_SPACE];
+  pIccBasedInfo->oColorSpace = (COLORSPACE_ID)entry->header[ICCX_O_SPACE];
+  pIccBasedInfo->i_dimensions = (int8)entry->header[ICCX_I_DIMENSIONS];
+  pIccBasedInfo->o_dimensions = (int8)entry->header[ICCX_O_DIMENSIONS];
+
+  offset = ICCX_POINTS_BYTES;
+  nactions = entry->header[ICCX_NACTIONS];
+  for ( i = 0; i < nactions; ++i ) {
+    uint32 code = iccx_get(entry->body + offset);
+    size_t size = iccx_get(entry->body + offset + 4);
+    void *data = NULL;
+
+    offset += ICCX_ACTION_BYTES;
+
+    if ( size > 0 ) {
+      if ( (data = mi_alloc(size)) == NULL )
+        return FALSE;
+      HqMemCpy(data, entry->body + offset, size);
+    }
+    offset += iccx_align(size);
+
+    /* Rebuild the pointers in the data. */
+    switch ( code ) {
+    case ICCX_PIECEWISE_LINEAR:
+    case ICCX_INVERSE_LINEAR: {
+      MI_PIECEWISE_LINEAR *piecewise = data;
+      DATA_PIECEWISE_LINEAR *curve = &piecewise->curves[0];
+      uint32 n;
+
+      for ( n = iccx_bits(piecewise->channelmask); n > 1; --n ) {
+        curve->next = (DATA_PIECEWISE_LINEAR *)
+          ((int8 *)curve + DATA_PIECEWISE_LINEAR_SIZE(curve->maxindex + 1));
+        curve = curve->next;
+      }
+      curve->next = NULL;
+      break;
+    }
+    case ICCX_CLUT16: {
+      MI_CLUT16 *clut = data;
+
+      clut->scratch = NULL;
+      if ( (clut->scratch = mi_alloc(sizeof(ICVALUE) * clut->out <<
+                                     (clut->in - 1))) == NULL ) {
+        mi_free(clut);
+        return FALSE;
+      }
+      break;
+    }
+    case ICCX_CLUT8: {
+      MI_CLUT8 *clut = data;
+
+      clut->scratch = NULL;
+      if ( (clut->scratch = mi_alloc(sizeof(ICVALUE) * clut->out <<
+                                     (clut->in - 1))) == NULL ) {
+        mi_free(clut);
+        return FALSE;
+      }
+      break;
+    }
+    }
+
+    if ( !mi_add_mini_invoke(ppIccBasedInfo, iccx_functions[code], data) ) {
+      if ( code == ICCX_CLUT16 )
+        mi_free(((MI_CLUT16 *)data)->scratch);
+      else if ( code == ICCX_CLUT8 )
+        mi_free(((MI_CLUT8 *)data)->scratch);
+      mi_free(data);
+      return FALSE;
+    }
+  }
+
+  *found = TRUE;
+  return TRUE;
+}
+
+/**
+ * Save a newly built transform in the persistent cache, if it is enabled.
+ * The cache is only an optimisation, so failing to save the transform is
+ * not an error.
+ */
+void icc_xform_cache_save(ICC_PROFILE_INFO *pInfo, Bool isOutput,
+                          uint8 desiredIntent,
+                          CLINKiccbased *pIccBasedInfo)
+{
+  uint32 header[ICCX_HEADER_WORDS], nactions = 0;
+  size_t bytes = ICCX_POINTS_BYTES, offset;
+  DEVICELIST *dev;
+  ICCX_ENTRY *entry;
+  int32 i;
+
+  HQASSERT(IS_INTERPRETER(), "Using the transform cache in the back end");
+
+  if ( !iccx_enabled ||
+       !iccx_key(pInfo, isOutput, desiredIntent, header) ||
+       iccx_find(header) != NULL ||
+       (dev = find_device((uint8 *)"os")) == NULL )
+    return;
+
+  for ( i = 0; pIccBasedInfo->actions[i].function != NULL; ++i ) {
+    uint32 code;
+    size_t size;
+
+    if ( !iccx_action_size(&pIccBasedInfo->actions[i], &code, &size) )
+      return;
+    bytes += ICCX_ACTION_BYTES + iccx_align(size);
+    ++nactions;
+  }
+  if ( nactions == 0 || nactions > ICCX_MAX_ACTIONS || bytes > ICCX_MAX_BODY )
+    return;
+
+  header[ICCX_MAGIC_WORD] = ICCX_MAGIC;
+  header[ICCX_VERSION_WORD] = ICCX_VERSION;
+  header[ICCX_LAYOUT] = iccx_layout();
+  header[ICCX_INTENT] = pIccBasedInfo->intent;
+  header[ICCX_I_SPACE] = (uint32)pIccBasedInfo->iColorSpace;
+  header[ICCX_O_SPACE] = (uint32)pIccBasedInfo->oColorSpace;
+  header[ICCX_I_DIMENSIONS] = (uint32)pIccBasedInfo->i_dimensions;
+  header[ICCX_O_DIMENSIONS] = (uint32)pIccBasedInfo->o_dimensions;
+  header[ICCX_NACTIONS] = nactions;
+  header[ICCX_BODY_BYTES] = (uint32)bytes;
+
+  entry = mm_alloc(mm_pool_color, sizeof(ICCX_ENTRY),
+                   MM_ALLOC_CLASS_ICC_PROFILE_CACHE);
+  if ( entry == NULL )
+    return;
+  entry->body = mm_alloc(mm_pool_color, bytes,
+                         MM_ALLOC_CLASS_ICC_PROFILE_CACHE);
+  if ( entry->body == NULL ) {
+    mm_free(mm_pool_color, entry, sizeof(ICCX_ENTRY));
+    return;
+  }
+
+  /* Padding is zeroed so the file contents are reproducible. */
+  HqMemZero(entry->body, bytes);
+  HqMemCpy(entry->body, pInfo->relative_whitepoint, sizeof(XYZVALUE));
+  HqMemCpy(entry->body + sizeof(XYZVALUE), pInfo->relative_blackpoint,
+           sizeof(XYZVALUE));
+
+  offset = ICCX_POINTS_BYTES;
+  for ( i = 0; pIccBasedInfo->actions[i].function != NULL; ++i ) {
+    uint32 code;
+    size_t size;
+
+    (void)iccx_action_size(&pIccBasedInfo->actions[i], &code, &size);
+    iccx_put(entry->body + offset, code);
+    iccx_put(entry->body + offset + 4, (uint32)size);
+    offset += ICCX_ACTION_BYTES;
+    if ( size > 0 )
+      HqMemCpy(entry->body + offset, pIccBasedInfo->actions[i].u.data, size);
+    offset += iccx_align(size);
+  }
+  HQASSERT(offset == bytes, "Transform cache record size is wrong");
+
+  header[ICCX_CHECKSUM] = iccx_checksum(header, entry->body);
+  HqMemCpy(entry->header, header, sizeof(header));
+  entry->lastUsed = ++iccx_clock;
+  entry->next = iccx_entries;
+  iccx_entries = entry;
+
+  iccx_append(dev, entry);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/** Solicit method of the transform cache low-memory handler. */
+static low_mem_offer_t *icc_xform_cache_solicit(low_mem_handler_t *handler,
+                                                corecontext_t *context,
+                                                size_t count,
+                                                memory_requirement_t* requests)
+{
+  static low_mem_offer_t offer;
+  size_t size_to_purge = 0;
+  ICCX_ENTRY *entry;
+
+  UNUSED_PARAM(low_mem_handler_t *, handler);
+  UNUSED_PARAM(size_t, count); UNUSED_PARAM(memory_requirement_t*, requests);
+
+  if ( !context->is_interpreter )
+    /* The cache is not thread-safe, but only the interpreter thread uses it. */
+    return NULL;
+
+  for ( entry = iccx_entries; entry != NULL; entry = entry->next ) {
+    if ( entry->body != NULL )
+      size_to_purge += entry->header[ICCX_BODY_BYTES];
+  }
+  if ( size_to_purge == 0 )
+    return NULL;
+
+  offer.pool = mm_pool_color;
+  offer.offer_size = size_to_purge;
+  offer.offer_cost = 0.5f; /* only read, not write */
+  offer.next = NULL;
+  return &offer;
+}
+
+
+/** Release method of the transform cache low-memory handler. Bodies are
+    discarded least recently used first; entries which cannot be read back
+    from the file are dropped completely. */
+static Bool icc_xform_cache_release(low_mem_handler_t *handler,
+                                    corecontext_t *context,
+                                    low_mem_offer_t *offer)
+{
+  size_t current_size = mm_pool_alloced_size(mm_pool_color), target_size;
+
+  UNUSED_PARAM(low_mem_handler_t *, handler);
+  UNUSED_PARAM(corecontext_t*, context);
+
+  if ( current_size <= offer->taken_size )
+    target_size = 0;
+  else
+    target_size = current_size - offer->taken_size;
+
+  while ( current_size >= target_size ) {
+    ICCX_ENTRY **prev, **oldest = NULL, *entry;
+
+    for ( prev = &iccx_entries; *prev != NULL; prev = &(*prev)->next ) {
+      if ( (*prev)->body != NULL &&
+           (oldest == NULL || (*prev)->lastUsed < (*oldest)->lastUsed) )
+        oldest = prev;
+    }
+    if ( oldest == NULL )
+      break; /* can't free no more */
+
+    entry = *oldest;
+    iccx_free_body(entry);
+    if ( entry->offset < 0 ) {
+      *oldest = entry->next;
+      mm_free(mm_pool_color, entry, sizeof(ICCX_ENTRY));
+    }
+    /* Other threads may change the size, but not worth worrying about. */
+    current_size = mm_pool_alloced_size(mm_pool_color);
+  }
+  return TRUE;
+}
+
+
+/** The transform cache low-memory handler. */
+static low_mem_handler_t icc_xform_cache_handler = {
+  "ICC transform cache purge",
+  memory_tier_disk, icc_xform_cache_solicit, icc_xform_cache_release, TRUE,
+  0, FALSE };
+
+
+Bool icc_xform_cache_init(void)
+{
+  return low_mem_handler_register(&icc_xform_cache_handler);
+}
+
+
+void icc_xform_cache_finish(void)
+{
+  low_mem_handler_deregister(&icc_xform_cache_handler);
+  iccx_free_entries();
+  iccx_loaded = FALSE;
+}
+
+
+void init_C_globals_gscicccache(void)
+{
+  iccx_enabled = FALSE;
+  iccx_loaded = FALSE;
+  iccx_entries = NULL;
+  iccx_filesize = 0;
+  iccx_clock = 0;
+}
+
+/* Log stripped */
@@ -0,0 +1,36 @@
+/** \file
+ * \ingroup color
+ *
+ * $HopeName: COREgstate!color:src:gscicccache.h(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * Persistent cache of ICC transforms.
+ */
+
+#ifndef __GSCICCCACHE_H__
+#define __GSCICCCACHE_H__
+
+#include "icmini.h"             /* CLINKiccbased */
+
+Bool icc_xform_cache_init(void);
+void icc_xform_cache_finish(void);
+
+void icc_xform_cache_enable(Bool enable);
+Bool icc_xform_cache_enabled(void);
+
+Bool icc_xform_cache_restore(ICC_PROFILE_INFO *pInfo, Bool isOutput,
+                             uint8 desiredIntent,
+                             CLINKiccbased **ppIccBasedInfo, Bool *found);
+
+void icc_xform_cache_save(ICC_PROFILE_INFO *pInfo, Bool isOutput,
+                          uint8 desiredIntent,
+                          CLINKiccbased *pIccBasedInfo);
+
+void init_C_globals_gscicccache(void);
+
+/* Log stripped */
+
+#endif /* __GSCICCCACHE_H__ */
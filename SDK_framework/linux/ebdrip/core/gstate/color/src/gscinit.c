@@ -124,6 +124,7 @@ IMPORT_INIT_C_GLOBALS( gs_table )
 IMPORT_INIT_C_GLOBALS( gschcms )
 IMPORT_INIT_C_GLOBALS( gschtone )
 IMPORT_INIT_C_GLOBALS( gscicc )
+IMPORT_INIT_C_GLOBALS( gscicccache )
 IMPORT_INIT_C_GLOBALS( gscparams )
 
 
@@ -143,6 +144,7 @@ void color_C_globals(struct core_init_fns *fns)
   init_C_globals_gschcms() ;
   init_C_globals_gschtone() ;
   init_C_globals_gscicc() ;
+  init_C_globals_gscicccache() ;
   init_C_globals_gscparams() ;
 
   fns->swinit = color_swinit ;
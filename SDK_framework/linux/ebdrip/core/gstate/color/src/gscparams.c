@@ -35,6 +35,7 @@
 #include "gs_cache.h"           /* GSC_ENABLE_ALL_COLOR_CACHES */
 #include "dicthash.h"           /* CopyDictionary */
 #include "gschtone.h"           /* gsc_redo_setscreen */
+#include "gscicccache.h"        /* icc_xform_cache_enable */
 
 #include "gscparamspriv.h"
 #include "functns.h"
@@ -60,6 +61,7 @@ static NAMETYPEMATCH gsc_system_match[] = {
   { NAME_AdobeCurrentHalftone | OOPTIONAL, 1, { OBOOLEAN }},
   { NAME_TableBasedColor | OOPTIONAL, 1, {OBOOLEAN}},
   { NAME_ForcePositive | OOPTIONAL, 1 , {OBOOLEAN}},
+  { NAME_ICCTransformCache | OOPTIONAL, 1 , {OBOOLEAN}},
   DUMMY_END_MATCH
 };
 
@@ -106,6 +108,7 @@ static NAMETYPEMATCH gsc_user_match[] = {
   { NAME_FasterColorMethod      | OOPTIONAL, 1, { ONAME }},
   { NAME_FasterColorGridPoints  | OOPTIONAL, 1, { OINTEGER }},
   { NAME_FasterColorSmoothness  | OOPTIONAL, 1, { OREAL }},
+  { NAME_FasterColorPrefill     | OOPTIONAL, 1, { OBOOLEAN }},
   { NAME_HalftoneColorantMapping | OOPTIONAL, 1, { OBOOLEAN }},
   { NAME_UseFastRGBToCMYK       | OOPTIONAL, 1, {OBOOLEAN}},
   { NAME_RGBToCMYKMethod        | OOPTIONAL, 1, {OINTEGER}},
@@ -137,6 +140,7 @@ static Bool colorSystemParamsInit(corecontext_t *context)
   color_systemparams->AdobeCurrentHalftone = FALSE;
   color_systemparams->TableBasedColor = TRUE;
   color_systemparams->ForcePositive = FALSE;
+  color_systemparams->ICCTransformCache = FALSE;
 
   HQASSERT(color_system_params.next == NULL,
            "Already linked system params accessor");
@@ -189,6 +193,7 @@ static Bool colorUserParamsInit(corecontext_t *context)
   colorParams->FasterColorMethod = NAME_Tetrahedral;
   colorParams->FasterColorGridPoints = 16;
   colorParams->FasterColorSmoothness = 1.0f;
+  colorParams->FasterColorPrefill = FALSE;
   colorParams->HalftoneColorantMapping = TRUE;
 
   colorParams->UseFastRGBToCMYK = TRUE;
@@ -285,6 +290,13 @@ static Bool gsc_set_systemparam(corecontext_t *context,
     }
     break;
 
+  case NAME_ICCTransformCache: /* Keep built ICC transforms across jobs */
+    if ( colorSystemParams->ICCTransformCache != oBool(*theo) ) {
+      colorSystemParams->ICCTransformCache = (uint8)oBool(*theo);
+      icc_xform_cache_enable(colorSystemParams->ICCTransformCache);
+    }
+    break;
+
   case NAMES_COUNTED: /* Finaliser */
       /* Copy all values into the DL_STATE. It is all values because this also
        * serves as the initialiser - I don't want to put knowledge of the
@@ -335,6 +347,10 @@ static Bool gsc_get_systemparam(corecontext_t *context,
   case NAME_ForcePositive:
     object_store_bool(result, colorSystemParams->ForcePositive);
     break;
+
+  case NAME_ICCTransformCache:
+    object_store_bool(result, colorSystemParams->ICCTransformCache);
+    break;
   }
 
   return TRUE;
@@ -535,6 +551,10 @@ static Bool gsc_set_pageparam(COLOR_USER_PARAMS *colorUserParams,
     colorUserParams->FasterColorSmoothness = oReal(*theo);
     break;
 
+  case NAME_FasterColorPrefill:
+    colorUserParams->FasterColorPrefill = oBool(*theo);
+    break;
+
   case NAME_HalftoneColorantMapping:
     colorUserParams->HalftoneColorantMapping = (int8)oBool(*theo);
     break;
@@ -708,6 +728,10 @@ static Bool gsc_get_userparam(corecontext_t *context,
     object_store_real(result, colorUserParams->FasterColorSmoothness);
     break;
 
+  case NAME_FasterColorPrefill:
+    object_store_bool(result, colorUserParams->FasterColorPrefill);
+    break;
+
   case NAME_HalftoneColorantMapping:
     object_store_bool(result, colorUserParams->HalftoneColorantMapping);
     break;
@@ -970,6 +994,7 @@ Bool gsc_pagedevice(corecontext_t *context,
   colorPageParams->fasterColorMethod = colorUserParams->FasterColorMethod;
   colorPageParams->fasterColorGridPoints = colorUserParams->FasterColorGridPoints;
   colorPageParams->fasterColorSmoothness = colorUserParams->FasterColorSmoothness;
+  colorPageParams->fasterColorPrefill = colorUserParams->FasterColorPrefill;
   colorPageParams->halftoneColorantMapping = colorUserParams->HalftoneColorantMapping;
 
   return TRUE;
@@ -93,6 +93,10 @@ static void rgbtocmykInfoAssertions(GS_RGBtoCMYKinfo *pInfo) ;
  * customconversion common creator.
  */
 
+/** Largest error allowed when sampling a custom conversion into a table:
+    a small fraction of a COLORVALUE step. */
+#define CUSTOMCONVERSION_LUT_TOLERANCE (0.25f / COLORVALUE_ONE)
+
 static size_t customconversionStructSize( void )
 {
   return sizeof(CLINKcustomconversion);
@@ -115,7 +119,11 @@ static Bool customconversion_invokeSingle(CLINK *pLink, USERVALUE *oColorValues)
   indims = pLink->n_iColorants ;
   ondims = pLink->p.customconversion->n_oColorants ;
 
-  if ( pLink->p.customconversion->pscalc_func ) {
+  if ( pLink->p.customconversion->pscalc_lut ) {
+    HQASSERT(indims == 1, "Sampled custom conversion should have one input");
+    pscalc_lut_lookup(pLink->p.customconversion->pscalc_lut,
+                      pLink->iColorValues[0], oColorValues);
+  } else if ( pLink->p.customconversion->pscalc_func ) {
 
     if ( pscalc_exec(pLink->p.customconversion->pscalc_func, indims, ondims,
         pLink->iColorValues, oColorValues) != PSCALC_noerr )
@@ -264,6 +272,8 @@ static Bool cmyktogray_invokeBlock( CLINK *pLink , CLINKblock *pBlock )
 
 static void customconversion_destroy(CLINK *pLink)
 {
+  pscalc_lut_destroy(pLink->p.customconversion->pscalc_lut);
+  pLink->p.customconversion->pscalc_lut = NULL;
   if ( pLink->p.customconversion->pscalc_func ) {
     pscalc_destroy(pLink->p.customconversion->pscalc_func);
     pLink->p.customconversion->pscalc_func = NULL;
@@ -303,6 +313,7 @@ CLINK *cc_cmykton_create( OBJECT customProcedure,
     Copy(object_slot_notvm(&pLink->p.customconversion->customprocedure),
          &customProcedure) ;
     pLink->p.customconversion->pscalc_func = pscalc_create(&customProcedure);
+    pLink->p.customconversion->pscalc_lut = NULL;
     pLink->p.customconversion->n_oColorants = n_oColorants ;
     cc_commonAssertions( pLink,
                          CL_TYPEcmykton,
@@ -931,6 +942,7 @@ CLINK *cc_rgbton_create( OBJECT customProcedure,
     Copy(object_slot_notvm(&pLink->p.customconversion->customprocedure),
          &customProcedure) ;
     pLink->p.customconversion->pscalc_func = pscalc_create(&customProcedure);
+    pLink->p.customconversion->pscalc_lut = NULL;
     pLink->p.customconversion->n_oColorants = n_oColorants ;
     cc_commonAssertions( pLink,
                          CL_TYPErgbton,
@@ -1347,6 +1359,10 @@ CLINK *cc_grayton_create( OBJECT customProcedure,
     Copy(object_slot_notvm(&pLink->p.customconversion->customprocedure),
          &customProcedure) ;
     pLink->p.customconversion->pscalc_func = pscalc_create(&customProcedure);
+    /* A gray conversion is usually linear, so avoid running it at all. */
+    pLink->p.customconversion->pscalc_lut =
+      pscalc_lut_create(pLink->p.customconversion->pscalc_func, n_oColorants,
+                        0.0f, 1.0f, CUSTOMCONVERSION_LUT_TOLERANCE);
     pLink->p.customconversion->n_oColorants = n_oColorants ;
     cc_commonAssertions( pLink,
                          CL_TYPEgrayton,
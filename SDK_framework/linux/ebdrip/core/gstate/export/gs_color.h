@@ -214,6 +214,11 @@ void gsc_finish( GS_COLORinfo *colorInfo );
  */
 void gsc_copycolorinfo( GS_COLORinfo *dst, GS_COLORinfo *src );
 
+/* gsc_sameColorInfo returns TRUE if two colorinfo structures refer to the
+ * same color chains and info structures, and so describe the same color state.
+ */
+Bool gsc_sameColorInfo( GS_COLORinfo *colorInfo1, GS_COLORinfo *colorInfo2 );
+
 /* colorInfos belong to colorStates and the first state is frontEndColorState.
  * A new colorState is created for backend color transforms and all the backend
  * colorInfos need copying over to this state.
@@ -27,6 +27,7 @@ typedef struct COLOR_SYSTEM_PARAMS {
   Bool      AdobeCurrentHalftone;
   Bool      TableBasedColor;
   Bool      ForcePositive;
+  Bool      ICCTransformCache;
 } COLOR_SYSTEM_PARAMS;
 
 /** The modularised color user params.
@@ -74,6 +75,7 @@ typedef struct COLOR_USER_PARAMS {
   int       FasterColorMethod;
   int       FasterColorGridPoints;
   USERVALUE FasterColorSmoothness;
+  Bool      FasterColorPrefill;
   Bool      HalftoneColorantMapping;
   Bool      UseFastRGBToCMYK;
   int       RGBToCMYKMethod;
@@ -110,6 +112,7 @@ typedef struct COLOR_PAGE_PARAMS {
   int       fasterColorMethod;
   int       fasterColorGridPoints;
   USERVALUE fasterColorSmoothness;
+  Bool      fasterColorPrefill;
   Bool      halftoneColorantMapping;
 } COLOR_PAGE_PARAMS;
 
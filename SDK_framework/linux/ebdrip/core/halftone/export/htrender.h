@@ -17,6 +17,7 @@
 #include "mlock.h" /* multi_rwlock_t */
 #include "graphict.h" /* GUCR_CHANNEL */
 #include "displayt.h" /* dl_erase_nr */
+#include "hqatomic.h" /* hq_atomic_counter_t */
 
 struct LISTCHALFTONE; /* from htcache.h */
 
@@ -125,6 +126,12 @@ MACRO_END
 extern void getnearest( int32 index, const ht_params_t *ht_params );
 
 
+/** Incremented whenever the bits of a halftone form are generated or
+    regenerated. Copies of rows taken from forms are only valid while this
+    is unchanged, because a form may be reused for another level or screen. */
+extern hq_atomic_counter_t ht_form_generation ;
+
+
 #define HT_PARAMS_DEGENERATE(ht_params) ((ht_params)->listchptr == NULL)
 
 
@@ -269,6 +269,9 @@ static double hqnrand( void )
 static mm_pool_t ht_form_pool;
 
 
+hq_atomic_counter_t ht_form_generation ;
+
+
 void free_ht_form(FORM *form)
 {
   mm_free(ht_form_pool, (mm_addr_t)form,
@@ -2537,6 +2540,7 @@ static void init_form(CHALFTONE * chptr, const ht_params_t *htp,
   int32 depth_factor = ((int32)1 << bit_depth) - 1;
   int32 dots = chptr->supcell_actual; /* #distinct ht patterns */
   int32 base; /* base whole tone level to start from */
+  hq_atomic_counter_t generation ;
 
   HQASSERT( !HT_PARAMS_DEGENERATE(htp), "Degenerate screen inited to a form" );
   HQASSERT( chptr->depth_shift == (uint8)ht_bit_depth_shift(CoreContext.page->hr),
@@ -2586,6 +2590,8 @@ static void init_form(CHALFTONE * chptr, const ht_params_t *htp,
     bitexpandform( htp, chptr->halfmxdims, chptr->halfmydims, render_cache );
   }
   render_cache->hoff = HT_FORM_INITED;
+  HqAtomicIncrement(&ht_form_generation, generation) ;
+  UNUSED_PARAM(hq_atomic_counter_t, generation) ;
 }
 
 /* ---------------------------------------------------------------------- */
@@ -2599,6 +2605,7 @@ static Bool regenerate_form(CHALFTONE *chptr, const ht_params_t *htp,
   int32 bit_depth, depth_factor, nearest_index, diff,
     to_base, from_base, to_level, from_level ;
   FORM *nearest_form ;
+  hq_atomic_counter_t generation ;
   Bool force = (chptr->depth_shift == 0 || HalfGetMultithreshold(chptr)) ;
 
   bit_depth = 1 << chptr->depth_shift;
@@ -2681,6 +2688,8 @@ static Bool regenerate_form(CHALFTONE *chptr, const ht_params_t *htp,
 #endif
 
   theform->hoff = HT_FORM_INITED;
+  HqAtomicIncrement(&ht_form_generation, generation) ;
+  UNUSED_PARAM(hq_atomic_counter_t, generation) ;
   return TRUE ;
 }
 
@@ -4616,6 +4625,7 @@ static void init_C_globals_halftone(void)
   theseed = 0;
   oldest_dl = FIRST_DL; output_dl = input_dl = INVALID_DL;
   ht_form_keep = TRUE;
+  ht_form_generation = 0 ;
   in_rip_ht_used_last_dl = INVALID_DL;
 #ifdef METRICS_BUILD
   halftone_metrics_reset(SW_METRICS_RESET_BOOT) ;
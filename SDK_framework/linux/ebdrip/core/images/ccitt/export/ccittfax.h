@@ -32,6 +32,14 @@ struct FILELIST *ccitt_open(struct FILELIST *source,
 
 void ccitt_close(struct FILELIST *filter);
 
+#if defined( ASSERT_BUILD )
+/** Time the CCITT decoder's word at a time changing element detection and
+    two level code tables against the byte at a time versions.
+
+    \param repeat The number of times to scan each test line. */
+void ccitt_benchmark(uint32 repeat) ;
+#endif
+
 /** \} */
 
 #endif /* protection for multiple inclusion */
@@ -145,6 +145,23 @@ typedef struct faxstate {
 #define CCITTHASHSIZE      (1<<CCITTHASHBITS)
 #define CCITTHASHMASK      (CCITTHASHSIZE-1)
 
+/* Two level lookup tables for the decoder. The first level is indexed by
+ * the next CCITTFASTBITS bits; codes longer than that go through a second
+ * level indexed by the bits up to MaxCodeSize.
+ */
+#define CCITTFASTBITS      9
+#define CCITTFASTSIZE      (1<<CCITTFASTBITS)
+#define CCITTSUBBITS       (MaxCodeSize-CCITTFASTBITS)
+#define CCITTSUBSIZE       (1<<CCITTSUBBITS)
+#define CCITTSUBTABLES     32
+
+typedef struct ccittcode {
+  int16 value ;         /* code value, or start of the second level table */
+  int8  numofbits ;     /* bits in code, CCITTSUBTABLE or 0 if no code */
+} CCITTCODE ;
+
+#define CCITTSUBTABLE      (-1)
+
 #define CodeDivider           64
 #define MaxCodeSize           13
 #define G40DEndCount           2
@@ -26,6 +26,8 @@
 #include "tables.h"
 #include "namedef_.h"
 #include "hqmemset.h" /* HqMemZero */
+#include "monitor.h"
+#include "swenv.h" /* get_rtime */
 
 #include "fileio.h"
 #include "ccitt.h"
@@ -66,6 +68,13 @@ static int32 extract_next_code_word( FILELIST *filter , int32 amwhite ) ;
 static int32 extract_next_code_word_bitbybit( FILELIST *filter , int32 amwhite ) ;
 static int32 detectnextbit1( uint32 *buf , int32 set , int32 bitp ) ;
 static int32 detectnextbit2( uint32 *buf , int32 set , int32 bitp ) ;
+#if defined( ASSERT_BUILD )
+static int32 detectnextbit1_bytewise( uint32 *buf , int32 set , int32 bitp ) ;
+static int32 detectnextbit2_bytewise( uint32 *buf , int32 set , int32 bitp ) ;
+static void  ccitt_unit_test( void ) ;
+#else
+#define ccitt_unit_test() EMPTY_STATEMENT()
+#endif
 static Bool output_code( FILELIST *filter , TERMCODE *termcode ) ;
 static Bool output_code_runlen( FILELIST *filter , int32 newcode , int32 amwhite ) ;
 static void init_C_globals_ccittfax(void) ;
@@ -79,6 +88,12 @@ static TERMCODE *hashblacktable [ CCITTHASHSIZE ];
 static TERMCODE *hashwhitetable [ CCITTHASHSIZE ];
 static TERMCODE *hash2dcodetable[ CCITTHASHSIZE ];
 
+static CCITTCODE fastwhitetable [ CCITTFASTSIZE ];
+static CCITTCODE fastblacktable [ CCITTFASTSIZE ];
+static CCITTCODE fast2dcodetable[ CCITTFASTSIZE ];
+static CCITTCODE fastsubtable[ CCITTSUBTABLES * CCITTSUBSIZE ];
+static int32 fastsubtables ;
+
 /*****************************************/
 /* functions used from the outside world */
 /*****************************************/
@@ -734,6 +749,51 @@ static void sorthashtable( TERMCODE **hashtable , TERMCODE *codes )
   }
 }
 
+/*
+  enters codes in a two level lookup table. Codes no longer than
+  CCITTFASTBITS fill every first level entry they prefix; longer codes
+  fill a second level table hung off the entry for their first
+  CCITTFASTBITS bits
+*/
+static void sortfasttable( CCITTCODE *fasttable , TERMCODE *codes )
+{
+  int32 i ;
+  TERMCODE *ptr ;
+
+  for ( ptr = codes ; theINumOfBits( ptr ) > 0 ; ptr++ ) {
+    int32 bits = (int32) theINumOfBits( ptr ) ;
+    int32 word = (int32) theICodeWord( ptr ) ;
+    CCITTCODE *entry ;
+    int32 lowbits ;
+
+    if ( bits <= CCITTFASTBITS ) {
+      lowbits = CCITTFASTBITS - bits ;
+      entry = fasttable + ( word << lowbits ) ;
+    }
+    else {
+      CCITTCODE *first = fasttable + ( word >> ( bits - CCITTFASTBITS )) ;
+
+      if ( first->numofbits == 0 ) {
+        HQASSERT( fastsubtables < CCITTSUBTABLES ,
+                  "sortfasttable: too many second level tables" ) ;
+        first->numofbits = CCITTSUBTABLE ;
+        first->value = (int16)( fastsubtables++ * CCITTSUBSIZE ) ;
+      }
+      HQASSERT( first->numofbits == CCITTSUBTABLE ,
+                "sortfasttable: code is prefixed by a shorter code" ) ;
+      lowbits = MaxCodeSize - bits ;
+      entry = fastsubtable + first->value +
+        (( word << lowbits ) & ( CCITTSUBSIZE - 1 )) ;
+    }
+
+    for ( i = 0 ; i < ( 1 << lowbits ) ; i++ ) {
+      HQASSERT( entry[ i ].numofbits == 0 , "sortfasttable failed" ) ;
+      entry[ i ].value = (int16) theICodeValue( ptr ) ;
+      entry[ i ].numofbits = (int8) bits ;
+    }
+  }
+}
+
 static void finalisehashtable( TERMCODE **hashtable )
 {
   int32 i ;
@@ -787,6 +847,17 @@ static void initfaxdata( void )
   finalisehashtable( hashwhitetable ) ;
   finalisehashtable( hashblacktable ) ;
   finalisehashtable( hash2dcodetable ) ;
+
+  fastsubtables = 0 ;
+  sortfasttable( fastwhitetable  , white_terminators ) ;
+  sortfasttable( fastwhitetable  , white_makeup_codes ) ;
+  sortfasttable( fastwhitetable  , extended_makeup_codes ) ;
+
+  sortfasttable( fastblacktable  , black_terminators ) ;
+  sortfasttable( fastblacktable  , black_makeup_codes ) ;
+  sortfasttable( fastblacktable  , extended_makeup_codes ) ;
+
+  sortfasttable( fast2dcodetable , twod_codetable ) ;
 }
 
 static void ungetccodings( FILELIST *filter , int32 code )
@@ -928,16 +999,56 @@ static int32 extract_next_code_bit( FILELIST *filter )
   return (( byte >> bits ) & 0x01 ) ;
 }
 
+/* When the underlying file has at least a word buffered, the next code is
+ * looked up in a window of the cached bits followed by that word, without
+ * reading it. Only the bytes the code uses are then consumed, so no more
+ * than a byte's worth of bits is left cached. Anything not in the fast
+ * tables (EOL, fill, errors) is left to the byte at a time code below.
+ */
 #define EXTRACT_NEXT_CODE_WORD( _filter , _faxstate , _amwhite , _code ) MACRO_START \
 do { \
   int32 _byte_ ; \
   int32 _bits_ ; \
   TERMCODE *_hashptr_ ; \
+  FILELIST *_uflptr_ = theIUnderFile( (_filter) ) ; \
   \
-  _byte_ = theIFaxLastByte( _faxstate ) ; \
   _bits_ = theIFaxLastBits( _faxstate ) ; \
+  if ( theICount( _uflptr_ ) >= 4 && _bits_ <= 16 ) { \
+    uint8 *_ptr_ = theIPtr( _uflptr_ ) ; \
+    uint32 _window_ = ((uint32)_ptr_[ 0 ] << 24) | ((uint32)_ptr_[ 1 ] << 16) | \
+                      ((uint32)_ptr_[ 2 ] << 8) | (uint32)_ptr_[ 3 ] ; \
+    CCITTCODE *_entry_ ; \
+    \
+    if ( _bits_ > 0 ) \
+      _window_ = ((uint32)theIFaxLastByte( _faxstate ) << ( 32 - _bits_ )) | \
+                 ( _window_ >> _bits_ ) ; \
+    _entry_ = &( theIFaxCheck2DCodes( _faxstate ) ? \
+                 fast2dcodetable : \
+                 ( (_amwhite) ? fastwhitetable : fastblacktable )) \
+      [ _window_ >> ( 32 - CCITTFASTBITS ) ] ; \
+    if ( _entry_->numofbits == CCITTSUBTABLE ) \
+      _entry_ = &fastsubtable[ _entry_->value + \
+                               (( _window_ >> ( 32 - MaxCodeSize )) & \
+                                ( CCITTSUBSIZE - 1 )) ] ; \
+    if ( _entry_->numofbits > 0 ) { \
+      int32 _used_ = _entry_->numofbits - _bits_ ; \
+      if ( _used_ <= 0 ) \
+        theIFaxLastBits( _faxstate ) = -_used_ ; \
+      else { \
+        int32 _bytes_ = ( _used_ + 7 ) >> 3 ; \
+        theIFaxLastByte( _faxstate ) = _ptr_[ _bytes_ - 1 ] ; \
+        theIFaxLastBits( _faxstate ) = ( _bytes_ << 3 ) - _used_ ; \
+        theIPtr( _uflptr_ ) += _bytes_ ; \
+        theICount( _uflptr_ ) -= _bytes_ ; \
+      } \
+      _code = _entry_->value ; \
+      break ; \
+    } \
+  } \
+  \
+  _byte_ = theIFaxLastByte( _faxstate ) ; \
   if ( _bits_ <= CCITTHASHBITS ) { \
-    int32 _nextbyte_ = Getc( theIUnderFile( (_filter) )) ; \
+    int32 _nextbyte_ = Getc( _uflptr_ ) ; \
     if ( _nextbyte_ == EOF ) { \
       if ( _bits_ == 0 ) \
         _code = EOF ; \
@@ -1208,7 +1319,66 @@ MACRO_END
 MACRO_END
 #endif
 
+/* Count the leading zeros of a non-zero word. */
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define CCITT_CLZ32( _v , _n ) MACRO_START \
+  (_n) = __builtin_clz( _v ) ; \
+MACRO_END
+#else
+#define CCITT_CLZ32( _v , _n ) MACRO_START \
+  int32 _hi_ ; \
+  HIGHEST_BIT_SET_32(( _v ) , _hi_ ) ; \
+  (_n) = 31 - _hi_ ; \
+MACRO_END
+#endif
+
+/* Load the 32 bits of a line buffer word in image order, whatever the
+ * byte order of the machine.
+ */
+#define CCITT_LOADBITS( _ptr ) \
+  (((uint32)(_ptr)[ 0 ] << 24) | ((uint32)(_ptr)[ 1 ] << 16) | \
+   ((uint32)(_ptr)[ 2 ] << 8) | (uint32)(_ptr)[ 3 ])
+
+/* Find the first bit at or after bitp with the value of set (all 0s or all
+ * 1s), a word at a time. The back stop markers at the end of the line
+ * buffers stop the search.
+ */
+static inline int32 findnextbit( uint32 *buf , uint32 set , int32 bitp )
+{
+  const uint8 *ptr = ( const uint8 * )( buf + ( bitp >> 5 )) ;
+  uint32 bits = ( CCITT_LOADBITS( ptr ) ^ ~set ) & ( 0xffffffffu >> ( bitp & 31 )) ;
+  int32 lead ;
+
+  bitp &= ~31 ;
+  while ( bits == 0 ) {
+    ptr += 4 ;
+    bitp += 32 ;
+    bits = CCITT_LOADBITS( ptr ) ^ ~set ;
+  }
+  CCITT_CLZ32( bits , lead ) ;
+  return bitp + lead ;
+}
+
+/* Find the first changing element to set at or after bitp: the first bit of
+ * the other value from the bit before bitp onwards, then the first bit of
+ * value set after that.
+ */
 static int32 detectnextbit1( uint32 *buf , int32 set , int32 bitp )
+{
+  bitp = findnextbit( buf , ~( uint32 )set , bitp - 1 ) ;
+  return findnextbit( buf , ( uint32 )set , bitp + 1 ) ;
+}
+
+/* Find the changing element after the next changing element to set. */
+static int32 detectnextbit2( uint32 *buf , int32 set , int32 bitp )
+{
+  bitp = detectnextbit1( buf , set , bitp ) ;
+  return findnextbit( buf , ~( uint32 )set , bitp + 1 ) ;
+}
+
+#if defined( ASSERT_BUILD )
+/* The byte at a time versions, kept to check and time the above against. */
+static int32 detectnextbit1_bytewise( uint32 *buf , int32 set , int32 bitp )
 {
   int32 bits ;
   int32 state ;
@@ -1246,6 +1416,8 @@ static int32 detectnextbit1( uint32 *buf , int32 set , int32 bitp )
   }
 }
 
+#endif
+
 #if defined( ASSERT_BUILD )
 #define TEST_DETECTNEXTEDGE1() \
   int32 check1 = detectnextbit1( theIFaxRefLine( faxstate ) , ~bufset , a1pos ) ;
@@ -1287,7 +1459,8 @@ MACRO_END
   CHCK_DETECTNEXTEDGE1() ; \
 MACRO_END
 
-static int32 detectnextbit2( uint32 *buf , int32 set , int32 bitp )
+#if defined( ASSERT_BUILD )
+static int32 detectnextbit2_bytewise( uint32 *buf , int32 set , int32 bitp )
 {
   int32 bits ;
   int32 state ;
@@ -1328,6 +1501,8 @@ static int32 detectnextbit2( uint32 *buf , int32 set , int32 bitp )
   }
 }
 
+#endif
+
 #if defined( ASSERT_BUILD )
 #define TEST_DETECTNEXTEDGE2() \
   int32 check2 = detectnextbit2( theIFaxRefLine( faxstate ) , ~bufset , a1pos ) ;
@@ -1738,6 +1913,175 @@ static Bool group12D_encode( FILELIST *filter , int32 twodencoding )
   return TRUE ;
 }
 
+#if defined( ASSERT_BUILD )
+/* Look a code up the way the byte at a time decoder does: through the hash
+ * table, then by searching ever longer prefixes of the window.
+ */
+static int32 ccitt_slow_lookup( uint32 window , int32 amwhite ,
+                                int32 check2dcodes , int32 *retval )
+{
+  TERMCODE *hashptr ;
+  int32 bitwidth ;
+
+  hashptr = ( check2dcodes ? hash2dcodetable :
+              ( amwhite ? hashwhitetable : hashblacktable ))
+    [ window >> ( MaxCodeSize - CCITTHASHBITS ) ] ;
+  if ( theINumOfBits( hashptr ) <= CCITTHASHBITS ) {
+    *retval = theICodeValue( hashptr ) ;
+    return theINumOfBits( hashptr ) ;
+  }
+  for ( bitwidth = CCITTHASHBITS + 1 ; bitwidth <= MaxCodeSize ; ++bitwidth ) {
+    if ( searchcodings( bitwidth , ( int32 )( window >> ( MaxCodeSize - bitwidth )) ,
+                        amwhite , check2dcodes , retval ))
+      return bitwidth ;
+  }
+  return 0 ;
+}
+
+static void ccitt_fill_line( uint32 *buf , int32 columns , int32 maxrun ,
+                             uint32 *seed )
+{
+  int32 x = 0 , i ;
+  uint32 set = 0 ;
+
+  for ( i = 0 ; i < ( columns + 31 ) >> 5 ; ++i )
+    buf[ i ] = 0 ;
+  while ( x < columns ) {
+    int32 run ;
+
+    *seed = *seed * 1664525u + 1013904223u ;
+    run = ( int32 )(( *seed >> 8 ) % ( uint32 )maxrun ) + 1 ;
+    if ( run > columns - x )
+      run = columns - x ;
+    if ( set != 0 )
+      CCITTFILL( buf , x , x + run , set ) ;
+    x += run ;
+    set = ~set ;
+  }
+  buf[ ( columns + 31 ) >> 5 ] = 0xAAAAAAAA ;
+}
+
+#define CCITT_TEST_COLUMNS 1000
+
+/* Unit test for the decoder's fast paths. Every window of MaxCodeSize bits
+ * that the two level tables decode must decode to the same code and length
+ * through the hash table and bit by bit search, and the word at a time
+ * changing element detection must match the byte at a time version on
+ * lines with short and long runs, from every starting position.
+ */
+static void ccitt_unit_test( void )
+{
+  uint32 line[ ( CCITT_TEST_COLUMNS + 31 ) / 32 + 2 ] ;
+  uint32 *buf = line + 1 ;
+  uint32 window , seed = 1 ;
+  int32 mode , columns , bitp , trial ;
+
+  for ( mode = 0 ; mode < 4 ; ++mode ) {
+    int32 amwhite = ( mode & 1 ) , check2dcodes = ( mode >> 1 ) ;
+    CCITTCODE *fasttable = check2dcodes ? fast2dcodetable :
+      ( amwhite ? fastwhitetable : fastblacktable ) ;
+
+    for ( window = 0 ; window < ( 1u << MaxCodeSize ) ; ++window ) {
+      CCITTCODE *entry = &fasttable[ window >> CCITTSUBBITS ] ;
+      int32 code = 0 ;
+
+      if ( entry->numofbits == CCITTSUBTABLE )
+        entry = &fastsubtable[ entry->value + ( window & ( CCITTSUBSIZE - 1 )) ] ;
+      if ( entry->numofbits > 0 ) {
+        HQASSERT( ccitt_slow_lookup( window , amwhite , check2dcodes , &code ) ==
+                  entry->numofbits && code == entry->value ,
+                  "CCITT fast code table does not match code search" ) ;
+      }
+    }
+  }
+
+  for ( trial = 0 ; trial < 40 ; ++trial ) {
+    columns = ( int32 )(( trial * 7919u ) % CCITT_TEST_COLUMNS ) + 1 ;
+    ccitt_fill_line( buf , columns , ( trial & 1 ) ? 3 : 200 , &seed ) ;
+    buf[ -1 ] = ( trial & 2 ) ? 0xffffffffu : 0 ;
+    for ( bitp = 0 ; bitp <= columns ; ++bitp ) {
+      int32 a , b , set ;
+
+      for ( set = 0 ; set >= -1 ; --set ) {
+        a = detectnextbit1( buf , set , bitp ) ;
+        b = detectnextbit1_bytewise( buf , set , bitp ) ;
+        HQASSERT( a == b , "detectnextbit1 does not match byte at a time" ) ;
+        a = detectnextbit2( buf , set , bitp ) ;
+        b = detectnextbit2_bytewise( buf , set , bitp ) ;
+        HQASSERT( a == b , "detectnextbit2 does not match byte at a time" ) ;
+      }
+    }
+  }
+}
+
+/* Time the word at a time changing element detection against the byte at
+ * a time version, and the two level code tables against the hash table and
+ * bit by bit search, on lines with short, medium and long runs. Call
+ * interactively in the debugger.
+ */
+void ccitt_benchmark( uint32 repeat )
+{
+  uint32 line[ ( CCITT_TEST_COLUMNS + 31 ) / 32 + 2 ] ;
+  uint32 *buf = line + 1 ;
+  static const int32 maxruns[] = { 4 , 32 , 512 } ;
+  uint32 seed = 1 , i , j ;
+  int32 start , words , bytes , total = 0 ;
+
+  buf[ -1 ] = 0 ;
+  for ( i = 0 ; i < NUM_ARRAY_ITEMS( maxruns ) ; ++i ) {
+    int32 bitp ;
+
+    ccitt_fill_line( buf , CCITT_TEST_COLUMNS , maxruns[ i ] , &seed ) ;
+
+    start = get_rtime() ;
+    for ( j = 0 ; j < repeat ; ++j )
+      for ( bitp = 0 ; bitp < CCITT_TEST_COLUMNS ;
+            bitp = detectnextbit1( buf , ( int32 )( j & 1 ) - 1 , bitp + 1 ))
+        ++total ;
+    words = get_rtime() - start ;
+
+    start = get_rtime() ;
+    for ( j = 0 ; j < repeat ; ++j )
+      for ( bitp = 0 ; bitp < CCITT_TEST_COLUMNS ;
+            bitp = detectnextbit1_bytewise( buf , ( int32 )( j & 1 ) - 1 , bitp + 1 ))
+        --total ;
+    bytes = get_rtime() - start ;
+
+    HQASSERT( total == 0 , "Changing element counts do not match" ) ;
+    monitorf(( uint8 * )"CCITT changing elements, runs up to %d: "
+             "word at a time %d ms, byte at a time %d ms\n" ,
+             maxruns[ i ] , words , bytes ) ;
+  }
+
+  start = get_rtime() ;
+  for ( j = 0 ; j < repeat ; ++j ) {
+    uint32 window ;
+    for ( window = 0 ; window < ( 1u << MaxCodeSize ) ; ++window ) {
+      CCITTCODE *entry = &fastblacktable[ window >> CCITTSUBBITS ] ;
+      if ( entry->numofbits == CCITTSUBTABLE )
+        entry = &fastsubtable[ entry->value + ( window & ( CCITTSUBSIZE - 1 )) ] ;
+      total += entry->value ;
+    }
+  }
+  words = get_rtime() - start ;
+
+  start = get_rtime() ;
+  for ( j = 0 ; j < repeat ; ++j ) {
+    uint32 window ;
+    for ( window = 0 ; window < ( 1u << MaxCodeSize ) ; ++window ) {
+      int32 code = 0 ;
+      ( void )ccitt_slow_lookup( window , FALSE , FALSE , &code ) ;
+      total += code ;
+    }
+  }
+  bytes = get_rtime() - start ;
+
+  monitorf(( uint8 * )"CCITT black code lookup (%d): "
+           "two level tables %d ms, hash and search %d ms\n" ,
+           total , words , bytes ) ;
+}
+#endif
+
 static void ccittfax_encode_filter(FILELIST *flptr)
 {
   HQASSERT(flptr, "No filter to initialise") ;
@@ -1801,7 +2145,12 @@ static Bool ccitt_swstart(struct SWSTART *params)
   HqMemZero(hashblacktable, CCITTHASHSIZE * sizeof(TERMCODE*));
   HqMemZero(hashwhitetable, CCITTHASHSIZE * sizeof(TERMCODE*));
   HqMemZero(hash2dcodetable, CCITTHASHSIZE * sizeof(TERMCODE*));
+  HqMemZero(fastwhitetable, sizeof(fastwhitetable));
+  HqMemZero(fastblacktable, sizeof(fastblacktable));
+  HqMemZero(fast2dcodetable, sizeof(fast2dcodetable));
+  HqMemZero(fastsubtable, sizeof(fastsubtable));
   initfaxdata();
+  ccitt_unit_test();
 
   ccittfax_encode_filter(&flptr[0]) ;
   filter_standard_add(&flptr[0]) ;
@@ -21,6 +21,14 @@ struct core_init_fns ; /* from SWcore */
 
 void jbig2_C_globals(struct core_init_fns *fns) ;
 
+#if defined(ASSERT_BUILD)
+/** Time the fast JBIG2 generic region decoder against the general one, and
+    check they decode the same bitmaps.
+
+    \param repeat The number of times to decode each test region. */
+void jbig2_benchmark(uint32 repeat) ;
+#endif
+
 /** \} */
 
 #endif /* protection for multiple inclusion */
@@ -77,6 +77,7 @@
 #include "jbig2i.h"
 #include "monitor.h"
 #include "ripdebug.h"
+#include "swenv.h"
 #include "namedef_.h"
 #include "ccittfax.h"
 #include "swcopyf.h"
@@ -560,6 +561,100 @@ static Bool jbig2DecodeBuffer(FILELIST *filter, int32 *ret_bytes )
   return TRUE;
 }
 
+#if defined(ASSERT_BUILD)
+/*
+ * Open a read-only file over a block of memory, which returns EOF at the
+ * end of the data.
+ */
+static void jbig2_memory_file(FILELIST *flptr, uint8 *data, int32 len)
+{
+  init_filelist_struct(flptr,
+                       NAME_AND_LENGTH("JBIG2Benchmark"),
+                       READ_FLAG,
+                       0, data, len,
+                       FileError,                          /* fillbuff */
+                       FileFlushBufError,                  /* flushbuff */
+                       FileInitError,                      /* initfile */
+                       FileCloseError,                     /* closefile */
+                       FileDispose,                        /* disposefile */
+                       FileError2,                         /* bytesavail */
+                       FileError,                          /* resetfile */
+                       FileError2,                         /* filepos */
+                       FileError2Const,                    /* setfilepos */
+                       FileError,                          /* flushfile */
+                       FileEncodeError,                    /* filterencode */
+                       FileDecodeError,                    /* filterdecode */
+                       FileLastError,                      /* lasterror */
+                       0, NULL, NULL, NULL) ;
+  theICount(flptr) = len ;
+}
+
+#define JBIG2_BENCH_W    2480 /* A4 width at 300 dpi */
+#define JBIG2_BENCH_H    128
+#define JBIG2_BENCH_DATA (64 * 1024)
+
+/*
+ * Time the fast generic region decoder against the general one, for each
+ * template with and without typical prediction. There is no JBIG2 corpus
+ * to hand, so the coded data is pseudo-random; the arithmetic decoder turns
+ * any data into a plausible bitmap. The two decoders must produce the same
+ * bitmap from the same data. Call interactively in the debugger.
+ */
+void jbig2_benchmark(uint32 repeat)
+{
+  int32 stride = (JBIG2_BENCH_W + 7) >> 3 ;
+  int32 bytes = stride * JBIG2_BENCH_H ;
+  uint8 *data, *fast, *general ;
+  uint32 seed = 1, i ;
+  int32 template, tpgdon ;
+
+  data = (uint8 *)jb2malloc(JBIG2_BENCH_DATA, 0) ;
+  fast = (uint8 *)jb2malloc(bytes, 0) ;
+  general = (uint8 *)jb2malloc(bytes, 0) ;
+  if ( data == NULL || fast == NULL || general == NULL ) {
+    monitorf((uint8 *)"JBIG2 benchmark out of memory\n") ;
+    goto done ;
+  }
+
+  for ( i = 0 ; i < JBIG2_BENCH_DATA ; i++ ) {
+    seed = seed * 1664525u + 1013904223u ;
+    data[i] = (uint8)(seed >> 24) ;
+  }
+
+  for ( template = 0 ; template < 4 ; template++ ) {
+    for ( tpgdon = 0 ; tpgdon < 2 ; tpgdon++ ) {
+      FILELIST flptr ;
+      int32 start, fasttime = 0, generaltime = 0 ;
+
+      for ( i = 0 ; i < repeat ; i++ ) {
+        jbig2_memory_file(&flptr, data, JBIG2_BENCH_DATA) ;
+        start = get_rtime() ;
+        (void)jbig2generic((J2STREAM *)&flptr, template, tpgdon, TRUE,
+                           (char *)fast, JBIG2_BENCH_W, JBIG2_BENCH_H) ;
+        fasttime += get_rtime() - start ;
+
+        jbig2_memory_file(&flptr, data, JBIG2_BENCH_DATA) ;
+        start = get_rtime() ;
+        (void)jbig2generic((J2STREAM *)&flptr, template, tpgdon, FALSE,
+                           (char *)general, JBIG2_BENCH_W, JBIG2_BENCH_H) ;
+        generaltime += get_rtime() - start ;
+
+        HQASSERT(HqMemCmp(fast, bytes, general, bytes) == 0,
+                 "Fast and general JBIG2 generic region decoders differ") ;
+      }
+      monitorf((uint8 *)"JBIG2 generic region, template %d%s: "
+               "fast %d ms, general %d ms\n", template,
+               tpgdon ? " TPGDON" : "", fasttime, generaltime) ;
+    }
+  }
+
+done:
+  jb2free((char *)data) ;
+  jb2free((char *)fast) ;
+  jb2free((char *)general) ;
+}
+#endif
+
 static void init_C_globals_jbig2(void)
 {
 #ifdef DEBUG_BUILD
@@ -870,6 +870,127 @@ static int sltpcontexts[] = {
 #define JBITS(_base, _bitaddr, _shft) ((((_base)[(_bitaddr) >> 3] >> \
                                         (7 - ((_bitaddr) & 7))) & 1) << _shft)
 
+#if defined(ASSERT_BUILD)
+/* Cleared by jbig2generic() to time the general decoder on nominal
+ * templates. */
+static int j2fastregions = 1;
+#else
+#define j2fastregions 1
+#endif
+
+/*
+ * Per-template constants for j2readregion_nominal(): the mask of the context
+ * bits that survive the shift to the next pixel, and for each of the two rows
+ * above, the shift bringing the new pixel to its place in the context and
+ * the bit it lands on.
+ */
+static int nommasks[] = { 0xf7ef, 0x1df7, 0x37b, 0x3ef };
+static int nomshifts1[] = { 7, 8, 10, 8 };
+static int nombits1[] = { 0x10, 0x08, 0x04, 0x10 };
+static int nomshifts2[] = { 9, 11, 14, 9 };
+static int nombits2[] = { 0x800, 0x200, 0x80, 0 };
+
+/*
+ * Decodes a bitmap using arithmetic coding, for a template with its adaptive
+ * pixels in their nominal places and no skip bitmap. This is what almost all
+ * generic regions and symbols use.
+ *
+ * Rather than reading each pixel from the rows above out of the bitmap, the
+ * two bytes of each row spanning the pixels the context needs are held in a
+ * word, which slides along a byte at a time. line1 holds the row above in
+ * its low 16 bits, line2 the row above that in bits 8 to 23, so the pixel
+ * entering the context for pixel m of the current byte is a fixed shift
+ * less m away from its place in the context. Pixels past the end of a row
+ * are always zero. The context is laid out exactly as j2readregion() lays
+ * it out, so retained contexts can be shared between the two.
+ */
+static int j2readregion_nominal(J2FSTATE *fsp, J2BITMAP *dest, int template,
+                                int tpgdon, uchar * contexts)
+{
+  uchar *dp, *up1, *up2;
+  int d, m, n, x, y, b;
+  int ltp, prev, thisbyte;
+  int mask, shift1, bit1, shift2, bit2;
+  unsigned int line1, line2;
+  int w, h, stride;
+
+  w = dest->w;
+  h = dest->h;
+  stride = dest->stride;
+  JB2ASSERT(stride == (w + 7) >> 3, "JBIG2 region stride does not match width");
+
+  mask = nommasks[template];
+  shift1 = nomshifts1[template];
+  bit1 = nombits1[template];
+  shift2 = nomshifts2[template];
+  bit2 = nombits2[template];
+
+  ltp = 0;
+  dp = dest->base;
+  for (y = 0; y < h; y++, dp += stride)
+  {
+    if (tpgdon)
+    {
+      ltp ^= j2iabit(fsp, contexts, sltpcontexts[template]);
+      if (ltp)
+      {
+        if (y == 0)
+          jb2zero((char *)dp, stride);
+        else
+          jb2copy((char *)dp - stride, (char *)dp, stride);
+        continue;
+      }
+    }
+
+    up1 = (y > 0) ? dp - stride : 0;
+    up2 = (y > 1 && template != 3) ? dp - 2 * stride : 0;
+    line1 = up1 ? up1[0] : 0;
+    line2 = up2 ? up2[0] << 8 : 0;
+
+    switch (template)
+    {
+      case 0:
+        prev = (line1 & 0xf0) | ((line2 >> 2) & 0x3800);
+        break;
+      case 1:
+        prev = ((line1 >> 1) & 0x78) | ((line2 >> 4) & 0xe00);
+        break;
+      case 2:
+        prev = ((line1 >> 3) & 0x1c) | ((line2 >> 7) & 0x180);
+        break;
+      default:
+        prev = (line1 >> 1) & 0x70;
+        break;
+    }
+
+    for (x = 0, b = 0; x < w; x += 8, b++)
+    {
+      line1 <<= 8;
+      line2 <<= 8;
+      if (b + 1 < stride)
+      {
+        if (up1)
+          line1 |= up1[b + 1];
+        if (up2)
+          line2 |= up2[b + 1] << 8;
+      }
+
+      n = (w - x < 8) ? w - x : 8;
+      thisbyte = 0;
+      for (m = 0; m < n; m++)
+      {
+        d = j2iabit(fsp, contexts, prev);
+        thisbyte |= d << (7 - m);
+        prev = (((prev << 1) | d) & mask) |
+               ((line1 >> (shift1 - m)) & bit1) |
+               ((line2 >> (shift2 - m)) & bit2);
+      }
+      dp[b] = (uchar)thisbyte;
+    }
+  }
+  return (1);
+}
+
 /*
  * Decodes a bitmap using arithmetic coding.
  */
@@ -919,6 +1040,9 @@ static int j2readregion(J2FSTATE *fsp, J2BITMAP *dest, int template,
       break;
   }
 
+  if (nominal && !skip && j2fastregions)
+    return j2readregion_nominal(fsp, dest, template, tpgdon, contexts);
+
   prev = 0;
   ltp = 0;
 
@@ -1896,6 +2020,72 @@ static int j2readsidht(J2FSTATE *fsp, int numsyms, J2HTAB **rp)
   return (1);
 }
 
+/*
+ * Combine one byte of the source with the destination under a mask, for each
+ * of the combination operators. With a constant mask of 0xff the masking
+ * folds away.
+ */
+#define J2ROP_OR(_d, _s, _m)   ((_d) | ((_s) & (_m)))
+#define J2ROP_AND(_d, _s, _m)  ((_d) & ((_s) | ~(_m)))
+#define J2ROP_XOR(_d, _s, _m)  ((_d) ^ ((_s) & (_m)))
+#define J2ROP_XNOR(_d, _s, _m) (((_d) & ~(_m)) | (~((_d) ^ (_s)) & (_m)))
+#define J2ROP_REPLACE(_d, _s, _m) (((_d) & ~(_m)) | ((_s) & (_m)))
+
+/*
+ * The row loop of j2dorop(), expanded once for each operator so that the
+ * operator is not switched on for every byte. When the source and
+ * destination are aligned, the middle of each row is combined without any
+ * shifting.
+ */
+#define J2DOROP_ROWS(_rop) \
+  for (k = 0; k < h; k++) \
+  { \
+    dp = drow; \
+    sp = srow; \
+    sbits1 = *sp++ << (8 + shift); \
+    if (shift > 0) \
+      sbits1 |= *sp++ << shift; \
+    sbits = sbits1 >> 8; \
+    dp[0] = (uchar)_rop(dp[0], sbits, lmask); \
+    dp++; \
+    if (shift == 0) \
+    { \
+      for (j = 0; j < bw; j++) \
+        dp[j] = (uchar)_rop(dp[j], sp[j], 0xff); \
+      dp += bw; \
+      sp += bw; \
+    } \
+    else if (shift < 0) \
+    { \
+      for (j = 0; j < bw; j++) \
+      { \
+        sbits1 = (sbits1 << 8) | *sp++ << (8 + shift); \
+        *dp = (uchar)_rop(*dp, sbits1 >> 8, 0xff); \
+        dp++; \
+      } \
+    } \
+    else \
+    { \
+      for (j = 0; j < bw; j++) \
+      { \
+        sbits1 = (sbits1 << 8) | *sp++ << shift; \
+        *dp = (uchar)_rop(*dp, sbits1 >> 8, 0xff); \
+        dp++; \
+      } \
+    } \
+    if (rmask) \
+    { \
+      if (shift <= 0) \
+        sbits1 = (sbits1 << 8) | *sp++ << (8 + shift); \
+      else \
+        sbits1 = (sbits1 << 8) | *sp++ << shift; \
+      sbits = sbits1 >> 8; \
+      dp[0] = (uchar)_rop(dp[0], sbits, rmask); \
+    } \
+    drow += dstride; \
+    srow += sstride; \
+  }
+
 /*
  * Combines two region bitmaps.
  */
@@ -1963,101 +2153,27 @@ static void j2dorop(J2BITMAP *bms, J2BITMAP *dest, int dx, int dy, int rop)
     lmask &= rmask;
     rmask = 0;
   }
-  for (k = 0; k < h; k++)
+  switch (rop)
   {
-    dp = drow;
-    sp = srow;
-    sbits1 = *sp++ << (8 + shift);
-    if (shift > 0)
-      sbits1 |= *sp++ << shift;
-    sbits = sbits1 >> 8;
-    switch (rop)
-    {
-      case J2_ROP_OR:
-        *dp++ |= sbits & lmask;
-        break;
-
-      case J2_ROP_AND:
-        *dp++ &= sbits | ~lmask;
-        break;
-
-      case J2_ROP_XOR:
-        *dp++ ^= sbits & lmask;
-        break;
-
-      case J2_ROP_XNOR:
-        dp[0] = (uchar)((dp[0] & ~lmask)|((~(dp[0] ^ sbits)) & lmask));
-        dp++;
-        break;
-
-      case J2_ROP_REPLACE:
-        dp[0] = (uchar)((dp[0] & ~lmask) | (sbits & lmask));
-        dp++;
-        break;
-    }
-    for (j = 0; j < bw; j++)
-    {
-      if (shift <= 0)
-        sbits1 = (sbits1 << 8) | *sp++ << (8 + shift);
-      else
-        sbits1 = (sbits1 << 8) | *sp++ << shift;
-      sbits = sbits1 >> 8;
-      switch (rop)
-      {
-        case J2_ROP_OR:
-          *dp++ |= sbits;
-          break;
-
-        case J2_ROP_AND:
-          *dp++ &= sbits;
-          break;
-
-        case J2_ROP_XOR:
-          *dp++ ^= sbits;
-          break;
-
-        case J2_ROP_XNOR:
-          dp[0] = (uchar)(~(dp[0] ^ sbits));
-          dp++;
-          break;
-
-        case J2_ROP_REPLACE:
-          *dp++ = (uchar)sbits;
-          break;
-      }
-    }
-    if (rmask)
-    {
-      if (shift <= 0)
-          sbits1 = (sbits1 << 8) | *sp++ << (8 + shift);
-      else
-          sbits1 = (sbits1 << 8) | *sp++ << shift;
-      sbits = sbits1 >> 8;
-      switch (rop)
-      {
-        case J2_ROP_OR:
-          dp[0] |= sbits & rmask;
-          break;
+    case J2_ROP_OR:
+      J2DOROP_ROWS(J2ROP_OR);
+      break;
 
-        case J2_ROP_AND:
-          dp[0] &= sbits | ~rmask;
-          break;
+    case J2_ROP_AND:
+      J2DOROP_ROWS(J2ROP_AND);
+      break;
 
-        case J2_ROP_XOR:
-          dp[0] ^= sbits & rmask;
-          break;
+    case J2_ROP_XOR:
+      J2DOROP_ROWS(J2ROP_XOR);
+      break;
 
-        case J2_ROP_XNOR:
-          dp[0] = (uchar)((dp[0] & ~rmask) | ((~(dp[0] ^ sbits)) & rmask));
-          break;
+    case J2_ROP_XNOR:
+      J2DOROP_ROWS(J2ROP_XNOR);
+      break;
 
-        case J2_ROP_REPLACE:
-          dp[0] = (uchar)((dp[0] & ~rmask) | (sbits & rmask));
-          break;
-      }
-    }
-    drow += dstride;
-    srow += sstride;
+    case J2_ROP_REPLACE:
+      J2DOROP_ROWS(J2ROP_REPLACE);
+      break;
   }
 }
 
@@ -4419,6 +4535,50 @@ int jbig2close(J2STREAM *inputstream)
     return (0);
 }
 
+#if defined(ASSERT_BUILD)
+/*
+ * Decodes the given stream as the arithmetic coded data of a generic region
+ * using a template with nominal adaptive pixels, through either the fast
+ * decoder or the general one. Used by the API layer to time and cross-check
+ * the two.
+ */
+int jbig2generic(J2STREAM *f, int template, int tpgdon, int fast,
+                 char *base, int w, int h)
+{
+  static schar nominal[4][8] = {
+    { 3, -1, -3, -1, 2, -2, -2, -2 }, { 3, -1 }, { 2, -1 }, { 2, -1 },
+  };
+  J2FSTATE fstate;
+  J2BITMAP region;
+  uchar *contexts;
+  int r;
+
+  contexts = (uchar *)jb2malloc(1 << jatemplatebits[template], 1);
+  if (!contexts)
+    return (-1);
+
+  region.w = w;
+  region.h = h;
+  region.left = 0;
+  region.stride = (w + 7) >> 3;
+  region.base = (uchar *)base;
+  region.free_it = 0;
+
+  j2initbitstream(&fstate.in, f);
+  fstate.huff = 0;
+  r = j2seedia(&fstate);
+  if (r > 0)
+  {
+    j2fastregions = fast;
+    r = j2readregion(&fstate, &region, template, tpgdon, contexts,
+                     nominal[template], (uchar *) 0);
+    j2fastregions = 1;
+  }
+  jb2free((char *)contexts);
+  return (r);
+}
+#endif
+
 /*
  * Restarted log with new port of code from Jaws.
  *
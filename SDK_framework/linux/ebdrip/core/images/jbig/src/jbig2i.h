@@ -78,6 +78,11 @@ void *jbig2open(J2STREAM *f);
 int jbig2read(J2STREAM *f);
 int jbig2close(J2STREAM *f);
 
+#if defined(ASSERT_BUILD)
+int jbig2generic(J2STREAM *f, int template, int tpgdon, int fast,
+                 char *base, int w, int h);
+#endif
+
 #endif /* protection for multiple inclusion */
 
 /*
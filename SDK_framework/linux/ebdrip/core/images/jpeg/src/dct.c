@@ -477,6 +477,8 @@ static void dctFilterDispose( FILELIST *filter )
     if ( state->jpeg_api != NULL && state->jpeg_api_data != NULL )
       state->jpeg_api->decompress_close(&state->jpeg_api_data);
 
+    dct_segments_free(state);
+
     if (state->RSD) {
       FILELIST * ufptr, * rsd;
 
@@ -1075,6 +1077,8 @@ static Bool jpeg_swstart(struct SWSTART *params)
 
   UNUSED_PARAM(struct SWSTART*, params) ;
 
+  dct_simd_unit_test() ;
+
   if ( (flptr = mm_alloc_static(sizeof(FILELIST) * 2)) == NULL )
     return FALSE ;
 
@@ -21,6 +21,7 @@ typedef struct scaninfo scaninfo ;
 typedef struct huffgroup_t huffgroup_t ;
 typedef struct DCTSTATE DCTSTATE ;
 typedef struct BITBUFFER BITBUFFER;
+typedef struct dct_segments_t dct_segments_t ;
 
 /*
  * The encoding filter status
@@ -147,6 +148,19 @@ enum {
 
 #define OVERSH(x)   ((x) << LG2_OVERSCALE)
 
+/**
+ * 8 unique elements of inverse dct matrix,
+ * where Ax = C(x)*cos(PI*x/16) [ C(x) = (x == 0 ? 1/sqrt(2) : 1) ]
+ */
+#define A0 0x5A82
+#define A1 0x7D8A
+#define A2 0x7642
+#define A3 0x6A6E
+#define A4 0x5A82
+#define A5 0x471D
+#define A6 0x30FC
+#define A7 0x18F9
+
 
 /* Bit buffer is currently 8 bits. Performance may be improved by moving to
  * a 32 bit buffer. So introduced these defines as a first step in that
@@ -24,11 +24,15 @@
 #include "filterinfo.h"
 #include "rsd.h"
 #include "tables.h"
+#include "swtrace.h"
+#include "taskh.h"
+#include "ripmulti.h"
 
 #include "dct.h"
 #include "dctimpl.h"
 #include "gu_dct.h"
 #include "gu_splat.h"
+#include "gu_simd.h"
 
 #include "namedef_.h"
 #include "objstack.h"
@@ -97,6 +101,13 @@ static Bool decode_progressive(DCTSTATE *dct, FILELIST *flptr);
 
 static Bool process_restart( register DCTSTATE *dct, FILELIST *flptr );
 
+typedef int32 (*DECODE_MDU_FN)( DCTSTATE *dct , FILELIST *flptr ) ;
+
+static Bool decode_MDU_row( DCTSTATE *dct , FILELIST *flptr ,
+                            uint8 *buffer , DECODE_MDU_FN decode_MDU ) ;
+static Bool dct_segments_row( FILELIST *filter , DCTSTATE *dct ,
+                              int32 *ret_bytes , Bool *delivered ) ;
+
 static Bool fetch_zigzag(DCTSTATE *dct, FILELIST *flptr, scaninfo * info);
 
 static DCT_RESULT skip_baseline_zigzag(DCTSTATE *dct, FILELIST *flptr,
@@ -2294,7 +2305,7 @@ static int32 extend_offset[16] = { /* entry n is (-1 << n) + 1 */
   ((-1)<<13) + 1, ((-1)<<14) + 1, ((-1)<<15) + 1
 };
 
-static void (*splat_array[64])(register int32 value) =
+static void (*splat_array[64])(int32 tile[8][8], register int32 value) =
 {
   splat_00,
   splat_01, splat_10,
@@ -2341,7 +2352,7 @@ static Bool decode_progressive(DCTSTATE *dct, FILELIST *flptr)
     register QUANTTABLE qtable = dct->quanttables[(int32)dct->current_ci->qtable_number];
 
     for (i = 0;i < 64;i++)
-      splat_array[i](dct->coeffs[i]*qtable[i]);
+      splat_array[i](dct->tile, dct->coeffs[i]*qtable[i]);
   }
 
   return TRUE;
@@ -2397,9 +2408,9 @@ static DCT_RESULT decode_zigzag_band_DC(DCTSTATE *dct,
     register QUANTTABLE qtable = dct->quanttables[(int32)dct->current_ci->qtable_number];
 
     if ( r != 0 )
-      splat_00((r << info->Al)*qtable[0]);
+      splat_00(dct->tile, (r << info->Al)*qtable[0]);
     else
-      zero_tile();
+      zero_tile(dct->tile);
   }
 
   dct->current_ci->dc_prediction = ( int16 )r;
@@ -2447,7 +2458,7 @@ static DCT_RESULT decode_zigzag_band_AC(DCTSTATE *dct,
       if (dct->successive) {
         dct->coeffs[k] = r << info->Al;
       } else {
-        splat_array[k]((r << info->Al)*qtable[k]);
+        splat_array[k](dct->tile, (r << info->Al)*qtable[k]);
       }
 
     } else {
@@ -3798,19 +3809,6 @@ static DCT_RESULT jpg_ac_dc(DCTSTATE *dct, FILELIST *flptr, scaninfo *info,
   return jpg_decode_ac(dct, flptr, info, dctlist);
 }
 
-/**
- * 8 unique elements of inverse dct matrix,
- * where Ax = C(x)*cos(PI*x/16) [ C(x) = (x == 0 ? 1/sqrt(2) : 1) ]
- */
-#define A0 0x5A82
-#define A1 0x7D8A
-#define A2 0x7642
-#define A3 0x6A6E
-#define A4 0x5A82
-#define A5 0x471D
-#define A6 0x30FC
-#define A7 0x18F9
-
 /**
  * Convert a zig-zag index into a regular index
  */
@@ -3919,12 +3917,12 @@ static void jpg_calc_idct(DCTSTATE *dct, DCTLIST *dctlist)
   if ( !new_jpg_idct )
   {
     if ( dctlist->nc == 0 || dctlist->coeff[0].zzi != 0 )
-      zero_tile();
+      zero_tile(dct->tile);
     for ( i = 0; i < dctlist->nc ; i++ )
     {
       int zzi = dctlist->coeff[i].zzi;
 
-      splat_array[zzi](dctlist->coeff[i].val*qtable[zzi]);
+      splat_array[zzi](dct->tile, dctlist->coeff[i].val*qtable[zzi]);
     }
     return;
   }
@@ -3940,23 +3938,23 @@ static void jpg_calc_idct(DCTSTATE *dct, DCTLIST *dctlist)
    */
   if ( dctlist->nc == 0 )
   {
-    zero_tile();
+    zero_tile(dct->tile);
     return;
   }
   else if ( dctlist->nc == 1 && dctlist->coeff[0].zzi == 0 )
   {
-    splat_array[0]((int32)dctlist->coeff[0].val*qtable[0]);
+    splat_array[0](dct->tile, (int32)dctlist->coeff[0].val*qtable[0]);
     return;
   }
   else if ( dctlist->nc <= 16 )
   {
     if ( dctlist->coeff[0].zzi != 0 )
-      zero_tile();
+      zero_tile(dct->tile);
     for ( i = 0; i < dctlist->nc ; i++ )
     {
       int32 zzi = dctlist->coeff[i].zzi;
 
-      splat_array[zzi](dctlist->coeff[i].val*qtable[zzi]);
+      splat_array[zzi](dct->tile, dctlist->coeff[i].val*qtable[zzi]);
     }
     return;
   }
@@ -3980,6 +3978,9 @@ static void jpg_calc_idct(DCTSTATE *dct, DCTLIST *dctlist)
     dtrans[unzig[zz_i]] = dctlist->coeff[i].val * qtable[zz_i];
   }
 
+  if ( dct_simd_idct(dtrans, dct->tile) )
+    return;
+
   /**
    * The two linear transforms have been unrolled and the dct array elements
    * put in explicitly. Then the 64 DCT elements have been reduced to the
@@ -4034,7 +4035,7 @@ static void jpg_calc_idct(DCTSTATE *dct, DCTLIST *dctlist)
     tile[6][i] = ((v[6] + (1<<3)) >> 4);
     tile[7][i] = ((v[7] + (1<<3)) >> 4);
   }
-  splat_tile(tile);
+  splat_tile(dct->tile, tile);
 }
 
 /**
@@ -5037,14 +5038,14 @@ static Bool decode_MDU_normal(DCTSTATE *dct, FILELIST *flptr)
     dct->h = 0;
     if ( decode_normal_zigzag( dct , flptr , info) < 0 )
       return FALSE ;
-    unfix_tile( r_ptr, 8);
+    unfix_tile(dct->tile, r_ptr, 8);
     if ( dct->dct_status == GOT_EOI )
       return TRUE;
 
     dct->h = 1;
     if ( decode_normal_zigzag( dct , flptr , info) < 0 )
       return FALSE ;
-    unfix_tile( r_ptr+8, 8);
+    unfix_tile(dct->tile, r_ptr+8, 8);
     if ( dct->dct_status == GOT_EOI )
       return TRUE;
 
@@ -5052,14 +5053,14 @@ static Bool decode_MDU_normal(DCTSTATE *dct, FILELIST *flptr)
     dct->h = 0;
     if ( decode_normal_zigzag( dct , flptr , info) < 0 )
      return FALSE ;
-    unfix_tile( r_ptr+128, 8);
+    unfix_tile(dct->tile, r_ptr+128, 8);
     if ( dct->dct_status == GOT_EOI )
       return TRUE;
 
     dct->h = 1;
     if ( decode_normal_zigzag( dct , flptr , info) < 0 )
       return FALSE ;
-    unfix_tile( r_ptr+136, 8);
+    unfix_tile(dct->tile, r_ptr+136, 8);
     if ( dct->dct_status == GOT_EOI )
       return TRUE;
 
@@ -5077,7 +5078,7 @@ static Bool decode_MDU_normal(DCTSTATE *dct, FILELIST *flptr)
     r_ptr = ci->mdu_block;
     if ( decode_normal_zigzag( dct , flptr , info) < 0 )
       return FALSE ;
-    unfix_tile( r_ptr, 0 );
+    unfix_tile(dct->tile, r_ptr, 0 );
     if ( dct->dct_status == GOT_EOI )
       return TRUE;
 
@@ -5093,7 +5094,7 @@ static Bool decode_MDU_normal(DCTSTATE *dct, FILELIST *flptr)
     r_ptr = ci->mdu_block;
     if ( decode_normal_zigzag( dct , flptr , info) < 0 )
       return FALSE ;
-    unfix_tile( r_ptr, 0 );
+    unfix_tile(dct->tile, r_ptr, 0 );
     if ( dct->dct_status == GOT_EOI )
       return TRUE;
 
@@ -5137,7 +5138,7 @@ static Bool decode_MDU_normal(DCTSTATE *dct, FILELIST *flptr)
         for ( dct->h = 0 ; dct->h < hsamples ; dct->h++ ) {
           if ( decode_normal_zigzag( dct , flptr , info) < 0 )
             return FALSE ;
-          unfix_tile( (int32 *)dct_block, 0 );
+          unfix_tile(dct->tile, (int32 *)dct_block, 0 );
           if ( dct->dct_status == GOT_EOI )
             return TRUE;
 
@@ -5227,7 +5228,7 @@ static Bool decode_MDU_progressive(DCTSTATE *dct, FILELIST *flptr)
       for ( dct->h = 0 ; dct->h < hsamples ; dct->h++ ) {
         if (! decode_progressive( dct , flptr))
           return FALSE ;
-        unfix_tile( (int32 *)dct_block, 0 );
+        unfix_tile(dct->tile, (int32 *)dct_block, 0 );
 
 
         /* up sample by v_skip * h_skip */
@@ -5309,9 +5310,9 @@ static void decode_MDU_prog_rejigged_inverse( DCTSTATE *dct )
                       (64 * ((l * hsamples) + h + (v * ci->num_hsamples) ) );
 
           for (i = 0;i < 64;i++)  {
-            splat_array[i](dct->coeffs[i]*qtable[i]);
+            splat_array[i](dct->tile, dct->coeffs[i]*qtable[i]);
           }
-          unfix_tile( (int32 *)dct_block, 0 );
+          unfix_tile(dct->tile, (int32 *)dct_block, 0 );
 
           /* up sample by v_skip * h_skip */
           /* v_shift and h_shift downsample to dct_block */
@@ -5512,7 +5513,7 @@ static Bool decode_MDU_noninterleaved(DCTSTATE *dct, FILELIST *flptr)
       for ( h = 0 ; h < hsamples ; h++ ) {
         if (! decode_noninterleaved( dct , flptr, info))
           return FALSE ;
-        unfix_tile( (int32 *)dct_block, 0 );
+        unfix_tile(dct->tile, (int32 *)dct_block, 0 );
         /* up sample by v_skip * h_skip */
         /* v_shift and h_shift downsample to dct_block */
 
@@ -5536,6 +5537,553 @@ static Bool decode_MDU_noninterleaved(DCTSTATE *dct, FILELIST *flptr)
 }
 
 
+/* ----------------------------------------------------------------------------
+   Restart segments
+
+   Each restart interval of a baseline scan starts with fresh DC predictions
+   and an empty bit buffer, so intervals can be decoded independently. Whole
+   MDU rows are gathered into segments which start and end on restart
+   boundaries. The entropy-coded data for a batch of segments is copied out
+   of the underlying file, and each segment is decoded by its own task into a
+   private copy of the decoder state. The decoded rows are then handed to the
+   filter buffer one MDU row at a time, in the same order and with the same
+   failures as the serial decoder would have produced them. The last MDU row
+   of the image is always decoded serially, so end of image handling is
+   unchanged.
+---------------------------------------------------------------------------- */
+
+/** Number of segments in a batch for each thread. */
+#define DCT_SEGMENTS_PER_THREAD 2
+
+/** Limit on the decoded pixel memory held by a batch of segments. */
+#define DCT_SEGMENTS_MEMORY (8 * 1024 * 1024)
+
+/** Initial size of a segment's entropy-coded data buffer. */
+#define DCT_SEGMENT_DATA_MIN 4096
+
+enum {
+  DCT_SEGMENT_OK,      /**< All rows of the segment were decoded. */
+  DCT_SEGMENT_EOI,     /**< An EOI marker ended the segment early. */
+  DCT_SEGMENT_ERROR    /**< The segment's entropy-coded data was bad. */
+} ;
+
+typedef struct dct_segment_t {
+  DCTSTATE state ;         /**< Private copy of the decoder state. */
+  int32 *mdu_blocks[4] ;   /**< Private MDU blocks for the state copy. */
+  FILELIST file ;          /**< Memory file reading the segment data. */
+  uint8 *data ;            /**< Entropy-coded data and restart markers. */
+  int32 data_size ;        /**< Allocated size of data. */
+  int32 data_len ;         /**< Number of bytes of data used. */
+  uint8 *pixels ;          /**< Decoded MDU rows, one after another. */
+  int32 rows ;             /**< Number of MDU rows to decode. */
+  int32 rows_done ;        /**< Number of MDU rows completely decoded. */
+  int32 result ;           /**< DCT_SEGMENT_* result of the decode. */
+  Bool decoded ;           /**< Has the segment been decoded? */
+} dct_segment_t ;
+
+struct dct_segments_t {
+  dct_segment_t *segments ; /**< Array of segments. */
+  int32 max_segments ;      /**< Size of the segment array. */
+  int32 nsegments ;         /**< Number of segments in the current batch. */
+  int32 rows_per_segment ;  /**< MDU rows in each segment. */
+  int32 intervals ;         /**< Restart intervals in each segment. */
+  int32 blocksize ;         /**< Size of each component's MDU block. */
+  int32 rowbytes ;          /**< Bytes in one decoded MDU row. */
+  int32 current ;           /**< Segment being delivered. */
+  int32 current_row ;       /**< MDU row being delivered in that segment. */
+  Bool restart_error ;      /**< Serial decoding would fail after the batch. */
+  Bool finished ;           /**< No more batches will be decoded. */
+} ;
+
+/** Are restart segments decoded in parallel? */
+static Bool dct_parallel_restarts = TRUE ;
+
+static void dct_segments_free_array(dct_segments_t *segs)
+{
+  int32 i, c ;
+
+  if ( segs->segments == NULL )
+    return ;
+
+  for ( i = 0 ; i < segs->max_segments ; i++ ) {
+    dct_segment_t *seg = &segs->segments[i] ;
+
+    for ( c = 0 ; c < 4 ; c++ ) {
+      if ( seg->mdu_blocks[c] != NULL )
+        mm_free(mm_pool_temp, (mm_addr_t)seg->mdu_blocks[c], segs->blocksize) ;
+    }
+    if ( seg->data != NULL )
+      mm_free(mm_pool_temp, (mm_addr_t)seg->data, seg->data_size) ;
+    if ( seg->pixels != NULL )
+      mm_free(mm_pool_temp, (mm_addr_t)seg->pixels,
+              segs->rowbytes * segs->rows_per_segment) ;
+  }
+  mm_free(mm_pool_temp, (mm_addr_t)segs->segments,
+          segs->max_segments * sizeof(dct_segment_t)) ;
+  segs->segments = NULL ;
+  segs->max_segments = 0 ;
+}
+
+void dct_segments_free(DCTSTATE *dct)
+{
+  if ( dct->segments != NULL ) {
+    dct_segments_free_array(dct->segments) ;
+    mm_free(mm_pool_temp, (mm_addr_t)dct->segments, sizeof(dct_segments_t)) ;
+    dct->segments = NULL ;
+  }
+}
+
+/**
+ * Create the segment state for a scan. If the restart intervals do not line
+ * up with MDU rows, or there isn't enough memory, the state is returned
+ * marked as finished so that the scan is decoded serially.
+ */
+static dct_segments_t *dct_segments_create(DCTSTATE *dct)
+{
+  dct_segments_t *segs ;
+  int32 mdus_per_row, segbytes, nsegs, i, c ;
+
+  segs = mm_alloc(mm_pool_temp, sizeof(dct_segments_t),
+                  MM_ALLOC_CLASS_DCT_BUFFER) ;
+  if ( segs == NULL )
+    return NULL ;
+
+  HqMemZero(segs, sizeof(dct_segments_t)) ;
+  segs->finished = TRUE ;
+  dct->segments = segs ;
+
+  mdus_per_row = ((int32)dct->columns + (int32)dct->cols_in_MDU - 1) /
+                 (int32)dct->cols_in_MDU ;
+  if ( dct->restart_interval % mdus_per_row == 0 ) {
+    segs->rows_per_segment = dct->restart_interval / mdus_per_row ;
+    segs->intervals = 1 ;
+  } else if ( mdus_per_row % dct->restart_interval == 0 ) {
+    segs->rows_per_segment = 1 ;
+    segs->intervals = mdus_per_row / dct->restart_interval ;
+  } else {
+    return segs ;
+  }
+
+  segs->blocksize = 64 * dct->max_hsamples * dct->max_vsamples * sizeof(int32) ;
+  segs->rowbytes = dct->bytes_in_scanline * (int32)dct->rows_in_MDU ;
+  segbytes = segs->rowbytes * segs->rows_per_segment ;
+  nsegs = NUM_THREADS() * DCT_SEGMENTS_PER_THREAD ;
+  if ( nsegs > DCT_SEGMENTS_MEMORY / segbytes )
+    nsegs = DCT_SEGMENTS_MEMORY / segbytes ;
+  if ( nsegs < 2 )
+    return segs ;
+
+  segs->segments = mm_alloc(mm_pool_temp, nsegs * sizeof(dct_segment_t),
+                            MM_ALLOC_CLASS_DCT_BUFFER) ;
+  if ( segs->segments == NULL )
+    return segs ;
+
+  HqMemZero(segs->segments, nsegs * sizeof(dct_segment_t)) ;
+  segs->max_segments = nsegs ;
+
+  for ( i = 0 ; i < nsegs ; i++ ) {
+    dct_segment_t *seg = &segs->segments[i] ;
+
+    seg->pixels = mm_alloc(mm_pool_temp, segbytes, MM_ALLOC_CLASS_DCT_BUFFER) ;
+    if ( seg->pixels == NULL ) {
+      dct_segments_free_array(segs) ;
+      return segs ;
+    }
+    for ( c = 0 ; c < (int32)dct->num_mdublocks ; c++ ) {
+      seg->mdu_blocks[c] = mm_alloc(mm_pool_temp, segs->blocksize,
+                                    MM_ALLOC_CLASS_DCT_BUFFER) ;
+      if ( seg->mdu_blocks[c] == NULL ) {
+        dct_segments_free_array(segs) ;
+        return segs ;
+      }
+    }
+  }
+
+  segs->finished = FALSE ;
+  return segs ;
+}
+
+/**
+ * Start a segment at the given image row, using a copy of the serial
+ * decoder state.
+ */
+static void dct_segment_start(DCTSTATE *dct, dct_segments_t *segs,
+                              dct_segment_t *seg, uint32 row,
+                              int32 restart_num)
+{
+  int32 c ;
+
+  seg->state = *dct ;
+  seg->state.segments = NULL ;
+  seg->state.currinfo = &seg->state.default_info ;
+  seg->state.current_row = row ;
+  seg->state.next_restart_num = restart_num ;
+  for ( c = 0 ; c < (int32)dct->num_mdublocks ; c++ )
+    seg->state.components[c].mdu_block = seg->mdu_blocks[c] ;
+
+  seg->data_len = 0 ;
+  seg->rows = segs->rows_per_segment ;
+  seg->rows_done = 0 ;
+  seg->result = DCT_SEGMENT_ERROR ;
+  seg->decoded = FALSE ;
+}
+
+/** Append a byte to a segment's data, growing the buffer if needed. */
+static Bool dct_segment_put(dct_segment_t *seg, int32 c)
+{
+  if ( seg->data_len == seg->data_size ) {
+    int32 size = seg->data_size == 0 ? DCT_SEGMENT_DATA_MIN
+                                     : seg->data_size * 2 ;
+    uint8 *data = mm_alloc(mm_pool_temp, size, MM_ALLOC_CLASS_DCT_BUFFER) ;
+
+    if ( data == NULL )
+      return FALSE ;
+
+    if ( seg->data != NULL ) {
+      HqMemCpy(data, seg->data, seg->data_len) ;
+      mm_free(mm_pool_temp, (mm_addr_t)seg->data, seg->data_size) ;
+    }
+    seg->data = data ;
+    seg->data_size = size ;
+  }
+  seg->data[seg->data_len++] = (uint8)c ;
+  return TRUE ;
+}
+
+/** Task function decoding the MDU rows of one segment. */
+static Bool dct_segment_decode(corecontext_t *context, void *args)
+{
+  dct_segment_t *seg = args ;
+  DCTSTATE *dct = &seg->state ;
+  int32 rowbytes = dct->bytes_in_scanline * (int32)dct->rows_in_MDU ;
+  uint8 *pixels = seg->pixels ;
+
+  UNUSED_PARAM(corecontext_t *, context) ;
+
+  seg->result = DCT_SEGMENT_OK ;
+  for ( seg->rows_done = 0 ; seg->rows_done < seg->rows ; seg->rows_done++ ) {
+    if ( ! decode_MDU_row(dct, &seg->file, pixels, decode_MDU_normal) ) {
+      seg->result = DCT_SEGMENT_ERROR ;
+      break ;
+    }
+    if ( dct->dct_status == GOT_EOI ) {
+      seg->result = DCT_SEGMENT_EOI ;
+      break ;
+    }
+    dct->current_row = (uint16)(dct->current_row + dct->rows_in_MDU) ;
+    pixels += rowbytes ;
+  }
+  seg->decoded = TRUE ;
+
+  return TRUE ;
+}
+
+/**
+ * Decode all of the segments in a batch, one task per segment. Segments
+ * which could not be given a task are decoded by the caller.
+ */
+static void dct_segments_decode(dct_segments_t *segs)
+{
+  corecontext_t *context = get_core_context_interp() ;
+  error_context_t errcontext = ERROR_CONTEXT_INIT, *olderror ;
+  task_group_t *root, *group ;
+  int32 i ;
+
+  for ( i = 0 ; i < segs->nsegments ; i++ ) {
+    dct_segment_t *seg = &segs->segments[i] ;
+
+    init_filelist_struct(&seg->file,
+                         NAME_AND_LENGTH("DCTSegment"),
+                         READ_FLAG,
+                         0, seg->data, seg->data_len,
+                         FileError,                          /* fillbuff */
+                         FileFlushBufError,                  /* flushbuff */
+                         FileInitError,                      /* initfile */
+                         FileCloseError,                     /* closefile */
+                         FileDispose,                        /* disposefile */
+                         FileError2,                         /* bytesavail */
+                         FileError,                          /* resetfile */
+                         FileError2,                         /* filepos */
+                         FileError2Const,                    /* setfilepos */
+                         FileError,                          /* flushfile */
+                         FileEncodeError,                    /* filterencode */
+                         FileDecodeError,                    /* filterdecode */
+                         FileLastError,                      /* lasterror */
+                         0, NULL, NULL, NULL) ;
+    theICount(&seg->file) = seg->data_len ;
+  }
+
+  /* Failing to make tasks just means decoding the segments here. */
+  olderror = context->error ;
+  context->error = &errcontext ;
+
+  root = task_group_root() ;
+  if ( task_group_create(&group, TASK_GROUP_IMAGE, root, NULL) ) {
+    task_group_ready(group) ;
+    for ( i = 0 ; i < segs->nsegments ; i++ ) {
+      task_t *task ;
+
+      if ( task_create(&task, NULL, NULL, dct_segment_decode,
+                       &segs->segments[i], NULL, group,
+                       SW_TRACE_JPEG_SEGMENT) ) {
+        task_ready(task) ;
+        task_release(&task) ;
+      }
+    }
+    task_group_close(group) ;
+    (void)task_group_join(group, NULL) ;
+    task_group_release(&group) ;
+  }
+  task_group_release(&root) ;
+
+  context->error = olderror ;
+
+  for ( i = 0 ; i < segs->nsegments ; i++ ) {
+    if ( ! segs->segments[i].decoded )
+      (void)dct_segment_decode(context, &segs->segments[i]) ;
+  }
+}
+
+/**
+ * Copy the entropy-coded data for a batch of segments out of the underlying
+ * file, then decode them. The batch ends after the restart marker following
+ * the last segment, which is checked as process_restart() would have done.
+ * If the data ends early, the segment it is in is the last of the batch, and
+ * decoding it will fail (or find the EOI) at the same place the serial
+ * decoder would have.
+ *
+ * Returns FALSE with an error raised if the batch could not be gathered;
+ * \a ready is TRUE if there is a batch of decoded rows to deliver.
+ */
+static Bool dct_segments_batch(DCTSTATE *dct, FILELIST *flptr, Bool *ready)
+{
+  dct_segments_t *segs = dct->segments ;
+  dct_segment_t *seg ;
+  int32 seg_rows, markers, restart_num, expected, c ;
+  uint32 row ;
+
+  *ready = FALSE ;
+
+  if ( ! dct_parallel_restarts || dct->restart_interval <= 0 ||
+       dct->match != NULL || dct->info_fetch || dct->jpeg_api != NULL ||
+       NUM_THREADS() <= 1 )
+    return TRUE ;
+
+  /* Segments have to start on a restart boundary. */
+  if ( dct->restarts_to_go != 0 &&
+       dct->restarts_to_go != dct->restart_interval )
+    return TRUE ;
+
+  if ( segs == NULL && (segs = dct_segments_create(dct)) == NULL )
+    return TRUE ;
+
+  if ( segs->finished )
+    return TRUE ;
+
+  /* The last MDU row of the image is always decoded serially. */
+  seg_rows = segs->rows_per_segment * (int32)dct->rows_in_MDU ;
+  row = dct->current_row ;
+  if ( (int32)row + seg_rows >= dct->rows ) {
+    segs->finished = TRUE ;
+    return TRUE ;
+  }
+
+  segs->nsegments = segs->current = segs->current_row = 0 ;
+  restart_num = dct->next_restart_num ;
+
+  /* If the serial decoder has not yet read the restart marker starting this
+     interval, it is part of the first segment. */
+  markers = segs->intervals + (dct->restarts_to_go == 0 ? 1 : 0) ;
+  seg = &segs->segments[segs->nsegments++] ;
+  dct_segment_start(dct, segs, seg, row, restart_num) ;
+
+  for (;;) {
+    if ( (c = Getc(flptr)) == EOF )
+      break ;
+
+    if ( c != 0xFF ) {
+      if ( ! dct_segment_put(seg, c) )
+        return error_handler(VMERROR) ;
+      continue ;
+    }
+
+    while ( (c = Getc(flptr)) == 0xFF ) {
+      if ( ! dct_segment_put(seg, 0xFF) )
+        return error_handler(VMERROR) ;
+    }
+    if ( c == EOF ) {
+      if ( ! dct_segment_put(seg, 0xFF) )
+        return error_handler(VMERROR) ;
+      break ;
+    }
+
+    if ( c < RST0 || c > RST7 ) {
+      /* A stuffed zero, or a marker for the segment decode to deal with. */
+      if ( ! dct_segment_put(seg, 0xFF) || ! dct_segment_put(seg, c) )
+        return error_handler(VMERROR) ;
+      if ( c == 0 )
+        continue ;
+      break ;
+    }
+
+    expected = (restart_num == RST0_SYNC) ? c - RST0 : restart_num ;
+
+    if ( --markers > 0 ) {
+      /* A restart marker inside the segment. */
+      if ( ! dct_segment_put(seg, 0xFF) || ! dct_segment_put(seg, c) )
+        return error_handler(VMERROR) ;
+      restart_num = (expected + 1) & 7 ;
+      continue ;
+    }
+
+    /* This marker ends the segment, and starts the next one. */
+    row += seg_rows ;
+    if ( segs->nsegments < segs->max_segments &&
+         (int32)row + seg_rows < dct->rows ) {
+      seg = &segs->segments[segs->nsegments++] ;
+      dct_segment_start(dct, segs, seg, row, restart_num) ;
+      seg->state.restarts_to_go = 0 ;
+      if ( ! dct_segment_put(seg, 0xFF) || ! dct_segment_put(seg, c) )
+        return error_handler(VMERROR) ;
+      restart_num = (expected + 1) & 7 ;
+      markers = segs->intervals ;
+      continue ;
+    }
+
+    /* End of the batch. Leave the serial decoder as if it had just
+       processed this marker. */
+    if ( c != RST0 + expected )
+      segs->restart_error = TRUE ;
+    dct->currinfo->bbuf.nbits = 0 ;
+    dct->currinfo->bbuf.data = 0xff ;
+    for ( c = 0 ; c < (int32)dct->currinfo->comp_in_scan ; c++ )
+      dct->components[c].dc_prediction = 0 ;
+    dct->restarts_to_go = dct->restart_interval ;
+    dct->next_restart_num = (expected + 1) & 7 ;
+
+    dct_segments_decode(segs) ;
+    *ready = TRUE ;
+    return TRUE ;
+  }
+
+  /* The data ended before the marker following the segment. Whatever is
+     decoded is delivered, and then decoding fails where the serial decoder
+     would have looked for the restart marker. */
+  segs->restart_error = TRUE ;
+  segs->finished = TRUE ;
+
+  dct_segments_decode(segs) ;
+  *ready = TRUE ;
+  return TRUE ;
+}
+
+/**
+ * Deliver the next MDU row from a batch of decoded segments into the filter
+ * buffer, decoding a new batch if necessary. \a delivered is FALSE if the
+ * row should be decoded serially.
+ */
+static Bool dct_segments_row(FILELIST *filter, DCTSTATE *dct,
+                             int32 *ret_bytes, Bool *delivered)
+{
+  dct_segments_t *segs = dct->segments ;
+  dct_segment_t *seg ;
+
+  *delivered = FALSE ;
+
+  if ( segs == NULL || segs->current == segs->nsegments ) {
+    Bool ready ;
+
+    if ( segs != NULL && segs->restart_error )
+      return error_handler(IOERROR) ;
+
+    if ( ! dct_segments_batch(dct, theIUnderFile(filter), &ready) )
+      return FALSE ;
+    if ( ! ready )
+      return TRUE ;
+    segs = dct->segments ;
+  }
+
+  seg = &segs->segments[segs->current] ;
+  HQASSERT(seg->decoded, "Delivering a segment that was not decoded") ;
+  HqMemCpy(theIBuffer(filter),
+           seg->pixels + segs->current_row * segs->rowbytes,
+           segs->rowbytes) ;
+  *delivered = TRUE ;
+
+  if ( segs->current_row == seg->rows_done ) {
+    /* The segment stopped early, so this is the end of the batch. */
+    segs->current = segs->nsegments ;
+    segs->finished = TRUE ;
+    if ( seg->result == DCT_SEGMENT_EOI ) {
+      dct->dct_status = GOT_EOI ;
+      return TRUE ;
+    }
+    HQASSERT(seg->result == DCT_SEGMENT_ERROR,
+             "Segment stopped early without a reason") ;
+    return error_handler(IOERROR) ;
+  }
+
+  dct->current_row = (uint16)(dct->current_row + dct->rows_in_MDU) ;
+  HQASSERT((int32)dct->current_row < dct->rows,
+           "Segment contained the last row of the image") ;
+  *ret_bytes = dct->bytes_in_scanline * (int32)dct->rows_in_MDU ;
+
+  if ( ++segs->current_row == seg->rows ) {
+    segs->current_row = 0 ;
+    segs->current++ ;
+  }
+
+  return TRUE ;
+}
+
+/**
+ * Decode one row of MDUs from \a flptr into \a buffer. Bad data returns
+ * FALSE without raising an error, so that segment tasks can use this too.
+ * A premature EOI returns TRUE, with dct_status set to GOT_EOI.
+ */
+static Bool decode_MDU_row(DCTSTATE *dct, FILELIST *flptr, uint8 *buffer,
+                           DECODE_MDU_FN decode_MDU)
+{
+  int32 MDUs_in_scan ;
+  int32 mdu ;
+
+  /* no of complete MDUs */
+  MDUs_in_scan = (int32)dct->columns/(int32)dct->cols_in_MDU ;
+  dct->current_col = 0 ;
+
+  dct->rowsleft = (int32)dct->rows - (int32)dct->current_row;
+  dct->maxrows = (7 + dct->rowsleft)/8;
+  if ( dct->rowsleft < (int32)dct->rows_in_MDU )
+    dct->nrows = dct->rowsleft;
+  else
+    dct->nrows = (int32) dct->rows_in_MDU;
+
+  dct->ncols = (int32) dct->cols_in_MDU;
+
+  for ( mdu = 0 ; mdu < MDUs_in_scan ; mdu++ ) {
+    if ( ! decode_MDU( dct , flptr ))
+      return FALSE ;
+
+    color_transform_MDU(dct, buffer);
+    dct->current_col += dct->cols_in_MDU;
+    buffer += dct->cols_in_MDU * dct->colors;
+  }
+
+  if ( dct->dct_status == GOT_EOI )
+    return TRUE;
+
+  /* handle the last incomplete MDU in the scanline , if there is one */
+  if ( dct->current_col < dct->columns ) {
+    if ( ! decode_MDU( dct , flptr ))
+      return FALSE ;
+    dct->ncols = dct->columns - dct->current_col;
+    color_transform_MDU(dct, buffer);
+  }
+
+  return TRUE ;
+}
+
+
 /* ----------------------------------------------------------------------------
    function:            decode_scan       author:              Luke Tunmer
    creation date:       06-Sep-1991       last modification:   ##-###-####
@@ -5555,9 +6103,7 @@ Bool decode_scan(FILELIST *filter,
                  Bool     reset)
 {
   FILELIST* flptr;
-  int32     MDUs_in_scan;
-  int32     mdu;
-  int32 (*decode_MDU)( DCTSTATE *dct , FILELIST *flptr );
+  DECODE_MDU_FN decode_MDU;
   scaninfo * info;
 
   uint8*    pFilterBuffer =  theIBuffer( filter );
@@ -5616,44 +6162,24 @@ Bool decode_scan(FILELIST *filter,
     info->bbuf.data = 0 ;
     dct->next_restart_num = RST0_SYNC ;
     dct->restarts_to_go = dct->restart_interval ;
+    dct_segments_free( dct ) ;
   }
 
-  /* no of complete MDUs */
-  MDUs_in_scan = (int32)dct->columns/(int32)dct->cols_in_MDU ;
-  dct->current_col = 0 ;
-
-  dct->rowsleft = (int32)dct->rows - (int32)dct->current_row;
-  dct->maxrows = (7 + dct->rowsleft)/8;
-  if ( dct->rowsleft < (int32)dct->rows_in_MDU )
-    dct->nrows = dct->rowsleft;
-  else
-    dct->nrows = (int32) dct->rows_in_MDU;
-
-  dct->ncols = (int32) dct->cols_in_MDU;
-
-  for ( mdu = 0 ; mdu < MDUs_in_scan ; mdu++ ) {
-
-    if ( ! decode_MDU( dct , flptr) ) {
-      return error_handler( IOERROR );
-    }
+  if ( dct->mode == edctmode_baselinescan ) {
+    Bool delivered ;
 
-    color_transform_MDU(dct, pFilterBuffer);
-    dct->current_col += dct->cols_in_MDU;
-    pFilterBuffer += dct->cols_in_MDU * dct->colors;
+    if ( ! dct_segments_row( filter , dct , ret_bytes , &delivered ))
+      return FALSE ;
+    if ( delivered )
+      return TRUE ;
   }
 
+  if ( ! decode_MDU_row( dct , flptr , pFilterBuffer , decode_MDU ))
+    return error_handler( IOERROR ) ;
+
   if ( dct->dct_status == GOT_EOI )
     return TRUE;
 
-  /* handle the last incomplete MDU in the scanline , if there is one */
-  if ( dct->current_col < dct->columns ) {
-    if ( ! decode_MDU( dct , flptr )) {
-      return error_handler( IOERROR ) ;
-    }
-    dct->ncols = dct->columns - dct->current_col;
-    color_transform_MDU(dct, pFilterBuffer);
-  }
-
   dct->current_row = (uint16)(dct->current_row + dct->rows_in_MDU);
 
   if ( (int32)dct->current_row >= (int32)dct->rows ) {
@@ -5880,7 +6406,9 @@ static void transfer_YUV_to_RGB( register DCTSTATE *dct,
   for (i= 0; i< nrows; i++) {
     rc_ptr = buffer;
     y_ptr = y_block; u_ptr = u_block; v_ptr = v_block;
-    for ( j = 0 ; j < ncols ; j++ ) {
+    j = dct_simd_yuv_to_rgb(y_ptr, u_ptr, v_ptr, 0, rc_ptr, ncols);
+    y_ptr += j; u_ptr += j; v_ptr += j; rc_ptr += 3 * j;
+    for ( ; j < ncols ; j++ ) {
       y = *y_ptr++;
       u = *u_ptr++;
       v = *v_ptr++;
@@ -5946,6 +6474,40 @@ static void transfer211_YUV_to_RGB( register DCTSTATE *dct,
   nrows = dct->nrows;
   ncols = dct->ncols;
 
+  /* the y data is arranged in blocks of Y_WIDTH */
+#define Y_WIDTH 16
+
+  /* The SIMD kernels convert a row at a time, repeating each chroma sample
+     across two columns as they load it. Each chroma row serves two rows. */
+  if ( dct_simd_level() != DCT_SIMD_NONE ) {
+    for ( i = 0 ; i < nrows ; i++ ) {
+      y_ptr = y_block + i * Y_WIDTH;
+      u_ptr = u_block + (i >> 1) * (Y_WIDTH / 2);
+      v_ptr = v_block + (i >> 1) * (Y_WIDTH / 2);
+      rc_ptr = buffer;
+      j = dct_simd_yuv_to_rgb(y_ptr, u_ptr, v_ptr, 1, rc_ptr, ncols);
+      for ( rc_ptr += 3 * j ; j < ncols ; j++ ) {
+        y = y_ptr[j];
+        u = u_ptr[j >> 1];
+        v = v_ptr[j >> 1];
+
+        r1 = y + v_r_tab[v];
+        RANGE_LIMIT( r1 );
+        *rc_ptr++ = (uint8) r1;
+
+        g1 = y + BIT_SHIFT32_SIGNED_RIGHT_EXPR(u_g_tab[u] + v_g_tab[v], 16);
+        RANGE_LIMIT( g1 ) ;
+        *rc_ptr++ = (uint8) g1 ;
+
+        b1 = y + u_b_tab[u];
+        RANGE_LIMIT( b1 ) ;
+        *rc_ptr++ = (uint8) b1;
+      }
+      buffer += dct->bytes_in_scanline;
+    }
+    return;
+  }
+
   /* The basic algorithm below assumes an even number of both rows and columns.
      To cope with an odd number, the 'DoExtraRow' and 'DoExtraCol' flags are
      used, and the additional code appears rather clumsy, but all in the name
@@ -6016,9 +6578,6 @@ static void transfer211_YUV_to_RGB( register DCTSTATE *dct,
          the y we skip 16 pixels to get to the next line
          remember that y_ptr has already been advanced twice
          above */
-      #define Y_WIDTH 16
-
-      /* the y data is arranged in blocks of Y_WIDTH */
       y1 = *(y_ptr + Y_WIDTH - 2) - y;
       r1 = r + y1;
       RANGE_LIMIT( r1 );
@@ -6179,7 +6738,9 @@ static void transfer_YUVK_to_CMYK( register DCTSTATE *dct,
   for (i= 0; i< nrows; i++) {
     rc_ptr = buffer;
     y_ptr = y_block; u_ptr = u_block; v_ptr = v_block; k_ptr = k_block;
-    for ( j = 0 ; j < ncols ; j++ ) {
+    j = dct_simd_yuvk_to_cmyk(y_ptr, u_ptr, v_ptr, k_ptr, rc_ptr, ncols);
+    y_ptr += j; u_ptr += j; v_ptr += j; k_ptr += j; rc_ptr += 4 * j;
+    for ( ; j < ncols ; j++ ) {
       y = *y_ptr++;
       u = *u_ptr++;
       v = *v_ptr++;
@@ -6221,6 +6782,108 @@ static void transfer_YUVK_to_CMYK( register DCTSTATE *dct,
   return;
 }
 
+#if defined( ASSERT_BUILD )
+/** Random value in -range..range for the SIMD unit test. */
+static int32 dct_simd_test_value(uint32 *seed, int32 range)
+{
+  *seed = *seed * 1664525u + 1013904223u;
+  return (int32)((*seed >> 8) % (uint32)(2 * range + 1)) - range;
+}
+
+/* Unit test function for the SIMD kernels. For every instruction set this
+   processor supports, the dense inverse DCT and the color conversions are
+   run on random coefficients and samples and compared against the scalar
+   decoder. The kernels must be bit-exact. The chroma values go beyond
+   -128..127 to check the clamping the lookup tables do, but stay within
+   the tables' margins. */
+void dct_simd_unit_test(void)
+{
+  static const struct {
+    int32 colors, sample_211;
+  } conversions[] = {
+    { 3, FALSE }, { 3, TRUE }, { 4, FALSE }
+  };
+  DCTSTATE dct;
+  COMPONENTINFO ci;
+  DCTLIST dctlist;
+  uint32 qtable[64];
+  int32 blocks[4][256], expected_tile[8][8], order[64];
+  uint8 expected[16 * 16 * 4], actual[16 * 16 * 4];
+  int32 level, maxlevel, limit, trial, c, i, n;
+  uint32 seed = 1;
+
+  (void)init_YUV_to_RGB_tables();
+
+  limit = dct_simd_set_limit(DCT_SIMD_AVX2);
+  maxlevel = dct_simd_level();
+
+  HqMemZero(&dct, sizeof(dct));
+  HqMemZero(&ci, sizeof(ci));
+  dct.current_ci = &ci;
+  dct.quanttables[0] = qtable;
+  for ( c = 0; c < 4; ++c )
+    dct.components[c].mdu_block = blocks[c];
+  dct.colortransform = 1;
+  dct.cols_in_MDU = 16;
+
+  for ( level = DCT_SIMD_SSE2; level <= maxlevel; ++level ) {
+    for ( trial = 0; trial < 200; ++trial ) {
+      /* A dense block of coefficients in a random order. */
+      for ( i = 0; i < 64; ++i ) {
+        order[i] = i;
+        qtable[i] = (uint32)(dct_simd_test_value(&seed, 127) + 128);
+      }
+      dctlist.nc = (int16)(17 + (trial % 48));
+      for ( i = 0; i < dctlist.nc; ++i ) {
+        int32 swap = i + (dct_simd_test_value(&seed, 32) + 32) % (64 - i);
+        int32 zzi = order[swap];
+
+        order[swap] = order[i];
+        order[i] = zzi;
+        dctlist.coeff[i].zzi = (int16)zzi;
+        dctlist.coeff[i].val = (int16)dct_simd_test_value(&seed, 2047);
+      }
+
+      (void)dct_simd_set_limit(DCT_SIMD_NONE);
+      jpg_calc_idct(&dct, &dctlist);
+      HqMemCpy(expected_tile, dct.tile, sizeof(expected_tile));
+      (void)dct_simd_set_limit(level);
+      jpg_calc_idct(&dct, &dctlist);
+      HQASSERT(HqMemCmp(expected_tile, sizeof(expected_tile),
+                        dct.tile, sizeof(dct.tile)) == 0,
+               "SIMD inverse DCT does not match scalar");
+
+      for ( c = 0; c < 4; ++c )
+        for ( i = 0; i < 256; ++i )
+          blocks[c][i] = dct_simd_test_value(&seed, c == 0 ? 320 : 180);
+
+      for ( i = 0; i < NUM_ARRAY_ITEMS(conversions); ++i ) {
+        dct.colors = conversions[i].colors;
+        dct.sample_211 = conversions[i].sample_211;
+        /* An MDU is 1..16 samples each way, which is what blocks holds. */
+        dct.nrows = (uint32)(dct_simd_test_value(&seed, 8) + 8) % 16 + 1;
+        dct.ncols = (uint32)(dct_simd_test_value(&seed, 8) + 8) % 16 + 1;
+        if ( !dct.sample_211 ) {
+          dct.nrows = min(dct.nrows, 8);
+          dct.ncols = min(dct.ncols, 8);
+        }
+        dct.bytes_in_scanline = dct.ncols * dct.colors;
+        n = dct.nrows * dct.bytes_in_scanline;
+
+        (void)dct_simd_set_limit(DCT_SIMD_NONE);
+        color_transform_MDU(&dct, expected);
+        (void)dct_simd_set_limit(level);
+        color_transform_MDU(&dct, actual);
+        HQASSERT(HqMemCmp(expected, n, actual, n) == 0,
+                 "SIMD color conversion does not match scalar");
+      }
+    }
+  }
+
+  (void)dct_simd_set_limit(limit);
+}
+#endif
+
 void init_C_globals_gu_dct(void)
 {
 #if defined( ASSERT_BUILD )
@@ -6229,6 +6892,7 @@ void init_C_globals_gu_dct(void)
   v_r_tab = u_b_tab = v_g_tab = u_g_tab = NULL ;
   inited_RGB_to_YUV_tables = FALSE ;
   inited_YUV_to_RGB_tables = FALSE ;
+  dct_parallel_restarts = TRUE ;
 }
 
 /*
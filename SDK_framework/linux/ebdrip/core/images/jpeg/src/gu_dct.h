@@ -168,6 +168,9 @@ struct DCTSTATE {
   huffgroup_t   ac_huff;
 
   Bool          info_fetch; /* true if calling from imagecontextinfo_ */
+
+  int32         tile[8][8]; /* inverse DCT output for the current block */
+  dct_segments_t *segments; /* restart segments decoded in parallel */
 } ;
 
 extern uint32 encoded_adobe_qtable[] ;
@@ -206,6 +209,13 @@ Bool decode_DHT(FILELIST *filter, DCTSTATE *dctstate);
 Bool decode_scan(FILELIST *filter, DCTSTATE *dct,
                  int32 *ret_bytes, Bool reset);
 Bool get_marker_code(int32 *pcode, register FILELIST *flptr);
+void dct_segments_free(DCTSTATE *dct);
+
+#if defined(ASSERT_BUILD)
+void dct_simd_unit_test(void);
+#else
+#define dct_simd_unit_test() EMPTY_STATEMENT()
+#endif
 
 
 Bool output_marker_code(register int32 code, register FILELIST *flptr);
@@ -0,0 +1,306 @@
+/** \file
+ * \ingroup jpeg
+ *
+ * $HopeName: COREjpeg!src:gu_simd.c(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * SSE2 and AVX2 versions of the DCT decoder's dense inverse DCT and its
+ * YCbCr to RGB and YCCK to CMYK conversions. Horizontally subsampled chroma
+ * is upsampled as it is loaded. The instruction set is chosen at runtime,
+ * so the RIP still runs on processors without SSE2.
+ */
+
+#include "core.h"
+#include "dctimpl.h"
+#include "gu_simd.h"
+
+#ifdef DCT_SIMD
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#define SIMD_TARGET_SSE2
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#define DCT_SIMD_UNKNOWN (-1)
+
+/** The best instruction set supported by this processor. This is set the
+    first time it is needed; every thread would set it to the same value. */
+static int32 dct_simd_supported = DCT_SIMD_UNKNOWN;
+
+/** The best instruction set the kernels are allowed to use. */
+static int32 dct_simd_limit = DCT_SIMD_AVX2;
+
+int32 dct_simd_level(void)
+{
+  int32 level = dct_simd_supported;
+
+  if ( level == DCT_SIMD_UNKNOWN ) {
+#if defined(_MSC_VER)
+    int info[4];
+
+    level = DCT_SIMD_NONE;
+    __cpuid(info, 0);
+    if ( info[0] >= 1 ) {
+      __cpuid(info, 1);
+      if ( (info[3] & (1 << 26)) != 0 ) {
+        level = DCT_SIMD_SSE2;
+        /* AVX2 needs the OS to save the YMM registers. */
+        if ( (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 &&
+             (_xgetbv(0) & 6) == 6 ) {
+          __cpuid(info, 0);
+          if ( info[0] >= 7 ) {
+            __cpuidex(info, 7, 0);
+            if ( (info[1] & (1 << 5)) != 0 )
+              level = DCT_SIMD_AVX2;
+          }
+        }
+      }
+    }
+#else
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") )
+      level = DCT_SIMD_AVX2;
+    else if ( __builtin_cpu_supports("sse2") )
+      level = DCT_SIMD_SSE2;
+    else
+      level = DCT_SIMD_NONE;
+#endif
+    dct_simd_supported = level;
+  }
+
+  return min(level, dct_simd_limit);
+}
+
+int32 dct_simd_set_limit(int32 level)
+{
+  int32 previous = dct_simd_limit;
+
+  HQASSERT(level >= DCT_SIMD_NONE && level <= DCT_SIMD_AVX2,
+           "Invalid SIMD instruction set");
+  dct_simd_limit = level;
+  return previous;
+}
+
+/** The inverse DCT matrix, as written out in the comment on jpg_calc_idct():
+    row x holds the coefficients of output x of a 1D pass. */
+static const int32 dct_idct_matrix[8][8] = {
+  { A0,  A1,  A2,  A3,  A4,  A5,  A6,  A7 },
+  { A0,  A3,  A6, -A7, -A4, -A1, -A2, -A5 },
+  { A0,  A5, -A6, -A1, -A4,  A7,  A2,  A3 },
+  { A0,  A7, -A2, -A5,  A4,  A3, -A6, -A1 },
+  { A0, -A7, -A2,  A5,  A4, -A3, -A6,  A1 },
+  { A0, -A5, -A6,  A1, -A4, -A7,  A2, -A3 },
+  { A0, -A3,  A6,  A7, -A4,  A1, -A2,  A5 },
+  { A0, -A1,  A2, -A3,  A4, -A5,  A6, -A7 }
+};
+
+/** The transpose of dct_idct_matrix. */
+static const int32 dct_idct_columns[8][8] = {
+  { A0,  A0,  A0,  A0,  A0,  A0,  A0,  A0 },
+  { A1,  A3,  A5,  A7, -A7, -A5, -A3, -A1 },
+  { A2,  A6, -A6, -A2, -A2, -A6,  A6,  A2 },
+  { A3, -A7, -A1, -A5,  A5,  A1,  A7, -A3 },
+  { A4, -A4, -A4,  A4,  A4, -A4, -A4,  A4 },
+  { A5, -A1,  A7,  A3, -A3, -A7,  A1, -A5 },
+  { A6, -A2,  A2, -A6, -A6,  A2, -A2,  A6 },
+  { A7, -A5,  A3, -A1,  A1, -A3,  A5, -A7 }
+};
+
+#define DCT_SIMD_PASTE2(a_, b_) a_##b_
+#define DCT_SIMD_PASTE(a_, b_) DCT_SIMD_PASTE2(a_, b_)
+
+/* --SSE2 versions-- */
+
+/** SSE2 has no 32-bit multiply keeping the low halves of the products, so
+    multiply the even and odd lanes separately and interleave the results. */
+static SIMD_TARGET_SSE2 inline __m128i sse2_mullo_epi32(__m128i a, __m128i b)
+{
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static SIMD_TARGET_SSE2 inline __m128i sse2_min_epi32(__m128i a, __m128i b)
+{
+  __m128i gt = _mm_cmpgt_epi32(a, b);
+
+  return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+static SIMD_TARGET_SSE2 inline __m128i sse2_max_epi32(__m128i a, __m128i b)
+{
+  __m128i gt = _mm_cmpgt_epi32(a, b);
+
+  return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+/** Store four RGBX pixels as RGB. SSE2 has no byte shuffle, so the words
+    are split up in the integer registers. */
+static SIMD_TARGET_SSE2 inline void sse2_store_rgb(uint8 *out, __m128i rgbx)
+{
+  uint32 words[4];
+  int32 i;
+
+  _mm_storeu_si128((__m128i *)words, rgbx);
+  for ( i = 0; i < 4; ++i, out += 3 ) {
+    out[0] = (uint8)words[i];
+    out[1] = (uint8)(words[i] >> 8);
+    out[2] = (uint8)(words[i] >> 16);
+  }
+}
+
+#define SIMD_TARGET SIMD_TARGET_SSE2
+#define SIMD_NAME(name_) DCT_SIMD_PASTE(name_, _sse2)
+#define SIMD_WIDTH 4
+
+#define V __m128i
+#define V_LOAD(p_) _mm_loadu_si128((const __m128i *)(p_))
+#define V_LOAD_DUP(p_) \
+  _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i *)(p_)), \
+                     _mm_loadl_epi64((const __m128i *)(p_)))
+#define V_STORE(p_, v_) _mm_storeu_si128((__m128i *)(p_), (v_))
+#define V_SET1(x_) _mm_set1_epi32((int)(x_))
+#define V_ADD(a_, b_) _mm_add_epi32((a_), (b_))
+#define V_SUB(a_, b_) _mm_sub_epi32((a_), (b_))
+#define V_MULLO(a_, b_) sse2_mullo_epi32((a_), (b_))
+#define V_SRAI(a_, n_) _mm_srai_epi32((a_), (n_))
+#define V_MIN(a_, b_) sse2_min_epi32((a_), (b_))
+#define V_MAX(a_, b_) sse2_max_epi32((a_), (b_))
+#define V_PACK_U8(v_) \
+  _mm_packus_epi16(_mm_packs_epi32((v_), (v_)), _mm_setzero_si128())
+#define V_STORE_RGB(p_, lo_, hi_) sse2_store_rgb((p_), (lo_))
+
+#include "gu_simdimpl.h"
+
+#undef SIMD_TARGET
+#undef SIMD_NAME
+#undef SIMD_WIDTH
+#undef V
+#undef V_LOAD
+#undef V_LOAD_DUP
+#undef V_STORE
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_MULLO
+#undef V_SRAI
+#undef V_MIN
+#undef V_MAX
+#undef V_PACK_U8
+#undef V_STORE_RGB
+
+/* --AVX2 versions-- */
+
+/** Store eight RGBX pixels as 24 bytes of RGB, squeezing out the X bytes of
+    each half and then joining the halves. */
+static SIMD_TARGET_AVX2 inline void avx2_store_rgb(uint8 *out, __m128i lo,
+                                                   __m128i hi)
+{
+  __m128i squeeze = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                                  -1, -1, -1, -1);
+
+  lo = _mm_shuffle_epi8(lo, squeeze);
+  hi = _mm_shuffle_epi8(hi, squeeze);
+  _mm_storeu_si128((__m128i *)out, _mm_or_si128(lo, _mm_slli_si128(hi, 12)));
+  _mm_storel_epi64((__m128i *)(out + 16), _mm_srli_si128(hi, 4));
+}
+
+#define SIMD_TARGET SIMD_TARGET_AVX2
+#define SIMD_NAME(name_) DCT_SIMD_PASTE(name_, _avx2)
+#define SIMD_WIDTH 8
+
+#define V __m256i
+#define V_LOAD(p_) _mm256_loadu_si256((const __m256i *)(p_))
+#define V_LOAD_DUP(p_) \
+  _mm256_permutevar8x32_epi32( \
+    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(p_))), \
+    _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3))
+#define V_STORE(p_, v_) _mm256_storeu_si256((__m256i *)(p_), (v_))
+#define V_SET1(x_) _mm256_set1_epi32((int)(x_))
+#define V_ADD(a_, b_) _mm256_add_epi32((a_), (b_))
+#define V_SUB(a_, b_) _mm256_sub_epi32((a_), (b_))
+#define V_MULLO(a_, b_) _mm256_mullo_epi32((a_), (b_))
+#define V_SRAI(a_, n_) _mm256_srai_epi32((a_), (n_))
+#define V_MIN(a_, b_) _mm256_min_epi32((a_), (b_))
+#define V_MAX(a_, b_) _mm256_max_epi32((a_), (b_))
+/* Packing works within each 128-bit half, so split the halves first. */
+#define V_PACK_U8(v_) \
+  _mm_packus_epi16(_mm_packs_epi32(_mm256_castsi256_si128(v_), \
+                                   _mm256_extracti128_si256((v_), 1)), \
+                   _mm_setzero_si128())
+#define V_STORE_RGB(p_, lo_, hi_) avx2_store_rgb((p_), (lo_), (hi_))
+
+#include "gu_simdimpl.h"
+
+#undef SIMD_TARGET
+#undef SIMD_NAME
+#undef SIMD_WIDTH
+#undef V
+#undef V_LOAD
+#undef V_LOAD_DUP
+#undef V_STORE
+#undef V_SET1
+#undef V_ADD
+#undef V_SUB
+#undef V_MULLO
+#undef V_SRAI
+#undef V_MIN
+#undef V_MAX
+#undef V_PACK_U8
+#undef V_STORE_RGB
+
+Bool dct_simd_idct(const int32 coeffs[64], int32 tile[8][8])
+{
+  switch ( dct_simd_level() ) {
+  case DCT_SIMD_AVX2:
+    dct_idct_avx2(coeffs, tile);
+    return TRUE;
+  case DCT_SIMD_SSE2:
+    dct_idct_sse2(coeffs, tile);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+int32 dct_simd_yuv_to_rgb(const int32 *y, const int32 *u, const int32 *v,
+                          int32 hshift, uint8 *out, int32 n)
+{
+  HQASSERT(hshift == 0 || hshift == 1, "Invalid chroma subsampling");
+
+  switch ( dct_simd_level() ) {
+  case DCT_SIMD_AVX2:
+    return dct_yuv_to_rgb_avx2(y, u, v, hshift, out, n);
+  case DCT_SIMD_SSE2:
+    return dct_yuv_to_rgb_sse2(y, u, v, hshift, out, n);
+  }
+  return 0;
+}
+
+int32 dct_simd_yuvk_to_cmyk(const int32 *y, const int32 *u, const int32 *v,
+                            const int32 *k, uint8 *out, int32 n)
+{
+  switch ( dct_simd_level() ) {
+  case DCT_SIMD_AVX2:
+    return dct_yuvk_to_cmyk_avx2(y, u, v, k, out, n);
+  case DCT_SIMD_SSE2:
+    return dct_yuvk_to_cmyk_sse2(y, u, v, k, out, n);
+  }
+  return 0;
+}
+
+#endif /* DCT_SIMD */
+
+/* Log stripped */
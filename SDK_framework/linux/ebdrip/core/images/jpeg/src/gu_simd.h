@@ -0,0 +1,96 @@
+/** \file
+ * \ingroup jpeg
+ *
+ * $HopeName: COREjpeg!src:gu_simd.h(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * SSE2 and AVX2 versions of the DCT decoder's inverse DCT and color
+ * conversions, selected at runtime by CPU feature detection.
+ */
+
+#ifndef __GU_SIMD_H__
+#define __GU_SIMD_H__
+
+/* The SIMD kernels are built for x86 compilers that can target instruction
+   sets beyond the baseline on a per-function basis. */
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define DCT_SIMD 1
+#elif (defined(_M_IX86) || defined(_M_X64)) && defined(_MSC_VER) && _MSC_VER >= 1800
+#define DCT_SIMD 1
+#endif
+
+/** Instruction sets the kernels can use, in increasing order. */
+enum {
+  DCT_SIMD_NONE,
+  DCT_SIMD_SSE2,
+  DCT_SIMD_AVX2
+};
+
+#ifdef DCT_SIMD
+
+/** \brief The instruction set the kernels will use: the best one this
+    processor supports, no better than the limit set by dct_simd_set_limit().
+*/
+int32 dct_simd_level(void);
+
+/** \brief Limit the instruction set the kernels may use.
+
+    \param level The best instruction set allowed.
+
+    \returns The previous limit.
+*/
+int32 dct_simd_set_limit(int32 level);
+
+/** \brief Dense inverse DCT, computing exactly what the two 1D passes in
+    jpg_calc_idct() compute.
+
+    \param coeffs The dequantised coefficients, in natural (not zig-zag)
+    order.
+    \param tile   The 8x8 block of output samples.
+
+    \returns TRUE if the transform was done, FALSE if no SIMD instruction set
+    is available.
+*/
+Bool dct_simd_idct(const int32 coeffs[64], int32 tile[8][8]);
+
+/** \brief Convert one row of YCbCr samples to RGB, as many as possible at a
+    time.
+
+    \param y, u, v The component samples, level shifted to be centred on 0.
+    \param hshift  1 if each chroma sample covers two luma samples, else 0.
+    \param out     The interleaved RGB bytes.
+    \param n       The number of pixels in the row.
+
+    \returns The number of pixels converted; the caller converts the
+    remainder.
+*/
+int32 dct_simd_yuv_to_rgb(const int32 *y, const int32 *u, const int32 *v,
+                          int32 hshift, uint8 *out, int32 n);
+
+/** \brief Convert one row of YCCK samples to CMYK, as many as possible at a
+    time.
+
+    \returns The number of pixels converted; the caller converts the
+    remainder.
+*/
+int32 dct_simd_yuvk_to_cmyk(const int32 *y, const int32 *u, const int32 *v,
+                            const int32 *k, uint8 *out, int32 n);
+
+#else /* !DCT_SIMD */
+
+#define dct_simd_level() DCT_SIMD_NONE
+#define dct_simd_set_limit(level_) DCT_SIMD_NONE
+#define dct_simd_idct(coeffs_, tile_) FALSE
+#define dct_simd_yuv_to_rgb(y_, u_, v_, hshift_, out_, n_) 0
+#define dct_simd_yuvk_to_cmyk(y_, u_, v_, k_, out_, n_) 0
+
+#endif /* !DCT_SIMD */
+
+#endif /* __GU_SIMD_H__ */
+
+/* Log stripped */
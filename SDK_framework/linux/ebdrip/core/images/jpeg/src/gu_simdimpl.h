@@ -0,0 +1,151 @@
+/** \file
+ * \ingroup jpeg
+ *
+ * $HopeName: COREjpeg!src:gu_simdimpl.h(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * Vector versions of the dense inverse DCT and the YCbCr and YCCK color
+ * conversions. Each function computes exactly what the scalar code in
+ * gu_dct.c computes.
+ *
+ * On inclusion, these macros should be defined:
+ *
+ * SIMD_TARGET expands to the attribute that allows a function to use the
+ * instruction set.
+ *
+ * SIMD_NAME(name) expands to the name of the version of a function for the
+ * instruction set.
+ *
+ * SIMD_WIDTH is the number of samples processed at a time, either 4 or 8.
+ *
+ * V is the integer vector type, with SIMD_WIDTH signed 32-bit lanes. The
+ * V_ macros are the vector operations used. V_LOAD_DUP loads SIMD_WIDTH/2
+ * samples and repeats each of them. V_PACK_U8 saturates the lanes to bytes
+ * in the low end of an __m128i. V_STORE_RGB stores SIMD_WIDTH pixels from
+ * the RGBX words of the first and (for 8 lanes) second __m128i.
+ *
+ * This file is included multiple times, so should NOT have a guard around
+ * it.
+ */
+
+/** Dense inverse DCT. Both 1D passes are arranged to run along rows, so no
+    transposes are needed: the first pass builds the transpose of the scalar
+    work array from the columns of the matrix, and the second pass produces
+    whole rows of the tile. Integer addition is associative, so the sums are
+    the same as the scalar ones. */
+static SIMD_TARGET void SIMD_NAME(dct_idct)(const int32 coeffs[64],
+                                            int32 tile[8][8])
+{
+  int32 ws[8][8];
+  int32 i, k, h;
+
+  for ( i = 0; i < 8; ++i ) {
+    for ( h = 0; h < 8; h += SIMD_WIDTH ) {
+      V sum = V_MULLO(V_SET1(coeffs[i * 8]), V_LOAD(&dct_idct_columns[0][h]));
+
+      for ( k = 1; k < 8; ++k )
+        sum = V_ADD(sum, V_MULLO(V_SET1(coeffs[i * 8 + k]),
+                                 V_LOAD(&dct_idct_columns[k][h])));
+      V_STORE(&ws[i][h], V_SRAI(V_ADD(sum, V_SET1(1 << 11)), 12));
+    }
+  }
+
+  for ( i = 0; i < 8; ++i ) {
+    for ( h = 0; h < 8; h += SIMD_WIDTH ) {
+      V sum = V_MULLO(V_SET1(dct_idct_matrix[i][0]), V_LOAD(&ws[0][h]));
+
+      for ( k = 1; k < 8; ++k )
+        sum = V_ADD(sum, V_MULLO(V_SET1(dct_idct_matrix[i][k]),
+                                 V_LOAD(&ws[k][h])));
+      V_STORE(&tile[i][h], V_SRAI(V_ADD(sum, V_SET1(1 << 3)), 4));
+    }
+  }
+}
+
+/** Unclamped RGB from YCbCr, using the same fixed point arithmetic as the
+    lookup tables built by init_YUV_to_RGB_tables(). The tables clamp the
+    chroma to -128..127, so the vectors do too. */
+static SIMD_TARGET inline void SIMD_NAME(dct_rgb)(V y, V u, V v,
+                                                  V *r, V *g, V *b)
+{
+  V lo = V_SET1(-128), hi = V_SET1(127);
+  V half = V_SET1(ONE_HALF);
+
+  u = V_MIN(V_MAX(u, lo), hi);
+  v = V_MIN(V_MAX(v, lo), hi);
+
+  *r = V_ADD(V_ADD(y, V_SRAI(V_ADD(V_MULLO(v, V_SET1(FIX(1.40200))), half),
+                             16)),
+             V_SET1(128));
+  *b = V_ADD(V_ADD(y, V_SRAI(V_ADD(V_MULLO(u, V_SET1(FIX(1.77200))), half),
+                             16)),
+             V_SET1(128));
+  *g = V_ADD(y, V_SRAI(V_ADD(V_ADD(V_MULLO(u, V_SET1(-FIX(0.34414))),
+                                   V_MULLO(v, V_SET1(-FIX(0.71414)))),
+                             V_SET1(ONE_HALF + 2 * FIX(64))),
+                       16));
+}
+
+static SIMD_TARGET int32 SIMD_NAME(dct_yuv_to_rgb)(const int32 *y,
+                                                   const int32 *u,
+                                                   const int32 *v,
+                                                   int32 hshift,
+                                                   uint8 *out, int32 n)
+{
+  __m128i zero = _mm_setzero_si128();
+  int32 j;
+
+  for ( j = 0; j + SIMD_WIDTH <= n; j += SIMD_WIDTH, out += 3 * SIMD_WIDTH ) {
+    V vu, vv, r, g, b;
+    __m128i rg, bx;
+
+    if ( hshift ) {
+      vu = V_LOAD_DUP(u + (j >> 1));
+      vv = V_LOAD_DUP(v + (j >> 1));
+    } else {
+      vu = V_LOAD(u + j);
+      vv = V_LOAD(v + j);
+    }
+    SIMD_NAME(dct_rgb)(V_LOAD(y + j), vu, vv, &r, &g, &b);
+
+    rg = _mm_unpacklo_epi8(V_PACK_U8(r), V_PACK_U8(g));
+    bx = _mm_unpacklo_epi8(V_PACK_U8(b), zero);
+    V_STORE_RGB(out, _mm_unpacklo_epi16(rg, bx), _mm_unpackhi_epi16(rg, bx));
+  }
+
+  return j;
+}
+
+static SIMD_TARGET int32 SIMD_NAME(dct_yuvk_to_cmyk)(const int32 *y,
+                                                     const int32 *u,
+                                                     const int32 *v,
+                                                     const int32 *k,
+                                                     uint8 *out, int32 n)
+{
+  V white = V_SET1(255), shift = V_SET1(128);
+  int32 j;
+
+  for ( j = 0; j + SIMD_WIDTH <= n; j += SIMD_WIDTH, out += 4 * SIMD_WIDTH ) {
+    V r, g, b;
+    __m128i cm, yk;
+
+    SIMD_NAME(dct_rgb)(V_LOAD(y + j), V_LOAD(u + j), V_LOAD(v + j),
+                       &r, &g, &b);
+
+    cm = _mm_unpacklo_epi8(V_PACK_U8(V_SUB(white, r)),
+                           V_PACK_U8(V_SUB(white, g)));
+    yk = _mm_unpacklo_epi8(V_PACK_U8(V_SUB(white, b)),
+                           V_PACK_U8(V_ADD(V_LOAD(k + j), shift)));
+    _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi16(cm, yk));
+#if SIMD_WIDTH == 8
+    _mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi16(cm, yk));
+#endif
+  }
+
+  return j;
+}
+
+/* Log stripped */
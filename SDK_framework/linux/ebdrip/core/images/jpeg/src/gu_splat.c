@@ -8,6 +8,8 @@
  *
  * \brief
  * Each routine here do an inverse dct of a single coefficient.
+ * They all work on a tile supplied by the caller, so that more than one
+ * decoder can be running at a time.
  */
 
 /*---------------------- INLCUDES --------------------------------*/
@@ -83,9 +85,7 @@
 #define COS_76 0x04C7 /* FIX(0.01866450) */
 #define COS_77 0x0270 /* FIX(0.00951506) */
 
-static int32 tile[ 8 ][ 8 ] ;
-
-void splat_00(register int32 coeff)
+void splat_00(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0;
 
@@ -116,7 +116,7 @@ void splat_00(register int32 coeff)
   tile[7][4] = c0; tile[7][5] = c0; tile[7][6] = c0; tile[7][7] = c0;
 }
 
-void splat_01(register int32 coeff)
+void splat_01(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -150,7 +150,7 @@ void splat_01(register int32 coeff)
   tile[7][4] -= c3; tile[7][5] -= c2; tile[7][6] -= c1; tile[7][7] -= c0;
 }
 
-void splat_02(register int32 coeff)
+void splat_02(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1;
 
@@ -182,7 +182,7 @@ void splat_02(register int32 coeff)
   tile[7][4] -= c0; tile[7][5] -= c1; tile[7][6] += c1; tile[7][7] += c0;
 }
 
-void splat_03(register int32 coeff)
+void splat_03(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -216,7 +216,7 @@ void splat_03(register int32 coeff)
   tile[7][4] += c2; tile[7][5] += c0; tile[7][6] += c3; tile[7][7] -= c1;
 }
 
-void splat_04(register int32 coeff)
+void splat_04(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0;
 
@@ -247,7 +247,7 @@ void splat_04(register int32 coeff)
   tile[7][4] += c0; tile[7][5] -= c0; tile[7][6] -= c0; tile[7][7] += c0;
 }
 
-void splat_05(register int32 coeff)
+void splat_05(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -281,7 +281,7 @@ void splat_05(register int32 coeff)
   tile[7][4] -= c1; tile[7][5] -= c3; tile[7][6] += c0; tile[7][7] -= c2;
 }
 
-void splat_06(register int32 coeff)
+void splat_06(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1;
 
@@ -313,7 +313,7 @@ void splat_06(register int32 coeff)
   tile[7][4] -= c1; tile[7][5] += c0; tile[7][6] -= c0; tile[7][7] += c1;
 }
 
-void splat_07(register int32 coeff)
+void splat_07(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -347,7 +347,7 @@ void splat_07(register int32 coeff)
   tile[7][4] += c0; tile[7][5] -= c1; tile[7][6] += c2; tile[7][7] -= c3;
 }
 
-void splat_10(register int32 coeff)
+void splat_10(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -381,7 +381,7 @@ void splat_10(register int32 coeff)
   tile[7][4] -= c0; tile[7][5] -= c0; tile[7][6] -= c0; tile[7][7] -= c0;
 }
 
-void splat_11(register int32 coeff)
+void splat_11(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -421,7 +421,7 @@ void splat_11(register int32 coeff)
   tile[7][4] += c3; tile[7][5] += c2; tile[7][6] += c1; tile[7][7] += c0;
 }
 
-void splat_12(register int32 coeff)
+void splat_12(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -459,7 +459,7 @@ void splat_12(register int32 coeff)
   tile[7][4] += c0; tile[7][5] += c1; tile[7][6] -= c1; tile[7][7] -= c0;
 }
 
-void splat_13(register int32 coeff)
+void splat_13(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -499,7 +499,7 @@ void splat_13(register int32 coeff)
   tile[7][4] -= c2; tile[7][5] -= c0; tile[7][6] -= c3; tile[7][7] += c1;
 }
 
-void splat_14(register int32 coeff)
+void splat_14(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
   
@@ -533,7 +533,7 @@ void splat_14(register int32 coeff)
   tile[7][4] -= c0; tile[7][5] += c0; tile[7][6] += c0; tile[7][7] -= c0;
 }
 
-void splat_15(register int32 coeff)
+void splat_15(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -573,7 +573,7 @@ void splat_15(register int32 coeff)
   tile[7][4] += c1; tile[7][5] += c3; tile[7][6] -= c0; tile[7][7] += c2;
 }
 
-void splat_16(register int32 coeff)
+void splat_16(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -611,7 +611,7 @@ void splat_16(register int32 coeff)
   tile[7][4] += c1; tile[7][5] -= c0; tile[7][6] += c0; tile[7][7] -= c1;
 }
 
-void splat_17(register int32 coeff)
+void splat_17(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -651,7 +651,7 @@ void splat_17(register int32 coeff)
   tile[7][4] -= c0; tile[7][5] += c1; tile[7][6] -= c2; tile[7][7] += c3;
 }
 
-void splat_20(register int32 coeff)
+void splat_20(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1;
 
@@ -683,7 +683,7 @@ void splat_20(register int32 coeff)
   tile[7][4] += c0; tile[7][5] += c0; tile[7][6] += c0; tile[7][7] += c0;
 }
 
-void splat_21(register int32 coeff)
+void splat_21(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -721,7 +721,7 @@ void splat_21(register int32 coeff)
   tile[7][4] -= c6; tile[7][5] -= c4; tile[7][6] -= c2; tile[7][7] -= c0;
 }
 
-void splat_22(register int32 coeff)
+void splat_22(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2;
 
@@ -754,7 +754,7 @@ void splat_22(register int32 coeff)
   tile[7][4] -= c0; tile[7][5] -= c1; tile[7][6] += c1; tile[7][7] += c0;
 }
 
-void splat_23(register int32 coeff)
+void splat_23(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -792,7 +792,7 @@ void splat_23(register int32 coeff)
   tile[7][4] += c4; tile[7][5] += c0; tile[7][6] += c6; tile[7][7] -= c2;
 }
 
-void splat_24(register int32 coeff)
+void splat_24(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1;
 
@@ -824,7 +824,7 @@ void splat_24(register int32 coeff)
   tile[7][4] += c0; tile[7][5] -= c0; tile[7][6] -= c0; tile[7][7] += c0;
 }
 
-void splat_25(register int32 coeff)
+void splat_25(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -862,7 +862,7 @@ void splat_25(register int32 coeff)
   tile[7][4] -= c2; tile[7][5] -= c6; tile[7][6] += c0; tile[7][7] -= c4;
 }
 
-void splat_26(register int32 coeff)
+void splat_26(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2;
 
@@ -895,7 +895,7 @@ void splat_26(register int32 coeff)
   tile[7][4] -= c1; tile[7][5] += c0; tile[7][6] -= c0; tile[7][7] += c1;
 }
 
-void splat_27(register int32 coeff)
+void splat_27(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -933,7 +933,7 @@ void splat_27(register int32 coeff)
   tile[7][4] += c0; tile[7][5] -= c2; tile[7][6] += c4; tile[7][7] -= c6;
 }
 
-void splat_30(register int32 coeff)
+void splat_30(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -967,7 +967,7 @@ void splat_30(register int32 coeff)
   tile[7][4] -= c1; tile[7][5] -= c1; tile[7][6] -= c1; tile[7][7] -= c1;
 }
 
-void splat_31(register int32 coeff)
+void splat_31(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -1007,7 +1007,7 @@ void splat_31(register int32 coeff)
   tile[7][4] += c6; tile[7][5] += c5; tile[7][6] += c4; tile[7][7] += c1;
 }
 
-void splat_32(register int32 coeff)
+void splat_32(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -1045,7 +1045,7 @@ void splat_32(register int32 coeff)
   tile[7][4] += c2; tile[7][5] += c3; tile[7][6] -= c3; tile[7][7] -= c2;
 }
 
-void splat_33(register int32 coeff)
+void splat_33(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -1085,7 +1085,7 @@ void splat_33(register int32 coeff)
   tile[7][4] -= c5; tile[7][5] -= c1; tile[7][6] -= c6; tile[7][7] += c4;
 }
 
-void splat_34(register int32 coeff)
+void splat_34(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -1119,7 +1119,7 @@ void splat_34(register int32 coeff)
   tile[7][4] -= c1; tile[7][5] += c1; tile[7][6] += c1; tile[7][7] -= c1;
 }
 
-void splat_35(register int32 coeff)
+void splat_35(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -1159,7 +1159,7 @@ void splat_35(register int32 coeff)
   tile[7][4] += c4; tile[7][5] += c6; tile[7][6] -= c1; tile[7][7] += c5;
 }
 
-void splat_36(register int32 coeff)
+void splat_36(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -1197,7 +1197,7 @@ void splat_36(register int32 coeff)
   tile[7][4] += c3; tile[7][5] -= c2; tile[7][6] += c2; tile[7][7] -= c3;
 }
 
-void splat_37(register int32 coeff)
+void splat_37(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -1237,7 +1237,7 @@ void splat_37(register int32 coeff)
   tile[7][4] -= c1; tile[7][5] += c4; tile[7][6] -= c5; tile[7][7] += c6;
 }
 
-void splat_40(register int32 coeff)
+void splat_40(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0;
 
@@ -1268,7 +1268,7 @@ void splat_40(register int32 coeff)
   tile[7][4] += c0; tile[7][5] += c0; tile[7][6] += c0; tile[7][7] += c0;
 }
 
-void splat_41(register int32 coeff)
+void splat_41(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -1302,7 +1302,7 @@ void splat_41(register int32 coeff)
   tile[7][4] -= c3; tile[7][5] -= c2; tile[7][6] -= c1; tile[7][7] -= c0;
 }
 
-void splat_42(register int32 coeff)
+void splat_42(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1;
 
@@ -1334,7 +1334,7 @@ void splat_42(register int32 coeff)
   tile[7][4] -= c0; tile[7][5] -= c1; tile[7][6] += c1; tile[7][7] += c0;
 }
 
-void splat_43(register int32 coeff)
+void splat_43(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -1368,7 +1368,7 @@ void splat_43(register int32 coeff)
   tile[7][4] += c2; tile[7][5] += c0; tile[7][6] += c3; tile[7][7] -= c1;
 }
 
-void splat_44(register int32 coeff)
+void splat_44(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0;
 
@@ -1399,7 +1399,7 @@ void splat_44(register int32 coeff)
   tile[7][4] += c0; tile[7][5] -= c0; tile[7][6] -= c0; tile[7][7] += c0;
 }
 
-void splat_45(register int32 coeff)
+void splat_45(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -1433,7 +1433,7 @@ void splat_45(register int32 coeff)
   tile[7][4] -= c1; tile[7][5] -= c3; tile[7][6] += c0; tile[7][7] -= c2;
 }
 
-void splat_46(register int32 coeff)
+void splat_46(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1;
 
@@ -1465,7 +1465,7 @@ void splat_46(register int32 coeff)
   tile[7][4] -= c1; tile[7][5] += c0; tile[7][6] -= c0; tile[7][7] += c1;
 }
 
-void splat_47(register int32 coeff)
+void splat_47(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -1499,7 +1499,7 @@ void splat_47(register int32 coeff)
   tile[7][4] += c0; tile[7][5] -= c1; tile[7][6] += c2; tile[7][7] -= c3;
 }
 
-void splat_50(register int32 coeff)
+void splat_50(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -1533,7 +1533,7 @@ void splat_50(register int32 coeff)
   tile[7][4] -= c2; tile[7][5] -= c2; tile[7][6] -= c2; tile[7][7] -= c2;
 }
 
-void splat_51(register int32 coeff)
+void splat_51(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -1573,7 +1573,7 @@ void splat_51(register int32 coeff)
   tile[7][4] += c8; tile[7][5] += c7; tile[7][6] += c5; tile[7][7] += c2;
 }
 
-void splat_52(register int32 coeff)
+void splat_52(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -1611,7 +1611,7 @@ void splat_52(register int32 coeff)
   tile[7][4] += c4; tile[7][5] += c5; tile[7][6] -= c5; tile[7][7] -= c4;
 }
 
-void splat_53(register int32 coeff)
+void splat_53(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -1651,7 +1651,7 @@ void splat_53(register int32 coeff)
   tile[7][4] -= c7; tile[7][5] -= c2; tile[7][6] -= c8; tile[7][7] += c5;
 }
 
-void splat_54(register int32 coeff)
+void splat_54(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -1685,7 +1685,7 @@ void splat_54(register int32 coeff)
   tile[7][4] -= c2; tile[7][5] += c2; tile[7][6] += c2; tile[7][7] -= c2;
 }
 
-void splat_55(register int32 coeff)
+void splat_55(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -1725,7 +1725,7 @@ void splat_55(register int32 coeff)
   tile[7][4] += c5; tile[7][5] += c8; tile[7][6] -= c2; tile[7][7] += c7;
 }
 
-void splat_56(register int32 coeff)
+void splat_56(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -1763,7 +1763,7 @@ void splat_56(register int32 coeff)
   tile[7][4] += c5; tile[7][5] -= c4; tile[7][6] += c4; tile[7][7] -= c5;
 }
 
-void splat_57(register int32 coeff)
+void splat_57(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -1803,7 +1803,7 @@ void splat_57(register int32 coeff)
   tile[7][4] -= c2; tile[7][5] += c5; tile[7][6] -= c7; tile[7][7] += c8;
 }
 
-void splat_60(register int32 coeff)
+void splat_60(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1;
 
@@ -1835,7 +1835,7 @@ void splat_60(register int32 coeff)
   tile[7][4] += c1; tile[7][5] += c1; tile[7][6] += c1; tile[7][7] += c1;
 }
 
-void splat_61(register int32 coeff)
+void splat_61(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -1873,7 +1873,7 @@ void splat_61(register int32 coeff)
   tile[7][4] -= c7; tile[7][5] -= c5; tile[7][6] -= c3; tile[7][7] -= c1;
 }
 
-void splat_62(register int32 coeff)
+void splat_62(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2;
 
@@ -1906,7 +1906,7 @@ void splat_62(register int32 coeff)
   tile[7][4] -= c1; tile[7][5] -= c2; tile[7][6] += c2; tile[7][7] += c1;
 }
 
-void splat_63(register int32 coeff)
+void splat_63(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -1944,7 +1944,7 @@ void splat_63(register int32 coeff)
   tile[7][4] += c5; tile[7][5] += c1; tile[7][6] += c7; tile[7][7] -= c3;
 }
 
-void splat_64(register int32 coeff)
+void splat_64(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1;
 
@@ -1976,7 +1976,7 @@ void splat_64(register int32 coeff)
   tile[7][4] += c1; tile[7][5] -= c1; tile[7][6] -= c1; tile[7][7] += c1;
 }
 
-void splat_65(register int32 coeff)
+void splat_65(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -2014,7 +2014,7 @@ void splat_65(register int32 coeff)
   tile[7][4] -= c3; tile[7][5] -= c7; tile[7][6] += c1; tile[7][7] -= c5;
 }
 
-void splat_66(register int32 coeff)
+void splat_66(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2;
 
@@ -2047,7 +2047,7 @@ void splat_66(register int32 coeff)
   tile[7][4] -= c2; tile[7][5] += c1; tile[7][6] -= c1; tile[7][7] += c2;
 }
 
-void splat_67(register int32 coeff)
+void splat_67(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -2085,7 +2085,7 @@ void splat_67(register int32 coeff)
   tile[7][4] += c1; tile[7][5] -= c3; tile[7][6] += c5; tile[7][7] -= c7;
 }
 
-void splat_70(register int32 coeff)
+void splat_70(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -2119,7 +2119,7 @@ void splat_70(register int32 coeff)
   tile[7][4] -= c3; tile[7][5] -= c3; tile[7][6] -= c3; tile[7][7] -= c3;
 }
 
-void splat_71(register int32 coeff)
+void splat_71(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -2159,7 +2159,7 @@ void splat_71(register int32 coeff)
   tile[7][4] += c9; tile[7][5] += c8; tile[7][6] += c6; tile[7][7] += c3;
 }
 
-void splat_72(register int32 coeff)
+void splat_72(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -2197,7 +2197,7 @@ void splat_72(register int32 coeff)
   tile[7][4] += c6; tile[7][5] += c7; tile[7][6] -= c7; tile[7][7] -= c6;
 }
 
-void splat_73(register int32 coeff)
+void splat_73(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -2237,7 +2237,7 @@ void splat_73(register int32 coeff)
   tile[7][4] -= c8; tile[7][5] -= c3; tile[7][6] -= c9; tile[7][7] += c6;
 }
 
-void splat_74(register int32 coeff)
+void splat_74(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3;
 
@@ -2271,7 +2271,7 @@ void splat_74(register int32 coeff)
   tile[7][4] -= c3; tile[7][5] += c3; tile[7][6] += c3; tile[7][7] -= c3;
 }
 
-void splat_75(register int32 coeff)
+void splat_75(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -2311,7 +2311,7 @@ void splat_75(register int32 coeff)
   tile[7][4] += c6; tile[7][5] += c9; tile[7][6] -= c3; tile[7][7] += c8;
 }
 
-void splat_76(register int32 coeff)
+void splat_76(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7;
 
@@ -2349,7 +2349,7 @@ void splat_76(register int32 coeff)
   tile[7][4] += c7; tile[7][5] -= c6; tile[7][6] += c6; tile[7][7] -= c7;
 }
 
-void splat_77(register int32 coeff)
+void splat_77(int32 tile[8][8], register int32 coeff)
 {
   register int32 c0,c1,c2,c3,c4,c5,c6,c7,c8,c9;
 
@@ -2393,7 +2393,7 @@ void splat_77(register int32 coeff)
  * Temp function to simplify inverse-DCT data paths.
  * Just copy the supplied data into the output tile
  */
-void splat_tile(int32 src[8][8])
+void splat_tile(int32 tile[8][8], int32 src[8][8])
 {
   int i, j;
 
@@ -2435,7 +2435,7 @@ void splat_tile(int32 src[8][8])
       tile[i][j] = src[i][j];
 }
 
-void zero_tile(void)
+void zero_tile(int32 tile[8][8])
 {
  tile[0][0] = 0; tile[0][1] = 0; tile[0][2] = 0; tile[0][3] = 0;
  tile[0][4] = 0; tile[0][5] = 0; tile[0][6] = 0; tile[0][7] = 0;
@@ -2455,7 +2455,7 @@ void zero_tile(void)
  tile[7][4] = 0; tile[7][5] = 0; tile[7][6] = 0; tile[7][7] = 0;
 }
 
-void unfix_clip_tile(register int32 *block, register int32 skip)
+void unfix_clip_tile(int32 tile[8][8], register int32 *block, register int32 skip)
 {
   register int32 t;
 
@@ -2541,7 +2541,7 @@ void unfix_clip_tile(register int32 *block, register int32 skip)
   t = UNFIX(tile[7][7])+128; RANGE_LIMIT(t); block[7] = t;
 }
 
-void unfix_tile(register int32 *block, register int32 skip)
+void unfix_tile(int32 tile[8][8], register int32 *block, register int32 skip)
 {
   skip += 8 ;
 
@@ -15,74 +15,74 @@
 
 /*--------------------------- prototypes ---------------------------*/
 
-extern void unfix_tile(register int32 *block, int32 skip);
-extern void unfix_clip_tile(register int32 *block, int32 skip);
-extern void zero_tile(void);
-extern void splat_tile(int32 src[8][8]);
-extern void splat_00(register int32 value);
-extern void splat_01(register int32 value);
-extern void splat_02(register int32 value);
-extern void splat_03(register int32 value);
-extern void splat_04(register int32 value);
-extern void splat_05(register int32 value);
-extern void splat_06(register int32 value);
-extern void splat_07(register int32 value);
-extern void splat_10(register int32 value);
-extern void splat_11(register int32 value);
-extern void splat_12(register int32 value);
-extern void splat_13(register int32 value);
-extern void splat_14(register int32 value);
-extern void splat_15(register int32 value);
-extern void splat_16(register int32 value);
-extern void splat_17(register int32 value);
-extern void splat_20(register int32 value);
-extern void splat_21(register int32 value);
-extern void splat_22(register int32 value);
-extern void splat_23(register int32 value);
-extern void splat_24(register int32 value);
-extern void splat_25(register int32 value);
-extern void splat_26(register int32 value);
-extern void splat_27(register int32 value);
-extern void splat_30(register int32 value);
-extern void splat_31(register int32 value);
-extern void splat_32(register int32 value);
-extern void splat_33(register int32 value);
-extern void splat_34(register int32 value);
-extern void splat_35(register int32 value);
-extern void splat_36(register int32 value);
-extern void splat_37(register int32 value);
-extern void splat_40(register int32 value);
-extern void splat_41(register int32 value);
-extern void splat_42(register int32 value);
-extern void splat_43(register int32 value);
-extern void splat_44(register int32 value);
-extern void splat_45(register int32 value);
-extern void splat_46(register int32 value);
-extern void splat_47(register int32 value);
-extern void splat_50(register int32 value);
-extern void splat_51(register int32 value);
-extern void splat_52(register int32 value);
-extern void splat_53(register int32 value);
-extern void splat_54(register int32 value);
-extern void splat_55(register int32 value);
-extern void splat_56(register int32 value);
-extern void splat_57(register int32 value);
-extern void splat_60(register int32 value);
-extern void splat_61(register int32 value);
-extern void splat_62(register int32 value);
-extern void splat_63(register int32 value);
-extern void splat_64(register int32 value);
-extern void splat_65(register int32 value);
-extern void splat_66(register int32 value);
-extern void splat_67(register int32 value);
-extern void splat_70(register int32 value);
-extern void splat_71(register int32 value);
-extern void splat_72(register int32 value);
-extern void splat_73(register int32 value);
-extern void splat_74(register int32 value);
-extern void splat_75(register int32 value);
-extern void splat_76(register int32 value);
-extern void splat_77(register int32 value);
+extern void unfix_tile(int32 tile[8][8], register int32 *block, int32 skip);
+extern void unfix_clip_tile(int32 tile[8][8], register int32 *block, int32 skip);
+extern void zero_tile(int32 tile[8][8]);
+extern void splat_tile(int32 tile[8][8], int32 src[8][8]);
+extern void splat_00(int32 tile[8][8], register int32 value);
+extern void splat_01(int32 tile[8][8], register int32 value);
+extern void splat_02(int32 tile[8][8], register int32 value);
+extern void splat_03(int32 tile[8][8], register int32 value);
+extern void splat_04(int32 tile[8][8], register int32 value);
+extern void splat_05(int32 tile[8][8], register int32 value);
+extern void splat_06(int32 tile[8][8], register int32 value);
+extern void splat_07(int32 tile[8][8], register int32 value);
+extern void splat_10(int32 tile[8][8], register int32 value);
+extern void splat_11(int32 tile[8][8], register int32 value);
+extern void splat_12(int32 tile[8][8], register int32 value);
+extern void splat_13(int32 tile[8][8], register int32 value);
+extern void splat_14(int32 tile[8][8], register int32 value);
+extern void splat_15(int32 tile[8][8], register int32 value);
+extern void splat_16(int32 tile[8][8], register int32 value);
+extern void splat_17(int32 tile[8][8], register int32 value);
+extern void splat_20(int32 tile[8][8], register int32 value);
+extern void splat_21(int32 tile[8][8], register int32 value);
+extern void splat_22(int32 tile[8][8], register int32 value);
+extern void splat_23(int32 tile[8][8], register int32 value);
+extern void splat_24(int32 tile[8][8], register int32 value);
+extern void splat_25(int32 tile[8][8], register int32 value);
+extern void splat_26(int32 tile[8][8], register int32 value);
+extern void splat_27(int32 tile[8][8], register int32 value);
+extern void splat_30(int32 tile[8][8], register int32 value);
+extern void splat_31(int32 tile[8][8], register int32 value);
+extern void splat_32(int32 tile[8][8], register int32 value);
+extern void splat_33(int32 tile[8][8], register int32 value);
+extern void splat_34(int32 tile[8][8], register int32 value);
+extern void splat_35(int32 tile[8][8], register int32 value);
+extern void splat_36(int32 tile[8][8], register int32 value);
+extern void splat_37(int32 tile[8][8], register int32 value);
+extern void splat_40(int32 tile[8][8], register int32 value);
+extern void splat_41(int32 tile[8][8], register int32 value);
+extern void splat_42(int32 tile[8][8], register int32 value);
+extern void splat_43(int32 tile[8][8], register int32 value);
+extern void splat_44(int32 tile[8][8], register int32 value);
+extern void splat_45(int32 tile[8][8], register int32 value);
+extern void splat_46(int32 tile[8][8], register int32 value);
+extern void splat_47(int32 tile[8][8], register int32 value);
+extern void splat_50(int32 tile[8][8], register int32 value);
+extern void splat_51(int32 tile[8][8], register int32 value);
+extern void splat_52(int32 tile[8][8], register int32 value);
+extern void splat_53(int32 tile[8][8], register int32 value);
+extern void splat_54(int32 tile[8][8], register int32 value);
+extern void splat_55(int32 tile[8][8], register int32 value);
+extern void splat_56(int32 tile[8][8], register int32 value);
+extern void splat_57(int32 tile[8][8], register int32 value);
+extern void splat_60(int32 tile[8][8], register int32 value);
+extern void splat_61(int32 tile[8][8], register int32 value);
+extern void splat_62(int32 tile[8][8], register int32 value);
+extern void splat_63(int32 tile[8][8], register int32 value);
+extern void splat_64(int32 tile[8][8], register int32 value);
+extern void splat_65(int32 tile[8][8], register int32 value);
+extern void splat_66(int32 tile[8][8], register int32 value);
+extern void splat_67(int32 tile[8][8], register int32 value);
+extern void splat_70(int32 tile[8][8], register int32 value);
+extern void splat_71(int32 tile[8][8], register int32 value);
+extern void splat_72(int32 tile[8][8], register int32 value);
+extern void splat_73(int32 tile[8][8], register int32 value);
+extern void splat_74(int32 tile[8][8], register int32 value);
+extern void splat_75(int32 tile[8][8], register int32 value);
+extern void splat_76(int32 tile[8][8], register int32 value);
+extern void splat_77(int32 tile[8][8], register int32 value);
 
 #endif
 
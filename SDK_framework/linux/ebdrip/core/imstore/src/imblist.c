@@ -626,6 +626,45 @@ IM_BLIST *blist_findGlobal(IM_SHARED *im_shared, int32 abytes, int32 bx)
   return blist;
 }
 
+/**
+ * Find a global blist which is not caching the data of any block, and take
+ * it off the global list. Unlike blist_findGlobal(), this never evicts the
+ * cached data of another block, so it is suitable for speculative loads.
+ *
+ * \param[in]     im_shared    The shared image state for this page.
+ * \param[in]     abytes       Size of image block
+ * \param[in]     bx           Column index
+ * \return  The blist found or NULL.
+ */
+IM_BLIST *blist_findGlobalFree(IM_SHARED *im_shared, int32 abytes, int32 bx)
+{
+  IM_STORE_NODE *node;
+  IM_BLIST *blist = NULL;
+
+  blist_checkGlobal(im_shared);
+
+  node = im_shared->im_list;
+  while (node != NULL && node->abytes != abytes)
+    node = node->next;
+
+  HQASSERT(node != NULL && node->abytes == abytes,
+           "Should have found node for this blist");
+
+  for ( ; blist == NULL && node != NULL; node = node->prev ) {
+    for ( blist = node->blistHead; blist != NULL; blist = blist->next ) {
+      if ( blist->block == NULL )
+        break;
+    }
+  }
+  if ( blist != NULL ) {
+    blist->bx = bx;
+    blist_unlinkGlobal(im_shared, blist);
+    im_blockclear(blist, abytes, FALSE);
+  }
+  blist_checkGlobal(im_shared);
+  return blist;
+}
+
 /**
  * Search for a blist in the given local image store
  *
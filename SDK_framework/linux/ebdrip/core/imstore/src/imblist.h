@@ -33,6 +33,7 @@ void blist_checkGlobal(IM_SHARED *im_shared);
 void blist_checkLocal(IM_BLIST* blist, int32 nblists);
 void blist_purgeGlobal(IM_SHARED *im_shared);
 IM_BLIST *blist_findGlobal(IM_SHARED *im_shared, int32 abytes, int32 bx);
+IM_BLIST *blist_findGlobalFree(IM_SHARED *im_shared, int32 abytes, int32 bx);
 IM_BLIST *blist_find(IM_STORE *ims, int32 abytes, int32 planei, int32 bx,
                      Bool lookInGlobal, Bool rendering);
 void blist_release(IM_STORE *ims, int32 band, int32 nullblock);
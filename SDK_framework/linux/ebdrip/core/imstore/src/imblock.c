@@ -31,8 +31,13 @@
 #include "strfilt.h"            /* string_decode_filter */
 #include "swerrors.h"           /* VMERROR */
 #include "interrupts.h"
+#include "timing.h"             /* PROBE */
+#include "hqatomic.h"           /* HqAtomicIncrement */
+#include "taskh.h"              /* task_create */
+#include "ripmulti.h"           /* NUM_THREADS */
 
 #include "imb32.h"              /* imb32_compress */
+#include "imlz.h"               /* imlz_compress */
 #include "imblist.h"            /* blist_setblock */
 #include "imfile.h"             /* im_fileoffset */
 #include "imstore_priv.h"
@@ -83,6 +88,17 @@ struct IM_BLOCK {
   IM_BLIST *blist;     /**< Pointer into the block list cache.*/
 };
 
+/** Work area for LZ compression of contone blocks. This is too big for the
+    stack, so each thread allocates one the first time it compresses a
+    block, and keeps it until the RIP finishes. */
+typedef struct IM_LZWORK {
+  uint16 hash[IMLZ_HASHSIZE];          /**< LZ match hash table. */
+  uint8 delta[IM_BLOCK_DEFAULT_SIZE];  /**< Row delta transformed data. */
+} IM_LZWORK;
+
+/** LZ compression work areas, indexed by thread index. */
+static IM_LZWORK *im_lzwork[NTHREADS_LIMIT];
+
 static multi_condvar_t im_load_condvar;
 static multi_condvar_t im_get_condvar;
 static multi_mutex_t im_block_mutex;
@@ -110,15 +126,163 @@ static Bool im_block_swstart(struct SWSTART *params)
 
 static void im_block_finish(void)
 {
+  int32 i;
+
+  for ( i = 0; i < NTHREADS_LIMIT; ++i ) {
+    if ( im_lzwork[i] != NULL ) {
+      mm_free(mm_pool_temp, im_lzwork[i], sizeof(IM_LZWORK));
+      im_lzwork[i] = NULL;
+    }
+  }
   multi_condvar_finish(&im_get_condvar);
   multi_condvar_finish(&im_load_condvar);
   multi_mutex_finish(&im_block_mutex);
 }
 
+#ifdef METRICS_BUILD
+#include "metrics.h"
+
+/** Per-method image block compression statistics. Blocks may be decompressed
+    outside the image block lock, so the counters are atomic. */
+static struct im_compress_metrics {
+  hq_atomic_counter_t compressed[IM_COMPRESS_N_METHODS];   /**< Blocks compressed. */
+  hq_atomic_counter_t bytes_in[IM_COMPRESS_N_METHODS];     /**< Bytes before compression. */
+  hq_atomic_counter_t bytes_out[IM_COMPRESS_N_METHODS];    /**< Bytes after compression. */
+  hq_atomic_counter_t decompressed[IM_COMPRESS_N_METHODS]; /**< Blocks decompressed. */
+} im_compress_metrics;
+
+/** Names of the compression methods in the metrics; NULL for the states
+    which are not methods. */
+static const char *im_compress_names[IM_COMPRESS_N_METHODS] = {
+  NULL,         /* IM_COMPRESS_NONE */
+  NULL,         /* IM_COMPRESS_TOO_BIG */
+  NULL,         /* IM_COMPRESS_FAILED */
+  "LZW",        /* IM_COMPRESS_LZW */
+  "CCITT",      /* IM_COMPRESS_CCITT */
+  "Flate",      /* IM_COMPRESS_FLATE */
+  "B32",        /* IM_COMPRESS_B32 */
+  "Copy",       /* IM_COMPRESS_COPY */
+  "LZ",         /* IM_COMPRESS_LZ */
+  "LZDelta",    /* IM_COMPRESS_LZ_DELTA */
+};
+
+static void im_compress_metrics_add(hq_atomic_counter_t *counter, int32 n)
+{
+  hq_atomic_counter_t before;
+  Bool swapped;
+
+  do {
+    before = *counter;
+    HqAtomicCAS(counter, before, before + n, swapped);
+  } while ( !swapped );
+}
+
+static Bool im_compress_metrics_update(sw_metrics_group *metrics)
+{
+  int32 i;
+
+  if ( !sw_metrics_open_group(&metrics, METRIC_NAME_AND_LENGTH("ImageCompression")) )
+    return FALSE;
+  for ( i = 0; i < IM_COMPRESS_N_METHODS; ++i ) {
+    if ( im_compress_names[i] != NULL &&
+         (im_compress_metrics.compressed[i] != 0 ||
+          im_compress_metrics.decompressed[i] != 0) ) {
+      if ( !sw_metrics_open_group(&metrics, im_compress_names[i],
+                                  strlen(im_compress_names[i])) )
+        return FALSE;
+      SW_METRIC_INTEGER("Compressed", im_compress_metrics.compressed[i]);
+      SW_METRIC_INTEGER("BytesIn", im_compress_metrics.bytes_in[i]);
+      SW_METRIC_INTEGER("BytesOut", im_compress_metrics.bytes_out[i]);
+      if ( im_compress_metrics.bytes_out[i] > 0 )
+        SW_METRIC_FLOAT("Ratio", (float)im_compress_metrics.bytes_in[i] /
+                                 (float)im_compress_metrics.bytes_out[i]);
+      SW_METRIC_INTEGER("Decompressed", im_compress_metrics.decompressed[i]);
+      sw_metrics_close_group(&metrics);
+    }
+  }
+  sw_metrics_close_group(&metrics);
+  return TRUE;
+}
+
+static void im_compress_metrics_reset(int reason)
+{
+  struct im_compress_metrics init = { 0 };
+
+  UNUSED_PARAM(int, reason);
+  im_compress_metrics = init;
+}
+
+static sw_metrics_callbacks im_compress_metrics_hook = {
+  im_compress_metrics_update,
+  im_compress_metrics_reset,
+  NULL
+};
+
+#define IM_COMPRESS_METRIC_COMPRESSED(method_, in_, out_) MACRO_START \
+  hq_atomic_counter_t _before_; \
+  HqAtomicIncrement(&im_compress_metrics.compressed[method_], _before_); \
+  UNUSED_PARAM(hq_atomic_counter_t, _before_); \
+  im_compress_metrics_add(&im_compress_metrics.bytes_in[method_], (in_)); \
+  im_compress_metrics_add(&im_compress_metrics.bytes_out[method_], (out_)); \
+MACRO_END
+
+#define IM_COMPRESS_METRIC_DECOMPRESSED(method_) MACRO_START \
+  hq_atomic_counter_t _before_; \
+  HqAtomicIncrement(&im_compress_metrics.decompressed[method_], _before_); \
+  UNUSED_PARAM(hq_atomic_counter_t, _before_); \
+MACRO_END
+
+/** Image block read-ahead statistics. */
+static struct im_readahead_metrics {
+  hq_atomic_counter_t scheduled; /**< Read-ahead tasks created. */
+  hq_atomic_counter_t loaded;    /**< Blocks loaded by read-ahead tasks. */
+} im_readahead_metrics;
+
+static Bool im_readahead_metrics_update(sw_metrics_group *metrics)
+{
+  if ( !sw_metrics_open_group(&metrics, METRIC_NAME_AND_LENGTH("ImageReadAhead")) )
+    return FALSE;
+  SW_METRIC_INTEGER("Scheduled", im_readahead_metrics.scheduled);
+  SW_METRIC_INTEGER("Loaded", im_readahead_metrics.loaded);
+  sw_metrics_close_group(&metrics);
+  return TRUE;
+}
+
+static void im_readahead_metrics_reset(int reason)
+{
+  struct im_readahead_metrics init = { 0 };
+
+  UNUSED_PARAM(int, reason);
+  im_readahead_metrics = init;
+}
+
+static sw_metrics_callbacks im_readahead_metrics_hook = {
+  im_readahead_metrics_update,
+  im_readahead_metrics_reset,
+  NULL
+};
+
+#define IM_READAHEAD_METRIC_INCREMENT(field_) MACRO_START \
+  hq_atomic_counter_t _before_; \
+  HqAtomicIncrement(&im_readahead_metrics.field_, _before_); \
+  UNUSED_PARAM(hq_atomic_counter_t, _before_); \
+MACRO_END
+#else
+#define IM_COMPRESS_METRIC_COMPRESSED(method_, in_, out_) EMPTY_STATEMENT()
+#define IM_COMPRESS_METRIC_DECOMPRESSED(method_) EMPTY_STATEMENT()
+#define IM_READAHEAD_METRIC_INCREMENT(field_) EMPTY_STATEMENT()
+#endif /* METRICS_BUILD */
+
 void im_block_C_globals(core_init_fns *fns)
 {
   fns->swstart = im_block_swstart ;
   fns->finish = im_block_finish ;
+#ifdef METRICS_BUILD
+  im_compress_metrics_reset(SW_METRICS_RESET_BOOT) ;
+  sw_metrics_register(&im_compress_metrics_hook) ;
+  im_readahead_metrics_reset(SW_METRICS_RESET_BOOT) ;
+  sw_metrics_register(&im_readahead_metrics_hook) ;
+#endif
 }
 
 Bool im_blocksetup(IM_STORE *ims, int32 plane, int32 bx, int32 by)
@@ -786,9 +950,84 @@ static Bool im_filter(uint8 *filtername, IMFPARAMS *params, int32 nparams,
   return TRUE;
 }
 
+/**
+ * Find the LZ compression work area for the current thread, allocating it
+ * if this is the thread's first compression. Blocks are compressed when
+ * memory is low, so the allocation doesn't try to free memory.
+ *
+ * \return The work area, or NULL if the thread has no thread index or the
+ *         work area could not be allocated.
+ */
+static IM_LZWORK *im_blocklzwork(void)
+{
+  corecontext_t *context = get_core_context();
+  IM_LZWORK **work;
+
+  if ( context == NULL || context->thread_index >= NTHREADS_LIMIT )
+    return NULL;
+
+  /* Only this thread uses this entry, so no lock is needed. */
+  work = &im_lzwork[context->thread_index];
+  if ( *work == NULL )
+    *work = mm_alloc_cost(mm_pool_temp, sizeof(IM_LZWORK), mm_cost_none,
+                          MM_ALLOC_CLASS_IMAGE_DATA);
+  return *work;
+}
+
+/**
+ * Compress a contone block with the LZ compressor, trying the row delta
+ * transform first if the block looks smooth, and then without it. If there
+ * is no work area for the compressor, the block is left for LZW.
+ */
+static Bool im_blocklzcompress(IM_STORE *ims, IM_BLOCK *block, uint8 *buffer,
+                               int32 bufsize, int32 *bufused)
+{
+  IM_LZWORK *work = im_blocklzwork();
+  int32 step = ims->bpp >> 3;
+  int32 bytes = block->xbytes * block->ysize;
+  Bool usedelta, trydelta = (bytes <= IM_BLOCK_DEFAULT_SIZE);
+  int32 attempt;
+
+  HQASSERT(ims->bpp == 8 || ims->bpp == 16, "LZ compression is for contone");
+
+  if ( work == NULL )
+    return FALSE;
+
+  usedelta = trydelta &&
+    imlz_prefer_delta(block->data, block->xbytes, block->ysize, step);
+
+  for ( attempt = 0; attempt < 2; ++attempt, usedelta = !usedelta ) {
+    if ( usedelta ) {
+      if ( !trydelta )
+        continue;
+      PROBE(SW_TRACE_IM_COMPRESS, IM_COMPRESS_LZ_DELTA,
+            imlz_delta_encode(block->data, work->delta, block->xbytes,
+                              block->ysize, step);
+            *bufused = imlz_compress(work->delta, bytes, buffer, bufsize,
+                                     work->hash));
+      if ( *bufused > 0 ) {
+        block->compress = IM_COMPRESS_LZ_DELTA;
+        return TRUE;
+      }
+    } else {
+      PROBE(SW_TRACE_IM_COMPRESS, IM_COMPRESS_LZ,
+            *bufused = imlz_compress(block->data, bytes, buffer, bufsize,
+                                     work->hash));
+      if ( *bufused > 0 ) {
+        block->compress = IM_COMPRESS_LZ;
+        return TRUE;
+      }
+    }
+  }
+
+  return FALSE;
+}
+
 static Bool im_blockcompress(IM_STORE *ims, IM_BLOCK *block, uint8 *buffer,
                              int32 bufsize, int32 *bufused)
 {
+  Bool ok;
+
   block->compress = IM_COMPRESS_TOO_BIG;
 
   if ( ims->bpp == 1 ) {
@@ -801,20 +1040,30 @@ static Bool im_blockcompress(IM_STORE *ims, IM_BLOCK *block, uint8 *buffer,
     ccittparams[ 0 ].integer = block->xsize;
     ccittparams[ 1 ].integer = block->ysize;
 
-    if ( im_filter((uint8 *)"CCITTFaxEncode", ccittparams, 3,
-                    block->data, block->xbytes, block->ysize,
-                    buffer, bufsize, bufused ))
+    PROBE(SW_TRACE_IM_COMPRESS, IM_COMPRESS_CCITT,
+          ok = im_filter((uint8 *)"CCITTFaxEncode", ccittparams, 3,
+                         block->data, block->xbytes, block->ysize,
+                         buffer, bufsize, bufused));
+    if ( ok )
       block->compress = IM_COMPRESS_CCITT;
     else
       error_clear();
   }
   else if ( ims->bpp == 32 ) {
-    if ( (*bufused = imb32_compress(FLT0TO1, (float *)(block->data),
+    PROBE(SW_TRACE_IM_COMPRESS, IM_COMPRESS_B32,
+          *bufused = imb32_compress(FLT0TO1, (float *)(block->data),
                                     block->xsize, block->ysize,
-                                    (uint32 *)buffer, bufsize)) > 0 )
+                                    (uint32 *)buffer, bufsize));
+    if ( *bufused > 0 )
       block->compress = IM_COMPRESS_B32;
   }
+  else if ( (ims->bpp == 8 || ims->bpp == 16) &&
+            im_blocklzcompress(ims, block, buffer, bufsize, bufused) ) {
+    EMPTY_STATEMENT();
+  }
   else {
+    /* Packed low bit depth data, or contone data that the LZ compressor
+       could not reduce enough. */
     IMFPARAMS lzwparams[ 3 ] =
     {
       { NAME_Columns         , 0x7FFFFFFF },
@@ -824,9 +1073,11 @@ static Bool im_blockcompress(IM_STORE *ims, IM_BLOCK *block, uint8 *buffer,
     lzwparams[ 0 ].integer = ims->bpp > 8 ? 2 * block->xsize : block->xsize;
     lzwparams[ 1 ].integer = ims->bpp > 8 ? 8 : ims->bpp;
 
-    if ( im_filter((uint8 *)"LZWEncode", lzwparams, 3,
-                    block->data, block->xbytes, block->ysize,
-                    buffer, bufsize, bufused ))
+    PROBE(SW_TRACE_IM_COMPRESS, IM_COMPRESS_LZW,
+          ok = im_filter((uint8 *)"LZWEncode", lzwparams, 3,
+                         block->data, block->xbytes, block->ysize,
+                         buffer, bufsize, bufused));
+    if ( ok )
       block->compress = IM_COMPRESS_LZW;
     else
       error_clear();
@@ -835,7 +1086,8 @@ static Bool im_blockcompress(IM_STORE *ims, IM_BLOCK *block, uint8 *buffer,
   return (block->compress != IM_COMPRESS_TOO_BIG);
 }
 
-static Bool im_blockdecompress(IM_STORE *ims, IM_BLOCK *block, uint8 *buffer)
+static Bool im_blockdecompress_method(IM_STORE *ims, IM_BLOCK *block,
+                                      uint8 *buffer)
 {
   int32 used;
   if ( block->compress == IM_COMPRESS_CCITT ) {
@@ -877,6 +1129,15 @@ static Bool im_blockdecompress(IM_STORE *ims, IM_BLOCK *block, uint8 *buffer)
                            (float *)(block->data), block->xsize, block->ysize) )
       return FALSE;
   }
+  else if ( block->compress == IM_COMPRESS_LZ ||
+            block->compress == IM_COMPRESS_LZ_DELTA ) {
+    if ( !imlz_decompress(buffer, block->cbytes,
+                          block->data, block->xbytes * block->ysize) )
+      return error_handler(UNREGISTERED);
+    if ( block->compress == IM_COMPRESS_LZ_DELTA )
+      imlz_delta_decode(block->data, block->xbytes, block->ysize,
+                        ims->bpp >> 3);
+  }
   else {
     HQASSERT(block->compress == IM_COMPRESS_COPY, "invalid compress method");
     HqMemCpy( block->data, buffer, block->cbytes );
@@ -885,6 +1146,18 @@ static Bool im_blockdecompress(IM_STORE *ims, IM_BLOCK *block, uint8 *buffer)
   return TRUE;
 }
 
+static Bool im_blockdecompress(IM_STORE *ims, IM_BLOCK *block, uint8 *buffer)
+{
+  Bool ok;
+
+  PROBE(SW_TRACE_IM_DECOMPRESS, block->compress,
+        ok = im_blockdecompress_method(ims, block, buffer));
+  if ( ok )
+    IM_COMPRESS_METRIC_DECOMPRESSED(block->compress);
+
+  return ok;
+}
+
 static Bool im_blockisICompressed(IM_BLOCK *block)
 {
   return block->compress != IM_COMPRESS_NONE &&
@@ -1024,6 +1297,7 @@ static void im_blocktocomp(IM_STORE *ims, IM_BLOCK *block, Bool freeData)
 
   block->cbytes = CAST_SIGNED_TO_INT16(bufused);
   HqMemCpy(block->cdata, pBuffer, bufused);
+  IM_COMPRESS_METRIC_COMPRESSED(block->compress, block->tbytes, bufused);
 
   if ( block->abytes == IM_BLOCK_DEFAULT_SIZE )
     ims->stdblocks -= 1;
@@ -1351,7 +1625,9 @@ int32 im_blockwrite(IM_STORE *ims, int32 planei, int32 bb, int32 bx, int32 by,
 }
 
 static Bool im_blockGetMoveable(IM_STORE *ims, IM_BLOCK *block,
-                                int32 plane, int32 bx, Bool rendering);
+                                int32 plane, int32 bx, Bool rendering,
+                                Bool *loaded);
+static void im_blockreadahead(IM_STORE *ims, int32 plane, int32 bb, int32 bx);
 
 Bool im_blockaddr(IM_STORE *ims, int32 plane, int32 bb, int32 bx,
                   int32 x, int32 y, uint8 **rbuf, int32 *rpixels)
@@ -1368,8 +1644,16 @@ Bool im_blockaddr(IM_STORE *ims, int32 plane, int32 bb, int32 bx,
 
   /* Moveable block handling */
   if ( im_blockisIMoveable(block) ) {
-    if (!im_blockGetMoveable(ims, block, plane, bx, TRUE))
+    Bool loaded = FALSE;
+
+    if (!im_blockGetMoveable(ims, block, plane, bx, TRUE, &loaded))
       return FALSE;
+
+    /* Having loaded this block, or used it for the first time after a
+       read-ahead loaded it, start loading the next block down the column,
+       which the following band will most likely need. */
+    if ( loaded )
+      im_blockreadahead(ims, plane, bb, bx);
   }
   HQASSERT(block->data, "Trying to read but lost data");
 
@@ -1420,8 +1704,72 @@ void im_blockfree(IM_STORE *ims, int32 iplane)
           ims->nblocks * sizeof(IM_BLOCK *), MM_ALLOC_CLASS_IMAGE_DATA);
 }
 
+/**
+ * Fill a moveable block's data, which has just been allocated, from its
+ * compressed data in memory, its uniform color, or from disk. The caller
+ * must have marked the block as loading, so no-one else will touch it.
+ */
+static Bool im_blockload(IM_STORE *ims, IM_BLOCK *block)
+{
+  /* Data can either be:
+   * a) compressed in memory.
+   * b) compressed on disk.
+   * c) non-compressed on disk.
+   */
+
+  if ( block->storage == IM_STORAGE_MEMORY ) {
+    HQASSERT(im_blockisICompressed( block ),
+             "block should either be compressed and/or on disk");
+    if ( ! im_blockdecompress( ims, block, block->cdata ) ) {
+      HQFAIL( "Somehow failed to decompress memory block" );
+      return FALSE;
+    }
+  }
+  else if ( block->storage == IM_STORAGE_UNIFORM_VARIANT ) {
+    /* Expand the uniform color value into the data referenced by
+     * im_storeread
+     */
+    uint32 npixels = block->xbytes, i ;
+
+    if ( ims->bpp == 16 ) {
+      uint16 *data = (uint16*)block->data ;
+
+      HQASSERT((block->xbytes & 1) == 0, "xbytes must be even for 16-bit image data") ;
+      npixels >>= 1 ;
+
+      for (i = 0; i < npixels; i++)
+        data[i] = block->uniformColor;
+    } else {
+      uint8 uniformColor8 = CAST_UNSIGNED_TO_UINT8(block->uniformColor) ;
+
+      for (i = 0; i < npixels; i++)
+        block->data[i] = uniformColor8;
+    }
+  }
+  else {
+    if ( !im_fileseek(block->ffile, block->foffset) )
+      return FALSE;
+    if ( !im_blockisICompressed( block ) ) {
+      if ( !im_fileread(block->ffile, block->data, block->tbytes) )
+        return FALSE;
+    } else {
+      /* Try and use a stack buffer if possible. It should be because
+       * the allocation is the max size of the original data.
+       */
+      uint8 buffer[ IM_BLOCK_DEFAULT_SIZE ];
+      if ( !im_fileread(block->ffile, buffer, block->cbytes) )
+        return FALSE;
+      if ( ! im_blockdecompress( ims, block, buffer ) )
+        return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
 static Bool im_blockGetMoveable(IM_STORE *ims, IM_BLOCK *block,
-                                int32 plane, int32 bx, Bool rendering)
+                                int32 plane, int32 bx, Bool rendering,
+                                Bool *loaded)
 {
   IM_BLIST *blist;
   Bool announce_block = FALSE;
@@ -1474,64 +1822,25 @@ static Bool im_blockGetMoveable(IM_STORE *ims, IM_BLOCK *block,
      * we clear that mark. */
     im_blockAllow();
 
-    /* Data can either be:
-     * a) compressed in memory.
-     * b) compressed on disk.
-     * c) non-compressed on disk.
-     */
-
-    if ( block->storage == IM_STORAGE_MEMORY ) {
-      HQASSERT(im_blockisICompressed( block ),
-               "block should either be compressed and/or on disk");
-      if ( ! im_blockdecompress( ims, block, block->cdata ) ) {
-        HQFAIL( "Somehow failed to decompress memory block" );
-        return FALSE;
-      }
-    }
-    else if ( block->storage == IM_STORAGE_UNIFORM_VARIANT ) {
-      /* Expand the uniform color value into the data referenced by
-       * im_storeread
-       */
-      uint32 npixels = block->xbytes, i ;
-
-      if ( ims->bpp == 16 ) {
-        uint16 *data = (uint16*)block->data ;
-
-        HQASSERT((block->xbytes & 1) == 0, "xbytes must be even for 16-bit image data") ;
-        npixels >>= 1 ;
-
-        for (i = 0; i < npixels; i++)
-          data[i] = block->uniformColor;
-      } else {
-        uint8 uniformColor8 = CAST_UNSIGNED_TO_UINT8(block->uniformColor) ;
+    if ( !im_blockload(ims, block) )
+      return FALSE;
 
-        for (i = 0; i < npixels; i++)
-          block->data[i] = uniformColor8;
-      }
-    }
-    else {
-      if ( !im_fileseek(block->ffile, block->foffset) )
-        return FALSE;
-      if ( !im_blockisICompressed( block ) ) {
-        if ( !im_fileread(block->ffile, block->data, block->tbytes) )
-          return FALSE;
-      } else {
-        /* Try and use a stack buffer if possible. It should be because
-         * the allocation is the max size of the original data.
-         */
-        uint8 buffer[ IM_BLOCK_DEFAULT_SIZE ];
-        if ( !im_fileread(block->ffile, buffer, block->cbytes) )
-          return FALSE;
-        if ( ! im_blockdecompress( ims, block, buffer ) )
-          return FALSE;
-      }
-    }
     /* OK, claim the lock to clear the is_loading flag. */
     im_blockForbid();
     block->flags &= ~IM_BLOCKFLAG_IS_LOADING;
     if ( block->refcount > 1 )
       /* Someone else cares that we got this */
       announce_block = TRUE;
+    if ( loaded != NULL &&
+         block->storage != IM_STORAGE_UNIFORM_VARIANT )
+      *loaded = TRUE;
+  }
+
+  /* First use of a block the read-ahead loaded; treat it as loaded here so
+     the read-ahead continues down the column. */
+  if ( loaded != NULL && (block->flags & IM_BLOCKFLAG_READ_AHEAD) != 0 ) {
+    block->flags &= ~IM_BLOCKFLAG_READ_AHEAD;
+    *loaded = TRUE;
   }
 
   blist = block->blist;
@@ -1554,6 +1863,157 @@ static Bool im_blockGetMoveable(IM_STORE *ims, IM_BLOCK *block,
   return TRUE;
 }
 
+/** Arguments for an image block read-ahead task. */
+typedef struct im_readahead_t {
+  IM_STORE *ims;   /**< Image store containing the block. */
+  IM_BLOCK *block; /**< Block to load; refcounted until cleanup. */
+  int32 plane;     /**< Plane index of the block. */
+  int32 bx;        /**< Column index of the block. */
+} im_readahead_t;
+
+/**
+ * Task function to load an image block ahead of the band that will need it.
+ * Only spare global blists that are not caching another block's data are
+ * used, so the read-ahead never competes for memory with the blocks that
+ * current bands are rendering from, and never evicts data that might be
+ * used again. Failure is not an error; the block will be loaded when it is
+ * actually needed.
+ */
+static Bool im_readahead(corecontext_t *context, void *args)
+{
+  im_readahead_t *readahead = args;
+  IM_STORE *ims = readahead->ims;
+  IM_BLOCK *block = readahead->block;
+  IM_BLIST *blist = NULL;
+
+  im_blockForbid();
+  if ( block->data == NULL &&
+       (block->flags & IM_BLOCKFLAG_IS_LOADING) == 0 &&
+       blist_toomany(ims->im_shared, 0) &&
+       (blist = blist_findGlobalFree(ims->im_shared, ims->abytes,
+                                     readahead->bx)) != NULL ) {
+    blist_link(blist, ims->planes[readahead->plane]);
+    block_from_blist(block, blist, TRUE);
+    block->flags |= IM_BLOCKFLAG_IS_LOADING;
+  }
+  im_blockAllow();
+
+  if ( blist == NULL )
+    return TRUE;
+
+  if ( !im_blockload(ims, block) ) {
+    im_blockForbid();
+    blist_setblock(blist, NULL);
+    block->blist = NULL;
+    block->data = NULL;
+    im_blockAllow();
+    error_clear_context(context->error);
+    blist = NULL;
+  } else {
+    IM_READAHEAD_METRIC_INCREMENT(loaded);
+  }
+
+  im_blockForbid();
+  block->flags &= ~IM_BLOCKFLAG_IS_LOADING;
+  if ( blist != NULL )
+    block->flags |= IM_BLOCKFLAG_READ_AHEAD;
+  if ( block->refcount > 1 )
+    /* A renderer is waiting for this block. */
+    multi_condvar_broadcast(&im_load_condvar);
+  im_blockAllow();
+
+  return TRUE;
+}
+
+/** Cleanup function for an image block read-ahead task. */
+static void im_readahead_cleanup(corecontext_t *context, void *args)
+{
+  im_readahead_t *readahead = args;
+
+  UNUSED_PARAM(corecontext_t *, context);
+
+  im_blockForbid();
+  readahead->block->refcount--;
+  multi_condvar_broadcast(&im_get_condvar);
+  im_blockAllow();
+
+  mm_free(mm_pool_temp, readahead, sizeof(im_readahead_t));
+}
+
+/**
+ * Having loaded block \a bb of a plane while rendering, schedule a task to
+ * load the next block down the same column, which the following band is
+ * likely to need. This is only worthwhile if there are other threads to
+ * run the task, and if there are spare blists beyond those required by the
+ * band extents of the images on the page. The task itself only takes a
+ * global blist which is not caching any block's data.
+ */
+static void im_blockreadahead(IM_STORE *ims, int32 plane, int32 bb, int32 bx)
+{
+  corecontext_t *context = get_core_context();
+  IM_BLOCK *block;
+  im_readahead_t *readahead;
+  task_group_t *group;
+  task_t *task;
+  Bool scheduled = FALSE;
+
+  if ( NUM_THREADS() <= 1 )
+    return;
+
+  bb += ims->xblock;
+  if ( bb >= ims->nblocks ||
+       (block = ims->planes[plane]->blocks[bb]) == NULL )
+    return;
+
+  im_blockForbid();
+  if ( !im_blockisIMoveable(block) || !im_blockcomplete(block) ||
+       block->data != NULL ||
+       (block->flags & IM_BLOCKFLAG_IS_LOADING) != 0 ||
+       block->storage == IM_STORAGE_UNIFORM_VARIANT ||
+       !blist_toomany(ims->im_shared, 0) ) {
+    im_blockAllow();
+    return;
+  }
+  block->refcount++;
+  im_blockAllow();
+
+  readahead = mm_alloc(mm_pool_temp, sizeof(im_readahead_t),
+                       MM_ALLOC_CLASS_IMAGE_DATA);
+  if ( readahead != NULL ) {
+    readahead->ims = ims;
+    readahead->block = block;
+    readahead->plane = plane;
+    readahead->bx = bx;
+
+    if ( (group = task_group_current(TASK_GROUP_RENDER)) != NULL ) {
+      error_context_t errcontext = ERROR_CONTEXT_INIT;
+      error_context_t *olderror = context->error;
+
+      /* Failing to schedule a read-ahead must not disturb the caller. */
+      context->error = &errcontext;
+      if ( task_create(&task, NULL, NULL, im_readahead, readahead,
+                       im_readahead_cleanup, group,
+                       SW_TRACE_IM_READAHEAD) ) {
+        /* The cleanup function now owns the arguments and refcount. */
+        scheduled = TRUE;
+        task_ready(task);
+        task_release(&task);
+        IM_READAHEAD_METRIC_INCREMENT(scheduled);
+      }
+      context->error = olderror;
+      task_group_release(&group);
+    }
+    if ( !scheduled )
+      mm_free(mm_pool_temp, readahead, sizeof(im_readahead_t));
+  }
+
+  if ( !scheduled ) {
+    im_blockForbid();
+    block->refcount--;
+    im_blockAllow();
+  }
+}
+
 void im_blockreadrelease(corecontext_t *context)
 {
   im_context_t *im_context = context->im_context ;
@@ -1774,6 +2234,7 @@ void im_blockclear(IM_BLIST *blist, int32 abytes, Bool xxx)
 
   block->data = NULL;
   block->blist = NULL;
+  block->flags &= ~IM_BLOCKFLAG_READ_AHEAD;
   if ( block->storage == IM_STORAGE_MEMORY && !im_blockisICompressed(block) )
       block->storage = IM_STORAGE_NONE;
   blist_setblock(blist, NULL);
@@ -1851,6 +2312,10 @@ static char im_storage(IM_BLOCK *block)
           return '3';
         case IM_COMPRESS_COPY:
           return 'y';
+        case IM_COMPRESS_LZ:
+          return 'z';
+        case IM_COMPRESS_LZ_DELTA:
+          return 'Z';
         default:
           return '?';
       }
@@ -2021,7 +2486,7 @@ Bool im_blockexists(IM_STORE *ims, int32 planei, int32 bb, int32 x,
     /* Moveable block handling */
     if ( im_blockisIMoveable(block) && (block->data == NULL) &&
          (block->storage != 0) ) {
-      if (!im_blockGetMoveable(ims, block, planei, x, FALSE /* rendering */))
+      if (!im_blockGetMoveable(ims, block, planei, x, FALSE /* rendering */, NULL))
         return FALSE;
     }
     if (( block->data == NULL) || (block->sbytes == 0))
@@ -2044,7 +2509,7 @@ Bool im_blockgetdata(IM_STORE *ims, int32 planei, int32 bx, int32 bb,
   /* Moveable block handling */
   if ( im_blockisIMoveable(block) && block->data == NULL &&
        block->storage != 0 ) {
-    if ( !im_blockGetMoveable(ims, block, planei, bx, FALSE /* rendering */) )
+    if ( !im_blockGetMoveable(ims, block, planei, bx, FALSE /* rendering */, NULL) )
       return FALSE;
   }
   /* if the block is has a global blist we need to grab it back */
@@ -2076,7 +2541,7 @@ Bool im_blockblistalloc(IM_STORE *ims, int32 planei,
   /* Moveable block handling */
   if ( im_blockisIMoveable(block) && (block->data == NULL) &&
        (block->storage != 0) )
-    if (!im_blockGetMoveable(ims, block, planei, bx, FALSE))
+    if (!im_blockGetMoveable(ims, block, planei, bx, FALSE, NULL))
       return FALSE;
   HQASSERT(block , "Somehow lost block");
 
@@ -0,0 +1,335 @@
+/** \file
+ * \ingroup images
+ *
+ * $HopeName: SWv20!src:imlz.c(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * Byte-oriented LZ compression of image store blocks.
+ *
+ * When memory is low, image blocks are compressed in memory. Running
+ * contone blocks through the LZW filter costs a filter setup for every
+ * block and a slow bit-oriented coder, and LZW compresses 8 and 16 bit
+ * contone data poorly. This module supplies a much faster LZ77 coder in the
+ * style of LZ4, called directly on the block data, and a per-row delta
+ * transform which turns smooth contone gradients into the short runs that
+ * LZ matches well.
+ *
+ * The compressed data is a sequence of
+ *
+ *   token, [literal length bytes], literals, offset, [match length bytes]
+ *
+ * The token's high nibble is the literal count and its low nibble is the
+ * match length less IMLZ_MINMATCH; a nibble of 15 is followed by bytes
+ * adding to it, ending with the first byte that is not 255. The offset is
+ * two bytes, least significant first, back from the current output
+ * position. The last sequence has only literals, and stops at the end of
+ * the data.
+ *
+ * Positions are held in 16 bits, so a block must be less than 64K; image
+ * blocks are well within this.
+ */
+
+#include "core.h"
+#include "hqmemcpy.h"           /* HqMemCpy */
+#include "hqmemset.h"           /* HqMemZero */
+#include "imlz.h"
+
+/** Shortest match that is coded. */
+#define IMLZ_MINMATCH     4
+
+/** Matches stop this far from the end of the data, so the match search
+    can always read a whole word. */
+#define IMLZ_LASTLITERALS 5
+
+/** Longest offset that can be coded. */
+#define IMLZ_MAXOFFSET    65535
+
+/** After 2^IMLZ_SKIPSHIFT consecutive failed searches, the search starts
+    stepping through the data faster, so incompressible blocks are rejected
+    quickly. */
+#define IMLZ_SKIPSHIFT    5
+
+/** Read four bytes, independently of alignment and byte order. */
+#define IMLZ_READ32(p_) \
+  ((uint32)(p_)[0] | ((uint32)(p_)[1] << 8) | \
+   ((uint32)(p_)[2] << 16) | ((uint32)(p_)[3] << 24))
+
+/** Hash of four bytes into the match hash table. */
+#define IMLZ_HASH(v_) ((uint32)((v_) * 2654435761u) >> (32 - IMLZ_HASHBITS))
+
+/**
+ * Output one sequence of literals, followed by a match if mlen is non-zero.
+ *
+ * \return  The new output position, or NULL if the sequence does not fit.
+ */
+static uint8 *imlz_sequence(uint8 *op, const uint8 *oend,
+                            const uint8 *lit, int32 nlit,
+                            int32 offset, int32 mlen)
+{
+  uint8 *token;
+  int32 n;
+
+  /* Worst case size of the sequence. */
+  if ( oend - op < 1 + nlit + nlit / 255 + 1 + 2 + mlen / 255 + 1 )
+    return NULL;
+
+  token = op++;
+  if ( nlit >= 15 ) {
+    *token = 15 << 4;
+    for ( n = nlit - 15; n >= 255; n -= 255 )
+      *op++ = 255;
+    *op++ = (uint8)n;
+  } else
+    *token = (uint8)(nlit << 4);
+
+  HqMemCpy(op, lit, nlit);
+  op += nlit;
+
+  if ( mlen > 0 ) {
+    HQASSERT(mlen >= IMLZ_MINMATCH, "LZ match too short");
+    HQASSERT(offset > 0 && offset <= IMLZ_MAXOFFSET, "LZ offset out of range");
+    *op++ = (uint8)(offset & 0xff);
+    *op++ = (uint8)(offset >> 8);
+    n = mlen - IMLZ_MINMATCH;
+    if ( n >= 15 ) {
+      *token |= 15;
+      for ( n -= 15; n >= 255; n -= 255 )
+        *op++ = 255;
+      *op++ = (uint8)n;
+    } else
+      *token |= (uint8)n;
+  }
+
+  return op;
+}
+
+/**
+ * Compress a block of data.
+ *
+ * \param[in]   src        Pointer to the data to compress
+ * \param[in]   srclen     Number of bytes of data; less than 64K
+ * \param[out]  dst        Pointer to resulting compressed data
+ * \param[in]   maxbytes   Maximum number of bytes of output allowed
+ * \param[in]   hash       Work area of IMLZ_HASHSIZE entries for the match
+ *                         hash table
+ * \return                 Number of compressed bytes created, or -1 if the
+ *                         compressed data would not fit in maxbytes.
+ */
+int32 imlz_compress(const uint8 *src, int32 srclen,
+                    uint8 *dst, int32 maxbytes, uint16 *hash)
+{
+  const uint8 *ip = src, *anchor = src;
+  const uint8 *iend = src + srclen;
+  uint8 *op = dst;
+  const uint8 *oend = dst + maxbytes;
+
+  HQASSERT(src != NULL && dst != NULL && hash != NULL,
+           "No LZ compression buffers");
+  HQASSERT(srclen >= 0 && srclen <= 65535, "LZ block too large");
+
+  if ( srclen > IMLZ_MINMATCH + IMLZ_LASTLITERALS ) {
+    const uint8 *mflimit = iend - IMLZ_LASTLITERALS;
+    uint32 misses = 0;
+
+    /* An empty entry refers to the start of the data, which is verified like
+       any other candidate. */
+    HqMemZero(hash, IMLZ_HASHSIZE * sizeof(hash[0]));
+
+    while ( ip < mflimit ) {
+      uint32 seq = IMLZ_READ32(ip);
+      uint32 h = IMLZ_HASH(seq);
+      const uint8 *ref = src + hash[h];
+
+      hash[h] = (uint16)(ip - src);
+
+      if ( ref < ip && ip - ref <= IMLZ_MAXOFFSET &&
+           IMLZ_READ32(ref) == seq ) {
+        const uint8 *mp = ip + IMLZ_MINMATCH;
+        const uint8 *rp = ref + IMLZ_MINMATCH;
+
+        while ( mp < mflimit && *mp == *rp ) {
+          ++mp;
+          ++rp;
+        }
+        /* Take in any matching bytes before the hashed position. */
+        while ( ip > anchor && ref > src && ip[-1] == ref[-1] ) {
+          --ip;
+          --ref;
+        }
+
+        if ( (op = imlz_sequence(op, oend, anchor, CAST_PTRDIFFT_TO_INT32(ip - anchor),
+                                 CAST_PTRDIFFT_TO_INT32(ip - ref),
+                                 CAST_PTRDIFFT_TO_INT32(mp - ip))) == NULL )
+          return -1;
+
+        anchor = ip = mp;
+        misses = 0;
+      } else
+        ip += 1 + (misses++ >> IMLZ_SKIPSHIFT);
+    }
+  }
+
+  if ( (op = imlz_sequence(op, oend, anchor,
+                           CAST_PTRDIFFT_TO_INT32(iend - anchor), 0, 0)) == NULL )
+    return -1;
+
+  return CAST_PTRDIFFT_TO_INT32(op - dst);
+}
+
+/**
+ * Decompress a block of data compressed by imlz_compress().
+ *
+ * \param[in]   src      Pointer to the compressed input data
+ * \param[in]   srclen   Number of bytes of input
+ * \param[out]  dst      Pointer to resulting data
+ * \param[in]   dstlen   Number of bytes of data expected
+ * \return               Success status; FALSE if the data is corrupt, or
+ *                       does not produce exactly dstlen bytes.
+ */
+Bool imlz_decompress(const uint8 *src, int32 srclen,
+                     uint8 *dst, int32 dstlen)
+{
+  const uint8 *ip = src, *iend = src + srclen;
+  uint8 *op = dst, *oend = dst + dstlen;
+
+  HQASSERT(src != NULL && dst != NULL, "No LZ decompression buffers");
+
+  while ( ip < iend ) {
+    uint32 token = *ip++;
+    int32 len = (int32)(token >> 4), offset;
+    uint32 b;
+
+    if ( len == 15 ) {
+      do {
+        if ( ip >= iend )
+          return FALSE;
+        len += (int32)(b = *ip++);
+      } while ( b == 255 );
+    }
+    if ( len > iend - ip || len > oend - op )
+      return FALSE;
+    HqMemCpy(op, ip, len);
+    ip += len;
+    op += len;
+
+    if ( ip == iend )
+      break;
+
+    if ( iend - ip < 2 )
+      return FALSE;
+    offset = (int32)ip[0] | ((int32)ip[1] << 8);
+    ip += 2;
+    if ( offset == 0 || offset > op - dst )
+      return FALSE;
+
+    len = (int32)(token & 15);
+    if ( len == 15 ) {
+      do {
+        if ( ip >= iend )
+          return FALSE;
+        len += (int32)(b = *ip++);
+      } while ( b == 255 );
+    }
+    len += IMLZ_MINMATCH;
+    if ( len > oend - op )
+      return FALSE;
+
+    if ( offset >= len ) {
+      HqMemCpy(op, op - offset, len);
+      op += len;
+    } else {
+      /* Overlapping match, repeating the last offset bytes. */
+      const uint8 *ref = op - offset;
+      while ( --len >= 0 )
+        *op++ = *ref++;
+    }
+  }
+
+  return op == oend;
+}
+
+/**
+ * Decide whether a block of contone data is likely to compress better
+ * after the delta transform.
+ *
+ * Runs of identical samples compress well either way, but gradients only
+ * become runs after the delta transform. A sample of the rows is examined,
+ * and the transform is preferred if there are more small steps between
+ * neighbouring samples than identical neighbours.
+ *
+ * \param[in]   src       Pointer to the block data
+ * \param[in]   rowbytes  Number of bytes in each row
+ * \param[in]   rows      Number of rows
+ * \param[in]   step      Number of bytes in each sample
+ * \return                TRUE if the delta transform should be used first.
+ */
+Bool imlz_prefer_delta(const uint8 *src, int32 rowbytes, int32 rows,
+                       int32 step)
+{
+  int32 y, x, same = 0, small = 0;
+  int32 ystep = rows > 16 ? rows / 16 : 1;
+
+  for ( y = 0; y < rows; y += ystep ) {
+    const uint8 *row = src + y * rowbytes;
+
+    for ( x = step; x < rowbytes; ++x ) {
+      int32 diff = (int8)(row[x] - row[x - step]);
+
+      if ( diff == 0 )
+        ++same;
+      else if ( diff >= -4 && diff <= 4 )
+        ++small;
+    }
+  }
+
+  return small > same;
+}
+
+/**
+ * Replace each sample after the first in each row by its difference from
+ * the previous sample.
+ *
+ * \param[in]   src       Pointer to the block data
+ * \param[out]  dst       Pointer to the transformed data
+ * \param[in]   rowbytes  Number of bytes in each row
+ * \param[in]   rows      Number of rows
+ * \param[in]   step      Number of bytes in each sample
+ */
+void imlz_delta_encode(const uint8 *src, uint8 *dst, int32 rowbytes,
+                       int32 rows, int32 step)
+{
+  int32 y, x;
+
+  for ( y = 0; y < rows; ++y ) {
+    for ( x = 0; x < step && x < rowbytes; ++x )
+      dst[x] = src[x];
+    for ( ; x < rowbytes; ++x )
+      dst[x] = (uint8)(src[x] - src[x - step]);
+    src += rowbytes;
+    dst += rowbytes;
+  }
+}
+
+/**
+ * Undo imlz_delta_encode(), in place.
+ *
+ * \param[in,out] data      Pointer to the transformed data
+ * \param[in]     rowbytes  Number of bytes in each row
+ * \param[in]     rows      Number of rows
+ * \param[in]     step      Number of bytes in each sample
+ */
+void imlz_delta_decode(uint8 *data, int32 rowbytes, int32 rows, int32 step)
+{
+  int32 y, x;
+
+  for ( y = 0; y < rows; ++y ) {
+    for ( x = step; x < rowbytes; ++x )
+      data[x] = (uint8)(data[x] + data[x - step]);
+    data += rowbytes;
+  }
+}
+
+/* Log stripped */
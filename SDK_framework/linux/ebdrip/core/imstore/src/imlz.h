@@ -0,0 +1,39 @@
+/** \file
+ * \ingroup images
+ *
+ * $HopeName: SWv20!src:imlz.h(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * API to the byte-oriented LZ image block compressor
+ */
+
+#ifndef __IMLZ_H__
+#define __IMLZ_H__
+
+/** Log2 of the number of entries in the match hash table. */
+#define IMLZ_HASHBITS     12
+
+/** Number of entries in the match hash table the caller supplies to
+    imlz_compress(). */
+#define IMLZ_HASHSIZE     (1 << IMLZ_HASHBITS)
+
+int32 imlz_compress(const uint8 *src, int32 srclen,
+                    uint8 *dst, int32 maxbytes, uint16 *hash);
+
+Bool imlz_decompress(const uint8 *src, int32 srclen,
+                     uint8 *dst, int32 dstlen);
+
+Bool imlz_prefer_delta(const uint8 *src, int32 rowbytes, int32 rows,
+                       int32 step);
+
+void imlz_delta_encode(const uint8 *src, uint8 *dst, int32 rowbytes,
+                       int32 rows, int32 step);
+
+void imlz_delta_decode(uint8 *data, int32 rowbytes, int32 rows, int32 step);
+
+#endif /* __IMLZ_H__ protection from multiple inclusion */
+
+/* Log stripped */
@@ -62,7 +62,10 @@ enum {
   IM_COMPRESS_CCITT,
   IM_COMPRESS_FLATE,
   IM_COMPRESS_B32, /* special compression for 32bit images */
-  IM_COMPRESS_COPY
+  IM_COMPRESS_COPY,
+  IM_COMPRESS_LZ,       /* byte-oriented LZ, for contone images */
+  IM_COMPRESS_LZ_DELTA, /* byte-oriented LZ of row deltas */
+  IM_COMPRESS_N_METHODS /* Number of methods; must be last */
 };
 
 enum {
@@ -108,6 +111,10 @@ enum {
      compressing or writing to disk. */
   IM_BLOCKFLAG_CHECKED_FOR_UNIFORM_DATA =     0x08,
 
+  /** The block's data was loaded by a read-ahead task, and no band has used
+      it yet. The first band to use it schedules the next read-ahead. */
+  IM_BLOCKFLAG_READ_AHEAD =                   0x10,
+
   /** Trimmed blocks get this flag indicating that it's OK for them to have
       no data.  When image filtering we can have blocks that may be disposed
       of or reused */
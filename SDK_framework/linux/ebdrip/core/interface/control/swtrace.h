@@ -70,6 +70,7 @@ typedef void (RIPFASTCALL SwTraceHandlerFn)(int trace_id,
   macro_(INTERPRET_PCLXL_FONT) /* Time in PCL XL font downloading. */ \
   macro_(INTERPRET_IMAGE)  /* Time spent in image interpretation */ \
   macro_(INTERPRET_JPEG)   /* Time spent in JPEG interpretation */ \
+  macro_(JPEG_SEGMENT)     /* Decoding a JPEG restart segment. */ \
   macro_(INTERPRET_TOMSTABLE) /* Interpretation time in Toms Table code */  \
   macro_(FONT_CACHE)       /* Time building font caches. */ \
   macro_(FONT_PFIN)        /* Time spent in PFIN modules. */ \
@@ -118,6 +119,8 @@ typedef void (RIPFASTCALL SwTraceHandlerFn)(int trace_id,
   macro_(RENDER_BACKDROP)  /* Time spent rendering a backdrop object */ \
   macro_(RENDER_ERASE)     /* Time spent rendering an erase object */ \
   macro_(COMPRESS_BAND)    /* Per-band compression time. */ \
+  macro_(COMPRESS_BAND_SETUP) /* %compress% device instance setup. */ \
+  macro_(COMPRESS_BAND_ENCODE) /* %compress% device band encoding. */ \
   macro_(OUTPUT_BAND)      /* Per-band output time. */ \
   macro_(READBACK_BAND)    /* Read band band from PGB device. */ \
   macro_(RETAINED_RASTER_CAPTURE) /* Time capturing retained raster. */ \
@@ -161,6 +164,9 @@ typedef void (RIPFASTCALL SwTraceHandlerFn)(int trace_id,
   macro_(IM_BLOCK_HOLD)    /* Image block mutex hold. */ \
   macro_(IM_STORE_ACQUIRE) /* Image store mutex acquire. */ \
   macro_(IM_STORE_HOLD)    /* Image store mutex hold. */ \
+  macro_(IM_COMPRESS)      /* Image block compression, by method. */ \
+  macro_(IM_DECOMPRESS)    /* Image block decompression, by method. */ \
+  macro_(IM_READAHEAD)     /* Image block read-ahead during rendering. */ \
   macro_(RSD_ACQUIRE)      /* RSD mutex acquire. */ \
   macro_(RSD_HOLD)         /* RSD mutex hold. */ \
   macro_(HT_CACHE_ACQUIRE) /* Halftone cache mutex acquire. */ \
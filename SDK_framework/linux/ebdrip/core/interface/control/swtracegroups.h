@@ -61,6 +61,7 @@ const static sw_tracegroup_t trace_groups[] = {
       SW_TRACE_INTERPRET_HPGL2,
       SW_TRACE_FONT_CACHE, SW_TRACE_FONT_PFIN, SW_TRACE_USERPATH_CACHE,
       SW_TRACE_INTERPRET_IMAGE, SW_TRACE_INTERPRET_JPEG,
+      SW_TRACE_JPEG_SEGMENT,
       SW_TRACE_INTERPRET_TOMSTABLE,
       SW_TRACE_PROBE, SW_TRACE_INVALID
     }
@@ -73,6 +74,7 @@ const static sw_tracegroup_t trace_groups[] = {
       SW_TRACE_DL_PREPARE, SW_TRACE_DL_PRECONVERT,
       SW_TRACE_TRAP_INIT, SW_TRACE_TRAP,
       SW_TRACE_RENDER_BAND, SW_TRACE_COMPRESS_BAND, SW_TRACE_OUTPUT_BAND,
+      SW_TRACE_COMPRESS_BAND_SETUP, SW_TRACE_COMPRESS_BAND_ENCODE,
       SW_TRACE_RENDER_SPLIT_X, SW_TRACE_RENDER_SPLIT_Y,
       SW_TRACE_MHT_GATE,
       SW_TRACE_RETAINED_RASTER_CAPTURE,
@@ -146,6 +148,7 @@ const static sw_tracegroup_t trace_groups[] = {
     {
       SW_TRACE_COMPOSITE_BAND, SW_TRACE_RENDER_BAND, SW_TRACE_MHT_GATE,
       SW_TRACE_COMPRESS_BAND, SW_TRACE_OUTPUT_BAND, SW_TRACE_READBACK_BAND,
+      SW_TRACE_COMPRESS_BAND_SETUP, SW_TRACE_COMPRESS_BAND_ENCODE,
       SW_TRACE_RENDER_FRAME_START, SW_TRACE_RENDER_FRAME_DONE,
       SW_TRACE_SHEET_START, SW_TRACE_SHEET_DONE,
       SW_TRACE_SHEET_RENDER_DONE, SW_TRACE_SHEET_OUTPUT_DONE,
@@ -257,7 +260,9 @@ const static sw_tracegroup_t trace_groups[] = {
   },
   { "memory", "Memory group, for memory tracing:",
     {
-      SW_TRACE_HANDLING_LOWMEM, SW_TRACE_MPS_COMMITTED, SW_TRACE_INVALID
+      SW_TRACE_HANDLING_LOWMEM, SW_TRACE_MPS_COMMITTED,
+      SW_TRACE_IM_COMPRESS, SW_TRACE_IM_DECOMPRESS, SW_TRACE_IM_READAHEAD,
+      SW_TRACE_INVALID
     }
   },
   /* Last element should have trailing comma, for skin groups that follow. */
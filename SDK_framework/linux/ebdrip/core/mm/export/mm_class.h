@@ -188,6 +188,7 @@ MM_ALLOC_CLASS(HALFTONE_XY)     /* halftone XY coords */
 MM_ALLOC_CLASS(HALFTONE_FORMCACHE) /* halftone form pointer list */
 MM_ALLOC_CLASS(HALFTONE_FORM)   /* halftone form */
 MM_ALLOC_CLASS(HALFTONE_LEVELS) /* halftone form usage pointers */
+MM_ALLOC_CLASS(HALFTONE_TILES)  /* halftone tile rows for rendering */
 MM_ALLOC_CLASS(HALFTONE_PATH)   /* halftone cache path on disk */
 MM_ALLOC_CLASS(TRANSFER_ARRAY)  /* transfer array for threshold ht */
 MM_ALLOC_CLASS(HPS_PHASE)       /* HPS temporary phase array */
@@ -332,6 +333,7 @@ MM_ALLOC_CLASS(RBT_WORKSPACE)
 MM_ALLOC_CLASS(DL_CELL)
 MM_ALLOC_CLASS(DL_CELL_LUT)
 MM_ALLOC_CLASS(DL_CELL_STREAM)
+MM_ALLOC_CLASS(RAINSTORM)
 
 MM_ALLOC_CLASS(BACKDROP_STATE)
 MM_ALLOC_CLASS(BACKDROP_DATA)
@@ -492,6 +494,7 @@ MM_ALLOC_CLASS(FRAME_DATA)
 MM_ALLOC_CLASS(SHEET_DATA)
 MM_ALLOC_CLASS(PASS_DATA)
 MM_ALLOC_CLASS(PAGE_DATA)
+MM_ALLOC_CLASS(COMPRESS_DEVICE)
 
 MM_ALLOC_CLASS(HTM_RENDER_INFO)
 MM_ALLOC_CLASS(ERASE_ARGS)
@@ -123,16 +123,14 @@ Bool task_group_join(/*@notnull@*/ /*@in@*/ task_group_t *group,
 
     \param group_type  The group type to find.
 
-    \returns The specified ancestor group of the current task.
-     \todo ajcd 2011-04-09: Haven't decided if we should return NULL if
-     ancestor type isn't found, or assert it. Depends on how implementation
-     goes.
+    \returns The specified ancestor group of the current task, or NULL if
+    the current task is not inside a group of that type.
 
      \note This function acquires a reference to the group returned. This
      reference \b must be released with \c task_group_release(), or passed
      to a function that consumes the reference.
 */
-/*@notnull@*/ /*@dependent@*/
+/*@null@*/ /*@dependent@*/
 task_group_t *task_group_current(task_grouptype_t group_type) ;
 
 /** \brief Return the root (interpreter) task group.
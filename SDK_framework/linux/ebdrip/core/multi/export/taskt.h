@@ -47,6 +47,7 @@ typedef struct task_group_t task_group_t ;
   macro_(FRAME) \
   macro_(BAND) \
   macro_(TRAP) \
+  macro_(IMAGE) /* Image filter decode tasks (inside root) */ \
   macro_(ORPHANS) /* Finalised tasks with references to them. */
 
 #define TASK_GROUP_ENUM(x) TASK_GROUP_ ## x,
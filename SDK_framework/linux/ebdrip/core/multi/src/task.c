@@ -99,6 +99,22 @@ static unsigned int helper_end_threshold ;
 /** Throttle the task producer when tasks greater or equal to this threshold. */
 static unsigned int helper_wait_threshold ;
 
+/** Default for whether dispatchable tasks are distributed through per-thread
+    run queues, with idle threads stealing work from each other, rather than
+    being found by walking the global task schedule. */
+#define TASK_WORK_STEALING FALSE
+
+/** Variable for the scheduler mode, set by the TaskWorkStealing system
+    param. This may ONLY be modified whilst holding the \c task_mutex. It is
+    read without the lock before taking tasks from the run queues, but tasks
+    taken are validated with the lock held. */
+static Bool task_work_stealing ;
+
+/** Capacity of each thread's run queue. This must be a power of two. Tasks
+    that do not fit in a run queue are found by walking the global schedule,
+    as they would be without work stealing. */
+#define TASK_RUNQ_SIZE 256
+
 /*****************************************************************************/
 
 /** \brief Thread state. */
@@ -115,6 +131,26 @@ enum {
     to be changed outside of the task mutex. */
 typedef hq_atomic_counter_t thread_state_t ;
 
+/** \brief Per-thread run queue of dispatchable tasks.
+
+    This is a double-ended queue in a fixed-size ring. The owning thread
+    pushes and takes tasks at the tail, so the task it most recently made
+    ready (and which most likely shares data with the task it just ran) is
+    run next. Other threads steal from the head, taking the oldest task.
+    Each entry holds a counted reference to a task.
+
+    Each queue is protected by its own spinlock, not the \c task_mutex, so
+    threads can push, take and steal without contending for the task system
+    lock. The spinlock may be taken with or without the \c task_mutex held,
+    but the \c task_mutex must never be taken (or a task released) whilst
+    holding the spinlock. */
+typedef struct task_runq_t {
+  hq_atomic_counter_t lock ;      /**< Spinlock for this queue. */
+  unsigned int head ;             /**< Index of oldest entry. */
+  unsigned int tail ;             /**< Index after newest entry. */
+  task_t *tasks[TASK_RUNQ_SIZE] ; /**< Ring of counted task references. */
+} task_runq_t ;
+
 /** \brief Thread-local task context.
 
     There is one task context per thread. The current task is saved and reset
@@ -125,6 +161,7 @@ typedef struct task_context_t {
   multi_condvar_t cond ;          /**< Condition this thread waits on. */
   dll_link_t thread_list ;        /**< Link on thread list. */
   thread_state_t state ;          /**< Thread state. */
+  task_runq_t *runq ;             /**< This thread's run queue, or NULL. */
   OBJECT_NAME_MEMBER
 } task_context_t ;
 
@@ -794,6 +831,18 @@ static int groups_peak_allocated = 0 ;
 int requirements_total_allocated ;
 int requirements_current_allocated ;
 int requirements_peak_allocated ;
+/* The run queue counters are updated outside of the task mutex. */
+static hq_atomic_counter_t runq_pushed = 0 ;
+static hq_atomic_counter_t runq_taken = 0 ;
+static hq_atomic_counter_t runq_stolen = 0 ;
+static hq_atomic_counter_t runq_stale = 0 ;
+static hq_atomic_counter_t runq_overflowed = 0 ;
+
+#define RUNQ_METRIC_INCREMENT(name_) MACRO_START \
+  hq_atomic_counter_t _before_ ; \
+  HqAtomicIncrement(&runq_ ## name_, _before_) ; \
+  UNUSED_PARAM(hq_atomic_counter_t, _before_) ; \
+MACRO_END
 
 static Bool tasks_metrics_update(sw_metrics_group *metrics)
 {
@@ -811,6 +860,11 @@ static Bool tasks_metrics_update(sw_metrics_group *metrics)
   SW_METRIC_INTEGER("requirements_total_allocated", requirements_total_allocated) ;
   SW_METRIC_INTEGER("requirements_peak_allocated", requirements_peak_allocated) ;
   SW_METRIC_INTEGER("requirements_current_allocated", requirements_current_allocated) ;
+  SW_METRIC_INTEGER("runq_pushed", (int)runq_pushed) ;
+  SW_METRIC_INTEGER("runq_taken", (int)runq_taken) ;
+  SW_METRIC_INTEGER("runq_stolen", (int)runq_stolen) ;
+  SW_METRIC_INTEGER("runq_stale", (int)runq_stale) ;
+  SW_METRIC_INTEGER("runq_overflowed", (int)runq_overflowed) ;
   sw_metrics_close_group(&metrics) ; /* Tasks */
 
   if ( mm_pool_task ) { /* Track peak memory allocated in pool. */
@@ -838,6 +892,7 @@ static void tasks_metrics_reset(int reason)
   groups_peak_allocated = (int)(groups_incomplete + groups_complete) ;
   links_peak_allocated = links_current_allocated ;
   requirements_peak_allocated = requirements_current_allocated ;
+  runq_pushed = runq_taken = runq_stolen = runq_stale = runq_overflowed = 0 ;
 }
 
 static sw_metrics_callbacks tasks_metrics_hook = {
@@ -845,6 +900,8 @@ static sw_metrics_callbacks tasks_metrics_hook = {
   tasks_metrics_reset,
   NULL
 } ;
+#else /* !METRICS_BUILD */
+#define RUNQ_METRIC_INCREMENT(name_) EMPTY_STATEMENT()
 #endif /* METRICS_BUILD */
 
 /****************************************************************************/
@@ -1853,6 +1910,338 @@ static void task_unlink_locked(task_link_t *entry)
 #endif
 }
 
+/****************************************************************************/
+/* Per-thread run queues for work stealing. When enabled, a task that
+   becomes dispatchable is pushed onto the run queue of the thread that made
+   it so. Dispatching threads take from their own queue first, then steal
+   from the other threads' queues, and only walk the task schedule (possibly
+   recomputing it, and provisioning groups) if the queues are empty.
+
+   The run queues have their own spinlocks, so pushing, taking and stealing
+   don't need the task_mutex. Tasks become dispatchable during graph
+   mutations, so pushes happen with the task_mutex already held. Dispatching
+   threads take candidates from the run queues before they lock the
+   task_mutex, and only lock it to claim the candidate, which changes the
+   task's state and the runnability counters.
+
+   The task schedule remains the authoritative record of incomplete tasks.
+   Run queue entries are hints, and may go stale if the task is activated
+   by a helper, join, or schedule walk, or if it changes runnability before
+   being taken. Stale entries are discarded when they are claimed. Tasks are
+   only pushed when they become dispatchable, so group provisioning still
+   follows the group schedule. */
+
+/** Number of run queues. The last thread index is used by threads outside
+    the pool, which do not dispatch tasks, so they have no run queue. */
+#define TASK_RUNQ_COUNT (NTHREADS_LIMIT - 1)
+
+/** The run queues, indexed by thread index. These outlive the threads using
+    them, so other threads can steal from them without holding the
+    \c task_mutex to stabilise the thread list. */
+static task_runq_t task_runqs[TASK_RUNQ_COUNT] ;
+
+/** \brief Initialise all of the run queues to be empty and unlocked. */
+static void runq_init_all(void)
+{
+  unsigned int i ;
+
+  for ( i = 0 ; i < TASK_RUNQ_COUNT ; ++i )
+    task_runqs[i].lock = task_runqs[i].head = task_runqs[i].tail = 0 ;
+}
+
+/** \brief Find the run queue for a thread index.
+
+    \param thread_index  The thread index of a thread in the pool, or the
+                         interpreter thread.
+
+    \returns The run queue the thread owns, or NULL if the thread has none.
+*/
+static inline task_runq_t *runq_for_thread(unsigned int thread_index)
+{
+  return thread_index < TASK_RUNQ_COUNT ? &task_runqs[thread_index] : NULL ;
+}
+
+/** \brief Can a task taken from a run queue be dispatched?
+
+    \param task   The task taken from the run queue.
+    \param found  The task filter. If the task is usable, this is updated
+                  to refer to it.
+
+    \retval TRUE  The task matched the filter. An uncounted reference to it
+                  is stored in \c found.
+    \retval FALSE The task did not match the filter.
+*/
+static inline Bool runq_usable(/*@notnull@*/ task_t *task,
+                               /*@notnull@*/ task_find_t *found)
+{
+  VERIFY_OBJECT(task, TASK_NAME) ;
+  HQASSERT(multi_mutex_is_locked(&task_mutex), "Run queue claim needs lock") ;
+
+  if ( task->runnability < found->level &&
+       (found->specialiser == NULL ||
+        (task->specialiser == found->specialiser &&
+         task->specialiser_args == found->specialiser_args)) ) {
+    /* Dispatchable tasks are incomplete, so the group's task list still
+       holds a reference after we release the run queue's reference. */
+    HQASSERT(task->state == TASK_READY || task->state == TASK_CANCELLED,
+             "Dispatchable task in unexpected state") ;
+    found->task = task ;
+    found->level = task->runnability ;
+    return TRUE ;
+  }
+
+  return FALSE ;
+}
+
+/** \brief Push a task that has just become dispatchable onto the run queue
+    of the current thread.
+
+    This is called from graph mutations, so the \c task_mutex is held, but
+    it is not needed by the run queue itself. */
+static void runq_push(/*@notnull@*/ task_t *task)
+{
+  corecontext_t *context = get_core_context() ;
+  task_context_t *taskcontext ;
+  task_runq_t *runq ;
+  Bool pushed = FALSE ;
+
+  /* Threads that are not in the pool (or the interpreter) have no run queue
+     that anyone would steal from. */
+  if ( context == NULL || (taskcontext = context->taskcontext) == NULL ||
+       (runq = taskcontext->runq) == NULL )
+    return ;
+
+  VERIFY_OBJECT(taskcontext, TASK_CONTEXT_NAME) ;
+
+  /* The reference is taken before the task is visible to other threads.
+     A full queue leaves the task to be found on the schedule. */
+  task = task_acquire(task) ;
+
+  spinlock_counter(&runq->lock, 1) ;
+  if ( runq->tail - runq->head < TASK_RUNQ_SIZE ) {
+    runq->tasks[runq->tail++ & (TASK_RUNQ_SIZE - 1)] = task ;
+    pushed = TRUE ;
+  }
+  spinunlock_counter(&runq->lock) ;
+
+  if ( pushed ) {
+    RUNQ_METRIC_INCREMENT(pushed) ;
+  } else {
+    /* The schedule holds a reference, so this can't be the last one. */
+    hq_atomic_counter_t after ;
+    HqAtomicDecrement(&task->refcount, after) ;
+    HQASSERT(after > 0, "Pushed task had no other references") ;
+    RUNQ_METRIC_INCREMENT(overflowed) ;
+  }
+}
+
+/** \brief Take a candidate task from the run queues, without needing the
+    \c task_mutex.
+
+    \param self              The run queue of the calling thread.
+    \param steal             If TRUE, steal from other threads' run queues
+                             if this thread's queue is empty.
+    \param specialiser       If not NULL, only the newest task on this
+                             thread's own queue is taken, and only if it
+                             has this specialiser, because the caller is
+                             trying to re-use its specialisation.
+    \param specialiser_args  The specialiser args to match.
+    \param stolen            Set to TRUE if the task came from another
+                             thread's queue.
+
+    \returns A counted reference to a task, which may be stale, or NULL if no
+    candidate was found. The caller must claim it with runq_claim_locked().
+*/
+static task_t *runq_take(/*@notnull@*/ task_runq_t *self, Bool steal,
+                         task_specialiser_fn *specialiser,
+                         void *specialiser_args,
+                         /*@notnull@*/ Bool *stolen)
+{
+  task_t *task = NULL ;
+  unsigned int i, start ;
+
+  *stolen = FALSE ;
+
+  /* Take the most recent task from our own queue. The specialiser is set
+     when a task is created, so it can be checked without the task_mutex. */
+  spinlock_counter(&self->lock, 1) ;
+  if ( self->head != self->tail ) {
+    task_t *newest = self->tasks[(self->tail - 1) & (TASK_RUNQ_SIZE - 1)] ;
+    if ( specialiser == NULL ||
+         (newest->specialiser == specialiser &&
+          newest->specialiser_args == specialiser_args) ) {
+      --self->tail ;
+      task = newest ;
+    }
+  }
+  spinunlock_counter(&self->lock) ;
+
+  if ( task != NULL || !steal || specialiser != NULL )
+    return task ;
+
+  /* Steal the oldest task from each other queue in turn, starting after our
+     own queue so that victims are spread around. The unlocked emptiness
+     test is only a hint. */
+  start = (unsigned int)(self - task_runqs) ;
+  for ( i = 1 ; i < TASK_RUNQ_COUNT && task == NULL ; ++i ) {
+    task_runq_t *victim = &task_runqs[(start + i) % TASK_RUNQ_COUNT] ;
+
+    if ( victim->head == victim->tail )
+      continue ;
+
+    spinlock_counter(&victim->lock, 1) ;
+    if ( victim->head != victim->tail )
+      task = victim->tasks[victim->head++ & (TASK_RUNQ_SIZE - 1)] ;
+    spinunlock_counter(&victim->lock) ;
+  }
+
+  *stolen = (task != NULL) ;
+  return task ;
+}
+
+/** \brief Take a candidate task from the run queues, discarding entries
+    that are obviously stale without locking the \c task_mutex.
+
+    The caller must not hold the \c task_mutex. Arguments are as for
+    runq_take(). The runnability is read without the \c task_mutex, so a
+    candidate returned may still be stale, but a task that is not
+    dispatchable when it is taken can be dropped: if it becomes dispatchable
+    again it is pushed again, and the schedule still has it anyway.
+
+    \returns A counted reference to a candidate task, or NULL.
+*/
+static task_t *runq_take_unlocked(/*@notnull@*/ task_runq_t *self, Bool steal,
+                                  task_specialiser_fn *specialiser,
+                                  void *specialiser_args,
+                                  /*@notnull@*/ Bool *stolen)
+{
+  task_t *task ;
+
+  while ( (task = runq_take(self, steal, specialiser, specialiser_args,
+                            stolen)) != NULL ) {
+    if ( task->runnability < RL_DISPATCHABLE )
+      break ;
+
+    /* This may be the last reference, in which case task_release() locks
+       the task_mutex to destroy it. */
+    task_release(&task) ;
+    RUNQ_METRIC_INCREMENT(stale) ;
+
+    /* Only the newest task on our own queue is a specialisation match. */
+    if ( specialiser != NULL )
+      break ;
+  }
+
+  return task ;
+}
+
+/** \brief Claim a candidate task taken from a run queue.
+
+    Claiming does need the \c task_mutex. Activating the task changes its
+    state and runnability, the runnability totals, and the group's running
+    counts, all of which are read by schedule walks, helpers, joins and the
+    low-memory handler under the \c task_mutex. The dispatcher must take the
+    lock after each task anyway to account for threads_scheduled, so the
+    claim shares that acquisition rather than adding another one. The run
+    queues take the search out of the locked region, and
+    runq_take_unlocked() drops stale entries before locking.
+
+    \param candidate  A counted reference to the candidate task. The
+                      reference is released, and the pointer cleared.
+    \param stolen     Whether the candidate was stolen, for metrics.
+    \param found      The task filter. If the candidate is usable, this is
+                      updated to refer to it.
+
+    \retval TRUE  The candidate can be dispatched. \c found->task contains
+                  an uncounted reference to the task.
+    \retval FALSE The candidate was stale, or didn't match the filter.
+*/
+static Bool runq_claim_locked(/*@notnull@*/ task_t **candidate, Bool stolen,
+                              /*@notnull@*/ task_find_t *found)
+{
+  Bool usable ;
+
+  HQASSERT(multi_mutex_is_locked(&task_mutex), "Run queue claim needs lock") ;
+
+  usable = runq_usable(*candidate, found) ;
+  task_release_locked(candidate) ;
+
+  if ( !usable ) {
+    RUNQ_METRIC_INCREMENT(stale) ;
+  } else if ( stolen ) {
+    RUNQ_METRIC_INCREMENT(stolen) ;
+  } else {
+    RUNQ_METRIC_INCREMENT(taken) ;
+  }
+
+  return usable ;
+}
+
+/** \brief Find a dispatchable task in the run queues, when the caller
+    already holds the \c task_mutex.
+
+    \param self   The task context of the calling thread.
+    \param found  A structure used to filter the task being considered. If
+                  a specialiser is given, only the newest task on this
+                  thread's own queue is considered.
+
+    \retval TRUE  A task was found. \c found->task contains an uncounted
+                  reference to the task, and \c found->level contains its
+                  runnability level.
+    \retval FALSE No matching task was found on any queue. Stale entries
+                  seen whilst searching have been discarded.
+*/
+static Bool runq_find_locked(/*@notnull@*/ task_context_t *self,
+                             /*@notnull@*/ task_find_t *found)
+{
+  task_t *task ;
+  Bool stolen ;
+
+  HQASSERT(multi_mutex_is_locked(&task_mutex), "Run queue search needs lock") ;
+  VERIFY_OBJECT(self, TASK_CONTEXT_NAME) ;
+
+  if ( self->runq == NULL )
+    return FALSE ;
+
+  /* Pushes only happen with the task_mutex held, so this terminates. */
+  while ( (task = runq_take(self->runq, found->specialiser == NULL,
+                            found->specialiser, found->specialiser_args,
+                            &stolen)) != NULL ) {
+    if ( runq_claim_locked(&task, stolen, found) )
+      return TRUE ;
+  }
+
+  return FALSE ;
+}
+
+/** \brief Release all of the task references in a run queue. */
+static void runq_flush_locked(/*@notnull@*/ task_runq_t *runq)
+{
+  HQASSERT(multi_mutex_is_locked(&task_mutex), "Run queue flush needs lock") ;
+
+  for (;;) {
+    task_t *task = NULL ;
+
+    spinlock_counter(&runq->lock, 1) ;
+    if ( runq->head != runq->tail )
+      task = runq->tasks[runq->head++ & (TASK_RUNQ_SIZE - 1)] ;
+    spinunlock_counter(&runq->lock) ;
+
+    if ( task == NULL )
+      break ;
+    task_release_locked(&task) ;
+  }
+}
+
+/** \brief Discard the contents of every run queue. */
+static void runq_flush_all_locked(void)
+{
+  unsigned int i ;
+
+  for ( i = 0 ; i < TASK_RUNQ_COUNT ; ++i )
+    runq_flush_locked(&task_runqs[i]) ;
+}
+
 /****************************************************************************/
 /** \brief Helper function to determine if tasks in a group might be
     runnable.
@@ -1956,6 +2345,7 @@ static void task_runnability(task_t *task)
   }
 
   if ( level != task->runnability ) {
+    task_runnability_t old_level = task->runnability ;
     unsigned int old_runnable_helpable = tasks_runnable_helpable ;
     unsigned int old_runnable_nothelpable = tasks_runnable_nothelpable ;
     unsigned int old_ready_unprovisioned = tasks_ready_unprovisioned ;
@@ -2004,6 +2394,13 @@ static void task_runnability(task_t *task)
       ++task_nothelpable_generation ;
     }
 
+    /* Tasks that have just become dispatchable go on this thread's run queue,
+       so dispatchers can find them without walking the schedule. Changes
+       between dispatchable levels don't need another entry. */
+    if ( task_work_stealing && level < RL_DISPATCHABLE &&
+         old_level > RL_DISPATCHABLE )
+      runq_push(task) ;
+
 #ifdef PROBE_BUILD
     if ( tasks_runnable_helpable + tasks_runnable_nothelpable !=
          old_runnable_helpable + old_runnable_nothelpable )
@@ -2837,16 +3234,15 @@ task_group_t *task_group_current(task_grouptype_t group_type)
 
   task = task_current_uncounted() ;
 
-  /* Note that there is no test condition. We do indeed require that we find
-     a task group of the specified type. */
-  for ( group = task->group ; ; group = group->parent ) {
+  for ( group = task->group ; group != NULL ; group = group->parent ) {
     VERIFY_OBJECT(group, TASK_GROUP_NAME) ;
-    if ( group->type == group_type )
+    if ( group->type == group_type ) {
+      HqAtomicIncrement(&group->refcount, before) ;
+      HQASSERT(before > 0, "Task group was previously released") ;
       break ;
+    }
   }
 
-  HqAtomicIncrement(&group->refcount, before) ;
-  HQASSERT(before > 0, "Task group was previously released") ;
   return group ;
 }
 
@@ -4657,6 +5053,17 @@ void task_specialise_done(corecontext_t *context,
        joining and couldn't find a dependent to run, we'll see if we can find
        another ready task with the same task specialisation as this one. */
     if ( reserved == NULL && (succ & SUCC_SPEC) != 0 ) {
+      task_t *candidate = NULL ;
+      Bool stolen = FALSE ;
+
+      /* The newest task on this thread's run queue is the one most likely
+         to share this thread's data. Take it before locking, so the run
+         queue access doesn't need the task_mutex. */
+      if ( task_work_stealing && taskcontext->runq != NULL )
+        candidate = runq_take_unlocked(taskcontext->runq, FALSE,
+                                       task->specialiser,
+                                       task->specialiser_args, &stolen) ;
+
       multi_mutex_lock(&task_mutex) ;
 
       /* If doing a recursive task, we don't incremented threads_scheduled
@@ -4676,7 +5083,9 @@ void task_specialise_done(corecontext_t *context,
         found.specialiser = task->specialiser ;
         found.specialiser_args = task->specialiser_args ;
 
-        if ( find_runnable_task(&found, NULL) ) {
+        if ( (candidate != NULL &&
+              runq_claim_locked(&candidate, stolen, &found)) ||
+             find_runnable_task(&found, NULL) ) {
           reserved = found.task ;
           task_activate_locked(reserved) ;
           /* Indicate that a task is scheduled before we loop, so the
@@ -4695,6 +5104,9 @@ void task_specialise_done(corecontext_t *context,
            graph walk. */
         wake_next_thread(NULL, NULL, 0) ;
       }
+
+      if ( candidate != NULL )
+        task_release_locked(&candidate) ;
       multi_mutex_unlock(&task_mutex) ;
     }
 
@@ -4757,6 +5169,8 @@ static void task_run(corecontext_t *context, task_t *task,
 static void task_dispatch(corecontext_t *thread_context, void *arg)
 {
   task_context_t *taskcontext = thread_context->taskcontext ;
+  task_t *candidate = NULL ; /* Counted reference taken from a run queue. */
+  Bool stolen = FALSE ;
 #ifdef PROBE_BUILD
   int dispatch_wakeups = 0 ;
 #endif
@@ -4778,7 +5192,16 @@ static void task_dispatch(corecontext_t *thread_context, void *arg)
         task_unprovisioned_generation ;
       task_find_t found = { NULL, RL_DISPATCHABLE, NULL, NULL } ;
 
-      if ( tasks_runnable_helpable + tasks_runnable_nothelpable > 0 ) {
+      if ( candidate != NULL &&
+           runq_claim_locked(&candidate, stolen, &found) ) {
+        HQASSERT(found.task != NULL, "Didn't claim a task to dispatch") ;
+        /* Took a task from the run queues before locking. */
+      } else if ( task_work_stealing &&
+                  tasks_runnable_helpable + tasks_runnable_nothelpable > 0 &&
+                  runq_find_locked(taskcontext, &found) ) {
+        HQASSERT(found.task != NULL, "Didn't take a task to dispatch") ;
+        /* Found a task without walking the schedule. */
+      } else if ( tasks_runnable_helpable + tasks_runnable_nothelpable > 0 ) {
         find_scheduled_task(&found) ;
         HQASSERT(found.task != NULL, "Didn't find a task to dispatch") ;
         /* If there's nothing dispatchable, see if there's anything
@@ -4810,6 +5233,13 @@ static void task_dispatch(corecontext_t *thread_context, void *arg)
 
         multi_mutex_unlock(&task_mutex) ;
         task_run(thread_context, found.task, SUCC_GROUP|SUCC_SPEC) ;
+
+        /* Take or steal the next task before locking, so searching the run
+           queues doesn't hold the task_mutex. */
+        if ( task_work_stealing && taskcontext->runq != NULL )
+          candidate = runq_take_unlocked(taskcontext->runq, TRUE, NULL, NULL,
+                                         &stolen) ;
+
         multi_mutex_lock(&task_mutex) ;
 
         WASNT_POINTLESS(dispatch_wakeups) ;
@@ -4817,6 +5247,13 @@ static void task_dispatch(corecontext_t *thread_context, void *arg)
       }
     }
 
+    /* A candidate we couldn't use mustn't keep its task alive whilst we
+       wait. */
+    if ( candidate != NULL ) {
+      task_release_locked(&candidate) ;
+      RUNQ_METRIC_INCREMENT(stale) ;
+    }
+
     TRACE_POINTLESS(SW_TRACE_POINTLESS_WAKEUPS, pointless_wakeups,
                     dispatch_wakeups) ;
 
@@ -4831,6 +5268,9 @@ static void task_dispatch(corecontext_t *thread_context, void *arg)
 
     MAYBE_POINTLESS(dispatch_wakeups) ;
   }
+
+  if ( candidate != NULL )
+    task_release_locked(&candidate) ;
   multi_mutex_unlock(&task_mutex) ;
 }
 
@@ -5006,6 +5446,7 @@ void task_call_with_context(
 #endif
     DLL_RESET_LINK(&task_context, thread_list) ;
     task_context.state = THREAD_RUNNING ;
+    task_context.runq = NULL ; /* Doesn't dispatch tasks. */
     NAME_OBJECT(&task_context, TASK_CONTEXT_NAME);
 
     core_context.taskcontext = &task_context;
@@ -5074,6 +5515,7 @@ static void *pool_thread_init(void *arg)
 
   thread_context.thread_index = (unsigned int)++thread_total_started ;
   HQASSERT(thread_total_started < NTHREADS_LIMIT, "Too many threads") ;
+  task_context.runq = runq_for_thread(thread_context.thread_index) ;
 
 #if defined(DEBUG_BUILD)
   set_thread_name("Thread pool initialise") ;
@@ -5089,6 +5531,8 @@ static void *pool_thread_init(void *arg)
         context_specialise_next(&thread_context, specialise)) ;
 
   multi_mutex_lock(&task_mutex) ;
+  if ( task_context.runq != NULL )
+    runq_flush_locked(task_context.runq) ;
   DLL_REMOVE(&task_context, thread_list) ;
   multi_mutex_unlock(&task_mutex) ;
 
@@ -6003,6 +6447,7 @@ static NAMETYPEMATCH tasks_match[] = {
   { NAME_TaskHelperWaitThreshold | OOPTIONAL, 1, { OINTEGER }},
   { NAME_TaskHelperStartThreshold | OOPTIONAL, 1, { OINTEGER }},
   { NAME_TaskHelperEndThreshold | OOPTIONAL, 1, { OINTEGER }},
+  { NAME_TaskWorkStealing | OOPTIONAL, 1, { OBOOLEAN }},
   DUMMY_END_MATCH
 } ;
 
@@ -6028,6 +6473,9 @@ static Bool tasks_get_systemparam(corecontext_t *context, uint16 nameid, OBJECT
     theLen(*result) = 2;
     oArray(*result) = &mt[0];
   } break;
+  case NAME_TaskWorkStealing:
+    object_store_bool(result, task_work_stealing) ;
+    break ;
   }
 
   return TRUE ;
@@ -6186,6 +6634,18 @@ Bool tasks_set_systemparam(corecontext_t *context, uint16 name, OBJECT *theo)
       wake_all_threads(THREAD_WAIT_HELP, THREAD_RUNNING) ;
     multi_mutex_unlock(&task_mutex) ;
     break ;
+  case NAME_TaskWorkStealing:
+    /* Switch between run queue dispatch and schedule walk dispatch. All
+       dispatchable tasks are on the schedule, so nothing is lost by
+       switching in either direction, but stale run queue references would
+       keep finished tasks alive, so they are discarded when turning work
+       stealing off. */
+    multi_mutex_lock(&task_mutex) ;
+    task_work_stealing = oBool(*theo) ;
+    if ( !task_work_stealing )
+      runq_flush_all_locked() ;
+    multi_mutex_unlock(&task_mutex) ;
+    break ;
   }
 
   return TRUE ;
@@ -6424,6 +6884,8 @@ static Bool tasks_swinit(SWSTART *params)
                      SW_TRACE_INVALID) ;
   DLL_RESET_LINK(&interpreter_task_context, thread_list) ;
   interpreter_task_context.state = THREAD_RUNNING ;
+  runq_init_all() ;
+  interpreter_task_context.runq = runq_for_thread(context->thread_index) ;
   NAME_OBJECT(&interpreter_task_context, TASK_CONTEXT_NAME) ;
 
   DLL_ADD_TAIL(&thread_list, &interpreter_task_context, thread_list) ;
@@ -6622,6 +7084,10 @@ static void tasks_finish(void)
 
   multi_mutex_lock(&task_mutex) ;
 
+  /* The pool threads flushed their own run queues when they exited. The
+     interpreter's run queue may still hold references to finished tasks. */
+  runq_flush_all_locked() ;
+
   HQASSERT(DLL_LIST_IS_EMPTY(&orphaned_task_group.tasks),
            "Orphaned group has tasks") ;
   HQASSERT(DLL_LIST_IS_EMPTY(&orphaned_task_group.children),
@@ -6728,6 +7194,7 @@ static void init_C_globals_task(void)
 
   join_wait_ms = JOIN_WAIT_mS ;
   helper_wait_ms = HELPER_WAIT_mS ;
+  task_work_stealing = TASK_WORK_STEALING ;
 
   /* Thresholds need to wait until swstart, in case they're based on thread
      limits. */
@@ -6787,6 +7254,7 @@ static void init_C_globals_task(void)
 #if defined(METRICS_BUILD)
   tasks_total_allocated = groups_total_allocated =
     links_total_allocated = requirements_total_allocated = 0 ;
+  runq_pushed = runq_taken = runq_stolen = runq_stale = runq_overflowed = 0 ;
   links_current_allocated = requirements_current_allocated = 0 ;
   tasks_metrics_reset(SW_METRICS_RESET_BOOT) ;
   sw_metrics_register(&tasks_metrics_hook) ;
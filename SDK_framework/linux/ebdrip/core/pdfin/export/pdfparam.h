@@ -103,6 +103,7 @@ typedef struct pdfparams {
 
   USERVALUE TextStrokeAdjust ;
   int32 XRefCacheLifetime ;
+  Bool XRefIndex ;
 
   /* PDFParams only: */
   Bool   PoorShowPage ;
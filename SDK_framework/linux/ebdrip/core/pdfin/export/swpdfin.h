@@ -33,6 +33,12 @@ Bool pdf_x_filter_preflight(struct FILELIST *flptr,
                             struct OBJECT *args, struct STACK *stack) ;
 
 Bool pdf_exec_stream(struct OBJECT *stream, int stream_type) ;
+
+/** Find the object number of a PDF content stream which has its own
+    Resources, so that it is identified wherever it is used in its PDF
+    execution context. Returns FALSE if the stream is not identifiable, or
+    inherits its Resources. */
+Bool pdf_stream_objnum(struct OBJECT *stream, int32 *objnum) ;
 Bool pdf_walk_gstack(Bool (*gs_fn)(struct GSTATE *, void *), void *args) ;
 
 Bool pdf_getStrictpdf(PDFXCONTEXT *pdfxc) ;
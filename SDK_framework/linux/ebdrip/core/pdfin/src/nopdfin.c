@@ -60,6 +60,13 @@ Bool pdf_exec_stream(struct OBJECT *stream, int stream_type)
   return error_handler(INVALIDACCESS) ;
 }
 
+Bool pdf_stream_objnum(struct OBJECT *stream, int32 *objnum)
+{
+  UNUSED_PARAM(OBJECT *, stream) ;
+  UNUSED_PARAM(int32 *, objnum) ;
+  return FALSE ;
+}
+
 typedef Bool (*gs_walk_fn)(GSTATE *, void *) ;
 
 Bool pdf_walk_gstack(gs_walk_fn gs_fn, void *args)
@@ -69,6 +69,7 @@
 #include "pdftxt.h"             /* pdf_inittextstate */
 #include "pdftextstr.h"         /* pdf_text_to_utf8 */
 #include "pdfx.h"               /* pdfxCheckForPageGroupCSOverride */
+#include "pdfxidx.h"            /* pdf_xrefindex_load */
 #include "streamd.h"            /* streamLookupDict */
 
 #include "pdfexec.h"
@@ -588,6 +589,31 @@ Bool pdf_exec_stream(struct OBJECT *stream, int stream_type)
   return result ;
 }
 
+/* ---------------------------------------------------------------------- */
+Bool pdf_stream_objnum(struct OBJECT *stream, int32 *objnum)
+{
+  OBJECT *dict, *slot ;
+
+  HQASSERT( stream , "stream NULL in pdf_stream_objnum" ) ;
+  HQASSERT( objnum , "objnum NULL in pdf_stream_objnum" ) ;
+
+  if ( oType(*stream) != OFILE ||
+       theIPDFContextID( oFile( *stream )) == 0 )
+    return FALSE ;
+
+  /* The xref cache slot is the stream's object number. Streams without their
+     own Resources use those of whatever invokes them. */
+  dict = streamLookupDict( stream ) ;
+  if ( dict == NULL || oType( *dict ) != ODICTIONARY ||
+       fast_extract_hash_name( dict , NAME_Resources ) == NULL ||
+       (slot = fast_extract_hash_name( dict , NAME_HqnCacheSlot )) == NULL ||
+       oType( *slot ) != OINTEGER )
+    return FALSE ;
+
+  *objnum = oInteger( *slot ) ;
+  return TRUE ;
+}
+
 /* ---------------------------------------------------------------------- */
 
 static Bool pdf_open( PDFCONTEXT *pdfc , FILELIST **flptrin )
@@ -3328,6 +3354,116 @@ Bool pdf_validate_info_dict(
 }
 
 
+/**
+ * Rebuild the xref sections from a saved index, and read the newest trailer
+ * dictionary it refers to. If this fails, everything the index set up is
+ * discarded, and the xref must be read from the file as normal.
+ */
+static Bool pdf_read_indexed_trailer( PDFCONTEXT *pdfc )
+{
+  PDF_XREFINDEX xidx ;
+  FILELIST *flptr ;
+  DEVICELIST *dev ;
+  OBJECT encrypt = OBJECT_NOTVM_NULL ;
+  OBJECT id = OBJECT_NOTVM_NULL ;
+  OBJECT ref = OBJECT_NOTVM_NOTHING ;
+  Bool result ;
+  PDFXCONTEXT *pdfxc ;
+  PDF_IXC_PARAMS *ixc ;
+
+  PDF_CHECK_MC( pdfc ) ;
+  PDF_GET_XC( pdfxc ) ;
+  PDF_GET_IXC( ixc ) ;
+
+  flptr = pdfxc->flptr ;
+  HQASSERT( flptr , "flptr field NULL in pdf_read_indexed_trailer" ) ;
+  dev = theIDeviceList( flptr ) ;
+  HQASSERT( dev , "dev field NULL in pdf_read_indexed_trailer" ) ;
+
+  if ( ! pdf_xrefindex_load( pdfc , & xidx )) {
+    error_clear_context( pdfc->corecontext->error ) ;
+    return FALSE ;
+  }
+
+  result = (*theIMyResetFile( flptr ))( flptr ) != EOF &&
+           (*theISeekFile( dev ))( dev , theIDescriptor( flptr ) ,
+                                   & xidx.trailerpos , SW_SET ) ;
+  if ( result ) {
+    switch ( xidx.kind ) {
+    case PDF_XREFINDEX_TABLE:
+      result = pdf_readobject( pdfc , flptr , & ixc->pdftrailer ) &&
+               oType( ixc->pdftrailer ) == ODICTIONARY &&
+               pdf_extract_trailer_dict( pdfc , & ixc->pdftrailer ) ;
+      break ;
+    case PDF_XREFINDEX_STREAM: {
+      /* The trailer is the xref stream dictionary, which sets the trailer
+         details as the stream object is read. */
+      OBJECT pdfobj = OBJECT_NOTVM_NOTHING ;
+      PDF_STREAM_INFO info ;
+      int8 streamDict ;
+
+      result = pdf_xrefobject( pdfc , flptr , & pdfobj , & info , FALSE ,
+                               & streamDict ) &&
+               streamDict == XREF_FullStream &&
+               pdfxXrefStreamDetected( pdfc ) ;
+      break ;
+    }
+    case PDF_XREFINDEX_REPAIRED:
+      result = pdf_read_trailerdict( pdfc , flptr , & encrypt , & id ) ;
+      ixc->repaired = TRUE ;
+      break ;
+    default:
+      result = FALSE ;
+      break ;
+    }
+  }
+
+  /* Indexes are not made for encrypted files, and the index must have been
+     made with the same trailer ID. */
+  result = result &&
+           oType( encrypt ) == ONULL &&
+           oType( ixc->trailer_encrypt ) == ONULL &&
+           pdf_xrefindex_same_id( & xidx ,
+                                  xidx.kind == PDF_XREFINDEX_REPAIRED ?
+                                  & id : & ixc->trailer_id ) ;
+
+  if ( oType( id ) == OARRAY || oType( id ) == OPACKEDARRAY )
+    pdf_freeobject( pdfc , & id ) ;
+
+  if ( ! result ) {
+    /* The index did not describe this file after all. */
+    if ( xidx.kind != PDF_XREFINDEX_STREAM &&
+         oType( ixc->pdftrailer ) == ODICTIONARY )
+      pdf_freeobject( pdfc , & ixc->pdftrailer ) ;
+    if ( oType( encrypt ) == ODICTIONARY )
+      pdf_freeobject( pdfc , & encrypt ) ;
+    pdf_flushxrefsec( pdfc ) ;
+    error_clear_context( pdfc->corecontext->error ) ;
+    ixc->pdfroot = ixc->pdfinfo = ixc->pdftrailer = onull ;
+    ixc->trailer_encrypt = ixc->trailer_id = onull ;
+    ixc->gotinfo = FALSE ;
+    ixc->repaired = FALSE ;
+    return FALSE ;
+  }
+
+  /* The Root and Info dictionaries may have come from older trailers. */
+  theTags( ref ) = OINDIRECT | LITERAL ;
+  oXRefID( ref ) = xidx.rootnum ;
+  theGen( ref ) = xidx.rootgen ;
+  Copy( & ixc->pdfroot , & ref ) ;
+  if ( xidx.infonum >= 0 ) {
+    oXRefID( ref ) = xidx.infonum ;
+    theGen( ref ) = xidx.infogen ;
+    Copy( & ixc->pdfinfo , & ref ) ;
+    ixc->gotinfo = TRUE ;
+  }
+
+  Hq32x2FromInt32( & ixc->trailer_prev , -1 ) ;
+  Hq32x2FromInt32( & ixc->trailer_xrefstm , -1 ) ;
+
+  return TRUE ;
+}
+
 static Bool pdf_read_trailer( PDFCONTEXT *pdfc , Bool *repairable )
 {
   Bool result ;
@@ -3335,6 +3471,8 @@ static Bool pdf_read_trailer( PDFCONTEXT *pdfc , Bool *repairable )
   PDFXCONTEXT *pdfxc ;
   PDF_IXC_PARAMS *ixc ;
   Bool stream = FALSE;
+  int32 indexkind ;
+  Hq32x2 trailerpos ;
 
   PDF_CHECK_MC( pdfc ) ;
   PDF_GET_XC( pdfxc ) ;
@@ -3347,11 +3485,24 @@ static Bool pdf_read_trailer( PDFCONTEXT *pdfc , Bool *repairable )
    * pdf_begin_decryption that has failed. */
   *repairable = TRUE ;
 
+  /* A saved index of the xref saves reading all of its sections. */
+  if ( ixc->XRefIndex && pdf_read_indexed_trailer( pdfc ))
+    return pdf_validate_info_dict( pdfc ) ;
+
   /* Read main xref section. */
   Hq32x2FromInt32( &ixc->trailer_prev, -1) ; /* set to unused*/
   if ( ! pdf_read_xref( pdfc , ixc->pdfxref, &stream ))
     return FALSE ;
 
+  /* Note where the newest trailer is, in case the xref is indexed. */
+  indexkind = PDF_XREFINDEX_STREAM ;
+  trailerpos = ixc->pdfxref ;
+  if ( ! stream ) {
+    indexkind = PDF_XREFINDEX_TABLE ;
+    if ( (*theIMyFilePos( flptr ))( flptr , & trailerpos ) == EOF )
+      indexkind = PDF_XREFINDEX_NONE ;
+  }
+
   while ( stream && (Hq32x2CompareInt32( &ixc->trailer_prev, 0) >= 0) ) {
     Hq32x2 prev = ixc->trailer_prev;
     Hq32x2FromInt32( & ixc->trailer_prev, -1 );
@@ -3359,6 +3510,11 @@ static Bool pdf_read_trailer( PDFCONTEXT *pdfc , Bool *repairable )
       return FALSE ;
   };
 
+  /* An xref stream chain ending in a table takes the trailer from the older
+     table, which an index cannot describe. */
+  if ( indexkind == PDF_XREFINDEX_STREAM && ! stream )
+    indexkind = PDF_XREFINDEX_NONE ;
+
   /* If we have read in a stream (PDF 1.5 rather than a table then we
      are basically done. */
   if (stream) {
@@ -3425,6 +3581,9 @@ static Bool pdf_read_trailer( PDFCONTEXT *pdfc , Bool *repairable )
   /* Now any decryption is set up validate the info dict */
   result = (result && pdf_validate_info_dict(pdfc));
 
+  if ( result )
+    pdf_xrefindex_save( pdfc , indexkind , trailerpos , & ixc->trailer_id ) ;
+
   return result ;
 }
 
@@ -4176,6 +4335,7 @@ enum {
   params_match_PDFXVerifyExternalProfileCheckSums,
   params_match_TextStrokeAdjust,
   params_match_XRefCacheLifetime,
+  params_match_XRefIndex,
 
   params_match_n_entries
 } ;
@@ -4219,6 +4379,7 @@ static NAMETYPEMATCH params_dictmatch[params_match_n_entries + 1] = {
   { NAME_PDFXVerifyExternalProfileCheckSums | OOPTIONAL, 1, { OBOOLEAN }},
   { NAME_TextStrokeAdjust | OOPTIONAL,            2, { OREAL, OINTEGER }},
   { NAME_XRefCacheLifetime | OOPTIONAL,           1, { OINTEGER }},
+  { NAME_XRefIndex | OOPTIONAL,                   1, { OBOOLEAN }},
 
   DUMMY_END_MATCH
 } ;
@@ -4443,6 +4604,10 @@ static Bool pdf_unpack_params( PDFCONTEXT *pdfc , OBJECT *thedict )
     ixc->XRefCacheLifetime = oInteger( *theo ) ;
   }
 
+  /* XRefIndex */
+  if (( theo = params_dictmatch[ params_match_XRefIndex ].result) != NULL)
+    ixc->XRefIndex = oBool( *theo ) ;
+
   return TRUE ;
 }
 
@@ -429,6 +429,7 @@ static Bool pdf_in_begin_execution_context( PDFXCONTEXT *pdfxc )
   ixc->PDFXVerifyExternalProfileCheckSums = pdfparams->PDFXVerifyExternalProfileCheckSums;
   ixc->TextStrokeAdjust = pdfparams->TextStrokeAdjust;
   ixc->XRefCacheLifetime = pdfparams->XRefCacheLifetime;
+  ixc->XRefIndex = pdfparams->XRefIndex;
 
   ixc->conformance_pdf_version = 0 ;
   ixc->suppress_duplicate_warnings = FALSE ;
@@ -188,6 +188,7 @@ struct pdf_ixc_params {
       Bool PDFXVerifyExternalProfileCheckSums ;
       USERVALUE TextStrokeAdjust ;
       int32 XRefCacheLifetime ;
+      Bool XRefIndex ;
 
   /* END of PDF Params */
 
@@ -62,6 +62,7 @@ enum {
   pdf_match_PDFXVerifyExternalProfileCheckSums,
   pdf_match_TextStrokeAdjust,
   pdf_match_XRefCacheLifetime,
+  pdf_match_XRefIndex,
   pdf_match_PoorShowPage,
   pdf_match_PoorSoftMask,
   pdf_match_AdobeRenderingIntent,
@@ -102,6 +103,7 @@ static NAMETYPEMATCH pdf_match[pdf_match_LENGTH + 1] = {
   { NAME_PDFXVerifyExternalProfileCheckSums | OOPTIONAL, 1, { OBOOLEAN }},
   { NAME_TextStrokeAdjust | OOPTIONAL,              2, { OREAL, OINTEGER }},
   { NAME_XRefCacheLifetime | OOPTIONAL,             1, { OINTEGER }},
+  { NAME_XRefIndex | OOPTIONAL,                     1, { OBOOLEAN }},
   { NAME_PoorShowPage | OOPTIONAL,                  1, { OBOOLEAN }},
   { NAME_PoorSoftMask | OOPTIONAL,                  1, { OBOOLEAN }},
   { NAME_AdobeRenderingIntent | OOPTIONAL,          1, { OBOOLEAN }},
@@ -518,6 +520,11 @@ Bool setpdfparams_(ps_context_t *pscontext)
     pdfparams->XRefCacheLifetime = oInteger(*theo) ;
   }
 
+  /* XRefIndex */
+  if ((theo = thematch[pdf_match_XRefIndex].result) != NULL) {
+    pdfparams->XRefIndex = oBool(*theo) ;
+  }
+
   /* PoorShowPage */
   if ((theo = thematch[ pdf_match_PoorShowPage ].result) != NULL) {
     pdfparams->PoorShowPage = oBool( *theo ) ;
@@ -895,6 +902,12 @@ Bool currentpdfparams_(ps_context_t *pscontext)
   if (! insert_hash( &thed, &nnewobj, &inewobj))
     return FALSE ;
 
+  /* XRefIndex */
+  oName( nnewobj ) = &system_names[ NAME_XRefIndex ] ;
+  if (! insert_hash( &thed, &nnewobj,
+                     pdfparams->XRefIndex ? &tnewobj : &fnewobj))
+    return FALSE;
+
   /* PoorShowPage */
   oName( nnewobj ) = &system_names[ NAME_PoorShowPage ] ;
   if (! insert_hash( &thed, &nnewobj,
@@ -997,6 +1010,7 @@ void initpdfparams(PDFPARAMS *params)
   params->PDFXVerifyExternalProfileCheckSums = FALSE;
   params->TextStrokeAdjust = 0.0 ;
   params->XRefCacheLifetime = 10 ;
+  params->XRefIndex = FALSE ;
 
   params->PoorShowPage = FALSE ;
   params->PoorSoftMask = DEFAULT_POOR_SOFT_MASK ;
@@ -30,6 +30,7 @@
 #include "pdfexec.h"
 #include "pdfxref.h"
 #include "pdfmem.h"
+#include "pdfxidx.h"
 
 static Bool pdf_repair_scan_object_id( uint8 *linebuf , uint8 *lineend ,
                                         int32 *objnum , uint16 *objgen ) ;
@@ -81,6 +82,7 @@ Bool pdf_repair( PDFCONTEXT *pdfc , FILELIST *flptr )
   OBJECT encrypt = OBJECT_NOTVM_NULL ;
   OBJECT id = OBJECT_NOTVM_NULL ;
   Hq32x2 offset;
+  Hq32x2 trailerpos ;
 
   PDF_CHECK_MC( pdfc ) ;
   PDF_GET_XC( pdfxc ) ;
@@ -128,6 +130,7 @@ Bool pdf_repair( PDFCONTEXT *pdfc , FILELIST *flptr )
 
   fstobj = 0 ;
   number = 0 ;
+  Hq32x2FromInt32( &trailerpos, -1 ) ;
 
   result = TRUE ;
 
@@ -239,6 +242,8 @@ Bool pdf_repair( PDFCONTEXT *pdfc , FILELIST *flptr )
       case REPAIR_TRAILER_STATE :
         /* Read the trailer dictionary for the root object, and the
          * info and encryption dictionaries. */
+        if ( (*theIMyFilePos( flptr ))( flptr , & trailerpos ) == EOF )
+          Hq32x2FromInt32( &trailerpos, -1 ) ;
         result = pdf_read_trailerdict( pdfc , flptr , & encrypt , & id ) ;
         state = REPAIR_INIT_STATE ;
         break ;
@@ -291,6 +296,9 @@ Bool pdf_repair( PDFCONTEXT *pdfc , FILELIST *flptr )
 
   result = (result && pdf_validate_info_dict(pdfc));
 
+  if ( result )
+    pdf_xrefindex_save( pdfc , PDF_XREFINDEX_REPAIRED , trailerpos , & id ) ;
+
   /* Free encryption dictionary and id array if necessary. */
   if ( oType( encrypt ) == ODICTIONARY )
     pdf_freeobject( pdfc , & encrypt ) ;
@@ -0,0 +1,868 @@
+/** \file
+ * \ingroup pdfin
+ *
+ * $HopeName: SWpdf!src:pdfxidx.c(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * Persistent PDF xref index.
+ *
+ * Reading all of the xref sections of a large PDF file, or repairing a file
+ * whose xref is unusable, is a noticeable part of the time taken to start a
+ * job. When the XRefIndex PDF parameter is set, the xref sections are saved
+ * to an index file on the %os% device once a file's trailer has been read.
+ * The next time the same file is opened, the sections are rebuilt from the
+ * index in one read, and only the newest trailer dictionary is read from
+ * the PDF file itself. The Root and Info references are kept in the index,
+ * as they may have come from older trailers.
+ *
+ * A file is identified by its length, modification time, the offset of its
+ * header, its startxref offset and a digest of its last XIDX_TAIL_BYTES
+ * bytes. The index is named from a hash of this key, and the whole key is
+ * checked before the index is used. A digest of the trailer ID is checked
+ * once the newest trailer has been read, and the offsets of a sample of the
+ * used objects are checked to start with their object headers. Files
+ * without a name on their device, with an indirect trailer ID, or which are
+ * encrypted are not indexed.
+ *
+ * Index files are evicted least recently used first, when there are more
+ * than XIDX_MAX_FILES of them or they hold more than XIDX_MAX_BYTES. The
+ * index files in use and when they were last used are listed in the
+ * directory file XIDX_DIR_NAME.
+ *
+ * An index is made of 4 byte words, least significant byte first. There is
+ * a header of XIDX_HEADER_WORDS words, followed by all of the sections, then
+ * all of the tables, then all of the objects:
+ *
+ *   section: offset high, offset low, number of tables
+ *   table:   first object number, number of objects
+ *   object:  use | (generation << 16), value high, value low
+ *
+ * The object value is the file offset of a used object, the next free object
+ * number of a free object, or the object stream number of a compressed
+ * object. The value high word of a compressed object is its index in the
+ * object stream. The order of sections, tables and objects is the same as in
+ * memory, so lookups resolve exactly as they did when the index was made.
+ */
+
+#include "core.h"
+#include "swdevice.h"
+#include "objects.h"
+#include "fileio.h"
+
+#include "devices.h"    /* find_device */
+#include "swcopyf.h"    /* swcopyf */
+#include "hqmemcpy.h"   /* HqMemCpy, HqMemMove */
+
+#include "swpdf.h"
+#include "pdfin.h"
+#include "pdfxref.h"
+#include "pdfxidx.h"
+
+/** Identifies an xref index file. */
+#define XIDX_MAGIC        0x49585250u
+
+/** Version of the index layout. Indexes with other versions are ignored. */
+#define XIDX_VERSION      2
+
+/** Number of bytes at the end of the PDF file included in the key. */
+#define XIDX_TAIL_BYTES   1024
+
+/** Limits on the size of an index, beyond which it is not used. */
+#define XIDX_MAX_SECTIONS 4096
+#define XIDX_MAX_TABLES   (1 << 20)
+#define XIDX_MAX_OBJECTS  (1 << 24)
+
+/** Limits on the index files kept, beyond which the least recently used are
+    deleted. */
+#define XIDX_MAX_FILES    64
+#define XIDX_MAX_BYTES    (64 * 1024 * 1024)
+
+/** Number of used object offsets checked when an index is loaded. */
+#define XIDX_SAMPLES      8
+
+/** Bytes read at a sampled object offset, enough for its object header. */
+#define XIDX_SAMPLE_BYTES 32
+
+/** Directory of the index files, listing the name hash, last use and size
+    of each, after a header of magic, version, next use stamp and count. */
+#define XIDX_DIR_NAME     "pdfxref.xrd"
+#define XIDX_DIR_MAGIC    0x44585250u
+#define XIDX_DIR_HEADER_WORDS 4
+#define XIDX_DIR_ENTRY_WORDS  3
+
+/** Basis of the FNV-1a hash. */
+#define XIDX_FNV_BASIS    2166136261u
+
+#define XIDX_SECTION_WORDS 3
+#define XIDX_TABLE_WORDS   2
+#define XIDX_OBJECT_WORDS  3
+
+/** Words in the index header. The words from XIDX_SIZE_HI to XIDX_MODIFIED
+    inclusive are the key of the PDF file. */
+enum {
+  XIDX_MAGIC_WORD,
+  XIDX_VERSION_WORD,
+  XIDX_SIZE_HI,       /**< File length. */
+  XIDX_SIZE_LO,
+  XIDX_START_HI,      /**< Offset of the PDF header in the file. */
+  XIDX_START_LO,
+  XIDX_XREF_HI,       /**< startxref offset. */
+  XIDX_XREF_LO,
+  XIDX_TAIL_LEN,      /**< Bytes of the end of the file digested. */
+  XIDX_TAIL_ADLER,    /**< Adler-32 of the end of the file. */
+  XIDX_TAIL_FNV,      /**< FNV-1a hash of the end of the file. */
+  XIDX_MODIFIED,      /**< Modification time of the file. */
+  XIDX_ID_LEN,        /**< Bytes of the trailer ID digested, or zero. */
+  XIDX_ID_FNV,        /**< FNV-1a hash of the trailer ID. */
+  XIDX_KIND,          /**< PDF_XREFINDEX_ value. */
+  XIDX_TRAILER_HI,    /**< Offset of the trailer. */
+  XIDX_TRAILER_LO,
+  XIDX_ROOT_NUM,      /**< Root object number. */
+  XIDX_ROOT_GEN,
+  XIDX_INFO_NUM,      /**< Info object number plus one, or zero. */
+  XIDX_INFO_GEN,
+  XIDX_NSECTIONS,
+  XIDX_NTABLES,
+  XIDX_NOBJECTS,
+  XIDX_CHECKSUM,      /**< Adler-32 of everything else in the index. */
+  XIDX_HEADER_WORDS
+} ;
+
+#define XIDX_HEADER_BYTES (XIDX_HEADER_WORDS * 4)
+
+static void xidx_put( uint8 *p , uint32 value )
+{
+  p[ 0 ] = ( uint8 )value ;
+  p[ 1 ] = ( uint8 )( value >> 8 ) ;
+  p[ 2 ] = ( uint8 )( value >> 16 ) ;
+  p[ 3 ] = ( uint8 )( value >> 24 ) ;
+}
+
+static uint32 xidx_get( const uint8 *p )
+{
+  return ( uint32 )p[ 0 ] | (( uint32 )p[ 1 ] << 8 ) |
+         (( uint32 )p[ 2 ] << 16 ) | (( uint32 )p[ 3 ] << 24 ) ;
+}
+
+static uint32 xidx_adler( uint32 adler , const uint8 *p , int32 len )
+{
+  uint32 a = adler & 0xffff , b = adler >> 16 ;
+
+  while ( len > 0 ) {
+    /* 5552 is the most bytes that can be summed before b overflows. */
+    int32 n = len < 5552 ? len : 5552 ;
+
+    len -= n ;
+    while ( --n >= 0 ) {
+      a += *p++ ;
+      b += a ;
+    }
+    a %= 65521 ;
+    b %= 65521 ;
+  }
+
+  return ( b << 16 ) | a ;
+}
+
+static uint32 xidx_fnv( uint32 hash , const uint8 *p , int32 len )
+{
+  while ( --len >= 0 )
+    hash = ( hash ^ *p++ ) * 16777619u ;
+
+  return hash ;
+}
+
+/** Fill in the key words of an index header for the current PDF file.
+    Returns FALSE if the end of the file could not be read. */
+static Bool xidx_key( PDFCONTEXT *pdfc , uint32 header[ XIDX_HEADER_WORDS ] )
+{
+  PDFXCONTEXT *pdfxc ;
+  PDF_IXC_PARAMS *ixc ;
+  FILELIST *flptr ;
+  DEVICELIST *dev ;
+  uint8 tail[ XIDX_TAIL_BYTES ] ;
+  uint8 filename[ LONGESTFILENAME ] ;
+  STAT stat ;
+  Hq32x2 pos ;
+  int32 len = XIDX_TAIL_BYTES ;
+
+  PDF_CHECK_MC( pdfc ) ;
+  PDF_GET_XC( pdfxc ) ;
+  PDF_GET_IXC( ixc ) ;
+
+  flptr = pdfxc->flptr ;
+  HQASSERT( flptr , "flptr field NULL in xidx_key" ) ;
+  dev = theIDeviceList( flptr ) ;
+  HQASSERT( dev , "dev field NULL in xidx_key" ) ;
+
+  /* The modification time is needed to tell an edited file from the one
+     indexed, so files without a name can't be indexed. */
+  if ( ! isDeviceRelative( dev ) || theINLen( flptr ) == 0 ||
+       theINLen( flptr ) >= LONGESTFILENAME )
+    return FALSE ;
+  HqMemCpy( filename , theICList( flptr ) , theINLen( flptr )) ;
+  filename[ theINLen( flptr ) ] = '\0' ;
+  if ( (*theIStatusFile( dev ))( dev , filename , & stat ) != 0 )
+    return FALSE ;
+
+  Hq32x2Subtract( & pos , & pdfxc->fileend , & pdfxc->filepos ) ;
+  if ( Hq32x2CompareInt32( & pos , len ) < 0 )
+    len = Hq32x2AssertToInt32( & pos ) ;
+  Hq32x2SubtractInt32( & pos , & pdfxc->fileend , len ) ;
+
+  if ( len <= 0 ||
+       ! (*theISeekFile( dev ))( dev , theIDescriptor( flptr ) ,
+                                 & pos , SW_SET ) ||
+       (*theIReadFile( dev ))( dev , theIDescriptor( flptr ) ,
+                               tail , len ) != len )
+    return FALSE ;
+
+  header[ XIDX_SIZE_HI ] = ( uint32 )pdfxc->fileend.high ;
+  header[ XIDX_SIZE_LO ] = pdfxc->fileend.low ;
+  header[ XIDX_START_HI ] = ( uint32 )pdfxc->filepos.high ;
+  header[ XIDX_START_LO ] = pdfxc->filepos.low ;
+  header[ XIDX_XREF_HI ] = ( uint32 )ixc->pdfxref.high ;
+  header[ XIDX_XREF_LO ] = ixc->pdfxref.low ;
+  header[ XIDX_TAIL_LEN ] = ( uint32 )len ;
+  header[ XIDX_TAIL_ADLER ] = xidx_adler( 1 , tail , len ) ;
+  header[ XIDX_TAIL_FNV ] = xidx_fnv( XIDX_FNV_BASIS , tail , len ) ;
+  header[ XIDX_MODIFIED ] = theStatModified( stat ) ;
+
+  return TRUE ;
+}
+
+/** Digest a trailer ID array. Returns FALSE if the ID can't be digested. */
+static Bool xidx_id( OBJECT *id , uint32 *idlen , uint32 *idhash )
+{
+  uint32 len = 0 , hash = XIDX_FNV_BASIS ;
+
+  HQASSERT( id , "No trailer ID" ) ;
+
+  switch ( oType( *id )) {
+  case ONULL:
+  case ONOTHING:
+    break ;
+  case OARRAY:
+  case OPACKEDARRAY: {
+    OBJECT *olist = oArray( *id ) ;
+    int32 i ;
+
+    for ( i = 0 ; i < theLen( *id ) ; ++i ) {
+      uint8 size[ 4 ] ;
+
+      if ( oType( olist[ i ] ) != OSTRING )
+        return FALSE ;
+      xidx_put( size , theLen( olist[ i ] )) ;
+      hash = xidx_fnv( hash , size , 4 ) ;
+      hash = xidx_fnv( hash , oString( olist[ i ] ) , theLen( olist[ i ] )) ;
+      len += 4 + theLen( olist[ i ] ) ;
+    }
+    break ;
+  }
+  default:
+    /* An indirect ID would have to be resolved to be compared. */
+    return FALSE ;
+  }
+
+  *idlen = len ;
+  *idhash = hash ;
+  return TRUE ;
+}
+
+/** Hash the key words of a header, which names its index file. */
+static uint32 xidx_hash( const uint32 header[ XIDX_HEADER_WORDS ] )
+{
+  uint8 key[ ( XIDX_MODIFIED - XIDX_SIZE_HI + 1 ) * 4 ] ;
+  int32 i ;
+
+  for ( i = XIDX_SIZE_HI ; i <= XIDX_MODIFIED ; ++i )
+    xidx_put( key + ( i - XIDX_SIZE_HI ) * 4 , header[ i ] ) ;
+
+  return xidx_fnv( XIDX_FNV_BASIS , key , sizeof( key )) ;
+}
+
+/** Make the index file name from the hash of its key. */
+static void xidx_name( uint32 hash , uint8 name[ 32 ] )
+{
+  swcopyf( name , ( uint8 * )"pdfxref-%08x.xri" , hash ) ;
+}
+
+/**
+ * Note that an index file has just been used or written, in the directory
+ * of index files, deleting the least recently used index files to keep
+ * within the limits. The directory is only a cache of what is on the
+ * device, so it is started again if it can't be read.
+ *
+ * \param dev   The device the index files are on.
+ * \param hash  The hash naming the index file.
+ * \param size  The size of the index file, or zero if it has been deleted.
+ */
+static void xidx_directory_touch( DEVICELIST *dev , uint32 hash , int32 size )
+{
+  uint8 dir[ ( XIDX_DIR_HEADER_WORDS +
+               ( XIDX_MAX_FILES + 1 ) * XIDX_DIR_ENTRY_WORDS ) * 4 ] ;
+  uint8 name[ 32 ] , *entry ;
+  uint32 count = 0 , stamp = 0 , total = 0 , i ;
+  int32 len ;
+  DEVICE_FILEDESCRIPTOR fd ;
+
+  if ( (fd = (*theIOpenFile( dev ))( dev , ( uint8 * )XIDX_DIR_NAME ,
+                                     SW_RDONLY )) >= 0 ) {
+    len = (*theIReadFile( dev ))( dev , fd , dir , sizeof( dir )) ;
+    (void)(*theICloseFile( dev ))( dev , fd ) ;
+    if ( len >= XIDX_DIR_HEADER_WORDS * 4 &&
+         xidx_get( dir ) == XIDX_DIR_MAGIC &&
+         xidx_get( dir + 4 ) == XIDX_VERSION ) {
+      stamp = xidx_get( dir + 8 ) ;
+      count = xidx_get( dir + 12 ) ;
+      if ( count > XIDX_MAX_FILES ||
+           len != ( int32 )(( XIDX_DIR_HEADER_WORDS +
+                              count * XIDX_DIR_ENTRY_WORDS ) * 4 ))
+        count = 0 ;
+    }
+  }
+
+  /* Remove the entry for this index, and add it back as the most recently
+     used. */
+  entry = dir + XIDX_DIR_HEADER_WORDS * 4 ;
+  for ( i = 0 ; i < count ; ++i ) {
+    if ( xidx_get( entry + i * XIDX_DIR_ENTRY_WORDS * 4 ) == hash ) {
+      --count ;
+      HqMemMove( entry + i * XIDX_DIR_ENTRY_WORDS * 4 ,
+                 entry + ( i + 1 ) * XIDX_DIR_ENTRY_WORDS * 4 ,
+                 ( count - i ) * XIDX_DIR_ENTRY_WORDS * 4 ) ;
+      break ;
+    }
+  }
+  if ( size > 0 ) {
+    xidx_put( entry + count * XIDX_DIR_ENTRY_WORDS * 4 , hash ) ;
+    xidx_put( entry + count * XIDX_DIR_ENTRY_WORDS * 4 + 4 , stamp++ ) ;
+    xidx_put( entry + count * XIDX_DIR_ENTRY_WORDS * 4 + 8 , ( uint32 )size ) ;
+    ++count ;
+  }
+
+  for ( i = 0 ; i < count ; ++i )
+    total += xidx_get( entry + i * XIDX_DIR_ENTRY_WORDS * 4 + 8 ) ;
+
+  /* Evict the least recently used indexes, other than this one. */
+  while ( count > 1 && ( count > XIDX_MAX_FILES || total > XIDX_MAX_BYTES )) {
+    uint32 oldest = 0 ;
+
+    for ( i = 1 ; i < count ; ++i ) {
+      if ( xidx_get( entry + i * XIDX_DIR_ENTRY_WORDS * 4 + 4 ) <
+           xidx_get( entry + oldest * XIDX_DIR_ENTRY_WORDS * 4 + 4 ))
+        oldest = i ;
+    }
+    xidx_name( xidx_get( entry + oldest * XIDX_DIR_ENTRY_WORDS * 4 ) , name ) ;
+    (void)(*theIDeleteFile( dev ))( dev , name ) ;
+    total -= xidx_get( entry + oldest * XIDX_DIR_ENTRY_WORDS * 4 + 8 ) ;
+    --count ;
+    HqMemMove( entry + oldest * XIDX_DIR_ENTRY_WORDS * 4 ,
+               entry + ( oldest + 1 ) * XIDX_DIR_ENTRY_WORDS * 4 ,
+               ( count - oldest ) * XIDX_DIR_ENTRY_WORDS * 4 ) ;
+  }
+
+  xidx_put( dir , XIDX_DIR_MAGIC ) ;
+  xidx_put( dir + 4 , XIDX_VERSION ) ;
+  xidx_put( dir + 8 , stamp ) ;
+  xidx_put( dir + 12 , count ) ;
+  len = ( int32 )(( XIDX_DIR_HEADER_WORDS +
+                    count * XIDX_DIR_ENTRY_WORDS ) * 4 ) ;
+  if ( (fd = (*theIOpenFile( dev ))( dev , ( uint8 * )XIDX_DIR_NAME ,
+                                     SW_WRONLY | SW_CREAT | SW_TRUNC )) >= 0 ) {
+    Bool ok = (*theIWriteFile( dev ))( dev , fd , dir , len ) == len ;
+
+    if ( (*theICloseFile( dev ))( dev , fd ) < 0 || ! ok )
+      (void)(*theIDeleteFile( dev ))( dev , ( uint8 * )XIDX_DIR_NAME ) ;
+  }
+}
+
+/** Skip PDF white space in a sampled object header. */
+static const uint8 *xidx_skip_space( const uint8 *p , const uint8 *end )
+{
+  while ( p < end && ( *p == ' ' || *p == '\t' || *p == '\r' ||
+                       *p == '\n' || *p == '\f' || *p == '\0' ))
+    ++p ;
+  return p ;
+}
+
+/** Read a decimal number in a sampled object header. */
+static const uint8 *xidx_number( const uint8 *p , const uint8 *end ,
+                                 uint32 *value )
+{
+  const uint8 *start = p ;
+
+  *value = 0 ;
+  while ( p < end && *p >= '0' && *p <= '9' && p - start < 10 )
+    *value = *value * 10 + ( uint32 )( *p++ - '0' ) ;
+  return p > start ? p : NULL ;
+}
+
+/** Check a used object's offset in the PDF file starts with its header. */
+static Bool xidx_check_object( FILELIST *flptr , uint32 objnum , uint32 gen ,
+                               Hq32x2 offset )
+{
+  DEVICELIST *dev = theIDeviceList( flptr ) ;
+  uint8 buf[ XIDX_SAMPLE_BYTES ] ;
+  const uint8 *p = buf , *end ;
+  uint32 value ;
+  int32 len ;
+
+  if ( ! (*theISeekFile( dev ))( dev , theIDescriptor( flptr ) ,
+                                 & offset , SW_SET ) ||
+       (len = (*theIReadFile( dev ))( dev , theIDescriptor( flptr ) ,
+                                      buf , XIDX_SAMPLE_BYTES )) <= 0 )
+    return FALSE ;
+  end = buf + len ;
+
+  p = xidx_skip_space( p , end ) ;
+  if ( (p = xidx_number( p , end , & value )) == NULL || value != objnum )
+    return FALSE ;
+  p = xidx_skip_space( p , end ) ;
+  if ( (p = xidx_number( p , end , & value )) == NULL || value != gen )
+    return FALSE ;
+  p = xidx_skip_space( p , end ) ;
+
+  return end - p >= 3 && p[ 0 ] == 'o' && p[ 1 ] == 'b' && p[ 2 ] == 'j' ;
+}
+
+/** Check that a sample of the used objects of a validated index, spread
+    through it, have headers at their offsets in the PDF file. */
+static Bool xidx_check_offsets( PDFCONTEXT *pdfc , const uint8 *body ,
+                                uint32 nsections , uint32 ntables ,
+                                uint32 nobjects )
+{
+  PDFXCONTEXT *pdfxc ;
+  const uint8 *tab = body + nsections * XIDX_SECTION_WORDS * 4 ;
+  const uint8 *obj = tab + ntables * XIDX_TABLE_WORDS * 4 ;
+  uint32 step = nobjects / XIDX_SAMPLES + 1 , index = 0 , i , n ;
+  Bool sample = FALSE ;
+
+  PDF_CHECK_MC( pdfc ) ;
+  PDF_GET_XC( pdfxc ) ;
+
+  for ( i = 0 ; i < ntables ; ++i , tab += XIDX_TABLE_WORDS * 4 ) {
+    uint32 objnum = xidx_get( tab ) ;
+
+    for ( n = 0 ; n < xidx_get( tab + 4 ) ;
+          ++n , ++index , obj += XIDX_OBJECT_WORDS * 4 ) {
+      if ( index % step == 0 )
+        sample = TRUE ;
+      /* Generation 65535 marks an object that isn't really used. */
+      if ( sample && obj[ 0 ] == XREF_Used &&
+           ( xidx_get( obj ) >> 16 ) != 65535 ) {
+        Hq32x2 offset ;
+
+        offset.high = ( int32 )xidx_get( obj + 4 ) ;
+        offset.low = xidx_get( obj + 8 ) ;
+        if ( ! xidx_check_object( pdfxc->flptr , objnum + n ,
+                                  xidx_get( obj ) >> 16 , offset ))
+          return FALSE ;
+        sample = FALSE ;
+      }
+    }
+  }
+
+  return TRUE ;
+}
+
+/** Check the sections, tables and objects of an index are consistent,
+    before anything is built from them. */
+static Bool xidx_validate( const uint8 *body , uint32 nsections ,
+                           uint32 ntables , uint32 nobjects )
+{
+  const uint8 *sec = body ;
+  const uint8 *tab = sec + nsections * XIDX_SECTION_WORDS * 4 ;
+  const uint8 *obj = tab + ntables * XIDX_TABLE_WORDS * 4 ;
+  uint32 tables = 0 , objects = 0 , i ;
+
+  for ( i = 0 ; i < nsections ; ++i , sec += XIDX_SECTION_WORDS * 4 ) {
+    if ( xidx_get( sec ) > MAXINT32 )
+      return FALSE ;
+    tables += xidx_get( sec + 8 ) ;
+    if ( tables > ntables )
+      return FALSE ;
+  }
+  if ( tables != ntables )
+    return FALSE ;
+
+  for ( i = 0 ; i < ntables ; ++i , tab += XIDX_TABLE_WORDS * 4 ) {
+    uint32 objnum = xidx_get( tab ) , number = xidx_get( tab + 4 ) ;
+
+    if ( objnum > MAXINT32 || number == 0 || number > nobjects - objects ||
+         number > ( uint32 )MAXINT32 - objnum )
+      return FALSE ;
+    objects += number ;
+  }
+  if ( objects != nobjects )
+    return FALSE ;
+
+  for ( i = 0 ; i < nobjects ; ++i , obj += XIDX_OBJECT_WORDS * 4 ) {
+    switch ( obj[ 0 ] ) {
+    case XREF_Used:
+      if ( xidx_get( obj + 4 ) > MAXINT32 )
+        return FALSE ;
+      break ;
+    case XREF_Compressed:
+      /* The object stream index is kept in 16 bits in memory. */
+      if ( xidx_get( obj + 4 ) > 0xffff )
+        return FALSE ;
+      break ;
+    case XREF_Free:
+    case XREF_Uninitialised:
+      break ;
+    default:
+      return FALSE ;
+    }
+  }
+
+  return TRUE ;
+}
+
+/** Build the xref sections of the PDF context from a validated index. */
+static Bool xidx_rebuild( PDFCONTEXT *pdfc , const uint8 *body ,
+                          uint32 nsections , uint32 ntables )
+{
+  const uint8 *sec = body ;
+  const uint8 *tab = sec + nsections * XIDX_SECTION_WORDS * 4 ;
+  const uint8 *obj = tab + ntables * XIDX_TABLE_WORDS * 4 ;
+  uint32 i , j ;
+
+  for ( i = 0 ; i < nsections ; ++i , sec += XIDX_SECTION_WORDS * 4 ) {
+    XREFSEC *xrefsec ;
+    Hq32x2 offset ;
+
+    offset.high = ( int32 )xidx_get( sec ) ;
+    offset.low = xidx_get( sec + 4 ) ;
+    if ( (xrefsec = pdf_allocxrefsec( pdfc , offset )) == NULL )
+      return FALSE ;
+
+    for ( j = xidx_get( sec + 8 ) ; j > 0 ; --j , tab += XIDX_TABLE_WORDS * 4 ) {
+      int32 objnum = ( int32 )xidx_get( tab ) ;
+      int32 number = ( int32 )xidx_get( tab + 4 ) ;
+      XREFTAB *xreftab ;
+      XREFOBJ *xrefobj ;
+
+      if ( (xreftab = pdf_allocxreftab( pdfc , xrefsec , objnum ,
+                                        number )) == NULL ||
+           (xrefobj = pdf_allocxrefobj( pdfc , xreftab , number )) == NULL )
+        return FALSE ;
+
+      for ( ; number > 0 ;
+            --number , ++xrefobj , obj += XIDX_OBJECT_WORDS * 4 ) {
+        uint16 gen = ( uint16 )( xidx_get( obj ) >> 16 ) ;
+
+        switch ( obj[ 0 ] ) {
+        case XREF_Used: {
+          Hq32x2 objoff ;
+
+          objoff.high = ( int32 )xidx_get( obj + 4 ) ;
+          objoff.low = xidx_get( obj + 8 ) ;
+          pdf_storexrefobj( xrefobj , objoff , gen ) ;
+          break ;
+        }
+        case XREF_Free:
+          pdf_storefreexrefobj( xrefobj , ( int32 )xidx_get( obj + 8 ) , gen ) ;
+          break ;
+        case XREF_Compressed:
+          pdf_storecompressedxrefobj( xrefobj , ( int32 )xidx_get( obj + 8 ) ,
+                                      ( uint16 )xidx_get( obj + 4 )) ;
+          break ;
+        default:
+          HQASSERT( obj[ 0 ] == XREF_Uninitialised ,
+                    "Index object use should have been validated" ) ;
+          break ;
+        }
+      }
+    }
+  }
+
+  return TRUE ;
+}
+
+/**
+ * Rebuild the xref sections of the current PDF file from a saved index.
+ *
+ * \param pdfc  The PDF context, with no xref sections read yet.
+ * \param xidx  Filled in with where to find the trailer.
+ * \return      TRUE if the sections were rebuilt. FALSE if there is no usable
+ *              index for the file; any sections partly built have been
+ *              freed, but a VMERROR may have been raised.
+ */
+Bool pdf_xrefindex_load( PDFCONTEXT *pdfc , PDF_XREFINDEX *xidx )
+{
+  PDFXCONTEXT *pdfxc ;
+  uint32 key[ XIDX_HEADER_WORDS ] , header[ XIDX_HEADER_WORDS ] ;
+  uint32 nsections = 0 , ntables = 0 , nobjects = 0 , i ;
+  uint32 hash ;
+  uint8 name[ 32 ] , head[ XIDX_HEADER_BYTES ] , *body = NULL ;
+  int32 bodysize = 0 ;
+  DEVICELIST *dev ;
+  DEVICE_FILEDESCRIPTOR fd ;
+  Bool ok ;
+
+  PDF_CHECK_MC( pdfc ) ;
+  PDF_GET_XC( pdfxc ) ;
+  HQASSERT( xidx , "No xref index details" ) ;
+  HQASSERT( pdfxc->xrefsec == NULL , "Xref already read" ) ;
+
+  if ( ! xidx_key( pdfc , key ) ||
+       (dev = find_device(( uint8 * )"os" )) == NULL )
+    return FALSE ;
+
+  hash = xidx_hash( key ) ;
+  xidx_name( hash , name ) ;
+  if ( (fd = (*theIOpenFile( dev ))( dev , name , SW_RDONLY )) < 0 )
+    return FALSE ;
+
+  ok = (*theIReadFile( dev ))( dev , fd , head , XIDX_HEADER_BYTES ) ==
+       XIDX_HEADER_BYTES ;
+  if ( ok ) {
+    for ( i = 0 ; i < XIDX_HEADER_WORDS ; ++i )
+      header[ i ] = xidx_get( head + i * 4 ) ;
+
+    nsections = header[ XIDX_NSECTIONS ] ;
+    ntables = header[ XIDX_NTABLES ] ;
+    nobjects = header[ XIDX_NOBJECTS ] ;
+
+    ok = header[ XIDX_MAGIC_WORD ] == XIDX_MAGIC &&
+         header[ XIDX_VERSION_WORD ] == XIDX_VERSION &&
+         nsections > 0 && nsections <= XIDX_MAX_SECTIONS &&
+         ntables <= XIDX_MAX_TABLES && nobjects <= XIDX_MAX_OBJECTS &&
+         header[ XIDX_TRAILER_HI ] <= MAXINT32 &&
+         header[ XIDX_ROOT_NUM ] <= MAXINT32 &&
+         header[ XIDX_INFO_NUM ] <= MAXINT32 ;
+    for ( i = XIDX_SIZE_HI ; ok && i <= XIDX_MODIFIED ; ++i )
+      ok = header[ i ] == key[ i ] ;
+  }
+
+  if ( ok ) {
+    bodysize = ( int32 )(( nsections * XIDX_SECTION_WORDS +
+                           ntables * XIDX_TABLE_WORDS +
+                           nobjects * XIDX_OBJECT_WORDS ) * 4 ) ;
+    ok = (body = mm_alloc( mm_pool_temp , bodysize ,
+                           MM_ALLOC_CLASS_PDF_XREF )) != NULL &&
+         (*theIReadFile( dev ))( dev , fd , body , bodysize ) == bodysize ;
+  }
+
+  (void)(*theICloseFile( dev ))( dev , fd ) ;
+
+  if ( ok ) {
+    uint32 adler = xidx_adler( 1 , head , XIDX_CHECKSUM * 4 ) ;
+
+    adler = xidx_adler( adler , body , bodysize ) ;
+    ok = adler == header[ XIDX_CHECKSUM ] &&
+         xidx_validate( body , nsections , ntables , nobjects ) ;
+    if ( ok ) {
+      ok = xidx_check_offsets( pdfc , body , nsections , ntables , nobjects ) ;
+      /* An index which no longer matches its file is no use to anyone. */
+      if ( ! ok ) {
+        (void)(*theIDeleteFile( dev ))( dev , name ) ;
+        xidx_directory_touch( dev , hash , 0 ) ;
+      }
+    }
+  }
+
+  if ( ok ) {
+    xidx_directory_touch( dev , hash , XIDX_HEADER_BYTES + bodysize ) ;
+    if ( xidx_rebuild( pdfc , body , nsections , ntables ) ) {
+      xidx->kind = ( int32 )header[ XIDX_KIND ] ;
+      xidx->trailerpos.high = ( int32 )header[ XIDX_TRAILER_HI ] ;
+      xidx->trailerpos.low = header[ XIDX_TRAILER_LO ] ;
+      xidx->rootnum = ( int32 )header[ XIDX_ROOT_NUM ] ;
+      xidx->rootgen = ( uint16 )header[ XIDX_ROOT_GEN ] ;
+      xidx->infonum = ( int32 )header[ XIDX_INFO_NUM ] - 1 ;
+      xidx->infogen = ( uint16 )header[ XIDX_INFO_GEN ] ;
+      xidx->idlen = header[ XIDX_ID_LEN ] ;
+      xidx->idhash = header[ XIDX_ID_FNV ] ;
+    } else {
+      pdf_flushxrefsec( pdfc ) ;
+      ok = FALSE ;
+    }
+  }
+
+  if ( body != NULL )
+    mm_free( mm_pool_temp , body , bodysize ) ;
+
+  return ok ;
+}
+
+/**
+ * Check the trailer ID of the current PDF file is the one its index was made
+ * with, once the trailer has been read.
+ *
+ * \param xidx  The trailer details restored by pdf_xrefindex_load().
+ * \param id    The ID from the trailer.
+ * \return      TRUE if the ID is the same.
+ */
+Bool pdf_xrefindex_same_id( const PDF_XREFINDEX *xidx , OBJECT *id )
+{
+  uint32 idlen , idhash ;
+
+  HQASSERT( xidx , "No xref index details" ) ;
+
+  return xidx_id( id , & idlen , & idhash ) &&
+         idlen == xidx->idlen && idhash == xidx->idhash ;
+}
+
+/**
+ * Save the xref sections of the current PDF file to an index, if the
+ * XRefIndex PDF parameter is set.
+ *
+ * The index is only an optimisation, so failing to save it is not an error.
+ *
+ * \param pdfc        The PDF context, after the trailer has been read.
+ * \param kind        Where the trailer is found, or PDF_XREFINDEX_NONE if the
+ *                    xref cannot be indexed.
+ * \param trailerpos  File offset of the trailer.
+ * \param id          The ID from the trailer.
+ */
+void pdf_xrefindex_save( PDFCONTEXT *pdfc , int32 kind , Hq32x2 trailerpos ,
+                         OBJECT *id )
+{
+  PDFXCONTEXT *pdfxc ;
+  PDF_IXC_PARAMS *ixc ;
+  uint32 header[ XIDX_HEADER_WORDS ] ;
+  uint32 nsections = 0 , ntables = 0 , nobjects = 0 , i ;
+  uint32 hash ;
+  uint8 name[ 32 ] , *buffer , *sec , *tab , *obj ;
+  int32 size ;
+  XREFSEC *xrefsec ;
+  XREFTAB *xreftab ;
+  DEVICELIST *dev ;
+  DEVICE_FILEDESCRIPTOR fd ;
+  Bool ok ;
+
+  PDF_CHECK_MC( pdfc ) ;
+  PDF_GET_XC( pdfxc ) ;
+  PDF_GET_IXC( ixc ) ;
+
+  if ( ! ixc->XRefIndex || kind == PDF_XREFINDEX_NONE ||
+       pdfxc->crypt_info != NULL || oType( ixc->trailer_encrypt ) != ONULL ||
+       oType( ixc->pdfroot ) != OINDIRECT ||
+       ( oType( ixc->pdfinfo ) != ONULL &&
+         oType( ixc->pdfinfo ) != OINDIRECT ) ||
+       Hq32x2CompareInt32( & trailerpos , 0 ) < 0 )
+    return ;
+
+  for ( xrefsec = pdfxc->xrefsec ; xrefsec ; xrefsec = xrefsec->xrefnxt ) {
+    if ( Hq32x2CompareInt32( & xrefsec->byteoffset , 0 ) < 0 )
+      return ;
+    ++nsections ;
+    for ( xreftab = xrefsec->xreftab ; xreftab ; xreftab = xreftab->xrefnxt ) {
+      ++ntables ;
+      nobjects += ( uint32 )xreftab->number ;
+      if ( nobjects > XIDX_MAX_OBJECTS )
+        return ;
+    }
+  }
+  if ( nsections == 0 || nsections > XIDX_MAX_SECTIONS ||
+       ntables > XIDX_MAX_TABLES )
+    return ;
+
+  size = ( int32 )( XIDX_HEADER_BYTES +
+                    ( nsections * XIDX_SECTION_WORDS +
+                      ntables * XIDX_TABLE_WORDS +
+                      nobjects * XIDX_OBJECT_WORDS ) * 4 ) ;
+  if ( size > XIDX_MAX_BYTES ||
+       ! xidx_id( id , & header[ XIDX_ID_LEN ] , & header[ XIDX_ID_FNV ] ) ||
+       ! xidx_key( pdfc , header ) ||
+       (dev = find_device(( uint8 * )"os" )) == NULL )
+    return ;
+
+  header[ XIDX_MAGIC_WORD ] = XIDX_MAGIC ;
+  header[ XIDX_VERSION_WORD ] = XIDX_VERSION ;
+  header[ XIDX_KIND ] = ( uint32 )kind ;
+  header[ XIDX_TRAILER_HI ] = ( uint32 )trailerpos.high ;
+  header[ XIDX_TRAILER_LO ] = trailerpos.low ;
+  header[ XIDX_ROOT_NUM ] = ( uint32 )oXRefID( ixc->pdfroot ) ;
+  header[ XIDX_ROOT_GEN ] = theGen( ixc->pdfroot ) ;
+  header[ XIDX_INFO_NUM ] = 0 ;
+  header[ XIDX_INFO_GEN ] = 0 ;
+  if ( oType( ixc->pdfinfo ) == OINDIRECT ) {
+    header[ XIDX_INFO_NUM ] = ( uint32 )oXRefID( ixc->pdfinfo ) + 1 ;
+    header[ XIDX_INFO_GEN ] = theGen( ixc->pdfinfo ) ;
+  }
+  header[ XIDX_NSECTIONS ] = nsections ;
+  header[ XIDX_NTABLES ] = ntables ;
+  header[ XIDX_NOBJECTS ] = nobjects ;
+
+  if ( (buffer = mm_alloc( mm_pool_temp , size ,
+                           MM_ALLOC_CLASS_PDF_XREF )) == NULL )
+    return ;
+
+  sec = buffer + XIDX_HEADER_BYTES ;
+  tab = sec + nsections * XIDX_SECTION_WORDS * 4 ;
+  obj = tab + ntables * XIDX_TABLE_WORDS * 4 ;
+  for ( xrefsec = pdfxc->xrefsec ; xrefsec ; xrefsec = xrefsec->xrefnxt ) {
+    uint32 count = 0 ;
+
+    for ( xreftab = xrefsec->xreftab ; xreftab ; xreftab = xreftab->xrefnxt ) {
+      XREFOBJ *xrefobj = xreftab->xrefobj ;
+      int32 n ;
+
+      xidx_put( tab , ( uint32 )xreftab->objnum ) ;
+      xidx_put( tab + 4 , ( uint32 )xreftab->number ) ;
+      tab += XIDX_TABLE_WORDS * 4 ;
+      ++count ;
+
+      for ( n = xreftab->number ; n > 0 ;
+            --n , ++xrefobj , obj += XIDX_OBJECT_WORDS * 4 ) {
+        uint32 use = xrefobj->objuse , high = 0 , low = 0 ;
+
+        switch ( use ) {
+        case XREF_Used:
+          use |= ( uint32 )xrefobj->d.n.objgen << 16 ;
+          high = ( uint32 )xrefobj->d.n.offset.high ;
+          low = xrefobj->d.n.offset.low ;
+          break ;
+        case XREF_Free:
+          use |= ( uint32 )xrefobj->d.f.objgen << 16 ;
+          low = ( uint32 )xrefobj->d.f.objnum ;
+          break ;
+        case XREF_Compressed:
+          high = ( uint32 )xrefobj->d.c.sindex ;
+          low = ( uint32 )xrefobj->d.c.objnum ;
+          break ;
+        default:
+          use = XREF_Uninitialised ;
+          break ;
+        }
+        xidx_put( obj , use ) ;
+        xidx_put( obj + 4 , high ) ;
+        xidx_put( obj + 8 , low ) ;
+      }
+    }
+
+    xidx_put( sec , ( uint32 )xrefsec->byteoffset.high ) ;
+    xidx_put( sec + 4 , xrefsec->byteoffset.low ) ;
+    xidx_put( sec + 8 , count ) ;
+    sec += XIDX_SECTION_WORDS * 4 ;
+  }
+
+  for ( i = 0 ; i < XIDX_CHECKSUM ; ++i )
+    xidx_put( buffer + i * 4 , header[ i ] ) ;
+  header[ XIDX_CHECKSUM ] =
+    xidx_adler( xidx_adler( 1 , buffer , XIDX_CHECKSUM * 4 ) ,
+                buffer + XIDX_HEADER_BYTES , size - XIDX_HEADER_BYTES ) ;
+  xidx_put( buffer + XIDX_CHECKSUM * 4 , header[ XIDX_CHECKSUM ] ) ;
+
+  hash = xidx_hash( header ) ;
+  xidx_name( hash , name ) ;
+  if ( (fd = (*theIOpenFile( dev ))( dev , name ,
+                                     SW_WRONLY | SW_CREAT | SW_TRUNC )) >= 0 ) {
+    ok = (*theIWriteFile( dev ))( dev , fd , buffer , size ) == size ;
+    ok = (*theICloseFile( dev ))( dev , fd ) >= 0 && ok ;
+    /* Don't leave a truncated index behind; it would be rejected anyway. */
+    if ( ! ok )
+      (void)(*theIDeleteFile( dev ))( dev , name ) ;
+    xidx_directory_touch( dev , hash , ok ? size : 0 ) ;
+  }
+
+  mm_free( mm_pool_temp , buffer , size ) ;
+}
+
+/* Log stripped */
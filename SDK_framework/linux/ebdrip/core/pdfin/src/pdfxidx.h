@@ -0,0 +1,48 @@
+/** \file
+ * \ingroup pdfin
+ *
+ * $HopeName: SWpdf!src:pdfxidx.h(EBDSDK_P.1) $
+ *
+ * Copyright (C) 2014 Global Graphics Software Ltd. All rights reserved.
+ * Global Graphics Software Ltd. Confidential Information.
+ *
+ * \brief
+ * Persistent PDF xref index API
+ */
+
+#ifndef __PDFXIDX_H__
+#define __PDFXIDX_H__
+
+#include "hq32x2.h"
+
+/** Where the trailer dictionary for an indexed file is found. */
+enum {
+  PDF_XREFINDEX_NONE = 0,   /**< The xref cannot be indexed. */
+  PDF_XREFINDEX_TABLE,      /**< Trailer dictionary after an xref table. */
+  PDF_XREFINDEX_STREAM,     /**< Dictionary of the main xref stream. */
+  PDF_XREFINDEX_REPAIRED    /**< Last trailer dictionary found by repair. */
+} ;
+
+/** Trailer details restored from an xref index. */
+typedef struct PDF_XREFINDEX {
+  int32 kind ;          /**< One of the PDF_XREFINDEX_ values. */
+  Hq32x2 trailerpos ;   /**< File offset of the trailer dictionary, or of
+                             the xref stream object. */
+  int32 rootnum ;       /**< Object number of the Root dictionary. */
+  uint16 rootgen ;      /**< Generation number of the Root dictionary. */
+  int32 infonum ;       /**< Object number of the Info dictionary, or -1. */
+  uint16 infogen ;      /**< Generation number of the Info dictionary. */
+  uint32 idlen ;        /**< Bytes of the trailer ID digested. */
+  uint32 idhash ;       /**< Digest of the trailer ID. */
+} PDF_XREFINDEX ;
+
+Bool pdf_xrefindex_load( PDFCONTEXT *pdfc , PDF_XREFINDEX *xidx ) ;
+
+Bool pdf_xrefindex_same_id( const PDF_XREFINDEX *xidx , OBJECT *id ) ;
+
+void pdf_xrefindex_save( PDFCONTEXT *pdfc , int32 kind , Hq32x2 trailerpos ,
+                         OBJECT *id ) ;
+
+#endif /* protection for multiple inclusion */
+
+/* Log stripped */
@@ -36,6 +36,7 @@ typedef struct band_t {
   Bool fDontOutput; /**< Don't output the band (if nothing ripped). */
   int32 size_to_write; /**< Size of band to write to page buffer dev. */
   struct band_t *next ; /**< Next band in list of buffers. */
+  unsigned int cache_index ; /**< Idle list an extension band returns to. */
 } band_t;
 
 /** \brief Parameter to set how many inches per dl band.
@@ -172,6 +173,30 @@ Bool alloc_band_extension(resource_pool_t *pool, band_t *pband) ;
 */
 void free_band_extensions(resource_pool_t *pool, band_t *pband) ;
 
+/** Nominate a pool whose band extension buffers will be recycled.
+
+    While a pool is nominated, \c free_band_extensions() keeps a small number
+    of extension buffers from it on each thread, for \c alloc_band_extension()
+    to re-use on the same thread, rather than returning them to the pool.
+    The idle buffers are also released in low memory. Only one pool can be
+    nominated at a time.
+
+    \param pool  The resource pool used for output band buffers.
+
+    \retval TRUE  The pool was nominated, and \c band_extensions_purge()
+                  must be called before the pool is released.
+    \retval FALSE Another pool is already nominated; extension buffers from
+                  this pool will not be recycled.
+*/
+Bool band_extensions_recycle(resource_pool_t *pool) ;
+
+/** Free recycled band extension buffers, and stop recycling extensions for
+    a pool nominated by \c band_extensions_recycle().
+
+    \param pool  The resource pool used for output band buffers.
+*/
+void band_extensions_purge(resource_pool_t *pool) ;
+
 /** \} */
 
 #endif /* __BANDTABLE_H__ */
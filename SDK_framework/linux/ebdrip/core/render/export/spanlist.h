@@ -269,6 +269,11 @@ void spanlist_assert_valid(spanlist_t *spanlist) ;
 
 /** Unit test asserts that spanlist functions work correctly */
 void spanlist_unit_test(void) ;
+
+/** Time bitmap span extraction against the pixel-by-pixel version.
+
+    \param repeat The number of times to extract spans from each bitmap. */
+void spanlist_bitmap_benchmark(uint32 repeat) ;
 #else
 #define spanlist_assert_valid(s_) EMPTY_STATEMENT()
 #define spanlist_unit_test() EMPTY_STATEMENT()
@@ -275,9 +275,11 @@ static void backdrop_blitmap_optimise(blit_colormap_t *map)
 static void bitfillbackdrop(render_blit_t *rb,
                             dcoord y, dcoord xsp, dcoord xep)
 {
+  /* The backdrop is in page DL space, and ignores the separation position. */
   bd_compositeSpan(rb->p_ri->p_rs->composite_context,
                    render_state_backdrop(rb->p_ri->p_rs),
-                   xsp, y, xep - xsp + 1, rb->color);
+                   xsp + rb->p_ri->x_dl_offset, y + rb->p_ri->y_dl_offset,
+                   xep - xsp + 1, rb->color);
 }
 
 /* ---------------------------------------------------------------------- */
@@ -297,7 +299,8 @@ static void blkfillbackdrop(render_blit_t *rb,
     bitfillbackdrop(rb, ys, xsp, xep);
   } else {
     bd_compositeBlock(rb->p_ri->p_rs->composite_context,
-                      render_state_backdrop(rb->p_ri->p_rs), xsp, ys,
+                      render_state_backdrop(rb->p_ri->p_rs),
+                      xsp + rb->p_ri->x_dl_offset, ys + rb->p_ri->y_dl_offset,
                       xep - xsp + 1, rows, rb->color);
   }
 }
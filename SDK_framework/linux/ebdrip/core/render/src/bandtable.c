@@ -45,6 +45,9 @@
 #include "swtimelines.h"
 #include "riptimeline.h"
 #include "irr.h"
+#include "lowmem.h" /* low_mem_handler_t */
+#include "hqmemset.h" /* HqMemZero */
+#include "hqspin.h" /* Must be last include because of hqwindows.h */
 
 /** Maximums for reserved bands/forms, see render_forms_t and
     alloc_all_bands. */
@@ -157,6 +160,83 @@ Bool got_basemap_semaphore(uint32 semaphore)
 
 
 /* ----------- band extension for RLE ----------- */
+
+/** Maximum number of extension buffers kept for re-use by each thread.
+    Extensions are the same size as output bands, so we don't want to hold
+    on to many of them. */
+#define BAND_EXTENSION_CACHE_MAX 2
+
+/** Index of the idle extension list shared by threads outside the core. */
+#define BAND_EXTENSION_CACHE_SHARED NTHREADS_LIMIT
+
+/** Extension buffers freed by bands allocated on one thread, waiting to be
+    re-used by the next band to overflow on the same thread. Each thread has
+    its own idle list, so bands rendering on different threads don't contend
+    for it. An extension is always returned to the list of the thread that
+    allocated it, so a thread that only frees cannot collect idle buffers. The list is protected by a spinlock on the \c free field, which
+    also protects the other fields; the lock is only contended when the
+    low-memory handler or a purge frees the idle buffers. */
+typedef struct band_extension_cache_t {
+  band_t *free ;          /**< Idle extension buffers. */
+  resource_pool_t *pool ; /**< Pool the idle extensions belong to. */
+  int32 count ;           /**< Length of the idle list. */
+  size_t bytes ;          /**< Size of the idle buffers. */
+} band_extension_cache_t ;
+
+/** Idle extension lists, indexed by thread index. Threads outside the core
+    share the extra list at BAND_EXTENSION_CACHE_SHARED. */
+static band_extension_cache_t band_extension_cache[NTHREADS_LIMIT + 1] ;
+
+/** The nominated pool, whose extensions are recycled. Only extensions from
+    this pool are added to the idle lists. */
+static resource_pool_t *band_extension_pool ;
+
+static low_mem_handler_t band_extension_handler ;
+
+/** Find the index of the idle extension list for the current thread. */
+static inline unsigned int band_extension_cache_local(void)
+{
+  corecontext_t *context = get_core_context() ;
+
+  if ( context == NULL || context->thread_index >= NTHREADS_LIMIT )
+    return BAND_EXTENSION_CACHE_SHARED ;
+  return context->thread_index ;
+}
+
+/** Free all of the idle extensions of one list from a pool, or all of the
+    idle extensions if \c pool is NULL, returning the number of bytes freed.
+    The buffers are returned to their pool while the list is still locked, so
+    a purge cannot release the pool while they are being freed. */
+static size_t band_extension_cache_free(band_extension_cache_t *cache,
+                                        resource_pool_t *pool)
+{
+  resource_entry_t entry = {
+    TASK_RESOURCE_FREE,
+    TASK_RESOURCE_ID_INVALID /*id*/,
+    NULL /*owner*/,
+    NULL /*resource*/
+  } ;
+  band_t *idle, *extra ;
+  size_t freed = 0 ;
+
+  spinlock_pointer(&cache->free, idle, 1) ;
+  if ( idle != NULL && (pool == NULL || cache->pool == pool) ) {
+    while ( (extra = idle) != NULL ) {
+      idle = extra->next ;
+      entry.resource = extra ;
+      freed += (size_t)cache->pool->key ;
+      cache->pool->free(cache->pool, &entry) ;
+    }
+    cache->count = 0 ;
+    cache->bytes = 0 ;
+  }
+  if ( idle == NULL )
+    cache->pool = NULL ;
+  spinunlock_pointer(&cache->free, idle) ;
+
+  return freed ;
+}
+
 Bool alloc_band_extension(resource_pool_t *pool, band_t *pband)
 {
   resource_entry_t entry = {
@@ -165,17 +245,37 @@ Bool alloc_band_extension(resource_pool_t *pool, band_t *pband)
     NULL /*owner*/,
     NULL /*resource*/
   } ;
-  band_t *extra ;
+  unsigned int index = band_extension_cache_local() ;
+  band_extension_cache_t *cache = &band_extension_cache[index] ;
+  band_t *extra, *idle ;
 
   HQASSERT(pband != NULL, "No band descriptor entry") ;
 
-  if ( !pool->alloc(pool, &entry, mm_cost_none) )
-    return FALSE ;
+  /* Prefer an extension this thread has finished with. */
+  spinlock_pointer(&cache->free, idle, 1) ;
+  if ( (extra = idle) != NULL && cache->pool == pool ) {
+    idle = extra->next ;
+    --cache->count ;
+    cache->bytes -= (size_t)pool->key ;
+  } else {
+    extra = NULL ;
+  }
+  spinunlock_pointer(&cache->free, idle) ;
 
-  if ( (extra = entry.resource) == NULL || extra->mem == NULL ) {
-    pool->free(pool, &entry) ;
-    return FALSE ;
+  if ( extra != NULL ) {
+    extra->fCompressed = FALSE ;
+    extra->fDontOutput = FALSE ;
+    extra->size_to_write = CAST_SIZET_TO_INT32(pool->key) ;
+  } else {
+    if ( !pool->alloc(pool, &entry, mm_cost_none) )
+      return FALSE ;
+
+    if ( (extra = entry.resource) == NULL || extra->mem == NULL ) {
+      pool->free(pool, &entry) ;
+      return FALSE ;
+    }
   }
+  extra->cache_index = index ;
 
   /* Push on head of extras list to make this easy to find. */
   extra->next = pband->next ;
@@ -192,17 +292,130 @@ void free_band_extensions(resource_pool_t *pool, band_t *pband)
     NULL /*owner*/,
     NULL /*resource*/
   } ;
-  band_t *extra ;
+  band_t *extra, *idle ;
 
   HQASSERT(pband != NULL, "No band descriptor entry") ;
 
   while ( (extra = pband->next) != NULL ) {
+    band_extension_cache_t *cache ;
+    Bool cached = FALSE ;
+
     pband->next = extra->next ;
-    entry.resource = extra ;
-    pool->free(pool, &entry) ;
+
+    /* Return the extension to the list of the thread that allocated it, so
+       it is found again by that thread's next overflow. */
+    HQASSERT(extra->cache_index <= BAND_EXTENSION_CACHE_SHARED,
+             "Band extension has no idle list") ;
+    cache = &band_extension_cache[extra->cache_index] ;
+
+    /* The nomination is checked while the list is locked, so a purge that
+       has withdrawn it will either see this extension or prevent it being
+       cached. */
+    spinlock_pointer(&cache->free, idle, 1) ;
+    if ( band_extension_pool == pool &&
+         (idle == NULL || cache->pool == pool) &&
+         cache->count < BAND_EXTENSION_CACHE_MAX ) {
+      extra->next = idle ;
+      idle = extra ;
+      cache->pool = pool ;
+      ++cache->count ;
+      cache->bytes += (size_t)pool->key ;
+      cached = TRUE ;
+    }
+    spinunlock_pointer(&cache->free, idle) ;
+
+    if ( !cached ) {
+      entry.resource = extra ;
+      pool->free(pool, &entry) ;
+    }
   }
 }
 
+Bool band_extensions_recycle(resource_pool_t *pool)
+{
+  Bool nominated ;
+
+  HQASSERT(pool != NULL, "No band extension pool") ;
+
+  HqAtomicCASPointer(&band_extension_pool, NULL, pool, nominated,
+                     resource_pool_t) ;
+
+  return nominated ;
+}
+
+void band_extensions_purge(resource_pool_t *pool)
+{
+  unsigned int i ;
+
+  HQASSERT(pool != NULL, "No band extension pool") ;
+  HQASSERT(band_extension_pool == pool, "Purging a pool not nominated") ;
+
+  /* Withdraw the nomination before visiting the lists, so no more
+     extensions are cached for this pool. Locking each list orders this
+     store before the list is examined. */
+  band_extension_pool = NULL ;
+
+  for ( i = 0 ; i <= BAND_EXTENSION_CACHE_SHARED ; ++i )
+    (void)band_extension_cache_free(&band_extension_cache[i], pool) ;
+}
+
+/** Solicit method of the band extension low-memory handler. */
+static low_mem_offer_t *band_extension_solicit(low_mem_handler_t *handler,
+                                               corecontext_t *context,
+                                               size_t count,
+                                               memory_requirement_t* requests)
+{
+  static low_mem_offer_t offer ;
+  unsigned int i ;
+  size_t idle = 0 ;
+
+  HQASSERT(handler != NULL, "No handler") ;
+  HQASSERT(context != NULL, "No context") ;
+  HQASSERT(requests != NULL, "No requests") ;
+  UNUSED_PARAM(low_mem_handler_t *, handler) ;
+  UNUSED_PARAM(corecontext_t *, context) ;
+  UNUSED_PARAM(size_t, count) ;
+  UNUSED_PARAM(memory_requirement_t*, requests) ;
+
+  /* An estimate is good enough; the lists are not locked. */
+  for ( i = 0 ; i <= BAND_EXTENSION_CACHE_SHARED ; ++i )
+    idle += band_extension_cache[i].bytes ;
+  if ( idle == 0 )
+    return NULL ;
+
+  offer.pool = basemap_pool ;
+  offer.offer_size = idle ;
+  offer.offer_cost = 1.0f ; /* Idle buffers cost nothing to recreate. */
+  offer.next = NULL ;
+  return &offer ;
+}
+
+/** Release method of the band extension low-memory handler. */
+static Bool band_extension_release(low_mem_handler_t *handler,
+                                   corecontext_t *context,
+                                   low_mem_offer_t *offer)
+{
+  unsigned int i ;
+  size_t freed = 0 ;
+
+  HQASSERT(handler != NULL, "No handler") ;
+  HQASSERT(context != NULL, "No context") ;
+  HQASSERT(offer != NULL, "No offer") ;
+  HQASSERT(offer->next == NULL, "Multiple offers") ;
+  UNUSED_PARAM(low_mem_handler_t *, handler) ;
+  UNUSED_PARAM(corecontext_t *, context) ;
+
+  for ( i = 0 ; i <= BAND_EXTENSION_CACHE_SHARED && freed < offer->taken_size ; ++i )
+    freed += band_extension_cache_free(&band_extension_cache[i], NULL) ;
+
+  return TRUE ;
+}
+
+static low_mem_handler_t band_extension_handler = {
+  "Band extension cache",
+  memory_tier_ram, band_extension_solicit, band_extension_release, TRUE,
+  0, FALSE } ;
+
 /* ----------- PGB interface ----------- */
 
 
@@ -1363,7 +1576,8 @@ static Bool bandtable_swinit(struct SWSTART *params)
 
   if ( !resource_source_low_mem_register(&output_band_source) ||
        !resource_source_low_mem_register(&mask_band_source) ||
-       !resource_source_low_mem_register(&framebuffer_band_source) ) {
+       !resource_source_low_mem_register(&framebuffer_band_source) ||
+       !low_mem_handler_register(&band_extension_handler) ) {
     bandtable_finish();
     return FAILURE(FALSE) ;
   }
@@ -1373,6 +1587,7 @@ static Bool bandtable_swinit(struct SWSTART *params)
 
 static void bandtable_finish(void)
 {
+  low_mem_handler_deregister(&band_extension_handler) ;
   resource_source_low_mem_deregister(&output_band_source) ;
   resource_source_low_mem_deregister(&mask_band_source) ;
   resource_source_low_mem_deregister(&framebuffer_band_source) ;
@@ -1402,6 +1617,9 @@ static void init_C_globals_bandtable(void)
 
   band_factor = 0.0f ;
 
+  HqMemZero(band_extension_cache, sizeof(band_extension_cache)) ;
+  band_extension_pool = NULL ;
+
   basemap_pool = NULL ;
   basemap.mem = NULL;
   basemap.size = 0;
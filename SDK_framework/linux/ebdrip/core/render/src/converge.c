@@ -21,9 +21,16 @@
  * repeated from the cell definition before a block copy of a number of bytes
  * can fill in the rest. repeatbw is repeatb rounded up to the number of blit
  * words containing those bytes.
+ *
+ * The first repeatbw words extracted for a row are cached per render thread
+ * as tile rows, keyed by the spot, colorant, form (which stands for the
+ * level) and phase of the row in the cell. Spans and blocks at the same
+ * level and phase copy the tile row instead of extracting it again.
  */
 
 #include "core.h"
+#include "coreinit.h"
+#include "swstart.h"
 
 #include "bitblts.h"
 #include "often.h"
@@ -33,6 +40,8 @@
 #include "halftone.h"
 #include "converge.h"
 #include "caching.h"
+#include "mm.h"
+#include "mlock.h" /* NTHREADS_LIMIT */
 
 
 /* Fast copy routines for halftone replication. When these are called, the
@@ -186,49 +195,22 @@ MACRO_END
 
 
 
-/* ----------------------------------------------------------------------------
-   function:            moreonbitsptr(..)  author:              Andrew Cave
-   creation date:       24-May-1987        last modification:   ##-###-####
-   arguments:           x , y , n .
-   description:
-
-   This procedure obtains the next n bit masks used in the halftoning.
-   Version for orthogonal screens using a cached FORM.
-
--------------------------------------------------------------------------- */
-void moreonbitsptr(blit_t *halftonebase, const ht_params_t *ht_params,
-                   int32 x, int32 y, int32 n)
+/** Extract \a n words of a halftone cell row into \a dstptr, starting \a cx
+    bits into the row at \a baseptr and wrapping every \a w bits. Returns the
+    word after the last one stored. */
+static inline blit_t *expand_row(register blit_t *dstptr, blit_t *baseptr,
+                                 register int32 cx, int32 w, int32 n)
 {
-  register int32 cx ;
   register int32 shiftr , shiftl ;
   register blit_t src1 , src2 ;
-  register blit_t *dstptr ;
   register blit_t *srcptr ;
-  int32 w , cy ;
-  blit_t *baseptr ;
-  int32 blitstocopy ;
-
-  SwOftenUnsafe() ;
-
-/* Find out how many words we can start doing a straight copy afterwards. */
-  SETUP_HALFTONE_COPY(ht_params, n, blitstocopy) ;
-
-/* Firstly, quick correct jumps in x & y. */
-  cx = (int32)((uint32)( x + ht_params->px ) % (uint32)ht_params->xdims) ;
-  cy = (int32)((uint32)( y + ht_params->py ) % (uint32)ht_params->ydims) ;
-
-/* Get y-base index into h/t. */
-  baseptr = BLIT_ADDRESS(theFormA(*ht_params->form), ht_params->ys[cy]) ;
 
   srcptr = &baseptr[cx >> BLIT_SHIFT_BITS] ;
-  dstptr = halftonebase ;
 
   src2 = (*srcptr++) ;
   shiftl = cx & BLIT_MASK_BITS ;
   shiftr = BLIT_WIDTH_BITS - shiftl ;
 
-  w  = ht_params->xdims  ;
-
   while ((--n) > 0 ) {
     src1 = src2 ;
     src2 = (*srcptr++) ;
@@ -236,12 +218,14 @@ void moreonbitsptr(blit_t *halftonebase, const ht_params_t *ht_params,
     if ( !shiftl )
       (*dstptr++) = src1;
     else
-#endif /* Can_Shift_32 */
+#endif  /* Can_Shift_32 */
       (*dstptr++) = SHIFTLEFT( src1 , shiftl ) | SHIFTRIGHT( src2 , shiftr ) ;
 
     cx += BLIT_WIDTH_BITS ;
     if ( cx >= w ) {
-      cx -= w ;
+      do {
+        cx -= w ;
+      } while ( cx >= w ) ;
       srcptr = baseptr ;
       src2 = (*srcptr++) ;
       shiftl = cx & BLIT_MASK_BITS ;
@@ -250,11 +234,139 @@ void moreonbitsptr(blit_t *halftonebase, const ht_params_t *ht_params,
   }
 #ifndef Can_Shift_32
   if ( !shiftl )
-    (*dstptr++) = src2;
+    (*dstptr++) = src2 ;
   else
-#endif /* Can_Shift_32 */
+#endif  /* Can_Shift_32 */
     (*dstptr++) = SHIFTLEFT(src2,shiftl) | SHIFTRIGHT(srcptr[0],shiftr) ;
 
+  return dstptr ;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/** Number of tile rows cached for each render thread. This must be a power
+    of two. */
+#define HT_TILE_ROWS 16
+
+/** Cache line size the tile rows are aligned to. */
+#define HT_TILE_ALIGN 64
+
+/** Largest tile row cached, in bytes. This is a multiple of the cache line
+    size, so the tile rows stay aligned. Screens with a longer repeat are
+    extracted directly. */
+#define HT_TILE_BYTES 256
+
+/** A row of a halftone cell, extracted from a phase in the cell up to the
+    replication repeat of the screen. */
+typedef struct ht_tile_row_t {
+  blit_t *row ;         /**< Cache line aligned words of the row. */
+  const FORM *form ;    /**< Form of the level extracted, NULL if unused. */
+  SPOTNO spotno ;       /**< Spot number of the screen. */
+  COLORANTINDEX ci ;    /**< Colorant of the screen. */
+  int32 cx, cy ;        /**< Phase of the row in the cell. */
+  int32 width ;         /**< Bits at which the row wraps. */
+  int32 nwords ;        /**< Number of words extracted. */
+  hq_atomic_counter_t generation ; /**< ht_form_generation when extracted. */
+} ht_tile_row_t ;
+
+/** Tile rows for all render threads, HT_TILE_ROWS per thread index. This is
+    NULL if the cache could not be allocated. */
+static ht_tile_row_t *ht_tile_rows ;
+
+/** Allocation holding the tile rows and their words. */
+static void *ht_tile_memory ;
+static size_t ht_tile_size ;
+
+/** Find the tile row for a phase of the current form, extracting it if it is
+    not already cached for this thread. Returns NULL if the screen's repeat is
+    too long to cache, or the thread has no cache. */
+static ht_tile_row_t *ht_tile_row(const ht_params_t *ht_params,
+                                  blit_t *baseptr, int32 cx, int32 cy,
+                                  int32 w)
+{
+  unsigned int index ;
+  uintptr_t hash ;
+  ht_tile_row_t *tile ;
+  hq_atomic_counter_t generation ;
+
+  if ( ht_tile_rows == NULL || ht_params->repeatbw <= 0 ||
+       ht_params->repeatbw > (int32)(HT_TILE_BYTES / sizeof(blit_t)) )
+    return NULL ;
+
+  /* Threads beyond the limit would have to share rows. */
+  index = get_core_context()->thread_index ;
+  if ( index >= NTHREADS_LIMIT )
+    return NULL ;
+
+  hash = ((uintptr_t)ht_params->form / HT_TILE_ALIGN) +
+    (uintptr_t)cy * 7 + (uintptr_t)cx ;
+  tile = &ht_tile_rows[index * HT_TILE_ROWS + (hash & (HT_TILE_ROWS - 1))] ;
+
+  /* The form cannot be regenerated while the screen is locked for
+     rendering, but it may have been reused for another level or screen
+     since the row was extracted. */
+  generation = ht_form_generation ;
+  if ( tile->form != ht_params->form ||
+       tile->generation != generation ||
+       tile->spotno != ht_params->spotno ||
+       tile->ci != ht_params->ci ||
+       tile->cx != cx || tile->cy != cy ||
+       tile->width != w ||
+       tile->nwords != ht_params->repeatbw ) {
+    (void)expand_row(tile->row, baseptr, cx, w, ht_params->repeatbw) ;
+    tile->form = ht_params->form ;
+    tile->spotno = ht_params->spotno ;
+    tile->ci = ht_params->ci ;
+    tile->cx = cx ;
+    tile->cy = cy ;
+    tile->width = w ;
+    tile->nwords = ht_params->repeatbw ;
+    tile->generation = generation ;
+  }
+
+  return tile ;
+}
+
+/* ----------------------------------------------------------------------------
+   function:            moreonbitsptr(..)  author:              Andrew Cave
+   creation date:       24-May-1987        last modification:   ##-###-####
+   arguments:           x , y , n .
+   description:
+
+   This procedure obtains the next n bit masks used in the halftoning.
+   Version for orthogonal screens using a cached FORM.
+
+-------------------------------------------------------------------------- */
+void moreonbitsptr(blit_t *halftonebase, const ht_params_t *ht_params,
+                   int32 x, int32 y, int32 n)
+{
+  register int32 cx ;
+  register blit_t *dstptr ;
+  register blit_t *srcptr ;
+  int32 cy ;
+  blit_t *baseptr ;
+  int32 blitstocopy ;
+  ht_tile_row_t *tile ;
+
+  SwOftenUnsafe() ;
+
+/* Find out how many words we can start doing a straight copy afterwards. */
+  SETUP_HALFTONE_COPY(ht_params, n, blitstocopy) ;
+
+/* Firstly, quick correct jumps in x & y. */
+  cx = (int32)((uint32)( x + ht_params->px ) % (uint32)ht_params->xdims) ;
+  cy = (int32)((uint32)( y + ht_params->py ) % (uint32)ht_params->ydims) ;
+
+/* Get y-base index into h/t. */
+  baseptr = BLIT_ADDRESS(theFormA(*ht_params->form), ht_params->ys[cy]) ;
+
+  tile = ht_tile_row(ht_params, baseptr, cx, cy, ht_params->xdims) ;
+  if ( tile != NULL ) {
+    copy_0(tile->row, halftonebase, (uint32)n) ;
+    dstptr = halftonebase + n ;
+  } else
+    dstptr = expand_row(halftonebase, baseptr, cx, ht_params->xdims, n) ;
+
 /* Now we've done all the hard work, just replicate the results */
   DO_HALFTONE_COPY(ht_params, srcptr, dstptr, blitstocopy) ;
 }
@@ -323,10 +435,9 @@ void moregnbitsptr(blit_t *halftonebase, ht_params_t *ht_params,
   register int32 cx , cy ;
   register blit_t *dstptr ;
   register blit_t *srcptr ;
-  register blit_t src1, src2 ;
-  int32 w ;
   blit_t *baseptr ;
-  int32 blitstocopy, shiftr, shiftl ;
+  int32 blitstocopy ;
+  ht_tile_row_t *tile ;
   int32 halfexdims = ht_params->exdims, halfeydims = ht_params->eydims;
   int32 halfydims = ht_params->ydims;
 
@@ -374,42 +485,12 @@ void moregnbitsptr(blit_t *halftonebase, ht_params_t *ht_params,
 /* Get y-base index into h/t. */
   baseptr = BLIT_ADDRESS(theFormA(*ht_params->form), ht_params->ys[cy]) ;
 
-  srcptr = &baseptr[cx >> BLIT_SHIFT_BITS] ;
-  dstptr = halftonebase ;
-
-  src2 = (*srcptr++) ;
-  shiftl = cx & BLIT_MASK_BITS ;
-  shiftr = BLIT_WIDTH_BITS - shiftl ;
-
-  w  = halfexdims ;
-
-  while ((--n) > 0 ) {
-    src1 = src2 ;
-    src2 = (*srcptr++) ;
-#ifndef Can_Shift_32
-    if ( !shiftl )
-      (*dstptr++) = src1;
-    else
-#endif  /* Can_Shift_32 */
-      (*dstptr++) = SHIFTLEFT( src1 , shiftl ) | SHIFTRIGHT( src2 , shiftr ) ;
-
-    cx += BLIT_WIDTH_BITS ;
-    if ( cx >= w ) {
-      do {
-        cx -= w ;
-      } while ( cx >= w ) ;
-      srcptr = baseptr ;
-      src2 = (*srcptr++) ;
-      shiftl = cx & BLIT_MASK_BITS ;
-      shiftr = BLIT_WIDTH_BITS - shiftl ;
-    }
-  }
-#ifndef Can_Shift_32
-  if ( !shiftl )
-    (*dstptr++) = src2 ;
-  else
-#endif  /* Can_Shift_32 */
-    (*dstptr++) = SHIFTLEFT(src2,shiftl) | SHIFTRIGHT(srcptr[0],shiftr) ;
+  tile = ht_tile_row(ht_params, baseptr, cx, cy, halfexdims) ;
+  if ( tile != NULL ) {
+    copy_0(tile->row, halftonebase, (uint32)n) ;
+    dstptr = halftonebase + n ;
+  } else
+    dstptr = expand_row(halftonebase, baseptr, cx, halfexdims, n) ;
 
 /* Now we've done all the hard work, just replicate the results */
   DO_HALFTONE_COPY(ht_params, srcptr, dstptr, blitstocopy) ;
@@ -614,4 +695,52 @@ void moresgnbitsptr(blit_t *halftonebase, ht_params_t *ht_params,
   DO_HALFTONE_COPY(ht_params, srcptr, dstptr, blitstocopy) ;
 }
 
+/* ------------------------------------------------------------------------- */
+
+static Bool converge_swstart(struct SWSTART *params)
+{
+  size_t rows = NTHREADS_LIMIT * HT_TILE_ROWS ;
+  uint8 *words ;
+  size_t i ;
+
+  UNUSED_PARAM(struct SWSTART *, params) ;
+
+  /* The tile rows are only an optimisation, so rendering carries on
+     extracting rows directly if there is no memory for them. */
+  ht_tile_size = rows * (sizeof(ht_tile_row_t) + HT_TILE_BYTES) + HT_TILE_ALIGN ;
+  ht_tile_memory = mm_alloc(mm_pool_temp, ht_tile_size,
+                            MM_ALLOC_CLASS_HALFTONE_TILES) ;
+  if ( ht_tile_memory == NULL )
+    return TRUE ;
+
+  words = (uint8 *)ht_tile_memory ;
+  words += (HT_TILE_ALIGN - ((uintptr_t)words & (HT_TILE_ALIGN - 1))) &
+    (HT_TILE_ALIGN - 1) ;
+  ht_tile_rows = (ht_tile_row_t *)(words + rows * HT_TILE_BYTES) ;
+  for ( i = 0 ; i < rows ; ++i ) {
+    ht_tile_rows[i].row = (blit_t *)(words + i * HT_TILE_BYTES) ;
+    ht_tile_rows[i].form = NULL ;
+  }
+
+  return TRUE ;
+}
+
+static void converge_finish(void)
+{
+  if ( ht_tile_memory != NULL )
+    mm_free(mm_pool_temp, ht_tile_memory, ht_tile_size) ;
+  ht_tile_memory = NULL ;
+  ht_tile_rows = NULL ;
+}
+
+void converge_C_globals(core_init_fns *fns)
+{
+  ht_tile_rows = NULL ;
+  ht_tile_memory = NULL ;
+  ht_tile_size = 0 ;
+
+  fns->swstart = converge_swstart ;
+  fns->finish = converge_finish ;
+}
+
 /* Log stripped */
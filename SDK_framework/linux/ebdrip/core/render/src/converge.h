@@ -249,6 +249,11 @@ void findsgnbits(ht_params_t *ht_params,
 void moresgnbitsptr(blit_t *res, ht_params_t *ht_params,
                     dcoord x, dcoord y, dcoord n);
 
+struct core_init_fns ; /* from SWcore */
+
+/** Runtime initialisation of the halftone tile row cache. */
+void converge_C_globals(struct core_init_fns *fns) ;
+
 #endif  /* !__CONVERGE_H__ */
 
 
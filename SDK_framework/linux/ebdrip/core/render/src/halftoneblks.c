@@ -27,9 +27,49 @@
 #include "halftoneblks.h"
 #include "toneblt.h" /* blkclipn */
 #include "hqmemset.h"
+#include "hqmemcpy.h"
 
 /* ---------------------------------------------------------------------- */
 
+/** Replicate halftone lines already generated by a block fill.
+
+    Halftone cells repeat vertically, so once a block fill has generated
+    \a period lines, every later line has the same pattern as the line
+    \a period lines above it. The whole words are copied a cache line at a
+    time by the platform's block copy, rather than being extracted and
+    shifted out of the halftone form again; only the partial words at the
+    ends of the line are merged.
+
+    \param bformptr  First word of the first line to replicate.
+    \param wupdate   Byte offset between output lines.
+    \param period    Vertical repeat of the halftone, in lines.
+    \param nlines    Number of lines to replicate.
+    \param nwords    Number of whole words between the first and last words.
+    \param firstmask Mask of the bits to set in the first word.
+    \param lastmask  Mask of the bits to set in the last word.
+*/
+static inline void blkreplicateh(blit_t *bformptr, int32 wupdate,
+                                 int32 period, dcoord nlines, int32 nwords,
+                                 blit_t firstmask, blit_t lastmask)
+{
+  int32 back = -period * wupdate ;
+
+  HQASSERT(period > 0, "Invalid halftone repeat") ;
+  HQASSERT(nlines > 0, "No halftone lines to replicate") ;
+  HQASSERT(nwords >= 0, "Invalid halftone replication width") ;
+
+  do {
+    register blit_t *srcptr = BLIT_ADDRESS(bformptr, back) ;
+
+    bformptr[0] = (bformptr[0] & ~firstmask) | (srcptr[0] & firstmask) ;
+    if ( nwords > 0 )
+      HqMemCpy(bformptr + 1, srcptr + 1, nwords * BLIT_WIDTH_BYTES) ;
+    bformptr[nwords + 1] = (bformptr[nwords + 1] & ~lastmask) |
+                           (srcptr[nwords + 1] & lastmask) ;
+    bformptr = BLIT_ADDRESS(bformptr, wupdate) ;
+  } while ( --nlines > 0 ) ;
+}
+
 static void blkfillhs(render_blit_t *rb, dcoord ys, dcoord ye,
                       register dcoord xs, register dcoord xe)
 {
@@ -129,6 +169,7 @@ static void blkfillhl(render_blit_t *rb,
   int32 halfydims = ht_params->ydims;
   dcoord xsbit, xebit; /* xs, xe in bits */
   dcoord ww, wr; /* width, remainder of width in words */
+  dcoord nrep ; /* lines replicated from earlier lines */
 
   HQASSERT(!HT_PARAMS_DEGENERATE(ht_params),
            "blkfillhl called with a degenerate screen");
@@ -205,6 +246,12 @@ static void blkfillhl(render_blit_t *rb,
   ww = xebit - xsbit;
   HQASSERT( ww >= 1, "Too few words in blkfillhl general case") ;
   wr = ww & 7; ww >>= 3; /* remainder and quotient by 8 */
+  /* Only generate the first vertical repeat of the cell. */
+  nrep = 0 ;
+  if ( ye >= halfydims ) {
+    nrep = ye - halfydims + 1 ;
+    ye = halfydims - 1 ;
+  }
   do {
     mask = (*halfptr++) ;
     shiftpword( mask , blshift , repeat ) ; /* Correct alignment of mask. */
@@ -235,6 +282,10 @@ static void blkfillhl(render_blit_t *rb,
       bypos = halfydims ;
     }
   } while ((--ye) >= 0 ) ;
+
+  if ( nrep > 0 )
+    blkreplicateh(bformptr, wupdate, halfydims, nrep, (ww << 3) + wr,
+                  firstmask, lastmask) ;
 }
 
 
@@ -251,6 +302,7 @@ static void blkfillho(render_blit_t *rb, dcoord ys, dcoord ye,
   int32 n ;
   dcoord bxpos1 , bypos1 ;
   dcoord bxpos2  ;
+  dcoord yr ; /* first line replicated from earlier lines */
   int32 blshift1, blshift2 ;
   int32 halfxdims = ht_params->xdims;
   int32 halfydims = ht_params->ydims;
@@ -343,6 +395,10 @@ static void blkfillho(render_blit_t *rb, dcoord ys, dcoord ye,
 /* General case. */
   n = (( xebit - xsbit ) >> BLIT_SHIFT_BITS ) + 1;
   ++eformptr ;
+  /* Only generate the first vertical repeat of the cell. */
+  yr = ys + ht_params->eydims ;
+  if ( yr > ye )
+    yr = ye + 1 ;
   do {
     register blit_t firstword = *bformptr & ~firstmask ;
     register blit_t lastword = *eformptr & ~lastmask ;
@@ -352,8 +408,11 @@ static void blkfillho(render_blit_t *rb, dcoord ys, dcoord ye,
     bformptr = BLIT_ADDRESS(bformptr, wupdate) ;
     eformptr = BLIT_ADDRESS(eformptr, wupdate);
     ++ys ;
-  } while ( ys <= ye ) ;
-  return ;
+  } while ( ys < yr ) ;
+
+  if ( ys <= ye )
+    blkreplicateh(bformptr, wupdate, ht_params->eydims, ye - ys + 1, n - 2,
+                  firstmask, lastmask) ;
 }
 
 static void blkfillhg(render_blit_t *rb, dcoord ys, dcoord ye,
@@ -367,6 +426,7 @@ static void blkfillhg(render_blit_t *rb, dcoord ys, dcoord ye,
   int32 n ;
   dcoord bxpos1 , bypos1 ;
   dcoord bxpos2 , bypos2 ;
+  dcoord yr ; /* first line replicated from earlier lines */
   int32 blshift1, blshift2 ;
   ht_params_t *htp = rb->p_ri->ht_params;
   int32 halfydims = htp->ydims;
@@ -488,6 +548,10 @@ static void blkfillhg(render_blit_t *rb, dcoord ys, dcoord ye,
 /* General case. */
   n = (( xebit - xsbit ) >> BLIT_SHIFT_BITS ) + 1;
   ++eformptr ;
+  /* Only generate the first vertical repeat of the cell. */
+  yr = ys + htp->eydims ;
+  if ( yr > ye )
+    yr = ye + 1 ;
   do {
     register blit_t firstword = *bformptr & ~firstmask ;
     register blit_t lastword = *eformptr & ~lastmask ;
@@ -497,8 +561,11 @@ static void blkfillhg(render_blit_t *rb, dcoord ys, dcoord ye,
     bformptr = BLIT_ADDRESS(bformptr, wupdate) ;
     eformptr = BLIT_ADDRESS(eformptr, wupdate);
     ++ys ;
-  } while ( ys <= ye ) ;
-  return ;
+  } while ( ys < yr ) ;
+
+  if ( ys <= ye )
+    blkreplicateh(bformptr, wupdate, htp->eydims, ye - ys + 1, n - 2,
+                  firstmask, lastmask) ;
 }
 
 static void blkfillhsg(render_blit_t *rb, dcoord ys, dcoord ye,
@@ -512,6 +579,7 @@ static void blkfillhsg(render_blit_t *rb, dcoord ys, dcoord ye,
   int32 n ;
   dcoord bxpos1 , bypos1 ;
   dcoord bxpos2 , bypos2 ;
+  dcoord yr ; /* first line replicated from earlier lines */
   int32 blshift1, blshift2 ;
   ht_params_t *htp = rb->p_ri->ht_params;
   int32 halfydims = htp->ydims;
@@ -619,6 +687,10 @@ static void blkfillhsg(render_blit_t *rb, dcoord ys, dcoord ye,
 /* General case. */
   n = (( xebit - xsbit ) >> BLIT_SHIFT_BITS ) + 1;
   ++eformptr ;
+  /* Only generate the first vertical repeat of the cell. */
+  yr = ys + htp->eydims ;
+  if ( yr > ye )
+    yr = ye + 1 ;
   do {
     register blit_t firstword = *bformptr & ~firstmask ;
     register blit_t lastword = *eformptr & ~lastmask ;
@@ -628,8 +700,11 @@ static void blkfillhsg(render_blit_t *rb, dcoord ys, dcoord ye,
     bformptr = BLIT_ADDRESS(bformptr, wupdate) ;
     eformptr = BLIT_ADDRESS(eformptr, wupdate);
     ++ys ;
-  } while ( ys <= ye ) ;
-  return ;
+  } while ( ys < yr ) ;
+
+  if ( ys <= ye )
+    blkreplicateh(bformptr, wupdate, htp->eydims, ye - ys + 1, n - 2,
+                  firstmask, lastmask) ;
 }
 
 
@@ -931,13 +931,61 @@ static Bool render_hdl(/*@notnull@*/ /*@in@*/ render_info_t*  p_ri,
                        Bool screened)
 {
   Bool ok ;
-  HDL *hdl = p_ri->lobj->dldata.hdl ;
+  HDL *hdl = p_ri->lobj->dldata.hdl, *replayOf ;
+  dcoord dx, dy ;
+  int32 bandheight ;
+  render_state_t rs ;
+  dbbox_t bbox ;
 
   UNUSED_PARAM(Bool, screened);
 
-  PROBE(SW_TRACE_RENDER_HDL, (intptr_t)hdl,
-        ok = hdlRender(hdl, p_ri,
+  if ( (replayOf = hdlReplayOf(hdl, &dx, &dy)) == NULL ) {
+    PROBE(SW_TRACE_RENDER_HDL, (intptr_t)hdl,
+          ok = hdlRender(hdl, p_ri,
+                         NULL /*transparency*/, FALSE /*self-intersect*/)) ;
+    return ok ;
+  }
+
+  /* A replay renders the objects of the HDL it replays offset by (dx,dy).
+     Set up a local render state with bounds, clip and band limits in the
+     replayed HDL's DL space, and let the separation position move the
+     output back to where the replay is. */
+  RS_COPY_FROM_RI(&rs, p_ri) ;
+
+  bbox_intersection(&rs.ri.bounds, &rs.ri.clip, &rs.ri.bounds) ;
+  hdlBBox(hdl, &bbox) ;
+  bbox_intersection(&rs.ri.bounds, &bbox, &rs.ri.bounds) ;
+  if ( bbox_is_empty(&rs.ri.bounds) )
+    return TRUE ;
+
+  bbox_offset(&rs.ri.bounds, -dx, -dy, &rs.ri.bounds) ;
+  rs.ri.clip = rs.ri.bounds ;
+  bbox_offset(&rs.cs.bandlimits, -dx, -dy, &rs.cs.bandlimits) ;
+  rs.ri.rb.x_sep_position += dx ;
+  rs.ri.rb.y_sep_position -= dy ;
+  rs.ri.x_dl_offset += dx ;
+  rs.ri.y_dl_offset += dy ;
+
+  /* The replayed objects are only in a single band of the replayed HDL if
+     the offset is a whole number of bands. Otherwise look at all of them. */
+  bandheight = rs.page->sizefactdisplayband ;
+  if ( rs.band != DL_LASTBAND ) {
+    if ( dy % bandheight == 0 )
+      rs.band -= dy / bandheight ;
+    else
+      rs.band = DL_LASTBAND ;
+  }
+
+  /* Bounds have changed, so we need a new clip context. */
+  if ( !clip_context_begin(&rs.ri) )
+    return FALSE ;
+
+  PROBE(SW_TRACE_RENDER_HDL, (intptr_t)replayOf,
+        ok = hdlRender(replayOf, &rs.ri,
                        NULL /*transparency*/, FALSE /*self-intersect*/)) ;
+
+  clip_context_end(&rs.ri) ;
+
   return ok ;
 }
 
@@ -38,6 +38,7 @@
 #include "spanlist.h"
 #include "render.h" /* rendering_prefers_bitmaps */
 #include "gu_htm.h"
+#include "converge.h" /* converge_C_globals */
 
 
 Bool rendering_prefers_bitmaps(DL_STATE *page)
@@ -166,6 +167,7 @@ static core_init_t render_init[] = {
   CORE_INIT_LOCAL("Render misc", render_misc_swinit, render_misc_swstart, NULL,
                   render_misc_finish),
   CORE_INIT("Band table", bandtable_C_globals),
+  CORE_INIT("Halftone tile rows", converge_C_globals),
 #if defined(BLIT_RLE_MONO) || defined(BLIT_RLE_COLOR)
   CORE_INIT("RLE resources", rleblt_C_globals),
 #endif
@@ -59,6 +59,83 @@
 
 static mm_pool_t mm_pool_rle ;
 
+#if defined(METRICS_BUILD)
+#include "metrics.h"
+#include "swenv.h" /* get_rtime */
+
+/** RLE generation throughput. Bands are rendered in parallel, so these are
+    updated atomically. Every byte is counted, but whole kilobytes are carried
+    out of \c bytes into \c kbytes to avoid overflow on long runs. */
+static struct rle_metrics {
+  hq_atomic_counter_t bands ;   /**< Bands of RLE generated. */
+  hq_atomic_counter_t kbytes ;  /**< Kilobytes of RLE carried out of bytes. */
+  hq_atomic_counter_t bytes ;   /**< Bytes of RLE not yet carried. */
+  hq_atomic_counter_t band_ms ; /**< Total time spent rendering RLE bands. */
+  hq_atomic_counter_t retries ; /**< Bands split because they overflowed. */
+} rle_metrics ;
+
+#define RLE_METRIC_ADD(field_, n_) MACRO_START \
+  hq_atomic_counter_t _was_ ; \
+  Bool _done_ ; \
+  do { \
+    _was_ = rle_metrics.field_ ; \
+    HqAtomicCAS(&rle_metrics.field_, _was_, _was_ + (n_), _done_) ; \
+  } while ( !_done_ ) ; \
+MACRO_END
+
+/** Count the bytes of RLE generated for a band, carrying whole kilobytes. */
+static void rle_metrics_add_bytes(size_t bytes)
+{
+  hq_atomic_counter_t was ;
+  Bool done ;
+
+  RLE_METRIC_ADD(bytes, CAST_SIZET_TO_INT32(bytes)) ;
+  do {
+    was = rle_metrics.bytes ;
+    if ( was < 1024 )
+      return ;
+    HqAtomicCAS(&rle_metrics.bytes, was, was & 1023, done) ;
+  } while ( !done ) ;
+  RLE_METRIC_ADD(kbytes, was >> 10) ;
+}
+
+static Bool rle_metrics_update(sw_metrics_group *metrics)
+{
+  double bytes = (double)rle_metrics.kbytes * 1024.0 + rle_metrics.bytes ;
+  int32 throughput = 0 ;
+
+  /* Bytes per millisecond of band rendering time is the rate a single band
+     is generated at; the aggregate rate scales with the number of bands
+     rendered simultaneously. */
+  if ( rle_metrics.band_ms > 0 )
+    throughput = (int32)(bytes / rle_metrics.band_ms) ;
+
+  if ( !sw_metrics_open_group(&metrics, METRIC_NAME_AND_LENGTH("RLE")) )
+    return FALSE ;
+  SW_METRIC_INTEGER("bands", rle_metrics.bands) ;
+  SW_METRIC_INTEGER("kbytes", rle_metrics.kbytes + (rle_metrics.bytes >> 10)) ;
+  SW_METRIC_INTEGER("band_ms", rle_metrics.band_ms) ;
+  SW_METRIC_INTEGER("band_retries", rle_metrics.retries) ;
+  SW_METRIC_INTEGER("bytes_per_ms_per_band", throughput) ;
+  sw_metrics_close_group(&metrics) ;
+
+  return TRUE ;
+}
+
+static void rle_metrics_reset(int reason)
+{
+  struct rle_metrics init = { 0 } ;
+  UNUSED_PARAM(int, reason) ;
+  rle_metrics = init ;
+}
+
+static sw_metrics_callbacks rle_metrics_hook = {
+  rle_metrics_update,
+  rle_metrics_reset,
+  NULL
+} ;
+#endif /* METRICS_BUILD */
+
 
 /** RUN_REPEAT repeat count disposition bits. */
 enum {
@@ -302,6 +379,7 @@ struct surface_sheet_t {
                                    from the page data's separation list is
                                    used for lifecycle management. */
   resource_pool_t *band_pool ; /**< The resource pool for the output band. */
+  Bool recycling ;             /**< Band extensions are being recycled. */
 
   OBJECT_NAME_MEMBER
 } ;
@@ -2034,6 +2112,10 @@ static Bool rle_sheet_begin(surface_handle_t *handle, sheet_data_t *sheet_data)
   rlesheet->band_pool =
     resource_requirement_get_pool(page->render_resources, TASK_RESOURCE_BAND_OUT) ;
   HQASSERT(rlesheet->band_pool != NULL, "No output band pool for RLE") ;
+  /* Bands that overflow their buffer can re-use extensions finished with by
+     earlier bands, instead of allocating and freeing a band buffer each
+     time. */
+  rlesheet->recycling = band_extensions_recycle(rlesheet->band_pool) ;
   NAME_OBJECT(rlesheet, RLE_SHEET_NAME) ;
 
   handle->sheet = rlesheet ;
@@ -2053,6 +2135,8 @@ static Bool rle_sheet_end(surface_handle_t handle, sheet_data_t *sheet_data,
   rlesheet = handle.sheet ;
   VERIFY_OBJECT(rlesheet, RLE_SHEET_NAME) ;
   rleColorantMapDestroy(&rlesheet->map) ;
+  if ( rlesheet->recycling )
+    band_extensions_purge(rlesheet->band_pool) ;
   resource_pool_release(&rlesheet->band_pool) ;
 
   rlepage = rlesheet->rlepage ;
@@ -2252,6 +2336,28 @@ static void rleStateInit(surface_band_t *tracker, DL_STATE *page,
   rleStateDefaultTransparency(state);
 }
 
+#if defined(METRICS_BUILD)
+/** Count the bytes of RLE blocks used by a band, including any extension
+    buffers. Extensions are pushed on the head of the band's list, so the
+    first extension is the one currently being filled. */
+static size_t rle_band_bytes(surface_band_t *tracker)
+{
+  band_t *pband = tracker->pband, *extra ;
+  size_t bytes ;
+
+  if ( (extra = pband->next) == NULL )
+    return CAST_SIGNED_TO_SIZET(tracker->next_free_block -
+                                (uint8 *)pband->mem) ;
+
+  bytes = CAST_SIGNED_TO_SIZET(tracker->next_free_block - (uint8 *)extra->mem) ;
+  bytes += CAST_SIGNED_TO_SIZET(pband->size_to_write) ;
+  for ( extra = extra->next ; extra != NULL ; extra = extra->next )
+    bytes += CAST_SIGNED_TO_SIZET(extra->size_to_write) ;
+
+  return bytes ;
+}
+#endif
+
 /** Band localiser for RLE. We use this function to initialise, then render,
     then finalise a band of RLE data. */
 static Bool rle_band_render(surface_handle_t *handle,
@@ -2269,6 +2375,9 @@ static Bool rle_band_render(surface_handle_t *handle,
   rle_separation_t *sepdata ;
   size_t repeat_mem ;
   uint16 repeat_id ;
+#if defined(METRICS_BUILD)
+  int32 start_ms = get_rtime() ;
+#endif
 
   HQASSERT(rs != NULL, "No render state") ;
   HQASSERT(callback != NULL, "No render band callback") ;
@@ -2477,6 +2586,17 @@ static Bool rle_band_render(surface_handle_t *handle,
     }
   }
 
+#if defined(METRICS_BUILD)
+  {
+    hq_atomic_counter_t before ;
+
+    HqAtomicIncrement(&rle_metrics.bands, before) ;
+    UNUSED_PARAM(hq_atomic_counter_t, before) ;
+    rle_metrics_add_bytes(rle_band_bytes(&rle_tracker)) ;
+    RLE_METRIC_ADD(band_ms, get_rtime() - start_ms) ;
+  }
+#endif
+
  cleanup:
   if ( rle_tracker.runAbort == RLE_GEN_RETRY ) {
     /* Signal retry with smaller band. */
@@ -2515,6 +2635,10 @@ static Bool rle_band_render(surface_handle_t *handle,
     /* Throw an error if we aborted but have no retry action to do. */
     if ( bandpass->action == SURFACE_PASS_DONE )
       result = error_handler(LIMITCHECK);
+#if defined(METRICS_BUILD)
+    else
+      RLE_METRIC_ADD(retries, 1) ;
+#endif
   } else if ( rle_tracker.runAbort == RLE_GEN_ERROR ) {
     result = FALSE;
   } else {
@@ -4129,6 +4253,11 @@ static void init_C_globals_rleblt(void)
   rle_page_allocated = 0 ;
   rle_sheet_allocated = 0 ;
 #endif
+
+#if defined(METRICS_BUILD)
+  rle_metrics_reset(SW_METRICS_RESET_BOOT) ;
+  sw_metrics_register(&rle_metrics_hook) ;
+#endif
 }
 
 static Bool rleblt_swinit(SWSTART *params)
@@ -18,6 +18,8 @@
 #include "spanlist.h"
 #include "render.h" /* render_blit_t */
 #include "hqmemcpy.h"
+#include "monitor.h"
+#include "swenv.h" /* get_rtime */
 
 /* The spanlist structure is put at the start of the area specified, with the
    spans immediately following. This arrangement makes it easy for clients to
@@ -175,41 +177,71 @@ Bool spanlist_insert(spanlist_t *spanlist, dcoord left, dcoord right)
   return (spanlist->lastspan < spanlist->spanlimit) ;
 }
 
+/* Count the leading (leftmost) zero bits of a blit word. A zero word has
+   BLIT_WIDTH_BITS leading zeros. */
+static inline int32 blit_leading_zeros(blit_t bits)
+{
+  if ( bits == 0 )
+    return BLIT_WIDTH_BITS ;
+#if defined(__GNUC__)
+#ifdef PLATFORM_IS_64BIT
+  return __builtin_clzll(bits) ;
+#else
+  return __builtin_clz(bits) ;
+#endif
+#else
+  {
+    int32 zeros = 0, shift ;
+
+    /* Binary search for the highest set bit. */
+    for ( shift = BLIT_WIDTH_BITS >> 1 ; shift > 0 ; shift >>= 1 ) {
+      if ( (bits >> (BLIT_WIDTH_BITS - shift)) == 0 ) {
+        zeros += shift ;
+        bits <<= shift ;
+      }
+    }
+    return zeros ;
+  }
+#endif
+}
+
+/* Count the set bits in a blit word. */
+static inline uint32 blit_population(blit_t bits)
+{
+#if defined(__GNUC__)
+#ifdef PLATFORM_IS_64BIT
+  return (uint32)__builtin_popcountll(bits) ;
+#else
+  return (uint32)__builtin_popcount(bits) ;
+#endif
+#else
+  const blit_t m1 = ALLONES / 3, m2 = ALLONES / 5, m4 = ALLONES / 17 ;
+
+  bits -= (bits >> 1) & m1 ;
+  bits = (bits & m2) + ((bits >> 2) & m2) ;
+  bits = (bits + (bits >> 4)) & m4 ;
+  return (uint32)((bits * (ALLONES / 255)) >> (BLIT_WIDTH_BITS - 8)) ;
+#endif
+}
+
 /* Determines the number of spans in the given bitmap without actually
-   inserting any spans. */
+   inserting any spans. A span starts at every set pixel whose left
+   neighbour is clear, so the spans in each word can be counted together. */
 uint32 spanlist_bitmap_spans(const blit_t *bitmap, dcoord w)
 {
-  Bool drawn = FALSE ;
-  dcoord right = 0 ;
+  blit_t previous = 0 ; /* Rightmost pixel of the previous word, in bit 0. */
   uint32 nspans = 0 ;
 
-  for ( ; right < w ; ++bitmap ) {
-    if ( right + BLIT_WIDTH_BITS < w && (*bitmap == 0 || *bitmap == ALLONES) ) {
-      /* do a whole blit_t in one go */
-      if ( *bitmap == ALLONES ) {
-        drawn = TRUE ;
-      } else {
-        if ( drawn )
-          ++nspans ;
-        drawn = FALSE ;
-      }
-      right += BLIT_WIDTH_BITS ;
-    } else {
-      /* do it bit-by-bit */
-      int32 bitshift ;
-      for ( bitshift = BLIT_MASK_BITS ; right < w && bitshift >= 0 ; ++right, --bitshift ) {
-        if ( ((*bitmap >> bitshift) & 0x1) != 0 ) {
-          drawn = TRUE ;
-        } else {
-          if ( drawn )
-            ++nspans ;
-          drawn = FALSE ;
-        }
-      }
-    }
+  for ( ; w > 0 ; ++bitmap, w -= BLIT_WIDTH_BITS ) {
+    blit_t bits = *bitmap ;
+
+    if ( w < BLIT_WIDTH_BITS ) /* Ignore padding in the last word. */
+      bits &= ~(ALLONES >> w) ;
+
+    nspans += blit_population(bits & ~((bits >> 1) |
+                                       (previous << BLIT_MASK_BITS))) ;
+    previous = bits & 1 ;
   }
-  if ( drawn )
-    ++nspans ;
 
   return nspans ;
 }
@@ -219,53 +251,58 @@ uint32 spanlist_bitmap_spans(const blit_t *bitmap, dcoord w)
    otherwise. */
 Bool spanlist_from_bitmap(spanlist_t *spanlist, const blit_t *bitmap, dcoord w)
 {
-  Bool drawn = FALSE, full = FALSE ;
+  Bool full = FALSE ;
   dcoord left = 0, right = 0 ;
+  /* All ones inside a span, all zeros between spans. Runs of the current
+     state are measured as leading zeros of the word XORed with this. */
+  blit_t state = 0 ;
 
   spanlist_assert_valid(spanlist) ;
 
-  for ( ; right < w ; ++bitmap ) {
-    if ( right + BLIT_WIDTH_BITS < w && (*bitmap == 0 || *bitmap == ALLONES) ) {
-      /* do a whole blit_t in one go */
-      if ( *bitmap == ALLONES ) {
-        if ( !drawn )
-          left = right ;
-        drawn = TRUE ;
-      } else {
-        if ( drawn ) {
-          if ( full )
-            return FALSE ; /* no room for this span */
-          if ( !spanlist_insert(spanlist, left, right - 1) )
-            full = TRUE ;
-        }
-        drawn = FALSE ;
-      }
+  while ( right < w ) {
+    blit_t bits = *bitmap++ ;
+    dcoord remaining ;
+
+    if ( bits == state ) {
+      /* The whole word continues the current span or gap. */
       right += BLIT_WIDTH_BITS ;
-    } else {
-      /* do it bit-by-bit */
-      int32 bitshift ;
-      for ( bitshift = BLIT_MASK_BITS ; right < w && bitshift >= 0 ; ++right, --bitshift ) {
-        if ( ((*bitmap >> bitshift) & 0x1) != 0 ) {
-          if ( !drawn )
-            left = right ;
-          drawn = TRUE ;
-        } else {
-          if ( drawn ) {
-            if ( full )
-              return FALSE ; /* no room for this span */
-            if ( !spanlist_insert(spanlist, left, right - 1) )
-              full = TRUE ;
-          }
-          drawn = FALSE ;
-        }
+      continue ;
+    }
+
+    remaining = w - right ;
+    if ( remaining > BLIT_WIDTH_BITS )
+      remaining = BLIT_WIDTH_BITS ;
+
+    for (;;) {
+      /* Bits shifted in at the right end never extend a span, and are beyond
+         the remaining pixels anyway. */
+      int32 run = blit_leading_zeros(bits ^ state) ;
+
+      if ( run >= remaining )
+        break ;
+
+      right += run ;
+      remaining -= run ;
+      bits <<= run ;
+
+      if ( state == 0 ) {
+        left = right ;
+      } else {
+        if ( full )
+          return FALSE ; /* no room for this span */
+        if ( !spanlist_insert(spanlist, left, right - 1) )
+          full = TRUE ;
       }
+      state = ~state ;
     }
+
+    right += remaining ;
   }
-  if ( drawn ) {
+
+  if ( state != 0 ) {
     if ( full )
       return FALSE ; /* no room for this span */
-    if ( !spanlist_insert(spanlist, left, right - 1) )
-      full = TRUE ;
+    (void)spanlist_insert(spanlist, left, w - 1) ;
   }
 
   return TRUE ;
@@ -640,6 +677,204 @@ void spanlist_assert_valid(spanlist_t *spanlist)
   }
 }
 
+/* The pixel-by-pixel bitmap span extraction that spanlist_bitmap_spans()
+   and spanlist_from_bitmap() replaced. These are kept to check the word
+   at a time versions against. */
+static uint32 spanlist_bitmap_spans_bitwise(const blit_t *bitmap, dcoord w)
+{
+  Bool drawn = FALSE ;
+  dcoord right = 0 ;
+  uint32 nspans = 0 ;
+
+  for ( ; right < w ; ++bitmap ) {
+    int32 bitshift ;
+    for ( bitshift = BLIT_MASK_BITS ; right < w && bitshift >= 0 ; ++right, --bitshift ) {
+      if ( ((*bitmap >> bitshift) & 0x1) != 0 ) {
+        drawn = TRUE ;
+      } else {
+        if ( drawn )
+          ++nspans ;
+        drawn = FALSE ;
+      }
+    }
+  }
+  if ( drawn )
+    ++nspans ;
+
+  return nspans ;
+}
+
+static Bool spanlist_from_bitmap_bitwise(spanlist_t *spanlist,
+                                         const blit_t *bitmap, dcoord w)
+{
+  Bool drawn = FALSE, full = FALSE ;
+  dcoord left = 0, right = 0 ;
+
+  for ( ; right < w ; ++bitmap ) {
+    int32 bitshift ;
+    for ( bitshift = BLIT_MASK_BITS ; right < w && bitshift >= 0 ; ++right, --bitshift ) {
+      if ( ((*bitmap >> bitshift) & 0x1) != 0 ) {
+        if ( !drawn )
+          left = right ;
+        drawn = TRUE ;
+      } else {
+        if ( drawn ) {
+          if ( full )
+            return FALSE ; /* no room for this span */
+          if ( !spanlist_insert(spanlist, left, right - 1) )
+            full = TRUE ;
+        }
+        drawn = FALSE ;
+      }
+    }
+  }
+  if ( drawn ) {
+    if ( full )
+      return FALSE ; /* no room for this span */
+    (void)spanlist_insert(spanlist, left, right - 1) ;
+  }
+
+  return TRUE ;
+}
+
+#define SPANLIST_BITMAP_TEST_WIDTH 1000 /* Pixels in largest test bitmap */
+#define SPANLIST_BITMAP_TEST_WORDS \
+  ((SPANLIST_BITMAP_TEST_WIDTH + BLIT_MASK_BITS) >> BLIT_SHIFT_BITS)
+#define SPANLIST_BITMAP_TEST_SIZE \
+  (sizeof(spanlist_t) + SPANLIST_BITMAP_TEST_WIDTH * sizeof(span_t))
+
+/* Fill a test bitmap with alternating runs of clear and set pixels. Runs
+   are up to maxrun pixels long, so long runs cover whole words and short
+   runs break words up. Padding after the last pixel is filled with noise,
+   which must be ignored. */
+static void spanlist_bitmap_fill(blit_t *bitmap, dcoord w, dcoord maxrun,
+                                 uint32 *seed)
+{
+  dcoord x = 0 ;
+  Bool drawn = FALSE ;
+  uint32 i ;
+
+  for ( i = 0 ; i < SPANLIST_BITMAP_TEST_WORDS ; ++i ) {
+    *seed = *seed * 1664525u + 1013904223u ;
+    bitmap[i] = ((blit_t)*seed << 16 << 16) ^ ((blit_t)*seed * 2654435761u) ;
+  }
+
+  while ( x < w ) {
+    dcoord run ;
+
+    *seed = *seed * 1664525u + 1013904223u ;
+    run = (dcoord)((*seed >> 8) % (uint32)maxrun) + 1 ;
+    if ( run > w - x )
+      run = w - x ;
+
+    for ( ; run > 0 ; --run, ++x ) {
+      blit_t mask = (blit_t)1 << (BLIT_MASK_BITS - (x & BLIT_MASK_BITS)) ;
+      if ( drawn )
+        bitmap[x >> BLIT_SHIFT_BITS] |= mask ;
+      else
+        bitmap[x >> BLIT_SHIFT_BITS] &= ~mask ;
+    }
+    drawn = !drawn ;
+  }
+}
+
+/* Check that the word at a time bitmap span extraction gives exactly the
+   same results as the pixel-by-pixel version, including when the spanlist
+   fills up. */
+static void spanlist_bitmap_unit_test(void)
+{
+  uintptr_t memory[SIZE_ALIGN_UP(SPANLIST_BITMAP_TEST_SIZE, sizeof(uintptr_t)) / sizeof(uintptr_t)] ;
+  uintptr_t memcheck[SIZE_ALIGN_UP(SPANLIST_BITMAP_TEST_SIZE, sizeof(uintptr_t)) / sizeof(uintptr_t)] ;
+  blit_t bitmap[SPANLIST_BITMAP_TEST_WORDS] ;
+  static const dcoord maxruns[] = { 1, 3, 17, 100, 400 } ;
+  uint32 seed = 1, i, j ;
+
+  for ( i = 0 ; i < 500 ; ++i ) {
+    dcoord w = (dcoord)(i * 7919u % SPANLIST_BITMAP_TEST_WIDTH) + 1 ;
+    dcoord maxrun = maxruns[i % NUM_ARRAY_ITEMS(maxruns)] ;
+    uint32 nspans, room ;
+    spanlist_t *spanlist, *spancheck ;
+    size_t size ;
+    Bool result ;
+
+    /* Every few tests use a bitmap with no spans at all, or only one. */
+    spanlist_bitmap_fill(bitmap, w, i % 11 == 0 ? w : maxrun, &seed) ;
+
+    nspans = spanlist_bitmap_spans(bitmap, w) ;
+    HQASSERT(nspans == spanlist_bitmap_spans_bitwise(bitmap, w),
+             "Bitmap span count does not match pixel-by-pixel count") ;
+
+    /* Alternate between spanlists that are large enough, exactly full, and
+       too small. */
+    room = nspans + 1 ;
+    if ( (i % 3) == 1 && nspans > 0 )
+      room = nspans ;
+    else if ( (i % 3) == 2 )
+      room = (nspans >> 1) + 1 ;
+    size = spanlist_size(room) ;
+
+    spanlist = spanlist_init(memory, size) ;
+    spancheck = spanlist_init(memcheck, size) ;
+    HQASSERT(spanlist != NULL && spancheck != NULL,
+             "Spanlist initialisation failed") ;
+
+    result = spanlist_from_bitmap(spanlist, bitmap, w) ;
+    HQASSERT(result == spanlist_from_bitmap_bitwise(spancheck, bitmap, w),
+             "Bitmap span extraction result does not match pixel-by-pixel") ;
+    HQASSERT(room < nspans || result,
+             "Bitmap span extraction failed with enough space") ;
+
+    spanlist_assert_valid(spanlist) ;
+    HQASSERT(spanlist_count(spanlist) == spanlist_count(spancheck),
+             "Bitmap span count does not match pixel-by-pixel spans") ;
+    for ( j = 1 ; j <= spanlist_count(spanlist) ; ++j ) {
+      HQASSERT(spanlist->spans[j].left == spancheck->spans[j].left &&
+               spanlist->spans[j].right == spancheck->spans[j].right,
+               "Bitmap spans do not match pixel-by-pixel spans") ;
+    }
+  }
+}
+
+/* Time the word at a time bitmap span extraction against the
+   pixel-by-pixel version, for bitmaps with short, medium and long runs.
+   Call interactively in the debugger. */
+void spanlist_bitmap_benchmark(uint32 repeat)
+{
+  uintptr_t memory[SIZE_ALIGN_UP(SPANLIST_BITMAP_TEST_SIZE, sizeof(uintptr_t)) / sizeof(uintptr_t)] ;
+  blit_t bitmap[SPANLIST_BITMAP_TEST_WORDS] ;
+  static const dcoord maxruns[] = { 4, 32, 512 } ;
+  uint32 seed = 1, i, j ;
+
+  for ( i = 0 ; i < NUM_ARRAY_ITEMS(maxruns) ; ++i ) {
+    int32 start, words, bitwise ;
+    uint32 nspans = 0 ;
+    spanlist_t *spanlist ;
+
+    spanlist_bitmap_fill(bitmap, SPANLIST_BITMAP_TEST_WIDTH, maxruns[i], &seed) ;
+
+    start = get_rtime() ;
+    for ( j = 0 ; j < repeat ; ++j ) {
+      nspans += spanlist_bitmap_spans(bitmap, SPANLIST_BITMAP_TEST_WIDTH) ;
+      spanlist = spanlist_init(memory, sizeof(memory)) ;
+      (void)spanlist_from_bitmap(spanlist, bitmap, SPANLIST_BITMAP_TEST_WIDTH) ;
+    }
+    words = get_rtime() - start ;
+
+    start = get_rtime() ;
+    for ( j = 0 ; j < repeat ; ++j ) {
+      nspans -= spanlist_bitmap_spans_bitwise(bitmap, SPANLIST_BITMAP_TEST_WIDTH) ;
+      spanlist = spanlist_init(memory, sizeof(memory)) ;
+      (void)spanlist_from_bitmap_bitwise(spanlist, bitmap, SPANLIST_BITMAP_TEST_WIDTH) ;
+    }
+    bitwise = get_rtime() - start ;
+
+    HQASSERT(nspans == 0, "Bitmap span counts do not match") ;
+    monitorf((uint8 *)"Spans from bitmap, runs up to %d: "
+             "word at a time %d ms, pixel-by-pixel %d ms\n",
+             maxruns[i], words, bitwise) ;
+  }
+}
+
 /* Unit test function for spanlists. Call interactively in the debugger. */
 #define SPANLIST_TEST_SPANS 5 /* Space for 5 spans */
 #define SPANLIST_TEST_SIZE (sizeof(spanlist_t) + SPANLIST_TEST_SPANS * sizeof(span_t))
@@ -845,6 +1080,8 @@ void spanlist_unit_test(void)
   HQASSERT(nspans == 1 &&
            mcoords[0] == 0 && mcoords[1] == 100,
            "Span list was not as expected after insertions and deletions") ;
+
+  spanlist_bitmap_unit_test() ;
 }
 #endif
 
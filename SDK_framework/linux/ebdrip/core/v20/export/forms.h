@@ -22,6 +22,12 @@ Bool in_execform(void);
 void preserve_execform(
   DL_STATE* page);
 
+/** Forget the display lists remembered for replaying forms, because the page
+    they are on is changing. The forms keep their cache slots. */
+void form_cache_reset(void);
+
+void init_formcache_debug(void);
+
 #endif /* protection for multiple inclusion */
 
 /* Log stripped */
@@ -37,6 +37,14 @@ Bool hdlOpen(/*@notnull@*/ /*@in@*/ DL_STATE* root,
 Bool hdlClose(/*@notnull@*/ /*@in@*/ HDL** hdlPointer,
               Bool success);
 void hdlDestroy(/*@notnull@*/ /*@in@*/ HDL** hdlPointer);
+HDL *hdlReserve(/*@notnull@*/ /*@in@*/ HDL *hdl);
+void hdlRelease(/*@notnull@*/ /*@in@*/ HDL **hdlPointer);
+Bool hdlReplay(/*@notnull@*/ /*@in@*/ DL_STATE *page,
+               /*@notnull@*/ /*@in@*/ HDL *hdl, dcoord dx, dcoord dy,
+               /*@notnull@*/ /*@out@*/ HDL **newHdl);
+HDL *hdlReplayOf(/*@notnull@*/ /*@in@*/ HDL *hdl,
+                 /*@notnull@*/ /*@out@*/ dcoord *dx,
+                 /*@notnull@*/ /*@out@*/ dcoord *dy);
 
 uint32 hdlId(/*@in@*/ /*@notnull@*/ /*@observer@*/ HDL *hdl);
 
@@ -94,6 +102,10 @@ Bool hdlTransparent(HDL *hdl);
 
 Bool hdlPatterned(HDL *hdl);
 
+Bool hdlHasReplays(HDL *hdl);
+
+Bool hdlReplayed(HDL *hdl);
+
 #endif
 
 
@@ -150,6 +162,22 @@ client (for example - the HDL may be referenced by its parent in the HDL
 hierarchy). However, it should not generally be necessary to explicitly destroy
 HDLs referenced in such a way.
 
+--Shared HDLs--
+A closed HDL may be placed on its parent by more than one HDL listobject, when
+the same content is painted again in identical circumstances (see forms.c).
+Each extra listobject takes a reference with hdlReserve(), and listobjects give
+up their reference with hdlRelease(), which only destroys the HDL when the last
+one goes. Cleaning up after a partial paint likewise leaves the HDL's contents
+to the last listobject referring to it.
+
+The same content painted again at a position differing by a whole number of
+device pixels is placed with a replay HDL, made by hdlReplay(). A replay has no
+objects of its own; it holds a reference to the HDL it replays, and renders
+that HDL's contents offset by (dx, dy). DL walkers that depend on where objects
+are on the page must treat HDLs for which hdlHasReplays() is TRUE with care,
+because the bounding boxes of the replayed objects are only right for the
+original position.
+
 --Floating HDLs--
 A 'floating' HDL is one that is not actually added to the HDL hierarchy. This
 is useful when you have captured a set of objects that should not be directly
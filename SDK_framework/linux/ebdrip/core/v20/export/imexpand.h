@@ -134,6 +134,8 @@ Bool im_expandmerge(DL_STATE *page, IM_EXPAND *ime_src, IM_EXPAND *ime_dst) ;
 void *im_expand_decode_array(const IM_EXPAND *ime);
 Bool im_expandlutexists(IM_EXPAND *ime, int32 plane) ;
 int32 im_expandiplanes( IM_EXPAND *ime ) ;
+/** Number of planes the expander produces, and entries in im_getcis(). */
+int32 im_expandlplanes(const IM_EXPAND *ime) ;
 void  im_expandpresepread( IM_EXPAND *ime ,
                            Bool fSubtractive ,
                            float *buf ,
@@ -28,6 +28,8 @@ Bool im_fileoffset(IM_FILE_CTXT *imfile_ctxt, int16 falign,
 Bool im_fileseek(IM_FILES *ffile, int32 foffset);
 Bool im_fileread(IM_FILES *ffile, uint8 *fdata, int32 fbytes);
 Bool im_filewrite(IM_FILES *ffile, uint8 *fdata, int32 fbytes);
+Bool im_filepread(IM_FILES *ffile, int32 foffset, uint8 *fdata, int32 fbytes);
+Bool im_filepwrite(IM_FILES *ffile, int32 foffset, uint8 *fdata, int32 fbytes);
 Bool im_filecloseall(IM_FILE_CTXT *imfile_ctxt);
 
 #endif /* __IMFILE_H__ protection for multiple inclusion */
@@ -171,6 +171,7 @@ struct render_info_t {
   int32                 overrideColorType; /**< Default value is GSC_UNDEFINED. */
   Bool                  generate_object_map; /**< Generate an object map. */
   dbbox_t               bounds;            /**< Restriction for region rendered, in current DL space. */
+  dcoord                x_dl_offset, y_dl_offset; /**< Offset of current DL space in the page DL, for replayed HDLs. */
   struct ht_params_t   *ht_params;         /**< Halftone parameters. */
   group_tracker_t      *group_tracker ;    /**< Transparency group context. */
   const struct surface_t *surface ;        /**< Current surface. */
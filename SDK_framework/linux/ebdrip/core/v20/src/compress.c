@@ -22,8 +22,72 @@
 #include "render.h"
 #include "dlstate.h"
 #include "params.h"
+#include "mm.h"
+#include "swerrors.h"
+#include "objnamer.h"
+#include "swtrace.h"
+#include "timing.h"
+#include "hqatomic.h"
 
 #include "compress.h"
+#include "hqspin.h" /* Must be last include because of hqwindows.h */
+
+
+struct compress_device_t {
+  DEVICELIST *dev ;          /**< Connected %compress% device. */
+  compress_device_t *next ;  /**< Next idle instance in pool. */
+  DEVICELIST *pgbdev ;       /**< Pagebuffer device last set up for. */
+  int32 color_factor ;       /**< Color factor last set up for. */
+  int32 band_size ;          /**< Band size last set up for. */
+  OBJECT_NAME_MEMBER
+} ;
+
+#define COMPRESS_DEVICE_NAME "Compress device instance"
+
+#if defined(METRICS_BUILD)
+#include "metrics.h"
+
+static struct compress_metrics {
+  hq_atomic_counter_t created ;  /**< Instances connected. */
+  hq_atomic_counter_t reused ;   /**< Instances taken from a pool. */
+  hq_atomic_counter_t setups ;   /**< Parameter setups performed. */
+  hq_atomic_counter_t discarded ; /**< Instances freed after an error. */
+} compress_metrics ;
+
+#define COMPRESS_METRIC_INCREMENT(field_) MACRO_START \
+  hq_atomic_counter_t _before_ ; \
+  HqAtomicIncrement(&compress_metrics.field_, _before_) ; \
+  UNUSED_PARAM(hq_atomic_counter_t, _before_) ; \
+MACRO_END
+
+static Bool compress_metrics_update(sw_metrics_group *metrics)
+{
+  if ( !sw_metrics_open_group(&metrics, METRIC_NAME_AND_LENGTH("CompressBand")) )
+    return FALSE ;
+  SW_METRIC_INTEGER("devices_created", compress_metrics.created) ;
+  SW_METRIC_INTEGER("devices_reused", compress_metrics.reused) ;
+  SW_METRIC_INTEGER("device_setups", compress_metrics.setups) ;
+  SW_METRIC_INTEGER("devices_discarded", compress_metrics.discarded) ;
+  sw_metrics_close_group(&metrics) ;
+
+  return TRUE ;
+}
+
+static void compress_metrics_reset(int reason)
+{
+  struct compress_metrics init = { 0 } ;
+  UNUSED_PARAM(int, reason) ;
+  compress_metrics = init ;
+}
+
+static sw_metrics_callbacks compress_metrics_hook = {
+  compress_metrics_update,
+  compress_metrics_reset,
+  NULL
+} ;
+#else
+#define COMPRESS_METRIC_INCREMENT(field_) EMPTY_STATEMENT()
+#endif /* METRICS_BUILD */
 
 
 /* copy_pagebuff_param()
@@ -52,12 +116,13 @@ static void copy_pagebuff_param( DEVICELIST *s_compress_device,
 }
 
 
-/* open_compress_device
- * ====================
+/* setup_compress_device
+ * =====================
  *
- * Open a channel to the compression device.
+ * Set the parameters of the compression device for a pagebuffer device
+ * configuration. Internal function used by compress_device_acquire().
  */
-DEVICE_FILEDESCRIPTOR open_compress_device(
+static void setup_compress_device(
   DEVICELIST *s_compress_device, DEVICELIST *pgbdev, int32 color_factor,
   int32 pagebuffer_band_size )
 {
@@ -67,9 +132,7 @@ DEVICE_FILEDESCRIPTOR open_compress_device(
 
   static uint8 *pszScratchSize = (uint8 *) "ScratchSize";
 
-  if (s_compress_device == NULL) {
-    return -1;
-  }
+  HQASSERT(s_compress_device != NULL, "No compression device to set up") ;
 
   /* get MinBandCompressRatio */
   theDevParamName(param)    = (uint8 *)"MinBandCompressRatio";
@@ -77,7 +140,7 @@ DEVICE_FILEDESCRIPTOR open_compress_device(
   nResult = (*theIGetParam(pgbdev))( pgbdev, &param );
   HQASSERT(nResult == ParamAccepted, "Error getting MinBandCompressRatio");
   HQASSERT(theDevParamType(param) == ParamFloat,
-           "Type error in open_compress_device");
+           "Type error in setup_compress_device");
   minCompressRatio = theDevParamFloat(param);
   /* Send it to compression device. */
   nResult = (*theISetParam(s_compress_device))( s_compress_device, &param );
@@ -110,7 +173,20 @@ DEVICE_FILEDESCRIPTOR open_compress_device(
 
   nResult = (*theISetParam(s_compress_device))( s_compress_device, &param );
 
-  HQASSERT(nResult == ParamAccepted, "Error setting device parameter in open_compress_device");
+  HQASSERT(nResult == ParamAccepted, "Error setting device parameter in setup_compress_device");
+}
+
+
+/* open_compress_device
+ * ====================
+ *
+ * Open a channel to the compression device.
+ */
+DEVICE_FILEDESCRIPTOR open_compress_device( DEVICELIST *s_compress_device )
+{
+  if (s_compress_device == NULL) {
+    return -1;
+  }
 
   /* Open the device */
   return (*theIOpenFile(s_compress_device))(s_compress_device,
@@ -151,4 +227,165 @@ int32 compress_band( DEVICELIST *s_compress_device,
 }
 
 
+/* Dismount and free a %compress% device instance. */
+static Bool compress_device_free(compress_device_t **cmpdevp)
+{
+  compress_device_t *cmpdev ;
+  Bool result = TRUE ;
+
+  HQASSERT(cmpdevp != NULL, "Nowhere to find compress device instance") ;
+  cmpdev = *cmpdevp ;
+  VERIFY_OBJECT(cmpdev, COMPRESS_DEVICE_NAME) ;
+  *cmpdevp = NULL ;
+
+  if ( (*theIDevDismount(cmpdev->dev))(cmpdev->dev) == -1 )
+    result = device_error_handler(cmpdev->dev) ;
+  device_free(cmpdev->dev) ;
+
+  UNNAME_OBJECT(cmpdev) ;
+  mm_free(mm_pool_temp, cmpdev, sizeof(*cmpdev)) ;
+
+  return result ;
+}
+
+
+void compress_pool_init(compress_pool_t *pool)
+{
+  HQASSERT(pool != NULL, "No compress device pool to initialise") ;
+  pool->free = NULL ;
+}
+
+
+Bool compress_pool_finish(compress_pool_t *pool)
+{
+  Bool result = TRUE ;
+
+  HQASSERT(pool != NULL, "No compress device pool to finish") ;
+
+  while ( pool->free != NULL ) {
+    compress_device_t *cmpdev = pool->free ;
+    pool->free = cmpdev->next ;
+    if ( !compress_device_free(&cmpdev) )
+      result = FALSE ;
+  }
+
+  return result ;
+}
+
+
+compress_device_t *compress_device_acquire(compress_pool_t *pool,
+                                           DEVICELIST *pgbdev,
+                                           int32 color_factor,
+                                           int32 pagebuffer_band_size)
+{
+  compress_device_t *cmpdev, *idle, **prev ;
+
+  HQASSERT(pool != NULL, "No compress device pool") ;
+  HQASSERT(pgbdev != NULL, "No pagebuffer device for compression") ;
+
+  /* Prefer an idle instance already set up for this configuration, so we
+     don't have to set its parameters again. Failing that, take any idle
+     instance. */
+  spinlock_pointer(&pool->free, idle, 1) ;
+  for ( prev = &idle ; (cmpdev = *prev) != NULL ; prev = &cmpdev->next ) {
+    if ( cmpdev->pgbdev == pgbdev &&
+         cmpdev->color_factor == color_factor &&
+         cmpdev->band_size == pagebuffer_band_size )
+      break ;
+  }
+  if ( cmpdev == NULL )
+    prev = &idle ;
+  if ( (cmpdev = *prev) != NULL )
+    *prev = cmpdev->next ;
+  spinunlock_pointer(&pool->free, idle) ;
+
+  if ( cmpdev != NULL ) {
+    VERIFY_OBJECT(cmpdev, COMPRESS_DEVICE_NAME) ;
+    COMPRESS_METRIC_INCREMENT(reused) ;
+  } else {
+    /* Create a new instance of the %compress% device. */
+    if ( (cmpdev = mm_alloc(mm_pool_temp, sizeof(*cmpdev),
+                            MM_ALLOC_CLASS_COMPRESS_DEVICE)) == NULL ) {
+      (void)error_handler(VMERROR) ;
+      return NULL ;
+    }
+
+    if ( (cmpdev->dev = device_alloc(STRING_AND_LENGTH("compress"))) == NULL ) {
+      mm_free(mm_pool_temp, cmpdev, sizeof(*cmpdev)) ;
+      return NULL ;
+    }
+
+    if ( !device_connect(cmpdev->dev, COMPRESS_DEVICE_TYPE,
+                         (char *)cmpdev->dev->name, 0, TRUE) ) {
+      (void)device_error_handler(cmpdev->dev) ;
+      device_free(cmpdev->dev) ;
+      mm_free(mm_pool_temp, cmpdev, sizeof(*cmpdev)) ;
+      return NULL ;
+    }
+
+    cmpdev->next = NULL ;
+    cmpdev->pgbdev = NULL ;
+    cmpdev->color_factor = 0 ;
+    cmpdev->band_size = 0 ;
+    NAME_OBJECT(cmpdev, COMPRESS_DEVICE_NAME) ;
+    COMPRESS_METRIC_INCREMENT(created) ;
+  }
+
+  if ( cmpdev->pgbdev != pgbdev ||
+       cmpdev->color_factor != color_factor ||
+       cmpdev->band_size != pagebuffer_band_size ) {
+    PROBE(SW_TRACE_COMPRESS_BAND_SETUP, (intptr_t)cmpdev,
+          setup_compress_device(cmpdev->dev, pgbdev, color_factor,
+                                pagebuffer_band_size)) ;
+    cmpdev->pgbdev = pgbdev ;
+    cmpdev->color_factor = color_factor ;
+    cmpdev->band_size = pagebuffer_band_size ;
+    COMPRESS_METRIC_INCREMENT(setups) ;
+  }
+
+  return cmpdev ;
+}
+
+
+void compress_device_release(compress_pool_t *pool,
+                             compress_device_t **cmpdevp, Bool reuse)
+{
+  compress_device_t *cmpdev, *idle ;
+
+  HQASSERT(pool != NULL, "No compress device pool") ;
+  HQASSERT(cmpdevp != NULL, "Nowhere to find compress device instance") ;
+  cmpdev = *cmpdevp ;
+  VERIFY_OBJECT(cmpdev, COMPRESS_DEVICE_NAME) ;
+
+  if ( !reuse ) {
+    /* The error that made this instance unusable has already been
+       signalled; don't replace it with any dismount error. */
+    (void)compress_device_free(cmpdevp) ;
+    COMPRESS_METRIC_INCREMENT(discarded) ;
+    return ;
+  }
+
+  *cmpdevp = NULL ;
+  spinlock_pointer(&pool->free, idle, 1) ;
+  cmpdev->next = idle ;
+  spinunlock_pointer(&pool->free, cmpdev) ;
+}
+
+
+DEVICELIST *compress_device_list(compress_device_t *cmpdev)
+{
+  VERIFY_OBJECT(cmpdev, COMPRESS_DEVICE_NAME) ;
+  return cmpdev->dev ;
+}
+
+
+void compress_C_globals(void)
+{
+#if defined(METRICS_BUILD)
+  compress_metrics_reset(SW_METRICS_RESET_BOOT) ;
+  sw_metrics_register(&compress_metrics_hook) ;
+#endif
+}
+
+
 /* Log stripped */
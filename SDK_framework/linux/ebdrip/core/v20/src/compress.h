@@ -17,14 +17,52 @@
 #include "devices.h"
 
 
-/** Performs an 'OpenFile' on the %compress% device after having first set a
-    parameter indicating the band size (which it uses for allocating a
-    scratch buffer). Returns -1 if error, else return the file id required
-    for calls to close_compress_device() and compress_band().
+/** An instance of the %compress% device, connected and set up for a
+    particular pagebuffer configuration. */
+typedef struct compress_device_t compress_device_t ;
+
+/** A pool of %compress% device instances, shared by all of the band
+    compression tasks for a page. Instances are set up once and reused for
+    each band with the same configuration, rather than being allocated,
+    connected and dismounted for every band. */
+typedef struct compress_pool_t {
+  compress_device_t *free ; /**< Spinlocked list of idle instances. */
+} compress_pool_t ;
+
+/** Initialise an empty %compress% device pool. */
+void compress_pool_init(compress_pool_t *pool) ;
+
+/** Dismount and free all of the idle instances in a %compress% device
+    pool. All instances must have been released back to the pool before
+    calling this. Returns FALSE if any of the instances failed to dismount. */
+Bool compress_pool_finish(compress_pool_t *pool) ;
+
+/** Take an instance of the %compress% device from a pool, creating a new
+    one if there are no idle instances. The instance's parameters are set up
+    from the pagebuffer device, color factor, and band size (which it uses
+    for allocating a scratch buffer) if they differ from the last use of
+    the instance. Returns NULL if an instance could not be created, in which
+    case an error has been signalled. */
+compress_device_t *compress_device_acquire(compress_pool_t *pool,
+                                           DEVICELIST *pgbdev,
+                                           int32 color_factor,
+                                           int32 pagebuffer_band_size) ;
+
+/** Return an instance of the %compress% device to a pool. If \a reuse is
+    FALSE, the instance may be in an inconsistent state after an error, so
+    it is dismounted and freed instead of being kept for later bands. */
+void compress_device_release(compress_pool_t *pool,
+                             compress_device_t **cmpdevp, Bool reuse) ;
+
+/** The device list of a %compress% device instance. */
+DEVICELIST *compress_device_list(compress_device_t *cmpdev) ;
+
+/** Performs an 'OpenFile' on the %compress% device. The device's parameters
+    must have been set up by compress_device_acquire(). Returns -1 if error,
+    else return the file id required for calls to close_compress_device()
+    and compress_band().
  */
-DEVICE_FILEDESCRIPTOR open_compress_device(
-  DEVICELIST *cmpdev, DEVICELIST *pgbdev, int32 color_factor,
-  int32 pagebuffer_band_size );
+DEVICE_FILEDESCRIPTOR open_compress_device(DEVICELIST *cmpdev) ;
 
 /** Closes the channel to the %compress% device.
  */
@@ -38,6 +76,9 @@ void close_compress_device( DEVICELIST *cmpdev, DEVICE_FILEDESCRIPTOR file_id );
  */
 int32 compress_band( DEVICELIST *cmpdev, DEVICE_FILEDESCRIPTOR file_id, uint8* pbBand, int32 cb );
 
+/** Initialise the C globals for the %compress% device interface. */
+void compress_C_globals(void) ;
+
 #endif  /* Protect against multiple inclusion */
 
 
@@ -111,6 +111,7 @@
 #include "preconvert.h" /* preconvert_on_the_fly */
 
 #include "monitori.h"  /* MON_TYPE_* for now */
+#include "rainstorm.h" /* rainstorm_unit_test */
 
 
 uint8 dl_currentexflags;
@@ -1541,6 +1542,7 @@ static Bool dl_changing_page(DL_STATE *page, dl_erase_t erase_type)
 
     /* Clear everything in all gstates (as of 18th March 2011 only gstags) */
     clear_gstate_dlpointers() ;
+    form_cache_reset() ;
 
     /** \todo ajcd 2011-03-24: Can these be moved before the groupClose()
         above, into the DL_ERASE_ALL case?
@@ -1560,6 +1562,7 @@ static Bool dl_changing_page(DL_STATE *page, dl_erase_t erase_type)
   case DL_ERASE_PRESERVE: /* partial paint keeping DL pools. */
     /* Clear everything in all gstates (as of 18th March 2011 only gstags) */
     clear_gstate_dlpointers() ;
+    form_cache_reset() ;
 
     /*@fallthrough@*/
   case DL_ERASE_COPYPAGE: /* LL2 copypage and continue with same DL. */
@@ -3912,6 +3915,7 @@ static Bool dl_misc_swstart(struct SWSTART *params)
 #endif
 
   clear_track_dl();
+  rainstorm_unit_test() ;
 
   return TRUE ;
 }
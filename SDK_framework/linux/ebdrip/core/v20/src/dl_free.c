@@ -258,8 +258,8 @@ static void free_dl_hdl(LISTOBJECT* killMe, DL_STATE *page)
 {
   HQASSERT(killMe != NULL, "free_dl_hdl - 'killMe' cannot be NULL");
 
-  /* Destroy HDL if it exists */
-  hdlDestroy(&killMe->dldata.hdl);
+  /* Release HDL if it exists; it may be shared by replayed forms. */
+  hdlRelease(&killMe->dldata.hdl);
 
   free_listobject(killMe, page);
 }
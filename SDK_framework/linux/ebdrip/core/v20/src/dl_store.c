@@ -1246,9 +1246,16 @@ void hdlStorePreserveChildren(DlSSEntry *entry, DlSSSet *stores)
 {
   DLREF *dl;
 
+  HDL *replayOf;
+  dcoord dx, dy;
+
   HQASSERT(entry != NULL, "Missing entry");
   HQASSERT(stores != NULL, "No DL stores");
 
+  /* A replay's contents are those of the HDL it replays. */
+  if ( (replayOf = hdlReplayOf((HDL*)entry, &dx, &dy)) != NULL )
+    dlSSPreserve(stores->hdl, hdlStoreEntry(replayOf), TRUE);
+
   for ( dl = hdlOrderList((HDL*)entry); dl != NULL; dl = dlref_next(dl) ) {
     LISTOBJECT *lobj = dlref_lobj(dl);
 
@@ -30,6 +30,7 @@
 #include "routedev.h"
 #include "dl_bbox.h"
 #include "dl_free.h"
+#include "dl_foral.h"
 
 #include "dicthash.h"
 #include "gstack.h"
@@ -51,6 +52,13 @@
 #include "forms.h"
 #include "vndetect.h"
 #include "dl_store.h"
+#include "dl_purge.h"
+#include "rcbcntrl.h"
+#include "gs_color.h"
+#include "mm.h"
+#include "ripdebug.h"
+#include "monitor.h"
+#include "metrics.h"
 
 
 /* Keep track of the innermost form HDL under construction, and preserve it and
@@ -78,6 +86,480 @@ void preserve_execform(DL_STATE* page)
 }
 
 
+/* Forms painted again and again on a page, such as the backgrounds, logos
+   and step-and-repeat tiles of variable data and imposed jobs, make the same
+   display list each time apart from its position. The DL a PDF form makes is
+   kept in its HDL, so a later invocation in the same circumstances adds a
+   listobject which renders that HDL again rather than interpreting the
+   content stream again. At the same position the listobject refers to the
+   HDL itself; at a position differing by a whole number of device pixels it
+   refers to a replay HDL (see hdlReplay()), which renders the HDL's objects
+   offset.
+
+   DL objects are in device coordinates, and are clipped by the clip in force
+   where they were made, so a form is only replayed at another position if
+   the clip is rectangular and leaves the form's BBox unclipped at both
+   positions. Forms containing images are not replayed elsewhere, because
+   image data is stored and released by the bands it covers, and nor are
+   forms containing transparency, overprints or patterns, whose effects
+   depend on the region map.
+
+   Forms are identified by their PDF execution context and object number, so
+   the cache slots and their usage survive from page to page. The HDLs
+   themselves belong to their page's DL, so each page has to interpret a form
+   once before it can be replayed. */
+
+#ifdef DEBUG_BUILD
+enum {
+  DEBUG_FORMCACHE_DISABLE = 1,
+  DEBUG_FORMCACHE_PRINT = 2
+} ;
+
+int32 debug_formcache = 0;
+
+/** Initialise form cache debug */
+void init_formcache_debug(void)
+{
+  register_ripvar(NAME_debug_formcache, OINTEGER, &debug_formcache);
+}
+# define FORMCACHE_DEBUG if ( debug_formcache & DEBUG_FORMCACHE_PRINT ) monitorf
+#else
+# define FORMCACHE_DEBUG if (FALSE) monitorf
+#endif
+
+#define FORM_CACHE_SIZE 16 /* Number of form DLs remembered. */
+#define FORM_DASH_MAX 8    /* Longest dash list a remembered form inherits. */
+
+/* A replay is placed at the nearest whole pixel if it is within this fraction
+   of a pixel, much as cached characters are placed. */
+#define FORM_OFFSET_EPSILON 0.001
+
+/** The parts of the gstate a form's DL depends on, apart from the color
+    state. */
+typedef struct FORM_STATE {
+  OMATRIX ctm ;              /**< Form space to device space. */
+  sbbox_t bbox ;             /**< Form BBox, in form space. */
+  int32 clipno ;             /**< Clip in force, CLIPID_INVALID for none. */
+  int32 clippagebaseid ;
+  dbbox_t clipbounds ;
+  Bool clipclear ;           /**< Clip is rectangular and misses the form. */
+  Bool degenerate ;          /**< degenerateClipping */
+  Bool optional ;            /**< optional_content_on */
+
+  USERVALUE linewidth, flatness, miterlimit, dashoffset ;
+  SYSTEMVALUE dashlist[FORM_DASH_MAX] ;
+  uint16 dashmode, dashlistlen ;
+  uint8 startlinecap, endlinecap, dashlinecap, linejoin ;
+
+  int32 devicebandid ;
+  int32 pagebaseid ;
+  USERVALUE smoothness ;
+  uint8 strokeadjust, scanconversion ;
+
+  int32 currfid ;
+  OMATRIX fontmatrix ;       /**< Font composite matrix. */
+  PDFFinfo pdffont ;
+  TranState tranState ;
+  int32 trapIntent ;
+} FORM_STATE ;
+
+typedef struct FORM_CACHE {
+  int32 contextid ;          /**< PDF context of the content stream. */
+  int32 objnum ;             /**< Object number of the content stream. */
+  FORM_STATE state ;         /**< The gstate the DL was made in. */
+  GS_COLORinfo *colorInfo ;  /**< Claim on the color state the DL was made in. */
+  uint32 parentid ;          /**< HDL the form's listobject was added to. */
+  uint32 hdlid ;             /**< The form's HDL, HDL_ID_INVALID if none. */
+  Bool replayable ;          /**< Can the HDL be replayed elsewhere? */
+  uint32 usage ;             /**< Times used, to choose which to replace. */
+} FORM_CACHE ;
+
+static FORM_CACHE form_cache[FORM_CACHE_SIZE] ;
+static uint32 form_cache_generation = 0 ; /* Incremented when DLs forgotten. */
+
+#ifdef METRICS_BUILD
+static struct formcache_metrics {
+  int32 cache_replayed;   /* Forms replayed from a remembered DL */
+  int32 cache_translated; /* Of which, replayed at another position */
+  int32 cache_missed;     /* Cacheable forms interpreted */
+  int32 cache_stored;     /* Form DLs remembered */
+  int32 cache_uncacheable;/* Forms which could not use the cache */
+} formcache_metrics;
+
+static void formcache_metrics_reset(int reason)
+{
+  struct formcache_metrics init = {0};
+  UNUSED_PARAM(int, reason);
+  formcache_metrics = init;
+}
+
+static Bool formcache_metrics_update(sw_metrics_group *metrics)
+{
+  int32 lookups = formcache_metrics.cache_replayed +
+                  formcache_metrics.cache_missed ;
+
+  if ( !sw_metrics_open_group(&metrics, METRIC_NAME_AND_LENGTH("Formcache")) )
+    return FALSE ;
+  SW_METRIC_INTEGER("cache_replayed", formcache_metrics.cache_replayed);
+  SW_METRIC_INTEGER("cache_translated", formcache_metrics.cache_translated);
+  SW_METRIC_INTEGER("cache_missed", formcache_metrics.cache_missed);
+  SW_METRIC_INTEGER("cache_stored", formcache_metrics.cache_stored);
+  SW_METRIC_INTEGER("cache_uncacheable", formcache_metrics.cache_uncacheable);
+  SW_METRIC_INTEGER("cache_hit_percent",
+                    lookups == 0 ? 0 :
+                    (int32)((100.0 * formcache_metrics.cache_replayed) / lookups));
+  sw_metrics_close_group(&metrics);
+  return TRUE ;
+}
+
+static sw_metrics_callbacks formcache_metrics_hook = {
+  formcache_metrics_update, formcache_metrics_reset, NULL
+};
+#define METRICS_INC(name, amount) formcache_metrics.name += amount
+#else /* !METRICS_BUILD */
+#define METRICS_INC(name, amount) /* nothing */
+#endif /* METRICS_BUILD */
+
+
+/** Forget a remembered form DL, but not which form the slot is for. The HDL
+    itself belongs to the DL. */
+static void form_cache_forget(FORM_CACHE *entry)
+{
+  if ( entry->colorInfo != NULL ) {
+    gsc_freecolorinfo(entry->colorInfo) ;
+    mm_free(mm_pool_temp, entry->colorInfo, gsc_colorInfoSize()) ;
+    entry->colorInfo = NULL ;
+  }
+  entry->hdlid = HDL_ID_INVALID ;
+}
+
+
+void form_cache_reset(void)
+{
+  int32 i ;
+
+  /* Halve the usage, so forms from finished jobs give up their slots. */
+  for ( i = 0 ; i < FORM_CACHE_SIZE ; ++i ) {
+    form_cache_forget(&form_cache[i]) ;
+    form_cache[i].usage >>= 1 ;
+  }
+  ++form_cache_generation ;
+}
+
+
+/** Can a form's DL be replayed or remembered? Only PDF content streams with
+    their own Resources are considered, because PostScript PaintProcs can have
+    side-effects other than marking the page, and are not identifiable. */
+static Bool form_cacheable(DL_STATE *page, OBJECT *paintproc,
+                           int32 *contextid, int32 *objnum)
+{
+#ifdef DEBUG_BUILD
+  if ( (debug_formcache & DEBUG_FORMCACHE_DISABLE) != 0 )
+    return FALSE ;
+#endif
+
+  if ( oType(*paintproc) != OFILE ||
+       !isIOpenFileFilter(paintproc, oFile(*paintproc)) ||
+       !pdf_stream_objnum(paintproc, objnum) ||
+       CURRENT_DEVICE() != DEVICE_BAND ||
+       isHDLTEnabled(*gstateptr) ||
+       gstateptr->theGSTAGinfo.structure != NULL ||
+       rcbn_enabled() || dlpurge_inuse() ||
+       page->currentHdl == NULL ||
+       theDashListLen(theLineStyle(*gstateptr)) > FORM_DASH_MAX )
+    return FALSE ;
+
+  *contextid = theIPDFContextID(oFile(*paintproc)) ;
+  return TRUE ;
+}
+
+
+/** Is the clip rectangular, and clear of the form's BBox (with a pixel to
+    spare for rounding)? The form's DL then does not depend on the clip, or on
+    where the form is. */
+static Bool form_clip_clear(CLIPPATH *clip, OMATRIX *ctm, sbbox_t *bbox)
+{
+  CLIPRECORD *rec ;
+  sbbox_t devbbox ;
+  dbbox_t formbounds ;
+
+  for ( rec = theClipRecord(*clip) ; rec != NULL ; rec = rec->next )
+    if ( (theClipType(*rec) & CLIPISRECT) == 0 )
+      return FALSE ;
+
+  bbox_transform(bbox, &devbbox, ctm) ;
+  if ( devbbox.x1 < -(SYSTEMVALUE)(MAXDCOORD / 2) ||
+       devbbox.y1 < -(SYSTEMVALUE)(MAXDCOORD / 2) ||
+       devbbox.x2 > (SYSTEMVALUE)(MAXDCOORD / 2) ||
+       devbbox.y2 > (SYSTEMVALUE)(MAXDCOORD / 2) )
+    return FALSE ;
+
+  bbox_store(&formbounds,
+             (dcoord)floor(devbbox.x1) - 1, (dcoord)floor(devbbox.y1) - 1,
+             (dcoord)ceil(devbbox.x2) + 1, (dcoord)ceil(devbbox.y2) + 1) ;
+  return bbox_contains(&clip->bounds, &formbounds) ;
+}
+
+
+/** Capture the parts of the current gstate a form's DL depends on. */
+static void form_state_get(FORM_STATE *state, OMATRIX *ctm, sbbox_t *bbox)
+{
+  CLIPPATH *clip = &thegsPageClip(*gstateptr) ;
+  LINESTYLE *style = &theLineStyle(*gstateptr) ;
+  uint16 i ;
+
+  state->ctm = *ctm ;
+  state->bbox = *bbox ;
+  state->clipno = theClipRecord(*clip) != NULL
+    ? theClipNo(*theClipRecord(*clip)) : CLIPID_INVALID ;
+  state->clippagebaseid = thegsPageBaseID(*clip) ;
+  state->clipbounds = clip->bounds ;
+  state->clipclear = form_clip_clear(clip, ctm, bbox) ;
+  state->degenerate = degenerateClipping ;
+  state->optional = optional_content_on ;
+
+  state->linewidth = theLineWidth(*style) ;
+  state->flatness = theFlatness(*style) ;
+  state->miterlimit = theMiterLimit(*style) ;
+  state->dashoffset = theDashOffset(*style) ;
+  state->dashmode = style->dashmode ;
+  state->dashlistlen = theDashListLen(*style) ;
+  HQASSERT(state->dashlistlen <= FORM_DASH_MAX, "Dash list too long to keep") ;
+  for ( i = 0 ; i < state->dashlistlen ; ++i )
+    state->dashlist[i] = theDashList(*style)[i] ;
+  state->startlinecap = theStartLineCap(*style) ;
+  state->endlinecap = theEndLineCap(*style) ;
+  state->dashlinecap = theDashLineCap(*style) ;
+  state->linejoin = theLineJoin(*style) ;
+
+  state->devicebandid = thegsDeviceBandId(*gstateptr) ;
+  state->pagebaseid = gstateptr->thePDEVinfo.pagebaseid ;
+  state->smoothness = thegsSmoothness(*gstateptr) ;
+  state->strokeadjust = thegsDeviceStrokeAdjust(*gstateptr) ;
+  state->scanconversion = gstateptr->thePDEVinfo.scanconversion ;
+
+  state->currfid = theCurrFid(theFontInfo(*gstateptr)) ;
+  state->fontmatrix = theFontCompositeMatrix(theFontInfo(*gstateptr)) ;
+  state->pdffont = thePDFFInfo(*gstateptr) ;
+  state->tranState = gstateptr->tranState ;
+  state->trapIntent = theTrapIntent(*gstateptr) ;
+}
+
+
+/** Are two captured gstates the same, apart from the translation of the
+    CTM and the clip? */
+static Bool form_state_same(FORM_STATE *s1, FORM_STATE *s2)
+{
+  uint16 i ;
+
+  if ( !MATRIX_REQ(&s1->ctm, &s2->ctm) ||
+       !bbox_equal(&s1->bbox, &s2->bbox) ||
+       s1->clippagebaseid != s2->clippagebaseid ||
+       s1->degenerate != s2->degenerate ||
+       s1->optional != s2->optional )
+    return FALSE ;
+
+  if ( s1->linewidth != s2->linewidth ||
+       s1->flatness != s2->flatness ||
+       s1->miterlimit != s2->miterlimit ||
+       s1->dashoffset != s2->dashoffset ||
+       s1->dashmode != s2->dashmode ||
+       s1->dashlistlen != s2->dashlistlen ||
+       s1->startlinecap != s2->startlinecap ||
+       s1->endlinecap != s2->endlinecap ||
+       s1->dashlinecap != s2->dashlinecap ||
+       s1->linejoin != s2->linejoin )
+    return FALSE ;
+  for ( i = 0 ; i < s1->dashlistlen ; ++i )
+    if ( s1->dashlist[i] != s2->dashlist[i] )
+      return FALSE ;
+
+  if ( s1->devicebandid != s2->devicebandid ||
+       s1->pagebaseid != s2->pagebaseid ||
+       s1->smoothness != s2->smoothness ||
+       s1->strokeadjust != s2->strokeadjust ||
+       s1->scanconversion != s2->scanconversion )
+    return FALSE ;
+
+  return (s1->currfid == s2->currfid &&
+          MATRIX_EQ(&s1->fontmatrix, &s2->fontmatrix) &&
+          s1->pdffont.Tc == s2->pdffont.Tc &&
+          s1->pdffont.Tfs == s2->pdffont.Tfs &&
+          s1->pdffont.TL == s2->pdffont.TL &&
+          s1->pdffont.Ts == s2->pdffont.Ts &&
+          s1->pdffont.Tw == s2->pdffont.Tw &&
+          s1->pdffont.Tz == s2->pdffont.Tz &&
+          s1->pdffont.Tr == s2->pdffont.Tr &&
+          OBJECTS_IDENTICAL(s1->pdffont.Tf, s2->pdffont.Tf) &&
+          s1->tranState.opaqueStroke == s2->tranState.opaqueStroke &&
+          s1->tranState.opaqueNonStroke == s2->tranState.opaqueNonStroke &&
+          s1->tranState.alphaIsShape == s2->tranState.alphaIsShape &&
+          s1->tranState.textKnockout == s2->tranState.textKnockout &&
+          s1->tranState.strokingAlpha == s2->tranState.strokingAlpha &&
+          s1->tranState.nonstrokingAlpha == s2->tranState.nonstrokingAlpha &&
+          s1->tranState.blendMode == s2->tranState.blendMode &&
+          s1->tranState.softMask.type == s2->tranState.softMask.type &&
+          s1->tranState.softMask.groupId == s2->tranState.softMask.groupId &&
+          s1->trapIntent == s2->trapIntent) ;
+}
+
+
+/** Find the whole device pixel offset of one CTM from another of the same
+    form. */
+static Bool form_offset(OMATRIX *from, OMATRIX *to, dcoord *dx, dcoord *dy)
+{
+  SYSTEMVALUE tx = to->matrix[2][0] - from->matrix[2][0] ;
+  SYSTEMVALUE ty = to->matrix[2][1] - from->matrix[2][1] ;
+  SYSTEMVALUE rx = floor(tx + 0.5), ry = floor(ty + 0.5) ;
+
+  if ( fabs(tx - rx) > FORM_OFFSET_EPSILON ||
+       fabs(ty - ry) > FORM_OFFSET_EPSILON ||
+       fabs(rx) > (SYSTEMVALUE)(MAXDCOORD / 2) ||
+       fabs(ry) > (SYSTEMVALUE)(MAXDCOORD / 2) )
+    return FALSE ;
+
+  *dx = (dcoord)rx ;
+  *dy = (dcoord)ry ;
+  return TRUE ;
+}
+
+
+/** dl_forall() callback stopping at images. */
+static Bool form_no_images(DL_FORALL_INFO *info)
+{
+  return info->lobj->opcode != RENDER_image ;
+}
+
+
+/** Can a form's HDL be replayed away from where it was made? Pattern cells
+    are replicated by offsetting their DLs already, so forms in them are not
+    replayed elsewhere. */
+static Bool form_replayable(DL_STATE *page, FORM_STATE *state, HDL *hdl)
+{
+  DL_FORALL_INFO info = {0} ;
+  HDL *parent ;
+
+  if ( !state->clipclear ||
+       hdlTransparent(hdl) || hdlOverprint(hdl) ||
+       hdlPatterned(hdl) || hdlRecombined(hdl) )
+    return FALSE ;
+
+  for ( parent = hdlParent(hdl) ; parent != NULL ; parent = hdlParent(parent) )
+    if ( hdlPurpose(parent) == HDL_PATTERN )
+      return FALSE ;
+
+  info.page = page ;
+  info.hdl = hdl ;
+  info.inflags = DL_FORALL_SHFILL|DL_FORALL_GROUP|DL_FORALL_NONE ;
+  return dl_forall(&info, form_no_images) ;
+}
+
+
+/** Find a remembered DL for a form invocation. If there is one, returns a
+    new reference to its HDL, or a replay of it, in hdl. Otherwise returns
+    the slot to remember the form's DL in if it was remembered before, or
+    NULL. */
+static Bool form_cache_lookup(DL_STATE *page, int32 contextid, int32 objnum,
+                              FORM_STATE *state, HDL **hdl,
+                              FORM_CACHE **slot)
+{
+  uint32 parentid = hdlId(page->currentHdl) ;
+  int32 i ;
+
+  *hdl = NULL ;
+  *slot = NULL ;
+
+  for ( i = 0 ; i < FORM_CACHE_SIZE ; ++i ) {
+    FORM_CACHE *entry = &form_cache[i] ;
+    HDL *cached ;
+    dcoord dx, dy ;
+
+    if ( entry->contextid != contextid || entry->objnum != objnum ||
+         !form_state_same(&entry->state, state) )
+      continue ;
+
+    if ( *slot == NULL )
+      *slot = entry ;
+
+    if ( entry->hdlid == HDL_ID_INVALID || entry->parentid != parentid ||
+         !gsc_sameColorInfo(entry->colorInfo, gstateptr->colorInfo) ||
+         !form_offset(&entry->state.ctm, &state->ctm, &dx, &dy) )
+      continue ;
+
+    /* At the same position, the clip must be the same or clear of the form
+       both times. Elsewhere, it must be clear both times. */
+    if ( dx == 0 && dy == 0 ) {
+      if ( !(entry->state.clipclear && state->clipclear) &&
+           (entry->state.clipno != state->clipno ||
+            !bbox_equal(&entry->state.clipbounds, &state->clipbounds)) )
+        continue ;
+    } else if ( !entry->replayable || !state->clipclear )
+      continue ;
+
+    cached = hdlStoreLookup(page->stores.hdl, entry->hdlid) ;
+    if ( cached == NULL ) {
+      /* The HDL's listobjects have all gone, so it has too. */
+      form_cache_forget(entry) ;
+      continue ;
+    }
+
+    if ( dx == 0 && dy == 0 )
+      *hdl = hdlReserve(cached) ;
+    else {
+      if ( !hdlReplay(page, cached, dx, dy, hdl) )
+        return FALSE ;
+      METRICS_INC(cache_translated, 1) ;
+    }
+
+    ++entry->usage ;
+    FORMCACHE_DEBUG((uint8 *)"Form cache: replayed HDL %u in slot %d at (%d,%d)\n",
+                    entry->hdlid, i, dx, dy) ;
+    return TRUE ;
+  }
+
+  return TRUE ;
+}
+
+
+/** Remember the DL a form invocation made, in the slot it had before or
+    replacing the least used entry. */
+static void form_cache_store(DL_STATE *page, int32 contextid, int32 objnum,
+                             FORM_STATE *state, HDL *hdl, FORM_CACHE *entry)
+{
+  GS_COLORinfo *colorInfo ;
+  int32 i ;
+
+  if ( entry == NULL ) {
+    entry = &form_cache[0] ;
+    for ( i = 1 ; i < FORM_CACHE_SIZE ; ++i ) {
+      if ( form_cache[i].usage < entry->usage )
+        entry = &form_cache[i] ;
+    }
+    entry->usage = 0 ;
+  }
+
+  /* Failing to remember the form is not an error. */
+  colorInfo = mm_alloc(mm_pool_temp, gsc_colorInfoSize(),
+                       MM_ALLOC_CLASS_GSTATE) ;
+  if ( colorInfo == NULL )
+    return ;
+
+  form_cache_forget(entry) ;
+  gsc_copycolorinfo(colorInfo, gstateptr->colorInfo) ;
+  entry->colorInfo = colorInfo ;
+  entry->contextid = contextid ;
+  entry->objnum = objnum ;
+  entry->state = *state ;
+  entry->parentid = hdlId(page->currentHdl) ;
+  entry->hdlid = hdlId(hdl) ;
+  entry->replayable = form_replayable(page, state, hdl) ;
+  ++entry->usage ;
+  METRICS_INC(cache_stored, 1) ;
+  FORMCACHE_DEBUG((uint8 *)"Form cache: stored HDL %u in slot %d\n",
+                  entry->hdlid, (int32)(entry - form_cache)) ;
+}
+
+
 /** Execute the given paintproc, storing the results in an HDL.
  *
  * An explicit newpath not needed since one is done by cliprectangles. */
@@ -261,6 +743,12 @@ Bool gs_execform( corecontext_t *context, STACK *stack )
   HDL *hdl = NULL ;
   int32 formId ;
   int32 saved_RecombineObject = userparams->RecombineObject;
+  OBJECT *paintproc ;
+  FORM_STATE state ;
+  FORM_CACHE *slot = NULL ;
+  int32 contextid = 0, objnum = 0 ;
+  Bool cacheable ;
+  uint32 generation = 0 ;
 
   static int32 form_uid = 0 ;
 
@@ -328,10 +816,31 @@ Bool gs_execform( corecontext_t *context, STACK *stack )
   userparams->RecombineObject = 0;
 #define return USE_goto_cleanup!
 
-  if ( !form_exec_paintproc( context, theo , formId ,
-                             formdictmatch[ form_PaintProc ].result ,
-                             & ctm , & bbox , & hdl ) )
-    goto cleanup ;
+  paintproc = formdictmatch[ form_PaintProc ].result ;
+
+  cacheable = form_cacheable(context->page, paintproc, &contextid, &objnum) ;
+  if ( cacheable ) {
+    generation = form_cache_generation ;
+    form_state_get(&state, &ctm, &bbox) ;
+    if ( !form_cache_lookup(context->page, contextid, objnum, &state,
+                            &hdl, &slot) )
+      goto cleanup ;
+  }
+
+  if ( hdl != NULL ) {
+    METRICS_INC(cache_replayed, 1) ;
+    cacheable = FALSE ; /* Already remembered. */
+  } else {
+    if ( cacheable ) {
+      METRICS_INC(cache_missed, 1) ;
+    } else {
+      METRICS_INC(cache_uncacheable, 1) ;
+    }
+
+    if ( !form_exec_paintproc( context, theo , formId , paintproc ,
+                               & ctm , & bbox , & hdl ) )
+      goto cleanup ;
+  }
 
   /** \todo call IDLOM_FORM(formId, ...) to cause callback for form object
       (NYI). */
@@ -342,11 +851,11 @@ Bool gs_execform( corecontext_t *context, STACK *stack )
     hdlBBox(hdl, &bbox);
 
     if ( bbox_is_empty(&bbox) )
-      hdlDestroy(&hdl);
+      hdlRelease(&hdl);
     else {
       LISTOBJECT *lobj;
       dl_color_t *dlc_current;
-      Bool setg_result;
+      Bool setg_result, added;
       int32 gid;
 
       if ( !gs_gpush(GST_FORM) )
@@ -382,10 +891,16 @@ Bool gs_execform( corecontext_t *context, STACK *stack )
       if ( hdlRecombined(hdl) )
         lobj->spflags |= RENDER_RECOMBINE;
 
-      if ( !add_listobject(context->page, lobj, NULL) ) {
+      if ( !add_listobject(context->page, lobj, &added) ) {
         free_listobject(lobj, context->page);
         goto cleanup;
       }
+
+      /* Remember the DL if the HDL is on the page, and nothing (a partial
+         paint, for instance) emptied the cache while the form was
+         interpreted. */
+      if ( added && cacheable && generation == form_cache_generation )
+        form_cache_store(context->page, contextid, objnum, &state, hdl, slot) ;
     }
   }
 
@@ -393,10 +908,27 @@ Bool gs_execform( corecontext_t *context, STACK *stack )
  cleanup:
   userparams->RecombineObject = saved_RecombineObject;
   if ( !result && hdl != NULL )
-    hdlDestroy(&hdl);
+    hdlRelease(&hdl);
 #undef return
   return result;
 }
 
+void init_C_globals_forms(void)
+{
+  FORM_CACHE zero = {0};
+  int32 i;
+
+  form_hdl = NULL;
+  for ( i = 0 ; i < FORM_CACHE_SIZE ; i++ )
+    form_cache[i] = zero;
+  form_cache_generation = 0;
+#ifdef METRICS_BUILD
+  sw_metrics_register(&formcache_metrics_hook);
+#endif
+#ifdef DEBUG_BUILD
+  debug_formcache = 0;
+#endif
+}
+
 /*
 Log stripped */
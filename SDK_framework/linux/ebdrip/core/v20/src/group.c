@@ -1342,8 +1342,9 @@ Bool groupEliminate(Group *group, TranAttrib *groupTA, Bool *eliminate)
      object and the group, attach it to the object, and eliminate the
      group.  However, if the object is patterned but its group has been
      eliminated, it can't be made transparent anymore.  Justification
-     for initialGroup: As above. */
-  if ( singleObj != NULL
+     for initialGroup: As above. Replays have no objects of their own to take
+     the transparency, so groups containing them must stay. */
+  if ( singleObj != NULL && !hdlHasReplays(group->hdl)
        && !(singleObj->objectstate->patternstate != NULL
             && singleObj->objectstate->patternstate->opcode == RENDER_hdl) ) {
     TranAttrib newTA;
@@ -1384,7 +1385,8 @@ Bool groupEliminate(Group *group, TranAttrib *groupTA, Bool *eliminate)
 #ifdef DEBUG_BUILD
        (backdrop_render_debug & BR_DISABLE_GROUP_ELIM_INTERSECT) == 0 &&
 #endif
-       !hdlTransparent(group->hdl) && !hdlOverprint(group->hdl) ) {
+       !hdlTransparent(group->hdl) && !hdlOverprint(group->hdl) &&
+       !hdlHasReplays(group->hdl) ) {
     STATEOBJECT *state = NULL;
     HDL *hdl = group->hdl;
 
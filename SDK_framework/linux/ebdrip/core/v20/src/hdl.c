@@ -156,6 +156,12 @@ struct HDL {
   Bool selfIntersect;      /**< Use self-intersection rendering? */
   int32 banding;           /**< What sort of banding is applied to this HDL */
   int purge_level;         /**< Level to which HDL has been purged */
+  uint32 refcount;         /**< Number of listobjects and replays referring to this */
+  HDL *replayOf;           /**< HDL whose objects this replays, or NULL */
+  uint32 replayOfId;       /**< Id of replayOf, to release it safely */
+  dcoord replayX, replayY; /**< Offset of this replay from replayOf */
+  Bool hasReplays;         /**< Does the HDL contain replays of other HDLs? */
+  Bool replayed;           /**< Is the HDL also rendered by replays? */
 
   dbbox_t bbox;            /**< Bounding box union of all objects in HDL */
   Range usedBands;         /**< Range of bands objects appear in */
@@ -423,6 +429,51 @@ static void hdlSetPatterned(HDL *hdl)
   }
 }
 
+/** Indicates HDL is, or contains, a replay of another HDL. */
+Bool hdlHasReplays(HDL *hdl)
+{
+  VERIFY_OBJECT(hdl, HDL_NAME);
+  return hdl->hasReplays;
+}
+
+/** Record that HDL is, or contains, a replay of another HDL. */
+static void hdlSetHasReplays(HDL *hdl)
+{
+  VERIFY_OBJECT(hdl, HDL_NAME);
+
+  if ( !hdl->hasReplays ) {
+    hdl->hasReplays = TRUE;
+
+    /* Propagate replay flag up the HDL hierarchy. */
+    if ( hdl->parent )
+      hdlSetHasReplays(hdl->parent);
+  }
+}
+
+/** Return the HDL a replay renders, and the offset it is rendered at, or NULL
+    if the HDL is not a replay. */
+HDL *hdlReplayOf(HDL *hdl, dcoord *dx, dcoord *dy)
+{
+  VERIFY_OBJECT(hdl, HDL_NAME);
+  HQASSERT(dx != NULL && dy != NULL, "Nowhere for replay offset");
+
+  *dx = hdl->replayX;
+  *dy = hdl->replayY;
+  return hdl->replayOf;
+}
+
+/** Are the objects in an HDL also rendered offset from their bboxes, by a
+    replay of it or of an HDL containing it? */
+Bool hdlReplayed(HDL *hdl)
+{
+  for ( ; hdl != NULL ; hdl = hdl->parent ) {
+    VERIFY_OBJECT(hdl, HDL_NAME);
+    if ( hdl->replayed )
+      return TRUE;
+  }
+  return FALSE;
+}
+
 /** Set HDL to use self-intersection rendering. */
 Bool hdlSetSelfIntersect(HDL *hdl)
 {
@@ -756,6 +807,9 @@ Bool hdlOpen(DL_STATE *page, Bool banded, int32 purpose, HDL **newHdl)
   hdl->recombined = FALSE;
   hdl->overprint = FALSE;
   hdl->patterned = FALSE;
+  hdl->hasReplays = FALSE;
+  hdl->replayed = FALSE;
+  hdl->replayOf = NULL;
   hdl->selfIntersect = FALSE;
   hdl->usedBands = rangeNew(0, 0); /* indicates no usage */
   bbox_clear(&hdl->bbox);
@@ -771,6 +825,7 @@ Bool hdlOpen(DL_STATE *page, Bool banded, int32 purpose, HDL **newHdl)
   else
     hdl->banding = BANDED_NEVER;
   hdl->purge_level = 0;
+  hdl->refcount = 1;
 
   NAME_OBJECT(hdl, HDL_NAME);
 
@@ -1154,6 +1209,17 @@ void hdlDestroy(HDL **hdlPointer)
   if ( hdl->storage.storage != NULL )
     hdlDestroyBandStorage(hdl);
 
+  /* A replay gives up its reference to the HDL it replays, unless that has
+     already gone from the store with the rest of the DL. */
+  if ( hdl->replayOf != NULL ) {
+    HDL *replayOf = hdlStoreLookup(hdl->page->stores.hdl, hdl->replayOfId);
+
+    if ( replayOf != NULL ) {
+      HQASSERT(replayOf == hdl->replayOf, "Replayed HDL id reused");
+      hdlRelease(&replayOf);
+    }
+  }
+
   dlc_release(hdl->page->dlc_context, &hdl->dlcMerged);
   (void)dlSSRemove(hdl->page->stores.hdl, &hdl->storeEntry);
   UNNAME_OBJECT(hdl);
@@ -1161,6 +1227,84 @@ void hdlDestroy(HDL **hdlPointer)
           MM_ALLOC_CLASS_HDL);
 }
 
+/**
+ * Add a reference to a closed HDL, so that another HDL listobject can place
+ * the same contents on the parent HDL again.
+ */
+HDL *hdlReserve(HDL *hdl)
+{
+  VERIFY_OBJECT(hdl, HDL_NAME);
+  HQASSERT(!hdl->open, "Only closed HDLs can be shared");
+  HQASSERT(hdl->refcount > 0, "HDL reference count uninitialised");
+
+  ++hdl->refcount;
+  return hdl;
+}
+
+/**
+ * Release an HDL listobject's reference to an HDL, destroying the HDL when
+ * the last reference goes.
+ */
+void hdlRelease(HDL **hdlPointer)
+{
+  HDL *hdl;
+
+  HQASSERT(hdlPointer != NULL, "hdlPointer cannot be NULL");
+  hdl = *hdlPointer;
+
+  if ( hdl == NULL )
+    return;
+
+  VERIFY_OBJECT(hdl, HDL_NAME);
+  HQASSERT(hdl->refcount > 0, "HDL reference count uninitialised");
+
+  if ( hdl->refcount > 1 ) {
+    --hdl->refcount;
+    *hdlPointer = NULL;
+  } else
+    hdlDestroy(hdlPointer);
+}
+
+/**
+ * Make an HDL on the current HDL which renders the contents of a closed HDL
+ * again, offset by a whole number of device pixels. The replay has no objects
+ * of its own, so it is not banded; it takes a reference to the HDL it replays,
+ * which lasts until the replay is destroyed.
+ */
+Bool hdlReplay(DL_STATE *page, HDL *hdl, dcoord dx, dcoord dy, HDL **newHdl)
+{
+  HDL *replay;
+
+  VERIFY_OBJECT(hdl, HDL_NAME);
+  HQASSERT(hdl->replayOf == NULL, "Replaying a replay");
+  HQASSERT(newHdl != NULL, "newHdl is null");
+  *newHdl = NULL;
+
+  if ( !hdlOpen(page, FALSE, hdl->purpose, &replay) )
+    return FALSE;
+
+  if ( !hdlClose(&replay, TRUE) )
+    return FALSE;
+
+  replay->replayOf = hdlReserve(hdl);
+  hdl->replayed = TRUE;
+  replay->replayOfId = hdl->id;
+  replay->replayX = dx;
+  replay->replayY = dy;
+  bbox_offset(&hdl->bbox, dx, dy, &replay->bbox);
+
+  dlc_release(page->dlc_context, &replay->dlcMerged);
+  if ( !dlc_copy(page->dlc_context, &replay->dlcMerged, &hdl->dlcMerged) ) {
+    dlc_get_none(page->dlc_context, &replay->dlcMerged);
+    hdlDestroy(&replay);
+    return FALSE;
+  }
+
+  hdlSetHasReplays(replay);
+  *newHdl = replay;
+  return TRUE;
+}
+
 /**
  * Add the passed DLREF to this HDL at the indicated index.
  * The link object may be singular, or may be the head of a linked list of
@@ -1544,6 +1688,27 @@ Bool hdlCleanupAfterPartialPaint(HDL **hdlPointer)
   VERIFY_OBJECT(hdl, HDL_NAME);
   HQASSERT(hdl->open || hdl->purpose != HDL_BASE, "Base HDL is never closed");
 
+  /* A shared HDL is cleaned up once, by the last listobject or replay
+     referring to it. The others can go straight away. */
+  if ( hdl->refcount > 1 ) {
+    --hdl->refcount;
+    *hdlPointer = NULL;
+    return TRUE;
+  }
+
+  /* A replay has no objects of its own, but cleans up its share of the HDL it
+     replays. If that survives, the replay must too. */
+  if ( hdl->replayOf != NULL ) {
+    HDL *replayOf = hdlStoreLookup(hdl->page->stores.hdl, hdl->replayOfId);
+
+    if ( replayOf != NULL ) {
+      HQASSERT(replayOf == hdl->replayOf, "Replayed HDL id reused");
+      if ( !hdlCleanupAfterPartialPaint(&replayOf) )
+        return FALSE;
+    }
+    hdl->replayOf = NULL;
+  }
+
   /* If this is an open HDL, preserve it. Otherwise delete it. We don't delete
      erase objects either, so the base HDL will not be completely removed,
      preserving the parent order of the HDL. */
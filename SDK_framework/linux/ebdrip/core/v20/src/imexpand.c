@@ -5109,6 +5109,13 @@ int32 im_expandiplanes( IM_EXPAND *ime )
   return ime->iplanes;
 }
 
+/* -------------------------------------------------------------------------- */
+int32 im_expandlplanes(const IM_EXPAND *ime)
+{
+  VERIFY_OBJECT(ime, IM_EXPAND_NAME);
+  return ime->lplanes;
+}
+
 /* -------------------------------------------------------------------------- */
 void im_expandpresepread( IM_EXPAND *ime ,
                           Bool fSubtractive ,
@@ -24,10 +24,12 @@
  *
  * There are two different usage patterns available.  Serial mode requires all
  * access to be single-threaded and any mutex locking requirement is handled by
- * the client.  Parallel mode allows multi-threaded reads (each thread has its
- * own file descriptor), but writes and other functions are still required to be
- * single threaded.  Parallel mode is used for image stores and serial for
- * backdrop.
+ * the client.  Parallel mode gives each thread its own file descriptor, so
+ * that each thread has its own file position.  Offsets are allocated
+ * atomically, and the positional calls im_filepread() and im_filepwrite()
+ * can be made from any number of threads at once without a lock, provided
+ * they do not touch the same range of the file at the same time.  Parallel
+ * mode is used for image stores and backdrop, and serial for the IRR store.
  *
  * \todo BMJ 02-Jun-11 : Change the API away from a file abstraction
  * (open/seek/read/write) to a more data-centric approach, to better
@@ -40,6 +42,7 @@
 
 #include "core.h"
 #include "coreinit.h"
+#include "hqatomic.h"           /* HqAtomicCAS */
 #include "devices.h"            /* device_error_handler */
 #include "mm.h"                 /* mm_alloc */
 #include "dlstate.h"            /* DL_STATE */
@@ -52,14 +55,14 @@
 
 struct IM_FILE_CTXT {
   uint32 id;              /**< For generating unique file names */
-  Bool parallel;          /**< parallel allows multi-threaded reads */
+  Bool parallel;          /**< parallel allows multi-threaded access */
   IM_FILES *head;         /**< A list of paged out data files */
-  uint32 count;           /**< The number of files */
+  hq_atomic_counter_t count; /**< The number of files */
 };
 
 struct IM_FILES {
   uint8 fname[32];
-  int32 fsize;
+  hq_atomic_counter_t fsize; /**< Bytes allocated, updated atomically. */
   int16 falign;
   uint8 writeable;
   uint8 parallel;
@@ -171,6 +174,8 @@ static Bool im_filecreate(IM_FILE_CTXT *imfile_ctxt,
   unsigned int i;
   IM_FILES *imf;
   unsigned int ii;
+  hq_atomic_counter_t count;
+  Bool swapped;
 
   HQASSERT(ffile != NULL, "ffile NULL");
   HQASSERT(im_tmpdev != NULL, "somehow didn't get im_tmpdev");
@@ -178,12 +183,15 @@ static Bool im_filecreate(IM_FILE_CTXT *imfile_ctxt,
   if ( (imf = im_filealloc(NUM_THREADS())) == NULL )
     return error_handler(VMERROR);
 
+  HqAtomicIncrement(&imfile_ctxt->count, count);
   swcopyf(imf->fname, (uint8 *)"P%X_%X.IMG",
-          imfile_ctxt->id, imfile_ctxt->count);
+          imfile_ctxt->id, (uint32)count);
   fdesc = (*theIOpenFile(im_tmpdev))(im_tmpdev, imf->fname,
                                      SW_RDWR|SW_CREAT|SW_TRUNC);
-  if ( fdesc < 0 )
+  if ( fdesc < 0 ) {
+    im_filefree(imf);
     return device_error_handler(im_tmpdev);
+  }
 
   imf->fsize = 0;
   imf->falign = falign;
@@ -197,9 +205,12 @@ static Bool im_filecreate(IM_FILE_CTXT *imfile_ctxt,
     if ( i != ii )
       imf->fdesc[i] = -1;
 
-  imf->next = imfile_ctxt->head;
-  imfile_ctxt->head = imf;
-  ++imfile_ctxt->count;
+  /* Another thread may be adding a file at the same time. Files are never
+     removed from the list until the context is destroyed. */
+  do {
+    imf->next = imfile_ctxt->head;
+    HqAtomicCASPointer(&imfile_ctxt->head, imf->next, imf, swapped, IM_FILES);
+  } while ( !swapped );
 
   (*ffile) = imf;
   return TRUE;
@@ -207,11 +218,32 @@ static Bool im_filecreate(IM_FILE_CTXT *imfile_ctxt,
 
 #define IM_MAXFILESIZE 0x7FFFFFFFu
 
+/**
+ * Atomically reserve the given number of bytes at the end of a file, unless
+ * that would make the file too large.
+ */
+static Bool im_filereserve(IM_FILES *imf, int32 tbytes, int32 *offset)
+{
+  hq_atomic_counter_t fsize;
+  Bool swapped;
+
+  do {
+    fsize = imf->fsize;
+    if ( (size_t)fsize + (size_t)tbytes >= IM_MAXFILESIZE )
+      return FALSE;
+    HqAtomicCAS(&imf->fsize, fsize, fsize + tbytes, swapped);
+  } while ( !swapped );
+
+  *offset = (int32)fsize;
+  return TRUE;
+}
+
 /**
  * Work out the file and offset where data of the given type, alignment, and
  * size will be stored. If the file does not yet exist, then lazily create it.
- * Not thread safe, and therefore it is up to the client to ensure thread
- * safety.
+ * In parallel mode this may be called from several threads at once, each
+ * being given a distinct range of a file. In serial mode it is up to the
+ * client to ensure thread safety.
  */
 Bool im_fileoffset(IM_FILE_CTXT *imfile_ctxt, int16 falign,
                    int32 tbytes, IM_FILES **ffile, int32 *offset)
@@ -224,28 +256,29 @@ Bool im_fileoffset(IM_FILE_CTXT *imfile_ctxt, int16 falign,
   HQASSERT(tbytes < IM_MAXFILESIZE, "tbytes >= IM_MAXFILESIZE");
 
   for ( imf = imfile_ctxt->head; imf != NULL; imf = imf->next ) {
-    unsigned int ii = im_index(imf);
-    size_t newsize = (size_t)imf->fsize + (size_t)tbytes;
-
-    if ( imf->fdesc[ii] >= 0 && imf->falign == falign &&
-         imf->writeable && newsize < IM_MAXFILESIZE )
+    if ( imf->falign == falign && imf->writeable &&
+         im_filereserve(imf, tbytes, offset) )
       break;
   }
 
-  if ( imf == NULL &&
-       !im_filecreate(imfile_ctxt, falign, &imf, imfile_ctxt->parallel) )
-    return FALSE;
-
-  *ffile  = imf;
-  *offset = imf->fsize;
-  imf->fsize += tbytes;
+  if ( imf == NULL ) {
+    if ( !im_filecreate(imfile_ctxt, falign, &imf, imfile_ctxt->parallel) )
+      return FALSE;
+    if ( !im_filereserve(imf, tbytes, offset) ) {
+      HQFAIL("New image file has no room");
+      return error_handler(LIMITCHECK);
+    }
+  }
 
+  *ffile = imf;
   return TRUE;
 }
 
 /**
- * Check to see if the this file was closed at the end of interpretation or
- * image adjustment, and if it was re-open it in read-only mode.
+ * Make sure this thread has a descriptor for the file. Files that were closed
+ * at the end of interpretation or image adjustment are re-opened in read-only
+ * mode. Files that are still being written are opened for reading and writing
+ * by each thread that needs them.
  */
 static Bool im_filevalidate(IM_FILES *ffile, unsigned int ii)
 {
@@ -256,13 +289,13 @@ static Bool im_filevalidate(IM_FILES *ffile, unsigned int ii)
   if ( ffile->fdesc[ii] < 0 ) {
     DEVICE_FILEDESCRIPTOR fd;
 
-    fd = (*theIOpenFile(im_tmpdev))(im_tmpdev, ffile->fname, SW_RDONLY);
+    fd = (*theIOpenFile(im_tmpdev))(im_tmpdev, ffile->fname,
+                                    ffile->writeable ? SW_RDWR : SW_RDONLY);
     if ( fd < 0 )
       return FAILURE(device_error_handler(im_tmpdev));
 
     ffile->fdesc[ii] = fd;
     ffile->fseek[ii] = 0;
-    ffile->writeable = FALSE;
   }
   HQASSERT(ffile->fdesc[ii] >= 0, "Failed to clone file");
   return TRUE;
@@ -321,8 +354,9 @@ Bool im_fileread(IM_FILES *ffile, uint8 *fdata, int32 fbytes)
 }
 
 /**
- * Write the given amount of image data out to the specified file.  Not thread
- * safe, and therefore it is up to the client to ensure thread safety.
+ * Write the given amount of image data out to the specified file.  Thread
+ * safe for writes to distinct ranges providing the 'parallel' option was
+ * enabled, otherwise it is up to the client to ensure thread safety.
  */
 Bool im_filewrite(IM_FILES *ffile, uint8 *fdata, int32 fbytes)
 {
@@ -343,6 +377,26 @@ Bool im_filewrite(IM_FILES *ffile, uint8 *fdata, int32 fbytes)
   return TRUE;
 }
 
+/**
+ * Read data from the given offset in the specified file. Each thread has its
+ * own file position in parallel mode, so reads from different threads do not
+ * need to be serialised.
+ */
+Bool im_filepread(IM_FILES *ffile, int32 foffset, uint8 *fdata, int32 fbytes)
+{
+  return im_fileseek(ffile, foffset) && im_fileread(ffile, fdata, fbytes);
+}
+
+/**
+ * Write data at the given offset in the specified file. In parallel mode,
+ * threads may write to different ranges allocated by im_fileoffset() at the
+ * same time.
+ */
+Bool im_filepwrite(IM_FILES *ffile, int32 foffset, uint8 *fdata, int32 fbytes)
+{
+  return im_fileseek(ffile, foffset) && im_filewrite(ffile, fdata, fbytes);
+}
+
 /**
  * Close all the file handles opened during interpretation or image adjustment
  * with read/write access.  Renderer threads reopen files with read only access.
@@ -360,22 +414,26 @@ Bool im_filecloseall(IM_FILE_CTXT *imfile_ctxt)
 
     HQASSERT(imf->fdesc, "Somehow lost fdesc array");
 
+    if ( !imf->writeable )
+      continue;
+
+    /* Several threads may have opened the file for writing. */
     for ( ii = 0; ii < imf->ndesc; ii++ ) {
-      if ( imf->fdesc[ii] >= 0 && imf->writeable ) {
+      if ( imf->fdesc[ii] >= 0 ) {
         if ( (*theICloseFile(im_tmpdev))(im_tmpdev, imf->fdesc[ii]) < 0 )
           result = device_error_handler(im_tmpdev) && result;
         imf->fdesc[ii] = -1;
-        imf->writeable = FALSE;
       }
     }
+    imf->writeable = FALSE;
   }
   return result;
 }
 
 /**
  * Create an imfile context to track all the files created for a particular
- * usage. imfile.c is not thread safe, except for multi-threaded reads when the
- * parallel flag is set.
+ * usage. imfile.c is not thread safe, except for offset allocation and
+ * positional reads and writes when the parallel flag is set.
  */
 Bool im_filecreatectxt(IM_FILE_CTXT **imfile_ctxt, Bool parallel)
 {
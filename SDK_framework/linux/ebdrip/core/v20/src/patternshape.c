@@ -236,6 +236,7 @@ static void render_state_patternshape(render_state_t *rs,
   rs->ri.fSoftMaskInPattern = FALSE ;
   rs->ri.overrideColorType = GSC_UNDEFINED ;
   rs->ri.bounds = rs->cs.bandlimits ;
+  rs->ri.x_dl_offset = rs->ri.y_dl_offset = 0 ;
   rs->ri.ht_params = NULL ;
   rs->ri.generate_object_map = FALSE;
   rs->ri.group_tracker = NULL ;
@@ -1434,6 +1434,11 @@ static Bool preconvert_callback(DL_FORALL_INFO *info)
   HQASSERT(transparency_strategy >= 1 && transparency_strategy <= 2,
            "Unexpected transparency_strategy value");
 
+  /* Objects in a replayed HDL are rendered away from their bboxes too, so
+     their bboxes are no more use for the region map than in a pattern. */
+  if ( hdlReplayed(info->hdl) )
+    insidepattern = TRUE;
+
   /* Preconvert the object if it only needs direct rendering now. */
   if ( preconvert_required(group, info->hdl, lobj, insidepattern,
                            transparency_strategy == 1) ) {
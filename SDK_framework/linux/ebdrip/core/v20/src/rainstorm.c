@@ -3,1945 +3,3341 @@
  *
  * $HopeName: SWv20!src:rainstorm.c(EBDSDK_P.1) $
  *
- * Copyright (C) 2008-2012 Global Graphics Software Ltd. All rights reserved.
+ * Copyright (C) 2008-2014 Global Graphics Software Ltd. All rights reserved.
  * Global Graphics Software Ltd. Confidential Information.
  *
  * \brief
- * Rainstorm prototype code
+ * Rainstorm page raster command stream.
  *
- * Rainstorm is a project to simplify and serialise the rip display list,
- * and transmit it in a compressed stream format to a printer which contains
- * a lightweight decoder.
- * Prototype code is needed to be able to iron out issues with the design
- * and implementation of the Rainstorm stream format and API.
+ * Rainstorm serialises the display list of a finished page as a compact,
+ * versioned stream of raster commands (see rainstorm.h for the format),
+ * which can be rendered band by band without the RIP's colour, clip, font
+ * and image machinery.
  *
- * This prototype code has been checked into the main rip source control
- * system for ease of development and testing, but is disabled and not
- * compiled by default. [ Could be made into a variant if I had the time to
- * wrestle with the jam build system ].
- * It has been developed and tested for windows builds only.
- * In order to use the code, comment in the define of RS_CODE_ENABLED below.
+ * The stream is a debugging aid, and is only written by debug builds. It is
+ * enabled by the PS fragment
+ *   << /Rainstorm 1 >> setsystemparams
+ * after which each page shown is written to the %os% device as
+ * "rainstorm-<job>-<page>.rs" before it is rendered. Failing to write a
+ * stream is reported, but does not fail the page.
  *
- * Again for ease of initial development, the stand-alone decoder code
- * is also included in this source file, and can be built independently via
+ * The display list is walked in z-order. Colours are defined once as device
+ * colorant values. Glyph forms, fills, quads and complex clips are scan
+ * converted once into span masks, and the samples of images and image masks
+ * are expanded once into image records. Erases, rectangles, glyphs, fills,
+ * images, image masks, the contents of vignettes and shaded fills, and
+ * the Gouraud triangles of shaded fills are emitted as commands, with their
+ * clip rectangle, complex clip masks, opacity and colours. Groups are
+ * emitted around their contents, with their opacity.
  *
- * cl /Zi /DBUILD_RSREAD=1 /Fersread.exe /Fdrsread.pdb /Forsread.obj rainstorm.c
+ * Blend modes, soft masks, knockout and isolated groups, and image alpha
+ * channels are not represented, so objects using them are painted as if
+ * they were normal. Patterned objects, backdrops, cells, recombine patches,
+ * and images which are colour converted on the fly or stored unconverted
+ * are counted and omitted, and the page is marked partial in the end
+ * record. A consumer must treat a partial page as incomplete and render the
+ * original display list instead.
  *
- * When this is done, Rainstorm is enabled by the PS fragment
- *   << /Rainstorm 1 >> setsystemparams
- * Then submit a job as usual, and a Rainstorm stream is created in the
- * top level folder, called "rip%d.rs".
- * An ascii listing of the contents of this can be created with the stand-alone
- * decoder using the command line
- *   rsread.exe -l rip0.rs
- * or it can be rendered to a windows BMP format via
- *   rsread.exe -c rip0.rs rip0.bmp
+ * The reader in this file validates a stream, rebuilds its display list of
+ * painting objects with their clips, opacities and colours, and renders
+ * that list into a raster of colorant values for any range of rows. The
+ * unit test checks that a stream using every command renders, as a whole
+ * page and band by band, to the same checksum as painting the commands
+ * directly. In assert builds every stream written is also read back and
+ * rendered band by band. The reader is also built into the stand-alone tool
+ * built with
  *
- * N.B. THIS IS PROTOTYPE CODE THAT WILL BE THROWN AWAY
- *      WHEN MAIN DEVELOPMENT STARTS !
+ *   cc -DBUILD_RSREAD=1 -o rsread rainstorm.c
  *
- * The code contains experimental algorithms not suitable for a final product,
- * very little error checking, and arbitrary fixed upper limits on some stages
- * of processing. At this stage, it is known to be able to deal with a limited
- * number of simple test cases.
+ * which lists a stream with "rsread -l in.rs", prints the checksum of its
+ * rendering with "rsread -c in.rs", and renders a preview with
+ * "rsread in.rs out.ppm".
  */
 
+#ifdef BUILD_RSREAD /* { */
 
-/* #define RS_CODE_ENABLED 1 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef int16_t  int16;
+typedef uint16_t uint16;
+typedef int32_t  int32;
+typedef uint32_t uint32;
+typedef int64_t  int64;
+typedef uint8_t  uint8;
+typedef int      Bool;
+#define TRUE 1
+#define FALSE 0
 
+#define HQASSERT(c_, m_) ((void)0)
+#define HqMemZero(p_, n_) memset((p_), 0, (n_))
+#define min(a_, b_) ((a_) < (b_) ? (a_) : (b_))
+#define max(a_, b_) ((a_) > (b_) ? (a_) : (b_))
+#define RS_ALLOC(n_) malloc(n_)
+#define RS_FREE(p_, n_) free(p_)
 
-#ifdef BUILD_RSREAD
-#define RS_CODE_ENABLED 0
-#endif
+#include "rainstorm.h"
 
-#if RS_CODE_ENABLED /* { */
+#else /* !BUILD_RSREAD } { */
 
 #include "core.h"
-#include "swerrors.h"
-#include "hqmemcpy.h"
-#include "mm.h"
-#include "mmcompat.h"
-#include "fonts.h"
-#include "fontcache.h"
-#include "namedef_.h"
-
-#include "display.h"
-#include "bitblts.h"
-#include "dl_store.h"
-#include "images.h"
-#include "imageo.h"
-#include "graphics.h"
-#include "dlstate.h"
-#include "params.h"
-#include "plotops.h"
-#include "dl_image.h"
-#include "ndisplay.h"
-#include "dl_bres.h"
-#include "gstate.h"
-#include "clipops.h"
-#include "control.h"
-#include "charblts.h"
-#include "dl_bbox.h"
-#include "dl_foral.h"
-#include "imstore.h"
-#include "routedev.h"
-#include "fcache.h"
-#include "pathops.h"
-#include "idlom.h"
-#include "toneblt.h"
-#include "trap.h"
-#include "dl_free.h"
-#include "vndetect.h"
-#include "dl_color.h"
-#include "gs_cache.h"
-#include "gschtone.h"
-#include "gschcms.h"
-#include "gscdevci.h"
-#include "gschead.h"
-#include "halftone.h"
-#include "color.h"
-#include "rcbcntrl.h"
-#include "recomb.h"
-#include "rcbcomp.h"
-#include "renderom.h"
-#include "gs_tag.h"
-#include "hdlPrivate.h"
-#include "groupPrivate.h"
-#include "cce.h"
-#include "patternshape.h"
-#include "ripmulti.h"
-#include "ripdebug.h"
-#include "debugging.h"
-#include "dl_shade.h"
+#include "swerrors.h"           /* VMERROR */
+#include "swdevice.h"           /* SW_WRONLY */
+#include "swcopyf.h"            /* swcopyf */
+#include "devices.h"            /* find_device */
+#include "monitor.h"            /* monitorf */
+#include "hqmemcpy.h"           /* HqMemCpy */
+#include "hqmemset.h"           /* HqMemZero */
+#include "hqmemcmp.h"           /* HqMemCmp */
+#include "mm.h"                 /* mm_alloc */
+#include "coreinit.h"           /* get_core_context */
+#include "context.h"            /* corecontext_t */
+#include "params.h"             /* SYSTEMPARAMS */
+#include "display.h"            /* LISTOBJECT */
+#include "dlstate.h"            /* DL_STATE */
+#include "dl_foral.h"           /* dl_forall */
+#include "dl_color.h"           /* dlc_from_dl_weak */
+#include "dl_purge.h"           /* load_dldata */
+#include "dl_bres.h"            /* quad_to_nfill */
+#include "ndisplay.h"           /* NFILLOBJECT */
+#include "bitblts.h"            /* invalid_block */
+#include "bitbltt.h"            /* FORM */
+#include "render.h"             /* render_state_mask */
+#include "surface.h"            /* invalid_surface */
+#include "scanconv.h"           /* scanconvert_band */
+#include "rlecache.h"           /* rlecache_line_read_init */
+#include "graphics.h"           /* CHARCACHE */
+#include "group.h"              /* groupHdl */
+#include "hdl.h"                /* hdlReplayOf */
+#include "shadex.h"             /* GOURAUDOBJECT */
+#include "imageo.h"             /* IMAGEOBJECT */
+#include "imexpand.h"           /* im_expandread */
 #include "rainstorm.h"
 
-#define _CRT_SECURE_NO_DEPRECATE 1
-#include <stdio.h>
+#define RS_ALLOC(n_) mm_alloc(mm_pool_temp, (n_), MM_ALLOC_CLASS_RAINSTORM)
+#define RS_FREE(p_, n_) mm_free(mm_pool_temp, (p_), (n_))
 
-typedef struct RS_RGB
-{
-  unsigned char r, g, b;
-} RS_RGB;
+#endif /* !BUILD_RSREAD } */
+
+/** Largest value of the Adler-32 checksum moduli. */
+#define RS_ADLER_BASE 65521u
 
-typedef struct RS_COORD
+/** Number of bytes which can be summed before the Adler-32 sums must be
+    reduced. */
+#define RS_ADLER_NMAX 5552
+
+/** Id returned when a colour, mask or image has not been defined. */
+#define RS_NO_ID 0xffffffffu
+
+/**
+ * Update an Adler-32 checksum with some data.
+ */
+static uint32 rs_adler32(uint32 adler, const uint8 *buf, size_t len)
 {
-  int32 x,y;
-} RS_COORD;
+  uint32 s1 = adler & 0xffff, s2 = adler >> 16;
+
+  while ( len > 0 ) {
+    size_t n = len < RS_ADLER_NMAX ? len : RS_ADLER_NMAX;
+
+    len -= n;
+    while ( n-- > 0 ) {
+      s1 += *buf++;
+      s2 += s1;
+    }
+    s1 %= RS_ADLER_BASE;
+    s2 %= RS_ADLER_BASE;
+  }
+
+  return (s2 << 16) | s1;
+}
 
-typedef struct RSS /* Rainstorm state */
+/* ========================================================================== */
+#ifndef BUILD_RSREAD /* { Stream writer */
+
+/** A growable byte buffer. Allocation failure is sticky, and is checked
+    when the buffer's contents are used. */
+typedef struct RS_BUFFER {
+  uint8 *data ;   /**< Buffer memory. */
+  int32 size ;    /**< Number of bytes used. */
+  int32 max ;     /**< Number of bytes allocated. */
+  Bool failed ;   /**< An allocation failed; the contents are incomplete. */
+} RS_BUFFER ;
+
+/** Map from the address of a display list colour, form, object or clip to
+    its id in the stream. Open addressed, with a power of two size. */
+typedef struct RS_IDMAP {
+  const void **keys ;
+  uint32 *ids ;
+  uint32 size ;   /**< Number of slots. */
+  uint32 count ;  /**< Number of keys present, which is also the next id. */
+} RS_IDMAP ;
+
+/** Destination of the stream bytes. */
+typedef Bool (*rs_sink_fn)(void *data, uint8 *buf, int32 len) ;
+
+/** Rainstorm stream writer state. */
+typedef struct RS_WRITER {
+  rs_sink_fn sink ;       /**< Where the stream goes. */
+  void *sinkdata ;        /**< Data for the sink function. */
+  uint32 adler ;          /**< Checksum of the stream so far. */
+  RS_BUFFER ops ;         /**< Commands of the objects record being built. */
+  RS_BUFFER def ;         /**< Payload of a definition record. */
+  RS_BUFFER pairs ;       /**< Spans of the mask row being encoded. */
+  RS_BUFFER row ;         /**< Encoding of the mask row being encoded. */
+  RS_BUFFER prev ;        /**< Encoding of the previous mask row block. */
+  RS_BUFFER spans ;       /**< Spans of the scanline being scan converted. */
+  RS_IDMAP colors ;       /**< Colours defined so far. */
+  RS_IDMAP masks ;        /**< Masks defined so far. */
+  RS_IDMAP images ;       /**< Images defined so far. */
+  uint32 color ;          /**< Colour id last selected. */
+  dbbox_t clip ;          /**< Clip rectangle last set. */
+  Bool clipset ;          /**< Whether the clip has been set. */
+  const void *clipmasks ; /**< Clip whose complex clip masks were last set. */
+  uint32 nclipmasks ;     /**< Number of clip masks last set. */
+  uint32 alpha ;          /**< Opacity last set. */
+  uint32 depth ;          /**< Number of groups being written. */
+  uint32 nobjects ;       /**< Number of objects written. */
+  uint32 nomitted ;       /**< Number of objects which couldn't be written. */
+  Bool ok ;               /**< No error has occurred. */
+} RS_WRITER ;
+
+/** Objects records are emitted when their commands reach this size, to
+    bound the writer's memory use. */
+#define RS_OPS_CHUNK (64 * 1024)
+
+/** Largest number of sample bytes written for an image. */
+#define RS_MAX_IMAGE_BYTES 0x7fff0000
+
+/**
+ * Make space for at least n more bytes in a buffer.
+ */
+static Bool rs_buffer_reserve(RS_BUFFER *buf, int32 n)
 {
-  RS_RGB color[256];
-  uint8 colori, freei;
-  struct
-  {
-    Bool cached;
-    CHARCACHE *cc;
-    int32 rlesize;
-    void *name;
-  } ccache[256];
-} RSS;
+  uint8 *data ;
+  int32 max ;
+
+  if ( buf->failed )
+    return FALSE ;
+  if ( buf->size + n <= buf->max )
+    return TRUE ;
+
+  for ( max = buf->max > 0 ? buf->max * 2 : 256 ; max < buf->size + n ; max *= 2 )
+    EMPTY_STATEMENT() ;
+
+  if ( (data = RS_ALLOC(max)) == NULL ) {
+    buf->failed = TRUE ;
+    return FALSE ;
+  }
+  if ( buf->data != NULL ) {
+    HqMemCpy(data, buf->data, buf->size) ;
+    RS_FREE(buf->data, buf->max) ;
+  }
+  buf->data = data ;
+  buf->max = max ;
+  return TRUE ;
+}
 
-static void rs_bandinit(RSS *rss)
+static void rs_buffer_free(RS_BUFFER *buf)
 {
-  rss->color[0].r = rss->color[0].g = rss->color[0].b = 0;
-  rss->color[1].r = rss->color[1].g = rss->color[1].b = 0;
-  rss->color[2].r = rss->color[2].g = rss->color[2].b = 255;
-  rss->colori = 1;
-  rss->freei  = 3;
+  if ( buf->data != NULL )
+    RS_FREE(buf->data, buf->max) ;
+  buf->data = NULL ;
+  buf->size = buf->max = 0 ;
+  buf->failed = FALSE ;
 }
 
-statcic void rs_write_nib(RS_BAND_BLOCK *rs, int32 val)
+static void rs_put_bytes(RS_BUFFER *buf, const uint8 *bytes, int32 n)
 {
-  if ( rs->nib )
-  {
-    rs->cmds[rs->size++] |= (uint8)(val);
-    rs->nib = FALSE;
+  if ( rs_buffer_reserve(buf, n) ) {
+    HqMemCpy(buf->data + buf->size, bytes, n) ;
+    buf->size += n ;
   }
-  else
-  {
-    rs->cmds[rs->size] = (uint8)(val<<4);
-    rs->nib = TRUE;
+}
+
+static void rs_put_byte(RS_BUFFER *buf, uint32 val)
+{
+  if ( rs_buffer_reserve(buf, 1) )
+    buf->data[buf->size++] = (uint8)val ;
+}
+
+static void rs_put_u16(RS_BUFFER *buf, uint32 val)
+{
+  rs_put_byte(buf, val & 0xff) ;
+  rs_put_byte(buf, (val >> 8) & 0xff) ;
+}
+
+static void rs_put_u32(RS_BUFFER *buf, uint32 val)
+{
+  rs_put_u16(buf, val & 0xffff) ;
+  rs_put_u16(buf, val >> 16) ;
+}
+
+static void rs_put_uvar(RS_BUFFER *buf, uint32 val)
+{
+  while ( val >= 0x80 ) {
+    rs_put_byte(buf, (val & 0x7f) | 0x80) ;
+    val >>= 7 ;
   }
+  rs_put_byte(buf, val) ;
 }
 
-static void rs_write(RS_BAND_BLOCK *rs, int32 val, int32 enc)
+static void rs_put_svar(RS_BUFFER *buf, int32 val)
 {
-  switch ( enc )
-  {
-    case RS_BYTE:
-      rs->cmds[rs->size++] = (uint8)(val);
-      break;
-
-    case RS_OFF16:
-      val += 0x1000; /* and fall thru ... */
-    case RS_DBYTE:
-      rs->cmds[rs->size++] = (uint8)(val%256);
-      rs->cmds[rs->size++] = (uint8)(val/256);
-      break;
-
-    case RS_UNS8:
-      if ( val < 255 )
-        rs->cmds[rs->size++] = (uint8)val;
-      else
-      {
-        rs->cmds[rs->size++] = 0xff;
-        rs->cmds[rs->size++] = (uint8)((val-255)%256);
-        rs->cmds[rs->size++] = (uint8)((val-255)/256);
-      }
-      break;
+  rs_put_uvar(buf, val < 0 ? ((~(uint32)val) << 1) | 1 : (uint32)val << 1) ;
+}
 
-    case RS_SIGN8:
-      if ( -127 <= val && val <= 127 )
-        rs->cmds[rs->size++] = (uint8)(val+127);
-      else
-      {
-        rs->cmds[rs->size++] = 0xff;
-        rs->cmds[rs->size++] = (uint8)((val+32767)%256);
-        rs->cmds[rs->size++] = (uint8)((val+32767)/256);
-      }
-      break;
-    case RS_VAL4:
-      if ( 1 <= val && val <= 15 )
-        rs_write_nib(rs, val-1);
-      else if ( 16 <= val && val <= 270 )
-      {
-        val -= 16;
-        rs_write_nib(rs, 0xF);
-        rs_write_nib(rs, (val>>4)&0xF);
-        rs_write_nib(rs, (val)&0xF);
-      }
-      else
-      {
-        val -= 271;
-        rs_write_nib(rs, 0XF);
-        rs_write_nib(rs, 0XF);
-        rs_write_nib(rs, 0XF);
-        rs_write_nib(rs, (val>>12)&0xF);
-        rs_write_nib(rs, (val>>8)&0xF);
-        rs_write_nib(rs, (val>>4)&0xF);
-        rs_write_nib(rs, (val)&0xF);
-      }
-      break;
+/**
+ * Send bytes to the sink, including them in the stream checksum.
+ */
+static Bool rs_send(RS_WRITER *w, uint8 *buf, int32 len)
+{
+  if ( len == 0 )
+    return TRUE ;
+  w->adler = rs_adler32(w->adler, buf, len) ;
+  return (*w->sink)(w->sinkdata, buf, len) ;
+}
 
-    case RS_NIBBLE:
-      rs_write_nib(rs, val);
-      break;
+/**
+ * Write the type and payload length of a record to the stream.
+ */
+static Bool rs_emit_head(RS_WRITER *w, uint32 type, uint32 len)
+{
+  uint8 head[6] ;
+  int32 n = 0 ;
+
+  head[n++] = (uint8)type ;
+  while ( len >= 0x80 ) {
+    head[n++] = (uint8)((len & 0x7f) | 0x80) ;
+    len >>= 7 ;
   }
+  head[n++] = (uint8)len ;
+
+  return rs_send(w, head, n) ;
 }
 
-static void rs_color(LISTOBJECT *lobj, RS_BAND_BLOCK *rs, RSS *rss)
+/**
+ * Write a record to the stream, and empty the payload buffer.
+ */
+static Bool rs_emit(RS_WRITER *w, uint32 type, RS_BUFFER *payload)
 {
-  dl_color_t dlc;
-  uint8 colori = 0;
+  if ( payload->failed )
+    return error_handler(VMERROR) ;
 
-  dlc_from_lobj_weak(lobj, &dlc);
-  switch ( dlc_check_black_white(&dlc) )
-  {
-    case DLC_TINT_WHITE:
-      colori = 2;
-      break;
-    case DLC_TINT_BLACK:
-      colori = 1;
-      break;
-    case DLC_TINT_OTHER:
-    {
-      color_entry_t *pce;
-      uint8 r, g, b;
-
-      pce = &(dlc.ce);
-      r = (uint8)(pce->pcv[0]/0x100);
-      g = (uint8)(pce->pcv[1]/0x100);
-      b = (uint8)(pce->pcv[2]/0x100);
-
-      if ( r == 0 && g == 0 && b == 0 )
-        colori = 1;
-      else if ( r == 0xff && g == 0xff && b == 0xff )
-        colori = 2;
-      else
-      {
-        for ( colori = 3; colori < rss->freei; colori++ )
-        {
-          if ( rss->color[colori].r == r && rss->color[colori].g == g &&
-               rss->color[colori].b == b )
-            break;
-        }
-        if ( colori == rss->freei )
-        {
-          rss->color[rss->freei].r = r;
-          rss->color[rss->freei].g = g;
-          rss->color[rss->freei].b = b;
-          if ( rss->freei != 255 )
-            rss->freei++;
-
-          rs->cmds[rs->size++] = 0x81;
-          rs->cmds[rs->size++] = colori;
-          rs->cmds[rs->size++] = r;
-          rs->cmds[rs->size++] = g;
-          rs->cmds[rs->size++] = b;
-        }
+  if ( !rs_emit_head(w, type, (uint32)payload->size) ||
+       !rs_send(w, payload->data, payload->size) )
+    return FALSE ;
+
+  payload->size = 0 ;
+  return TRUE ;
+}
+
+/**
+ * Emit the objects record being built, if it has any commands.
+ */
+static Bool rs_flush_ops(RS_WRITER *w)
+{
+  if ( w->ops.size == 0 && !w->ops.failed )
+    return TRUE ;
+  return rs_emit(w, RS_REC_OBJECTS, &w->ops) ;
+}
+
+/**
+ * Emit a definition record from the definition buffer. Definitions must
+ * precede their use, so the commands built so far are emitted first.
+ */
+static Bool rs_emit_def(RS_WRITER *w, uint32 type)
+{
+  return rs_flush_ops(w) && rs_emit(w, type, &w->def) ;
+}
+
+/**
+ * Find the id of a key, or the empty slot where it should go.
+ */
+static uint32 rs_idmap_slot(const RS_IDMAP *map, const void *key)
+{
+  uint32 mask = map->size - 1 ;
+  uint32 i = (uint32)(((uintptr_t)key >> 3) * 2654435761u) & mask ;
+
+  while ( map->keys[i] != NULL && map->keys[i] != key )
+    i = (i + 1) & mask ;
+
+  return i ;
+}
+
+/**
+ * Look up the id of a colour, form, object or clip.
+ *
+ * \param[in,out] map   The id map.
+ * \param[in]     key   The address of the colour, form, object or clip.
+ * \param[out]    id    The id of the key, which is a new id if the key was
+ *                      not found.
+ * \param[out]    isnew Whether the key was not found, and has been given a
+ *                      new id which the caller must define in the stream.
+ * \return FALSE if the map could not be grown.
+ */
+static Bool rs_idmap_lookup(RS_IDMAP *map, const void *key,
+                            uint32 *id, Bool *isnew)
+{
+  uint32 i ;
+
+  HQASSERT(key != NULL, "No key to look up") ;
+
+  if ( (map->count + 1) * 2 > map->size ) {
+    RS_IDMAP bigger ;
+    uint32 j ;
+
+    bigger.size = map->size > 0 ? map->size * 2 : 64 ;
+    bigger.count = map->count ;
+    bigger.keys = RS_ALLOC(bigger.size * sizeof(bigger.keys[0])) ;
+    bigger.ids = RS_ALLOC(bigger.size * sizeof(bigger.ids[0])) ;
+    if ( bigger.keys == NULL || bigger.ids == NULL ) {
+      if ( bigger.keys != NULL )
+        RS_FREE((void *)bigger.keys, bigger.size * sizeof(bigger.keys[0])) ;
+      if ( bigger.ids != NULL )
+        RS_FREE(bigger.ids, bigger.size * sizeof(bigger.ids[0])) ;
+      return error_handler(VMERROR) ;
+    }
+    HqMemZero((void *)bigger.keys, bigger.size * sizeof(bigger.keys[0])) ;
+    for ( j = 0 ; j < map->size ; ++j ) {
+      if ( map->keys[j] != NULL ) {
+        i = rs_idmap_slot(&bigger, map->keys[j]) ;
+        bigger.keys[i] = map->keys[j] ;
+        bigger.ids[i] = map->ids[j] ;
       }
-      break;
     }
+    if ( map->size > 0 ) {
+      RS_FREE((void *)map->keys, map->size * sizeof(map->keys[0])) ;
+      RS_FREE(map->ids, map->size * sizeof(map->ids[0])) ;
+    }
+    *map = bigger ;
   }
-  if ( rss->colori != colori )
-  {
-    rs->cmds[rs->size++] = 0x82;
-    rs->cmds[rs->size++] = colori;
-    rss->colori = colori;
+
+  i = rs_idmap_slot(map, key) ;
+  if ( (*isnew = (map->keys[i] == NULL)) ) {
+    map->keys[i] = key ;
+    map->ids[i] = map->count++ ;
   }
+  *id = map->ids[i] ;
+  return TRUE ;
 }
 
-typedef struct ATHREAD
+static void rs_idmap_free(RS_IDMAP *map)
 {
-  int32 ncoords;
-  int32 minx, maxx;
-  RS_COORD xy[1];
-} ATHREAD;
+  if ( map->size > 0 ) {
+    RS_FREE((void *)map->keys, map->size * sizeof(map->keys[0])) ;
+    RS_FREE(map->ids, map->size * sizeof(map->ids[0])) ;
+  }
+  map->keys = NULL ;
+  map->ids = NULL ;
+  map->size = map->count = 0 ;
+}
 
-typedef struct ALLTHREADS
+/**
+ * Start a stream, writing the identification, job and page records.
+ */
+static Bool rs_writer_begin(RS_WRITER *w, rs_sink_fn sink, void *sinkdata,
+                            int32 job, int32 page, int32 width,
+                            int32 height, int32 band_lines)
 {
-  int32 bytes;
-  int32 nthreads;
-  ATHREAD *thread[1];
-} ALLTHREADS;
+  HqMemZero(w, sizeof(*w)) ;
+  w->sink = sink ;
+  w->sinkdata = sinkdata ;
+  w->adler = 1 ;
+  w->color = RS_NO_ID ;
+  w->alpha = RS_VALUE_ONE ;
+  w->ok = TRUE ;
+
+  rs_put_u32(&w->def, RS_MAGIC0) ;
+  rs_put_u32(&w->def, RS_MAGIC1) ;
+  rs_put_u16(&w->def, RS_VERSION_MAJOR) ;
+  rs_put_u16(&w->def, RS_VERSION_MINOR) ;
+  if ( w->def.failed )
+    return error_handler(VMERROR) ;
+  if ( !rs_send(w, w->def.data, w->def.size) )
+    return FALSE ;
+  w->def.size = 0 ;
+
+  rs_put_uvar(&w->def, (uint32)job) ;
+  if ( !rs_emit(w, RS_REC_JOB, &w->def) )
+    return FALSE ;
+
+  rs_put_uvar(&w->def, (uint32)page) ;
+  rs_put_uvar(&w->def, (uint32)width) ;
+  rs_put_uvar(&w->def, (uint32)height) ;
+  rs_put_uvar(&w->def, (uint32)band_lines) ;
+  return rs_emit(w, RS_REC_PAGE, &w->def) ;
+}
 
-static ALLTHREADS *extract_threads(NFILLOBJECT *nfill)
+/**
+ * Finish a stream, writing the end record with the stream checksum.
+ */
+static Bool rs_writer_end(RS_WRITER *w)
 {
-  static ALLTHREADS *allthreads = NULL;
-  int32 th;
+  uint8 head[2], sum[4] ;
+  uint32 adler ;
+
+  if ( !rs_flush_ops(w) )
+    return FALSE ;
+
+  rs_put_uvar(&w->def, w->nomitted > 0 ? RS_PAGE_PARTIAL : 0) ;
+  rs_put_uvar(&w->def, w->nobjects) ;
+  rs_put_uvar(&w->def, w->nomitted) ;
+  if ( w->def.failed )
+    return error_handler(VMERROR) ;
+  HQASSERT(w->def.size + 4 < 0x80, "End record needs a longer length") ;
+
+  head[0] = RS_REC_END ;
+  head[1] = (uint8)(w->def.size + 4) ;
+  if ( !rs_send(w, head, 2) || !rs_send(w, w->def.data, w->def.size) )
+    return FALSE ;
+
+  adler = w->adler ;
+  sum[0] = (uint8)adler ;
+  sum[1] = (uint8)(adler >> 8) ;
+  sum[2] = (uint8)(adler >> 16) ;
+  sum[3] = (uint8)(adler >> 24) ;
+  return (*w->sink)(w->sinkdata, sum, 4) ;
+}
 
-  if ( allthreads == NULL )
-  {
-    allthreads = (ALLTHREADS *)malloc(1024*1024);
-    allthreads->bytes = 1024*1024;
+static void rs_writer_free(RS_WRITER *w)
+{
+  rs_buffer_free(&w->ops) ;
+  rs_buffer_free(&w->def) ;
+  rs_buffer_free(&w->pairs) ;
+  rs_buffer_free(&w->row) ;
+  rs_buffer_free(&w->prev) ;
+  rs_buffer_free(&w->spans) ;
+  rs_idmap_free(&w->colors) ;
+  rs_idmap_free(&w->masks) ;
+  rs_idmap_free(&w->images) ;
+}
+
+/**
+ * Select a colour id, if it is not already selected.
+ */
+static void rs_op_color(RS_WRITER *w, uint32 id)
+{
+  if ( w->color != id ) {
+    rs_put_byte(&w->ops, RS_OP_COLOR) ;
+    rs_put_uvar(&w->ops, id) ;
+    w->color = id ;
   }
+}
 
-  if ( (allthreads->nthreads = nfill->nthreads) > 50 )
-    return NULL;
+/**
+ * Set the clip rectangle, if it is not already set.
+ */
+static void rs_op_clip(RS_WRITER *w, const dbbox_t *clip)
+{
+  if ( !w->clipset || !bbox_equal(&w->clip, clip) ) {
+    rs_put_byte(&w->ops, RS_OP_CLIP) ;
+    rs_put_svar(&w->ops, clip->x1) ;
+    rs_put_svar(&w->ops, clip->y1) ;
+    rs_put_svar(&w->ops, clip->x2) ;
+    rs_put_svar(&w->ops, clip->y2) ;
+    w->clip = *clip ;
+    w->clipset = TRUE ;
+  }
+}
 
-  for ( th = 0; th < nfill->nthreads; th++ )
-  {
-    NBRESS *nbress = nfill->thread[th];
-    ATHREAD *at;
-    RS_COORD *xy;
-    dcoord i, x, y;
-
-    allthreads->thread[th] = (ATHREAD *)(((uint8 *)allthreads) +
-        sizeof(ALLTHREADS) + allthreads->nthreads * sizeof(ATHREAD *) +
-        th*allthreads->bytes/allthreads->nthreads);
-    at = allthreads->thread[th];
-    xy = at->xy;
-    xy->x = nbress->nx1; xy->y = nbress->ny1; xy++;
-    at->ncoords = 2;
-    x = nbress->nx2; y = nbress->ny2;
-    xy->x = x; xy->y = y; xy++;
-
-    dxylist_reset(&(nbress->dxy));
-    while ( dxylist_get(&(nbress->dxy),&x,&y) )
-    {
-      xy->x = x; xy->y = y; xy++;
-      at->ncoords++;
-    }
-    if ( at->ncoords > 1000 )
-      return NULL;
+/**
+ * Set the opacity of the following paints, if it is not already set.
+ */
+static void rs_op_alpha(RS_WRITER *w, uint32 alpha)
+{
+  if ( w->alpha != alpha ) {
+    rs_put_byte(&w->ops, RS_OP_ALPHA) ;
+    rs_put_u16(&w->ops, alpha) ;
+    w->alpha = alpha ;
   }
-  return allthreads;
 }
 
-static int32 merge_threads(ALLTHREADS *at)
+static void rs_op_erase(RS_WRITER *w)
 {
-  int32 th, dst;
+  rs_put_byte(&w->ops, RS_OP_ERASE) ;
+}
 
-  /* join any threads that we can */
-  for ( th = 0; th < at->nthreads; th++ )
-  {
-    ATHREAD *at1 = at->thread[th];
-
-    for ( dst = 0; dst < at->nthreads; dst++ )
-    {
-      ATHREAD *at2 = at->thread[dst];
-
-      if ( dst != th && at1 != NULL && at2 != NULL )
-      {
-        /* can th(at1) be added to the end of dst(at2) ? */
-        if ( at1->xy[0].x == at2->xy[at2->ncoords-1].x &&
-             at1->xy[0].y == at2->xy[at2->ncoords-1].y )
-        {
-          int32 j;
-
-          for ( j = 0; j < at1->ncoords; j++ )
-            at2->xy[at2->ncoords+j-1] = at1->xy[j];
-          at2->ncoords += at1->ncoords-1;
-          at->thread[th] = NULL;
-        }
-      }
-    }
-  }
-  /* re-count the threads */
-  for ( th = 0, dst = 0; th < at->nthreads; th++ )
-  {
-    at->thread[dst] = at->thread[th];
-    if ( at->thread[dst] != NULL )
-      dst++;
+static void rs_op_rect(RS_WRITER *w, const dbbox_t *rect)
+{
+  rs_put_byte(&w->ops, RS_OP_RECT) ;
+  rs_put_svar(&w->ops, rect->x1) ;
+  rs_put_svar(&w->ops, rect->y1) ;
+  rs_put_svar(&w->ops, rect->x2) ;
+  rs_put_svar(&w->ops, rect->y2) ;
+}
+
+static void rs_op_mask(RS_WRITER *w, uint32 id, dcoord x, dcoord y)
+{
+  rs_put_byte(&w->ops, RS_OP_MASK) ;
+  rs_put_uvar(&w->ops, id) ;
+  rs_put_svar(&w->ops, x) ;
+  rs_put_svar(&w->ops, y) ;
+}
+
+/**
+ * Emit the commands built so far if there are enough of them.
+ */
+static Bool rs_ops_check(RS_WRITER *w)
+{
+  if ( w->ops.failed )
+    return error_handler(VMERROR) ;
+  if ( w->ops.size >= RS_OPS_CHUNK )
+    return rs_flush_ops(w) ;
+  return TRUE ;
+}
+
+/**
+ * Add a span to the mask row being encoded. The gap is from the end of the
+ * previous span.
+ */
+static void rs_mask_span(RS_WRITER *w, int32 gap, int32 run, int32 *npairs)
+{
+  rs_put_uvar(&w->pairs, (uint32)gap) ;
+  rs_put_uvar(&w->pairs, (uint32)run) ;
+  ++*npairs ;
+}
+
+/**
+ * Finish encoding a block of mask rows. Blocks whose spans are the same as
+ * the previous block's are merged with it.
+ */
+static void rs_mask_rows(RS_WRITER *w, int32 rows, int32 npairs, int32 *prevrows)
+{
+  RS_BUFFER swap ;
+
+  w->row.size = 0 ;
+  rs_put_uvar(&w->row, (uint32)npairs) ;
+  rs_put_bytes(&w->row, w->pairs.data, w->pairs.size) ;
+  w->pairs.size = 0 ;
+
+  if ( *prevrows > 0 && w->row.size == w->prev.size &&
+       HqMemCmp(w->row.data, w->row.size, w->prev.data, w->prev.size) == 0 ) {
+    *prevrows += rows ;
+    return ;
   }
-  at->nthreads -= (th-dst);
 
-  /* Temp : assume no self-intersections, reverse sort by max x */
-  for ( th = 0; th < at->nthreads; th++ )
-  {
-    ATHREAD *at1 = at->thread[th];
-    int32 j, mymin, mymax;
-
-    mymin = mymax = at1->xy[0].x;
-    for ( j = 1; j < at1->ncoords; j++ )
-    {
-      if ( at1->xy[j].x > mymax )
-        mymax = at1->xy[j].x;
-      if ( at1->xy[j].x < mymin )
-        mymin = at1->xy[j].x;
-    }
-    at1->minx = mymin;
-    at1->maxx = mymax;
+  if ( *prevrows > 0 ) {
+    rs_put_uvar(&w->def, (uint32)*prevrows) ;
+    rs_put_bytes(&w->def, w->prev.data, w->prev.size) ;
   }
-  for ( th = 0; th < at->nthreads; th++ )
-  {
-    for ( dst = 0; dst < at->nthreads; dst++ )
-    {
-      if ( th != dst )
-      {
-        ATHREAD *at1 = at->thread[th];
-        ATHREAD *at2 = at->thread[dst];
-
-        if ( ( th < dst && at1->maxx > at2->maxx ) ||
-             ( th > dst && at1->maxx < at2->maxx ) )
-        {
-          at->thread[th]  = at2;
-          at->thread[dst] = at1;
-        }
+  swap = w->prev ;
+  w->prev = w->row ;
+  w->row = swap ;
+  *prevrows = rows ;
+}
+
+/**
+ * Encode the rows of an RLE glyph form as a mask definition.
+ */
+static void rs_mask_rle(RS_WRITER *w, FORM *form)
+{
+  RLECACHE_LINE_READ_STATE state ;
+  int32 y, prevrows = 0 ;
+
+  state.next_line = (uint8 *)form->addr ;
+  for ( y = 0 ; y < form->h ; y += state.row_height ) {
+    int32 pair[2], gap = 0, npairs = 0 ;
+
+    rlecache_line_read_init(&state, form, state.next_line) ;
+    HQASSERT(state.row_height > 0, "RLE form row has no height") ;
+    while ( !state.line_finished ) {
+      rlecache_get_span_pair(&state, pair) ;
+      gap += pair[0] ;
+      if ( pair[1] > 0 ) {
+        rs_mask_span(w, gap, pair[1], &npairs) ;
+        gap = 0 ;
       }
     }
+    rs_mask_rows(w, min(state.row_height, form->h - y), npairs, &prevrows) ;
   }
-  if ( at->nthreads >=2 && at->thread[0]->minx > at->thread[1]->minx )
-  {
-    ATHREAD *at1 = at->thread[0];
-    ATHREAD *at2 = at->thread[1];
+  rs_mask_rows(w, 0, 0, &prevrows) ;
+}
 
-    at->thread[0] = at2;
-    at->thread[1] = at1;
+/**
+ * Encode the rows of a bitmap glyph form as a mask definition.
+ */
+static void rs_mask_bitmap(RS_WRITER *w, FORM *form)
+{
+  int32 y, prevrows = 0 ;
+
+  for ( y = 0 ; y < form->h ; ++y ) {
+    blit_t *row = BLIT_ADDRESS(form->addr, y * form->l) ;
+    int32 x = 0, end = 0, npairs = 0 ;
+
+    while ( x < form->w ) {
+      int32 x1 ;
+
+      while ( x < form->w &&
+              ((AONE >> (x & BLIT_MASK_BITS)) &
+               *BLIT_ADDRESS(row, BLIT_OFFSET(x))) == 0 )
+        ++x ;
+      if ( x == form->w )
+        break ;
+      x1 = x ;
+      while ( x < form->w &&
+              ((AONE >> (x & BLIT_MASK_BITS)) &
+               *BLIT_ADDRESS(row, BLIT_OFFSET(x))) != 0 )
+        ++x ;
+      rs_mask_span(w, x1 - end, x - x1, &npairs) ;
+      end = x ;
+    }
+    rs_mask_rows(w, 1, npairs, &prevrows) ;
   }
-  return at->nthreads;
+  rs_mask_rows(w, 0, 0, &prevrows) ;
 }
 
-static void makeyhull(RS_BAND_BLOCK *rs, ATHREAD *left, ATHREAD *right)
+/**
+ * Find the mask id of a glyph form, defining it if it is new.
+ *
+ * \return FALSE on error. If the form type cannot be written, \a id is
+ *         RS_NO_ID.
+ */
+static Bool rs_form_mask(RS_WRITER *w, FORM *form, uint32 *id)
 {
-  RS_COORD *lxy = left->xy;
-  RS_COORD *rxy = right->xy;
+  Bool isnew ;
+
+  *id = RS_NO_ID ;
+  if ( form->type == FORMTYPE_CHARCACHE )
+    form = ((CHARCACHE *)form)->thebmapForm ;
+
+  switch ( form->type ) {
+  case FORMTYPE_CACHEBITMAP:
+  case FORMTYPE_CACHEBITMAPTORLE:
+  case FORMTYPE_CACHERLE1: case FORMTYPE_CACHERLE2:
+  case FORMTYPE_CACHERLE3: case FORMTYPE_CACHERLE4:
+  case FORMTYPE_CACHERLE5: case FORMTYPE_CACHERLE6:
+  case FORMTYPE_CACHERLE7: case FORMTYPE_CACHERLE8:
+    break ;
+  default:
+    return TRUE ;
+  }
 
-  do
-  {
-    int32 i, do_left, do_right, nvecs, x, y;
-    int32 eleft = 0, eright = 0;
-    int32 toptail = 0;
-
-    if ( ( do_left = left->ncoords ) > 17 )
-      do_left = 17;
-    if ( ( do_right = right->ncoords ) > 17 )
-      do_right = 17;
-
-    if ( lxy[0].y < rxy[0].y )
-      eright++, toptail += 1;
-    else if ( lxy[0].y > rxy[0].y )
-      eleft++, toptail += 2;
-
-    if ( lxy[do_left-1].y < rxy[do_right-1].y )
-      eleft++, toptail += 4;
-    else if ( lxy[do_left-1].y > rxy[do_right-1].y )
-      eright++, toptail += 8;
-
-    if ( do_left > 17 - eleft )
-      do_left = 17 - eleft;
-    if ( do_right > 17 - eright )
-      do_right = 17 - eright;
-
-    nvecs = (do_left + eleft -2)*16+(do_right + eright - 2);
-
-    /* write the hull header */
-    rs_write(rs, 0x86, RS_BYTE);
-    rs_write(rs, 0, RS_UNS8); /* ya */
-    rs_write(rs, rs->y1-rs->y0+1, RS_UNS8); /* yb */
-    rs_write(rs, nvecs, RS_BYTE); /* nvecs */
-
-    /* write the hull left hand vectors */
-    if ( toptail & 2 )
-      { x = rxy[0].x; y = rxy[0].y; }
-    else
-      { x = lxy[0].x; y = lxy[0].y; }
-    rs_write(rs, x, RS_OFF16);
-    rs_write(rs, y, RS_OFF16);
-    for ( i = (toptail & 2) ? 0 : 1; i < do_left; i++ )
-    {
-      rs_write(rs, lxy[i].x - x, RS_SIGN8);
-      rs_write(rs, lxy[i].y - y, RS_UNS8);
-      x = lxy[i].x;
-      y = lxy[i].y;
-    }
-    if ( toptail & 4 )
-    {
-      rs_write(rs, rxy[do_right-1].x - x, RS_SIGN8);
-      rs_write(rs, rxy[do_right-1].y - y, RS_UNS8);
-    }
+  if ( !rs_idmap_lookup(&w->masks, form, id, &isnew) )
+    return FALSE ;
 
-    /* write the hull right hand vectors */
-    if ( toptail & 1 )
-      { x = lxy[0].x; y = lxy[0].y; }
+  if ( isnew ) {
+    rs_put_uvar(&w->def, *id) ;
+    rs_put_uvar(&w->def, (uint32)form->w) ;
+    rs_put_uvar(&w->def, (uint32)form->h) ;
+    if ( form->type >= FORMTYPE_CACHERLE1 && form->type <= FORMTYPE_CACHERLE8 )
+      rs_mask_rle(w, form) ;
     else
-      { x = rxy[0].x; y = rxy[0].y; }
-    rs_write(rs, x, RS_OFF16);
-    rs_write(rs, y, RS_OFF16);
-    for ( i = (toptail & 1) ? 0 : 1; i < do_right; i++ )
-    {
-      rs_write(rs, rxy[i].x - x, RS_SIGN8);
-      rs_write(rs, rxy[i].y - y, RS_UNS8);
-      x = rxy[i].x;
-      y = rxy[i].y;
-    }
-    if ( toptail & 8 )
-    {
-      rs_write(rs, lxy[do_left-1].x - x, RS_SIGN8);
-      rs_write(rs, lxy[do_left-1].y - y, RS_UNS8);
-    }
+      rs_mask_bitmap(w, form) ;
+    if ( w->pairs.failed || w->row.failed || w->prev.failed )
+      return error_handler(VMERROR) ;
+    if ( !rs_emit_def(w, RS_REC_MASK) )
+      return FALSE ;
+  }
+
+  return TRUE ;
+}
+
+/** State of a fill being scan converted into a mask definition. */
+typedef struct RS_SCAN {
+  RS_WRITER *w ;
+  dbbox_t box ;           /**< Area of the mask on the page. */
+  dcoord y ;              /**< Row whose spans are being collected. */
+  int32 prevrows ;        /**< Rows in the mask row block being merged. */
+  Bool invert ;           /**< Mask the pixels outside the fill. */
+} RS_SCAN ;
 
-    lxy += do_left;
-    rxy += do_right;
-    left->ncoords -= do_left;
-    right->ncoords -= do_right;
-
-    if ( left->ncoords > 0 || right->ncoords > 0 )
-    {
-      left->ncoords++, lxy--;
-      right->ncoords++, rxy--;
-      if ( left->ncoords == 1 )
-        lxy[1] = lxy[0], left->ncoords++;
-      if ( right->ncoords == 1 )
-        rxy[1] = rxy[0], right->ncoords++;
+/**
+ * Encode the spans collected for a row of a scan converted mask, and repeat
+ * it for a number of rows.
+ */
+static void rs_scan_rows(RS_SCAN *scan, int32 rows)
+{
+  RS_WRITER *w = scan->w ;
+  dcoord *span = (dcoord *)w->spans.data ;
+  int32 n = w->spans.size / (int32)(2 * sizeof(dcoord)), i, j, npairs = 0 ;
+  dcoord end = scan->box.x1, x1, x2 ;
+
+  /* Spans arrive in any order, and may overlap. Sort them by their left
+     ends, then merge them as they are encoded. */
+  for ( i = 1 ; i < n ; ++i ) {
+    x1 = span[2 * i] ;
+    x2 = span[2 * i + 1] ;
+    for ( j = i ; j > 0 && span[2 * j - 2] > x1 ; --j ) {
+      span[2 * j] = span[2 * j - 2] ;
+      span[2 * j + 1] = span[2 * j - 1] ;
     }
-  } while ( left->ncoords > 0 || right->ncoords > 0 );
+    span[2 * j] = x1 ;
+    span[2 * j + 1] = x2 ;
+  }
+
+  for ( i = 0 ; i < n ; i = j ) {
+    x1 = max(span[2 * i], scan->box.x1) ;
+    x2 = span[2 * i + 1] ;
+    for ( j = i + 1 ; j < n && span[2 * j] <= x2 + 1 ; ++j )
+      x2 = max(x2, span[2 * j + 1]) ;
+    x2 = min(x2, scan->box.x2) ;
+    if ( x1 > x2 || x2 < end )
+      continue ;
+    x1 = max(x1, end) ;
+    if ( !scan->invert )
+      rs_mask_span(w, x1 - end, x2 - x1 + 1, &npairs) ;
+    else if ( x1 > end )
+      rs_mask_span(w, 0, x1 - end, &npairs) ;
+    end = x2 + 1 ;
+  }
+  if ( scan->invert && end <= scan->box.x2 )
+    rs_mask_span(w, 0, scan->box.x2 - end + 1, &npairs) ;
+
+  w->spans.size = 0 ;
+  if ( rows > 0 )
+    rs_mask_rows(w, rows, npairs, &scan->prevrows) ;
 }
 
-static void rs_nfill(LISTOBJECT *lobj, RS_BAND_BLOCK *rs, RSS *rss)
+/**
+ * Span function collecting the spans of a fill being scan converted.
+ * Scanlines arrive in increasing order, but may skip empty rows.
+ */
+static void rs_scan_span(render_blit_t *rb, dcoord y, dcoord xs, dcoord xe)
 {
-  ALLTHREADS *at = extract_threads(lobj->dldata.nfill);
+  RS_SCAN *scan ;
+  dcoord span[2] ;
 
-  if ( at == NULL )
-    return;
-  rs_color(lobj, rs, rss);
-  while ( merge_threads(at) > 1 )
-  {
-    ATHREAD *th0 = at->thread[0];
-    ATHREAD *th1 = at->thread[1];
-    RS_COORD th0_end, th1_end;
-
-    th0_end = th0->xy[th0->ncoords-1];
-    th1_end = th1->xy[th1->ncoords-1];
-    if ( th0_end.y < th1_end.y )
-      th0->xy[th0->ncoords++] = th1_end;
-    else if ( th0_end.y > th1_end.y )
-      th1->xy[th1->ncoords++] = th0_end;
-    makeyhull(rs, th0, th1);
-    if ( th0_end.y == th1_end.y )
-      at->thread[0] = at->thread[1] = NULL;
-    else if ( th0_end.y < th1_end.y )
-    {
-      th0->xy[0] = th0_end;
-      th0->xy[1] = th1_end;
-      th0->ncoords = 2;
-      at->thread[1] = NULL;
-    }
-    else
-    {
-      th1->xy[0] = th1_end;
-      th1->xy[1] = th0_end;
-      th1->ncoords = 2;
-      at->thread[0] = NULL;
-    }
+  GET_BLIT_DATA(rb->blits, BASE_BLIT_INDEX, scan) ;
+  HQASSERT(y >= scan->y && y <= scan->box.y2, "Scanline out of order") ;
+
+  if ( y != scan->y ) {
+    rs_scan_rows(scan, 1) ;
+    rs_scan_rows(scan, y - scan->y - 1) ;
+    scan->y = y ;
   }
+  span[0] = xs ;
+  span[1] = xe ;
+  rs_put_bytes(&scan->w->spans, (uint8 *)span, sizeof(span)) ;
 }
 
-static int32 decode_runs(uint8 *rle, int32 bytes, int32 nib, int32 *runs)
+/**
+ * Scan convert a fill into a mask definition covering an area of the page.
+ */
+static Bool rs_scan_mask(RS_WRITER *w, uint32 id, NFILLOBJECT *nfill,
+                         int32 rule, const dbbox_t *box, Bool invert)
 {
-  int32 n[1000], nn, rr;
-  int32 nvals, maxval;
+  static blit_slice_t slice = {
+    rs_scan_span, invalid_block, invalid_snfill, invalid_char, invalid_imgblt
+  } ;
+  render_state_t rs ;
+  blit_chain_t blits ;
+  render_forms_t forms ;
+  FORM form ;
+  RS_SCAN scan ;
+
+  HQASSERT(!bbox_is_empty(box), "Scan converting into an empty mask") ;
+
+  rs_put_uvar(&w->def, id) ;
+  rs_put_uvar(&w->def, (uint32)(box->x2 - box->x1 + 1)) ;
+  rs_put_uvar(&w->def, (uint32)(box->y2 - box->y1 + 1)) ;
+
+  scan.w = w ;
+  scan.box = *box ;
+  scan.y = box->y1 ;
+  scan.prevrows = 0 ;
+  scan.invert = invert ;
+  w->spans.size = 0 ;
+
+  /* The form is never written to, it only sets the band limits. */
+  HqMemZero(&form, sizeof(form)) ;
+  theFormW(form) = box->x2 + 1 ;
+  theFormH(form) = theFormRH(form) = box->y2 + 1 ;
+  theFormHOff(form) = 0 ;
+  render_state_mask(&rs, &blits, &forms, &invalid_surface, &form) ;
+  RESET_BLITS(&blits, &slice, &slice, &slice) ;
+  SET_BLIT_DATA(&blits, BASE_BLIT_INDEX, &scan) ;
+  rs.ri.clip = *box ;
+
+  REPAIR_NFILL(nfill, box->y1) ;
+  scanconvert_band(&rs.ri.rb, nfill, rule) ;
+
+  rs_scan_rows(&scan, 1) ;
+  rs_scan_rows(&scan, box->y2 - scan.y) ;
+  rs_mask_rows(w, 0, 0, &scan.prevrows) ;
+
+  if ( w->spans.failed || w->pairs.failed || w->row.failed || w->prev.failed )
+    return error_handler(VMERROR) ;
+  return rs_emit_def(w, RS_REC_MASK) ;
+}
 
-  if ( nib == 1 )
-  {
-    nvals = 2*bytes; maxval = 0xF;
-    for ( nn = 0; nn < nvals; nn += 2 )
-    {
-      n[nn]   = (rle[nn/2]>>4)&0xf;
-      n[nn+1] = (rle[nn/2])&0xf;
+/**
+ * Find the colour id of a display list colour, defining it if it is new.
+ */
+static Bool rs_ncolor_id(RS_WRITER *w, p_ncolor_t ncolor, uint32 *id)
+{
+  dl_color_t dlc ;
+  Bool isnew ;
+
+  HQASSERT(ncolor != NULL, "No colour to define") ;
+  if ( !rs_idmap_lookup(&w->colors, ncolor, id, &isnew) )
+    return FALSE ;
+
+  if ( isnew ) {
+    dlc_from_dl_weak(ncolor, &dlc) ;
+    rs_put_uvar(&w->def, *id) ;
+    switch ( dlc_check_black_white(&dlc) ) {
+    case DLC_TINT_BLACK:
+      rs_put_uvar(&w->def, RS_COLOR_BLACK) ;
+      break ;
+    case DLC_TINT_WHITE:
+      rs_put_uvar(&w->def, RS_COLOR_WHITE) ;
+      break ;
+    default: {
+      dl_color_iter_t iter ;
+      dlc_iter_result_t res ;
+      COLORANTINDEX ci ;
+      COLORVALUE cv ;
+      uint32 n = 0 ;
+
+      for ( res = dlc_first_colorant(&dlc, &iter, &ci, &cv) ;
+            res == DLC_ITER_COLORANT || res == DLC_ITER_ALLSEP ;
+            res = dlc_next_colorant(&dlc, &iter, &ci, &cv) )
+        ++n ;
+
+      rs_put_uvar(&w->def, RS_COLOR_TINTS) ;
+      rs_put_uvar(&w->def, n) ;
+      for ( res = dlc_first_colorant(&dlc, &iter, &ci, &cv) ;
+            res == DLC_ITER_COLORANT || res == DLC_ITER_ALLSEP ;
+            res = dlc_next_colorant(&dlc, &iter, &ci, &cv) ) {
+        rs_put_svar(&w->def, res == DLC_ITER_ALLSEP ? RS_COLORANT_ALL
+                                                    : (int32)ci) ;
+        rs_put_u16(&w->def, (uint32)cv) ;
+      }
+      break ;
     }
-  }
-  else
-  {
-    nvals = bytes; maxval = 0xFF;
-    for ( nn = 0; nn < nvals; nn += 2 )
-    {
-      n[nn]   = rle[nn];
-      n[nn+1] = rle[nn+1];
     }
+    if ( !rs_emit_def(w, RS_REC_COLOR) )
+      return FALSE ;
   }
-  for ( rr = 0, nn = 0; nn < nvals; )
-  {
-    if ( n[nn] == maxval - 1 )
-    {
-      nn++;
-      runs[rr++] = (maxval + 1) + n[nn++];
-    }
-    else if ( n[nn] == maxval )
-    {
-      nn++;
-      runs[rr] = (2*maxval + 1) + (maxval+1)*n[nn++];
-      runs[rr++] += n[nn++];
+
+  return TRUE ;
+}
+
+/**
+ * Set the complex clip masks of a clip, defining the masks which are new.
+ * Each complex clip in the clip's chain is scan converted once over its
+ * bounds, and is keyed by its CLIPOBJECT.
+ */
+static Bool rs_clipmasks(RS_WRITER *w, DL_STATE *page, CLIPOBJECT *clip)
+{
+  CLIPOBJECT *c ;
+  dbbox_t box, pagebox ;
+  uint32 id, n = 0 ;
+  Bool isnew ;
+
+  if ( clip == w->clipmasks || (clip != NULL && clip->ncomplex == 0 &&
+                                w->nclipmasks == 0) )
+    return TRUE ;
+
+  bbox_store(&pagebox, 0, 0, page->page_w - 1, page->page_h - 1) ;
+  for ( c = clip ; c != NULL ; c = c->context ) {
+    if ( c->fill == NULL )
+      continue ;
+    if ( !rs_idmap_lookup(&w->masks, c, &id, &isnew) )
+      return FALSE ;
+    if ( isnew ) {
+      bbox_intersection(&c->bounds, &pagebox, &box) ;
+      if ( bbox_is_empty(&box) ) {
+        /* A clip covering none of the page is an empty mask. */
+        rs_put_uvar(&w->def, id) ;
+        rs_put_uvar(&w->def, 0) ;
+        rs_put_uvar(&w->def, 0) ;
+        if ( !rs_emit_def(w, RS_REC_MASK) )
+          return FALSE ;
+      } else if ( !rs_scan_mask(w, id, c->fill, (c->rule & CLIPRULE) | ISCLIP,
+                                &box, (c->rule & CLIPINVERT) != 0) )
+        return FALSE ;
     }
-    else
-    {
-      runs[rr++] = 1 + n[nn++];
+    ++n ;
+  }
+
+  if ( n > 0 || w->nclipmasks > 0 ) {
+    rs_put_byte(&w->ops, RS_OP_CLIPMASKS) ;
+    rs_put_uvar(&w->ops, n) ;
+    for ( c = clip ; c != NULL ; c = c->context ) {
+      if ( c->fill == NULL )
+        continue ;
+      if ( !rs_idmap_lookup(&w->masks, c, &id, &isnew) )
+        return FALSE ;
+      HQASSERT(!isnew, "Clip mask should have been defined") ;
+      bbox_intersection(&c->bounds, &pagebox, &box) ;
+      rs_put_uvar(&w->ops, id) ;
+      rs_put_svar(&w->ops, box.x1) ;
+      rs_put_svar(&w->ops, box.y1) ;
     }
   }
-  if ( rr & 1 )
-    rr--;
-  return rr/2;
+  w->clipmasks = clip ;
+  w->nclipmasks = n ;
+  return TRUE ;
 }
 
-static void rs_ouputrlechar(RS_BAND_BLOCK *rs, int32 id, FORM *form)
+/**
+ * Set the clip and opacity of an object, and its colour if it is painted
+ * in a single colour.
+ */
+static Bool rs_lobj_state(RS_WRITER *w, DL_STATE *page, LISTOBJECT *lobj,
+                          Bool flat)
 {
-  uint8 *rle = (uint8 *)(form->addr), *end = rle + form->size;
-  int32 nib = form->type - FORMTYPE_CACHERLE1 + 1;
-  int32 runs[1000], npairs, nn;
-  uint8 *nnibbles;
+  CLIPOBJECT *clip = lobj->objectstate->clipstate ;
+  dbbox_t bounds ;
+  uint32 id ;
 
-  rs_write(rs, 0x8B, RS_BYTE);
-  rs_write(rs, id, RS_BYTE);
-  rs_write(rs, form->w, RS_UNS8);
-  rs_write(rs, form->h, RS_UNS8);
-  nnibbles = &(rs->cmds[rs->size]);
-  rs_write(rs, 0, RS_DBYTE);
+  if ( !rs_clipmasks(w, page, clip) )
+    return FALSE ;
+  if ( flat && !rs_ncolor_id(w, lobj->p_ncolor, &id) )
+    return FALSE ;
 
-  if ( nib > 2 )
-    return;
+  if ( clip != NULL )
+    bounds = clip->bounds ;
+  else
+    bbox_store(&bounds, 0, 0, page->page_w - 1, page->page_h - 1) ;
+  rs_op_clip(w, &bounds) ;
+  rs_op_alpha(w, dl_color_opacity(lobj->p_ncolor)) ;
+  if ( flat )
+    rs_op_color(w, id) ;
+  return TRUE ;
+}
 
-  while ( rle < end )
-  {
-    int32 nlines = *rle++;
-    int32 size   = *rle++;
+/**
+ * Start an image record. The record's samples must follow, sent with
+ * rs_image_row().
+ */
+static Bool rs_image_begin(RS_WRITER *w, uint32 id, int32 width, int32 height,
+                           const ibbox_t *box, int32 bps, int32 ncomps,
+                           const int32 colorants[])
+{
+  uint32 len ;
+  int32 i ;
+
+  HQASSERT((bps == 1 || bps == 2) && ncomps > 0 &&
+           ncomps <= RS_MAX_COMPONENTS, "Invalid image sample format") ;
+
+  rs_put_uvar(&w->def, id) ;
+  rs_put_uvar(&w->def, (uint32)width) ;
+  rs_put_uvar(&w->def, (uint32)height) ;
+  rs_put_uvar(&w->def, (uint32)box->x1) ;
+  rs_put_uvar(&w->def, (uint32)box->y1) ;
+  rs_put_uvar(&w->def, (uint32)box->x2) ;
+  rs_put_uvar(&w->def, (uint32)box->y2) ;
+  rs_put_uvar(&w->def, (uint32)bps) ;
+  rs_put_uvar(&w->def, (uint32)ncomps) ;
+  for ( i = 0 ; i < ncomps ; ++i )
+    rs_put_svar(&w->def, colorants[i]) ;
+  if ( w->def.failed )
+    return error_handler(VMERROR) ;
+
+  len = (uint32)w->def.size + (uint32)(box->x2 - box->x1 + 1) *
+    (uint32)(box->y2 - box->y1 + 1) * (uint32)(ncomps * bps) ;
+  if ( !rs_flush_ops(w) || !rs_emit_head(w, RS_REC_IMAGE, len) ||
+       !rs_send(w, w->def.data, w->def.size) )
+    return FALSE ;
+  w->def.size = 0 ;
+  return TRUE ;
+}
 
-    npairs = decode_runs(rle, size, nib, runs);
-    rle += size;
+/**
+ * Send a row of image samples. Two byte samples are in native byte order,
+ * and are sent least significant byte first.
+ */
+static Bool rs_image_row(RS_WRITER *w, const void *values, int32 n, int32 bps)
+{
+  const uint16 *values16 = values ;
+  int32 i ;
+
+  if ( bps == 1 )
+    return rs_send(w, (uint8 *)values, n) ;
+
+  w->row.size = 0 ;
+  for ( i = 0 ; i < n ; ++i )
+    rs_put_u16(&w->row, values16[i]) ;
+  if ( w->row.failed )
+    return error_handler(VMERROR) ;
+  return rs_send(w, w->row.data, w->row.size) ;
+}
 
-    if ( npairs == 0 )
-      rs_write(rs, 15, RS_NIBBLE); /* 15 == blank line ? */
-    else if ( npairs <= 11 )
-      rs_write(rs, npairs, RS_NIBBLE);
+/**
+ * Find the image id of an image or image mask, defining it if it is new.
+ * The samples are expanded as the renderer would expand them.
+ *
+ * \return FALSE on error. If the image cannot be written, \a id is
+ *         RS_NO_ID.
+ */
+static Bool rs_image_def(RS_WRITER *w, IMAGEOBJECT *image, uint32 *id)
+{
+  IM_EXPAND *ime = image->ime ;
+  const ibbox_t *box = &image->imsbbox ;
+  const COLORANTINDEX *cis ;
+  int32 colorants[RS_MAX_COMPONENTS], planes[RS_MAX_COMPONENTS] ;
+  int32 ncomps, bps, bw, bh, format, i, y ;
+  Bool isnew ;
+
+  *id = RS_NO_ID ;
+  if ( image->ims == NULL || ime == NULL || im_converting_on_the_fly(ime) )
+    return TRUE ;
+  format = im_expandformat(ime) ;
+  if ( format == ime_as_is || format == ime_as_is_decoded )
+    return TRUE ;
+
+  ncomps = im_expandlplanes(ime) ;
+  bps = im_expandobpp(ime) >> 3 ;
+  bw = box->x2 - box->x1 + 1 ;
+  bh = box->y2 - box->y1 + 1 ;
+  if ( ncomps <= 0 || ncomps > RS_MAX_COMPONENTS || bw <= 0 || bh <= 0 ||
+       bw > RS_MAX_IMAGE_BYTES / (ncomps * bps) / bh )
+    return TRUE ;
+
+  cis = im_getcis(ime) ;
+  for ( i = 0 ; i < ncomps ; ++i ) {
+    if ( cis[i] == COLORANTINDEX_ALL )
+      colorants[i] = RS_COLORANT_ALL ;
+    else if ( cis[i] >= 0 )
+      colorants[i] = (int32)cis[i] ;
     else
-    {
-      ; /* TEMP : NYI */
-    }
-    for ( nn = 0; nn < npairs*2; nn++ )
-      rs_write(rs, runs[nn], RS_VAL4);
-    if ( nlines > 1 )
-    {
-      rs_write(rs, 14, RS_NIBBLE);
-      rs_write(rs, nlines-1, RS_VAL4);
-    }
+      return TRUE ; /* Alpha, or an unknown colorant. */
+    planes[i] = i ;
   }
-  nn = (int32)((&(rs->cmds[rs->size]) - nnibbles - 2)*2);
-  if ( rs->nib )
-  {
-    rs_write(rs, 0, RS_NIBBLE);
-    nn++;
+
+  if ( !rs_idmap_lookup(&w->images, image, id, &isnew) )
+    return FALSE ;
+
+  if ( isnew ) {
+    if ( !rs_image_begin(w, *id, image->geometry.w, image->geometry.h, box,
+                         bps, ncomps, colorants) )
+      return FALSE ;
+    for ( y = box->y1 ; y <= box->y2 ; ++y ) {
+      void *values ;
+      int32 nrows ;
+
+      values = im_expandread(ime, image->ims, FALSE, box->x1, y, bw, &nrows,
+                             planes, (unsigned int)ncomps) ;
+      if ( values == NULL || !rs_image_row(w, values, bw * ncomps, bps) )
+        return FALSE ;
+    }
   }
-  nnibbles[0] = (uint8)(nn&0xff);
-  nnibbles[1] = (uint8)((nn>>8)&0xff);
+
+  return TRUE ;
 }
 
-static void rs_cachechar(RSS *rss, CHARCACHE *cc, RS_BAND_BLOCK *rs, FORM *form)
+/**
+ * Write the geometry of an image.
+ */
+static void rs_image_geometry(RS_WRITER *w, const im_transform_t *geometry)
 {
-  int32 i;
+  rs_put_svar(&w->ops, geometry->tx) ;
+  rs_put_svar(&w->ops, geometry->ty) ;
+  rs_put_svar(&w->ops, geometry->wx) ;
+  rs_put_svar(&w->ops, geometry->wy) ;
+  rs_put_svar(&w->ops, geometry->hx) ;
+  rs_put_svar(&w->ops, geometry->hy) ;
+}
 
-  for ( i = 0; i < 256; i++ )
-  {
-    if ( rss->ccache[i].cached && cc == rss->ccache[i].cc &&
-         cc->rlesize == rss->ccache[i].rlesize &&
-         cc->glyphname._d1.vals.name == rss->ccache[i].name )
-      return;
+/**
+ * Write an image, with its mask if it has one, or an image mask.
+ *
+ * \return FALSE on error. \a written is FALSE if the image could not be
+ *         written.
+ */
+static Bool rs_lobj_image(RS_WRITER *w, DL_STATE *page, LISTOBJECT *lobj,
+                          Bool *written)
+{
+  IMAGEOBJECT *image = lobj->dldata.image ;
+  Bool ismask = (lobj->opcode == RENDER_mask) ;
+  uint32 id, maskid = RS_NO_ID ;
+
+  *written = FALSE ;
+  if ( !rs_image_def(w, image, &id) )
+    return FALSE ;
+  if ( id == RS_NO_ID )
+    return TRUE ;
+  if ( !ismask && image->mask != NULL ) {
+    if ( !rs_image_def(w, image->mask, &maskid) )
+      return FALSE ;
+    if ( maskid == RS_NO_ID )
+      return TRUE ;
   }
-  for ( i = 0; i < 256; i++ )
-  {
-    if ( !rss->ccache[i].cached )
-    {
-      rss->ccache[i].cached = TRUE;
-      rss->ccache[i].cc = cc;
-      rss->ccache[i].rlesize = cc->rlesize;
-      rss->ccache[i].name = cc->glyphname._d1.vals.name;
-      rs_ouputrlechar(rs, i, form);
-      return;
-    }
+
+  if ( !rs_lobj_state(w, page, lobj, ismask) )
+    return FALSE ;
+
+  if ( ismask ) {
+    rs_put_byte(&w->ops, RS_OP_IMAGEMASK) ;
+    rs_put_uvar(&w->ops, id) ;
+    rs_image_geometry(w, &image->geometry) ;
+  } else {
+    rs_put_byte(&w->ops, RS_OP_IMAGE) ;
+    rs_put_uvar(&w->ops, id) ;
+    rs_put_uvar(&w->ops, maskid + 1) ; /* RS_NO_ID + 1 is 0, no mask. */
+    rs_image_geometry(w, &image->geometry) ;
+    if ( maskid != RS_NO_ID )
+      rs_image_geometry(w, &image->mask->geometry) ;
   }
+  *written = TRUE ;
+  return TRUE ;
 }
 
-static uint8 rs_cacheid(RSS *rss, CHARCACHE *cc)
-{
-  int32 i;
+/** State of the walk of a Gouraud object's decomposition. */
+typedef struct RS_GOURAUD {
+  uintptr_t flags ;       /**< Subdivision flags being used. */
+  int32 bits ;            /**< Number of flags left. */
+  p_ncolor_t *nextcolor ; /**< Next subdivision colour or flags. */
+} RS_GOURAUD ;
 
-  for ( i = 0; i < 256; i++ )
-  {
-    if ( rss->ccache[i].cached && cc == rss->ccache[i].cc &&
-         cc->rlesize == rss->ccache[i].rlesize &&
-         cc->glyphname._d1.vals.name == rss->ccache[i].name )
-      return (uint8)i;
+/**
+ * Write the linear triangles of a Gouraud object's decomposition, walking
+ * it as render_gouraud_sub() does. Coordinates are in 1/RS_SUBPIXEL pixels.
+ */
+static Bool rs_gouraud_sub(RS_WRITER *w, RS_GOURAUD *g, int32 coords[6],
+                           p_ncolor_t colors[3])
+{
+  uintptr_t mask ;
+  uint32 ids[3] ;
+  int32 i, j ;
+
+  if ( --g->bits < 0 ) { /* Get a new flag word if no more bits */
+    g->bits = sizeof(uintptr_t) * 8 - 1 ;
+    g->flags = *((uintptr_t *)g->nextcolor) ;
+    g->nextcolor += 1 ;
   }
-  return 255;
+  mask = (uintptr_t)1 << g->bits ;
+
+  if ( (g->flags & mask) != 0 ) { /* Subdivided */
+    int32 scoords[6] ;
+    p_ncolor_t vcolors[3], scolors[3] ;
+
+    /* The colour between vertices i and j is vcolors[(i + j) ^ 3]. */
+    vcolors[2] = g->nextcolor[0] ;
+    vcolors[0] = g->nextcolor[1] ;
+    vcolors[1] = g->nextcolor[2] ;
+    g->nextcolor += 3 ;
+
+    /* v0, v01, v20; v01, v1, v12; v20, v12, v2 */
+    for ( j = 0 ; j < 3 ; ++j ) {
+      scoords[j + j] = coords[j + j] ;
+      scoords[j + j + 1] = coords[j + j + 1] ;
+      scolors[j] = colors[j] ;
+      for ( i = (j + 1) % 3 ; i != j ; i = (i + 1) % 3 ) {
+        scoords[i + i] = coords[i + i] + (coords[j + j] - coords[i + i]) / 2 ;
+        scoords[i + i + 1] = coords[i + i + 1] +
+          (coords[j + j + 1] - coords[i + i + 1]) / 2 ;
+        scolors[i] = vcolors[(j + i) ^ 3] ;
+      }
+      if ( !rs_gouraud_sub(w, g, scoords, scolors) )
+        return FALSE ;
+    }
+    /* v01, v20, v12 */
+    for ( i = j = 0 ; i < 3 ; ++i, j = (j + 2) % 3 ) {
+      int32 k = (j + 1) % 3 ;
+
+      scoords[i + i] = coords[j + j] + (coords[k + k] - coords[j + j]) / 2 ;
+      scoords[i + i + 1] = coords[j + j + 1] +
+        (coords[k + k + 1] - coords[j + j + 1]) / 2 ;
+      scolors[i] = vcolors[(j + k) ^ 3] ;
+    }
+    return rs_gouraud_sub(w, g, scoords, scolors) ;
+  }
+
+  for ( i = 0 ; i < 3 ; ++i )
+    if ( !rs_ncolor_id(w, colors[i], &ids[i]) )
+      return FALSE ;
+  rs_put_byte(&w->ops, RS_OP_TRIANGLE) ;
+  for ( i = 0 ; i < 6 ; ++i )
+    rs_put_svar(&w->ops, coords[i]) ;
+  for ( i = 0 ; i < 3 ; ++i )
+    rs_put_uvar(&w->ops, ids[i]) ;
+  return rs_ops_check(w) ;
 }
 
-static void rs_page_defines(DLREF *dl, RS_BAND_BLOCK *rs, RSS *rss)
+/**
+ * Write a Gouraud shaded triangle as the linear triangles it is rendered
+ * as.
+ */
+static Bool rs_lobj_gouraud(RS_WRITER *w, DL_STATE *page, LISTOBJECT *lobj)
 {
-  int32 i;
+  GOURAUDOBJECT *gour = load_dldata(lobj) ;
+  p_ncolor_t *colors = (p_ncolor_t *)(gour + 1) ;
+  RS_GOURAUD g ;
+  int32 coords[6], i ;
 
-  for ( i = 0; i < 256; i++ )
-    rss->ccache[i].name = NULL, rss->ccache[i].cached = FALSE;
+  if ( !rs_lobj_state(w, page, lobj, FALSE) )
+    return FALSE ;
 
-  for ( ; dl != NULL; dl = dlref_next(dl) )
-  {
-    LISTOBJECT *lobj = dlref_lobj(dl);
+  g.flags = gour->flags ;
+  g.bits = sizeof(uintptr_t) * 8 ;
+  g.nextcolor = colors + 3 ;
 
-    if ( lobj->opcode  == RENDER_char )
-    {
-      DL_CHARS *dlchars = lobj->dldata.text;
+  /* Vertices are at the centres of their pixels, as the renderer rounds
+     them. */
+  for ( i = 0 ; i < 6 ; ++i )
+    coords[i] = gour->coords[i] * RS_SUBPIXEL + RS_SUBPIXEL / 2 ;
 
-      for ( i = 0; i < dlchars->nchars; i++ )
-      {
-        FORM *form = dlchars->ch[i].form;
-        CHARCACHE *cc = NULL;
+  return rs_gouraud_sub(w, &g, coords, colors) ;
+}
 
-        if ( form->type == FORMTYPE_CHARCACHE )
-        {
-          cc = ((CHARCACHE *)form);
-          form = cc->thebmapForm;
-        }
+static Bool rs_dl_object(DL_FORALL_INFO *info) ;
 
-        if ( form->type >= FORMTYPE_CACHERLE1 &&
-             form->type <= FORMTYPE_CACHERLE8 )
-          rs_cachechar(rss, cc, rs, form);
-      }
-    }
+/**
+ * Write a group, with its contents.
+ */
+static Bool rs_lobj_group(RS_WRITER *w, DL_FORALL_INFO *info)
+{
+  DL_FORALL_INFO sub ;
+  HDL *hdl = groupHdl(info->lobj->dldata.group) ;
+  Bool ok ;
+
+  if ( hdl == NULL || w->depth >= RS_MAX_GROUP_DEPTH ) {
+    ++w->nomitted ;
+    return TRUE ;
   }
+
+  rs_put_byte(&w->ops, RS_OP_GROUP) ;
+  rs_put_u16(&w->ops, dl_color_opacity(info->lobj->p_ncolor)) ;
+  ++w->nobjects ;
+
+  /* The group's contents are walked here, rather than by dl_forall(), so
+     the end of the group is known. */
+  sub = *info ;
+  sub.hdl = hdl ;
+  sub.inflags &= ~DL_FORALL_DLRANGE ;
+  ++w->depth ;
+  ok = dl_forall(&sub, rs_dl_object) ;
+  --w->depth ;
+
+  rs_put_byte(&w->ops, RS_OP_ENDGROUP) ;
+  return ok && rs_ops_check(w) ;
 }
 
-static void rs_char(LISTOBJECT *lobj, RS_BAND_BLOCK *rs, RSS *rss)
+/**
+ * dl_forall() callback writing one display list object.
+ */
+static Bool rs_dl_object(DL_FORALL_INFO *info)
 {
-  DL_CHARS *dlchars = lobj->dldata.text;
-  int32 i;
+  RS_WRITER *w = info->data ;
+  LISTOBJECT *lobj = info->lobj ;
+  STATEOBJECT *state = lobj->objectstate ;
+  uint32 id ;
+
+  switch ( lobj->opcode ) {
+  case RENDER_hdl:
+    { /* Replays render objects which are not at their own positions, and
+         have no stream representation. */
+      dcoord dx, dy ;
+
+      if ( hdlReplayOf(lobj->dldata.hdl, &dx, &dy) != NULL )
+        ++w->nomitted ;
+    }
+    return TRUE ;
+  case RENDER_void:
+  case RENDER_vignette: /* Their objects are visited by dl_forall(). */
+  case RENDER_shfill:
+    return TRUE ;
+  case RENDER_erase:
+    if ( !rs_ncolor_id(w, lobj->p_ncolor, &id) )
+      return FALSE ;
+    rs_op_color(w, id) ;
+    rs_op_erase(w) ;
+    ++w->nobjects ;
+    return rs_ops_check(w) ;
+  case RENDER_group:
+    return rs_lobj_group(w, info) ;
+  }
 
-  rs_color(lobj, rs, rss);
+  if ( state == NULL || state->patternstate != NULL ) {
+    ++w->nomitted ;
+    return TRUE ;
+  }
 
-  for ( i = 0; i < dlchars->nchars; i++ )
-  {
-    FORM *form = dlchars->ch[i].form;
-    dcoord x   = dlchars->ch[i].x;
-    dcoord y   = dlchars->ch[i].y;
-    CHARCACHE *cc = NULL;
-
-    if ( form->type == FORMTYPE_CHARCACHE )
-    {
-      cc = ((CHARCACHE *)form);
-      form = cc->thebmapForm;
+  switch ( lobj->opcode ) {
+  case RENDER_rect:
+    if ( !rs_lobj_state(w, info->page, lobj, TRUE) )
+      return FALSE ;
+    rs_op_rect(w, &lobj->bbox) ;
+    break ;
+
+  case RENDER_char: {
+    DL_CHARS *text = lobj->dldata.text ;
+    int32 i ;
+
+    /* Define all of the glyphs first, so no definitions are emitted
+       between the object's commands. */
+    for ( i = 0 ; i < text->nchars ; ++i ) {
+      if ( !rs_form_mask(w, text->ch[i].form, &id) )
+        return FALSE ;
+      if ( id == RS_NO_ID && text->ch[i].form->type != FORMTYPE_BLANK ) {
+        ++w->nomitted ;
+        return TRUE ;
+      }
     }
+    if ( !rs_lobj_state(w, info->page, lobj, TRUE) )
+      return FALSE ;
+    for ( i = 0 ; i < text->nchars ; ++i ) {
+      if ( !rs_form_mask(w, text->ch[i].form, &id) )
+        return FALSE ;
+      if ( id != RS_NO_ID )
+        rs_op_mask(w, id, text->ch[i].x, text->ch[i].y) ;
+    }
+    break ;
+  }
+
+  case RENDER_quad:
+  case RENDER_fill: {
+    NFILLOBJECT quadfill, *nfill ;
+    NBRESS threads[4] ;
+    Bool isnew ;
+
+    if ( !rs_idmap_lookup(&w->masks, lobj, &id, &isnew) )
+      return FALSE ;
+    if ( isnew ) {
+      if ( lobj->opcode == RENDER_quad ) {
+        quad_to_nfill(lobj, &quadfill, threads) ;
+        nfill = &quadfill ;
+      } else
+        nfill = load_dldata(lobj) ;
+      if ( !rs_scan_mask(w, id, nfill, nfill->type, &lobj->bbox, FALSE) )
+        return FALSE ;
+    }
+    if ( !rs_lobj_state(w, info->page, lobj, TRUE) )
+      return FALSE ;
+    rs_op_mask(w, id, lobj->bbox.x1, lobj->bbox.y1) ;
+    break ;
+  }
 
-    if ( form->type >= FORMTYPE_CACHERLE1 &&
-         form->type <= FORMTYPE_CACHERLE8 )
-    {
-      uint8 id = rs_cacheid(rss, cc);
+  case RENDER_image:
+  case RENDER_mask: {
+    Bool written ;
 
-      rs_write(rs, 0x8C, RS_BYTE);
-      rs_write(rs, id, RS_BYTE);
-      rs_write(rs, x, RS_OFF16);
-      rs_write(rs, y-rs->y0, RS_SIGN8);
+    if ( !rs_lobj_image(w, info->page, lobj, &written) )
+      return FALSE ;
+    if ( !written ) {
+      ++w->nomitted ;
+      return TRUE ;
     }
+    break ;
   }
+
+  case RENDER_gouraud:
+    if ( !rs_lobj_gouraud(w, info->page, lobj) )
+      return FALSE ;
+    break ;
+
+  default:
+    /* Backdrops, cells and recombine patches are not written. */
+    ++w->nomitted ;
+    return TRUE ;
+  }
+
+  ++w->nobjects ;
+  return rs_ops_check(w) ;
 }
 
-static void rs_moveto(RS_BAND_BLOCK *rs, int32 x, int32 y)
+/** Device file the stream is written to. */
+typedef struct RS_FILE {
+  DEVICELIST *dev ;
+  DEVICE_FILEDESCRIPTOR fd ;
+#if defined(ASSERT_BUILD)
+  RS_BUFFER copy ;        /**< Copy of the stream, to check it reads back. */
+#endif
+} RS_FILE ;
+
+#if defined(ASSERT_BUILD)
+static void rs_check_stream(const RS_WRITER *w, const uint8 *stream,
+                            int32 len) ;
+#endif
+
+static Bool rs_file_sink(void *data, uint8 *buf, int32 len)
 {
-  rs_write(rs, 0x80, RS_BYTE);
-  rs_write(rs, x, RS_DBYTE);
-  rs_write(rs, y, RS_UNS8);
+  RS_FILE *file = data ;
+
+#if defined(ASSERT_BUILD)
+  rs_put_bytes(&file->copy, buf, len) ;
+#endif
+  if ( (*theIWriteFile(file->dev))(file->dev, file->fd, buf, len) != len )
+    return device_error_handler(file->dev) ;
+  return TRUE ;
 }
 
-static void rs_image(LISTOBJECT *lobj, RS_BAND_BLOCK *rs)
+/**
+ * Write the display list of a page as a Rainstorm stream.
+ */
+static Bool rs_write_page(DL_STATE *page)
 {
-  IMAGEOBJECT *im = lobj->dldata.image;
-  int32 xx = im->bbox.x1;
-  int32 yy = im->bbox.y1;
-  int32 w = im->bbox.x2 - im->bbox.x1;
-  int32 h = im->bbox.y2 - im->bbox.y1;
-  int32 x, y, colorant;
-  uint8 *compsize, *compdata;
+  RS_WRITER w ;
+  RS_FILE file ;
+  DL_FORALL_INFO info ;
+  uint8 name[64] ;
+  Bool ok ;
+
+  if ( (file.dev = find_device((uint8 *)"os")) == NULL )
+    return error_handler(UNDEFINEDFILENAME) ;
+  swcopyf(name, (uint8 *)"rainstorm-%d-%d.rs",
+          page->job_number, (int32)page->pageno) ;
+  if ( (file.fd = (*theIOpenFile(file.dev))(file.dev, name,
+                                            SW_WRONLY|SW_CREAT|SW_TRUNC)) < 0 )
+    return device_error_handler(file.dev) ;
+#if defined(ASSERT_BUILD)
+  HqMemZero(&file.copy, sizeof(file.copy)) ;
+#endif
 
-  if ( w <= 0 || h <= 0 )
-    return; /* safety valve */
+  ok = rs_writer_begin(&w, rs_file_sink, &file, page->job_number,
+                       (int32)page->pageno, page->page_w, page->page_h,
+                       page->band_lines) ;
+  if ( ok ) {
+    info.page = page ;
+    info.hdl = dlPageHDL(page) ;
+    info.inflags = DL_FORALL_SHFILL ;
+    info.data = &w ;
+    ok = dl_forall(&info, rs_dl_object) && rs_writer_end(&w) ;
+  }
+#if defined(ASSERT_BUILD)
+  /* The copy is dropped rather than failing the page if it can't be held. */
+  if ( ok && !file.copy.failed )
+    rs_check_stream(&w, file.copy.data, file.copy.size) ;
+  rs_buffer_free(&file.copy) ;
+#endif
+  rs_writer_free(&w) ;
 
-  if ( im->ims == NULL || im_storebpp(im->ims) != 8 )
-    return;
+  if ( (*theICloseFile(file.dev))(file.dev, file.fd) < 0 && ok )
+    ok = device_error_handler(file.dev) ;
 
-  rs_moveto(rs, xx, yy);
-  rs_write(rs, 0x87, RS_BYTE);
-  rs_write(rs, im->rw, RS_UNS8);
-  rs_write(rs, im->rh, RS_UNS8);
-  rs_write(rs, 0, RS_UNS8);
-  rs_write(rs, 0, RS_UNS8);
-  rs_write(rs, im->rw, RS_UNS8);
-  rs_write(rs, im->rh, RS_UNS8);
-  rs_write(rs, w, RS_UNS8);
-  rs_write(rs, h, RS_UNS8);
-  rs_write(rs, 0, RS_BYTE); /* uncompress 8 bit RGB */
-  compsize = &(rs->cmds[rs->size]);
-  rs_write(rs, 0, RS_DBYTE); /* space for compressed size */
-  rs_write(rs, 0, RS_DBYTE); /* space for compressed size */
-  compdata = &(rs->cmds[rs->size]);
+  return ok ;
+}
 
-  for ( y = 0; y < im->rh; y++ )
-  {
-    for ( colorant = 0; colorant < 3; colorant++ )
-    {
-      for ( x = 0; x < im->rw; )
-      {
-        int32 impixels;
-        uint8 *imdata;
-
-        im_storeread(im->ims, x, y, colorant, &imdata, &impixels);
-        if ( x + impixels > im->rw )
-          impixels = im->rw - x;
-        HqMemCpy(compdata, imdata, impixels);
-        rs->size += impixels;
-        compdata += impixels;
-        x += impixels;
-      }
-    }
+void rainstorm(DL_STATE *page)
+{
+  corecontext_t *context = get_core_context() ;
+
+  if ( context->systemparams->Rainstorm == 0 )
+    return ;
+
+  if ( !rs_write_page(page) ) {
+    monitorf(UVM("%%%%[ Warning: Rainstorm stream for page %d could not be written ]%%%%\n"),
+             (int32)page->pageno) ;
+    error_clear_context(context->error) ;
   }
-  compsize[0] = (uint8)(((int32)(compdata - compsize - 4))&0xff);
-  compsize[1] = (uint8)(((int32)((compdata - compsize - 4)>>8))&0xff);
-  compsize[2] = (uint8)(((int32)((compdata - compsize - 4)>>16))&0xff);
-  compsize[3] = (uint8)(((int32)((compdata - compsize - 4)>>24))&0xff);
 }
 
-static void rs_rect(LISTOBJECT *lobj, RS_BAND_BLOCK *rs, RSS *rss)
-{
-  int32 x = lobj->bbox.x1;
-  int32 y = lobj->bbox.y1;
-  int32 w = lobj->bbox.x2 - x;
-  int32 h = lobj->bbox.y2 - y;
+#endif /* !BUILD_RSREAD } */
 
-  if ( y < (int32)rs->y0 )
-    { h -= rs->y0-y; y = rs->y0; }
-  if ( y + h - 1 > (int32)rs->y1 )
-    { h = (int32)rs->y1 - y + 1; }
+/* ========================================================================== */
+#if defined(ASSERT_BUILD) || defined(BUILD_RSREAD) /* { Stream reader */
 
-  if ( h > 0 )
-  {
-    y -= (int32)rs->y0;
-    rs_color(lobj, rs, rss);
-    rs_moveto(rs, x, y);
+/** Bounds checked position in a stream. */
+typedef struct RS_CURSOR {
+  const uint8 *p ;
+  const uint8 *end ;
+  Bool bad ;        /**< Read past the end, or found a malformed value. */
+} RS_CURSOR ;
 
-    rs_write(rs, 0x85, RS_BYTE);
-    rs_write(rs, w, RS_UNS8);
-    rs_write(rs, h, RS_UNS8);
+static uint32 rs_get_byte(RS_CURSOR *c)
+{
+  if ( c->p >= c->end ) {
+    c->bad = TRUE ;
+    return 0 ;
   }
+  return *c->p++ ;
 }
 
-static void rs_hdl(DLREF *dl, RS_BAND_BLOCK *rs, RSS *rss)
+static uint32 rs_get_u16(RS_CURSOR *c)
 {
-  for ( ; dl != NULL; dl = dlref_next(dl) )
-  {
-    LISTOBJECT *lobj = dlref_lobj(dl);
-
-    switch ( lobj->opcode )
-    {
-      case RENDER_rect:
-        rs_rect(lobj, rs, rss);
-        break;
-
-      case RENDER_quad:
-        /** \todo BMJ 09-Jun-08 :  : rs_quad(lobj, rs, rss); */
-        break;
-
-      case RENDER_fill:
-        rs_nfill(lobj, rs, rss);
-        break;
-
-      case RENDER_char:
-        rs_char(lobj, rs, rss);
-        break;
-
-      case RENDER_image:
-        rs_image(lobj, rs);
-        break;
-      case RENDER_hdl:
-        rs_hdl(hdlOrderList(lobj->dldata.hdl, rs, rss);
-        break;
-      case RENDER_void:
-      case RENDER_erase:
-      case RENDER_mask:
-      case RENDER_vignette:
-      case RENDER_gouraud:
-      case RENDER_shfill:
-      case RENDER_shfill_patch:
-      case RENDER_group:
-      case RENDER_cell:
-      case RENDER_backdrop:
-      default:
-        break;
-    }
-  }
+  uint32 lo = rs_get_byte(c) ;
+  return lo | (rs_get_byte(c) << 8) ;
 }
 
-static void rs_band(DLREF *dl, RS_BAND_BLOCK *rs, RSS *rss)
+static uint32 rs_get_u32(RS_CURSOR *c)
 {
-  static uint8 *rsbuf = NULL;
-
-  if ( rsbuf == NULL )
-    rsbuf = malloc(64*1024*1024);
-  rs->size = 0;
-  rs->nib  = FALSE;
-  rs->cmds = rsbuf;
-
-  if ( rs->y0 == 0 && rs->y1 == 0 )
-  {
-    rs_page_defines(dl, rs, rss);
-    return;
-  }
-  rs_bandinit(rss);
-  rs_hdl(dl, rs, rss);
+  uint32 lo = rs_get_u16(c) ;
+  return lo | (rs_get_u16(c) << 16) ;
 }
 
-static FILE *rs_open()
+static uint32 rs_get_uvar(RS_CURSOR *c)
 {
-  FILE *f;
-  int32 page;
-  char name[32];
-
-  for ( page = 0; page < 10000; page++ )
-  {
-    sprintf(name,"rip%d.rs",page);
-    if ( ( f = fopen(name,"r")) == NULL )
-    {
-      f = fopen(name,"wb");
-      return f;
-    }
-    fclose(f);
-  }
-  return NULL;
-}
-
-void rainstorm(const DL_STATE* self)
-{
-  FILE *f = rs_open();
-  RS_ID_BLOCK rs_id_block;
-  RS_JOB_BLOCK rs_job_block;
-  RS_PAGE_BLOCK rs_page_block;
-  RS_BAND_BLOCK rs_band_block;
-  RSS rss;
-  uint32 meta;
-  int32 bandi;
-
-  rs_id_block.magic[0] = RS_MAGIC0;
-  rs_id_block.magic[1] = RS_MAGIC1;
-  rs_id_block.version[0] = 0;
-  rs_id_block.version[1] = 0;
-  fwrite(&rs_id_block, 1, sizeof(rs_id_block), f);
-
-  rs_job_block.id = self->job_number;
-  rs_job_block.meta_size = 4;
-  meta = 0x12345678;
-  fwrite(&rs_job_block, 1, sizeof(rs_job_block), f);
-  fwrite(&meta, 1, rs_job_block.meta_size, f);
-
-  rs_page_block.id = self->page_number;
-  rs_page_block.rasterStyle = 0;
-  rs_page_block.pageWidth = self->page_w;
-  rs_page_block.pageHeight = self->page_h;
-  rs_page_block.colors = 3;
-  rs_page_block.bits   = 8;
-  rs_page_block.spare1 = rs_page_block.spare2 = 0;
-  rs_page_block.bg[0] = rs_page_block.bg[1] = rs_page_block.bg[2] = 0xff;
-  rs_page_block.bg[3] = 0x0;
-  rs_page_block.meta_size = 4;
-  fwrite(&rs_page_block, 1, sizeof(rs_page_block), f);
-  meta = 0x23456789;
-  fwrite(&meta, 1, rs_page_block.meta_size, f);
-
-  rs_band_block.y0 = rs_band_block.y1 = 0;
-  rs_band(get_dl_orderlist(self), &rs_band_block, &rss);
-  {
-    fwrite(&(rs_band_block.size), 1, sizeof(rs_band_block.size), f);
-    fwrite(rs_band_block.cmds, 1, rs_band_block.size, f);
-  }
-  for ( bandi = 0; bandi < self->sizedisplaylist; bandi++ )
-  {
-    rs_band_block.y0 = bandi*self->band_lines;
-    rs_band_block.y1 = (bandi+1)*self->band_lines-1;
-    if ( rs_band_block.y1 > (uint32)(self->page_h) )
-        rs_band_block.y1 = (uint32)(self->page_h);
-
-    rs_band(get_dl_head(self, bandi), &rs_band_block, &rss);
-    if ( rs_band_block.size > 0 )
-    {
-      fwrite(&rs_band_block, 1, 12, f);
-      fwrite(rs_band_block.cmds, 1, rs_band_block.size, f);
+  uint32 val = 0, b ;
+  int32 shift = 0 ;
+
+  do {
+    b = rs_get_byte(c) ;
+    if ( shift == 28 && b > 0x0f ) {
+      c->bad = TRUE ;
+      return 0 ;
     }
-  }
-  meta = 0xffffffff;
-  fwrite(&meta, 1, sizeof(uint32), f);
-  fwrite(&meta, 1, sizeof(uint32), f);
-  fclose(f);
-}
+    val |= (b & 0x7f) << shift ;
+    shift += 7 ;
+  } while ( (b & 0x80) != 0 && !c->bad ) ;
 
-#else  /* !RS_CODE_ENABLED */
+  return val ;
+}
 
-#ifndef BUILD_RSREAD
+static int32 rs_get_svar(RS_CURSOR *c)
+{
+  uint32 val = rs_get_uvar(c) ;
+  return (val & 1) != 0 ? (int32)~(val >> 1) : (int32)(val >> 1) ;
+}
 
-#include "core.h"
-#include "displayt.h"
+/** Largest coordinate magnitude accepted, so coordinate arithmetic cannot
+    overflow. */
+#define RS_MAX_COORD 0x1fffffff
 
 /**
- * Dummy stub for when rainstorm prototype code is not
- * compiled in.
+ * Read a coordinate, marking the cursor bad if it is out of range.
  */
-void rainstorm(const DL_STATE *self)
+static int32 rs_get_coord(RS_CURSOR *c)
 {
-  UNUSED_PARAM(const DL_STATE *, self);
-}
-
-#endif /* BUILD_RSREAD */
-
-#endif /* RS_CODE_ENABLED } */
+  int32 val = rs_get_svar(c) ;
 
-/*
- * ============================================================================
- */
+  if ( val < -RS_MAX_COORD || val > RS_MAX_COORD )
+    c->bad = TRUE ;
+  return val ;
+}
 
-#if BUILD_RSREAD /* { */
+/** A mask definition in a stream. */
+typedef struct RS_MASK_DEF {
+  int32 w, h ;
+  const uint8 *rows ;     /**< Row blocks; NULL if not defined. */
+  const uint8 *end ;
+} RS_MASK_DEF ;
+
+/** An image definition in a stream. */
+typedef struct RS_IMAGE_DEF {
+  int32 w, h ;            /**< Size of the image. */
+  int32 x1, y1, x2, y2 ;  /**< Stored samples of the image, inclusive. */
+  int32 bps ;             /**< Bytes per sample. */
+  int32 ncomps ;          /**< Components of each sample. */
+  int32 channel[RS_MAX_COMPONENTS] ; /**< Raster channel of each component,
+                                          or -1 for all channels. */
+  const uint8 *samples ;  /**< Stored samples; NULL if not defined. */
+} RS_IMAGE_DEF ;
+
+/** Where a mask is placed on the page. */
+typedef struct RS_PLACED {
+  uint32 id ;
+  int32 x, y ;            /**< Page position of the mask's top left. */
+} RS_PLACED ;
+
+/** A painting object of the display list rebuilt from a stream. */
+typedef struct RS_ROBJ {
+  uint32 op ;             /**< The RS_OP_ command painting the object. */
+  uint32 alpha ;          /**< Opacity, including that of its groups. */
+  uint32 color[3] ;       /**< Colour ids; one for each triangle vertex. */
+  uint32 id ;             /**< Mask or image id. */
+  uint32 maskid ;         /**< Image mask id + 1, or 0. */
+  uint32 clipmasks ;      /**< First complex clip mask, in the reader's
+                               placed masks. */
+  uint32 nclipmasks ;     /**< Number of complex clip masks. */
+  int32 bbox[4] ;         /**< Pixels the object may paint: the intersection
+                               of its extent, its clip rectangle and the
+                               page, inclusive. */
+  int32 v[12] ;           /**< Rectangle, mask position, triangle vertices,
+                               or image and mask geometry. */
+} RS_ROBJ ;
+
+/** Rainstorm stream reader state. */
+typedef struct RS_READER {
+  const uint8 *stream ;
+  int32 len ;
+  uint32 job, page ;
+  int32 width, height, band_lines ;
+  uint32 flags, nobjects, nomitted ;
+  uint32 ncolors ;
+  const uint8 **colors ;  /**< Colour definitions by id, after the id. */
+  uint32 nmasks ;
+  RS_MASK_DEF *masks ;    /**< Mask definitions by id. */
+  uint32 nimages ;
+  RS_IMAGE_DEF *images ;  /**< Image definitions by id. */
+  uint32 maxchannels ;
+  uint32 nchannels ;      /**< Number of colorants in the raster. */
+  int32 *channels ;       /**< Colorant of each raster channel, ascending. */
+  uint16 *colorvals ;     /**< Channel values of each colour. */
+  uint8 *colorset ;       /**< Channels each colour paints. */
+  uint32 nrobjs ;
+  RS_ROBJ *robjs ;        /**< The rebuilt display list. */
+  uint32 nplaced ;
+  RS_PLACED *placed ;     /**< Complex clip masks of the objects. */
+  uint8 *cover ;          /**< A row of pixel coverage, while rendering. */
+} RS_READER ;
 
-/*
- * Code for stand alone tool rsread.exe
- *
- * Read the contents of a Rainstorm graphics stream file and either
- *   a) Create an ascii listing of the contents or
- *   b) Convert it to a simple ".bmp" raster file
+/**
+ * Check a mask's row blocks, which must cover exactly its height.
  */
-
-#define _CRT_SECURE_NO_DEPRECATE 1
-#include <stdio.h>
-#include <malloc.h>
-#include <signal.h>
-typedef short          int16;
-typedef unsigned short uint16;
-typedef unsigned long  uint32;
-typedef long           int32;
-typedef unsigned char  uint8;
-typedef int32          Bool;
-#define TRUE 1
-#define FALSE 0
-#include "rainstorm.h"
-
-void sigfunc(int sig)
+static Bool rs_read_mask_valid(RS_MASK_DEF *mask)
 {
-  printf("Got signal %d... exiting\n",sig);
-  exit(1);
+  RS_CURSOR c ;
+  int32 y = 0 ;
+
+  c.p = mask->rows ;
+  c.end = mask->end ;
+  c.bad = FALSE ;
+  while ( c.p < c.end && !c.bad ) {
+    uint32 rows = rs_get_uvar(&c), npairs = rs_get_uvar(&c), x = 0 ;
+
+    if ( rows == 0 || rows > (uint32)(mask->h - y) )
+      return FALSE ;
+    y += (int32)rows ;
+    while ( npairs-- > 0 && !c.bad ) {
+      x += rs_get_uvar(&c) ;
+      x += rs_get_uvar(&c) ;
+      if ( x > (uint32)mask->w )
+        return FALSE ;
+    }
+  }
+  return !c.bad && y == mask->h ;
 }
 
-void init_catch()
+static void rs_read_close(RS_READER *rs)
 {
-  signal(SIGINT, sigfunc);
-  signal(SIGABRT, sigfunc);
-  signal(SIGFPE, sigfunc);
-  signal(SIGILL, sigfunc);
-  signal(SIGSEGV, sigfunc);
-  signal(SIGTERM, sigfunc);
+  if ( rs->colors != NULL )
+    RS_FREE((void *)rs->colors, rs->ncolors * sizeof(rs->colors[0])) ;
+  if ( rs->masks != NULL )
+    RS_FREE(rs->masks, rs->nmasks * sizeof(rs->masks[0])) ;
+  if ( rs->images != NULL )
+    RS_FREE(rs->images, rs->nimages * sizeof(rs->images[0])) ;
+  if ( rs->channels != NULL )
+    RS_FREE(rs->channels, rs->maxchannels * sizeof(rs->channels[0])) ;
+  if ( rs->colorvals != NULL )
+    RS_FREE(rs->colorvals,
+            rs->ncolors * rs->nchannels * sizeof(rs->colorvals[0])) ;
+  if ( rs->colorset != NULL )
+    RS_FREE(rs->colorset, rs->ncolors * rs->nchannels) ;
+  if ( rs->robjs != NULL )
+    RS_FREE(rs->robjs, rs->nrobjs * sizeof(rs->robjs[0])) ;
+  if ( rs->placed != NULL )
+    RS_FREE(rs->placed, rs->nplaced * sizeof(rs->placed[0])) ;
+  if ( rs->cover != NULL )
+    RS_FREE(rs->cover, rs->width + 1) ;
+  rs->colors = NULL ;
+  rs->masks = NULL ;
+  rs->images = NULL ;
+  rs->channels = NULL ;
+  rs->colorvals = NULL ;
+  rs->colorset = NULL ;
+  rs->robjs = NULL ;
+  rs->placed = NULL ;
+  rs->cover = NULL ;
 }
 
-void error(char *message)
+/**
+ * Add a colorant to the raster channels, which are kept in ascending order.
+ */
+static void rs_read_add_channel(RS_READER *rs, int32 colorant)
 {
-  fprintf(stderr,"%s\n", message);
-  exit(1);
+  uint32 i ;
+
+  if ( colorant == RS_COLORANT_ALL )
+    return ;
+  for ( i = rs->nchannels ; i > 0 && rs->channels[i - 1] >= colorant ; --i )
+    if ( rs->channels[i - 1] == colorant )
+      return ;
+  HQASSERT(rs->nchannels < rs->maxchannels, "Too many channels") ;
+  if ( i < rs->nchannels )
+    memmove(&rs->channels[i + 1], &rs->channels[i],
+            (rs->nchannels - i) * sizeof(rs->channels[0])) ;
+  rs->channels[i] = colorant ;
+  ++rs->nchannels ;
 }
 
-typedef struct RS_RGB
+/**
+ * Find the raster channel of a colorant, or -1 for all channels.
+ */
+static int32 rs_read_channel(const RS_READER *rs, int32 colorant)
 {
-  unsigned char r, g, b;
-} RS_RGB;
+  uint32 lo = 0, hi = rs->nchannels ;
 
-typedef struct RS_COORD
-{
-  int32 x,y;
-} RS_COORD;
+  if ( colorant == RS_COLORANT_ALL )
+    return -1 ;
+  while ( lo < hi ) {
+    uint32 mid = (lo + hi) / 2 ;
 
-typedef struct RSS /* Rainstorm State */
-{
-  FILE *src, *dst;
-  RS_ID_BLOCK rs_id_block;
-  RS_JOB_BLOCK  *rs_job_block;
-  RS_PAGE_BLOCK *rs_page_block;
-  struct
-  {
-    uint32 size;
-    uint8 *ptr;
-  } page_defines;
-  RS_BAND_BLOCK band;
-  uint32 rasterWidth, rasterHeight;
-  uint8 *pageRaster;
-  /* state info */
-  int32 x,y;
-  uint8 rlemode;
-  RS_RGB color[256];
-  uint8 colori;
-  struct
-  {
-    int xx;
-  } rcache[256];
-} RSS;
-
-typedef struct BMP_HEADER
-{
-  int32 filesize;
-  int16 dum1, dum2;
-  int32 offset;
-
-  int32 size, width, height;
-  int16 planes, bits;
-  int32 compression, imagesize, xres, yres;
-  int32 ncolors, impcolors;
-} BMP_HEADER;
-
-int bmp_setup(RSS *rss)
-{
-  BMP_HEADER bmp;
-  int32 w = rss->rs_page_block->pageWidth;
-  int32 h = rss->rs_page_block->pageHeight;
-  int16 magic = 0x4D42;
-  int32 x, y;
-  int32 rw = ((w*3+3)/4)*4;
-  uint8 *bg = rss->rs_page_block->bg;
-
-  rss->rasterWidth  = rw;
-  rss->rasterHeight = h;
-
-  if ( ( rss->pageRaster = (uint8 *)malloc(rw*h)) == NULL )
-    return -1;
-
-  bmp.filesize = sizeof(bmp)+rw*h + sizeof(magic);
-  bmp.dum1 = bmp.dum2 = 0;
-  bmp.offset = sizeof(bmp) + sizeof(magic);
-
-  bmp.size        = 0x28;
-  bmp.width       = w;
-  bmp.height      = -h; /* invert raster sense */
-  bmp.planes      = 1;
-  bmp.bits        = 0x18;
-  bmp.compression = 0x0;
-  bmp.imagesize   = rw*h;
-  bmp.xres        = 2835; /* 72dpi */
-  bmp.yres        = 2835; /* 72dpi */
-  bmp.ncolors     = 0;
-  bmp.impcolors   = 0;
-
-  fwrite(&magic, 1, sizeof(magic), rss->dst);
-  fwrite(&bmp, 1, sizeof(bmp), rss->dst);
-
-  for ( y = 0 ; y < h; y++ )
-  {
-    for ( x = 0 ; x < w; x++ )
-    {
-      rss->pageRaster[3*(y*w+x)+0] = bg[0];
-      rss->pageRaster[3*(y*w+x)+1] = bg[1];
-      rss->pageRaster[3*(y*w+x)+2] = bg[2];
-    }
+    if ( rs->channels[mid] < colorant )
+      lo = mid + 1 ;
+    else
+      hi = mid ;
   }
-  return 1;
+  HQASSERT(lo < rs->nchannels && rs->channels[lo] == colorant,
+           "Colorant has no raster channel") ;
+  return (int32)lo ;
 }
 
-typedef struct NIBREAD
+/**
+ * Read the fields of an image definition, up to its samples.
+ *
+ * \return FALSE if the fields are malformed, or the samples are not the
+ *         rest of the record.
+ */
+static Bool rs_read_image_def(RS_CURSOR *r, RS_IMAGE_DEF *image,
+                              int32 colorants[RS_MAX_COMPONENTS])
 {
-  Bool nib;
-  uint8 *ptr;
-} NIBREAD;
+  uint32 rowbytes, size ;
+  int32 i, bw, bh ;
+
+  image->w = (int32)rs_get_uvar(r) ;
+  image->h = (int32)rs_get_uvar(r) ;
+  image->x1 = (int32)rs_get_uvar(r) ;
+  image->y1 = (int32)rs_get_uvar(r) ;
+  image->x2 = (int32)rs_get_uvar(r) ;
+  image->y2 = (int32)rs_get_uvar(r) ;
+  image->bps = (int32)rs_get_uvar(r) ;
+  image->ncomps = (int32)rs_get_uvar(r) ;
+  if ( r->bad || image->w <= 0 || image->w > RS_MAX_COORD ||
+       image->h <= 0 || image->h > RS_MAX_COORD ||
+       image->x1 < 0 || image->x1 > image->x2 || image->x2 >= image->w ||
+       image->y1 < 0 || image->y1 > image->y2 || image->y2 >= image->h ||
+       (image->bps != 1 && image->bps != 2) ||
+       image->ncomps <= 0 || image->ncomps > RS_MAX_COMPONENTS )
+    return FALSE ;
+  for ( i = 0 ; i < image->ncomps ; ++i ) {
+    colorants[i] = rs_get_svar(r) ;
+    if ( colorants[i] < RS_COLORANT_ALL )
+      return FALSE ;
+  }
+  if ( r->bad )
+    return FALSE ;
+
+  bw = image->x2 - image->x1 + 1 ;
+  bh = image->y2 - image->y1 + 1 ;
+  size = (uint32)(r->end - r->p) ;
+  if ( (uint32)bw > size / (uint32)(image->ncomps * image->bps) )
+    return FALSE ;
+  rowbytes = (uint32)bw * (uint32)(image->ncomps * image->bps) ;
+  if ( (uint32)bh > size / rowbytes || rowbytes * (uint32)bh != size )
+    return FALSE ;
+  image->samples = r->p ;
+  return TRUE ;
+}
 
-int32 rs_read(NIBREAD *nr, int32 encoding)
+/**
+ * Set the channel values of the colours.
+ */
+static Bool rs_read_colors(RS_READER *rs)
 {
-  int32 val;
-  uint8 *ptr = nr->ptr;
-
-  switch (encoding)
-  {
-    case RS_NIBBLE:
-      if ( nr->nib )
-      {
-        val = ptr[0]&0xF;
-        nr->nib = FALSE;
-        nr->ptr++;
+  uint32 id, i ;
+
+  if ( rs->ncolors == 0 )
+    return TRUE ;
+  if ( (rs->colorvals = RS_ALLOC(rs->ncolors * rs->nchannels *
+                                 sizeof(rs->colorvals[0]))) == NULL ||
+       (rs->colorset = RS_ALLOC(rs->ncolors * rs->nchannels)) == NULL )
+    return FALSE ;
+  HqMemZero(rs->colorvals, rs->ncolors * rs->nchannels * sizeof(rs->colorvals[0])) ;
+  HqMemZero(rs->colorset, rs->ncolors * rs->nchannels) ;
+
+  for ( id = 0 ; id < rs->ncolors ; ++id ) {
+    uint16 *vals = &rs->colorvals[id * rs->nchannels] ;
+    uint8 *set = &rs->colorset[id * rs->nchannels] ;
+    RS_CURSOR c ;
+    uint32 kind, n ;
+
+    if ( rs->colors[id] == NULL )
+      continue ;
+    c.p = rs->colors[id] ;
+    c.end = rs->stream + rs->len ;
+    c.bad = FALSE ;
+    kind = rs_get_uvar(&c) ;
+    switch ( kind ) {
+    case RS_COLOR_BLACK:
+    case RS_COLOR_WHITE:
+      for ( i = 0 ; i < rs->nchannels ; ++i ) {
+        vals[i] = (uint16)(kind == RS_COLOR_BLACK ? 0 : RS_VALUE_ONE) ;
+        set[i] = TRUE ;
       }
-      else
-      {
-        val = (ptr[0]>>4)&0xF;
-        nr->nib = TRUE;
+      break ;
+    case RS_COLOR_TINTS:
+      for ( n = rs_get_uvar(&c) ; n > 0 && !c.bad ; --n ) {
+        int32 ch = rs_read_channel(rs, rs_get_svar(&c)) ;
+        uint32 cv = rs_get_u16(&c) ;
+
+        if ( cv > RS_VALUE_ONE )
+          return FALSE ;
+        for ( i = 0 ; i < rs->nchannels ; ++i ) {
+          if ( ch < 0 || (uint32)ch == i ) {
+            vals[i] = (uint16)cv ;
+            set[i] = TRUE ;
+          }
+        }
       }
-      break;
-
-    case RS_VAL4:
-      if ( nr->nib )
-      {
-        val = (*ptr++ & 0xF) + 1;
-        nr->nib = FALSE;
-        nr->ptr += 1;
-        if ( val == 16 )
-        {
-          val = 16 + *ptr++;
-          nr->ptr += 1;
-          if ( val == 256+16 )
-          {
-            val = 271 + ptr[0] + 256*ptr[1];
-            nr->ptr += 2;
+      break ;
+    default:
+      return FALSE ;
+    }
+    if ( c.bad )
+      return FALSE ;
+  }
+  return TRUE ;
+}
+
+/**
+ * Validate a stream and index its definitions.
+ */
+static Bool rs_read_index(RS_READER *rs, const uint8 *stream, int32 len)
+{
+  RS_CURSOR c ;
+  Bool page = FALSE, end = FALSE ;
+  uint32 ncolorants = 0, i ;
+  int32 pass ;
+
+  HqMemZero(rs, sizeof(*rs)) ;
+  rs->stream = stream ;
+  rs->len = len ;
+
+  c.p = stream ;
+  c.end = stream + len ;
+  c.bad = FALSE ;
+  if ( rs_get_u32(&c) != RS_MAGIC0 || rs_get_u32(&c) != RS_MAGIC1 ||
+       rs_get_u16(&c) != RS_VERSION_MAJOR || c.bad )
+    return FALSE ;
+
+  /* The first pass checks the record structure and counts the ids and
+     colorants; the second indexes the definitions and collects the
+     colorants into the raster channels. */
+  for ( pass = 0 ; pass < 2 ; ++pass ) {
+    c.p = stream + RS_ID_BYTES ;
+    while ( c.p < c.end && !end ) {
+      uint32 type = rs_get_byte(&c), size = rs_get_uvar(&c) ;
+      RS_CURSOR r ;
+
+      if ( c.bad || size > (uint32)(c.end - c.p) )
+        return FALSE ;
+      r.p = c.p ;
+      r.end = c.p + size ;
+      r.bad = FALSE ;
+      c.p = r.end ;
+
+      switch ( type ) {
+      case RS_REC_JOB:
+        rs->job = rs_get_uvar(&r) ;
+        break ;
+      case RS_REC_PAGE:
+        rs->page = rs_get_uvar(&r) ;
+        rs->width = (int32)rs_get_uvar(&r) ;
+        rs->height = (int32)rs_get_uvar(&r) ;
+        rs->band_lines = (int32)rs_get_uvar(&r) ;
+        if ( rs->width < 0 || rs->width > RS_MAX_COORD ||
+             rs->height < 0 || rs->height > RS_MAX_COORD )
+          return FALSE ;
+        page = TRUE ;
+        break ;
+      case RS_REC_COLOR: {
+        uint32 id = rs_get_uvar(&r), kind, n ;
+
+        if ( r.bad || id >= 0x1000000 )
+          return FALSE ;
+        if ( pass == 0 ) {
+          if ( id >= rs->ncolors )
+            rs->ncolors = id + 1 ;
+        } else
+          rs->colors[id] = r.p ;
+        kind = rs_get_uvar(&r) ;
+        if ( kind == RS_COLOR_TINTS ) {
+          for ( n = rs_get_uvar(&r) ; n > 0 && !r.bad ; --n ) {
+            int32 colorant = rs_get_svar(&r) ;
+
+            (void)rs_get_u16(&r) ;
+            if ( colorant < RS_COLORANT_ALL )
+              return FALSE ;
+            if ( pass == 0 )
+              ++ncolorants ;
+            else
+              rs_read_add_channel(rs, colorant) ;
           }
         }
+        break ;
       }
-      else
-      {
-        val = ((ptr[0]>>4)&0xF) + 1;
-        nr->nib = TRUE;
-        if ( val == 16 )
-        {
-          val = 16 + ((ptr[0]&0xF)<<4) + ((ptr[1]>>4)&0xF);
-          nr->ptr += 1; ptr++;
-          if ( val == 256+16 )
-          {
-            val = 271 + ((ptr[0]&0xF)<<12) + (((ptr[1]>>4)&0xF)<<8)
-                      + ((ptr[1]&0xF)<<4) + ((ptr[2]>>4)&0xF);
-            nr->ptr += 2;
+      case RS_REC_MASK: {
+        uint32 id = rs_get_uvar(&r), w = rs_get_uvar(&r), h = rs_get_uvar(&r) ;
+
+        if ( r.bad || id >= 0x1000000 || w > RS_MAX_COORD || h > RS_MAX_COORD )
+          return FALSE ;
+        if ( pass == 0 ) {
+          if ( id >= rs->nmasks )
+            rs->nmasks = id + 1 ;
+        } else {
+          RS_MASK_DEF *mask = &rs->masks[id] ;
+
+          mask->w = (int32)w ;
+          mask->h = (int32)h ;
+          mask->rows = r.p ;
+          mask->end = r.end ;
+          if ( !rs_read_mask_valid(mask) )
+            return FALSE ;
+        }
+        break ;
+      }
+      case RS_REC_IMAGE: {
+        uint32 id = rs_get_uvar(&r) ;
+        RS_IMAGE_DEF image ;
+        int32 colorants[RS_MAX_COMPONENTS] ;
+
+        if ( r.bad || id >= 0x1000000 ||
+             !rs_read_image_def(&r, &image, colorants) )
+          return FALSE ;
+        if ( pass == 0 ) {
+          if ( id >= rs->nimages )
+            rs->nimages = id + 1 ;
+          ncolorants += (uint32)image.ncomps ;
+        } else {
+          for ( i = 0 ; i < (uint32)image.ncomps ; ++i ) {
+            rs_read_add_channel(rs, colorants[i]) ;
+            /* The channel is set when all of the colorants are known. */
+            image.channel[i] = colorants[i] ;
           }
+          rs->images[id] = image ;
         }
+        r.p = r.end ;
+        break ;
+      }
+      case RS_REC_END:
+        rs->flags = rs_get_uvar(&r) ;
+        rs->nobjects = rs_get_uvar(&r) ;
+        rs->nomitted = rs_get_uvar(&r) ;
+        if ( r.bad || r.end - r.p < 4 )
+          return FALSE ;
+        r.p = r.end - 4 ;
+        if ( rs_get_u32(&r) != rs_adler32(1, stream, r.end - 4 - stream) ||
+             r.end != c.end )
+          return FALSE ;
+        end = TRUE ;
+        break ;
+      default:
+        /* Unknown records are skipped. */
+        break ;
       }
-      break;
-    case RS_UNS8:
-      val = *ptr++;
-      nr->ptr += 1;
-      if ( val == 255 )
-      {
-        val = ptr[0] + 256*ptr[1] + 255;
-        nr->ptr += 2;
+      if ( r.bad )
+        return FALSE ;
+      if ( !page && type != RS_REC_JOB )
+        return FALSE ;
+    }
+    if ( !end )
+      return FALSE ;
+
+    if ( pass == 0 ) {
+      if ( rs->ncolors > 0 ) {
+        if ( (rs->colors = RS_ALLOC(rs->ncolors * sizeof(rs->colors[0]))) == NULL )
+          return FALSE ;
+        HqMemZero((void *)rs->colors, rs->ncolors * sizeof(rs->colors[0])) ;
       }
-      break;
-    case RS_SIGN8:
-      val = *ptr++ - 127;
-      nr->ptr += 1;
-      if ( val == 128 )
-      {
-        val = ptr[0] + 256*ptr[1] - 32767;
-        nr->ptr += 2;
+      if ( rs->nmasks > 0 ) {
+        if ( (rs->masks = RS_ALLOC(rs->nmasks * sizeof(rs->masks[0]))) == NULL )
+          return FALSE ;
+        HqMemZero(rs->masks, rs->nmasks * sizeof(rs->masks[0])) ;
       }
-      break;
-    case RS_OFF16:
-        val = ptr[0] + 256*ptr[1] - 0x1000;
-        nr->ptr += 2;
-        break;
-    case RS_SIZE16:
-        val = ptr[0] + 256*ptr[1];
-        nr->ptr += 2;
-        if ( val == 0xffff )
-        {
-          ptr += 2;
-          val = ptr[0] + 256*ptr[1] + 256*256*ptr[2] +
-                256*256*256*ptr[3] + 65536;
-          nr->ptr += 4;
-        }
-        break;
-    case RS_BYTE:
-      val = *ptr++;
-      nr->ptr += 1;
-      break;
-    case RS_DBYTE:
-      val = ptr[0] + 256*ptr[1];
-      nr->ptr += 2;
-      break;
-    case RS_DELTA4:
-      val = (*ptr++ & 0xF) - 8;
-      nr->ptr += 1;
-      break;
-    case RS_DELTA2p2:
-      break;
-    default:
-      error("Bad encoding style");
-      break;
+      if ( rs->nimages > 0 ) {
+        if ( (rs->images = RS_ALLOC(rs->nimages * sizeof(rs->images[0]))) == NULL )
+          return FALSE ;
+        HqMemZero(rs->images, rs->nimages * sizeof(rs->images[0])) ;
+      }
+      /* There is always at least one channel, for black and white. */
+      rs->maxchannels = ncolorants + 1 ;
+      if ( (rs->channels = RS_ALLOC(rs->maxchannels * sizeof(rs->channels[0]))) == NULL )
+        return FALSE ;
+      end = FALSE ;
+    }
+  }
+
+  if ( rs->nchannels == 0 )
+    rs->channels[rs->nchannels++] = RS_COLORANT_ALL ;
+  for ( i = 0 ; i < rs->nimages ; ++i ) {
+    RS_IMAGE_DEF *image = &rs->images[i] ;
+    int32 j ;
+
+    for ( j = 0 ; image->samples != NULL && j < image->ncomps ; ++j )
+      image->channel[j] = rs_read_channel(rs, image->channel[j]) ;
   }
-  return val;
+
+  return rs_read_colors(rs) ;
 }
 
-uint8 *base_addr(RSS *rss, int32 x, int32 y)
+/** Parsing state while rebuilding the display list of a stream. */
+typedef struct RS_PARSE {
+  uint32 color ;          /**< Colour id selected, or RS_NO_ID. */
+  int32 clip[4] ;         /**< Clip rectangle. */
+  uint32 alpha ;          /**< Opacity of paints. */
+  uint32 group[RS_MAX_GROUP_DEPTH + 1] ; /**< Opacity of each group level. */
+  uint32 depth ;          /**< Number of groups open. */
+  uint32 clipmasks, nclipmasks ; /**< Complex clip masks set. */
+} RS_PARSE ;
+
+/**
+ * Intersect an object's extent with its clip rectangle and the page.
+ */
+static void rs_robj_bbox(const RS_READER *rs, const RS_PARSE *parse,
+                         RS_ROBJ *robj, int32 x1, int32 y1, int32 x2, int32 y2)
 {
-  y += rss->band.y0;
+  robj->bbox[0] = max(max(x1, parse->clip[0]), 0) ;
+  robj->bbox[1] = max(max(y1, parse->clip[1]), 0) ;
+  robj->bbox[2] = min(min(x2, parse->clip[2]), rs->width - 1) ;
+  robj->bbox[3] = min(min(y2, parse->clip[3]), rs->height - 1) ;
+}
 
-  if ( y < 0 || y >= rss->rasterHeight )
-    return NULL;
-  return rss->pageRaster + rss->rasterWidth * y + x*3;
+/**
+ * Read the geometry of an image, and extend an extent to cover it.
+ *
+ * \return FALSE if the geometry is degenerate.
+ */
+static Bool rs_read_geometry(RS_CURSOR *r, int32 v[6], int32 extent[4])
+{
+  int32 i, x, y ;
+
+  for ( i = 0 ; i < 6 ; ++i )
+    v[i] = rs_get_coord(r) ;
+  if ( r->bad || (int64)v[2] * v[5] == (int64)v[4] * v[3] )
+    return FALSE ;
+  for ( i = 0 ; i < 4 ; ++i ) {
+    x = v[0] + ((i & 1) != 0 ? v[2] : 0) + ((i & 2) != 0 ? v[4] : 0) ;
+    y = v[1] + ((i & 1) != 0 ? v[3] : 0) + ((i & 2) != 0 ? v[5] : 0) ;
+    extent[0] = min(extent[0], x) ;
+    extent[1] = min(extent[1], y) ;
+    extent[2] = max(extent[2], x) ;
+    extent[3] = max(extent[3], y) ;
+  }
+  return TRUE ;
 }
 
-void paintRun(RSS *rss, int32 color, int32 x, int32 y, int32 run)
+/**
+ * Parse the commands of the objects records into a list of painting
+ * objects, each with the state it is painted with.
+ *
+ * \param[in,out] rs  Stream opened with rs_read_index().
+ * \param[in]     out Whether to fill in the objects, or only count them.
+ * \return FALSE if the commands are malformed.
+ */
+static Bool rs_read_objects(RS_READER *rs, Bool out)
 {
-  uint8 *ras = base_addr(rss, x, y);
-  RS_RGB   *rgb = &rss->color[color];
-  int32 i;
+  RS_CURSOR c ;
+  RS_PARSE parse ;
+  uint32 nrobjs = 0, nplaced = 0 ;
+
+  parse.color = RS_NO_ID ;
+  parse.clip[0] = parse.clip[1] = 0 ;
+  parse.clip[2] = rs->width - 1 ;
+  parse.clip[3] = rs->height - 1 ;
+  parse.alpha = RS_VALUE_ONE ;
+  parse.group[0] = RS_VALUE_ONE ;
+  parse.depth = 0 ;
+  parse.clipmasks = parse.nclipmasks = 0 ;
+
+  c.p = rs->stream + RS_ID_BYTES ;
+  c.end = rs->stream + rs->len ;
+  c.bad = FALSE ;
+  while ( c.p < c.end ) {
+    uint32 type = rs_get_byte(&c), size = rs_get_uvar(&c) ;
+    RS_CURSOR r ;
+
+    r.p = c.p ;
+    r.end = c.p + size ;
+    r.bad = FALSE ;
+    c.p = r.end ;
+    if ( type == RS_REC_END )
+      break ;
+    if ( type != RS_REC_OBJECTS )
+      continue ;
+
+    while ( r.p < r.end && !r.bad ) {
+      uint32 op = rs_get_byte(&r), id, n, i ;
+      RS_ROBJ robj ;
+      int32 extent[4] ;
+
+      HqMemZero(&robj, sizeof(robj)) ;
+      robj.op = op ;
+      robj.color[0] = parse.color ;
+      robj.alpha = (parse.alpha * parse.group[parse.depth] +
+                    RS_VALUE_ONE / 2) / RS_VALUE_ONE ;
+      robj.clipmasks = parse.clipmasks ;
+      robj.nclipmasks = parse.nclipmasks ;
+
+      switch ( op ) {
+      case RS_OP_COLOR:
+        id = rs_get_uvar(&r) ;
+        if ( id >= rs->ncolors || rs->colors[id] == NULL )
+          return FALSE ;
+        parse.color = id ;
+        continue ;
+      case RS_OP_CLIP:
+        for ( i = 0 ; i < 4 ; ++i )
+          parse.clip[i] = rs_get_coord(&r) ;
+        continue ;
+      case RS_OP_ALPHA:
+        parse.alpha = rs_get_u16(&r) ;
+        if ( parse.alpha > RS_VALUE_ONE )
+          return FALSE ;
+        continue ;
+      case RS_OP_CLIPMASKS:
+        n = rs_get_uvar(&r) ;
+        if ( n > (uint32)(r.end - r.p) / 3 )
+          return FALSE ;
+        parse.clipmasks = nplaced ;
+        parse.nclipmasks = n ;
+        for ( i = 0 ; i < n && !r.bad ; ++i ) {
+          RS_PLACED placed ;
+
+          placed.id = rs_get_uvar(&r) ;
+          placed.x = rs_get_coord(&r) ;
+          placed.y = rs_get_coord(&r) ;
+          if ( placed.id >= rs->nmasks || rs->masks[placed.id].rows == NULL )
+            return FALSE ;
+          if ( out )
+            rs->placed[nplaced] = placed ;
+          ++nplaced ;
+        }
+        continue ;
+      case RS_OP_GROUP:
+        if ( parse.depth >= RS_MAX_GROUP_DEPTH )
+          return FALSE ;
+        n = rs_get_u16(&r) ;
+        if ( n > RS_VALUE_ONE )
+          return FALSE ;
+        parse.group[parse.depth + 1] = (parse.group[parse.depth] * n +
+                                        RS_VALUE_ONE / 2) / RS_VALUE_ONE ;
+        ++parse.depth ;
+        continue ;
+      case RS_OP_ENDGROUP:
+        if ( parse.depth == 0 )
+          return FALSE ;
+        --parse.depth ;
+        continue ;
+
+      case RS_OP_ERASE:
+        if ( parse.color == RS_NO_ID )
+          return FALSE ;
+        /* Erases paint the whole page, regardless of clip and opacity. */
+        robj.alpha = RS_VALUE_ONE ;
+        robj.nclipmasks = 0 ;
+        robj.bbox[0] = robj.bbox[1] = 0 ;
+        robj.bbox[2] = rs->width - 1 ;
+        robj.bbox[3] = rs->height - 1 ;
+        break ;
+      case RS_OP_RECT:
+        if ( parse.color == RS_NO_ID )
+          return FALSE ;
+        for ( i = 0 ; i < 4 ; ++i )
+          robj.v[i] = rs_get_coord(&r) ;
+        rs_robj_bbox(rs, &parse, &robj, robj.v[0], robj.v[1],
+                     robj.v[2], robj.v[3]) ;
+        break ;
+      case RS_OP_MASK:
+        if ( parse.color == RS_NO_ID )
+          return FALSE ;
+        robj.id = rs_get_uvar(&r) ;
+        robj.v[0] = rs_get_coord(&r) ;
+        robj.v[1] = rs_get_coord(&r) ;
+        if ( robj.id >= rs->nmasks || rs->masks[robj.id].rows == NULL )
+          return FALSE ;
+        rs_robj_bbox(rs, &parse, &robj, robj.v[0], robj.v[1],
+                     robj.v[0] + rs->masks[robj.id].w - 1,
+                     robj.v[1] + rs->masks[robj.id].h - 1) ;
+        break ;
+      case RS_OP_TRIANGLE:
+        for ( i = 0 ; i < 6 ; ++i )
+          robj.v[i] = rs_get_coord(&r) ;
+        for ( i = 0 ; i < 3 ; ++i ) {
+          robj.color[i] = rs_get_uvar(&r) ;
+          if ( robj.color[i] >= rs->ncolors ||
+               rs->colors[robj.color[i]] == NULL )
+            return FALSE ;
+        }
+        extent[0] = min(min(robj.v[0], robj.v[2]), robj.v[4]) / RS_SUBPIXEL - 1 ;
+        extent[1] = min(min(robj.v[1], robj.v[3]), robj.v[5]) / RS_SUBPIXEL - 1 ;
+        extent[2] = max(max(robj.v[0], robj.v[2]), robj.v[4]) / RS_SUBPIXEL + 1 ;
+        extent[3] = max(max(robj.v[1], robj.v[3]), robj.v[5]) / RS_SUBPIXEL + 1 ;
+        rs_robj_bbox(rs, &parse, &robj, extent[0], extent[1],
+                     extent[2], extent[3]) ;
+        break ;
+      case RS_OP_IMAGE:
+      case RS_OP_IMAGEMASK:
+        if ( op == RS_OP_IMAGEMASK && parse.color == RS_NO_ID )
+          return FALSE ;
+        robj.id = rs_get_uvar(&r) ;
+        robj.maskid = op == RS_OP_IMAGE ? rs_get_uvar(&r) : 0 ;
+        if ( robj.id >= rs->nimages || rs->images[robj.id].samples == NULL ||
+             robj.maskid > rs->nimages ||
+             (robj.maskid > 0 && rs->images[robj.maskid - 1].samples == NULL) )
+          return FALSE ;
+        extent[0] = extent[1] = RS_MAX_COORD * 2 ;
+        extent[2] = extent[3] = -RS_MAX_COORD * 2 ;
+        if ( !rs_read_geometry(&r, &robj.v[0], extent) )
+          return FALSE ;
+        if ( robj.maskid > 0 ) {
+          int32 maskextent[4] ;
+
+          /* Only the intersection of the image and mask is painted. */
+          maskextent[0] = maskextent[1] = RS_MAX_COORD * 2 ;
+          maskextent[2] = maskextent[3] = -RS_MAX_COORD * 2 ;
+          if ( !rs_read_geometry(&r, &robj.v[6], maskextent) )
+            return FALSE ;
+          extent[0] = max(extent[0], maskextent[0]) ;
+          extent[1] = max(extent[1], maskextent[1]) ;
+          extent[2] = min(extent[2], maskextent[2]) ;
+          extent[3] = min(extent[3], maskextent[3]) ;
+        }
+        rs_robj_bbox(rs, &parse, &robj, extent[0], extent[1],
+                     extent[2], extent[3]) ;
+        break ;
+      default:
+        return FALSE ;
+      }
 
-  if ( ras && color > 0 )
-  {
-    for ( i = 0; i < run; i++ )
-    {
-      *ras++ = rgb->b;
-      *ras++ = rgb->g;
-      *ras++ = rgb->r;
+      if ( out )
+        rs->robjs[nrobjs] = robj ;
+      ++nrobjs ;
     }
+    if ( r.bad )
+      return FALSE ;
+  }
+
+  if ( !out ) {
+    rs->nrobjs = nrobjs ;
+    rs->nplaced = nplaced ;
   }
+  return TRUE ;
+}
+
+/**
+ * Open a stream for reading, rebuilding its display list. A stream which is
+ * opened must be closed with rs_read_close().
+ *
+ * \return FALSE if the stream is malformed, has the wrong major version,
+ *         fails its checksum, or memory could not be allocated.
+ */
+static Bool rs_read_open(RS_READER *rs, const uint8 *stream, int32 len)
+{
+  if ( !rs_read_index(rs, stream, len) || !rs_read_objects(rs, FALSE) )
+    goto fail ;
+
+  if ( (rs->nrobjs > 0 &&
+        (rs->robjs = RS_ALLOC(rs->nrobjs * sizeof(rs->robjs[0]))) == NULL) ||
+       (rs->nplaced > 0 &&
+        (rs->placed = RS_ALLOC(rs->nplaced * sizeof(rs->placed[0]))) == NULL) ||
+       (rs->cover = RS_ALLOC(rs->width + 1)) == NULL ||
+       !rs_read_objects(rs, TRUE) )
+    goto fail ;
+  return TRUE ;
+
+ fail:
+  rs_read_close(rs) ;
+  return FALSE ;
 }
 
-void paintRectangle(RSS *rss, int32 w, int32 h)
+/**
+ * Paint a pixel. Channels which are not set are left unchanged.
+ */
+static void rs_paint_pixel(uint16 *pixel, uint32 nchannels,
+                           const uint16 *vals, const uint8 *set, uint32 alpha)
 {
-  int32 y;
+  uint32 i ;
 
-  for ( y = 0; y < h; y++ )
-    paintRun(rss, rss->colori, rss->x, rss->y+y, w);
+  for ( i = 0 ; i < nchannels ; ++i ) {
+    if ( set[i] ) {
+      if ( alpha >= RS_VALUE_ONE )
+        pixel[i] = vals[i] ;
+      else
+        pixel[i] = (uint16)(pixel[i] + ((int64)vals[i] - pixel[i]) *
+                            alpha / RS_VALUE_ONE) ;
+    }
+  }
 }
 
-int32 find_x(int32 y, RS_COORD *coord, int32 ncoord)
+/**
+ * Find the coverage and colour of a triangle at the centre of a pixel.
+ *
+ * \param[in]  v       Vertices of the triangle, in 1/RS_SUBPIXEL pixels.
+ * \param[in]  x       Pixel x coordinate.
+ * \param[in]  y       Pixel y coordinate.
+ * \param[in]  vals    Channel values of the three vertex colours.
+ * \param[in]  set     Channels set by the three vertex colours.
+ * \param[in]  nchannels Number of channels.
+ * \param[out] pvals   Interpolated channel values.
+ * \param[out] pset    Channels set by all three vertex colours.
+ * \return Whether the pixel centre is inside the triangle.
+ */
+static Bool rs_triangle_pixel(const int32 v[6], int32 x, int32 y,
+                              const uint16 *vals[3], const uint8 *set[3],
+                              uint32 nchannels, uint16 *pvals, uint8 *pset)
 {
-  int32 i;
+  int64 px = (int64)x * RS_SUBPIXEL + RS_SUBPIXEL / 2 ;
+  int64 py = (int64)y * RS_SUBPIXEL + RS_SUBPIXEL / 2 ;
+  int64 e[3], area ;
+  uint32 i, j ;
 
-  if ( y < coord[0].y )
-    return -1001;
+  /* Edge functions, each proportional to the weight of the opposite
+     vertex. */
+  for ( i = 0 ; i < 3 ; ++i ) {
+    const int32 *a = &v[((i + 1) % 3) * 2], *b = &v[((i + 2) % 3) * 2] ;
 
-  for ( i = 0; i < ncoord-1; i++ )
-  {
-    if ( y <= coord[i+1].y )
-    {
-      double f = ((double)(y - coord[i].y))/(coord[i+1].y - coord[i].y);
-      double x = coord[i].x + f*(coord[i+1].x - coord[i].x);
-      return (int32)(x+0.5);
+    e[i] = ((int64)b[0] - a[0]) * (py - a[1]) - ((int64)b[1] - a[1]) * (px - a[0]) ;
+  }
+  area = e[0] + e[1] + e[2] ;
+  if ( area == 0 )
+    return FALSE ;
+  if ( area < 0 ) {
+    area = -area ;
+    for ( i = 0 ; i < 3 ; ++i )
+      e[i] = -e[i] ;
+  }
+  if ( e[0] < 0 || e[1] < 0 || e[2] < 0 )
+    return FALSE ;
+
+  for ( j = 0 ; j < nchannels ; ++j ) {
+    pset[j] = (uint8)(set[0][j] && set[1][j] && set[2][j]) ;
+    if ( pset[j] ) {
+      double cv = 0.0 ;
+
+      for ( i = 0 ; i < 3 ; ++i )
+        cv += (double)e[i] * vals[i][j] ;
+      pvals[j] = (uint16)(cv / (double)area + 0.5) ;
     }
   }
-  return -1001;
+  return TRUE ;
 }
 
-void paintHull(RSS *rss, int32 ya, int32 yb, int32 nleft, int32 nright,
-               RS_COORD *left, RS_COORD *right)
+/**
+ * Find the image sample at the centre of a pixel.
+ *
+ * \param[in] image  The image.
+ * \param[in] v      Geometry of the image: tx, ty, wx, wy, hx, hy.
+ * \param[in] x      Pixel x coordinate.
+ * \param[in] y      Pixel y coordinate.
+ * \return The sample's first component, or NULL if the pixel centre is
+ *         outside the image or its stored samples.
+ */
+static const uint8 *rs_image_sample(const RS_IMAGE_DEF *image, const int32 v[6],
+                                    int32 x, int32 y)
 {
-  int32 y, xl, xr;
+  int64 dx = 2 * ((int64)x - v[0]) + 1, dy = 2 * ((int64)y - v[1]) + 1 ;
+  int64 cross = (int64)v[2] * v[5] - (int64)v[4] * v[3] ;
+  int64 un = (dx * v[5] - dy * v[4]) * image->w ;
+  int64 vn = (dy * v[2] - dx * v[3]) * image->h ;
+  int64 u, w ;
+
+  /* The sample is floor(n / (2 * cross)), for n of un and vn. */
+  cross *= 2 ;
+  if ( cross < 0 ) {
+    cross = -cross ;
+    un = -un ;
+    vn = -vn ;
+  }
+  u = un >= 0 ? un / cross : -((-un + cross - 1) / cross) ;
+  w = vn >= 0 ? vn / cross : -((-vn + cross - 1) / cross) ;
+  if ( u < image->x1 || u > image->x2 || w < image->y1 || w > image->y2 )
+    return NULL ;
+
+  return image->samples +
+    ((w - image->y1) * (image->x2 - image->x1 + 1) + (u - image->x1)) *
+    image->ncomps * image->bps ;
+}
 
-  for ( y = ya; y <= yb; y++ )
-  {
-    xl = find_x(y+rss->band.y0, left, nleft);
-    xr = find_x(y+rss->band.y0, right, nright);
-    if ( xl > -1000 && xr > -1000 )
-      paintRun(rss, rss->colori, xl, y, xr-xl);
+/**
+ * Read a component of an image sample as a colour value.
+ */
+static uint32 rs_sample_value(const RS_IMAGE_DEF *image, const uint8 *sample,
+                              int32 comp)
+{
+  uint32 val ;
+
+  if ( image->bps == 1 )
+    return (uint32)sample[comp] << 8 ;
+  val = sample[comp * 2] | ((uint32)sample[comp * 2 + 1] << 8) ;
+  return val > RS_VALUE_ONE ? RS_VALUE_ONE : val ;
+}
+
+/**
+ * Paint a pixel from an image sample.
+ */
+static void rs_paint_sample(uint16 *pixel, uint32 nchannels,
+                            const RS_IMAGE_DEF *image, const uint8 *sample,
+                            uint32 alpha)
+{
+  uint16 one[1] ;
+  uint8 on[1] = { TRUE } ;
+  int32 i ;
+  uint32 j ;
+
+  for ( i = 0 ; i < image->ncomps ; ++i ) {
+    one[0] = (uint16)rs_sample_value(image, sample, i) ;
+    if ( image->channel[i] >= 0 )
+      rs_paint_pixel(&pixel[image->channel[i]], 1, one, on, alpha) ;
+    else
+      for ( j = 0 ; j < nchannels ; ++j )
+        rs_paint_pixel(&pixel[j], 1, one, on, alpha) ;
   }
 }
 
-void paintContone(RSS *rss, int32 sw, int32 sh, int32 tx, int32 ty,
-                  int32 tw, int32 th, int32 dw, int32 dh,
-                  int32 colorspace, int32 compress, int32 bytes,uint8 *ptr)
+/** A mask being read row by row, placed on the page. */
+typedef struct RS_MASK_ROWS {
+  const RS_MASK_DEF *mask ;
+  int32 x, y ;            /**< Page position of the mask's top left. */
+  RS_CURSOR c ;           /**< Position of the next row block. */
+  int32 rows ;            /**< Page row after the current row block. */
+  const uint8 *spans ;    /**< Spans of the current row block. */
+  uint32 npairs ;         /**< Number of spans in the current row block. */
+} RS_MASK_ROWS ;
+
+static void rs_mask_rows_start(RS_MASK_ROWS *m, const RS_MASK_DEF *mask,
+                               int32 x, int32 y)
 {
-  int32 sx, sy, repx, repy;
+  m->mask = mask ;
+  m->x = x ;
+  m->y = y ;
+  m->c.p = mask->rows ;
+  m->c.end = mask->end ;
+  m->c.bad = FALSE ;
+  m->rows = y ;
+  m->spans = NULL ;
+  m->npairs = 0 ;
+}
 
-  if ( colorspace != 0 || compress != 0 )
-    return;
-  if ( tx != 0 || ty != 0 || sw != tw || sh != th )
-    return;
+/**
+ * Clear the coverage of the pixels of a page row outside a mask. Rows must
+ * be visited in increasing order.
+ */
+static void rs_mask_rows_cover(RS_MASK_ROWS *m, int32 y, uint8 *cover,
+                               int32 x1, int32 x2)
+{
+  RS_CURSOR c ;
+  int32 x, sx ;
+  uint32 npairs ;
+
+  if ( y < m->y || y >= m->y + m->mask->h ) {
+    for ( x = x1 ; x <= x2 ; ++x )
+      cover[x] = FALSE ;
+    return ;
+  }
 
-  repx = dw/sw; if ( repx == 0 ) repx = 1;
-  repy = dh/sh; if ( repy == 0 ) repy = 1;
+  while ( y >= m->rows ) {
+    m->rows += (int32)rs_get_uvar(&m->c) ;
+    m->npairs = rs_get_uvar(&m->c) ;
+    m->spans = m->c.p ;
+    for ( npairs = m->npairs * 2 ; npairs > 0 ; --npairs )
+      (void)rs_get_uvar(&m->c) ;
+  }
 
-  for ( sy = 0; sy < sh; sy++ )
-  {
-    int32 y = sy*dh/sh;
+  c.p = m->spans ;
+  c.end = m->mask->end ;
+  c.bad = FALSE ;
+  sx = m->x ;
+  x = x1 ;
+  for ( npairs = m->npairs ; npairs > 0 && x <= x2 ; --npairs ) {
+    sx += (int32)rs_get_uvar(&c) ;
+    while ( x < sx && x <= x2 )
+      cover[x++] = FALSE ;
+    sx += (int32)rs_get_uvar(&c) ;
+    if ( x < sx )
+      x = sx ;
+  }
+  while ( x <= x2 )
+    cover[x++] = FALSE ;
+}
+
+/**
+ * Render one object of the rebuilt display list into some rows of a raster.
+ */
+static void rs_render_robj(RS_READER *rs, const RS_ROBJ *robj,
+                           uint16 *raster, int32 y0, int32 y1)
+{
+  RS_MASK_ROWS clipmasks[8], *clips = clipmasks, glyph ;
+  const uint16 *vals[3] ;
+  const uint8 *set[3] ;
+  uint16 tvals[RS_MAX_COMPONENTS + 1], *pvals = NULL ;
+  uint8 tset[RS_MAX_COMPONENTS + 1], *pset = NULL ;
+  const RS_IMAGE_DEF *image = NULL, *mask = NULL ;
+  uint32 nch = rs->nchannels, i ;
+  int32 x, y, x1 = robj->bbox[0], x2 = robj->bbox[2] ;
+  int32 ya = max(robj->bbox[1], y0), yb = min(robj->bbox[3], y1 - 1) ;
+  size_t clipsize = 0 ;
+
+  if ( x1 > x2 || ya > yb )
+    return ;
+
+  if ( robj->nclipmasks > sizeof(clipmasks) / sizeof(clipmasks[0]) ) {
+    clipsize = robj->nclipmasks * sizeof(clips[0]) ;
+    if ( (clips = RS_ALLOC(clipsize)) == NULL )
+      return ;
+  }
+  for ( i = 0 ; i < robj->nclipmasks ; ++i ) {
+    const RS_PLACED *placed = &rs->placed[robj->clipmasks + i] ;
 
-    for ( sx = 0; sx < sw; sx++ )
-    {
-      int32 x = sx*dw/sw;
-      int32 i, j;
+    rs_mask_rows_start(&clips[i], &rs->masks[placed->id], placed->x, placed->y) ;
+  }
+  if ( robj->op == RS_OP_MASK )
+    rs_mask_rows_start(&glyph, &rs->masks[robj->id], robj->v[0], robj->v[1]) ;
 
-      uint8 r = ptr[sy*sw*3+sw*0+sx];
-      uint8 g = ptr[sy*sw*3+sw*1+sx];
-      uint8 b = ptr[sy*sw*3+sw*2+sx];
+  for ( i = 0 ; i < 3 ; ++i ) {
+    uint32 id = robj->color[i] != RS_NO_ID ? robj->color[i] : robj->color[0] ;
 
-      for ( j = 0; j < repy; j++ )
-      {
-        uint8 *dst = rss->pageRaster + rss->rasterWidth * (rss->y + y+j) +
-                                                          (rss->x + x)*3;
+    vals[i] = id != RS_NO_ID ? &rs->colorvals[id * nch] : NULL ;
+    set[i] = id != RS_NO_ID ? &rs->colorset[id * nch] : NULL ;
+  }
+  if ( robj->op == RS_OP_IMAGE || robj->op == RS_OP_IMAGEMASK ) {
+    image = &rs->images[robj->id] ;
+    if ( robj->maskid > 0 )
+      mask = &rs->images[robj->maskid - 1] ;
+  }
+  if ( robj->op == RS_OP_TRIANGLE ) {
+    /* The raster may have more channels than the fixed buffers. */
+    if ( nch > RS_MAX_COMPONENTS + 1 ) {
+      if ( (pvals = RS_ALLOC(nch * (sizeof(pvals[0]) + 1))) == NULL )
+        goto done ;
+      pset = (uint8 *)(pvals + nch) ;
+    } else {
+      pvals = tvals ;
+      pset = tset ;
+    }
+  }
 
-        for ( i = 0; i < repx; i++ )
-          *dst++ = b, *dst++ = g, *dst++ = r;
+  /* Rows before those being rendered are skipped through the masks. */
+  for ( y = robj->bbox[1] ; y <= yb ; ++y ) {
+    uint16 *row = raster + ((size_t)(y - y0) * rs->width) * nch ;
+    uint8 *cover = rs->cover ;
+
+    for ( x = x1 ; x <= x2 ; ++x )
+      cover[x] = TRUE ;
+    for ( i = 0 ; i < robj->nclipmasks ; ++i )
+      rs_mask_rows_cover(&clips[i], y, cover, x1, x2) ;
+    if ( robj->op == RS_OP_MASK )
+      rs_mask_rows_cover(&glyph, y, cover, x1, x2) ;
+    if ( y < ya )
+      continue ;
+
+    for ( x = x1 ; x <= x2 ; ++x ) {
+      uint16 *pixel = row + (size_t)x * nch ;
+      const uint8 *sample ;
+
+      if ( !cover[x] )
+        continue ;
+      switch ( robj->op ) {
+      case RS_OP_TRIANGLE:
+        if ( rs_triangle_pixel(robj->v, x, y, vals, set, nch, pvals, pset) )
+          rs_paint_pixel(pixel, nch, pvals, pset, robj->alpha) ;
+        break ;
+      case RS_OP_IMAGE:
+        if ( mask != NULL &&
+             ((sample = rs_image_sample(mask, &robj->v[6], x, y)) == NULL ||
+              rs_sample_value(mask, sample, 0) == 0) )
+          break ;
+        if ( (sample = rs_image_sample(image, robj->v, x, y)) != NULL )
+          rs_paint_sample(pixel, nch, image, sample, robj->alpha) ;
+        break ;
+      case RS_OP_IMAGEMASK:
+        if ( (sample = rs_image_sample(image, robj->v, x, y)) != NULL &&
+             rs_sample_value(image, sample, 0) != 0 )
+          rs_paint_pixel(pixel, nch, vals[0], set[0], robj->alpha) ;
+        break ;
+      default:
+        rs_paint_pixel(pixel, nch, vals[0], set[0], robj->alpha) ;
+        break ;
       }
     }
   }
+
+ done:
+  if ( pvals != NULL && pvals != tvals )
+    RS_FREE(pvals, nch * (sizeof(pvals[0]) + 1)) ;
+  if ( clips != clipmasks )
+    RS_FREE(clips, clipsize) ;
 }
 
-uint8 *find_glyph(RSS *rss, int32 find_id, int32 *nnibbles, int32 *w, int32 *h)
+/**
+ * Render the display list rebuilt from a stream into a raster.
+ *
+ * \param[in]  rs      Stream opened with rs_read_open().
+ * \param[out] raster  Raster of rs->width pixels by y1 - y0 rows, each of
+ *                     rs->nchannels colorant values in the order of
+ *                     rs->channels. Unpainted pixels are white.
+ * \param[in]  y0      First row of the page to render.
+ * \param[in]  y1      Row of the page after the last to render.
+ */
+static void rs_read_render(RS_READER *rs, uint16 *raster, int32 y0, int32 y1)
 {
-  NIBREAD nr;
-  uint8 *end;
+  size_t i, n = (size_t)rs->width * (y1 - y0) * rs->nchannels ;
+  uint32 j ;
 
-  nr.nib = FALSE;
-  nr.ptr = rss->page_defines.ptr;
-  end = nr.ptr + rss->page_defines.size;
+  HQASSERT(y0 >= 0 && y0 <= y1 && y1 <= rs->height, "Invalid rows") ;
 
-  while ( nr.ptr < end )
-  {
-    if ( rs_read(&nr, RS_BYTE) == 0x8B )
-    {
-      int32 id, n;
-
-      id = rs_read(&nr, RS_BYTE);
-      *w  = rs_read(&nr, RS_UNS8);
-      *h  = rs_read(&nr, RS_UNS8);
-      n  = rs_read(&nr, RS_DBYTE);
-
-      if ( id == find_id )
-      {
-        *nnibbles = n;
-        return nr.ptr;
+  for ( i = 0 ; i < n ; ++i )
+    raster[i] = RS_VALUE_ONE ;
+  for ( j = 0 ; j < rs->nrobjs ; ++j )
+    rs_render_robj(rs, &rs->robjs[j], raster, y0, y1) ;
+}
+
+#endif /* ASSERT_BUILD || BUILD_RSREAD } */
+
+/* ========================================================================== */
+#if defined(ASSERT_BUILD) && !defined(BUILD_RSREAD) /* { Checks */
+
+/**
+ * Check that the stream written for a page reads back with the details the
+ * writer recorded, and that it can be rendered band by band.
+ */
+static void rs_check_stream(const RS_WRITER *w, const uint8 *stream, int32 len)
+{
+  RS_READER rs ;
+  uint16 *raster ;
+  size_t bytes ;
+  int32 y, y1 ;
+  Bool ok ;
+
+  ok = rs_read_open(&rs, stream, len) ;
+  HQASSERT(ok, "Rainstorm stream written for the page should be valid") ;
+  if ( !ok )
+    return ;
+
+  HQASSERT(rs.flags == (w->nomitted > 0 ? RS_PAGE_PARTIAL : 0u) &&
+           rs.nobjects == w->nobjects && rs.nomitted == w->nomitted &&
+           rs.ncolors == w->colors.count && rs.nmasks == w->masks.count &&
+           rs.nimages == w->images.count,
+           "Rainstorm stream details differ from those written") ;
+
+  if ( rs.band_lines > 0 ) {
+    bytes = (size_t)rs.width * rs.band_lines * rs.nchannels * sizeof(raster[0]) ;
+    if ( (raster = RS_ALLOC(bytes)) != NULL ) {
+      for ( y = 0 ; y < rs.height ; y = y1 ) {
+        y1 = min(y + rs.band_lines, rs.height) ;
+        rs_read_render(&rs, raster, y, y1) ;
       }
-      else
-        nr.ptr += (n+1)/2;
+      RS_FREE(raster, bytes) ;
     }
-    else
-      return NULL;
   }
-  return NULL;
+  rs_read_close(&rs) ;
 }
 
-void paintGlyph(RSS *rss, int32 id, int32 x, int32 y)
+/** Unit test page size, chosen to make bands end mid-glyph. */
+#define RS_TEST_W 97
+#define RS_TEST_H 61
+#define RS_TEST_BAND 16
+
+/** Unit test glyph size. */
+#define RS_TEST_GW 37
+#define RS_TEST_GH 11
+
+/** Unit test image and image mask sizes. */
+#define RS_TEST_IW 5
+#define RS_TEST_IH 4
+#define RS_TEST_MW 6
+#define RS_TEST_MH 5
+
+/** Unit test colorants, which are the raster channels. */
+#define RS_TEST_NCH 2
+
+/** One command painted by the unit test. */
+typedef struct RS_TEST_OP {
+  int32 op ;              /**< RS_OP_ command. */
+  int32 color ;           /**< Test colour; the first for a triangle. */
+  uint32 alpha ;          /**< Opacity, or group opacity. */
+  Bool clipmask ;         /**< Clipped by the glyph at (RS_TEST_CMX, RS_TEST_CMY). */
+  dbbox_t clip ;          /**< Clip rectangle. */
+  int32 v[12] ;           /**< Rectangle, mask position, triangle vertices,
+                               or image geometry; a masked image has the
+                               image mask's geometry in v[6] to v[11]. */
+} RS_TEST_OP ;
+
+/** Where the glyph is placed when it is used as a clip mask. */
+#define RS_TEST_CMX 20
+#define RS_TEST_CMY 26
+
+/** Test colours, as (kind, colorant 0 value, colorant 1 value), where
+    -1 is a colorant the colour does not set. */
+static const int32 rs_test_colors[][3] = {
+  { RS_COLOR_TINTS, 0x1000, 0x8000 },
+  { RS_COLOR_TINTS, 0xff00, -1 },
+  { RS_COLOR_BLACK, 0, 0 },
+  { RS_COLOR_TINTS, 0x4000, 0x4000 }, /* Written as RS_COLORANT_ALL. */
+  { RS_COLOR_WHITE, 0xff00, 0xff00 },
+} ;
+#define RS_TEST_NCOLORS (sizeof(rs_test_colors) / sizeof(rs_test_colors[0]))
+
+static Bool rs_test_sink(void *data, uint8 *buf, int32 len)
 {
-  NIBREAD nr;
-  int32 nn, w, h;
-  uint8 *rle;
+  rs_put_bytes(data, buf, len) ;
+  return TRUE ;
+}
 
-  rle = find_glyph(rss, id, &nn, &w, &h);
-  nr.ptr = rle;
-  nr.nib = FALSE;
+/**
+ * Is a pixel of the test glyph placed at (gx, gy) set?
+ */
+static Bool rs_test_glyph(FORM *form, int32 gx, int32 gy, int32 x, int32 y)
+{
+  x -= gx ;
+  y -= gy ;
+  return (x >= 0 && x < form->w && y >= 0 && y < form->h &&
+          ((AONE >> (x & BLIT_MASK_BITS)) &
+           *BLIT_ADDRESS(form->addr, y * form->l + BLIT_OFFSET(x))) != 0) ;
+}
 
-  if ( rle && nn > 0 )
-  {
-    int32 val, npairs, repeat = 0;
-    int32 runs[100], x0 = x;
-
-    while ( (nr.ptr - rle)*2 + (nr.nib ? 1 : 0 ) < nn )
-    {
-      val = rs_read(&nr, RS_NIBBLE);
-
-      switch ( val )
-      {
-        case 0:
-          break;
-        case 1: case 2: case 3: case 4: case 5: case 6:
-        case 7: case 8: case 9: case 10: case 11:
-          npairs = val;
-          for ( val = 0; val < npairs*2; val++ )
-          {
-            runs[val] = rs_read(&nr, RS_VAL4);
-            if ( val & 1 )
-              paintRun(rss, rss->colori, x, y, runs[val]);
-            x += runs[val];
+/**
+ * Paint the test commands directly, without the stream.
+ */
+static void rs_test_reference(uint16 *raster, const RS_TEST_OP *ops,
+                              int32 nops, FORM *form,
+                              const RS_IMAGE_DEF *image,
+                              const RS_IMAGE_DEF *mask)
+{
+  uint16 vals[RS_TEST_NCOLORS][RS_TEST_NCH] ;
+  uint8 set[RS_TEST_NCOLORS][RS_TEST_NCH] ;
+  uint32 group[RS_MAX_GROUP_DEPTH + 1], depth = 0 ;
+  int32 i, x, y, ch ;
+
+  for ( i = 0 ; i < (int32)RS_TEST_NCOLORS ; ++i ) {
+    for ( ch = 0 ; ch < RS_TEST_NCH ; ++ch ) {
+      set[i][ch] = (uint8)(rs_test_colors[i][ch + 1] >= 0) ;
+      vals[i][ch] = (uint16)(set[i][ch] ? rs_test_colors[i][ch + 1] : 0) ;
+    }
+  }
+
+  for ( i = 0 ; i < RS_TEST_W * RS_TEST_H * RS_TEST_NCH ; ++i )
+    raster[i] = RS_VALUE_ONE ;
+  group[0] = RS_VALUE_ONE ;
+
+  for ( i = 0 ; i < nops ; ++i ) {
+    const RS_TEST_OP *op = &ops[i] ;
+    uint32 alpha = (op->alpha * group[depth] + RS_VALUE_ONE / 2) / RS_VALUE_ONE ;
+
+    if ( op->op == RS_OP_GROUP ) {
+      group[depth + 1] = alpha ;
+      ++depth ;
+      continue ;
+    } else if ( op->op == RS_OP_ENDGROUP ) {
+      --depth ;
+      continue ;
+    } else if ( op->op == RS_OP_ERASE )
+      alpha = RS_VALUE_ONE ;
+
+    for ( y = 0 ; y < RS_TEST_H ; ++y ) {
+      for ( x = 0 ; x < RS_TEST_W ; ++x ) {
+        uint16 *pixel = &raster[(y * RS_TEST_W + x) * RS_TEST_NCH] ;
+        const uint8 *sample ;
+
+        if ( op->op != RS_OP_ERASE &&
+             (x < op->clip.x1 || x > op->clip.x2 ||
+              y < op->clip.y1 || y > op->clip.y2 ||
+              (op->clipmask &&
+               !rs_test_glyph(form, RS_TEST_CMX, RS_TEST_CMY, x, y))) )
+          continue ;
+
+        switch ( op->op ) {
+        case RS_OP_ERASE:
+          rs_paint_pixel(pixel, RS_TEST_NCH, vals[op->color], set[op->color],
+                         alpha) ;
+          break ;
+        case RS_OP_RECT:
+          if ( x >= op->v[0] && x <= op->v[2] && y >= op->v[1] && y <= op->v[3] )
+            rs_paint_pixel(pixel, RS_TEST_NCH, vals[op->color],
+                           set[op->color], alpha) ;
+          break ;
+        case RS_OP_MASK:
+          if ( rs_test_glyph(form, op->v[0], op->v[1], x, y) )
+            rs_paint_pixel(pixel, RS_TEST_NCH, vals[op->color],
+                           set[op->color], alpha) ;
+          break ;
+        case RS_OP_TRIANGLE: {
+          const uint16 *tv[3] ;
+          const uint8 *ts[3] ;
+          uint16 pv[RS_TEST_NCH] ;
+          uint8 ps[RS_TEST_NCH] ;
+          int32 j ;
+
+          for ( j = 0 ; j < 3 ; ++j ) {
+            tv[j] = vals[(op->color + j) % RS_TEST_NCOLORS] ;
+            ts[j] = set[(op->color + j) % RS_TEST_NCOLORS] ;
           }
-          x = x0;
-          y++;
-          break;
-        case 12:
-          break;
-        case 13:
-          break;
-        case 14:
-          repeat = rs_read(&nr, RS_VAL4);
-          while ( repeat-- > 0 )
-          {
-            for ( val = 0; val < npairs*2; val++ )
-            {
-              if ( val & 1 )
-                paintRun(rss, rss->colori, x, y, runs[val]);
-              x += runs[val];
+          if ( rs_triangle_pixel(op->v, x, y, tv, ts, RS_TEST_NCH, pv, ps) )
+            rs_paint_pixel(pixel, RS_TEST_NCH, pv, ps, alpha) ;
+          break ;
+        }
+        case RS_OP_IMAGE:
+          if ( op->color != 0 &&
+               ((sample = rs_image_sample(mask, &op->v[6], x, y)) == NULL ||
+                *sample == 0) )
+            break ;
+          if ( (sample = rs_image_sample(image, op->v, x, y)) != NULL )
+            for ( ch = 0 ; ch < RS_TEST_NCH ; ++ch ) {
+              uint16 cv = (uint16)(sample[ch] << 8) ;
+              uint8 on = TRUE ;
+
+              rs_paint_pixel(&pixel[ch], 1, &cv, &on, alpha) ;
             }
-            x = x0;
-            y++;
-          }
-          break;
-        case 15:
-          npairs = 0;
-          x = x0;
-          y++;
-          break;
+          break ;
+        case RS_OP_IMAGEMASK:
+          if ( (sample = rs_image_sample(mask, op->v, x, y)) != NULL &&
+               *sample != 0 )
+            rs_paint_pixel(pixel, RS_TEST_NCH, vals[op->color],
+                           set[op->color], alpha) ;
+          break ;
+        }
       }
     }
   }
 }
 
-void rs_bandinit(RSS *rss)
+/**
+ * Write an image definition for the unit test.
+ */
+static void rs_test_image(RS_WRITER *w, const RS_IMAGE_DEF *image,
+                          const int32 colorants[])
 {
-  uint8 *bg = rss->rs_page_block->bg;
-  int32 i;
-
-  rss->rlemode = RS_ABUTTING;
-  rss->x = rss->y = 0;
-  for ( i=0; i<256; i++ )
-  {
-    rss->color[i].r = bg[0];
-    rss->color[i].g = bg[1];
-    rss->color[i].b = bg[2];
-  }
-  rss->color[0].r = rss->color[0].g = rss->color[0].b = 0;
-  rss->color[1].r = rss->color[1].g = rss->color[1].b = 0;
-  rss->color[2].r = rss->color[2].g = rss->color[2].b = 255;
-  rss->colori = 1;
+  ibbox_t box ;
+  int32 y, rowbytes = (image->x2 - image->x1 + 1) * image->ncomps ;
+  uint32 id ;
+  Bool isnew, ok ;
+
+  ok = rs_idmap_lookup(&w->images, image, &id, &isnew) ;
+  HQASSERT(ok && isnew, "Rainstorm image should be new") ;
+  bbox_store(&box, image->x1, image->y1, image->x2, image->y2) ;
+  ok = rs_image_begin(w, id, image->w, image->h, &box, 1, image->ncomps,
+                      colorants) ;
+  for ( y = image->y1 ; ok && y <= image->y2 ; ++y )
+    ok = rs_image_row(w, image->samples + (y - image->y1) * rowbytes,
+                      rowbytes, 1) ;
+  HQASSERT(ok, "Rainstorm image could not be defined") ;
+  UNUSED_PARAM(Bool, ok) ;
 }
 
-int rs_do_band(RSS *rss)
+void rainstorm_unit_test(void)
 {
-  RS_BAND_BLOCK *band = &(rss->band);
-  NIBREAD nr;
-
-  nr.nib = FALSE;
-  rs_bandinit(rss);
-
-  if ( rss->dst == NULL )
-  {
-    printf("  band %d -> %d: %d bytes of band cmds ...\n", band->y0, band->y1,
-        band->size);
+  static const RS_TEST_OP ops[] = {
+    { RS_OP_ERASE, 4, RS_VALUE_ONE, FALSE, { 0, 0, 0, 0 }, { 0 } },
+    { RS_OP_RECT, 0, RS_VALUE_ONE, FALSE, { 0, 0, RS_TEST_W - 1, RS_TEST_H - 1 },
+      { -5, -3, 20, 40 } },
+    { RS_OP_RECT, 1, RS_VALUE_ONE, FALSE, { 10, 10, 60, 50 }, { 15, 5, 120, 17 } },
+    { RS_OP_MASK, 2, RS_VALUE_ONE, FALSE, { 0, 0, RS_TEST_W - 1, RS_TEST_H - 1 },
+      { 3, 12 } },
+    { RS_OP_MASK, 3, 0x8000, FALSE, { 40, 0, 80, 35 }, { 30, 30 } },
+    { RS_OP_TRIANGLE, 0, RS_VALUE_ONE, FALSE, { 0, 0, RS_TEST_W - 1, RS_TEST_H - 1 },
+      { 50 * RS_SUBPIXEL + 17, -3 * RS_SUBPIXEL, 95 * RS_SUBPIXEL,
+        20 * RS_SUBPIXEL + 100, 60 * RS_SUBPIXEL + 3, 45 * RS_SUBPIXEL } },
+    { RS_OP_GROUP, 0, 0xc000, FALSE, { 0 }, { 0 } },
+    { RS_OP_RECT, 2, 0x6000, TRUE, { 0, 0, RS_TEST_W - 1, RS_TEST_H - 1 },
+      { 0, 20, 70, 40 } },
+    { RS_OP_GROUP, 0, 0x8000, FALSE, { 0 }, { 0 } },
+    { RS_OP_TRIANGLE, 2, RS_VALUE_ONE, TRUE, { 18, 0, 50, 60 },
+      { 10 * RS_SUBPIXEL, 50 * RS_SUBPIXEL, 40 * RS_SUBPIXEL, 10 * RS_SUBPIXEL,
+        70 * RS_SUBPIXEL, 55 * RS_SUBPIXEL } },
+    { RS_OP_ENDGROUP, 0, 0, FALSE, { 0 }, { 0 } },
+    { RS_OP_IMAGE, 0, RS_VALUE_ONE, FALSE, { 0, 0, RS_TEST_W - 1, RS_TEST_H - 1 },
+      { 20, 30, 40, 10, -8, 24 } },
+    { RS_OP_ENDGROUP, 0, 0, FALSE, { 0 }, { 0 } },
+    { RS_OP_IMAGEMASK, 1, RS_VALUE_ONE, FALSE, { 0, 0, 90, 50 },
+      { 60, 25, 30, 0, 0, -20 } },
+    { RS_OP_IMAGE, 1, 0x9000, FALSE, { 0, 0, RS_TEST_W - 1, RS_TEST_H - 1 },
+      { 5, 40, 60, -5, 3, 20, 10, 38, 50, 0, 0, 25 } },
+    { RS_OP_RECT, 0, RS_VALUE_ONE, FALSE, { 0, 0, RS_TEST_W - 1, RS_TEST_H - 1 },
+      { 90, -10, 200, 100 } },
+    { RS_OP_MASK, 3, RS_VALUE_ONE, FALSE, { 0, 0, RS_TEST_W - 1, RS_TEST_H - 1 },
+      { -10, -4 } },
+  } ;
+#define RS_TEST_NOPS (sizeof(ops) / sizeof(ops[0]))
+  static const uint8 image_samples[RS_TEST_IH][(RS_TEST_IW - 1) * 2] = {
+    { 0x00, 0xff, 0x40, 0x80, 0x80, 0x40, 0xff, 0x00 },
+    { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80 },
+    { 0xf0, 0xe0, 0xd0, 0xc0, 0xb0, 0xa0, 0x90, 0x80 },
+    { 0x33, 0x66, 0x99, 0xcc, 0xff, 0x00, 0x11, 0x22 },
+  } ;
+  static const uint8 mask_samples[RS_TEST_MH][RS_TEST_MW] = {
+    { 1, 0, 0, 1, 1, 0 },
+    { 0, 255, 0, 0, 1, 1 },
+    { 1, 1, 1, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 1 },
+    { 7, 0, 7, 0, 7, 0 },
+  } ;
+  static const int32 image_colorants[2] = { 0, 1 } ;
+  static const int32 mask_colorants[1] = { RS_COLORANT_ALL } ;
+  blit_t bits[RS_TEST_GH * FORM_LINE_BYTES(RS_TEST_GW) / sizeof(blit_t)] ;
+  uint16 expected[RS_TEST_W * RS_TEST_H * RS_TEST_NCH] ;
+  uint16 actual[RS_TEST_W * RS_TEST_H * RS_TEST_NCH] ;
+  RS_IMAGE_DEF image, mask ;
+  FORM form ;
+  RS_BUFFER stream = { NULL, 0, 0, FALSE } ;
+  RS_WRITER w ;
+  RS_READER rs ;
+  uint32 colorid[RS_TEST_NCOLORS], maskid, clipid ;
+  int32 i, x, y ;
+  Bool isnew, ok ;
+
+  /* A glyph with repeated rows, empty rows, and spans at both edges. */
+  form.type = FORMTYPE_CACHEBITMAP ;
+  form.addr = bits ;
+  form.w = RS_TEST_GW ;
+  form.h = RS_TEST_GH ;
+  form.l = FORM_LINE_BYTES(RS_TEST_GW) ;
+  form.size = RS_TEST_GH * form.l ;
+  form.rh = RS_TEST_GH ;
+  form.hoff = 0 ;
+  HqMemZero(bits, sizeof(bits)) ;
+  for ( y = 0 ; y < RS_TEST_GH ; ++y ) {
+    blit_t *row = BLIT_ADDRESS(bits, y * form.l) ;
+
+    for ( x = 0 ; x < RS_TEST_GW ; ++x ) {
+      if ( y != 4 && ((x + (y >> 1) * 3) % 7 < 3 || x == RS_TEST_GW - 1) )
+        *BLIT_ADDRESS(row, BLIT_OFFSET(x)) |= AONE >> (x & BLIT_MASK_BITS) ;
+    }
   }
-  for ( nr.ptr = band->cmds ; nr.ptr < band->cmds + band->size; )
-  {
-    uint8 ch = *nr.ptr++;
-
-    if ( ch & 0x80 ) /* escape command */
-    {
-      switch ( ch & 0x7F )
-      {
-        case 0: /* set (x,y) position */
-          rss->x = rs_read(&nr, RS_DBYTE);
-          rss->y = rs_read(&nr, RS_UNS8);
-          if ( rss->dst == NULL )
-            printf("    moveto (%d,%d)\n", rss->x, rss->y);
-          break;
-        case 1: /* Define a color */
-        {
-          uint8 colori, red, green, blue;
-
-          colori = rs_read(&nr, RS_BYTE);
-          red    = rs_read(&nr, RS_BYTE);
-          green  = rs_read(&nr, RS_BYTE);
-          blue   = rs_read(&nr, RS_BYTE);
-
-          rss->color[colori].r = red;
-          rss->color[colori].g = green;
-          rss->color[colori].b = blue;
-
-          if ( rss->dst == NULL )
-            printf("    define color[%d] = (%x,%x,%x)\n",
-                   colori, red, green, blue);
-          break;
-        }
-        case 2: /* Set current color */
-        {
-          uint8 colori = rs_read(&nr, RS_BYTE);
-
-          rss->colori = colori;
-          if ( rss->dst == NULL )
-            printf("    current color = %d\n", colori);
-          break;
-        }
-        case 3: /* Set run length mode to abutting */
-          rss->rlemode = RS_ABUTTING;
-          if ( rss->dst == NULL )
-            printf("    rlemode = ABUTTING\n");
-          break;
-        case 4: /* Set run length mode to vertical */
-          rss->rlemode = RS_VERTICAL;
-          if ( rss->dst == NULL )
-            printf("    rlemode = VERTICAL\n");
-          break;
-        case 5: /* Render a rectangle */
-        {
-          int32 w = rs_read(&nr, RS_UNS8);
-          int32 h = rs_read(&nr, RS_UNS8);
-
-          if ( rss->dst == NULL )
-            printf("    rectangle %d*%d\n", w, h);
-          else
-            paintRectangle(rss, w, h);
-          break;
-        }
-        case 6: /* Render a y hull */
-        {
-          int32 ya = rs_read(&nr, RS_UNS8);
-          int32 yb = rs_read(&nr, RS_UNS8);
-          int32 i, nleft, nright;
-          RS_COORD left[17], right[17];
-
-          nleft = nright = rs_read(&nr, RS_BYTE);
-          nleft >>= 4; nright &= 0x0F;
-          nleft += 2; nright += 2;
-          left[0].x = rs_read(&nr, RS_OFF16);
-          left[0].y = rs_read(&nr, RS_OFF16);
-          for ( i = 1; i < nleft; i++ )
-          {
-            left[i].x = left[i-1].x + rs_read(&nr, RS_SIGN8);
-            left[i].y = left[i-1].y + rs_read(&nr, RS_UNS8);
-          }
-          right[0].x = rs_read(&nr, RS_OFF16);
-          right[0].y = rs_read(&nr, RS_OFF16);
-          for ( i = 1; i < nright; i++ )
-          {
-            right[i].x = right[i-1].x + rs_read(&nr, RS_SIGN8);
-            right[i].y = right[i-1].y + rs_read(&nr, RS_UNS8);
-          }
 
-          if ( rss->dst == NULL )
-          {
-            printf("    y-hull %d->%d", ya, yb);
-            printf(" %d:",nleft);
-            for ( i = 0; i < nleft; i++ )
-              printf("(%d,%d)", left[i].x, left[i].y);
-            printf(" %d:",nright);
-            for ( i = 0; i < nright; i++ )
-              printf("(%d,%d)", right[i].x, right[i].y);
-            printf("\n");
-          }
-          else
-            paintHull(rss, ya, yb, nleft, nright, left, right);
-
-          break;
+  /* A two colorant image whose first column is not stored, and a one
+     colorant image mask. */
+  HqMemZero(&image, sizeof(image)) ;
+  image.w = RS_TEST_IW ;
+  image.h = RS_TEST_IH ;
+  image.x1 = 1 ;
+  image.x2 = RS_TEST_IW - 1 ;
+  image.y2 = RS_TEST_IH - 1 ;
+  image.bps = 1 ;
+  image.ncomps = 2 ;
+  image.samples = &image_samples[0][0] ;
+  HqMemZero(&mask, sizeof(mask)) ;
+  mask.w = RS_TEST_MW ;
+  mask.h = RS_TEST_MH ;
+  mask.x2 = RS_TEST_MW - 1 ;
+  mask.y2 = RS_TEST_MH - 1 ;
+  mask.bps = 1 ;
+  mask.ncomps = 1 ;
+  mask.samples = &mask_samples[0][0] ;
+
+  ok = rs_writer_begin(&w, rs_test_sink, &stream, 1, 2, RS_TEST_W,
+                       RS_TEST_H, RS_TEST_BAND) ;
+  HQASSERT(ok, "Rainstorm stream could not be started") ;
+
+  for ( i = 0 ; i < (int32)RS_TEST_NCOLORS ; ++i ) {
+    const int32 *color = rs_test_colors[i] ;
+
+    ok = rs_idmap_lookup(&w.colors, &colorid[i], &colorid[i], &isnew) ;
+    HQASSERT(ok && isnew && colorid[i] == (uint32)i,
+             "Rainstorm colour ids should be allocated in order") ;
+    rs_put_uvar(&w.def, colorid[i]) ;
+    rs_put_uvar(&w.def, (uint32)color[0]) ;
+    if ( color[0] == RS_COLOR_TINTS ) {
+      if ( color[1] == color[2] ) {
+        rs_put_uvar(&w.def, 1) ;
+        rs_put_svar(&w.def, RS_COLORANT_ALL) ;
+        rs_put_u16(&w.def, (uint32)color[1]) ;
+      } else {
+        rs_put_uvar(&w.def, color[2] >= 0 ? 2 : 1) ;
+        rs_put_svar(&w.def, 0) ;
+        rs_put_u16(&w.def, (uint32)color[1]) ;
+        if ( color[2] >= 0 ) {
+          rs_put_svar(&w.def, 1) ;
+          rs_put_u16(&w.def, (uint32)color[2]) ;
         }
-        case 7: /* Render a rectangle of raster data */
-        {
-          int32 sw = rs_read(&nr, RS_UNS8);
-          int32 sh = rs_read(&nr, RS_UNS8);
-          int32 tx = rs_read(&nr, RS_UNS8);
-          int32 ty = rs_read(&nr, RS_UNS8);
-          int32 tw = rs_read(&nr, RS_UNS8);
-          int32 th = rs_read(&nr, RS_UNS8);
-          int32 dw = rs_read(&nr, RS_UNS8);
-          int32 dh = rs_read(&nr, RS_UNS8);
-          int32 colorspace, compress, i, bytes;
-
-          colorspace = compress = rs_read(&nr, RS_UNS8);
-          colorspace >>= 4; compress &= 0x0F;
-          bytes = rs_read(&nr, RS_DBYTE);
-          bytes = bytes + 256*256*rs_read(&nr, RS_DBYTE);
-
-          if ( rss->dst == NULL )
-          {
-            uint8 im;
-            int32 i, maxi;
-
-            printf("    contone rectangle %d*%d -> %d*%d %d*%d@(%d,%d) : %d/%d",
-                sw,sh,dw,dh,tw,th,tx,ty,colorspace,compress);
-            printf(" %d bytes of compressed image data : <", bytes);
-            if ( (maxi = bytes) > 50 ) maxi = 50;
-            for ( i = 0; i < maxi; i++ )
-              printf("%02x", nr.ptr[i]);
-            printf("...>\n");
-          }
-          else
-            paintContone(rss,sw,sh,tx,ty,tw,th,dw,dh,colorspace,compress,
-                         bytes,nr.ptr);
+      }
+    }
+    ok = rs_emit_def(&w, RS_REC_COLOR) ;
+    HQASSERT(ok, "Rainstorm colour could not be defined") ;
+  }
+  rs_test_image(&w, &image, image_colorants) ;
+  rs_test_image(&w, &mask, mask_colorants) ;
+
+  /* The glyph is mask 0, and is also the clip mask. */
+  ok = rs_form_mask(&w, &form, &clipid) ;
+  HQASSERT(ok && clipid == 0, "Rainstorm mask should be defined once") ;
+
+  for ( i = 0 ; i < (int32)RS_TEST_NOPS ; ++i ) {
+    const RS_TEST_OP *op = &ops[i] ;
+    int32 j ;
+
+    if ( op->op == RS_OP_GROUP ) {
+      rs_put_byte(&w.ops, RS_OP_GROUP) ;
+      rs_put_u16(&w.ops, op->alpha) ;
+      continue ;
+    } else if ( op->op == RS_OP_ENDGROUP ) {
+      rs_put_byte(&w.ops, RS_OP_ENDGROUP) ;
+      continue ;
+    }
 
-          nr.ptr += bytes;
-          break;
-        }
-        case 8: /* Render a parallelogram strip of raster data */
-          break;
-        case 9: /* Render a complete smooth shade triangle */
-          break;
-        case 10: /* Render runs within a smooth shade triangle */
-          break;
-        case 11: /* Define a cached raster mask */
-          break;
-        case 12: /* Render a cached raster mask */
-        {
-          uint8 id = rs_read(&nr, RS_BYTE);
-          int32 x  = rs_read(&nr, RS_OFF16);
-          int32 y  = rs_read(&nr, RS_SIGN8);
-
-          if ( rss->dst == NULL )
-            printf("    glyph[%d] @ (%d,%d)\n", id, x, y);
-          else
-            paintGlyph(rss, id, x, y);
-
-          break;
-        }
-        case 13: /* Override default object type */
-          break;
-        case 14: /* set overprint */
-          break;
-        case 127: /* Debug message */
-        {
-          char message[257];
-          int32 i, len = rs_read(&nr, RS_BYTE);
-
-          for ( i = 0; i < len; i++ )
-            message[i] = *nr.ptr++;
-          message[len] = '\0';
-
-          if ( rss->dst == NULL )
-            printf("    message '%s'\n", message);
-        }
-        break;
-        default:
-          if ( rss->dst == NULL )
-            printf("    unknown cmd '%d'\n", ch);
-          return -1;
-          break;
+    rs_op_color(&w, colorid[op->color]) ;
+    if ( op->op == RS_OP_ERASE ) {
+      rs_op_erase(&w) ;
+      ++w.nobjects ;
+      continue ;
+    }
+
+    rs_op_clip(&w, &op->clip) ;
+    rs_op_alpha(&w, op->alpha) ;
+    if ( op->clipmask != (w.nclipmasks > 0) ) {
+      rs_put_byte(&w.ops, RS_OP_CLIPMASKS) ;
+      rs_put_uvar(&w.ops, op->clipmask ? 1 : 0) ;
+      if ( op->clipmask ) {
+        rs_put_uvar(&w.ops, clipid) ;
+        rs_put_svar(&w.ops, RS_TEST_CMX) ;
+        rs_put_svar(&w.ops, RS_TEST_CMY) ;
       }
+      w.nclipmasks = op->clipmask ? 1 : 0 ;
     }
-    else /* color and a run */
-    {
-      uint8 color = (ch & 0x70)>>4;
-      int32 run = 1 + (ch & 0xF);
-
-      nr.ptr--;
-      if ( rss->rlemode == RS_VERTICAL && color == 0 )
-        run = rs_read(&nr, RS_DELTA4);
-      else
-        run = rs_read(&nr, RS_VAL4);
 
-      if ( rss->dst == NULL )
-        printf("    color %d : run %d\n", color, run);
-      else
-        paintRun(rss, color, rss->x, rss->y, run);
+    switch ( op->op ) {
+    case RS_OP_RECT: {
+      dbbox_t rect ;
 
-      if ( rss->rlemode == RS_VERTICAL )
-        rss->y++;
-      else
-        rss->x += run;
+      bbox_store(&rect, op->v[0], op->v[1], op->v[2], op->v[3]) ;
+      rs_op_rect(&w, &rect) ;
+      break ;
+    }
+    case RS_OP_MASK:
+      ok = rs_form_mask(&w, &form, &maskid) ;
+      HQASSERT(ok && maskid == clipid, "Rainstorm mask should be defined once") ;
+      rs_op_mask(&w, maskid, op->v[0], op->v[1]) ;
+      break ;
+    case RS_OP_TRIANGLE:
+      rs_put_byte(&w.ops, RS_OP_TRIANGLE) ;
+      for ( j = 0 ; j < 6 ; ++j )
+        rs_put_svar(&w.ops, op->v[j]) ;
+      for ( j = 0 ; j < 3 ; ++j )
+        rs_put_uvar(&w.ops, colorid[(op->color + j) % RS_TEST_NCOLORS]) ;
+      break ;
+    case RS_OP_IMAGE:
+      /* The colour of an image is whether it is masked. */
+      rs_put_byte(&w.ops, RS_OP_IMAGE) ;
+      rs_put_uvar(&w.ops, 0) ;
+      rs_put_uvar(&w.ops, op->color != 0 ? 2 : 0) ;
+      for ( j = 0 ; j < (op->color != 0 ? 12 : 6) ; ++j )
+        rs_put_svar(&w.ops, op->v[j]) ;
+      break ;
+    case RS_OP_IMAGEMASK:
+      rs_put_byte(&w.ops, RS_OP_IMAGEMASK) ;
+      rs_put_uvar(&w.ops, 1) ;
+      for ( j = 0 ; j < 6 ; ++j )
+        rs_put_svar(&w.ops, op->v[j]) ;
+      break ;
     }
+    ++w.nobjects ;
   }
-  return 1;
+  ok = rs_writer_end(&w) ;
+  HQASSERT(ok && !stream.failed, "Rainstorm stream could not be finished") ;
+  rs_writer_free(&w) ;
+
+  ok = rs_read_open(&rs, stream.data, stream.size) ;
+  HQASSERT(ok, "Rainstorm stream should be valid") ;
+  HQASSERT(rs.width == RS_TEST_W && rs.height == RS_TEST_H &&
+           rs.band_lines == RS_TEST_BAND && rs.job == 1 && rs.page == 2 &&
+           rs.flags == 0 && rs.nobjects == RS_TEST_NOPS - 4 &&
+           rs.nrobjs == RS_TEST_NOPS - 4 && rs.ncolors == RS_TEST_NCOLORS &&
+           rs.nmasks == 1 && rs.nimages == 2 &&
+           rs.nchannels == RS_TEST_NCH && rs.channels[0] == 0 &&
+           rs.channels[1] == 1,
+           "Rainstorm stream page details are wrong") ;
+
+  /* The stream rendered as a whole page and band by band must match the
+     commands painted directly. */
+  rs_test_reference(expected, ops, RS_TEST_NOPS, &form, &image, &mask) ;
+  rs_read_render(&rs, actual, 0, RS_TEST_H) ;
+  HQASSERT(rs_adler32(1, (uint8 *)actual, sizeof(actual)) ==
+           rs_adler32(1, (uint8 *)expected, sizeof(expected)) &&
+           HqMemCmp((uint8 *)actual, sizeof(actual),
+                    (uint8 *)expected, sizeof(expected)) == 0,
+           "Rainstorm page rendering differs from direct rendering") ;
+  for ( y = 0 ; y < RS_TEST_H ; y += RS_TEST_BAND ) {
+    int32 y1 = min(y + RS_TEST_BAND, RS_TEST_H) ;
+    size_t bytes = (size_t)(y1 - y) * RS_TEST_W * RS_TEST_NCH * sizeof(actual[0]) ;
+
+    rs_read_render(&rs, actual, y, y1) ;
+    HQASSERT(rs_adler32(1, (uint8 *)actual, bytes) ==
+             rs_adler32(1, (uint8 *)&expected[y * RS_TEST_W * RS_TEST_NCH],
+                        bytes) &&
+             HqMemCmp((uint8 *)actual, (int32)bytes,
+                      (uint8 *)&expected[y * RS_TEST_W * RS_TEST_NCH],
+                      (int32)bytes) == 0,
+             "Rainstorm band rendering differs from direct rendering") ;
+  }
+  rs_read_close(&rs) ;
+
+  /* Corruption and truncation must be detected. */
+  stream.data[stream.size / 2] ^= 0x10 ;
+  HQASSERT(!rs_read_open(&rs, stream.data, stream.size),
+           "Corrupt Rainstorm stream should be rejected") ;
+  stream.data[stream.size / 2] ^= 0x10 ;
+  HQASSERT(!rs_read_open(&rs, stream.data, stream.size - 1),
+           "Truncated Rainstorm stream should be rejected") ;
+
+  rs_buffer_free(&stream) ;
+  UNUSED_PARAM(Bool, ok) ;
 }
 
-void show_page_defines(RSS *rss)
-{
-  int32 id, nn, w, h;
-  NIBREAD nr;
-  uint8 *rle;
+#endif /* ASSERT_BUILD && !BUILD_RSREAD } */
 
-  for ( id = 0; id < 256; id++ )
-  {
-    if ( ( rle = find_glyph(rss, id, &nn, &w, &h) ) != NULL && nn > 0 )
-    {
-      int32 val, npairs, repeat = 0;
-      int32 runs[100];
-
-      printf("    glyph[%d] %d*%d %d nibbles : ", id, w, h, nn);
-      nr.ptr = rle;
-      nr.nib = FALSE;
-
-      while ( (nr.ptr - rle)*2 + (nr.nib ? 1 : 0 ) < nn )
-      {
-        val = rs_read(&nr, RS_NIBBLE);
-
-        switch ( val )
-        {
-          case 0:
-            printf("VAL4 ");
-            break;
-          case 1: case 2: case 3: case 4: case 5: case 6:
-          case 7: case 8: case 9: case 10: case 11:
-            npairs = val;
-            printf("%d(",npairs);
-            for ( val = 0; val < npairs*2; val++ )
-            {
-              runs[val] = rs_read(&nr, RS_VAL4);
-              if ( val != 0 )
-                printf(",");
-              printf("%d",runs[val]);
-            }
-            printf(") ");
-            break;
-          case 12:
-            printf("DELTA4 ");
-            break;
-          case 13:
-            printf("DELTA2p2 ");
-            break;
-          case 14:
-            repeat = rs_read(&nr, RS_VAL4);
-            printf("REPEAT(%d) ", repeat);
-            break;
-          case 15:
-            printf("0() ");
-            break;
+/* ========================================================================== */
+#ifdef BUILD_RSREAD /* { Stand-alone reader */
+
+/** Names of the commands, for listing. */
+static const char *rsread_ops[] = {
+  "?", "colour", "clip", "erase", "rect", "mask", "alpha", "clipmasks",
+  "triangle", "image", "imagemask", "group", "endgroup"
+} ;
+
+/**
+ * List the records and the rebuilt display list of a stream.
+ */
+static void rsread_list(RS_READER *rs)
+{
+  RS_CURSOR c ;
+  uint32 i, j ;
+
+  printf("job %u page %u: %d x %d, %d lines/band\n", rs->job, rs->page,
+         rs->width, rs->height, rs->band_lines) ;
+  printf("%u colours, %u masks, %u images, %u objects, %u omitted%s\n",
+         rs->ncolors, rs->nmasks, rs->nimages, rs->nobjects, rs->nomitted,
+         (rs->flags & RS_PAGE_PARTIAL) != 0 ? " (partial page)" : "") ;
+  printf("colorants:") ;
+  for ( i = 0 ; i < rs->nchannels ; ++i )
+    printf(" %d", rs->channels[i]) ;
+  printf("\n") ;
+
+  c.p = rs->stream + RS_ID_BYTES ;
+  c.end = rs->stream + rs->len ;
+  c.bad = FALSE ;
+  while ( c.p < c.end ) {
+    uint32 type = rs_get_byte(&c), size = rs_get_uvar(&c) ;
+    RS_CURSOR r ;
+
+    r.p = c.p ;
+    r.end = c.p + size ;
+    r.bad = FALSE ;
+    c.p = r.end ;
+
+    switch ( type ) {
+    case RS_REC_COLOR: {
+      uint32 id = rs_get_uvar(&r), kind = rs_get_uvar(&r), n ;
+
+      printf("colour %u:", id) ;
+      if ( kind == RS_COLOR_BLACK )
+        printf(" black") ;
+      else if ( kind == RS_COLOR_WHITE )
+        printf(" white") ;
+      else
+        for ( n = rs_get_uvar(&r) ; n > 0 && !r.bad ; --n ) {
+          int32 ci = rs_get_svar(&r) ;
+          printf(" %d=%u", ci, rs_get_u16(&r)) ;
         }
-      }
-      printf("\n");
+      printf("\n") ;
+      break ;
     }
-  }
-}
+    case RS_REC_MASK: {
+      uint32 id = rs_get_uvar(&r), w = rs_get_uvar(&r), h = rs_get_uvar(&r) ;
 
-int rsread(RSS *rss)
-{
-  int32 size, err = 0;
-  RS_JOB_BLOCK  rs_job_block;
-  RS_PAGE_BLOCK rs_page_block;
-
-  size = sizeof(rss->rs_id_block);
-  if ( fread(&(rss->rs_id_block), 1, size, rss->src) != size )
-    return -1;
-  if ( rss->rs_id_block.magic[0] != RS_MAGIC0 ||
-       rss->rs_id_block.magic[1] != RS_MAGIC1 )
-    return -1;
-  if ( rss->rs_id_block.version[0] != 0 ||
-       rss->rs_id_block.version[1] != 0 )
-    return -1;
-
-  size = sizeof(rs_job_block);
-  if ( fread(&(rs_job_block), 1, size, rss->src) != size )
-    return -1;
-  size = rs_job_block.meta_size;
-  rss->rs_job_block = (RS_JOB_BLOCK *)malloc(sizeof(RS_JOB_BLOCK) + size);
-  if ( rss->rs_job_block == NULL )
-    return -1;
-  *(rss->rs_job_block) = rs_job_block;
-  if ( fread(rss->rs_job_block + 1, 1, size, rss->src) != size )
-    return -1;
-
-  size = sizeof(rs_page_block);
-  if ( fread(&(rs_page_block), 1, size, rss->src) != size )
-    return -1;
-  size = rs_page_block.meta_size;
-  rss->rs_page_block = (RS_PAGE_BLOCK *)malloc(sizeof(RS_PAGE_BLOCK) + size);
-  if ( rss->rs_page_block == NULL )
-    return -1;
-  *(rss->rs_page_block) = rs_page_block;
-  if ( fread(rss->rs_page_block + 1, 1, size, rss->src) != size )
-    return -1;
-
-  size = sizeof(rss->page_defines.size);
-  if ( fread(&(rss->page_defines.size), 1, size, rss->src) != size )
-    return -1;
-  size = rss->page_defines.size;
-  if ( ( rss->page_defines.ptr = (uint8 *)malloc(size) ) == NULL )
-    return -1;
-  if ( fread(rss->page_defines.ptr, 1, size, rss->src) != size )
-    return -1;
-
-  if ( rss->dst )
-  {
-    if ( bmp_setup(rss) < 0 )
-      return -1;
-  }
-  else
-  {
-    printf("Rainstorm stream :\n");
-    printf("================\n");
-    printf("  magic numbers %x %x\n", rss->rs_id_block.magic[0],
-                                      rss->rs_id_block.magic[1]);
-    printf("  versions %d %d\n", rss->rs_id_block.version[0],
-                                 rss->rs_id_block.version[1]);
-    printf("  jobid %d\n", rss->rs_job_block->id);
-    printf("  %d bytes of job meta data\n", rss->rs_job_block->meta_size);
-    printf("  pageid %d\n", rss->rs_page_block->id);
-    printf("  rasterStyle %d\n", rss->rs_page_block->rasterStyle);
-    printf("  page dims %d*%d\n", rss->rs_page_block->pageWidth,
-                                  rss->rs_page_block->pageHeight);
-    printf("  %d colors %d bits\n", rss->rs_page_block->colors,
-                                    rss->rs_page_block->bits);
-    printf("  background (%x,%x,%x)\n", rss->rs_page_block->bg[0],
-                                  rss->rs_page_block->bg[1],
-                                  rss->rs_page_block->bg[2]);
-    printf("  %d bytes of page meta data\n", rss->rs_page_block->meta_size);
-    printf("  %d bytes of page defines\n", rss->page_defines.size);
-    show_page_defines(rss);
-    printf("  ....\n");
-  }
-
-  while ( fread(&size, 1, sizeof(int32), rss->src) == sizeof(int32) &&
-          size != -1 )
-  {
-    rss->band.y0 = size;
-    fread(&(rss->band.y1), 1, sizeof(int32), rss->src);
-    fread(&(rss->band.size), 1, sizeof(int32), rss->src);
-
-    if ( (size = rss->band.size) > 0 )
-    {
-      rss->band.cmds = malloc(size);
-      if ( fread(rss->band.cmds, 1, size, rss->src) != size )
-        return -1;
-
-      if ( rs_do_band(rss) < 0 )
-      {
-        err = -1;
-        break;
-      }
-      free(rss->band.cmds);
+      printf("mask %u: %u x %u, %u bytes\n", id, w, h,
+             (uint32)(r.end - r.p)) ;
+      break ;
+    }
+    case RS_REC_IMAGE: {
+      uint32 id = rs_get_uvar(&r) ;
+      const RS_IMAGE_DEF *image = &rs->images[id] ;
+
+      printf("image %u: %d x %d, stored (%d,%d) (%d,%d), %d x %d bytes\n",
+             id, image->w, image->h, image->x1, image->y1, image->x2,
+             image->y2, image->ncomps, image->bps) ;
+      break ;
+    }
+    default:
+      break ;
     }
   }
-  if ( rss->dst == NULL )
-    printf("  End of bands\n");
-  else
-    fwrite(rss->pageRaster, 1, rss->rasterWidth*rss->rasterHeight, rss->dst);
-
-  if ( err < 0 )
-    return err;
 
-  if ( fread(&size, 1, sizeof(int32), rss->src) != sizeof(int32) || size != -1 )
-  {
-    printf("  More than 1 page ?\n");
-    return -1;
+  for ( i = 0 ; i < rs->nrobjs ; ++i ) {
+    const RS_ROBJ *robj = &rs->robjs[i] ;
+
+    printf("  %s", rsread_ops[robj->op < sizeof(rsread_ops) / sizeof(rsread_ops[0])
+                              ? robj->op : 0]) ;
+    if ( robj->op == RS_OP_MASK || robj->op == RS_OP_IMAGE ||
+         robj->op == RS_OP_IMAGEMASK )
+      printf(" %u", robj->id) ;
+    if ( robj->maskid > 0 )
+      printf(" masked by %u", robj->maskid - 1) ;
+    if ( robj->op != RS_OP_IMAGE )
+      printf(" colour %d", (int32)robj->color[0]) ;
+    printf(" alpha %u in (%d,%d) (%d,%d)", robj->alpha, robj->bbox[0],
+           robj->bbox[1], robj->bbox[2], robj->bbox[3]) ;
+    for ( j = 0 ; j < robj->nclipmasks ; ++j )
+      printf(" clip mask %u", rs->placed[robj->clipmasks + j].id) ;
+    printf("\n") ;
   }
-  if ( rss->dst == NULL )
-    printf("  End of page\n");
-  return 1;
 }
 
-void main(int ac, char *av[])
+int main(int argc, char *argv[])
 {
-  int err = 0;
-  RSS rss;
+  RS_READER rs ;
+  FILE *f ;
+  uint8 *stream ;
+  uint16 *raster ;
+  long len ;
+  int32 band, y ;
+  int list = 0, checksum = 0, arg = 1 ;
+
+  for ( ; arg < argc && argv[arg][0] == '-' ; ++arg ) {
+    if ( strcmp(argv[arg], "-l") == 0 )
+      list = 1 ;
+    else if ( strcmp(argv[arg], "-c") == 0 )
+      checksum = 1 ;
+    else
+      break ;
+  }
+  if ( arg >= argc || (!list && !checksum && arg + 1 >= argc) ) {
+    fprintf(stderr, "usage: rsread [-l] [-c] in.rs [out.ppm]\n") ;
+    return 2 ;
+  }
 
-  init_catch();
+  if ( (f = fopen(argv[arg], "rb")) == NULL ||
+       fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0 ||
+       len > 0x7fffffff || fseek(f, 0, SEEK_SET) != 0 ||
+       (stream = malloc(len > 0 ? len : 1)) == NULL ||
+       fread(stream, 1, len, f) != (size_t)len ) {
+    fprintf(stderr, "rsread: cannot read %s\n", argv[arg]) ;
+    return 1 ;
+  }
+  fclose(f) ;
+
+  if ( !rs_read_open(&rs, stream, (int32)len) ) {
+    fprintf(stderr, "rsread: %s is not a valid Rainstorm %d.x stream\n",
+            argv[arg], RS_VERSION_MAJOR) ;
+    return 1 ;
+  }
 
-  rss.src = rss.dst = NULL;
+  if ( list )
+    rsread_list(&rs) ;
 
-  if ( ac == 3 && strcmp(av[1],"-l") == 0 &&
-       (rss.src = fopen(av[2], "rb")) != NULL )
-  {
-    err = rsread(&rss);
+  if ( !checksum && arg + 1 >= argc )
+    return 0 ;
+
+  /* Render a band at a time, as a consumer of the stream would. */
+  band = rs.band_lines > 0 ? rs.band_lines : 64 ;
+  if ( (raster = malloc((size_t)rs.width * band * rs.nchannels *
+                        sizeof(uint16) + 1)) == NULL ) {
+    fprintf(stderr, "rsread: out of memory\n") ;
+    return 1 ;
   }
-  else if ( ac == 4 && strcmp(av[1],"-c") == 0 &&
-       (rss.src = fopen(av[2], "rb")) != NULL &&
-       (rss.dst = fopen(av[3], "wb")) != NULL )
-  {
-    err = rsread(&rss);
+  f = NULL ;
+  if ( arg + 1 < argc ) {
+    if ( (f = fopen(argv[arg + 1], "wb")) == NULL ) {
+      fprintf(stderr, "rsread: cannot write %s\n", argv[arg + 1]) ;
+      return 1 ;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", rs.width, rs.height) ;
   }
-  else
   {
-    fprintf(stderr, "List contents of a Rainstorm file\n");
-    fprintf(stderr, "    usage : rsread -l rs-filename\n");
-    fprintf(stderr, "Convert Rainstorm file to .bmp format\n");
-    fprintf(stderr, "    usage : rsread -c rs-filename bmp-filename\n");
+    uint32 adler = 1 ;
+
+    for ( y = 0 ; y < rs.height ; y += band ) {
+      int32 y1 = y + band < rs.height ? y + band : rs.height, i ;
+
+      rs_read_render(&rs, raster, y, y1) ;
+      adler = rs_adler32(adler, (uint8 *)raster, (size_t)rs.width *
+                         (y1 - y) * rs.nchannels * sizeof(uint16)) ;
+      /* The reader does not know the colour space of the page, so the
+         first three colorants are shown as RGB, or one as grey. */
+      for ( i = 0 ; f != NULL && i < rs.width * (y1 - y) ; ++i ) {
+        const uint16 *pixel = raster + (size_t)i * rs.nchannels ;
+        uint8 rgb[3] ;
+        uint32 j ;
+
+        for ( j = 0 ; j < 3 ; ++j )
+          rgb[j] = (uint8)(pixel[j < rs.nchannels ? j : 0] >> 8) ;
+        fwrite(rgb, 1, 3, f) ;
+      }
+    }
+    if ( checksum )
+      printf("%08x\n", adler) ;
   }
-  if ( rss.src )
-    fclose(rss.src);
-  if ( rss.dst )
-    fclose(rss.dst);
-  if ( err < 0 )
-    fprintf(stderr, "!! Rainstorm read failed\n");
+  if ( f != NULL )
+    fclose(f) ;
+
+  free(raster) ;
+  rs_read_close(&rs) ;
+  free(stream) ;
+  return 0 ;
 }
 
 #endif /* BUILD_RSREAD } */
 
-/* ==========================================================================
- *
-* Log stripped */
+/* Log stripped */
@@ -3,67 +3,164 @@
  *
  * $HopeName: SWv20!src:rainstorm.h(EBDSDK_P.1) $
  *
- * Copyright (C) 1989-2008 Global Graphics Software Ltd. All rights reserved.
+ * Copyright (C) 1989-2014 Global Graphics Software Ltd. All rights reserved.
  * Global Graphics Software Ltd. Confidential Information.
  *
  * \brief
- * Rainstorm prototype header defines
+ * Rainstorm page raster command stream format definitions.
  * ( See rainstorm.c source file for more Rainstorm details )
  *
- * N.B. THIS IS PROTOTYPE CODE THAT WILL BE THROWN AWAY
- *      WHEN MAIN DEVELOPMENT STARTS !
+ * This header is shared between the RIP, which writes the stream, and the
+ * stand-alone reader built with BUILD_RSREAD, so it only uses the basic
+ * integer types.
  */
 
 #ifndef __RAINSTORM_H__
 #define __RAINSTORM_H__
 
-typedef struct RS_ID_BLOCK
-{
-  uint32 magic[2];
-  uint32 version[2];
-} RS_ID_BLOCK;
+/** \defgroup rainstorm_format Rainstorm stream format
+ * \ingroup dl
+ *
+ * A stream starts with a 12 byte identification block:
+ *
+ *   RS_MAGIC0, RS_MAGIC1   (each 4 bytes, least significant byte first)
+ *   RS_VERSION_MAJOR       (2 bytes, least significant byte first)
+ *   RS_VERSION_MINOR       (2 bytes, least significant byte first)
+ *
+ * followed by a sequence of records, each of which is
+ *
+ *   type (1 byte), payload length (uvar), payload
+ *
+ * so a reader can skip records it does not understand. Readers must reject
+ * a stream with a different major version; minor version changes only add
+ * record types or trailing payload fields.
+ *
+ * Integers in payloads are variable length: a uvar is an unsigned value in
+ * 7-bit groups, least significant group first, with the top bit set on all
+ * but the last byte. An svar is a signed value zig-zag mapped onto a uvar.
+ * Colour values and opacities are 2 bytes, least significant byte first.
+ *
+ * Colour values are additive, as they are in the display list: 0 is no
+ * light and RS_VALUE_ONE is full light, so black is 0 in every colorant and
+ * white is RS_VALUE_ONE. Colorants are the RIP's colorant indices, or
+ * RS_COLORANT_ALL for a value which applies to every colorant. Colorants
+ * absent from a colour are left unchanged by painting it, as they are when
+ * overprinting.
+ *
+ * Coordinates are device space pixels. Rectangles and clips are inclusive
+ * of both corners, as display list bounding boxes are. Triangle vertices
+ * are in units of 1/RS_SUBPIXEL pixels. A triangle or image paints the
+ * pixels whose centres it covers; image point (u, v) in a w x h image is at
+ * (tx + wx * u / w + hx * v / h, ty + wy * u / w + hy * v / h).
+ *
+ * Painting with opacity a changes each colorant value c painted to
+ * c + (p - c) * a / RS_VALUE_ONE, where p is the value painted. A group's
+ * opacity multiplies the opacity of everything in it. Blend modes, soft
+ * masks, knockout and isolated groups are not represented.
+ * @{
+ */
 
 #define RS_MAGIC0 0x5261696E
 #define RS_MAGIC1 0x0D0A890A
 
-typedef struct RS_JOB_BLOCK
-{
-  uint32 id;
-  uint32 meta_size;
-} RS_JOB_BLOCK;
-
-typedef struct RS_PAGE_BLOCK
-{
-  uint32 id;
-  uint32 rasterStyle;
-  uint32 pageWidth;
-  uint32 pageHeight;
-  uint8  colors, bits, spare1, spare2;
-  uint8  bg[4];
-  uint32 meta_size;
-} RS_PAGE_BLOCK;
-
-typedef struct RS_BAND_BLOCK
-{
-  uint32 y0, y1;
-  uint32 size;
-  Bool   nib;
-  uint8 *cmds;
-} RS_BAND_BLOCK;
-
-#define RS_ABUTTING 0
-#define RS_VERTICAL 1
-
-#define RS_VAL4      1
-#define RS_UNS8      2
-#define RS_SIGN8     3
-#define RS_OFF16     4
-#define RS_SIZE16    5
-#define RS_BYTE      6
-#define RS_DBYTE     7
-#define RS_NIBBLE    8
-#define RS_DELTA4    9
-#define RS_DELTA2p2  10
+#define RS_VERSION_MAJOR 2
+#define RS_VERSION_MINOR 0
+
+/** Size of the identification block. */
+#define RS_ID_BYTES 12
+
+/** Colour value of full light, and opacity of an opaque paint. */
+#define RS_VALUE_ONE 0xff00
+
+/** Colorant of a value which applies to every colorant. */
+#define RS_COLORANT_ALL (-1)
+
+/** Number of triangle vertex units in a pixel. */
+#define RS_SUBPIXEL 256
+
+/** Largest number of components in an image. */
+#define RS_MAX_COMPONENTS 16
+
+/** Deepest nesting of groups. */
+#define RS_MAX_GROUP_DEPTH 32
+
+/** Record types. */
+enum {
+  RS_REC_JOB = 1,     /**< uvar job number. */
+  RS_REC_PAGE,        /**< uvar page number, width, height, band lines. */
+  RS_REC_COLOR,       /**< uvar id, kind; for RS_COLOR_TINTS, uvar count,
+                           then count pairs of svar colorant, 2 byte value. */
+  RS_REC_MASK,        /**< uvar id, width, height, then row blocks of uvar
+                           rows, uvar pairs, and pairs of uvar white and
+                           black span lengths. */
+  RS_REC_OBJECTS,     /**< A sequence of RS_OP_ commands. */
+  RS_REC_END,         /**< uvar flags, objects written, objects omitted,
+                           then the 4 byte Adler-32 checksum of all of the
+                           stream before the checksum. */
+  RS_REC_IMAGE        /**< uvar id, width, height, x1, y1, x2, y2 of the
+                           stored samples (inclusive), bytes per sample (1
+                           or 2), components, svar colorant of each
+                           component, then the stored samples row by row
+                           with the components of each sample together.
+                           1 byte samples are colour values / 256. */
+} ;
+
+/** Colour kinds in RS_REC_COLOR. */
+enum {
+  RS_COLOR_BLACK = 0, /**< The constant black colour. */
+  RS_COLOR_WHITE,     /**< The constant white colour. */
+  RS_COLOR_TINTS      /**< An explicit set of colorant values. */
+} ;
+
+/** Commands in RS_REC_OBJECTS records. Colours, masks and images must be
+    defined before they are used. */
+enum {
+  RS_OP_COLOR = 1,    /**< uvar colour id to paint with. */
+  RS_OP_CLIP,         /**< svar x1, y1, x2, y2 of the clip rectangle. */
+  RS_OP_ERASE,        /**< Paint the whole page in the current colour. */
+  RS_OP_RECT,         /**< svar x1, y1, x2, y2 of a rectangle. */
+  RS_OP_MASK,         /**< uvar mask id, svar x, y of its top left. */
+  RS_OP_ALPHA,        /**< 2 byte opacity of the following paints. */
+  RS_OP_CLIPMASKS,    /**< uvar count, then count of uvar mask id, svar x,
+                           y: the following paints are also clipped to the
+                           intersection of the masks. */
+  RS_OP_TRIANGLE,     /**< svar x, y of three vertices, then uvar colour id
+                           of each vertex, interpolated linearly. */
+  RS_OP_IMAGE,        /**< uvar image id, mask image id + 1 or 0, svar tx,
+                           ty, wx, wy, hx, hy; then if masked, the mask
+                           image's svar tx, ty, wx, wy, hx, hy. The image
+                           paints where the mask's samples are not 0. */
+  RS_OP_IMAGEMASK,    /**< uvar image id, svar tx, ty, wx, wy, hx, hy: paint
+                           the current colour where the samples are not 0. */
+  RS_OP_GROUP,        /**< 2 byte opacity of a group's contents. */
+  RS_OP_ENDGROUP      /**< End the innermost group. */
+} ;
+
+/** Flags in RS_REC_END. */
+enum {
+  RS_PAGE_PARTIAL = 1 /**< Some objects on the page could not be written. */
+} ;
+
+/** @} */
+
+#ifndef BUILD_RSREAD
+
+struct DL_STATE ;
+
+/** Write the display list of a page as a Rainstorm stream, if the
+    Rainstorm system parameter is set. The stream is a debugging aid, so
+    failing to write it is reported but does not fail the page. */
+void rainstorm(struct DL_STATE *page) ;
+
+#if defined(ASSERT_BUILD)
+/** Check that streams written read back and render the same as painting
+    their primitives directly. */
+void rainstorm_unit_test(void) ;
+#else
+#define rainstorm_unit_test() EMPTY_STATEMENT()
+#endif
+
+#endif /* !BUILD_RSREAD */
 
 #endif /* protection for multiple inclusion */
 
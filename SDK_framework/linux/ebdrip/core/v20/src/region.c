@@ -666,6 +666,20 @@ static Bool dlregion_callback(DL_FORALL_INFO *info)
     }
   }
 
+  /* The objects a replay renders were marked where the replayed HDL is, not
+     where the replay is. Replayed HDLs have no transparent, overprinted or
+     patterned objects, so only the enclosing group or overprint tracking can
+     require the replay's area to be composited. */
+  if ( lobj->opcode == RENDER_hdl && group != NULL ) {
+    dcoord dx, dy;
+
+    if ( hdlReplayOf(lobj->dldata.hdl, &dx, &dy) != NULL &&
+         (groupMustComposite(group) || data->regionInfo != NULL) ) {
+      bitGridSetBoxMapped(page->regionMap, &lobj->bbox, TRUE);
+      return TRUE;
+    }
+  }
+
   /* Only DL objects inside a group can be composited. Watermarks and traps are
      added straight into the HDL base. */
   if ( group == NULL || !requires_marking(lobj) ||
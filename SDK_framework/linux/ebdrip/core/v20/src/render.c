@@ -109,6 +109,7 @@
 #include "tranState.h"
 #include "imexpand.h" /* IM_EXPBUF */
 #include "pscontext.h"
+#include "rainstorm.h" /* rainstorm */
 
 /** The partial painting mechanism of writing out partially painted bands
    to disk before reading them back in again for the next stage of rendering
@@ -177,6 +178,7 @@ struct page_data_t {
   SPOTNO spotno_watermark ; /**< Spotno for watermarking. */
   Bool fail_job ;           /**< Does a render failure fail the job? */
   void *scratch_band; /**< Scratch band to give to PGB. */
+  compress_pool_t compress_pool ; /**< %compress% instances for this page. */
 
   OBJECT_NAME_MEMBER
 } ;
@@ -3103,6 +3105,10 @@ static void page_data_cleanup(corecontext_t *context, void *args)
     if ( page_data->trap_context != NULL )
       trapDispose(&page_data->trap_context) ;
 
+    /* All band compression tasks have finished with the page data, so every
+       %compress% instance is idle. There's nobody to report an error to. */
+    (void)compress_pool_finish(&page_data->compress_pool) ;
+
     HQASSERT(!page_data->surface_started,
              "Surface still open when cleaning up page data") ;
 
@@ -3685,6 +3691,7 @@ static Bool band_render(corecontext_t *context, void *args)
     prs->ri.overrideColorType = GSC_UNDEFINED;
     prs->ri.generate_object_map = FALSE;
     prs->ri.bounds = prs->cs.bandlimits ;
+    prs->ri.x_dl_offset = prs->ri.y_dl_offset = 0 ;
     prs->ri.ht_params = NULL;
     prs->ri.group_tracker = NULL ;
     prs->ri.surface = surface ;
@@ -3798,8 +3805,12 @@ static Bool band_compress(corecontext_t *context, void *args)
   band_data_t *band = args ;
   frame_data_t *frame ;
   sheet_data_t *sheet ;
+  page_data_t *page_data ;
   Bool result = FALSE ;
-  DEVICELIST *compress_dev;
+  compress_device_t *compress_dev ;
+  DEVICELIST *devlist ;
+  DEVICE_FILEDESCRIPTOR compress_fd ;
+  int32 size_uncompressed ;
   band_t *pband ;
   DL_STATE *page ;
 
@@ -3817,56 +3828,50 @@ static Bool band_compress(corecontext_t *context, void *args)
   page = context->page ;
   HQASSERT(page != NULL, "No output page") ;
 
-  /** \todo ajcd 2010-12-10: Maybe re-factor back to sharing a small set of
-      compress device clones for the whole page, and storing a pointer to the
-      compression device in the args. For now, we'll do the allocation, setup
-      and deallocation every time and measure if it is a significant drain
-      before creating a compress device pool. */
-
-  /* Create a new instance of the %compress% device for just this band. */
-  compress_dev = device_alloc(STRING_AND_LENGTH("compress"));
+  /** \todo ajcd 2011-01-03: I don't like recalculating the band size, and
+      I don't like the page reference. We should probably store the line
+      range in the band_data_t, or some such. */
+  size_uncompressed = CAST_SIZET_TO_INT32(page->band_l) * band->y_allocated ;
+
+  /* Take an instance of the %compress% device from the page's pool. It is
+     only set up again if the last band it compressed had a different
+     configuration. */
+  page_data = sheet->pass_data->page_data ;
+  compress_dev = compress_device_acquire(&page_data->compress_pool,
+                                         page->pgbdev,
+                                         sheet->colorants_per_band,
+                                         size_uncompressed) ;
   if ( compress_dev == NULL )
     return FALSE ;
 
-  if ( device_connect(compress_dev, COMPRESS_DEVICE_TYPE,
-                      (char*)compress_dev->name, 0, TRUE) ) {
-    /** \todo ajcd 2011-01-03: I don't like recalculating the band size, and
-        I don't like the page reference. We should probably store the
-        line range in the band_data_t, or some such. */
-    int32 size_uncompressed = CAST_SIZET_TO_INT32(page->band_l) *
-      band->y_allocated ;
-    DEVICE_FILEDESCRIPTOR compress_fd =
-      open_compress_device(compress_dev,
-                           page->pgbdev, sheet->colorants_per_band,
-                           size_uncompressed);
-
-    if ( compress_fd >= 0 ) {
-      int32 size_if_compressed = compress_band(compress_dev, compress_fd,
-                                               (uint8 *)pband->mem,
-                                               pband->size_to_write / sheet->colorants_per_band) ;
-
-      if (size_if_compressed == 0) { /* Unrecoverable error */
-        pband->fCompressed = FALSE;
-        result = device_error_handler(compress_dev) ;
-      } else if (size_if_compressed > 0) {
-        /* A -ve return indicates that the band could not be compressed */
-        pband->fCompressed = TRUE;
-        pband->size_to_write = size_if_compressed ;
-        result = TRUE ;
-      } else {
-        pband->fCompressed = FALSE;
-        result = TRUE ;
-      }
+  devlist = compress_device_list(compress_dev) ;
+  compress_fd = open_compress_device(devlist) ;
+  if ( compress_fd >= 0 ) {
+    int32 size_if_compressed ;
+
+    PROBE(SW_TRACE_COMPRESS_BAND_ENCODE, (intptr_t)band,
+          size_if_compressed =
+            compress_band(devlist, compress_fd, (uint8 *)pband->mem,
+                          pband->size_to_write / sheet->colorants_per_band)) ;
+
+    if (size_if_compressed == 0) { /* Unrecoverable error */
+      pband->fCompressed = FALSE;
+      result = device_error_handler(devlist) ;
+    } else if (size_if_compressed > 0) {
+      /* A -ve return indicates that the band could not be compressed */
+      pband->fCompressed = TRUE;
+      pband->size_to_write = size_if_compressed ;
+      result = TRUE ;
+    } else {
+      pband->fCompressed = FALSE;
+      result = TRUE ;
+    }
 
-      close_compress_device(compress_dev, compress_fd) ;
-    } else /* open_compress_device failed */
-      return device_error_handler(compress_dev) ;
-  } else /* device_connect failed */
-    return device_error_handler(compress_dev) ;
+    close_compress_device(devlist, compress_fd) ;
+  } else /* open_compress_device failed */
+    result = device_error_handler(devlist) ;
 
-  if ( (*theIDevDismount(compress_dev))(compress_dev) == -1 )
-    result = device_error_handler(compress_dev);
-  device_free(compress_dev) ;
+  compress_device_release(&page_data->compress_pool, &compress_dev, result) ;
 
   return result ;
 }
@@ -4772,6 +4777,7 @@ static Bool render_tasks_sheet(corecontext_t *context, pass_data_t *pass,
        stored anywhere convenient. We must release this reference to the
        render group. */
     render_tasks = task_group_current(TASK_GROUP_RENDER) ;
+    HQASSERT(render_tasks != NULL, "Not rendering inside a render group") ;
 
     /* Create data for construction of a graph. */
     /* The sheet group is joined by render_all_frames_of_dl(). We use reference
@@ -4991,6 +4997,7 @@ void render_state_mask(render_state_t *rs, blit_chain_t *blits,
   rs->ri.p_rs = rs ;
   rs->ri.lobj = NULL;
   rs->ri.clip = rs->ri.bounds = rs->cs.bandlimits;
+  rs->ri.x_dl_offset = rs->ri.y_dl_offset = 0;
   rs->ri.region_set_type = RENDER_REGIONS_DIRECT;
   rs->ri.overrideColorType = GSC_UNDEFINED ;
   rs->ri.fSoftMaskInPattern = FALSE ;
@@ -5338,6 +5345,7 @@ static Bool spawn_all_passes_of_page(corecontext_t *context, int32 numcopies,
     page_data->fail_job = (spawn_type == DL_ERASE_ALL) ;
     dlc_clear(&page_data->dlc_watermark) ;
     page_data->spotno_watermark = SPOT_NO_INVALID ;
+    compress_pool_init(&page_data->compress_pool) ;
     NAME_OBJECT(page_data, PAGE_DATA_NAME) ;
 
     /* Pipelining doesn't yet manage all the memory properly with resources.
@@ -5803,6 +5811,11 @@ Bool renderbands_(ps_context_t *pscontext)
       return FALSE ;
   }
 
+#if defined(DEBUG_BUILD)
+  /* Serialise the finished display list, if requested. */
+  rainstorm(context->page) ;
+#endif
+
   return spawn_all_passes_of_page(context, numcopies, PAINT_TYPE_FINAL) ;
 }
 
@@ -5963,6 +5976,8 @@ void v20render_C_globals(
   blit_color_init(&mask_knockout_color, &mask_blitmap) ;
   blit_color_mask(&mask_knockout_color, TRUE /*white*/) ;
 
+  compress_C_globals() ;
+
   fns->postboot = render_postboot;
   fns->finish = render_finish;
 }
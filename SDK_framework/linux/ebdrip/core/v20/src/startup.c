@@ -42,6 +42,7 @@
 #include "display.h"
 #include "graphics.h"
 #include "gu_fills.h"
+#include "forms.h"
 #include "gu_chan.h"
 #include "routedev.h"
 #include "asyncps.h"   /* init_async_memory */
@@ -183,6 +184,7 @@ Bool dostart( void )
   init_sepomit_debug();             /* Separation omission */
   init_patternshape_debug() ;       /* Pattern shapes debug/trace */
   init_polycache_debug() ;          /* Polygon caching debug/trace */
+  init_formcache_debug() ;          /* Form DL caching debug/trace */
 #endif
 
   /* Initial values of realtime and usertime. */
@@ -460,6 +462,7 @@ IMPORT_INIT_C_GLOBALS( security )
 IMPORT_INIT_C_GLOBALS( spdetect )
 IMPORT_INIT_C_GLOBALS( vndetect )
 IMPORT_INIT_C_GLOBALS( polycache )
+IMPORT_INIT_C_GLOBALS( forms )
 
 /** Compound runtime initialisation */
 void v20_C_globals(core_init_fns *fns)
@@ -472,6 +475,7 @@ void v20_C_globals(core_init_fns *fns)
   init_C_globals_spdetect() ;
   init_C_globals_vndetect() ;
   init_C_globals_polycache();
+  init_C_globals_forms();
 }
 
 /*
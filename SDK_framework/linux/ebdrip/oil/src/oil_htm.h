@@ -92,8 +92,25 @@ typedef struct HTI {
 /* 4-bpp */
 sw_htm_api *htm4bpp_getInstance();
 void htm4bpp_remapHTtables(OIL_eScreenQuality eImageQuality, OIL_eScreenQuality eGraphicsQuality, OIL_eScreenQuality eTextQuality);
+void htm4bpp_getHTtables(OIL_eScreenQuality *peImageQuality, OIL_eScreenQuality *peGraphicsQuality, OIL_eScreenQuality *peTextQuality);
 /* 2-bpp */
 sw_htm_api *htm2bpp_getInstance();
 void htm2bpp_remapHTtables(OIL_eScreenQuality eImageQuality, OIL_eScreenQuality eGraphicsQuality, OIL_eScreenQuality eTextQuality);
+void htm2bpp_getHTtables(OIL_eScreenQuality *peImageQuality, OIL_eScreenQuality *peGraphicsQuality, OIL_eScreenQuality *peTextQuality);
+
+/* Line screening, used by the modules' DoHalftone() and by the screening
+   tests. The reference functions screen one pixel at a time. */
+void scrn4bppLine(const HTI *ourInst, sw_htm_coord lineY, int32 width,
+                  const uint8 *pSrc8, const uint8 *pObjMap,
+                  const sw_htm_raster_unit *pMsk, sw_htm_raster_unit *pDst);
+void scrn4bppLineReference(const HTI *ourInst, sw_htm_coord lineY, int32 width,
+                           const uint8 *pSrc8, const uint8 *pObjMap,
+                           const sw_htm_raster_unit *pMsk, sw_htm_raster_unit *pDst);
+void scrn2bppLine(const HTI *ourInst, sw_htm_coord lineY, int32 width,
+                  const uint8 *pSrc, const uint8 *pObjMap,
+                  const sw_htm_raster_unit *pMsk, sw_htm_raster_unit *pDst);
+void scrn2bppLineReference(const HTI *ourInst, sw_htm_coord lineY, int32 width,
+                           const uint8 *pSrc, const uint8 *pObjMap,
+                           const sw_htm_raster_unit *pMsk, sw_htm_raster_unit *pDst);
 
 #endif /* __OIL_HTM_H__ */
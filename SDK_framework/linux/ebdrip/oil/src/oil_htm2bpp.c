@@ -40,7 +40,7 @@ static int lint_flag = 0 ;
 #endif
 
 #ifdef GG_OBJ_TYPES
-static uint32 uaMaps[256];
+uint32 g_ua2bppMaps[256];
 #endif
 /**
  * @brief The @a sw_htm_api instance used to register the module with the RIP.
@@ -361,7 +361,7 @@ sw_htm_api *htm2bpp_getInstance()
 
 #ifdef GG_OBJ_TYPES
   for(x = 0; x<256; x++)
-      uaMaps[x]=0;
+      g_ua2bppMaps[x]=0;
 #endif
 
   return &htmApi ;
@@ -478,5 +478,37 @@ void htm2bpp_remapHTtables(OIL_eScreenQuality eImageQuality, OIL_eScreenQuality
   htm2bpp_setupHTtables();
 }
 
+/**
+ * \brief Find the screen quality currently mapped for an object type.
+ *
+ * The quality is recovered from the table \c htm2bpp_remapHTtables() chose
+ * for the cyan colorant, which always changes with the others.
+ */
+static OIL_eScreenQuality htm2bpp_quality(int obj)
+{
+  switch(st2bppScreenLookup[obj].eHtTables[OIL_Cyan])
+  {
+  case PMS_SCREEN_2BPP_IMAGE_CYAN:
+    return OIL_Scrn_LowLPI;
+  case PMS_SCREEN_2BPP_GFX_CYAN:
+    return OIL_Scrn_MediumLPI;
+  default:
+    return OIL_Scrn_HighLPI;
+  }
+}
+
+/**
+ * \brief Report the screen qualities the screen lookup table is configured for.
+ *
+ * The qualities returned can be passed back to \c htm2bpp_remapHTtables() to
+ * restore the current configuration.
+ */
+void htm2bpp_getHTtables(OIL_eScreenQuality *peImageQuality, OIL_eScreenQuality *peGraphicsQuality, OIL_eScreenQuality *peTextQuality)
+{
+  *peImageQuality = htm2bpp_quality(GG_OBJ_IMAGE);
+  *peGraphicsQuality = htm2bpp_quality(GG_OBJ_GFX);
+  *peTextQuality = htm2bpp_quality(GG_OBJ_TEXT);
+}
+
 
 
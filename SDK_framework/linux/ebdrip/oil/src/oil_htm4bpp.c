@@ -46,7 +46,7 @@ static int lint_flag = 0 ;
 #endif
 
 #ifdef GG_OBJ_TYPES
-static uint32 uaMaps[256];
+uint32 g_ua4bppMaps[256];
 #endif
 /**
  * @brief The @a sw_htm_api instance used to register the module with the RIP.
@@ -368,7 +368,7 @@ sw_htm_api *htm4bpp_getInstance()
 
 #ifdef GG_OBJ_TYPES
   for(x = 0; x<256; x++)
-      uaMaps[x]=0;
+      g_ua4bppMaps[x]=0;
 #endif
 
   return &htmApi ;
@@ -485,5 +485,37 @@ void htm4bpp_remapHTtables(OIL_eScreenQuality eImageQuality, OIL_eScreenQuality
   htm4bpp_setupHTtables();
 }
 
+/**
+ * \brief Find the screen quality currently mapped for an object type.
+ *
+ * The quality is recovered from the table \c htm4bpp_remapHTtables() chose
+ * for the cyan colorant, which always changes with the others.
+ */
+static OIL_eScreenQuality htm4bpp_quality(int obj)
+{
+  switch(st4bppScreenLookup[obj].eHtTables[OIL_Cyan])
+  {
+  case PMS_SCREEN_4BPP_IMAGE_CYAN:
+    return OIL_Scrn_LowLPI;
+  case PMS_SCREEN_4BPP_GFX_CYAN:
+    return OIL_Scrn_MediumLPI;
+  default:
+    return OIL_Scrn_HighLPI;
+  }
+}
+
+/**
+ * \brief Report the screen qualities the screen lookup table is configured for.
+ *
+ * The qualities returned can be passed back to \c htm4bpp_remapHTtables() to
+ * restore the current configuration.
+ */
+void htm4bpp_getHTtables(OIL_eScreenQuality *peImageQuality, OIL_eScreenQuality *peGraphicsQuality, OIL_eScreenQuality *peTextQuality)
+{
+  *peImageQuality = htm4bpp_quality(GG_OBJ_IMAGE);
+  *peGraphicsQuality = htm4bpp_quality(GG_OBJ_GFX);
+  *peTextQuality = htm4bpp_quality(GG_OBJ_TEXT);
+}
+
 
 
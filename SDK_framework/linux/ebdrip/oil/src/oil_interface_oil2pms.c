@@ -460,6 +460,8 @@ int OIL_FileBytes(void * handle)
  *
  * This routine passes the completed band to PMS. \n
  * It is called only in push band delivery model. \n
+ * In \c OIL_PUSH_BAND mode the band's memory was leased from the PMS, and is
+ * handed over to it here. \n
  */
 int SubmitBandToPMS(PMS_TyBandPacket *ptBandpacket)
 {
@@ -512,6 +514,15 @@ int SubmitBandToPMS(PMS_TyBandPacket *ptBandpacket)
   } /* do checksums */
 
   /* checkin the band packet */
+  if(ptBandpacket != NULL &&
+     g_ConfigurableFeatures.eBandDeliveryType == OIL_PUSH_BAND)
+  {
+    int nResult = PMS_CheckinBand(ptBandpacket);
+
+    /* the leased band now belongs to the PMS, unless the check in failed */
+    UnleaseBandRasters(ptBandpacket, !nResult);
+    return nResult;
+  }
   return (PMS_CheckinBand(ptBandpacket));
 }
 
@@ -60,6 +60,8 @@ extern int(**g_apfn_pms_calls[PMS_TOTAL_NUMBER_OF_API_FUNCTIONS])();
 #define PMS_RasterLayout          (int)(*(*g_apfn_pms_calls)[EPMS_FN_RasterLayout])
 #define PMS_RasterRequirements    (int)(*(*g_apfn_pms_calls)[EPMS_FN_RasterRequirements])
 #define PMS_RasterDestination     (int)(*(*g_apfn_pms_calls)[EPMS_FN_RasterDestination])
+#define PMS_LeaseBuffer           (int)(*(*g_apfn_pms_calls)[EPMS_FN_LeaseBuffer])
+#define PMS_ReleaseBuffer         (int)(*(*g_apfn_pms_calls)[EPMS_FN_ReleaseBuffer])
 #define PMS_RippingComplete       (int)(*(*g_apfn_pms_calls)[EPMS_FN_RippingComplete])
 #define PMS_Malloc                (int)(*(*g_apfn_pms_calls)[EPMS_FN_Malloc])
 #define PMS_Free                  (int)(*(*g_apfn_pms_calls)[EPMS_FN_Free])
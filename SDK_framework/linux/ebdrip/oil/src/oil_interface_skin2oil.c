@@ -787,6 +787,18 @@ int32 RIPCALL OIL_RasterCallback(void *pJobContext,
               ptCurrentBandPacket = ptBandPacket;
               ptCurrentBandPacket->uBandNumber = iBandNumber+1;
             }
+            /* copy the band into memory leased from the PMS */
+            if (g_ConfigurableFeatures.eBandDeliveryType == OIL_PUSH_BAND &&
+                !LeaseBandRasters(ptCurrentBandPacket, nOutputLinesPerBand * nOutputBytesPerLine))
+            {
+              if(g_pstCurrentPage->ptPMSpage != NULL)
+                OIL_PageDone(g_pstCurrentPage->ptPMSpage);
+              else
+                DeleteOILPage(g_pstCurrentPage);
+              OIL_JobCancel();
+              OIL_ProbeLog(SW_TRACE_OIL_RASTERCALLBACK, SW_TRACETYPE_EXIT, (intptr_t)0);
+              return FALSE ;
+            }
           }
 
           /* loop to copy rasters into correct planes and hook them into g_pstCurrentPage */
@@ -1357,6 +1369,9 @@ PMS_TyBandInfo stPMSBandInfo;
         nBandHeight = stPMSBandInfo.LinesPerBand;
       nBandSize = stPMSBandInfo.BytesPerLine * nBandHeight;
         /* set buffer data to zero */
+      if (g_ConfigurableFeatures.eBandDeliveryType == OIL_PUSH_BAND &&
+          !LeaseBandRasters(ptBandPacket, stPMSBandInfo.LinesPerBand * stPMSBandInfo.BytesPerLine))
+        return;
       for(k =0; k < OIL_MAX_PLANES_COUNT; k++)
       {
         if(Map[k] != OIL_InvalidColor)
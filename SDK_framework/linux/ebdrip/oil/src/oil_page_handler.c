@@ -338,8 +338,10 @@ PMS_TyBandPacket *CreateBandPacket(int nColorants, int nColorFamilyOffset, int n
     ptBandPacket->atColoredBand[j].uBandHeight = 0;
     ptBandPacket->atColoredBand[j].cbBandSize = 0;
     /* allocate memory for the band data only in valid planes, if
-       we're not in band direct mode */
-    if(g_ConfigurableFeatures.eBandDeliveryType != OIL_PUSH_BAND_DIRECT_SINGLE &&
+       we're not in band direct mode.  In push band mode the memory is leased
+       from the PMS for each band, see LeaseBandRasters(). */
+    if(g_ConfigurableFeatures.eBandDeliveryType != OIL_PUSH_BAND &&
+       g_ConfigurableFeatures.eBandDeliveryType != OIL_PUSH_BAND_DIRECT_SINGLE &&
        g_ConfigurableFeatures.eBandDeliveryType != OIL_PUSH_BAND_DIRECT_FRAME &&
        ptBandPacket->atColoredBand[j].ePlaneColorant != PMS_INVALID_COLOURANT)
     {
@@ -359,6 +361,79 @@ PMS_TyBandPacket *CreateBandPacket(int nColorants, int nColorFamilyOffset, int n
   return ptBandPacket;
 }
 
+/**
+ * \brief Lease the memory for the next band of a band packet from the PMS
+ *
+ * In push band mode each band is copied into a single buffer leased from
+ * the PMS, holding all of the band's valid planes one after another, which
+ * the PMS can then hook into its page without copying again.  The lease
+ * passes to the PMS when the band is checked in.  If the packet already has
+ * its memory, as for the rest of a partial band, nothing is done.
+ *
+ * \param[in] ptBandPacket   The band packet to fill in.
+ * \param[in] nBytesPerBand  The size of one plane of the band.
+ * \return TRUE if the band packet has its memory, FALSE otherwise.
+ */
+int LeaseBandRasters(PMS_TyBandPacket *ptBandPacket, int nBytesPerBand)
+{
+  unsigned char *pBuffer;
+  int j, nPlanes = 0;
+
+  for(j=0; j < OIL_MAX_PLANES_COUNT; j++)
+  {
+    if(ptBandPacket->atColoredBand[j].ePlaneColorant != PMS_INVALID_COLOURANT)
+    {
+      if(ptBandPacket->atColoredBand[j].pBandRaster != NULL)
+        return TRUE;
+      nPlanes++;
+    }
+  }
+  if(nPlanes == 0)
+    return TRUE;
+
+  if(!PMS_LeaseBuffer((size_t)nPlanes * nBytesPerBand, PMS_LEASE_FOR_BAND, &pBuffer))
+  {
+    HQFAILV(("LeaseBandRasters: Failed to lease %d bytes", nPlanes * nBytesPerBand));
+    return FALSE;
+  }
+
+  for(j=0; j < OIL_MAX_PLANES_COUNT; j++)
+  {
+    if(ptBandPacket->atColoredBand[j].ePlaneColorant != PMS_INVALID_COLOURANT)
+    {
+      ptBandPacket->atColoredBand[j].pBandRaster = pBuffer;
+      pBuffer += nBytesPerBand;
+    }
+  }
+  return TRUE;
+}
+
+/**
+ * \brief Forget the leased memory of a band packet
+ *
+ * Called once the band has been checked in, when the lease belongs to the
+ * PMS.  If \a bRelease is TRUE the band was not checked in, and the lease
+ * is returned to the PMS.
+ */
+void UnleaseBandRasters(PMS_TyBandPacket *ptBandPacket, int bRelease)
+{
+  int j;
+
+  for(j=0; j < OIL_MAX_PLANES_COUNT; j++)
+  {
+    if(ptBandPacket->atColoredBand[j].pBandRaster != NULL)
+    {
+      if(bRelease)
+      {
+        /* All of the planes are in the one lease. */
+        PMS_ReleaseBuffer(ptBandPacket->atColoredBand[j].pBandRaster);
+        bRelease = FALSE;
+      }
+      ptBandPacket->atColoredBand[j].pBandRaster = NULL;
+    }
+  }
+}
+
 /**
  * \brief Processes notification of a 'page done' event.
  *
@@ -446,13 +521,8 @@ void DeleteOILPage(OIL_TyPage *ptOILPage)
     {
       PMS_TyBandPacket *ptBandPacket;
       ptBandPacket = (PMS_TyBandPacket *)ptOILPage->ptBandPacket;
-      for(j=0; j < OIL_MAX_PLANES_COUNT; j++)
-      {
-        if(ptBandPacket->atColoredBand[j].pBandRaster)
-        {
-          OIL_free(OILMemoryPoolJob,(void *)ptBandPacket->atColoredBand[j].pBandRaster);
-        }
-      }
+      /* return the lease of a band which was never checked in */
+      UnleaseBandRasters(ptBandPacket, TRUE);
       OIL_free(OILMemoryPoolJob,(void *)ptBandPacket);
     }
     else if (g_ConfigurableFeatures.eBandDeliveryType == OIL_PUSH_BAND_DIRECT_SINGLE ||
@@ -25,6 +25,8 @@ extern void DeleteOILPage(OIL_TyPage *ptOILPage);
 extern OIL_TyPage* CreateOILBlankPage(OIL_TyPage *ptOILPage, struct rasterDescription *pstRasterDescription);
 extern void CreateOILBlankPlane(OIL_TyPage *ptOILPage, int colorant, OIL_TyPlane *ptOILSamplePlane);
 PMS_TyBandPacket *CreateBandPacket(int nColorants, int nColorFamilyOffset, int nSeparations, int nReqBytesPerLine, int nReqLinesPerBand, short Map[]);
+int LeaseBandRasters(PMS_TyBandPacket *ptBandPacket, int nBytesPerBand);
+void UnleaseBandRasters(PMS_TyBandPacket *ptBandPacket, int bRelease);
 
 extern void CreateConfigTestPage(unsigned char *sz);
 extern void CreatePSTestPage(unsigned char *sz);
@@ -18,10 +18,212 @@
 #include "pms_export.h"
 #include "oil_htm.h"
 #include "swrle.h"
+#include "oil_scrnrow.h"
 #include <string.h>
 #include <stdio.h>
 
 extern HTI* g_2bppHTI[];
+#ifdef GG_OBJ_TYPES
+extern uint32 g_ua2bppMaps[];
+#endif
+
+/** @brief Screen one line, one pixel at a time.
+ *
+ * This is the reference implementation of 2bpp screening, used for lines the
+ * row functions in oil_scrnrow.h cannot handle, and to check their results.
+ *
+ * \param[in]  ourInst  The halftone instance being screened.
+ * \param[in]  lineY    The device line being screened.
+ * \param[in]  width    The number of pixels in the line.
+ * \param[in]  pSrc     The line's source pixels.
+ * \param[in]  pObjMap  The line's object type map.
+ * \param[in]  pMsk     The line's mask.
+ * \param[out] pDst     The line's destination raster.
+ */
+void scrn2bppLineReference(const HTI *ourInst, sw_htm_coord lineY, int32 width,
+                           const uint8 *pSrc, const uint8 *pObjMap,
+                           const sw_htm_raster_unit *pMsk,
+                           sw_htm_raster_unit *pDst)
+{
+  static uint8 anClearPix[4]     = {0x3f, 0xcf, 0xf3, 0xfc};
+  static uint8 anSetPixLevel[3][4] = { {0x40, 0x10, 0x04, 0x01},
+                                       {0x80, 0x20, 0x08, 0x02},
+                                       {0xc0, 0x30, 0x0c, 0x03} };
+  int32 x;
+  uint8* pDest8 = (uint8*)pDst;
+  /* The index into the vertical axis of the cell for this line. */
+  int32 celloffset;
+  const uint8 **ppCell;
+  int32 s;
+  int32 scnSize;
+  uint32 x32 = 0x80000000;
+  uint8 uSrc = 0;
+  uint8 uMap = 0;
+#ifdef LOWBYTEFIRST
+  int8 anSwap[16] = {
+    3, 3, 3, 3,
+    1, 1, 1, 1,
+    -1, -1, -1, -1,
+    -3, -3, -3, -3 };
+#endif
+
+  for(x = 0; x < width; x++)
+  {
+      if(*pMsk & x32)
+      {
+#ifdef LOWBYTEFIRST
+          pDest8 = (uint8*)pDst + (x>>2) + anSwap[x&15];
+#else
+          pDest8 = (uint8*)pDst + (x>>2);
+#endif
+          /* clear the pixel in the byte */
+          *pDest8 &= anClearPix[x%4];
+          uMap = pObjMap[x];
+          if(uMap)
+          {
+            uSrc = pSrc[x];
+            /* Find the byte in the screen pattern cell that contains the first level threshold value */
+            if(uMap & RLE_TEXT_OBJECT)
+            {
+                celloffset = (((lineY % ourInst->pHTables[GG_OBJ_TEXT].uHeight) * ourInst->pHTables[GG_OBJ_TEXT].uWidth)
+                             + (x % ourInst->pHTables[GG_OBJ_TEXT].uWidth));
+                ppCell = &(*ourInst->pHTables[GG_OBJ_TEXT].ditherMatrix)[2];
+                scnSize = (ourInst->pHTables[GG_OBJ_TEXT].uWidth * ourInst->pHTables[GG_OBJ_TEXT].uHeight);
+            }
+            else if(uMap & RLE_LW_OBJECT)
+            {
+                celloffset = (((lineY % ourInst->pHTables[GG_OBJ_GFX].uHeight) * ourInst->pHTables[GG_OBJ_GFX].uWidth)
+                             + (x % ourInst->pHTables[GG_OBJ_GFX].uWidth));
+                ppCell = &(*ourInst->pHTables[GG_OBJ_GFX].ditherMatrix)[2];
+                scnSize = (ourInst->pHTables[GG_OBJ_GFX].uWidth * ourInst->pHTables[GG_OBJ_GFX].uHeight);
+            }
+            else /* RLE_VIGNETTE_OBJECT | RLE_IMAGE_OBJECT | RLE_COMPOSITED_OBJECT */
+            {
+                celloffset = (((lineY % ourInst->pHTables[GG_OBJ_IMAGE].uHeight) * ourInst->pHTables[GG_OBJ_IMAGE].uWidth)
+                             + (x % ourInst->pHTables[GG_OBJ_IMAGE].uWidth));
+                ppCell = &(*ourInst->pHTables[GG_OBJ_IMAGE].ditherMatrix)[2];
+                scnSize = (ourInst->pHTables[GG_OBJ_IMAGE].uWidth * ourInst->pHTables[GG_OBJ_IMAGE].uHeight);
+            }
+
+#ifdef GG_OBJ_TYPES
+            g_ua2bppMaps[uMap]++;
+#endif
+
+            if(uSrc==255)
+            {
+               *pDest8 |= anSetPixLevel[2][x%4];
+            }
+            else if(uSrc)
+            {
+              /* Start at the third threshold value, and work backwards until the source value
+                 is greater than the threshold value. This level is the output level, 1, 2 or 3. */
+              for(s=2;s>=0;s--)
+              {
+                if(uSrc > (*ppCell)[celloffset])
+                {
+                  *pDest8 |= anSetPixLevel[s][x%4];
+                  break;
+                }
+                ppCell--; 
+              }
+            }
+          }
+      }
+
+      x32>>=1;
+      if(x32==0)
+      {
+          x32 = 0x80000000;
+          pMsk++;
+      }
+
+  }
+}
+
+/** @brief Screen one line using the row functions.
+ *
+ * The output levels of each segment of the line are computed by
+ * scrnRowSpan(), and then merged into the destination a raster unit (16
+ * pixels) at a time under the mask. Lines with screen cells too wide for the
+ * row functions are screened by scrn2bppLineReference().
+ *
+ * \param[in]  ourInst  The halftone instance being screened.
+ * \param[in]  lineY    The device line being screened.
+ * \param[in]  width    The number of pixels in the line.
+ * \param[in]  pSrc     The line's source pixels.
+ * \param[in]  pObjMap  The line's object type map.
+ * \param[in]  pMsk     The line's mask.
+ * \param[out] pDst     The line's destination raster.
+ */
+void scrn2bppLine(const HTI *ourInst, sw_htm_coord lineY, int32 width,
+                  const uint8 *pSrc, const uint8 *pObjMap,
+                  const sw_htm_raster_unit *pMsk,
+                  sw_htm_raster_unit *pDst)
+{
+#ifdef OIL_SCRN_ROWS
+  OIL_TyScreenRow aRows[OIL_MAXSCREENOBJECTS];
+  uint8 auLevels[OIL_SCRN_SEGMENT];
+  int32 x0, x, n;
+  int i, j;
+
+  if ( !scrnRowsPrepare(aRows, ourInst, lineY, 3) )
+  {
+    scrn2bppLineReference(ourInst, lineY, width, pSrc, pObjMap, pMsk, pDst);
+    return;
+  }
+
+  for ( x0 = 0 ; x0 < width ; x0 += OIL_SCRN_SEGMENT )
+  {
+    n = width - x0;
+    if ( n > OIL_SCRN_SEGMENT )
+      n = OIL_SCRN_SEGMENT;
+
+    /* Pixels with no object type are left clear. */
+    scrnRowSpan(aRows, 3, TRUE, pSrc, pObjMap, pMsk, x0, n, auLevels);
+
+#ifdef GG_OBJ_TYPES
+    /* Count object types as the reference loop does. */
+    for ( x = 0 ; x < n ; x++ )
+      if ( (pMsk[(x0 + x) >> 5] & (0x80000000u >> ((x0 + x) & 31))) != 0 &&
+           pObjMap[x0 + x] != 0 )
+        g_ua2bppMaps[pObjMap[x0 + x]]++;
+#endif
+
+    /* Each mask word covers 32 pixels, which are two destination words of
+       16 pixels. The first pixel is in the most significant bits. */
+    for ( x = 0 ; x < n ; x += 32 )
+    {
+      uint32 uMsk = scrnRowMask(pMsk, x0 + x, width);
+
+      for ( i = 0 ; uMsk != 0 ; i++, uMsk <<= 16 )
+      {
+        uint32 uBits = uMsk >> 16;
+        const uint8 *pLevel = &auLevels[x + i * 16];
+        uint32 uPairs, uValue;
+        sw_htm_raster_unit *pWord;
+
+        if ( uBits == 0 )
+          continue;
+
+        /* Spread the 16 mask bits to the 16 bit pairs. */
+        uPairs = (uBits | (uBits << 8)) & 0x00ff00ffu;
+        uPairs = (uPairs | (uPairs << 4)) & 0x0f0f0f0fu;
+        uPairs = (uPairs | (uPairs << 2)) & 0x33333333u;
+        uPairs = (uPairs | (uPairs << 1)) & 0x55555555u;
+        uPairs *= 0x3;
+
+        for ( j = 0, uValue = 0 ; j < 16 ; j++ )
+          uValue = (uValue << 2) | pLevel[j];
+
+        pWord = &pDst[(x0 + x + i * 16) >> 4];
+        *pWord = (*pWord & ~uPairs) | (uValue & uPairs);
+      }
+    }
+  }
+#else
+  scrn2bppLineReference(ourInst, lineY, width, pSrc, pObjMap, pMsk, pDst);
+#endif /* OIL_SCRN_ROWS */
+}
 
 /** @brief Implementation of DoHalftone().
  *
@@ -43,15 +245,13 @@ extern HTI* g_2bppHTI[];
 HqBool RIPCALL do2bppHalftone(sw_htm_instance *instance,
                               const sw_htm_dohalftone_request *request)
 {
-  static uint8 anClearPix[4]     = {0x3f, 0xcf, 0xf3, 0xfc};
-  static uint8 anSetPixLevel[3][4] = { {0x40, 0x10, 0x04, 0x01},
-                                       {0x80, 0x20, 0x08, 0x02},
-                                       {0xc0, 0x30, 0x0c, 0x03} };
   sw_htm_coord  lineY = request->first_line_y ;
   uint32        iLine ;
 
   int           i ;
+#ifdef GG_OBJ_TYPES
   int32 x;
+#endif
   HTI           *ourInst = NULL ;
 
   HQASSERT(NULL != request, "") ;
@@ -125,105 +325,18 @@ HqBool RIPCALL do2bppHalftone(sw_htm_instance *instance,
 
     uint8* pSrc = (uint8*)request->src_channels[ 0 ]
                           + ( iLine *request->render_info->src_linebytes );
-    uint8* pDest8 = (uint8*)pDst;
 
     uint8* pObjMap = (uint8*)request->object_props_map + ( iLine * request->render_info->src_linebytes );
 
-
-    /* The index into the vertical axis of the cell for this line. */
-    int32 celloffset;
-    const uint8 **ppCell;
-    int32 s;
-    int32 scnSize;
-    uint32 x32 = 0x80000000;
-    uint8 uSrc = 0;
-    uint8 uMap = 0;
-#ifdef LOWBYTEFIRST
-    int8 anSwap[16] = {
-      3, 3, 3, 3,
-      1, 1, 1, 1,
-      -1, -1, -1, -1,
-      -3, -3, -3, -3 };
-#endif
-
-    for(x = 0; x < request->render_info->width; x++)
-    {
-        if(*pMsk & x32)
-        {
-#ifdef LOWBYTEFIRST
-            pDest8 = (uint8*)pDst + (x>>2) + anSwap[x&15];
-#else
-            pDest8 = (uint8*)pDst + (x>>2);
-#endif
-            /* clear the pixel in the byte */
-            *pDest8 &= anClearPix[x%4];
-            uMap = pObjMap[x];
-            if(uMap)
-            {
-              uSrc = pSrc[x];
-              /* Find the byte in the screen pattern cell that contains the first level threshold value */
-              if(uMap & RLE_TEXT_OBJECT)
-              {
-                  celloffset = (((lineY % ourInst->pHTables[GG_OBJ_TEXT].uHeight) * ourInst->pHTables[GG_OBJ_TEXT].uWidth)
-                               + (x % ourInst->pHTables[GG_OBJ_TEXT].uWidth));
-                  ppCell = &(*ourInst->pHTables[GG_OBJ_TEXT].ditherMatrix)[2];
-                  scnSize = (ourInst->pHTables[GG_OBJ_TEXT].uWidth * ourInst->pHTables[GG_OBJ_TEXT].uHeight);
-              }
-              else if(uMap & RLE_LW_OBJECT)
-              {
-                  celloffset = (((lineY % ourInst->pHTables[GG_OBJ_GFX].uHeight) * ourInst->pHTables[GG_OBJ_GFX].uWidth)
-                               + (x % ourInst->pHTables[GG_OBJ_GFX].uWidth));
-                  ppCell = &(*ourInst->pHTables[GG_OBJ_GFX].ditherMatrix)[2];
-                  scnSize = (ourInst->pHTables[GG_OBJ_GFX].uWidth * ourInst->pHTables[GG_OBJ_GFX].uHeight);
-              }
-              else /* RLE_VIGNETTE_OBJECT | RLE_IMAGE_OBJECT | RLE_COMPOSITED_OBJECT */
-              {
-                  celloffset = (((lineY % ourInst->pHTables[GG_OBJ_IMAGE].uHeight) * ourInst->pHTables[GG_OBJ_IMAGE].uWidth)
-                               + (x % ourInst->pHTables[GG_OBJ_IMAGE].uWidth));
-                  ppCell = &(*ourInst->pHTables[GG_OBJ_IMAGE].ditherMatrix)[2];
-                  scnSize = (ourInst->pHTables[GG_OBJ_IMAGE].uWidth * ourInst->pHTables[GG_OBJ_IMAGE].uHeight);
-              }
-
-#ifdef GG_OBJ_TYPES
-              uaMaps[uMap]++;
-#endif
-
-              if(uSrc==255)
-              {
-                 *pDest8 |= anSetPixLevel[2][x%4];
-              }
-              else if(uSrc)
-              {
-                /* Start at the third threshold value, and work backwards until the source value
-                   is greater than the threshold value. This level is the output level, 1, 2 or 3. */
-                for(s=2;s>=0;s--)
-                {
-                  if(uSrc > (*ppCell)[celloffset])
-                  {
-                    *pDest8 |= anSetPixLevel[s][x%4];
-                    break;
-                  }
-                  ppCell--; 
-                }
-              }
-            }
-        }
-
-        x32>>=1;
-        if(x32==0)
-        {
-            x32 = 0x80000000;
-            pMsk++;
-        }
-
-    }
+    scrn2bppLine(ourInst, lineY, request->render_info->width,
+                 pSrc, pObjMap, pMsk, pDst);
   } /* for each line */
 
 #ifdef GG_OBJ_TYPES
   for( x=0; x<256; x++)
   {
-      if(uaMaps[x])
-          printf("uaMaps[%d]=%d\n", x, uaMaps[x]);
+      if(g_ua2bppMaps[x])
+          printf("uaMaps[%d]=%d\n", x, g_ua2bppMaps[x]);
   }
 #endif
 
@@ -18,10 +18,210 @@
 #include "pms_export.h"
 #include "oil_htm.h"
 #include "swrle.h"
+#include "oil_scrnrow.h"
 #include <string.h>
 #include <stdio.h>
 
 extern HTI* g_4bppHTI[];
+#ifdef GG_OBJ_TYPES
+extern uint32 g_ua4bppMaps[];
+#endif
+
+/** @brief Screen one line, one pixel at a time.
+ *
+ * This is the reference implementation of 4bpp screening, used for lines the
+ * row functions in oil_scrnrow.h cannot handle, and to check their results.
+ *
+ * \param[in]  ourInst  The halftone instance being screened.
+ * \param[in]  lineY    The device line being screened.
+ * \param[in]  width    The number of pixels in the line.
+ * \param[in]  pSrc8    The line's source pixels.
+ * \param[in]  pObjMap  The line's object type map.
+ * \param[in]  pMsk     The line's mask.
+ * \param[out] pDst     The line's destination raster.
+ */
+void scrn4bppLineReference(const HTI *ourInst, sw_htm_coord lineY, int32 width,
+                           const uint8 *pSrc8, const uint8 *pObjMap,
+                           const sw_htm_raster_unit *pMsk,
+                           sw_htm_raster_unit *pDst)
+{
+  int32 x;
+  uint8* pDest8 = (uint8*)pDst;
+  /* The index into the vertical axis of the cell for this line. */
+  int32 celloffset;
+  const uint8 **ppCell;
+  int8 s;
+  int32 scnSize;
+  uint32 x32 = 0x80000000;
+  uint8 uSrc = 0;
+#ifdef LOWBYTEFIRST
+  int8 anSwap[8] = { 3, 3, 1, 1, -1, -1, -3, -3 };
+#endif
+
+  for(x = 0; x < width; x++)
+  {
+      if(*pMsk & x32)
+      {
+#ifdef LOWBYTEFIRST
+          pDest8 = (uint8*)pDst + (x>>1) + anSwap[x&7];
+#else
+          pDest8 = (uint8*)pDst + (x>>1);
+#endif
+          uSrc = pSrc8[x];
+
+          /* clear the pixel */
+          if(x&1)
+             *pDest8 &= 0xF0;
+          else
+             *pDest8 &= 0x0F;
+
+          if(pObjMap[x] & RLE_TEXT_OBJECT)
+          {
+              celloffset = ((lineY % ourInst->pHTables[GG_OBJ_TEXT].uHeight) * ourInst->pHTables[GG_OBJ_TEXT].uWidth)
+                           + (x % ourInst->pHTables[GG_OBJ_TEXT].uWidth);
+              ppCell = &(*ourInst->pHTables[GG_OBJ_TEXT].ditherMatrix)[14];
+              scnSize = (ourInst->pHTables[GG_OBJ_TEXT].uWidth * ourInst->pHTables[GG_OBJ_TEXT].uHeight);
+          }
+          else if(pObjMap[x] & RLE_LW_OBJECT)
+          {
+              celloffset = ((lineY % ourInst->pHTables[GG_OBJ_GFX].uHeight) * ourInst->pHTables[GG_OBJ_GFX].uWidth)
+                           + (x % ourInst->pHTables[GG_OBJ_GFX].uWidth);
+              ppCell = &(*ourInst->pHTables[GG_OBJ_GFX].ditherMatrix)[14];
+              /* Screen pattern size in memory is 8 byte aligned */
+              scnSize = (ourInst->pHTables[GG_OBJ_GFX].uWidth * ourInst->pHTables[GG_OBJ_GFX].uHeight);
+          }
+          else /* RLE_VIGNETTE_OBJECT | RLE_IMAGE_OBJECT | RLE_COMPOSITED_OBJECT */
+          {
+              celloffset = ((lineY % ourInst->pHTables[GG_OBJ_IMAGE].uHeight) * ourInst->pHTables[GG_OBJ_IMAGE].uWidth)
+                           + (x % ourInst->pHTables[GG_OBJ_IMAGE].uWidth);
+              ppCell = &(*ourInst->pHTables[GG_OBJ_IMAGE].ditherMatrix)[14];
+              /* Screen pattern size in memory is 8 byte aligned */
+              scnSize = (ourInst->pHTables[GG_OBJ_IMAGE].uWidth * ourInst->pHTables[GG_OBJ_IMAGE].uHeight);
+          }
+
+#ifdef GG_OBJ_TYPES
+          g_ua4bppMaps[pObjMap[x]]++;
+#endif
+
+          if(uSrc==255)
+          {
+            if(x&1)
+               *pDest8 |= 0x0F;
+            else
+               *pDest8 |= 0xF0;
+          }
+          else if(uSrc)
+          {
+            /* Start at the last (15th) threshold value, and work backwards until the source value
+               is greater than the threshold value. This level is the output level, 1 to 15. */
+            for(s=15;s>0;s--)
+            {
+                if(uSrc > (*ppCell)[celloffset])
+                {
+                    if(x&1)
+                      *pDest8 |= s;
+                    else
+                      *pDest8 |= ((s)<<4);
+                    break;
+                }
+                ppCell--;
+            }
+          }
+      }
+
+      x32>>=1;
+      if(x32==0)
+      {
+          x32 = 0x80000000;
+          pMsk++;
+      }
+
+  }
+}
+
+/** @brief Screen one line using the row functions.
+ *
+ * The output levels of each segment of the line are computed by
+ * scrnRowSpan(), and then merged into the destination a raster unit (eight
+ * pixels) at a time under the mask. Lines with screen cells too wide for the
+ * row functions are screened by scrn4bppLineReference().
+ *
+ * \param[in]  ourInst  The halftone instance being screened.
+ * \param[in]  lineY    The device line being screened.
+ * \param[in]  width    The number of pixels in the line.
+ * \param[in]  pSrc8    The line's source pixels.
+ * \param[in]  pObjMap  The line's object type map.
+ * \param[in]  pMsk     The line's mask.
+ * \param[out] pDst     The line's destination raster.
+ */
+void scrn4bppLine(const HTI *ourInst, sw_htm_coord lineY, int32 width,
+                  const uint8 *pSrc8, const uint8 *pObjMap,
+                  const sw_htm_raster_unit *pMsk,
+                  sw_htm_raster_unit *pDst)
+{
+#ifdef OIL_SCRN_ROWS
+  OIL_TyScreenRow aRows[OIL_MAXSCREENOBJECTS];
+  uint8 auLevels[OIL_SCRN_SEGMENT];
+  int32 x0, x, n;
+  int i;
+
+  if ( !scrnRowsPrepare(aRows, ourInst, lineY, 15) )
+  {
+    scrn4bppLineReference(ourInst, lineY, width, pSrc8, pObjMap, pMsk, pDst);
+    return;
+  }
+
+  for ( x0 = 0 ; x0 < width ; x0 += OIL_SCRN_SEGMENT )
+  {
+    n = width - x0;
+    if ( n > OIL_SCRN_SEGMENT )
+      n = OIL_SCRN_SEGMENT;
+
+    scrnRowSpan(aRows, 15, FALSE, pSrc8, pObjMap, pMsk, x0, n, auLevels);
+
+#ifdef GG_OBJ_TYPES
+    /* Count object types as the reference loop does. */
+    for ( x = 0 ; x < n ; x++ )
+      if ( (pMsk[(x0 + x) >> 5] & (0x80000000u >> ((x0 + x) & 31))) != 0 )
+        g_ua4bppMaps[pObjMap[x0 + x]]++;
+#endif
+
+    /* Each mask word covers 32 pixels, which are four destination words of
+       eight pixels. The first pixel is in the most significant bits. */
+    for ( x = 0 ; x < n ; x += 32 )
+    {
+      uint32 uMsk = scrnRowMask(pMsk, x0 + x, width);
+
+      for ( i = 0 ; uMsk != 0 ; i++, uMsk <<= 8 )
+      {
+        uint32 uBits = uMsk >> 24;
+        const uint8 *pLevel = &auLevels[x + i * 8];
+        uint32 uNibbles, uValue;
+        sw_htm_raster_unit *pWord;
+
+        if ( uBits == 0 )
+          continue;
+
+        /* Spread the eight mask bits to the eight nibbles. */
+        uNibbles = (uBits | (uBits << 12)) & 0x000f000fu;
+        uNibbles = (uNibbles | (uNibbles << 6)) & 0x03030303u;
+        uNibbles = (uNibbles | (uNibbles << 3)) & 0x11111111u;
+        uNibbles *= 0xf;
+
+        uValue = ((uint32)pLevel[0] << 28) | ((uint32)pLevel[1] << 24) |
+                 ((uint32)pLevel[2] << 20) | ((uint32)pLevel[3] << 16) |
+                 ((uint32)pLevel[4] << 12) | ((uint32)pLevel[5] << 8) |
+                 ((uint32)pLevel[6] << 4) | (uint32)pLevel[7];
+
+        pWord = &pDst[(x0 + x + i * 8) >> 3];
+        *pWord = (*pWord & ~uNibbles) | (uValue & uNibbles);
+      }
+    }
+  }
+#else
+  scrn4bppLineReference(ourInst, lineY, width, pSrc8, pObjMap, pMsk, pDst);
+#endif /* OIL_SCRN_ROWS */
+}
 
 /** @brief Implementation of DoHalftone().
  *
@@ -48,7 +248,9 @@ HqBool RIPCALL do4bppHalftone(sw_htm_instance *instance,
   uint32  iLine ;
 
   int           i ;
+#ifdef GG_OBJ_TYPES
   int32 x;
+#endif
   HTI           *ourInst = NULL ;
 
   HQASSERT(NULL != request, "") ;
@@ -122,109 +324,18 @@ HqBool RIPCALL do4bppHalftone(sw_htm_instance *instance,
 
     uint8* pSrc8 = (uint8*)request->src_channels[ 0 ]
                           + ( iLine *request->render_info->src_linebytes );
-    uint8* pDest8 = (uint8*)pDst;
 
     uint8* pObjMap = (uint8*)request->object_props_map + ( iLine * request->render_info->src_linebytes );
 
-
-    /* The index into the vertical axis of the cell for this line. */
-    int32 celloffset;
-    const uint8 **ppCell;
-    int8 s;
-    int32 scnSize;
-    uint32 x32 = 0x80000000;
-    uint8 uSrc = 0;
-#ifdef LOWBYTEFIRST
-    int8 anSwap[8] = { 3, 3, 1, 1, -1, -1, -3, -3 };
-#endif
-
-    for(x = 0; x < request->render_info->width; x++)
-    {
-        if(*pMsk & x32)
-        {
-#ifdef LOWBYTEFIRST
-            pDest8 = (uint8*)pDst + (x>>1) + anSwap[x&7];
-#else
-            pDest8 = (uint8*)pDst + (x>>1);
-#endif
-            uSrc = pSrc8[x];
-
-            /* clear the pixel */
-            if(x&1)
-               *pDest8 &= 0xF0;
-            else
-               *pDest8 &= 0x0F;
-
-            if(pObjMap[x] & RLE_TEXT_OBJECT)
-            {
-                celloffset = ((lineY % ourInst->pHTables[GG_OBJ_TEXT].uHeight) * ourInst->pHTables[GG_OBJ_TEXT].uWidth)
-                             + (x % ourInst->pHTables[GG_OBJ_TEXT].uWidth);
-                ppCell = &(*ourInst->pHTables[GG_OBJ_TEXT].ditherMatrix)[14];
-                scnSize = (ourInst->pHTables[GG_OBJ_TEXT].uWidth * ourInst->pHTables[GG_OBJ_TEXT].uHeight);
-            }
-            else if(pObjMap[x] & RLE_LW_OBJECT)
-            {
-                celloffset = ((lineY % ourInst->pHTables[GG_OBJ_GFX].uHeight) * ourInst->pHTables[GG_OBJ_GFX].uWidth)
-                             + (x % ourInst->pHTables[GG_OBJ_GFX].uWidth);
-                ppCell = &(*ourInst->pHTables[GG_OBJ_GFX].ditherMatrix)[14];
-                /* Screen pattern size in memory is 8 byte aligned */
-                scnSize = (ourInst->pHTables[GG_OBJ_GFX].uWidth * ourInst->pHTables[GG_OBJ_GFX].uHeight);
-            }
-            else /* RLE_VIGNETTE_OBJECT | RLE_IMAGE_OBJECT | RLE_COMPOSITED_OBJECT */
-            {
-                celloffset = ((lineY % ourInst->pHTables[GG_OBJ_IMAGE].uHeight) * ourInst->pHTables[GG_OBJ_IMAGE].uWidth)
-                             + (x % ourInst->pHTables[GG_OBJ_IMAGE].uWidth);
-                ppCell = &(*ourInst->pHTables[GG_OBJ_IMAGE].ditherMatrix)[14];
-                /* Screen pattern size in memory is 8 byte aligned */
-                scnSize = (ourInst->pHTables[GG_OBJ_IMAGE].uWidth * ourInst->pHTables[GG_OBJ_IMAGE].uHeight);
-            }
-
-#ifdef GG_OBJ_TYPES
-            uaMaps[pObjMap[x]]++;
-#endif
-
-            if(uSrc==255)
-            {
-              if(x&1)
-                 *pDest8 |= 0x0F;
-              else
-                 *pDest8 |= 0xF0;
-            }
-            else if(uSrc)
-            {
-              /* Start at the last (15th) threshold value, and work backwards until the source value
-                 is greater than the threshold value. This level is the output level, 1 to 15. */
-              for(s=15;s>0;s--)
-              {
-                  if(uSrc > (*ppCell)[celloffset])
-                  {
-                      if(x&1)
-                        *pDest8 |= s;
-                      else
-                        *pDest8 |= ((s)<<4);
-                      break;
-                  }
-                  ppCell--;
-              }
-            }
-        }
-
-        x32>>=1;
-        if(x32==0)
-        {
-            x32 = 0x80000000;
-            pMsk++;
-        }
-
-    }
-
+    scrn4bppLine(ourInst, lineY, request->render_info->width,
+                 pSrc8, pObjMap, pMsk, pDst);
   } /* for each line */
 
 #ifdef GG_OBJ_TYPES
   for( x=0; x<256; x++)
   {
-      if(uaMaps[x])
-          printf("uaMaps[%d]=%d\n", x, uaMaps[x]);
+      if(g_ua4bppMaps[x])
+          printf("uaMaps[%d]=%d\n", x, g_ua4bppMaps[x]);
   }
 #endif
 
@@ -0,0 +1,272 @@
+/* Copyright (C) 2012 Global Graphics Software Ltd. All rights reserved.
+ *
+ * This example is provided on an "as is" basis and without
+ * warranty of any kind. Global Graphics Software Ltd. does not
+ * warrant or make any representations regarding the use or results
+ * of use of this example.
+ *
+ * $HopeName: SWebd_OIL_example_gg!src:oil_scrnrow.h(EBDSDK_P.1) $
+ */
+/*! \file
+ *  \ingroup OIL
+ *  \brief Row-at-a-time threshold screening shared by the multibit
+ *  screening modules.
+ *
+ * The per-pixel screening loops in oil_scrn2bpp.c and oil_scrn4bpp.c
+ * recompute the cell offset with two divisions, select the threshold
+ * tables by object type and search the threshold levels for every pixel.
+ * The functions here instead prepare each threshold table row once per
+ * line, replicated so that a run of 16 pixels can be read from any phase
+ * of the cell without wrapping, and then compute the output level of 16
+ * pixels at a time. With SSE2 the threshold compares and the object type
+ * selection are done with vector compares and masks; otherwise the same
+ * prepared rows are used one pixel at a time.
+ *
+ * The output levels are exactly those the per-pixel loops produce: the
+ * level is the highest threshold table whose value the source exceeds,
+ * a source of 255 is always the highest level, and text, then linework,
+ * then everything else selects the tables used.
+ *
+ * These functions are only usable when the raster unit is 32 bits, which
+ * is what the per-pixel loops assume when they walk the mask.
+ */
+#ifndef __OIL_SCRNROW_H__
+#define __OIL_SCRNROW_H__
+
+#include "oil_htm.h"
+#include "swrle.h"
+#include <string.h>
+
+#if SW_HTM_RASTER_UNIT_BITS == 32
+#define OIL_SCRN_ROWS 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OIL_SCRN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/** @brief Largest screen cell width the row functions can prepare. Lines
+ * using a wider cell are screened by the per-pixel loops. */
+#define OIL_SCRN_MAXCELLWIDTH 240
+
+/** @brief Number of pixels read from a prepared threshold row at once. */
+#define OIL_SCRN_RUN 16
+
+/** @brief Number of pixels whose levels are computed before they are
+ * packed into the destination. Must be a multiple of 32. */
+#define OIL_SCRN_SEGMENT 256
+
+/** @brief The maximum number of threshold levels (4bpp). */
+#define OIL_SCRN_MAXLEVELS 15
+
+/** @brief One threshold table's rows for the line being screened. */
+typedef struct OIL_stScreenRow
+{
+  int32 nWidth;   /*!< Screen cell width in pixels */
+  int32 nPhase;   /*!< Offset in the cell row of the next pixel */
+  /*! Threshold rows for each level, replicated past the cell width */
+  uint8 auThresholds[OIL_SCRN_MAXLEVELS][OIL_SCRN_MAXCELLWIDTH + OIL_SCRN_RUN];
+} OIL_TyScreenRow;
+
+#ifdef OIL_SCRN_ROWS
+
+/** @brief Prepare the threshold rows of all object types for a line.
+ *
+ * \param[out] pRows    One row structure per object type.
+ * \param[in]  ourInst  The halftone instance being screened.
+ * \param[in]  lineY    The device line being screened.
+ * \param[in]  nLevels  The number of threshold tables (3 or 15).
+ * \return     FALSE if a cell is too wide for the row functions.
+ */
+static HqBool scrnRowsPrepare(OIL_TyScreenRow pRows[OIL_MAXSCREENOBJECTS],
+                              const HTI *ourInst, sw_htm_coord lineY,
+                              int nLevels)
+{
+  int obj, s, i;
+
+  for ( obj = 0 ; obj < OIL_MAXSCREENOBJECTS ; obj++ )
+  {
+    const DITHERTABLES *pTables = &ourInst->pHTables[obj];
+    int32 nWidth = pTables->uWidth;
+    int32 rowbase;
+
+    if ( nWidth <= 0 || nWidth > OIL_SCRN_MAXCELLWIDTH || pTables->uHeight == 0 )
+      return FALSE;
+
+    rowbase = (lineY % pTables->uHeight) * nWidth;
+    pRows[obj].nWidth = nWidth;
+    pRows[obj].nPhase = 0;
+    for ( s = 0 ; s < nLevels ; s++ )
+    {
+      const uint8 *pCellRow = (*pTables->ditherMatrix)[s] + rowbase;
+      uint8 *pRow = pRows[obj].auThresholds[s];
+
+      memcpy(pRow, pCellRow, nWidth);
+      for ( i = nWidth ; i < nWidth + OIL_SCRN_RUN ; i++ )
+        pRow[i] = pRow[i - nWidth];
+    }
+  }
+
+  return TRUE;
+}
+
+/** @brief Move a row's phase on by a number of pixels. */
+#define SCRN_ROW_ADVANCE(pRow_, n_) MACRO_START \
+  (pRow_)->nPhase += (n_); \
+  while ( (pRow_)->nPhase >= (pRow_)->nWidth ) \
+    (pRow_)->nPhase -= (pRow_)->nWidth; \
+MACRO_END
+
+/** @brief The level of one pixel, from the current phase of its row. */
+static uint8 scrnRowLevel(const OIL_TyScreenRow *pRow, int nLevels, uint8 uSrc)
+{
+  int s;
+
+  if ( uSrc == 255 )
+    return (uint8)nLevels;
+
+  for ( s = nLevels ; s > 0 ; s-- )
+  {
+    if ( uSrc > pRow->auThresholds[s - 1][pRow->nPhase] )
+      return (uint8)s;
+  }
+
+  return 0;
+}
+
+/** @brief Select the object type of a pixel, the same way the per-pixel
+ * loops do. */
+#define SCRN_OBJECT_TYPE(uMap_) \
+  (((uMap_) & RLE_TEXT_OBJECT) != 0 ? GG_OBJ_TEXT : \
+   ((uMap_) & RLE_LW_OBJECT) != 0 ? GG_OBJ_GFX : GG_OBJ_IMAGE)
+
+#ifdef OIL_SCRN_SSE2
+/** @brief The levels of a run of 16 pixels for one object type. */
+static __m128i scrnRowLevels16(const OIL_TyScreenRow *pRow, int nLevels,
+                               __m128i src)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i level = zero;
+  int s;
+
+  /* Each level overrides the lower ones wherever the source exceeds its
+     threshold, which leaves the highest such level, as the search down
+     from the top level finds. */
+  for ( s = 0 ; s < nLevels ; s++ )
+  {
+    __m128i thresh = _mm_loadu_si128((const __m128i *)
+                                     &pRow->auThresholds[s][pRow->nPhase]);
+    /* src <= thresh where the saturated difference is zero. */
+    __m128i notover = _mm_cmpeq_epi8(_mm_subs_epu8(src, thresh), zero);
+    level = _mm_or_si128(_mm_and_si128(notover, level),
+                         _mm_andnot_si128(notover, _mm_set1_epi8((char)(s + 1))));
+  }
+
+  return level;
+}
+#endif /* OIL_SCRN_SSE2 */
+
+/** @brief Compute the output levels of a span of pixels in a line.
+ *
+ * Runs of pixels which are wholly outside the mask are skipped, leaving
+ * their levels undefined.
+ *
+ * \param[in,out] pRows        The line's prepared rows, at the phase of
+ *                             pixel \a x0.
+ * \param[in]     nLevels      The number of threshold tables (3 or 15).
+ * \param[in]     fBlankNoObj  Whether pixels with no object type are level 0.
+ * \param[in]     pSrc         The line's source pixels.
+ * \param[in]     pObjMap      The line's object type map.
+ * \param[in]     pMsk         The line's mask.
+ * \param[in]     x0           The first pixel of the span; a multiple of 32.
+ * \param[in]     n            The number of pixels in the span.
+ * \param[out]    pLevels      The levels of the span's pixels.
+ */
+static void scrnRowSpan(OIL_TyScreenRow pRows[OIL_MAXSCREENOBJECTS],
+                        int nLevels, HqBool fBlankNoObj,
+                        const uint8 *pSrc, const uint8 *pObjMap,
+                        const sw_htm_raster_unit *pMsk,
+                        int32 x0, int32 n, uint8 *pLevels)
+{
+  int32 x = 0;
+  int obj;
+
+#ifdef OIL_SCRN_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i textbit = _mm_set1_epi8((char)RLE_TEXT_OBJECT);
+  const __m128i lwbit = _mm_set1_epi8((char)RLE_LW_OBJECT);
+  const __m128i top = _mm_set1_epi8((char)nLevels);
+  const __m128i full = _mm_set1_epi8((char)0xff);
+
+  for ( ; x + OIL_SCRN_RUN <= n ; x += OIL_SCRN_RUN )
+  {
+    uint32 uMsk = pMsk[(x0 + x) >> 5] << ((x0 + x) & 16);
+
+    if ( (uMsk & 0xffff0000u) != 0 )
+    {
+      __m128i src = _mm_loadu_si128((const __m128i *)&pSrc[x0 + x]);
+      __m128i map = _mm_loadu_si128((const __m128i *)&pObjMap[x0 + x]);
+      __m128i text = _mm_xor_si128(_mm_cmpeq_epi8(_mm_and_si128(map, textbit), zero), full);
+      __m128i lw = _mm_andnot_si128(text,
+                     _mm_xor_si128(_mm_cmpeq_epi8(_mm_and_si128(map, lwbit), zero), full));
+      __m128i image = _mm_xor_si128(_mm_or_si128(text, lw), full);
+      __m128i level = zero;
+
+      /* Only the tables of object types present in the run are used. */
+      if ( _mm_movemask_epi8(image) != 0 )
+        level = _mm_and_si128(image, scrnRowLevels16(&pRows[GG_OBJ_IMAGE], nLevels, src));
+      if ( _mm_movemask_epi8(lw) != 0 )
+        level = _mm_or_si128(level,
+                  _mm_and_si128(lw, scrnRowLevels16(&pRows[GG_OBJ_GFX], nLevels, src)));
+      if ( _mm_movemask_epi8(text) != 0 )
+        level = _mm_or_si128(level,
+                  _mm_and_si128(text, scrnRowLevels16(&pRows[GG_OBJ_TEXT], nLevels, src)));
+
+      /* A solid source is always the top level. */
+      level = _mm_or_si128(level, _mm_and_si128(_mm_cmpeq_epi8(src, full), top));
+      if ( fBlankNoObj )
+        level = _mm_andnot_si128(_mm_cmpeq_epi8(map, zero), level);
+
+      _mm_storeu_si128((__m128i *)&pLevels[x], level);
+    }
+
+    for ( obj = 0 ; obj < OIL_MAXSCREENOBJECTS ; obj++ )
+      SCRN_ROW_ADVANCE(&pRows[obj], OIL_SCRN_RUN);
+  }
+#endif /* OIL_SCRN_SSE2 */
+
+  for ( ; x < n ; x++ )
+  {
+    uint8 uMap = pObjMap[x0 + x];
+
+    if ( (pMsk[(x0 + x) >> 5] & (0x80000000u >> ((x0 + x) & 31))) != 0 )
+    {
+      if ( fBlankNoObj && uMap == 0 )
+        pLevels[x] = 0;
+      else
+        pLevels[x] = scrnRowLevel(&pRows[SCRN_OBJECT_TYPE(uMap)], nLevels,
+                                  pSrc[x0 + x]);
+    }
+
+    for ( obj = 0 ; obj < OIL_MAXSCREENOBJECTS ; obj++ )
+      SCRN_ROW_ADVANCE(&pRows[obj], 1);
+  }
+}
+
+/** @brief The mask bits of a span of pixels, with the bits past the end of
+ * the line cleared. */
+static uint32 scrnRowMask(const sw_htm_raster_unit *pMsk, int32 x, int32 width)
+{
+  uint32 uMsk = pMsk[x >> 5];
+
+  if ( width - x < 32 )
+    uMsk &= ~(0xffffffffu >> (width - x));
+
+  return uMsk;
+}
+
+#endif /* OIL_SCRN_ROWS */
+
+#endif /* __OIL_SCRNROW_H__ */
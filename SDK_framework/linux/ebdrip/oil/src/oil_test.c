@@ -41,6 +41,10 @@
  * \arg TestDrawCornerTicks1bpp() - Draw diagonal tick marks in the corners of the raster area.
  * \arg TestXRuler1bpp() - Draw a horizonal ruler with shorts ticks every 10 pixels and long ticks every 100 pixels.
  *
+ * TestScreening2bpp() and TestScreening4bpp() check that the line functions used by the
+ * multibit screening modules give exactly the same rasters as their per-pixel reference
+ * implementations, for each of the screen qualities.
+ *
  */
 
 #include "oil.h"
@@ -52,6 +56,10 @@
 #include "oil_job_handler.h"
 #include "oil_page_handler.h"
 #include "oil_probelog.h"
+#if defined(SDK_SUPPORT_2BPP_EXT_EG) || defined(SDK_SUPPORT_4BPP_EXT_EG)
+#include "oil_htm.h"
+#include "swrle.h"
+#endif
 
 #include <stdio.h>
 #include <string.h>     /* for memset and memcpy */
@@ -598,3 +606,172 @@ void TestSetupConfiguration(int Config)
   }
 }
 
+#if defined(SDK_SUPPORT_2BPP_EXT_EG) || defined(SDK_SUPPORT_4BPP_EXT_EG)
+
+/** \brief Longest line screened by the screening tests. */
+#define TEST_SCREEN_MAXWIDTH 1024
+
+/** \brief Number of lines screened for each colorant and screen quality. */
+#define TEST_SCREEN_LINES 200
+
+/** \brief Screening line function, as exported by the screening modules. */
+typedef void (TestScreenLineFn)(const HTI *ourInst, sw_htm_coord lineY, int32 width,
+                                const uint8 *pSrc, const uint8 *pObjMap,
+                                const sw_htm_raster_unit *pMsk, sw_htm_raster_unit *pDst);
+
+/** \brief Pseudo-random numbers for the screening tests, so failures repeat. */
+static uint32 TestScreenRandom(uint32 *pSeed)
+{
+  *pSeed = *pSeed * 1103515245u + 12345u;
+  return *pSeed >> 8;
+}
+
+/**
+ * \brief Compare a screening module's line functions on random lines.
+ *
+ * Each line has a random width, device line, mask, object map and source,
+ * favouring the solid, empty and mixed runs that exercise the special
+ * cases. The destination starts with random contents, so that pixels
+ * outside the mask are checked to be preserved.
+ *
+ * \param[in]   pszName     The module name, for reporting.
+ * \param[in]   apHTI       The module's halftone instances.
+ * \param[in]   nBpp        The module's output bit depth.
+ * \param[in]   pfnLine     The module's line function.
+ * \param[in]   pfnRef      The module's reference line function.
+ * \return      TRUE if the results were identical, FALSE otherwise.
+ */
+static int TestScreenLines(char *pszName, HTI *apHTI[], int nBpp,
+                           TestScreenLineFn *pfnLine, TestScreenLineFn *pfnRef)
+{
+  static const uint8 auObjTypes[] = {
+    0, RLE_LW_OBJECT, RLE_TEXT_OBJECT, RLE_IMAGE_OBJECT,
+    RLE_LW_OBJECT | RLE_TEXT_OBJECT, RLE_IMAGE_OBJECT | RLE_LW_OBJECT
+  };
+  uint8 auSrc[TEST_SCREEN_MAXWIDTH], auObjMap[TEST_SCREEN_MAXWIDTH];
+  sw_htm_raster_unit auMsk[TEST_SCREEN_MAXWIDTH / 32];
+  sw_htm_raster_unit auDst[TEST_SCREEN_MAXWIDTH * 4 / 32];
+  sw_htm_raster_unit auRef[TEST_SCREEN_MAXWIDTH * 4 / 32];
+  uint32 uSeed = 0x5eed;
+  int colorant, line;
+  int32 x, width, nWords;
+
+  for ( colorant = 0 ; colorant < 4 ; colorant++ )
+  {
+    for ( line = 0 ; line < TEST_SCREEN_LINES ; line++ )
+    {
+      sw_htm_coord lineY = (sw_htm_coord)(TestScreenRandom(&uSeed) % 4096);
+      uint8 uObj = 0, uSrc = 0;
+
+      width = 1 + (int32)(TestScreenRandom(&uSeed) % TEST_SCREEN_MAXWIDTH);
+      for ( x = 0 ; x < width ; x++ )
+      {
+        /* Runs of object types and sources, with some noise. */
+        if ( (TestScreenRandom(&uSeed) & 15) == 0 )
+          uObj = auObjTypes[TestScreenRandom(&uSeed) % sizeof(auObjTypes)];
+        switch ( TestScreenRandom(&uSeed) % 8 )
+        {
+        case 0: uSrc = 0; break;
+        case 1: uSrc = 255; break;
+        case 2: case 3: uSrc = (uint8)TestScreenRandom(&uSeed); break;
+        default: break;
+        }
+        auObjMap[x] = uObj;
+        auSrc[x] = uSrc;
+      }
+
+      for ( x = 0 ; x < (width + 31) / 32 ; x++ )
+      {
+        switch ( TestScreenRandom(&uSeed) % 4 )
+        {
+        case 0: auMsk[x] = 0; break;
+        case 1: auMsk[x] = 0xffffffffu; break;
+        default: auMsk[x] = (sw_htm_raster_unit)(TestScreenRandom(&uSeed) ^
+                                                 (TestScreenRandom(&uSeed) << 16)); break;
+        }
+      }
+
+      nWords = (width * nBpp + 31) / 32;
+      for ( x = 0 ; x < nWords ; x++ )
+        auDst[x] = auRef[x] = (sw_htm_raster_unit)(TestScreenRandom(&uSeed) ^
+                                                   (TestScreenRandom(&uSeed) << 16));
+
+      (*pfnLine)(apHTI[colorant], lineY, width, auSrc, auObjMap, auMsk, auDst);
+      (*pfnRef)(apHTI[colorant], lineY, width, auSrc, auObjMap, auMsk, auRef);
+
+      if ( memcmp(auDst, auRef, nWords * sizeof(sw_htm_raster_unit)) != 0 )
+      {
+        GG_SHOW(GG_SHOW_TEST, "%s: colorant %d line %d width %d differs from reference\n",
+                pszName, colorant, lineY, width);
+        return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+#endif
+
+#if defined(SDK_SUPPORT_4BPP_EXT_EG)
+extern HTI* g_4bppHTI[];
+
+/**
+ * \brief Check the 4bpp screening module against its reference.
+ *
+ * The line function used by the 4bpp screening module is compared with the
+ * per-pixel reference implementation for each of the screen qualities.
+ * The module's screen tables are restored to the qualities they had before.
+ *
+ * \return      TRUE if the results were identical, FALSE otherwise.
+ */
+int TestScreening4bpp(void)
+{
+  OIL_eScreenQuality eQuality, eImageQuality, eGraphicsQuality, eTextQuality;
+  int bResult = TRUE;
+
+  htm4bpp_getHTtables(&eImageQuality, &eGraphicsQuality, &eTextQuality);
+
+  for ( eQuality = OIL_Scrn_LowLPI ; eQuality <= OIL_Scrn_HighLPI && bResult ; eQuality++ )
+  {
+    htm4bpp_remapHTtables(eQuality, eQuality, eQuality);
+    bResult = TestScreenLines("TestScreening4bpp", g_4bppHTI, 4,
+                              scrn4bppLine, scrn4bppLineReference);
+  }
+
+  htm4bpp_remapHTtables(eImageQuality, eGraphicsQuality, eTextQuality);
+  GG_SHOW(GG_SHOW_TEST, "TestScreening4bpp: %s\n", bResult ? "passed" : "FAILED");
+  return bResult;
+}
+#endif
+
+#if defined(SDK_SUPPORT_2BPP_EXT_EG)
+extern HTI* g_2bppHTI[];
+
+/**
+ * \brief Check the 2bpp screening module against its reference.
+ *
+ * The line function used by the 2bpp screening module is compared with the
+ * per-pixel reference implementation for each of the screen qualities.
+ * The module's screen tables are restored to the qualities they had before.
+ *
+ * \return      TRUE if the results were identical, FALSE otherwise.
+ */
+int TestScreening2bpp(void)
+{
+  OIL_eScreenQuality eQuality, eImageQuality, eGraphicsQuality, eTextQuality;
+  int bResult = TRUE;
+
+  htm2bpp_getHTtables(&eImageQuality, &eGraphicsQuality, &eTextQuality);
+
+  for ( eQuality = OIL_Scrn_LowLPI ; eQuality <= OIL_Scrn_HighLPI && bResult ; eQuality++ )
+  {
+    htm2bpp_remapHTtables(eQuality, eQuality, eQuality);
+    bResult = TestScreenLines("TestScreening2bpp", g_2bppHTI, 2,
+                              scrn2bppLine, scrn2bppLineReference);
+  }
+
+  htm2bpp_remapHTtables(eImageQuality, eGraphicsQuality, eTextQuality);
+  GG_SHOW(GG_SHOW_TEST, "TestScreening2bpp: %s\n", bResult ? "passed" : "FAILED");
+  return bResult;
+}
+#endif
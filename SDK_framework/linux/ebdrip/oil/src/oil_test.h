@@ -24,6 +24,12 @@
 
 int TestCreateRaster (PMS_TyJob *pms_ptJob, OIL_eColorMode eColorMode);
 void TestSetupConfiguration(int);
+#if defined(SDK_SUPPORT_2BPP_EXT_EG)
+int TestScreening2bpp(void);
+#endif
+#if defined(SDK_SUPPORT_4BPP_EXT_EG)
+int TestScreening4bpp(void);
+#endif
 
 
 #endif /* _OIL_TEST_H_ */
@@ -32,6 +32,20 @@ extern OIL_TyConfigurableFeatures g_ConfigurableFeatures;
 /*! The memory used for the virtual file chunk is stored in the RIP memory pool */
 #define OIL_VIRTFILE_MEM_RIP     2
 
+/*! The memory used for the virtual file chunk is leased from the PMS band ring */
+#define OIL_VIRTFILE_MEM_PMS     3
+
+/*! Smallest amount of memory allocated for a new chunk. */
+#define OIL_VIRTFILE_CHUNK_MIN   (4 * 1024)
+
+/*! Largest amount of memory allocated for a new chunk, unless a single write
+    is larger. Chunks grow with the file up to this size, so that large spooled
+    jobs are held in a few large chunks, and most reads are a single copy. */
+#define OIL_VIRTFILE_CHUNK_MAX   (1024 * 1024)
+
+/*! Number of buckets in each of the virtual file hash tables. */
+#define OIL_VIRTFILE_HASH        64
+
 /* Debug the link list */
 /* #define GG_DEBUG_LIST */
 
@@ -41,9 +55,10 @@ extern OIL_TyConfigurableFeatures g_ConfigurableFeatures;
 struct TyVirtFileChunk
 {
   unsigned char *pMemory;                /*!< The memory used for the virtual file chunk */
-  unsigned int cbSize;                   /*!< Size of the virtual file chunk */
+  unsigned int cbSize;                   /*!< Number of bytes of file data in the chunk */
+  unsigned int cbCapacity;               /*!< Size of pMemory; writes at the end of the file fill it before adding a chunk */
+  unsigned int uStart;                   /*!< Offset in the file of the first byte of the chunk */
   unsigned int nMemoryPool;              /*!< Memory pool used for pMemory. OIL, RIP, or somewhere else */
-  struct TyVirtFileChunk * pNextChunk;   /*!< Pointer to next virtual file chunk */
 #ifdef GG_DEBUG_LIST
   unsigned int bWrittenTo; /* !< Debugging... has this chunk been written to? */
   unsigned int nID;        /* !< Debugging... ID? */
@@ -52,20 +67,55 @@ struct TyVirtFileChunk
 
 /**
  * \brief Virtual file structure.
+ *
+ * The chunks are held in an array in file order, so that the chunk containing
+ * any offset can be found with a binary search on the chunk start offsets.
  */
 struct TyVirtFile { 
   char *pszFilename;                     /*!< Filename */
   int nFileID;                           /*!< ID for this virtual file */
   unsigned int uLength;                  /*!< Total length of the virtual file */
-  struct TyVirtFileChunk *pFirstChunk;   /*!< Pointer to the first chunk of data */
-  struct TyVirtFileChunk *pCurrentChunk; /*!< The current file pointer is within this chunk */
-  unsigned int uCurrentChunkPos;         /*!< The current file pointer is this many bytes into the pCurrentChunk */
+  struct TyVirtFileChunk **ppChunks;     /*!< The chunks of data, in file order */
+  unsigned int nChunks;                  /*!< Number of chunks in ppChunks */
+  unsigned int nChunksMax;               /*!< Number of entries allocated for ppChunks */
+  unsigned int uCurrentChunk;            /*!< The current file pointer is within this chunk */
+  unsigned int uCurrentChunkPos;         /*!< The current file pointer is this many bytes into the current chunk */
   struct TyVirtFile *pNextFile;          /*!< Pointer to the next virtual file */
+  struct TyVirtFile *pNextByName;        /*!< Next virtual file in the same filename hash bucket */
+  struct TyVirtFile *pNextByID;          /*!< Next virtual file in the same ID hash bucket */
+  int bLeaseChunks;                      /*!< Chunk memory is leased from the PMS, for the RIP's pagebuffer files */
 };
 
 struct TyVirtFile *l_pVirtFiles = NULL;  /*!< Head of the virtual file list list */
 int l_nNextFileID = 0;                   /*!< Next file id to use */
 
+/*! Virtual files hashed by filename. */
+static struct TyVirtFile *l_apVirtFilesByName[OIL_VIRTFILE_HASH];
+
+/*! Virtual files hashed by ID. */
+static struct TyVirtFile *l_apVirtFilesByID[OIL_VIRTFILE_HASH];
+
+/*! Hash bucket for a virtual file ID. */
+#define VIRTFILE_ID_HASH(_id_) ((unsigned int)(_id_) % OIL_VIRTFILE_HASH)
+
+/**
+ * \brief Hash bucket for a virtual file name.
+ *
+ * \param[in] pszFilename Filename string to hash.
+ *
+ * \return    Index of the filename's bucket in the filename hash table.
+ */
+static unsigned int VirtFileNameHash(char *pszFilename)
+{
+  unsigned int uHash = 0;
+
+  while(*pszFilename)
+  {
+    uHash = uHash * 31 + (unsigned char)*pszFilename++;
+  }
+  return uHash % OIL_VIRTFILE_HASH;
+}
+
 /**
  * \brief Find a virtual file by a given ID number.
  *
@@ -76,7 +126,7 @@ int l_nNextFileID = 0;                   /*!< Next file id to use */
 static struct TyVirtFile *GetVirtFileFromID(int nFileID)
 {
   struct TyVirtFile *pVirtFile;
-  for( pVirtFile = l_pVirtFiles; pVirtFile; pVirtFile = pVirtFile->pNextFile )
+  for( pVirtFile = l_apVirtFilesByID[VIRTFILE_ID_HASH(nFileID)]; pVirtFile; pVirtFile = pVirtFile->pNextByID )
   {
     if(pVirtFile->nFileID == nFileID)
     {
@@ -92,6 +142,7 @@ void DumpVirtFileList(int nFileID)
 {
   struct TyVirtFile *pVirtFile;
   struct TyVirtFileChunk *pVirtFileChunk;
+  unsigned int uChunk;
   FILE *hFile = NULL;
   char szMsg[256];
   static int nFile=0;
@@ -107,36 +158,39 @@ void DumpVirtFileList(int nFileID)
    
   pVirtFile = GetVirtFileFromID(nFileID);
 
-  printf("pVirtFile First chunk %p\n"
-         "  Current chunk %p\n"
+  printf("pVirtFile Chunks %u\n"
+         "  Current chunk %u\n"
          "  Current pos %u\n"
          "  Length %u\n",
-    pVirtFile->pFirstChunk,
-    pVirtFile->pCurrentChunk,
+    pVirtFile->nChunks,
+    pVirtFile->uCurrentChunk,
     pVirtFile->uCurrentChunkPos,
     pVirtFile->uLength);
 
 
-  for(pVirtFileChunk = pVirtFile->pFirstChunk; 
-      pVirtFileChunk;
-      pVirtFileChunk = pVirtFileChunk->pNextChunk) {
+  for(uChunk = 0; uChunk < pVirtFile->nChunks; uChunk++) {
+    pVirtFileChunk = pVirtFile->ppChunks[uChunk];
     printf("pVirtFileChunk %p, %u\n"
            "  cbSize %u\n"
+           "  cbCapacity %u\n"
+           "  uStart %u\n"
            "  memory data (8 bytes) %p\n"
            "  memory pool %u\n",
            pVirtFileChunk,
            pVirtFileChunk->nID,
            pVirtFileChunk->cbSize,
+           pVirtFileChunk->cbCapacity,
+           pVirtFileChunk->uStart,
            (void*)pVirtFileChunk->pMemory,
            pVirtFileChunk->nMemoryPool
            );
     if(hFile) {
-      sprintf(szMsg, "\r\n*** nID %d, size %d, addr=0x%p, data=0x%p, next=0x%p\r\n", 
+      sprintf(szMsg, "\r\n*** nID %d, size %d, addr=0x%p, data=0x%p, start=%u\r\n", 
         pVirtFileChunk->nID,
         pVirtFileChunk->cbSize,
         pVirtFileChunk,
         pVirtFileChunk->pMemory,
-        pVirtFileChunk->pNextChunk
+        pVirtFileChunk->uStart
         );
       fwrite(szMsg, 1, strlen(szMsg), hFile);
       fwrite(pVirtFileChunk->pMemory, 1, pVirtFileChunk->cbSize, hFile);
@@ -161,7 +215,7 @@ void DumpVirtFileList(int nFileID)
 static struct TyVirtFile *GetVirtFileFromFilename(char *pszFilename)
 {
   struct TyVirtFile *pVirtFile;
-  for( pVirtFile = l_pVirtFiles; pVirtFile; pVirtFile = pVirtFile->pNextFile )
+  for( pVirtFile = l_apVirtFilesByName[VirtFileNameHash(pszFilename)]; pVirtFile; pVirtFile = pVirtFile->pNextByName )
   {
     if(strcmp(pVirtFile->pszFilename, pszFilename)==0)
     {
@@ -172,16 +226,15 @@ static struct TyVirtFile *GetVirtFileFromFilename(char *pszFilename)
 }
 
 /**
- * \brief Write a new virtual file chunk.
- *
- * \param[in]   pBuff Data to copy into the virtual file chunk. If NULL, then no data is copied, 
- *              but nLength bytes of memory is still allocated.
+ * \brief Allocate a new virtual file chunk.
  *
- * \param[in]   nLength Length in bytes of the new virtual file chunk.
+ * \param[in]   nCapacity Number of bytes of memory to allocate for the chunk's data.
+ * \param[in]   bLease    Lease the memory from the PMS band ring if possible.
  *
- * \return    Pointer to the virtual file chunk if succesfully written, or NULL if the write fails.
+ * \return    Pointer to the empty virtual file chunk if succesfully allocated, or NULL
+ *            if the allocation fails.
  */
-static struct TyVirtFileChunk * NewVirtFileChunk(unsigned char *pBuff, int nLength)
+static struct TyVirtFileChunk * NewVirtFileChunk(unsigned int nCapacity, int bLease)
 {
   struct TyVirtFileChunk * pVirtFileChunkNew;
 #ifdef GG_DEBUG_LIST
@@ -195,44 +248,190 @@ static struct TyVirtFileChunk * NewVirtFileChunk(unsigned char *pBuff, int nLeng
     return NULL;
   }
 
-  /* Try OILMemoryPoolJob first, without blocking. If no memory immediately avaiable,
-     then try RIR Memory. */
-  pVirtFileChunkNew->pMemory = OIL_malloc(OILMemoryPoolJob, OIL_MemNonBlock, nLength);
-  if(!pVirtFileChunkNew->pMemory)
+  /* Pagebuffer files are written and deleted for every page, so their memory
+     is leased from the PMS, which reuses it from page to page. */
+  if(bLease &&
+     PMS_LeaseBuffer((size_t)nCapacity, PMS_LEASE_FOR_FILE, &pVirtFileChunkNew->pMemory))
   {
-    pVirtFileChunkNew->pMemory = MemAlloc(nLength, FALSE, FALSE);
+    pVirtFileChunkNew->nMemoryPool = OIL_VIRTFILE_MEM_PMS;
+  }
+  else
+  {
+    /* Try OILMemoryPoolJob first, without blocking. If no memory immediately avaiable,
+       then try RIR Memory. */
+    pVirtFileChunkNew->pMemory = OIL_malloc(OILMemoryPoolJob, OIL_MemNonBlock, nCapacity);
     if(!pVirtFileChunkNew->pMemory)
     {
-      /* We could make a second attempt in OILMemoryPoolJob with OIL_MemBlock, just in
-         case there are checked in pages waiting to be printed */
+      pVirtFileChunkNew->pMemory = MemAlloc(nCapacity, FALSE, FALSE);
+      if(!pVirtFileChunkNew->pMemory)
+      {
+        /* We could make a second attempt in OILMemoryPoolJob with OIL_MemBlock, just in
+           case there are checked in pages waiting to be printed */
 
-      HQFAILV(("NewVirtFileChunk: failed to allocate a new file chunk %d bytes", nLength));
-      OIL_free(OILMemoryPoolJob, pVirtFileChunkNew);
-      return NULL;
+        HQFAILV(("NewVirtFileChunk: failed to allocate a new file chunk %d bytes", nCapacity));
+        OIL_free(OILMemoryPoolJob, pVirtFileChunkNew);
+        return NULL;
+      }
+      else
+      {
+        pVirtFileChunkNew->nMemoryPool = OIL_VIRTFILE_MEM_RIP;
+      }
     }
     else
     {
-      pVirtFileChunkNew->nMemoryPool = OIL_VIRTFILE_MEM_RIP;
+      pVirtFileChunkNew->nMemoryPool = OIL_VIRTFILE_MEM_OIL_JOB;
     }
   }
-  else
+
+  pVirtFileChunkNew->cbSize = 0;
+  pVirtFileChunkNew->cbCapacity = nCapacity;
+  pVirtFileChunkNew->uStart = 0;
+#ifdef GG_DEBUG_LIST
+  pVirtFileChunkNew->nID = nID++;
+#endif
+
+  return pVirtFileChunkNew;
+}
+
+/**
+ * \brief Free a virtual file chunk.
+ *
+ * \param[in] pFileChunk Pointer to the virtual file chunk to free.
+ *
+ * \return Returns 1 if successful, or 0 if it fails.
+ */
+static int FreeVirtFileChunk(struct TyVirtFileChunk *pFileChunk)
+{
+  switch(pFileChunk->nMemoryPool)
   {
-    pVirtFileChunkNew->nMemoryPool = OIL_VIRTFILE_MEM_OIL_JOB;
+  case OIL_VIRTFILE_MEM_RIP:
+    MemFree(pFileChunk->pMemory);
+    break;
+  case OIL_VIRTFILE_MEM_OIL_JOB:
+    OIL_free(OILMemoryPoolJob, pFileChunk->pMemory);
+    break;
+  case OIL_VIRTFILE_MEM_PMS:
+    PMS_ReleaseBuffer(pFileChunk->pMemory);
+    break;
+  default:
+    HQFAILV(("FreeVirtFileChunk: not expect memory pool %d", pFileChunk->nMemoryPool));
+    return 0;
+    break;
   }
+  OIL_free(OILMemoryPoolJob, pFileChunk);
+  return 1;
+}
+
+/**
+ * \brief Add a new chunk at the end of a virtual file.
+ *
+ * The new chunk's capacity grows with the length of the file, so that large
+ * files are held in a small number of large chunks.
+ *
+ * \param[in] pVirtFile Pointer to the virtual file structure to extend.
+ *
+ * \param[in] nLength Number of bytes that are about to be written to the chunk.
+ *
+ * \return    Pointer to the new, empty, chunk, or NULL if the allocation fails.
+ */
+static struct TyVirtFileChunk * AppendVirtFileChunk(struct TyVirtFile *pVirtFile, unsigned int nLength)
+{
+  struct TyVirtFileChunk *pVirtFileChunkNew;
+  unsigned int nCapacity;
+
+  /* Make room in the chunk index */
+  if(pVirtFile->nChunks == pVirtFile->nChunksMax)
+  {
+    unsigned int nChunksMax = pVirtFile->nChunksMax ? pVirtFile->nChunksMax * 2 : 16;
+    struct TyVirtFileChunk **ppChunks;
 
-  pVirtFileChunkNew->pNextChunk = NULL;
-  if(pBuff) {
-    memcpy(pVirtFileChunkNew->pMemory, pBuff, nLength);
+    ppChunks = OIL_malloc(OILMemoryPoolJob, OIL_MemBlock, nChunksMax * sizeof(struct TyVirtFileChunk *));
+    if(!ppChunks)
+    {
+      HQFAILV(("AppendVirtFileChunk: failed to allocate chunk index for %u chunks", nChunksMax));
+      return NULL;
+    }
+    if(pVirtFile->ppChunks)
+    {
+      memcpy(ppChunks, pVirtFile->ppChunks, pVirtFile->nChunks * sizeof(struct TyVirtFileChunk *));
+      OIL_free(OILMemoryPoolJob, pVirtFile->ppChunks);
+    }
+    pVirtFile->ppChunks = ppChunks;
+    pVirtFile->nChunksMax = nChunksMax;
   }
 
-  pVirtFileChunkNew->cbSize = nLength;
-#ifdef GG_DEBUG_LIST
-  pVirtFileChunkNew->nID = nID++;
-#endif
+  nCapacity = pVirtFile->uLength;
+  if(nCapacity < OIL_VIRTFILE_CHUNK_MIN)
+    nCapacity = OIL_VIRTFILE_CHUNK_MIN;
+  if(nCapacity > OIL_VIRTFILE_CHUNK_MAX)
+    nCapacity = OIL_VIRTFILE_CHUNK_MAX;
+  if(nCapacity < nLength)
+    nCapacity = nLength;
+
+  pVirtFileChunkNew = NewVirtFileChunk(nCapacity, pVirtFile->bLeaseChunks);
+  if(!pVirtFileChunkNew)
+    return NULL;
+
+  pVirtFileChunkNew->uStart = pVirtFile->uLength;
+  pVirtFile->ppChunks[pVirtFile->nChunks++] = pVirtFileChunkNew;
 
   return pVirtFileChunkNew;
 }
 
+/**
+ * \brief Set the current position of a virtual file.
+ *
+ * The chunk containing the position is found by a binary search of the
+ * chunk index. A position at the end of the file is at the end of the last
+ * chunk.
+ *
+ * \param[in] pVirtFile Pointer to the virtual file structure.
+ *
+ * \param[in] uPosition The new position, which must not be past the end of the file.
+ */
+static void SetVirtFilePosition(struct TyVirtFile *pVirtFile, unsigned int uPosition)
+{
+  unsigned int uLow, uHigh;
+
+  HQASSERT(uPosition <= pVirtFile->uLength, "SetVirtFilePosition: position past end of file");
+
+  if(pVirtFile->nChunks == 0)
+  {
+    pVirtFile->uCurrentChunk = 0;
+    pVirtFile->uCurrentChunkPos = 0;
+    return;
+  }
+
+  /* Find the last chunk starting at or before the position. */
+  uLow = 0;
+  uHigh = pVirtFile->nChunks - 1;
+  while(uLow < uHigh)
+  {
+    unsigned int uMid = (uLow + uHigh + 1) / 2;
+    if(pVirtFile->ppChunks[uMid]->uStart <= uPosition)
+      uLow = uMid;
+    else
+      uHigh = uMid - 1;
+  }
+
+  pVirtFile->uCurrentChunk = uLow;
+  pVirtFile->uCurrentChunkPos = uPosition - pVirtFile->ppChunks[uLow]->uStart;
+}
+
+/**
+ * \brief Get the current position of a virtual file.
+ *
+ * \param[in] pVirtFile Pointer to the virtual file structure.
+ *
+ * \return    The offset of the current position from the start of the file.
+ */
+static unsigned int GetVirtFilePosition(struct TyVirtFile *pVirtFile)
+{
+  if(pVirtFile->nChunks == 0)
+    return 0;
+  return pVirtFile->ppChunks[pVirtFile->uCurrentChunk]->uStart + pVirtFile->uCurrentChunkPos;
+}
+
 /**
  * \brief Allocate a new virtual file structure.
  *
@@ -244,40 +443,52 @@ static struct TyVirtFileChunk * NewVirtFileChunk(unsigned char *pBuff, int nLeng
 static struct TyVirtFile * NewVirtFile(char *pszFilename)
 {
   struct TyVirtFile *pVirtFile;
+  struct TyVirtFile *pVirtFileNew;
   struct TyVirtFile **ppVirtFileNew;
+  unsigned int uBucket;
   
-  ppVirtFileNew = &l_pVirtFiles;
-
-  for( pVirtFile = l_pVirtFiles; pVirtFile; pVirtFile = pVirtFile->pNextFile ) 
-  {
-    ppVirtFileNew = &pVirtFile->pNextFile;
-  }
+  pVirtFileNew = OIL_malloc(OILMemoryPoolJob, OIL_MemBlock, sizeof(struct TyVirtFile));
 
-  *ppVirtFileNew = OIL_malloc(OILMemoryPoolJob, OIL_MemBlock, sizeof(struct TyVirtFile));
-
-  if(*ppVirtFileNew == NULL)
+  if(pVirtFileNew == NULL)
   {
     HQFAILV(("NewVirtFile: Failed to allocate a new virtual file structure %s.", pszFilename));
     return NULL;
   }
-  memset(*ppVirtFileNew, 0x00, sizeof(struct TyVirtFile));
+  memset(pVirtFileNew, 0x00, sizeof(struct TyVirtFile));
 
-  (*ppVirtFileNew)->pszFilename = (char*)OIL_malloc(OILMemoryPoolJob, OIL_MemBlock, strlen(pszFilename)+1);
+  pVirtFileNew->pszFilename = (char*)OIL_malloc(OILMemoryPoolJob, OIL_MemBlock, strlen(pszFilename)+1);
 
-  if((*ppVirtFileNew)->pszFilename == NULL)
+  if(pVirtFileNew->pszFilename == NULL)
   {
     HQFAILV(("NewVirtFile: Failed to allocate filename string for virtual file %s.", pszFilename));
-    OIL_free(OILMemoryPoolJob, *ppVirtFileNew);
-    *ppVirtFileNew=NULL;
+    OIL_free(OILMemoryPoolJob, pVirtFileNew);
     return NULL;
   }
 
-  strcpy((char*)(*ppVirtFileNew)->pszFilename, (char*)pszFilename);
+  strcpy((char*)pVirtFileNew->pszFilename, (char*)pszFilename);
+  pVirtFileNew->bLeaseChunks = (strncmp(pszFilename, "PGB/", 4) == 0);
 
-  (*ppVirtFileNew)->nFileID = l_nNextFileID;
+  pVirtFileNew->nFileID = l_nNextFileID;
   l_nNextFileID++;
 
-  return (*ppVirtFileNew);
+  /* Add to the end of the list of all files */
+  ppVirtFileNew = &l_pVirtFiles;
+  for( pVirtFile = l_pVirtFiles; pVirtFile; pVirtFile = pVirtFile->pNextFile ) 
+  {
+    ppVirtFileNew = &pVirtFile->pNextFile;
+  }
+  *ppVirtFileNew = pVirtFileNew;
+
+  /* and to the hash tables */
+  uBucket = VirtFileNameHash(pszFilename);
+  pVirtFileNew->pNextByName = l_apVirtFilesByName[uBucket];
+  l_apVirtFilesByName[uBucket] = pVirtFileNew;
+
+  uBucket = VIRTFILE_ID_HASH(pVirtFileNew->nFileID);
+  pVirtFileNew->pNextByID = l_apVirtFilesByID[uBucket];
+  l_apVirtFilesByID[uBucket] = pVirtFileNew;
+
+  return pVirtFileNew;
 }
 
 /**
@@ -289,36 +500,30 @@ static struct TyVirtFile * NewVirtFile(char *pszFilename)
  */
 static int DeleteAllChunks(struct TyVirtFile *pVirtFile)
 {
-  struct TyVirtFileChunk *pFileChunk;
-  struct TyVirtFileChunk *pFileChunkNext;
+  unsigned int uChunk;
+  int nResult = 1;
 
   HQASSERT(pVirtFile, "DeleteAllChunks: pVirtFile is NULL");
 
-  for( pFileChunk = pVirtFile->pFirstChunk; pFileChunk; pFileChunk = pFileChunkNext )
+  for( uChunk = 0; uChunk < pVirtFile->nChunks; uChunk++ )
   {
-    pFileChunkNext = pFileChunk->pNextChunk;
-    switch(pFileChunk->nMemoryPool)
-    {
-    case OIL_VIRTFILE_MEM_RIP:
-      MemFree(pFileChunk->pMemory);
-      break;
-    case OIL_VIRTFILE_MEM_OIL_JOB:
-      OIL_free(OILMemoryPoolJob, pFileChunk->pMemory);
-      break;
-    default:
-      HQFAILV(("DeleteAllChunks: not expect memory pool %d", pFileChunk->nMemoryPool));
-      return 0;
-      break;
-    }
-    OIL_free(OILMemoryPoolJob, pFileChunk);
+    if(!FreeVirtFileChunk(pVirtFile->ppChunks[uChunk]))
+      nResult = 0;
+  }
+
+  if(pVirtFile->ppChunks)
+  {
+    OIL_free(OILMemoryPoolJob, pVirtFile->ppChunks);
   }
 
-  pVirtFile->pCurrentChunk = NULL;
-  pVirtFile->pFirstChunk = NULL;
+  pVirtFile->ppChunks = NULL;
+  pVirtFile->nChunks = 0;
+  pVirtFile->nChunksMax = 0;
+  pVirtFile->uCurrentChunk = 0;
   pVirtFile->uCurrentChunkPos = 0;
   pVirtFile->uLength = 0;
 
-  return 1;
+  return nResult;
 }
 
 /**
@@ -366,8 +571,7 @@ int OIL_VirtFileOpen(char *pszFilename, int nOpenFlags)
     return -1;
 
   /* Set file position to the beginning */
-  pVirtFile->pCurrentChunk = pVirtFile->pFirstChunk;
-  pVirtFile->uCurrentChunkPos = 0;
+  SetVirtFilePosition(pVirtFile, 0);
 
   return (pVirtFile->nFileID);
 }
@@ -387,8 +591,7 @@ int OIL_VirtFileClose(int nFileID)
   if(!pVirtFile)
     return -1;
 
-  pVirtFile->pCurrentChunk = pVirtFile->pFirstChunk;
-  pVirtFile->uCurrentChunkPos = 0;
+  SetVirtFilePosition(pVirtFile, 0);
 
   return 0;
 }
@@ -403,8 +606,7 @@ int OIL_VirtFileClose(int nFileID)
 int OIL_VirtFileDelete(char *pszFilename)
 {
   struct TyVirtFile *pVirtFileDelete;
-  struct TyVirtFile *pVirtFile;
-  struct TyVirtFile *pVirtFilePrev = NULL;
+  struct TyVirtFile **ppVirtFile;
 
   GG_SHOW(GG_SHOW_VIRTFILE,"OIL_VirtFileDelete %s\n", pszFilename);
 
@@ -412,32 +614,36 @@ int OIL_VirtFileDelete(char *pszFilename)
   if(!pVirtFileDelete)
     return -1;
 
-  for( pVirtFile = l_pVirtFiles; pVirtFile; pVirtFile = pVirtFile->pNextFile )
+  /* Unlink from the hash tables */
+  for( ppVirtFile = &l_apVirtFilesByName[VirtFileNameHash(pszFilename)];
+       *ppVirtFile != pVirtFileDelete;
+       ppVirtFile = &(*ppVirtFile)->pNextByName )
+    EMPTY_STATEMENT();
+  *ppVirtFile = pVirtFileDelete->pNextByName;
+
+  for( ppVirtFile = &l_apVirtFilesByID[VIRTFILE_ID_HASH(pVirtFileDelete->nFileID)];
+       *ppVirtFile != pVirtFileDelete;
+       ppVirtFile = &(*ppVirtFile)->pNextByID )
+    EMPTY_STATEMENT();
+  *ppVirtFile = pVirtFileDelete->pNextByID;
+
+  /* and from the list of all files */
+  for( ppVirtFile = &l_pVirtFiles; *ppVirtFile; ppVirtFile = &(*ppVirtFile)->pNextFile )
   {
-    if(pVirtFile == pVirtFileDelete)
+    if(*ppVirtFile == pVirtFileDelete)
     {
-      if(pVirtFilePrev)
-      {
-        pVirtFilePrev->pNextFile = pVirtFile->pNextFile;
-      }
-      else
-      {
-        if(pVirtFile->pNextFile) {
-          l_pVirtFiles = pVirtFile->pNextFile;
-        } else {
-          l_nNextFileID = 0;
-          l_pVirtFiles = NULL;
-        }
-      }
+      *ppVirtFile = pVirtFileDelete->pNextFile;
+      if(!l_pVirtFiles)
+        l_nNextFileID = 0;
 
-      DeleteAllChunks(pVirtFile);
-      OIL_free(OILMemoryPoolJob, pVirtFile->pszFilename);
-      OIL_free(OILMemoryPoolJob, pVirtFile);
+      DeleteAllChunks(pVirtFileDelete);
+      OIL_free(OILMemoryPoolJob, pVirtFileDelete->pszFilename);
+      OIL_free(OILMemoryPoolJob, pVirtFileDelete);
       return 0;
     }
-    pVirtFilePrev = pVirtFile;
   }
 
+  HQFAILV(("OIL_VirtFileDelete: %s is not in the file list", pszFilename));
   return -1;
 }
 
@@ -456,8 +662,7 @@ int OIL_VirtFileRead(int nFileID, unsigned char *pBuff, int nLength)
 {
   struct TyVirtFile *pVirtFile;
   struct TyVirtFileChunk *pVirtFileChunk;
-  unsigned int uToRead;
-  unsigned int uRemaining;
+  unsigned int uToRead = (unsigned int)nLength;
   unsigned char *pDst = pBuff;
 
   HQASSERT(pBuff, "OIL_VirtFileRead: pBuff is NULL");
@@ -469,73 +674,49 @@ int OIL_VirtFileRead(int nFileID, unsigned char *pBuff, int nLength)
     return -1;
 
   /* Is the file empty? */
-  if(!pVirtFile->pCurrentChunk)
-    return 0;
-  /* At the end of file */
-  if((pVirtFile->pCurrentChunk->pNextChunk == NULL) && (pVirtFile->pCurrentChunk->cbSize == pVirtFile->uCurrentChunkPos))
+  if(pVirtFile->nChunks == 0)
     return 0;
-  /* If the requested buffer fits in the current chunk, then we
-     simply copy the data and return early */
-  if((pVirtFile->pCurrentChunk->cbSize - pVirtFile->uCurrentChunkPos) >= (unsigned int)nLength)
-  {
-    memcpy(pDst, pVirtFile->pCurrentChunk->pMemory + pVirtFile->uCurrentChunkPos, nLength);
-    pVirtFile->uCurrentChunkPos+=nLength;
-    return nLength;
-  }
 
-  /* otherwise we'll get the remaining data from the current chunk,
-     and then copy the data out of the remain chunks in the loop below */
-  uRemaining = (pVirtFile->pCurrentChunk->cbSize - pVirtFile->uCurrentChunkPos);
-  if(uRemaining > 0)
+  /* Chunks are coalesced as the file is written, so this is usually a
+     single copy from the current chunk. */
+  while(uToRead > 0)
   {
-    memcpy(pDst, pVirtFile->pCurrentChunk->pMemory + pVirtFile->uCurrentChunkPos, uRemaining);
-    pDst += uRemaining;
-    pVirtFile->uCurrentChunkPos+=uRemaining;
-  }
-  uToRead = nLength - uRemaining;
-
-  /* At the end of file */
-  if((pVirtFile->pCurrentChunk->pNextChunk == NULL) && (pVirtFile->pCurrentChunk->cbSize == pVirtFile->uCurrentChunkPos))
-    return (nLength - uToRead);
+    unsigned int uAvail;
 
-  pVirtFile->pCurrentChunk = pVirtFile->pCurrentChunk->pNextChunk;
-  pVirtFile->uCurrentChunkPos = 0;
-
-  for( pVirtFileChunk = pVirtFile->pCurrentChunk; (uToRead!=0) && pVirtFileChunk; pVirtFileChunk = pVirtFileChunk->pNextChunk)
-  {
-    /* the remaining request data fits in this chunk */
-    if(uToRead <= pVirtFileChunk->cbSize)
-    {
-      memcpy(pDst, pVirtFileChunk->pMemory, uToRead);
-      pVirtFile->pCurrentChunk = pVirtFileChunk;
-      pVirtFile->uCurrentChunkPos = uToRead;
-      return nLength;
-    }
-    else
+    pVirtFileChunk = pVirtFile->ppChunks[pVirtFile->uCurrentChunk];
+    uAvail = pVirtFileChunk->cbSize - pVirtFile->uCurrentChunkPos;
+    if(uAvail == 0)
     {
-      memcpy(pDst, pVirtFileChunk->pMemory, pVirtFileChunk->cbSize);
-      uToRead -= pVirtFileChunk->cbSize;
-      pDst += pVirtFileChunk->cbSize;
+      /* At the end of file */
+      if(pVirtFile->uCurrentChunk + 1 >= pVirtFile->nChunks)
+        break;
+      pVirtFile->uCurrentChunk++;
+      pVirtFile->uCurrentChunkPos = 0;
+      continue;
     }
-  }
 
-  /* if we made it here, then the requested number of bytes to read 
-     is more than the length of the virtual file */
-  if(pVirtFileChunk)
-  {
-    pVirtFile->pCurrentChunk = pVirtFileChunk;
-    pVirtFile->uCurrentChunkPos = 0;
+    if(uAvail > uToRead)
+      uAvail = uToRead;
+    memcpy(pDst, pVirtFileChunk->pMemory + pVirtFile->uCurrentChunkPos, uAvail);
+    pVirtFile->uCurrentChunkPos += uAvail;
+    pDst += uAvail;
+    uToRead -= uAvail;
   }
 
-  return (nLength - uToRead);
+  return (nLength - (int)uToRead);
 }
 
 /**
  * \brief Write from a buffer to a virtual file.
  *
+ * Data at the current position is overwritten, and the rest is appended.
+ * Appended data fills the unused memory of the last chunk before a new chunk
+ * is added.
+ *
  * \param[in] nFileID Filename ID number of the virtual file to recieve the data.
  *
- * \param[in] pBuff Buffer containing the data to write to the virtual file.
+ * \param[in] pBuff Buffer containing the data to write to the virtual file. If NULL,
+ *                  nLength zero bytes are written.
  *
  * \param[in] nLength Length of the buffer.
  *
@@ -544,11 +725,9 @@ int OIL_VirtFileRead(int nFileID, unsigned char *pBuff, int nLength)
 int OIL_VirtFileWrite(int nFileID, unsigned char *pBuff, int nLength)
 {
   struct TyVirtFile *pVirtFile;
-  struct TyVirtFileChunk *pVirtFileChunkNew;
   struct TyVirtFileChunk *pVirtFileChunk;
-  unsigned char *pSrc;
-  int nToWrite;
-  int nWritten=0;
+  unsigned char *pSrc = pBuff;
+  unsigned int uToWrite = (unsigned int)nLength;
 
   pVirtFile = GetVirtFileFromID(nFileID);
 
@@ -556,85 +735,63 @@ int OIL_VirtFileWrite(int nFileID, unsigned char *pBuff, int nLength)
   if(!pVirtFile)
     return -1;
 
-  /* is it the first ever chunk? */
-  if(pVirtFile->pCurrentChunk==NULL)
+  while(uToWrite > 0)
   {
-    pVirtFileChunkNew = NewVirtFileChunk(pBuff, nLength);
-    if(!pVirtFileChunkNew)
-      return 0;
+    unsigned int uSpace;
 
-    pVirtFile->pCurrentChunk = pVirtFileChunkNew;
-    pVirtFile->pFirstChunk = pVirtFileChunkNew;
-    pVirtFile->uCurrentChunkPos = nLength;
-    pVirtFile->uLength = nLength;
-    nWritten = nLength;
-  }
-  else
-  {
-    /* Are we currently at the end of the file? */
-    if((pVirtFile->pCurrentChunk->pNextChunk == NULL) && (pVirtFile->uCurrentChunkPos == pVirtFile->pCurrentChunk->cbSize))
+    if(pVirtFile->nChunks == 0)
     {
-      pVirtFileChunkNew = NewVirtFileChunk(pBuff, nLength);
-      if(!pVirtFileChunkNew)
-        return 0;
+      /* is it the first ever chunk? */
+      if(!AppendVirtFileChunk(pVirtFile, uToWrite))
+        break;
+      pVirtFile->uCurrentChunk = 0;
+      pVirtFile->uCurrentChunkPos = 0;
+    }
 
-      pVirtFile->pCurrentChunk->pNextChunk = pVirtFileChunkNew;
-      pVirtFile->pCurrentChunk = pVirtFileChunkNew;
-      pVirtFile->uCurrentChunkPos = pVirtFileChunkNew->cbSize;
-      pVirtFile->uLength += nLength;
-      nWritten = nLength;
+    pVirtFileChunk = pVirtFile->ppChunks[pVirtFile->uCurrentChunk];
+    if(pVirtFile->uCurrentChunk + 1 < pVirtFile->nChunks)
+    {
+      /* Overwrite the rest of this chunk's data */
+      uSpace = pVirtFileChunk->cbSize - pVirtFile->uCurrentChunkPos;
     }
     else
     {
-      /* does the data fit into the current chunk? */
-      if((pVirtFile->uCurrentChunkPos + nLength) <= pVirtFile->pCurrentChunk->cbSize)
-      {
-        memcpy(pVirtFile->pCurrentChunk->pMemory + pVirtFile->uCurrentChunkPos, pBuff, nLength);
-        pVirtFile->uCurrentChunkPos += nLength;
-        nWritten = nLength;
-      }
-      else
-      {
-        int nBytesToCopy;
-        /* We need to write more data than fits in the current chunk.
-           Fill the current chunk, and any next chunks until existing file is full.
-           Then create a new chunk for remaining buffer. 
-        */
-
-        nToWrite = nLength;
-        pSrc = pBuff;
-
-        nBytesToCopy = pVirtFile->pCurrentChunk->cbSize - pVirtFile->uCurrentChunkPos;
-
-        memcpy(pVirtFile->pCurrentChunk->pMemory, pSrc, nBytesToCopy);
-        nToWrite -= nBytesToCopy;
-        pSrc += nBytesToCopy;
-        nWritten += nBytesToCopy;
-        pVirtFile->uCurrentChunkPos = pVirtFile->pCurrentChunk->cbSize;
-
-        for(pVirtFileChunk = pVirtFile->pCurrentChunk->pNextChunk; 
-            pVirtFileChunk && (nToWrite > 0); 
-            pVirtFileChunk=pVirtFileChunk->pNextChunk)
-        {
-          nBytesToCopy = (nToWrite <= (int)pVirtFileChunk->cbSize)? nToWrite : (int)pVirtFileChunk->cbSize;
-          memcpy(pVirtFileChunk->pMemory, pSrc, nBytesToCopy);
-          nWritten += nBytesToCopy;
-          nToWrite -= nBytesToCopy;
-          pSrc += nBytesToCopy;
-          pVirtFile->pCurrentChunk = pVirtFileChunk;
-          pVirtFile->uCurrentChunkPos = nBytesToCopy;
-        }
-
-        if(nToWrite>0)
-        {
-          /* recurse to append a new chunk */
-          nWritten += OIL_VirtFileWrite(nFileID, pSrc, nToWrite);
-        }
-      }
+      /* Overwrite and extend the last chunk, up to its capacity */
+      uSpace = pVirtFileChunk->cbCapacity - pVirtFile->uCurrentChunkPos;
+    }
+
+    if(uSpace == 0)
+    {
+      if(pVirtFile->uCurrentChunk + 1 >= pVirtFile->nChunks &&
+         !AppendVirtFileChunk(pVirtFile, uToWrite))
+        break;
+      pVirtFile->uCurrentChunk++;
+      pVirtFile->uCurrentChunkPos = 0;
+      continue;
+    }
+
+    if(uSpace > uToWrite)
+      uSpace = uToWrite;
+    if(pSrc)
+    {
+      memcpy(pVirtFileChunk->pMemory + pVirtFile->uCurrentChunkPos, pSrc, uSpace);
+      pSrc += uSpace;
+    }
+    else
+    {
+      memset(pVirtFileChunk->pMemory + pVirtFile->uCurrentChunkPos, 0x00, uSpace);
+    }
+    pVirtFile->uCurrentChunkPos += uSpace;
+    uToWrite -= uSpace;
+
+    if(pVirtFile->uCurrentChunkPos > pVirtFileChunk->cbSize)
+    {
+      pVirtFile->uLength += pVirtFile->uCurrentChunkPos - pVirtFileChunk->cbSize;
+      pVirtFileChunk->cbSize = pVirtFile->uCurrentChunkPos;
     }
   }
 
-  return nWritten;
+  return (nLength - (int)uToWrite);
 }
 
 /**
@@ -654,8 +811,8 @@ int OIL_VirtFileWrite(int nFileID, unsigned char *pBuff, int nLength)
 int OIL_VirtFileSeek(int nFileID, Hq32x2 *pDestination, int nWhence)
 {
   struct TyVirtFile *pVirtFile;
-  struct TyVirtFileChunk *pVirtFileChunk;
   unsigned int uDest;
+  unsigned int uPosition;
 
   HQASSERT(pDestination, "OIL_VirtFileSeek: destination NULL");
   HQASSERT(pDestination->high == 0,
@@ -670,82 +827,50 @@ int OIL_VirtFileSeek(int nFileID, Hq32x2 *pDestination, int nWhence)
   if ( !Hq32x2ToUint32( pDestination, &uDest ) )
     return 0;
 
-  if(pVirtFile->pFirstChunk==NULL)
+  if(pVirtFile->nChunks == 0)
     return (uDest==0);
 
+  uPosition = GetVirtFilePosition(pVirtFile);
+
   switch(nWhence)
   {
   case SW_SET:
-    GG_SHOW(GG_SHOW_VIRTFILE, "OIL_VirtFileSeek: SW_SET %u uLength=%d uCurrentChunkPos=%d cbSize=%d\n", 
-      uDest, pVirtFile->uLength, pVirtFile->uCurrentChunkPos, pVirtFile->pCurrentChunk->cbSize);
+    GG_SHOW(GG_SHOW_VIRTFILE, "OIL_VirtFileSeek: SW_SET %u uLength=%d uPosition=%d\n", 
+      uDest, pVirtFile->uLength, uPosition);
 
-    if(uDest==0)
+    if(uDest <= pVirtFile->uLength)
     {
-      pVirtFile->pCurrentChunk = pVirtFile->pFirstChunk;
-      pVirtFile->uCurrentChunkPos = 0;
+      SetVirtFilePosition(pVirtFile, uDest);
     }
     else
-    { 
-      for(pVirtFile->pCurrentChunk = pVirtFile->pFirstChunk; 
-          pVirtFile->pCurrentChunk;
-          pVirtFile->pCurrentChunk = pVirtFile->pCurrentChunk->pNextChunk) 
-      { 
-        if(uDest < pVirtFile->pCurrentChunk->cbSize) {
-          pVirtFile->uCurrentChunkPos = uDest;
-          uDest = 0;
-          break;
-        }
-        uDest -= pVirtFile->pCurrentChunk->cbSize; 
-        if(!pVirtFile->pCurrentChunk->pNextChunk) {
-          pVirtFile->uCurrentChunkPos = pVirtFile->pCurrentChunk->cbSize;
-          break;
-        }
-      }
-
-      if(uDest > 0)
-      {
-        int nWritten;
+    {
+      int nWritten;
 
-        /* We've been asked to seek past the end of the file... maybe an error? */
-        GG_SHOW(GG_SHOW_VIRTFILE, "OIL_VirtFileSeek: Seek %u bytes past the end of the file... maybe an error?\n", uDest);
+      /* We've been asked to seek past the end of the file... maybe an error? */
+      GG_SHOW(GG_SHOW_VIRTFILE, "OIL_VirtFileSeek: Seek %u bytes past the end of the file... maybe an error?\n",
+        uDest - pVirtFile->uLength);
 
-        nWritten = OIL_VirtFileWrite(nFileID, NULL, uDest);
-        if(nWritten != (int)uDest)
-          return 0;
-      }
+      uDest -= pVirtFile->uLength;
+      SetVirtFilePosition(pVirtFile, pVirtFile->uLength);
+      nWritten = OIL_VirtFileWrite(nFileID, NULL, uDest);
+      if(nWritten != (int)uDest)
+        return 0;
     }
-
     break;
 
   case SW_INCR:
-    GG_SHOW(GG_SHOW_VIRTFILE, "OIL_VirtFileSeek: SW_INCR %u uLength=%d uCurrentChunkPos=%d cbSize=%d\n", 
-      uDest, pVirtFile->uLength, pVirtFile->uCurrentChunkPos, pVirtFile->pCurrentChunk->cbSize);
+    GG_SHOW(GG_SHOW_VIRTFILE, "OIL_VirtFileSeek: SW_INCR %u uLength=%d uPosition=%d\n", 
+      uDest, pVirtFile->uLength, uPosition);
 
-    if(uDest <= (pVirtFile->pCurrentChunk->cbSize - pVirtFile->uCurrentChunkPos))
-    {
-      pVirtFile->uCurrentChunkPos += uDest;
-      break;
-    }
-
-    uDest -= (pVirtFile->pCurrentChunk->cbSize - pVirtFile->uCurrentChunkPos);
-
-    for(pVirtFileChunk = pVirtFile->pCurrentChunk->pNextChunk; 
-        pVirtFileChunk && (uDest > pVirtFileChunk->cbSize); 
-        pVirtFileChunk = pVirtFileChunk->pNextChunk) 
-    { 
-      uDest -= pVirtFileChunk->cbSize; 
-    }
-
-    if(!pVirtFileChunk)
+    if(uDest > pVirtFile->uLength - uPosition)
       return 0;
 
-    pVirtFile->uCurrentChunkPos = uDest;
-    pVirtFile->pCurrentChunk = pVirtFileChunk;
+    SetVirtFilePosition(pVirtFile, uPosition + uDest);
     break ;
 
   case SW_XTND:
-    GG_SHOW(GG_SHOW_VIRTFILE, "SW_XTND: SW_INCR %u uLength=%d uCurrentChunkPos=%d cbSize=%d\n", 
-      uDest, pVirtFile->uLength, pVirtFile->uCurrentChunkPos, pVirtFile->pCurrentChunk->cbSize);
+    GG_SHOW(GG_SHOW_VIRTFILE, "SW_XTND: SW_INCR %u uLength=%d uPosition=%d\n", 
+      uDest, pVirtFile->uLength, uPosition);
 
     HQFAIL("OIL_VirtFileSeek: Seek method SW_XTND not implemented");
     return 0;
@@ -805,8 +930,6 @@ int OIL_VirtFileStatus(char *pszFilename, STAT *pStat)
 int OIL_VirtFileBytes(int nFileID, Hq32x2 *pBytes, int nReason)
 {
   struct TyVirtFile *pVirtFile;
-  struct TyVirtFileChunk *pVirtFileChunk;
-  unsigned int uBytes;
 
   pVirtFile = GetVirtFileFromID(nFileID);
   if(!pVirtFile)
@@ -815,39 +938,10 @@ int OIL_VirtFileBytes(int nFileID, Hq32x2 *pBytes, int nReason)
   switch ( nReason )
   {
   case SW_BYTES_AVAIL_REL:
-
-    /* No current chunk, then nothing left in file */
-    if(!pVirtFile->pCurrentChunk)
-    {
-      Hq32x2FromUint32( pBytes, 0 );
-      break;
-    }
-
-    /* No next chunk, so we'll return the space left in the current chunk */
-    if(pVirtFile->pCurrentChunk->pNextChunk == NULL)
-    {
-      Hq32x2FromUint32( pBytes, pVirtFile->pCurrentChunk->cbSize - pVirtFile->uCurrentChunkPos );
-      break;
-    }
-
-    /* Where is the current position from the first chunk? */
-    uBytes = 0;
-    for(pVirtFileChunk = pVirtFile->pFirstChunk;
-      pVirtFileChunk; 
-      pVirtFileChunk = pVirtFileChunk->pNextChunk)
-    {
-      if(pVirtFileChunk == pVirtFile->pCurrentChunk)
-      {
-        uBytes += pVirtFile->uCurrentChunkPos;
-        break;
-      }
-      uBytes += pVirtFileChunk->cbSize;
-    }
     /* Total length minus current position */
-    Hq32x2FromUint32( pBytes, pVirtFile->uLength - uBytes );
+    Hq32x2FromUint32( pBytes, pVirtFile->uLength - GetVirtFilePosition(pVirtFile) );
     break;
 
-
   case SW_BYTES_TOTAL_ABS:
     Hq32x2FromUint32( pBytes, pVirtFile->uLength );
     break;
@@ -872,6 +966,7 @@ int OIL_VirtFileSendToOutput(int nFileID)
 {
   struct TyVirtFile *pVirtFile;
   struct TyVirtFileChunk *pVirtFileChunk;
+  unsigned int uChunk;
   int nWritten;
   PMS_TyBackChannelWriteFileOut tFile;
 
@@ -884,10 +979,9 @@ int OIL_VirtFileSendToOutput(int nFileID)
   sprintf(tFile.szFilename, "%s", pVirtFile->pszFilename + 6);
 
   /* Output the complete file */
-  for(pVirtFileChunk = pVirtFile->pFirstChunk;
-      pVirtFileChunk;
-      pVirtFileChunk = pVirtFileChunk->pNextChunk)
+  for(uChunk = 0; uChunk < pVirtFile->nChunks; uChunk++)
   {
+    pVirtFileChunk = pVirtFile->ppChunks[uChunk];
     PMS_WriteDataStream(PMS_WRITE_FILE_OUT,
                         &tFile,
                         pVirtFileChunk->pMemory,
@@ -916,4 +1010,3 @@ int OIL_VirtFileCleanup() {
 
   return 1;
 }
-
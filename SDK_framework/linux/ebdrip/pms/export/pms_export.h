@@ -82,6 +82,8 @@ enum {
   EPMS_FN_RasterLayout,
   EPMS_FN_RasterRequirements,
   EPMS_FN_RasterDestination,
+  EPMS_FN_LeaseBuffer,         /**< Lease a buffer from the band ring. */
+  EPMS_FN_ReleaseBuffer,       /**< Return a leased buffer to the band ring. */
   EPMS_FN_RippingComplete,
   EPMS_FN_Malloc,
   EPMS_FN_Free,
@@ -253,12 +255,20 @@ typedef int PMS_eOutputType;
 enum {
     PMS_PUSH_PAGE,        /**< OIL should push page into PMS */
     PMS_PULL_BAND,        /**< PMS will Pull Bands from OIL */
-    PMS_PUSH_BAND,        /**< OIL should push bands(on the fly) into PMS */
-    PMS_PUSH_BAND_DIRECT_SINGLE, /**< The RIP should render directly into memory provided by the PMS, one band at a time. */
+    PMS_PUSH_BAND,        /**< OIL should push bands(on the fly) into PMS. Each band is copied into a buffer leased from the PMS band ring. */
+    PMS_PUSH_BAND_DIRECT_SINGLE, /**< The RIP should render directly into memory provided by the PMS, one band at a time. Each band buffer is leased from a ring and handed to the page without copying. */
     PMS_PUSH_BAND_DIRECT_FRAME,  /**< The RIP should render directly into memory provided by the PMS, which is part of a framebuffer. The framebuffer can also be used to store the results of partial paints, which has large performance advantages. */
 };
 typedef int PMS_eBandDeliveryType;
 
+/*! \brief Uses of a buffer leased with PMS_LeaseBuffer().
+*/
+enum {
+    PMS_LEASE_FOR_BAND,   /**< A band raster, passed back to PMS_CheckinBand(). */
+    PMS_LEASE_FOR_FILE,   /**< Memory held until it is passed to PMS_ReleaseBuffer(). */
+};
+typedef int PMS_eLeaseUse;
+
 /*! \brief Colorant Families.
 */
 enum {
@@ -337,6 +337,359 @@ static unsigned int guRIPComponents = 0;
     framebuffer, if present. */
 static unsigned int guRIPComponentsPerBand = 0;
 
+/*! \brief Who is using a band buffer in the band ring. */
+typedef enum {
+  PMS_LEASE_IDLE = 0,   /**< Free to be leased for another band. */
+  PMS_LEASE_RIP,        /**< Leased for a band which has not been checked in. */
+  PMS_LEASE_PAGE,       /**< Checked in and hooked into a PMS page. */
+  PMS_LEASE_FILE        /**< Leased by the OIL until it calls PMS_ReleaseBuffer(). */
+} PMS_eBandLeaseState;
+
+/*! \brief A buffer leased from the PMS band ring.
+ *
+ * In \c PMS_PUSH_BAND_DIRECT_SINGLE mode the RIP renders each band directly
+ * into a leased buffer, and in \c PMS_PUSH_BAND mode the OIL copies each band
+ * into one.  The buffer is then hooked into the PMS page without copying, and
+ * goes back to the ring when the page has been output, ready for a later band.
+ * A band leased but never checked in goes back to the ring at the end of the
+ * page it was leased for.  The OIL also leases memory for its pagebuffer
+ * files, which it holds until it releases it.
+ */
+typedef struct PMS_TyBandLease {
+  unsigned char *pBuffer;         /**< Band memory, owned by the PMS. */
+  size_t cbBuffer;                /**< Size of the band memory in bytes. */
+  PMS_eBandLeaseState eState;     /**< Who is using the buffer. */
+  unsigned int uPage;             /**< Page the buffer was leased for. */
+  int nFrameNumber;               /**< Frame the buffer was leased for. */
+  unsigned int uBandNum;          /**< Band the buffer was leased for. */
+  struct PMS_TyBandLease *pNext;  /**< Next lease in the ring. */
+} PMS_TyBandLease;
+
+/** The ring of band buffers, linked circularly. Points at the lease to try
+    first when the RIP next asks for a band. Protected by \c g_csBandRing. */
+static PMS_TyBandLease *l_pBandRing = NULL;
+/** The size in bytes of the band buffers currently being leased. */
+static size_t l_cbBandRing = 0;
+/** The number of pages whose bands have all been checked in. Band leases are
+    keyed by it, so that the end of one page only returns its own leases. */
+static unsigned int l_uLeasePage = 0;
+/** TRUE once the ring has been freed, after which buffers the OIL still
+    holds are freed when it releases them. */
+static int l_bBandRingClosed = FALSE;
+
+/**
+ * \brief Free all the idle band buffers which are not of the given size.
+ *
+ * The caller must hold \c g_csBandRing.  A size of zero frees every buffer
+ * in the ring except those the OIL holds for files, so must only be used once
+ * the RIP and the PMS have finished with all the bands.
+ */
+static void TrimBandRing(size_t cbKeep)
+{
+  PMS_TyBandLease *pHead, *pLease, **ppLease;
+
+  if (l_pBandRing == NULL)
+    return;
+
+  /* Break the ring into a list, filter it, and close it up again. */
+  pHead = l_pBandRing->pNext;
+  l_pBandRing->pNext = NULL;
+  ppLease = &pHead;
+  while ((pLease = *ppLease) != NULL)
+  {
+    if ((cbKeep == 0 && pLease->eState != PMS_LEASE_FILE) ||
+        (pLease->eState == PMS_LEASE_IDLE && pLease->cbBuffer != cbKeep))
+    {
+      *ppLease = pLease->pNext;
+      OSFree(pLease->pBuffer, PMS_MemoryPoolPMS);
+      OSFree(pLease, PMS_MemoryPoolPMS);
+    }
+    else
+    {
+      ppLease = &pLease->pNext;
+    }
+  }
+  if (pHead != NULL)
+    *ppLease = pHead;
+  l_pBandRing = pHead;
+}
+
+/**
+ * \brief Lease a buffer from the ring.
+ *
+ * If the RIP asks again for a band of the current page it has not yet checked
+ * in, it gets the same buffer back.  Otherwise an idle buffer of the right
+ * size is reused if there is one, or a new buffer is added to the ring.  The
+ * ring therefore grows to the number of bands the PMS holds at once, and
+ * stays at that size from page to page.
+ *
+ * \param[in] eState        \c PMS_LEASE_RIP for a band, or \c PMS_LEASE_FILE.
+ * \param[in] nFrameNumber  Frame of a band, or -1 if it is not known.
+ * \param[in] uBandNum      Band number of a band.
+ * \param[in] cbBuffer      Size of the buffer in bytes.
+ *
+ * \return The buffer, or NULL if a new buffer could not be allocated.
+ */
+static unsigned char *LeaseBandBuffer(PMS_eBandLeaseState eState,
+                                      int nFrameNumber, unsigned int uBandNum,
+                                      size_t cbBuffer)
+{
+  PMS_TyBandLease *pLease, *pIdle = NULL, *pSame = NULL;
+  unsigned char *pBuffer = NULL;
+
+  PMS_EnterCriticalSection(g_csBandRing);
+
+  pLease = l_pBandRing;
+  if (pLease != NULL)
+  {
+    do
+    {
+      if (pLease->cbBuffer == cbBuffer)
+      {
+        if (eState == PMS_LEASE_RIP && nFrameNumber >= 0 &&
+            pLease->eState == PMS_LEASE_RIP && pLease->uPage == l_uLeasePage &&
+            pLease->nFrameNumber == nFrameNumber && pLease->uBandNum == uBandNum)
+        {
+          pSame = pLease;
+          break;
+        }
+        if (pLease->eState == PMS_LEASE_IDLE && pIdle == NULL)
+          pIdle = pLease;
+      }
+      pLease = pLease->pNext;
+    } while (pLease != l_pBandRing);
+
+    pLease = pSame != NULL ? pSame : pIdle;
+  }
+
+  if (pLease == NULL)
+  {
+    pLease = (PMS_TyBandLease *)OSMalloc(sizeof(PMS_TyBandLease), PMS_MemoryPoolPMS);
+    if (pLease != NULL)
+    {
+      pLease->pBuffer = (unsigned char *)OSMalloc(cbBuffer, PMS_MemoryPoolPMS);
+      if (pLease->pBuffer == NULL)
+      {
+        OSFree(pLease, PMS_MemoryPoolPMS);
+        pLease = NULL;
+      }
+    }
+    if (pLease != NULL)
+    {
+      pLease->cbBuffer = cbBuffer;
+      if (l_pBandRing == NULL)
+      {
+        pLease->pNext = pLease;
+        l_pBandRing = pLease;
+      }
+      else
+      {
+        pLease->pNext = l_pBandRing->pNext;
+        l_pBandRing->pNext = pLease;
+      }
+      l_bBandRingClosed = FALSE;
+    }
+  }
+
+  if (pLease != NULL)
+  {
+    pLease->eState = eState;
+    pLease->uPage = l_uLeasePage;
+    pLease->nFrameNumber = nFrameNumber;
+    pLease->uBandNum = uBandNum;
+    pBuffer = pLease->pBuffer;
+    /* Start looking for the next band after this one. */
+    l_pBandRing = pLease->pNext;
+  }
+
+  PMS_LeaveCriticalSection(g_csBandRing);
+
+  return pBuffer;
+}
+
+/**
+ * \brief Find the lease whose band buffer contains a raster pointer.
+ *
+ * The caller must hold \c g_csBandRing.
+ *
+ * \return The lease, or NULL if the raster was not leased from the ring.
+ */
+static PMS_TyBandLease *FindBandLease(unsigned char *pRaster)
+{
+  PMS_TyBandLease *pLease = l_pBandRing;
+
+  if (pLease != NULL)
+  {
+    do
+    {
+      if (pRaster >= pLease->pBuffer && pRaster < pLease->pBuffer + pLease->cbBuffer)
+        return pLease;
+      pLease = pLease->pNext;
+    } while (pLease != l_pBandRing);
+  }
+
+  return NULL;
+}
+
+/**
+ * \brief Find the lease holding the rasters of a band packet.
+ *
+ * All of the colorants in a packet are rendered into the same leased buffer,
+ * so only the first raster pointer is needed to find it.  The caller must
+ * hold \c g_csBandRing.
+ *
+ * \return The lease, or NULL if the rasters were not leased from the ring.
+ */
+static PMS_TyBandLease *FindBandPacketLease(PMS_TyBandPacket *ThisBand)
+{
+  int i;
+
+  for (i = 0; i < PMS_MAX_PLANES_COUNT; i++)
+  {
+    if (ThisBand->atColoredBand[i].ePlaneColorant != PMS_INVALID_COLOURANT &&
+        ThisBand->atColoredBand[i].pBandRaster != NULL)
+      return FindBandLease(ThisBand->atColoredBand[i].pBandRaster);
+  }
+
+  return NULL;
+}
+
+/**
+ * \brief Record that a checked in band packet has been hooked into a page, or
+ * return its band buffer to the ring.
+ */
+static void CheckinBandPacket(PMS_TyBandPacket *ThisBand, int bHooked)
+{
+  PMS_TyBandLease *pLease;
+
+  PMS_EnterCriticalSection(g_csBandRing);
+  pLease = FindBandPacketLease(ThisBand);
+  if (pLease != NULL)
+    pLease->eState = bHooked ? PMS_LEASE_PAGE : PMS_LEASE_IDLE;
+  PMS_LeaveCriticalSection(g_csBandRing);
+}
+
+/**
+ * \brief Return the band buffers leased for the page just finished which were
+ * not checked in, and start keying leases by the next page.
+ *
+ * Called at the end of a page.  The RIP may fix a band's memory and then not
+ * deliver it, for instance when the page is aborted; those bands will not be
+ * checked in now, so their buffers can be leased again.  Buffers hooked into
+ * pages, bands already leased for a later page and buffers the OIL holds for
+ * files are unaffected.
+ */
+static void ReleaseUncheckedBands(void)
+{
+  PMS_TyBandLease *pLease;
+
+  PMS_EnterCriticalSection(g_csBandRing);
+  pLease = l_pBandRing;
+  if (pLease != NULL)
+  {
+    do
+    {
+      if (pLease->eState == PMS_LEASE_RIP && pLease->uPage == l_uLeasePage)
+        pLease->eState = PMS_LEASE_IDLE;
+      pLease = pLease->pNext;
+    } while (pLease != l_pBandRing);
+  }
+  l_uLeasePage++;
+  PMS_LeaveCriticalSection(g_csBandRing);
+}
+
+/**
+ * \brief PMS Callback routine to lease a buffer from the band ring.
+ *
+ * A buffer leased for a band is passed back in a band packet to
+ * PMS_CheckinBand(), which hooks it into the page without copying if it can.
+ * A buffer leased for a file is held until PMS_ReleaseBuffer() is called.
+ *
+ * \param[in]  cbBuffer  Size of the buffer in bytes.
+ * \param[in]  eUse      What the buffer is used for.
+ * \param[out] ppBuffer  The buffer, or NULL if it could not be allocated.
+ *
+ * \return 1 if the buffer was leased, 0 otherwise.
+ */
+int PMS_LeaseBuffer(size_t cbBuffer, PMS_eLeaseUse eUse, unsigned char **ppBuffer)
+{
+  PMS_ASSERT(ppBuffer != NULL, ("PMS_LeaseBuffer : ppBuffer value is NULL\n"));
+
+  *ppBuffer = LeaseBandBuffer(eUse == PMS_LEASE_FOR_FILE ? PMS_LEASE_FILE : PMS_LEASE_RIP,
+                              -1, 0, cbBuffer);
+  return (*ppBuffer != NULL);
+}
+
+/**
+ * \brief PMS Callback routine to return a leased buffer to the band ring.
+ *
+ * Used for buffers leased for files, and for band buffers which will not be
+ * checked in.
+ *
+ * \return 1 if the buffer was leased from the ring, 0 otherwise.
+ */
+int PMS_ReleaseBuffer(unsigned char *pBuffer)
+{
+  PMS_TyBandLease *pLease, *pPrev;
+  int bFound = FALSE;
+
+  PMS_EnterCriticalSection(g_csBandRing);
+  pLease = FindBandLease(pBuffer);
+  if (pLease != NULL && pLease->eState != PMS_LEASE_PAGE)
+  {
+    bFound = TRUE;
+    pLease->eState = PMS_LEASE_IDLE;
+    if (l_bBandRingClosed)
+    {
+      /* The ring has been freed apart from the files' buffers. */
+      pPrev = pLease;
+      while (pPrev->pNext != pLease)
+        pPrev = pPrev->pNext;
+      pPrev->pNext = pLease->pNext;
+      l_pBandRing = (pPrev == pLease) ? NULL : pPrev;
+      OSFree(pLease->pBuffer, PMS_MemoryPoolPMS);
+      OSFree(pLease, PMS_MemoryPoolPMS);
+    }
+  }
+  PMS_LeaveCriticalSection(g_csBandRing);
+
+  return bFound;
+}
+
+/**
+ * \brief Free the band rasters of a PMS page.
+ *
+ * Rasters in band buffers leased from the ring are returned to the ring;
+ * rasters the PMS allocated itself are freed.
+ */
+void PMS_FreeBandRasters(PMS_TyPage *ptPMSPage)
+{
+  unsigned int i, j;
+
+  /* Hold the ring for the whole page, so a buffer released for one colorant
+   * cannot be leased again before the page's other colorants are seen. */
+  PMS_EnterCriticalSection(g_csBandRing);
+  for(i = 0; i < PMS_MAX_PLANES_COUNT; i++)
+  {
+    for(j = 0; j < PMS_BAND_LIMIT; j++)
+    {
+      unsigned char *pRaster = ptPMSPage->atPlane[i].atBand[j].pBandRaster;
+
+      if(pRaster != NULL)
+      {
+        PMS_TyBandLease *pLease = FindBandLease(pRaster);
+
+        if (pLease != NULL)
+          pLease->eState = PMS_LEASE_IDLE;
+        else
+          OSFree(pRaster, PMS_MemoryPoolPMS);
+        ptPMSPage->atPlane[i].atBand[j].pBandRaster = NULL;
+      }
+    }
+  }
+  PMS_LeaveCriticalSection(g_csBandRing);
+}
+
 /**
  * \brief PMS Callback routine to enable OIL to look at the Data Stream chunk.
  *
@@ -646,11 +999,17 @@ int PMS_CheckinBand(PMS_TyBandPacket *ThisBand)
   int i, nColorant;
   unsigned char   *pRasterBuffer;
   PMS_TyPage *pstPageToPrint;
+  int bHooked = FALSE;
+  int bLeased = FALSE;
 
   pstPageToPrint = g_pstCurrentPMSPage;
 
   if(ThisBand == NULL) /* last band */
   {
+    if (g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND_DIRECT_SINGLE ||
+        g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND)
+      ReleaseUncheckedBands();
+
     if (g_tSystemInfo.uUseRIPAhead)
     {
       PMS_IncrementSemaphore(g_semPageComplete);
@@ -672,6 +1031,16 @@ int PMS_CheckinBand(PMS_TyBandPacket *ThisBand)
     return TRUE;
   }
 
+  /* In push band mode the OIL copies each band into a buffer leased from the
+   * band ring, which can be hooked into the page like a direct single band. */
+  if (g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND_DIRECT_SINGLE ||
+      g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND)
+  {
+    PMS_EnterCriticalSection(g_csBandRing);
+    bLeased = (FindBandPacketLease(ThisBand) != NULL);
+    PMS_LeaveCriticalSection(g_csBandRing);
+  }
+
   if(g_tSystemInfo.eOutputType != PMS_NONE)
   {
     /* How much data do we need to copy for each line? */
@@ -692,9 +1061,13 @@ int PMS_CheckinBand(PMS_TyBandPacket *ThisBand)
         pstPageToPrint->atPlane[nColorant].atBand[ThisBand->uBandNumber-1].cbBandSize = bytesPerBand;
 
         /* allocate memory for rasters if we're not in direct mode, or if the
-         * output from the core is scan-line interleaved. */
-        if (g_tSystemInfo.eBandDeliveryType != PMS_PUSH_BAND_DIRECT_FRAME ||
-            g_tSystemInfo.bScanlineInterleave)
+         * output from the core is scan-line interleaved.  A leased push band
+         * can be used as it is if its lines are packed. */
+        if (((g_tSystemInfo.eBandDeliveryType != PMS_PUSH_BAND_DIRECT_SINGLE &&
+              g_tSystemInfo.eBandDeliveryType != PMS_PUSH_BAND_DIRECT_FRAME) ||
+             g_tSystemInfo.bScanlineInterleave) &&
+            !(g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND && bLeased &&
+              ThisBand->atColoredBand[i].cbBandSize == (unsigned int)bytesPerBand))
         {
           int y;
           unsigned char *src;
@@ -712,6 +1085,10 @@ int PMS_CheckinBand(PMS_TyBandPacket *ThisBand)
           if(!pRasterBuffer)
           {
             PMS_SHOW_ERROR("\n**** Page Handler: Memory allocation failed **** \n\n");
+            /* Keep a leased buffer already hooked into the page for a
+             * previous colorant of this band. */
+            if (bLeased && bHooked)
+              CheckinBandPacket(ThisBand, bHooked);
             return FALSE;
           }
           src = ThisBand->atColoredBand[i].pBandRaster;
@@ -726,12 +1103,21 @@ int PMS_CheckinBand(PMS_TyBandPacket *ThisBand)
         }
         else
         {
+          /* The RIP or the OIL wrote straight into PMS memory; a leased
+           * band buffer now belongs to the page. */
           pstPageToPrint->atPlane[nColorant].atBand[ThisBand->uBandNumber-1].pBandRaster = ThisBand->atColoredBand[i].pBandRaster;
+          bHooked = TRUE;
         }
         pstPageToPrint->atPlane[nColorant].uBandTotal++;
       }
     }
   }
+
+  /* A leased band buffer whose contents were copied, or not wanted, can be
+   * reused straight away. */
+  if (bLeased)
+    CheckinBandPacket(ThisBand, bHooked);
+
   return TRUE;
 }
 
@@ -742,19 +1128,7 @@ int PMS_CheckinBand(PMS_TyBandPacket *ThisBand)
  */
 int PMS_DeletePrintedPage(PMS_TyPage *pstPageToDelete)
 {
-  unsigned int i, j;
-
-  for(i = 0; i < PMS_MAX_PLANES_COUNT; i++)
-  {
-    for(j = 0; j < PMS_BAND_LIMIT; j++)
-    {
-      if(pstPageToDelete->atPlane[i].atBand[j].pBandRaster != NULL)
-      {
-        OSFree(pstPageToDelete->atPlane[i].atBand[j].pBandRaster, PMS_MemoryPoolPMS);
-        pstPageToDelete->atPlane[i].atBand[j].pBandRaster = NULL;
-      }
-    }
-  }
+  PMS_FreeBandRasters(pstPageToDelete);
 
   /* now allow the page list in PMSOutput to be cleared
   currently has an issue with cclearing part complete pages */ 
@@ -1215,6 +1589,12 @@ void FreePMSFramebuffer(void)
     gFrameBuffer = NULL;
   }
 
+  PMS_EnterCriticalSection(g_csBandRing);
+  l_cbBandRing = 0;
+  TrimBandRing(0);
+  l_bBandRingClosed = TRUE;
+  PMS_LeaveCriticalSection(g_csBandRing);
+
   gnPageHeightPixels = 0;
   gFrameBufferSize = 0;
   guRIPBandHeight = 0;
@@ -1348,7 +1728,26 @@ int PMS_RasterRequirements( int nPageWidthPixels, int nPageHeightPixels,
   }
   else if (g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND_DIRECT_SINGLE)
   {
-    uFrameBufferSize = uRIPBandHeight * uRIPBytesPerLine * uComponents ;
+    /* Each band is leased from the band ring as the RIP asks for it, so
+     * there is no framebuffer.  The OIL calls this before every band in
+     * this mode, so only trim the ring when the band size changes. */
+    size_t cbBand = uRIPBandHeight * uRIPBytesPerLine * uComponentsPerBand ;
+
+    gnPageHeightPixels = nPageHeightPixels;
+    guRIPBandHeight = uRIPBandHeight;
+    guRIPBytesPerLine = uRIPBytesPerLine;
+    guRIPComponents = uComponents;
+    guRIPComponentsPerBand = uComponentsPerBand;
+
+    if (l_cbBandRing != cbBand)
+    {
+      PMS_EnterCriticalSection(g_csBandRing);
+      l_cbBandRing = cbBand;
+      TrimBandRing(cbBand);
+      PMS_LeaveCriticalSection(g_csBandRing);
+    }
+    *fHaveFrameBuffer = TRUE;
+    return 0;
   }
   else if (g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND_DIRECT_FRAME)
   {
@@ -1409,7 +1808,12 @@ int PMS_RasterDestination( int nFrameNumber, unsigned int uBandNum,
 
   if (g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND_DIRECT_SINGLE)
   {
-    *pMemoryBase = gFrameBuffer;
+    *pMemoryBase = LeaseBandBuffer(PMS_LEASE_RIP, nFrameNumber, uBandNum, uBandSize);
+    if (*pMemoryBase == NULL)
+    {
+      PMS_SHOW_ERROR("\n**** Raster Destination: Memory allocation failed **** \n\n");
+      return -1;
+    }
     *pMemoryCeiling = *pMemoryBase + uBandSize - 1;
   }
   else if (g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND_DIRECT_FRAME)
@@ -2348,6 +2752,8 @@ PMS_API_FNS PMS_InitAPI()
   apfnRip_IF_KcCalls[EPMS_FN_RasterLayout]      = PMS_RasterLayout;
   apfnRip_IF_KcCalls[EPMS_FN_RasterRequirements] = PMS_RasterRequirements;
   apfnRip_IF_KcCalls[EPMS_FN_RasterDestination] = PMS_RasterDestination;
+  apfnRip_IF_KcCalls[EPMS_FN_LeaseBuffer]       = PMS_LeaseBuffer;
+  apfnRip_IF_KcCalls[EPMS_FN_ReleaseBuffer]     = PMS_ReleaseBuffer;
   apfnRip_IF_KcCalls[EPMS_FN_RippingComplete]   = PMS_RippingComplete;
   apfnRip_IF_KcCalls[EPMS_FN_Malloc]            = PMS_Malloc;
   apfnRip_IF_KcCalls[EPMS_FN_Free]              = PMS_Free;
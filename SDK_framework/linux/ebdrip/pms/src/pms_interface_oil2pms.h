@@ -24,4 +24,5 @@ extern PMS_API_FNS PMS_InitAPI();
 
 extern int PMS_GetPaperInfo(PMS_ePaperSize ePaperSize, PMS_TyPaperInfo** ppPaperInfo);
 extern void FreePMSFramebuffer(void);
+extern void PMS_FreeBandRasters(PMS_TyPage *ptPMSPage);
 
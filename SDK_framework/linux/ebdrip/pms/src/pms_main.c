@@ -79,6 +79,7 @@ void *g_semPageComplete; /* Semaphore to syncronize submission of band packets f
 void *g_csPageList;      /* Critical section for thread-safe accessing of g_pstPageList */
 void *g_csMemoryUsage;   /* Critical section for thread-safe accessing of nValidBytes in sockets */
 void *g_csSocketInput;   /* Critical section for thread-safe accessing of l_tPMSMem */
+void *g_csBandRing;      /* Critical section for thread-safe accessing of the band buffer ring */
 int g_printPMSLog;
 
 unsigned int g_bDebugMemory;
@@ -301,6 +302,7 @@ static void InitGlobals(void)
   g_csMemoryUsage = PMS_CreateCriticalSection();
   g_csPageList = PMS_CreateCriticalSection();
   g_csSocketInput = PMS_CreateCriticalSection();
+  g_csBandRing = PMS_CreateCriticalSection();
 
   /* Create semaphore function uses OSMalloc, therefore must be done after Memory usage critical section is created */
   g_semCheckin = PMS_CreateSemaphore(0);
@@ -1353,10 +1355,12 @@ static void ParseCommandLine(void)
     g_bTaggedBackChannel = 0;
   }
 
-  /* Push direct methods rely on the gFrameBuffer memory, but only one buffer has been
+  /* Push direct frame relies on the gFrameBuffer memory, but only one buffer has been
      allocated, therefore rip ahead cannot work. Rip Ahead can only work if there
      are more than one frame buffer or band buffer - so that the rip can continue
      rendering whilst the pms take its time to print the previous bands/frames.
+     Push direct single leases a separate band buffer for every band from a ring
+     which grows as needed, so it works with rip ahead and multiple threads.
      Other band delivery methods use the page store in OIL (oil_page_handler.c).
      Consider allocating more buffers if rip ahead is required.
      \todo Remove this section when the generic 'Page Store' module is implemented. */
@@ -1366,17 +1370,6 @@ static void ParseCommandLine(void)
       g_tSystemInfo.uUseEngineSimulator = FALSE;
       g_tSystemInfo.uUseRIPAhead = FALSE;
     }
-    if((g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND_DIRECT_SINGLE)) {
-      PMS_SHOW_ERROR("Warning: 'Push Band Direct Single' does not work with 'Rip Ahead'. Switching to '-e bypass'.\n");
-      g_tSystemInfo.uUseEngineSimulator = FALSE;
-      g_tSystemInfo.uUseRIPAhead = FALSE;
-    }
-  }
-
-  if( g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND_DIRECT_SINGLE &&
-      g_tSystemInfo.nRendererThreads > 1 ) {
-    PMS_SHOW_ERROR("Warning: 'Push Band Direct Single' does not work with more than 1 thread. Switching to 'Push Band'.\n");
-    g_tSystemInfo.eBandDeliveryType = PMS_PUSH_BAND;
   }
 }
 
@@ -1486,6 +1479,7 @@ static void CleanUp()
 
   PMS_DestroyCriticalSection(g_csPageList);
   PMS_DestroyCriticalSection(g_csSocketInput);
+  PMS_DestroyCriticalSection(g_csBandRing);
   PMS_DestroyCriticalSection(g_csMemoryUsage);
 }
 
@@ -17,6 +17,7 @@
 
 #include "pms.h"
 #include "pms_page_handler.h"
+#include "pms_interface_oil2pms.h"
 #include "oil_entry.h"
 #include "pms_platform.h"
 #include "pms_malloc.h"
@@ -405,25 +406,13 @@ void PrintPage(PMS_TyPage * pstPageToPrint)
     }
 
     /* free the PMS memory allocated for the rasters in PMS page
-       In non-direct band delivery model, all the memory allocated for band rasters belong to PMS*/
+       In non-direct band delivery model, all the memory allocated for band rasters belong to PMS.
+       In direct single band delivery model, the band buffers go back to the band ring. */
     if((g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND) ||
        (g_tSystemInfo.eBandDeliveryType == PMS_PUSH_BAND_DIRECT_SINGLE) ||
        g_tSystemInfo.bScanlineInterleave)
     {
-      int i;
-      unsigned int j;
-      for(i=0; i < PMS_MAX_PLANES_COUNT; i++)
-      {
-        for(j=0; j < pstPageToPrint->atPlane[i].uBandTotal; j++)
-        {
-          if ( pstPageToPrint->atPlane[i].atBand[j].pBandRaster)
-          {
-            /* free the PMS memory allocated for each band of each plane */
-            OSFree(pstPageToPrint->atPlane[i].atBand[j].pBandRaster, PMS_MemoryPoolPMS);
-            pstPageToPrint->atPlane[i].atBand[j].pBandRaster = NULL;
-          }
-        }
-      }
+      PMS_FreeBandRasters(pstPageToPrint);
     }
     else
     {
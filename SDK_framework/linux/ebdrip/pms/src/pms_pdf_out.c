@@ -22,6 +22,7 @@
  * \li One PDF file per rasterized page.
  * \li Output direct to disk or via back channel.
  * \li Flate (zlib) compression, and no compression.
+ * \li Bands compressed concurrently on a pool of worker threads, and written in page order.
  *
  * Alternative compressions are allowed by the PDF specification but no examples have been provided within this SDK;
  *
@@ -45,6 +46,7 @@
 #include "pms.h"
 #include "pms_malloc.h"
 #include "pms_pdf_out.h"
+#include "pms_platform.h"
 #include "zlib.h"
 #include <string.h>
 
@@ -71,26 +73,67 @@ static void *zlib_alloc(void *opaque, uInt items, uInt size);
 /*! \brief Memory free function to be used by the zlib library. */
 static void zlib_free(void *opaque, void *address);
 
-/*! \brief Parameters for the PDF output module. */
-typedef struct tagPDFout_globals {
+/*! \brief The maximum number of worker threads compressing bands for a page. */
+#define PDF_MAX_STRIP_WORKERS 8
+
+/*! \brief The number of bands each worker may have compressed ahead of the band being written. */
+#define PDF_STRIP_WINDOW_PER_WORKER 2
+
+/*! \brief A band (strip) slot, pixel interleaved and compressed by a worker thread. */
+typedef struct tagPDFstrip {
   char *pRasterBuffer ;           /**< Pixel-interleaved raster data */
-  unsigned int cbRasterBuffer;    /**< Raster buffer size */
   char *pCompressBuffer ;         /**< Compressed raster data */
+  char *pWriteBuffer ;            /**< Data to write, either of the above */
+  unsigned int cbWrite;           /**< Number of bytes to write */
+  unsigned int cbBandSize;        /**< Number of uncompressed bytes */
+  unsigned long uAdler;           /**< Adler-32 of the uncompressed bytes */
+  unsigned int uChecksum;         /**< Checksum contribution of this band */
+  PMS_ePDF_Errors eResult;        /**< Result of compressing this band */
+  void *semReady;                 /**< Signalled when the band is ready to write */
+#ifndef NOCOMPRESS
+  struct z_stream_s zstate ;      /**< zlib context structure, reset for each band */
+  int fZInit;                     /**< zstate has been initialised */
+#endif
+}TPDFSTRIP;
+
+/*! \brief State shared between the PDF writer and its strip compression workers.
+
+    Bands are claimed in page order by the workers, and written in page order
+    by the PMS thread. A worker may not claim a band until a credit is available,
+    which limits the workers to uWindow bands ahead of the band being written,
+    so band \c n always uses slot \c n % uWindow.
+ */
+typedef struct tagPDFstrip_writer {
+  PMS_TyPage *ptPMSPage;          /**< Page being written */
+  unsigned int uBands;            /**< Number of bands in the page */
+  unsigned int uNextBand;         /**< Next band to be claimed by a worker */
+  unsigned int cbRasterBuffer;    /**< Raster buffer size */
   unsigned int cbCompressBuffer;  /**< Compression buffer size */
+  unsigned int uWindow;           /**< Number of slots in use */
+  void *csClaim;                  /**< Protects uNextBand */
+  void *semCredit;                /**< Counts the free slots */
+#ifdef COMPRESS_TEST
+  char *pTestCompressedFull;      /**< Copy of all the data written for the image */
+  char *pTestCompPos;             /**< End of the data in pTestCompressedFull */
+#endif
+  TPDFSTRIP atStrip[PDF_MAX_STRIP_WORKERS * PDF_STRIP_WINDOW_PER_WORKER];
+}TPDFSTRIP_WRITER;
 
+/*! \brief Parameters for the PDF output module. */
+typedef struct tagPDFout_globals {
   FILE * hFileOut;                /**< Output file handle */
   PMS_TyBackChannelWriteFileOut tWriteFileOut; /**< Backchannel output */
   unsigned int nobjects;          /**< Number of objects in PDF file */
   unsigned int filepos;           /**< Current file position */
   unsigned int offsets[MAXOBJ] ;  /**< Location of PDF objects */
-  struct z_stream_s zstate ;      /**< zlib context structure */
+  unsigned long cbImageStream;    /**< Number of bytes written for the image stream */
 #ifdef ADD_PDF_COMMENTS
   unsigned int uPageChecksum;     /**< Checksum for comments for regression testing */
 #endif
 }TPDFOUT_GLOBALS, *PTPDFOUT_GLOBALS;
 
 /*! PDF output module variables */
-TPDFOUT_GLOBALS gtPDFOut = { NULL, 0, NULL, 0, NULL };
+TPDFOUT_GLOBALS gtPDFOut = { NULL };
 
 /**
  * \brief Open PDF data stream output.
@@ -117,7 +160,6 @@ static int PDF_OpenOutput(const char *pszFilename)
  * \brief Close PDF data stream output.
  *
  * Close the PDF output file if writing direct to file.
- * Free raster buffer and compression buffer used.
  */
 static void PDF_CloseOutput()
 {
@@ -129,18 +171,6 @@ static void PDF_CloseOutput()
       gtPDFOut.hFileOut = NULL;
     }
   }
-
-  if(gtPDFOut.pRasterBuffer)
-  {
-    OSFree(gtPDFOut.pRasterBuffer, PMS_MemoryPoolPMS);
-    gtPDFOut.pRasterBuffer = NULL;
-  }
-
-  if(gtPDFOut.pCompressBuffer)
-  {
-    OSFree(gtPDFOut.pCompressBuffer, PMS_MemoryPoolPMS);
-    gtPDFOut.pCompressBuffer = NULL;
-  }
 }
 
 /**
@@ -464,8 +494,8 @@ static int PDF_WriteFileTrailer(PMS_TyPage *ptPMSPage)
 
   /* The second object is the length of the image stream plus one for the new line char. */
   length = sprintf(buffer,    "2 0 obj\n" /* Length of image */
-                              "%ld\n"
-                              "endobj\n", gtPDFOut.zstate.total_out + 1);
+                              "%lu\n"
+                              "endobj\n", gtPDFOut.cbImageStream + 1);
   if(PDF_WriteOutput(buffer, length) < length)
   {
     PMS_SHOW_ERROR("PDF_WriteFileTrailer: File IO failed.\n");
@@ -1398,329 +1428,534 @@ static unsigned int PDF_PixelInterleave(PMS_TyPage *ptPMSPage, int nBand, char *
 }
 
 /**
- * \brief The one and only function call to the PDF output method.
+ * \brief Pixel interleave and compress one band into its slot.
  *
- * \param ptPMSPage Pointer to PMS page structure that contains the complete page.
- * \return PMS_ePDF_Errors error code.
+ * Called on a worker thread. Each band is compressed as an independent raw
+ * deflate segment; every band but the last ends with a sync flush so that the
+ * segments can be concatenated, in page order, into a single zlib stream.
+ *
+ * \param ptWriter Pointer to the strip writer.
+ * \param uBand Band to compress.
  */
-int PDF_PageHandler( PMS_TyPage *ptPMSPage )
+static void PDF_CompressStrip(TPDFSTRIP_WRITER *ptWriter, unsigned int uBand)
 {
-  PMS_ePDF_Errors eResult = PDF_NoError;
-  unsigned int nBytesPerLine;
-  unsigned int uBytesToWrite;
-  unsigned int uBands;
-  unsigned int uBandHeight;
-  unsigned int uFirstColorant;
-  unsigned int cbBandSize;
-  unsigned int j;
-  char *pWriteBuf;
-  int nCopyNo;
-  int nWritten;
+  TPDFSTRIP *ptStrip = &ptWriter->atStrip[uBand % ptWriter->uWindow];
 #ifdef ADD_PDF_COMMENTS
   unsigned char *p;
 #endif
 #ifndef NOCOMPRESS
-  unsigned int uLastTotal;
   int nResult;
+  int fLast = (uBand + 1 == ptWriter->uBands);
 #endif
-#ifdef COMPRESS_TEST
-  char *pTestCompressedFull;
-  char *pTestCompPos;
-  char *pTestUncompressedFull;
-  char *pTestUncompPos;
-  struct z_stream_s zstateUncompress;
+
+  ptStrip->eResult = PDF_NoError;
+
+  /* pixel interleave */
+  ptStrip->cbBandSize = PDF_PixelInterleave(ptWriter->ptPMSPage, uBand, ptStrip->pRasterBuffer);
+  PMS_ASSERT(ptStrip->cbBandSize <= ptWriter->cbRasterBuffer, ("Band Height increased... RasterBuffer and Compress need to be reallocated.\n"));
+
+#ifdef ADD_PDF_COMMENTS
+  ptStrip->uChecksum = 0;
+  for(p = (unsigned char *)ptStrip->pRasterBuffer; p < ((unsigned char *)(ptStrip->pRasterBuffer + ptStrip->cbBandSize)); p++) {
+    ptStrip->uChecksum += *p;
+  }
 #endif
 
-  /* checks for features not supported */
-  if((ptPMSPage->uOutputDepth != 1)
-    && (ptPMSPage->uOutputDepth != 2)
-    && (ptPMSPage->uOutputDepth != 4)
-    && (ptPMSPage->uOutputDepth != 8)
-    && (ptPMSPage->uOutputDepth != 16))
+#ifndef NOCOMPRESS
+  ptStrip->uAdler = adler32(adler32(0L, Z_NULL, 0), (Bytef*)ptStrip->pRasterBuffer, ptStrip->cbBandSize);
+
+  /* compress */
+  if(deflateReset(&ptStrip->zstate) != Z_OK)
   {
-    PMS_SHOW_ERROR("%d bpp is not yet supported in PDF out.\n", ptPMSPage->uOutputDepth);
-    return FALSE;
+    ptStrip->eResult = PDF_Error_FileIO;
+    return;
   }
-  /* checks for features not supported */
-  if((ptPMSPage->uTotalPlanes == 3) && (ptPMSPage->uOutputDepth < 8))
+  ptStrip->zstate.avail_in = ptStrip->cbBandSize;
+  ptStrip->zstate.next_in = (Bytef*)ptStrip->pRasterBuffer;
+  ptStrip->zstate.avail_out = ptWriter->cbCompressBuffer;
+  ptStrip->zstate.next_out = (Bytef*)ptStrip->pCompressBuffer;
+
+  nResult = deflate(&ptStrip->zstate, fLast ? Z_FINISH : Z_SYNC_FLUSH);
+  if(ptStrip->zstate.avail_in != 0 || nResult != (fLast ? Z_STREAM_END : Z_OK))
   {
-    PMS_SHOW_ERROR("1, 2 and 4 bpp RGB is not yet supported in PDF out.\n");
-    return FALSE;
+    PMS_SHOW_ERROR("PDF_CompressStrip: Compression of band %u failed (%d), avail_in = %u, avail_out = %u.\n",
+      uBand, nResult, ptStrip->zstate.avail_in, ptStrip->zstate.avail_out);
+    ptStrip->eResult = PDF_Error_FileIO;
+    return;
   }
 
-   /* This assumes each colorant has the same number of bands. */
-  uBands = 0;
-  uBandHeight = 0;
-  uFirstColorant = 0;
-  for(j=0; j < PMS_MAX_PLANES_COUNT; j++)
+  ptStrip->pWriteBuffer = ptStrip->pCompressBuffer;
+  ptStrip->cbWrite = ptWriter->cbCompressBuffer - ptStrip->zstate.avail_out;
+#else
+  ptStrip->pWriteBuffer = ptStrip->pRasterBuffer;
+  ptStrip->cbWrite = ptStrip->cbBandSize;
+#endif
+}
+
+/**
+ * \brief Strip compression worker thread.
+ *
+ * Claims bands in page order until there are none left, compressing each one
+ * and signalling its slot. Before claiming a band the worker takes a credit, so
+ * it never overwrites a slot that has not yet been written.
+ *
+ * \param pArg Pointer to the strip writer.
+ */
+static void PDF_StripWorker(void *pArg)
+{
+  TPDFSTRIP_WRITER *ptWriter = (TPDFSTRIP_WRITER *)pArg;
+  unsigned int uBand;
+
+  for(;;)
   {
-    if(ptPMSPage->atPlane[j].uBandTotal > 0)
+    PMS_WaitOnSemaphore_Forever(ptWriter->semCredit);
+
+    PMS_EnterCriticalSection(ptWriter->csClaim);
+    uBand = ptWriter->uNextBand;
+    if(uBand < ptWriter->uBands)
+      ptWriter->uNextBand++;
+    PMS_LeaveCriticalSection(ptWriter->csClaim);
+
+    if(uBand >= ptWriter->uBands)
     {
-      uBands = ptPMSPage->atPlane[j].uBandTotal;
-      uBandHeight = ptPMSPage->atPlane[j].atBand[0].uBandHeight;
-      uFirstColorant = j;
+      /* Hand the credit on so that any other idle worker sees the end too. */
+      PMS_IncrementSemaphore(ptWriter->semCredit);
       break;
     }
+
+    PDF_CompressStrip(ptWriter, uBand);
+    PMS_IncrementSemaphore(ptWriter->atStrip[uBand % ptWriter->uWindow].semReady);
   }
-  if(uBandHeight==0)
+}
+
+/**
+ * \brief Free the slots, semaphores and compression state of the strip writer.
+ *
+ * Safe to call on a partially allocated strip writer.
+ *
+ * \param ptWriter Pointer to the strip writer.
+ */
+static void PDF_FreeStrips(TPDFSTRIP_WRITER *ptWriter)
+{
+  unsigned int i;
+
+  for(i = 0; i < ptWriter->uWindow; i++)
   {
-    PMS_SHOW_ERROR("PDF_PageHandler: Band height is zero.\n");
-    return PDF_Error_Memory;
+    TPDFSTRIP *ptStrip = &ptWriter->atStrip[i];
+
+#ifndef NOCOMPRESS
+    if(ptStrip->fZInit)
+    {
+      (void)deflateEnd(&ptStrip->zstate);
+      ptStrip->fZInit = FALSE;
+    }
+#endif
+    if(ptStrip->semReady)
+    {
+      PMS_DestroySemaphore(ptStrip->semReady);
+      ptStrip->semReady = NULL;
+    }
+    if(ptStrip->pRasterBuffer)
+    {
+      OSFree(ptStrip->pRasterBuffer, PMS_MemoryPoolPMS);
+      ptStrip->pRasterBuffer = NULL;
+    }
+    if(ptStrip->pCompressBuffer)
+    {
+      OSFree(ptStrip->pCompressBuffer, PMS_MemoryPoolPMS);
+      ptStrip->pCompressBuffer = NULL;
+    }
+  }
+
+  if(ptWriter->semCredit)
+  {
+    PMS_DestroySemaphore(ptWriter->semCredit);
+    ptWriter->semCredit = NULL;
+  }
+  if(ptWriter->csClaim)
+  {
+    PMS_DestroyCriticalSection(ptWriter->csClaim);
+    ptWriter->csClaim = NULL;
+  }
+#ifdef COMPRESS_TEST
+  if(ptWriter->pTestCompressedFull)
+  {
+    free(ptWriter->pTestCompressedFull);
+    ptWriter->pTestCompressedFull = NULL;
   }
+#endif
+}
 
-  /* dataWidth (bits per scanline including padding) is a multiple of 32, so divide by 8 to get bytes */
-  nBytesPerLine = (ptPMSPage->nRasterWidthBits >> 3);
+/**
+ * \brief Allocate the slots, semaphores and compression state of the strip writer.
+ *
+ * \param ptWriter Pointer to the strip writer, with uWindow and the buffer sizes set.
+ * \return PMS_ePDF_Errors error code.
+ */
+static PMS_ePDF_Errors PDF_AllocStrips(TPDFSTRIP_WRITER *ptWriter)
+{
+  unsigned int i;
 
-  /* Output several times. */
-  /* \todo Perf - just copy the file, we don't need to recreate the PDF every time */
-  for(nCopyNo = 1; nCopyNo <= ptPMSPage->nCopies; nCopyNo++)
+  ptWriter->csClaim = PMS_CreateCriticalSection();
+  ptWriter->semCredit = PMS_CreateSemaphore((int)ptWriter->uWindow);
+  if(!ptWriter->csClaim || !ptWriter->semCredit)
   {
-    /* Bytes per line needed to store pixel interleaved packed raster band.
-       Note: The amount of memory could be reduced for bit depths less than 8. */
-    gtPDFOut.cbRasterBuffer = ((ptPMSPage->nRasterWidthBits >> 3) * ptPMSPage->uTotalPlanes) * uBandHeight;
-
-    /* \todo Make the raster buffer persistent, and only reallocate if a larger one is needed */
-    /* \todo Even better - output bands of raster rather store the whole page (it shouldn't be too tricky to do) */
-    gtPDFOut.pRasterBuffer = (char *)OSMalloc(gtPDFOut.cbRasterBuffer,PMS_MemoryPoolPMS);
-    if(!gtPDFOut.pRasterBuffer)
+    PMS_SHOW_ERROR("PDF_PageHandler: Failed to create strip writer synchronisation objects.\n");
+    return PDF_Error_Memory;
+  }
+
+  for(i = 0; i < ptWriter->uWindow; i++)
+  {
+    TPDFSTRIP *ptStrip = &ptWriter->atStrip[i];
+
+    ptStrip->semReady = PMS_CreateSemaphore(0);
+    if(!ptStrip->semReady)
     {
-      PMS_SHOW_ERROR("PDF_PageHandler: Failed to allocate %d bytes of memory for packed raster line. WidthBits=%d, Planes=%d, BandHeight=%d\n",
-        gtPDFOut.cbRasterBuffer, ptPMSPage->nRasterWidthBits, ptPMSPage->uTotalPlanes, uBandHeight);
+      PMS_SHOW_ERROR("PDF_PageHandler: Failed to create strip semaphore.\n");
       return PDF_Error_Memory;
     }
 
-    /* Compression buffer size.
-       Note: zlib worst case expansion is an overhead of five bytes per 16KB (about 0.03%)
-             plus size bytes.
-       Allocate, band size + 1% + 32 bytes */
-    gtPDFOut.cbCompressBuffer = (((gtPDFOut.cbRasterBuffer * 100) / 99) + 32);
-    /* \todo Make the compression buffer persistent, and only reallocate if a larger one is needed */
-    gtPDFOut.pCompressBuffer = (char *)OSMalloc(gtPDFOut.cbCompressBuffer,PMS_MemoryPoolPMS);
-    if(!gtPDFOut.pCompressBuffer)
+    ptStrip->pRasterBuffer = (char *)OSMalloc(ptWriter->cbRasterBuffer,PMS_MemoryPoolPMS);
+    if(!ptStrip->pRasterBuffer)
     {
-      PMS_SHOW_ERROR("PDF_PageHandler: Failed to allocate %d bytes of memory for compression buffer\n",
-        gtPDFOut.cbCompressBuffer);
-      OSFree(gtPDFOut.pRasterBuffer, PMS_MemoryPoolPMS);
-      gtPDFOut.pRasterBuffer = NULL;
+      PMS_SHOW_ERROR("PDF_PageHandler: Failed to allocate %d bytes of memory for packed raster band.\n",
+        ptWriter->cbRasterBuffer);
       return PDF_Error_Memory;
     }
 
-    /* write pdf header */
-    eResult = PDF_WriteFileHeader(ptPMSPage);
-    if(eResult!=PDF_NoError)
+#ifndef NOCOMPRESS
+    ptStrip->pCompressBuffer = (char *)OSMalloc(ptWriter->cbCompressBuffer,PMS_MemoryPoolPMS);
+    if(!ptStrip->pCompressBuffer)
     {
-      PMS_SHOW_ERROR("PDF_PageHandler: Write header failed.\n");
-      eResult = PDF_Error_FileIO;
-      PDF_CloseOutput();
-      break;
+      PMS_SHOW_ERROR("PDF_PageHandler: Failed to allocate %d bytes of memory for compression buffer\n",
+        ptWriter->cbCompressBuffer);
+      return PDF_Error_Memory;
     }
 
-#ifndef NOCOMPRESS
-    /* initialise compressor */
-    gtPDFOut.zstate.zalloc = &zlib_alloc ;
-    gtPDFOut.zstate.zfree = &zlib_free ;
-    gtPDFOut.zstate.opaque = NULL ;
-
-    if ( deflateInit(&gtPDFOut.zstate, Z_BEST_SPEED) != Z_OK )
+    /* Raw deflate; the zlib header and Adler-32 trailer are written around
+       the concatenated bands by PDF_WriteStrips(). */
+    ptStrip->zstate.zalloc = &zlib_alloc ;
+    ptStrip->zstate.zfree = &zlib_free ;
+    ptStrip->zstate.opaque = NULL ;
+    if ( deflateInit2(&ptStrip->zstate, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS,
+                      8, Z_DEFAULT_STRATEGY) != Z_OK )
     {
       PMS_SHOW_ERROR("PDF_PageHandler: Compression failed.\n");
-      eResult = PDF_Error_FileIO;
-      PDF_CloseOutput();
-      break;
+      return PDF_Error_Memory;
     }
-    uLastTotal = 0;
+    ptStrip->fZInit = TRUE;
+#endif
+  }
+
+  return PDF_NoError;
+}
+
+/**
+ * \brief Write image data to the PDF output, and account for it in the file position.
+ *
+ * \param ptWriter Pointer to the strip writer.
+ * \param pBuffer Pointer to data to output.
+ * \param cbBuffer Number of bytes to output.
+ * \return PMS_ePDF_Errors error code.
+ */
+static PMS_ePDF_Errors PDF_WriteImageData(TPDFSTRIP_WRITER *ptWriter, char *pBuffer, unsigned int cbBuffer)
+{
+  int nWritten;
+
+  UNUSED_PARAM(TPDFSTRIP_WRITER *, ptWriter);
+
+  if(cbBuffer == 0)
+    return PDF_NoError;
+
+  nWritten = PDF_WriteOutput(pBuffer, (int)cbBuffer);
+  if(nWritten != (int)cbBuffer)
+  {
+    PMS_SHOW_ERROR("PDF_PageHandler: Write output failed.\n");
+    return PDF_Error_FileIO;
+  }
+  gtPDFOut.filepos += nWritten ;
+  gtPDFOut.cbImageStream += nWritten ;
 
 #ifdef COMPRESS_TEST
-    pTestCompressedFull = malloc((ptPMSPage->nRasterWidthBits/8) * ptPMSPage->nPageHeightPixels * 4);
-    pTestUncompressedFull = malloc((ptPMSPage->nRasterWidthBits/8) * ptPMSPage->nPageHeightPixels * 4);
-    pTestCompPos = pTestCompressedFull;
-    pTestUncompPos = pTestUncompressedFull;
-#endif
+  if(ptWriter->pTestCompressedFull)
+  {
+    memcpy(ptWriter->pTestCompPos, pBuffer, cbBuffer);
+    ptWriter->pTestCompPos += cbBuffer;
+  }
 #endif
 
-    for(j=0; j < uBands; j++)
+  return PDF_NoError;
+}
+
+#ifdef COMPRESS_TEST
+/**
+ * \brief Check that the image data written for the page inflates.
+ *
+ * \param ptWriter Pointer to the strip writer.
+ */
+static void PDF_CompressTest(TPDFSTRIP_WRITER *ptWriter)
+{
+  PMS_TyPage *ptPMSPage = ptWriter->ptPMSPage;
+  struct z_stream_s zstateUncompress;
+  char *pTestUncompressedFull;
+
+  if(!ptWriter->pTestCompressedFull)
+    return;
+
+  pTestUncompressedFull = malloc((ptPMSPage->nRasterWidthBits/8) * ptPMSPage->nPageHeightPixels * 4);
+  if(!pTestUncompressedFull)
+    return;
+
+  memset(&zstateUncompress, 0x00, sizeof(zstateUncompress));
+  zstateUncompress.zalloc = &zlib_alloc;
+  zstateUncompress.zfree = &zlib_free;
+  if ( inflateInit(&zstateUncompress) != Z_OK )
+  {
+    PMS_SHOW_ERROR("PDF_PageHandler: Test uncompress failed.\n");
+  }
+  else
+  {
+    zstateUncompress.avail_in = (uInt)(ptWriter->pTestCompPos - ptWriter->pTestCompressedFull);
+    zstateUncompress.avail_out = (ptPMSPage->nRasterWidthBits/8) * ptPMSPage->nPageHeightPixels * 4;
+    zstateUncompress.next_in = (Bytef *)ptWriter->pTestCompressedFull;
+    zstateUncompress.next_out = (Bytef *)pTestUncompressedFull;
+    if (inflate(&zstateUncompress, Z_FINISH) != Z_STREAM_END)
     {
-      /* If the band height increases then we need a larger buffer */
-      PMS_ASSERT(ptPMSPage->atPlane[uFirstColorant].atBand[j].uBandHeight <= uBandHeight, ("Band Height increased... RasterBuffer and Compress need to be reallocated.\n"));
+      PMS_SHOW_ERROR("PDF_PageHandler: inflate failed.\n");
+    }
+    else
+    {
+      PMS_SHOW("PDF_PageHandler: Compress test... inflate succeeded.\n");
+    }
 
-      /* pixel interleave */
-      cbBandSize = PDF_PixelInterleave(ptPMSPage, j, gtPDFOut.pRasterBuffer);
+    if (inflateEnd(&zstateUncompress) != Z_OK)
+    {
+      PMS_SHOW_ERROR("PDF_PageHandler: inflateEnd failed.\n");
+    }
+  }
 
-#ifdef ADD_PDF_COMMENTS
-      for(p = (unsigned char *)gtPDFOut.pRasterBuffer; p < ((unsigned char *)(gtPDFOut.pRasterBuffer + cbBandSize)); p++) {
-        gtPDFOut.uPageChecksum += *p;
-      }
+  free(pTestUncompressedFull);
+}
 #endif
 
+/**
+ * \brief Write the image data for the page, compressing bands on a pool of worker threads.
+ *
+ * One worker is started for each RIP renderer thread (up to PDF_MAX_STRIP_WORKERS).
+ * The workers pixel interleave and compress bands concurrently while this thread
+ * writes the completed bands out in page order. The flate stream written is a
+ * zlib header, the raw deflate segment of each band, and the Adler-32 checksum
+ * of the whole image combined from the per-band checksums.
+ *
+ * \param ptPMSPage Pointer to PMS page structure that contains the complete page.
+ * \param uBands Number of bands in the page.
+ * \param uBandHeight Height of the first (and tallest) band.
+ * \return PMS_ePDF_Errors error code.
+ */
+static PMS_ePDF_Errors PDF_WriteStrips(PMS_TyPage *ptPMSPage, unsigned int uBands, unsigned int uBandHeight)
+{
+  PMS_ePDF_Errors eResult = PDF_NoError;
+  TPDFSTRIP_WRITER tWriter;
+  void *apWorkers[PDF_MAX_STRIP_WORKERS];
+  unsigned int nWorkers, nStarted, j;
 #ifndef NOCOMPRESS
-      /* compress */
-      gtPDFOut.zstate.avail_in = cbBandSize;
-      gtPDFOut.zstate.next_in = (Bytef*)gtPDFOut.pRasterBuffer;
-      gtPDFOut.zstate.avail_out = gtPDFOut.cbCompressBuffer;
-      gtPDFOut.zstate.next_out = (Bytef*)gtPDFOut.pCompressBuffer;
-
-      /* flush compressor */
-      nResult = deflate(&gtPDFOut.zstate, Z_SYNC_FLUSH);
-      if(gtPDFOut.zstate.avail_in!=0)
-      {
-        PMS_SHOW_ERROR("*** ASSERT *** Raster data not entirely consumed by compressor... gtPDFOut.zstate\n" \
-               "  .avail_in = %u\n" \
-               "  .avail_out = %u\n" \
-               "  .total_in = %lu\n" \
-               "  .total_out = %lu\n" \
-               "  cbBandSize = %u\n",
-            gtPDFOut.zstate.avail_in,
-            gtPDFOut.zstate.avail_out,
-            gtPDFOut.zstate.total_in,
-            gtPDFOut.zstate.total_out,
-            cbBandSize
-          );
-      }
-      if ( nResult != Z_OK && nResult != Z_STREAM_END )
-      {
-        PMS_SHOW_ERROR("PDF_PageHandler: Compression no flush failed.\n");
-        eResult = PDF_Error_FileIO;
-        PDF_CloseOutput();
-        break;
-      }
-
-      uBytesToWrite = gtPDFOut.zstate.total_out - uLastTotal;
-#else
-      uBytesToWrite = cbBandSize;
+  static char zlibHeader[2] = { 0x78, 0x01 }; /* deflate, 32K window, fastest */
+  unsigned char adlerTrailer[4];
+  unsigned long uAdler = adler32(0L, Z_NULL, 0);
 #endif
 
-      if(uBytesToWrite)
-      {
+  memset(&tWriter, 0, sizeof(tWriter));
+  tWriter.ptPMSPage = ptPMSPage;
+  tWriter.uBands = uBands;
+  gtPDFOut.cbImageStream = 0;
+
+  nWorkers = (g_tSystemInfo.nRendererThreads > 0) ? (unsigned int)g_tSystemInfo.nRendererThreads : 1;
+  if(nWorkers > PDF_MAX_STRIP_WORKERS)
+    nWorkers = PDF_MAX_STRIP_WORKERS;
+  if(nWorkers > uBands)
+    nWorkers = uBands;
+  tWriter.uWindow = nWorkers * PDF_STRIP_WINDOW_PER_WORKER;
+
+  /* Bytes per line needed to store pixel interleaved packed raster band.
+     Note: The amount of memory could be reduced for bit depths less than 8. */
+  tWriter.cbRasterBuffer = ((ptPMSPage->nRasterWidthBits >> 3) * ptPMSPage->uTotalPlanes) * uBandHeight;
+
+  /* Compression buffer size.
+     Note: zlib worst case expansion is an overhead of five bytes per 16KB (about 0.03%)
+           plus size bytes.
+     Allocate, band size + 1% + 32 bytes */
+  tWriter.cbCompressBuffer = (((tWriter.cbRasterBuffer * 100) / 99) + 32);
+
+  eResult = PDF_AllocStrips(&tWriter);
+  if(eResult != PDF_NoError)
+  {
+    PDF_FreeStrips(&tWriter);
+    return eResult;
+  }
+
 #ifndef NOCOMPRESS
-        pWriteBuf = gtPDFOut.pCompressBuffer;
-        uLastTotal = gtPDFOut.zstate.total_out;
 #ifdef COMPRESS_TEST
-        memcpy(pTestCompPos, gtPDFOut.pCompressBuffer, uBytesToWrite);
-        pTestCompPos += uBytesToWrite;
+  tWriter.pTestCompressedFull = malloc((ptPMSPage->nRasterWidthBits/8) * ptPMSPage->nPageHeightPixels * 4);
+  tWriter.pTestCompPos = tWriter.pTestCompressedFull;
 #endif
-#else
-        pWriteBuf = gtPDFOut.pRasterBuffer;
+
+  eResult = PDF_WriteImageData(&tWriter, zlibHeader, sizeof(zlibHeader));
+  if(eResult != PDF_NoError)
+  {
+    PDF_FreeStrips(&tWriter);
+    return eResult;
+  }
 #endif
-        /* write */
-        nWritten = PDF_WriteOutput(pWriteBuf, uBytesToWrite);
-        if(nWritten!=(int)uBytesToWrite)
-        {
-          PMS_SHOW_ERROR("PDF_PageHandler: Write output failed.\n");
-          eResult = PDF_Error_FileIO;
-          PDF_CloseOutput();
-          deflateEnd(&gtPDFOut.zstate);
-          return eResult;
-        }
-        gtPDFOut.filepos += nWritten ;
-      }
-    }
 
+  for(nStarted = 0; nStarted < nWorkers; nStarted++)
+  {
+    apWorkers[nStarted] = PMS_BeginThread(&PDF_StripWorker, 0, &tWriter);
+    if(!apWorkers[nStarted])
+      break;
+  }
+  if(nStarted == 0)
+  {
+    PMS_SHOW_ERROR("PDF_PageHandler: Failed to start strip compression thread.\n");
+    PDF_FreeStrips(&tWriter);
+    return PDF_Error_Memory;
+  }
+
+  for(j=0; j < uBands; j++)
+  {
+    TPDFSTRIP *ptStrip = &tWriter.atStrip[j % tWriter.uWindow];
+
+    PMS_WaitOnSemaphore_Forever(ptStrip->semReady);
+
+    eResult = ptStrip->eResult;
+    if(eResult != PDF_NoError)
+      break;
+
+#ifdef ADD_PDF_COMMENTS
+    gtPDFOut.uPageChecksum += ptStrip->uChecksum;
+#endif
 #ifndef NOCOMPRESS
-    /* finish compressor */
-    if(uBands>0)
-    {
-      /* finish compression */
-      do {
-        gtPDFOut.zstate.avail_in = 0;
-        gtPDFOut.zstate.next_in = (Bytef*)NULL;
-        gtPDFOut.zstate.avail_out = gtPDFOut.cbCompressBuffer;
-        gtPDFOut.zstate.next_out = (Bytef*)gtPDFOut.pCompressBuffer;
-        nResult = deflate(&gtPDFOut.zstate, Z_FINISH) ;
-        if(gtPDFOut.zstate.avail_in!=0)
-        {
-          PMS_SHOW_ERROR("*** ASSERT *** Raster data not entirely consumed by compressor... Z_FINISH gtPDFOut.zstate\n" \
-                 "  .avail_in = %u\n" \
-                 "  .avail_out = %u\n" \
-                 "  .total_in = %lu\n" \
-                 "  .total_out = %lu\n",
-              gtPDFOut.zstate.avail_in,
-              gtPDFOut.zstate.avail_out,
-              gtPDFOut.zstate.total_in,
-              gtPDFOut.zstate.total_out
-            );
-        }
-        if ( nResult != Z_OK && nResult != Z_STREAM_END )
-        {
-          PMS_SHOW_ERROR("PDF_PageHandler: Compression finish failed.\n");
-        }
-        uBytesToWrite = gtPDFOut.zstate.total_out - uLastTotal;
+    uAdler = adler32_combine(uAdler, ptStrip->uAdler, (z_off_t)ptStrip->cbBandSize);
+#endif
 
-        if(uBytesToWrite)
-        {
-          uLastTotal = gtPDFOut.zstate.total_out;
-          nWritten = PDF_WriteOutput(gtPDFOut.pCompressBuffer, uBytesToWrite);
-          if(nWritten!=(int)uBytesToWrite)
-          {
-            eResult = PDF_Error_FileIO;
-            PDF_CloseOutput();
-            deflateEnd(&gtPDFOut.zstate);
-            return eResult;
-          }
-          gtPDFOut.filepos += nWritten;
+    eResult = PDF_WriteImageData(&tWriter, ptStrip->pWriteBuffer, ptStrip->cbWrite);
+    if(eResult != PDF_NoError)
+      break;
+
+    /* The slot is free for band j + uWindow. */
+    PMS_IncrementSemaphore(tWriter.semCredit);
+  }
+
+  if(j < uBands)
+  {
+    /* Stop the workers claiming any more bands. */
+    PMS_EnterCriticalSection(tWriter.csClaim);
+    tWriter.uNextBand = uBands;
+    PMS_LeaveCriticalSection(tWriter.csClaim);
+  }
+
+  /* Wake any worker waiting for a credit, so it can see there is no more work,
+     and wait for them all to exit. */
+  PMS_IncrementSemaphore(tWriter.semCredit);
+  while(nStarted > 0)
+  {
+    (void)PMS_CloseThread(apWorkers[--nStarted], -1);
+  }
+
+#ifndef NOCOMPRESS
+  if(eResult == PDF_NoError)
+  {
+    adlerTrailer[0] = (unsigned char)(uAdler >> 24);
+    adlerTrailer[1] = (unsigned char)(uAdler >> 16);
+    adlerTrailer[2] = (unsigned char)(uAdler >> 8);
+    adlerTrailer[3] = (unsigned char)uAdler;
+    eResult = PDF_WriteImageData(&tWriter, (char *)adlerTrailer, sizeof(adlerTrailer));
+  }
 #ifdef COMPRESS_TEST
-          memcpy(pTestCompPos, gtPDFOut.pCompressBuffer, uBytesToWrite);
-          pTestCompPos += uBytesToWrite;
+  if(eResult == PDF_NoError)
+    PDF_CompressTest(&tWriter);
 #endif
-        }
-      }while(nResult == Z_OK);
+#endif
+
+  PDF_FreeStrips(&tWriter);
+  return eResult;
+}
+
+/**
+ * \brief The one and only function call to the PDF output method.
+ *
+ * \param ptPMSPage Pointer to PMS page structure that contains the complete page.
+ * \return PMS_ePDF_Errors error code.
+ */
+int PDF_PageHandler( PMS_TyPage *ptPMSPage )
+{
+  PMS_ePDF_Errors eResult = PDF_NoError;
+  unsigned int uBands;
+  unsigned int uBandHeight;
+  unsigned int j;
+  int nCopyNo;
+
+  /* checks for features not supported */
+  if((ptPMSPage->uOutputDepth != 1)
+    && (ptPMSPage->uOutputDepth != 2)
+    && (ptPMSPage->uOutputDepth != 4)
+    && (ptPMSPage->uOutputDepth != 8)
+    && (ptPMSPage->uOutputDepth != 16))
+  {
+    PMS_SHOW_ERROR("%d bpp is not yet supported in PDF out.\n", ptPMSPage->uOutputDepth);
+    return FALSE;
+  }
+  /* checks for features not supported */
+  if((ptPMSPage->uTotalPlanes == 3) && (ptPMSPage->uOutputDepth < 8))
+  {
+    PMS_SHOW_ERROR("1, 2 and 4 bpp RGB is not yet supported in PDF out.\n");
+    return FALSE;
+  }
+
+   /* This assumes each colorant has the same number of bands. */
+  uBands = 0;
+  uBandHeight = 0;
+  for(j=0; j < PMS_MAX_PLANES_COUNT; j++)
+  {
+    if(ptPMSPage->atPlane[j].uBandTotal > 0)
+    {
+      uBands = ptPMSPage->atPlane[j].uBandTotal;
+      uBandHeight = ptPMSPage->atPlane[j].atBand[0].uBandHeight;
+      break;
     }
+  }
+  if(uBandHeight==0)
+  {
+    PMS_SHOW_ERROR("PDF_PageHandler: Band height is zero.\n");
+    return PDF_Error_Memory;
+  }
 
-    /* end deflate */
-    if ( deflateEnd(&gtPDFOut.zstate) != Z_OK )
+  /* Output several times. */
+  /* \todo Perf - just copy the file, we don't need to recreate the PDF every time */
+  for(nCopyNo = 1; nCopyNo <= ptPMSPage->nCopies; nCopyNo++)
+  {
+    /* write pdf header */
+    eResult = PDF_WriteFileHeader(ptPMSPage);
+    if(eResult!=PDF_NoError)
     {
-      PMS_SHOW_ERROR("PDF_PageHandler: Compression end failed.\n");
+      PMS_SHOW_ERROR("PDF_PageHandler: Write header failed.\n");
       eResult = PDF_Error_FileIO;
+      PDF_CloseOutput();
+      break;
+    }
+
+    /* compress and write the bands */
+    eResult = PDF_WriteStrips(ptPMSPage, uBands, uBandHeight);
+    if(eResult!=PDF_NoError)
+    {
       PDF_CloseOutput();
       return eResult;
     }
-#endif
 
     /* write pdf trailer */
     PDF_WriteFileTrailer(ptPMSPage);
 
     /* close */
     PDF_CloseOutput();
-
-#ifndef NOCOMPRESS
-#ifdef COMPRESS_TEST
-    memset(&zstateUncompress, 0x00, sizeof(zstateUncompress));
-    zstateUncompress.zalloc = &zlib_alloc;
-    zstateUncompress.zfree = &zlib_free;
-    if ( inflateInit(&zstateUncompress) != Z_OK )
-    {
-      PMS_SHOW_ERROR("PDF_PageHandler: Test uncompress failed.\n");
-      free(pTestCompressedFull);
-      pTestCompressedFull = NULL;
-      free(pTestUncompressedFull);
-      pTestUncompressedFull = NULL;
-    }
-    else
-    {
-      zstateUncompress.avail_in = (uInt)(pTestCompPos - pTestCompressedFull);
-      zstateUncompress.avail_out = (ptPMSPage->nRasterWidthBits/8) * ptPMSPage->nPageHeightPixels * 4;
-      zstateUncompress.next_in = (Bytef *)pTestCompressedFull;
-      zstateUncompress.next_out = (Bytef *)pTestUncompressedFull;
-      if (inflate(&zstateUncompress, Z_FINISH) != Z_STREAM_END)
-      {
-        PMS_SHOW_ERROR("PDF_PageHandler: inflate failed.\n");
-      }
-      else
-      {
-        PMS_SHOW("PDF_PageHandler: Compress test... inflate succeeded.\n");
-      }
-
-      if (inflateEnd(&zstateUncompress) != Z_OK)
-      {
-        PMS_SHOW_ERROR("PDF_PageHandler: inflateEnd failed.\n");
-      }
-
-      free(pTestCompressedFull);
-      pTestCompressedFull = NULL;
-      free(pTestUncompressedFull);
-      pTestUncompressedFull = NULL;
-    }
-#endif
-#endif
   }
 #ifdef DIRECTVIEWPDFTIFF
   if((eResult == PDF_NoError) && (g_tSystemInfo.eOutputType == PMS_PDF_VIEW) && (!g_bBackChannelPageOutput))
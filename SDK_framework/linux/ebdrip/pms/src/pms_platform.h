@@ -119,6 +119,14 @@ extern void * g_csSocketInput;
 */
 extern void * g_csMemoryUsage;
 
+/*! \brief Critical Section for thread-safe accessing of the PMS band buffer ring
+ * 
+ * PC/Windows
+ *
+ * Casted to void * for platform portability.
+*/
+extern void * g_csBandRing;
+
 
 
 #endif /* _PMS_PLATFORM_H_ */
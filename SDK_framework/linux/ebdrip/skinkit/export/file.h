@@ -227,6 +227,30 @@ extern int32 PKSeekFile(FileDesc* pDescriptor,  Hq32x2 * destination, int32 flag
  */
 extern int32 PKBytesFile(FileDesc* pDescriptor, Hq32x2 * bytes, int32 reason, int32 * pError );
 
+/**
+ * \brief Extend an open file to a given length and map all of it into
+ * memory for reading and writing.
+ *
+ * The file's disk space is allocated before it is mapped, so that later
+ * stores to the mapping cannot fail for lack of space. The mapping remains
+ * valid after the file is closed, until it is released with PKUnmapFile().
+ *
+ * \param pDescriptor The file descriptor, as returned from PKOpenFile().
+ * \param length The length of the file and the mapping, in bytes.
+ * \param pError A value which the function can set to one of the \c PKError values.
+ * \return The address of the mapping on success; \c NULL otherwise.
+ */
+extern uint8 * PKMapFile(FileDesc* pDescriptor, size_t length, int32 * pError );
+
+/**
+ * \brief Release a mapping made by PKMapFile().
+ * \param pBase The address returned by PKMapFile().
+ * \param length The length passed to PKMapFile().
+ * \param pError A value which the function can set to one of the \c PKError values.
+ * \return \c TRUE on success; \c FALSE otherwise.
+ */
+extern int32 PKUnmapFile(uint8 * pBase, size_t length, int32 * pError );
+
 /**
  * \brief Populate a structure with information about a file.
  *
@@ -70,5 +70,21 @@ int32 SwLePgbSetCallback(const char *paramname,
  */
 void SwLePgbUseFrameBuffer(int32 fFlag);
 
+/**
+ * \brief Keeps the partial paint band cache in a preallocated, memory-mapped
+ * file with a fixed slot for each band, so bands are flushed and read back
+ * without seeking. This needs a band cache device that can map files (the
+ * file system device can); otherwise the cache is streamed as usual.
+ *
+ * If the application has also called SwLePgbSetMultipleCopies(TRUE), pages
+ * with more than one copy are rendered once, and the pagebuffer device
+ * delivers the extra copies of single separation pages from the mapping.
+ * The raster callback then sees each copy as a separate page with a copy
+ * count of one, and must not modify the band data it is given.
+ *
+ * \param fFlag TRUE to use the mapped band cache. Default is FALSE.
+ */
+void SwLePgbUseMappedBandCache(int32 fFlag);
+
 
 #endif
@@ -1351,11 +1351,12 @@ static int32 RIPCALL fs_device_dismount( DEVICELIST *dev )
 
 /** \brief   The ioctl routine for the file system device type.
 
-   At the time of this writing, the only ioctl opcode is ..._ShortRead,
-   which is used to indicate that, although Harlequin RIP will ask for an
-   entire buffer's data in the read_file call, only a certain number of
-   bytes will be used: read-ahead won't help.  Other opcodes may be added
-   in the future.
+   The RIP's only ioctl opcode is ..._ShortRead, which is used to indicate
+   that, although Harlequin RIP will ask for an entire buffer's data in the
+   read_file call, only a certain number of bytes will be used: read-ahead
+   won't help.  The skin's own DeviceIOCtl_MapFile and DeviceIOCtl_UnmapFile
+   opcodes map a file into memory, so that the pagebuffer device can keep
+   its band cache in a mapped file.
 */
 
 static int32 RIPCALL fs_ioctl( DEVICELIST *dev,
@@ -1385,6 +1386,52 @@ static int32 RIPCALL fs_ioctl( DEVICELIST *dev,
 
     PKSignalSemaphore (pDeviceState->pSema);
   }
+  else if (opcode == DeviceIOCtl_MapFile)
+  {
+    FileDeviceState* pDeviceState = (FileDeviceState*) dev->private_data;
+    FileState* pFileState;
+    DEVICE_FILEMAP *pMap = (DEVICE_FILEMAP *) arg;
+
+    PKWaitOnSemaphore (pDeviceState->pSema);
+
+    pFileState = (FileState*) DEVICE_FILEDESCRIPTOR_TO_VOIDPTR (descriptor);
+    if (! pFileState || ! pMap)
+    {
+      nError = DeviceInvalidAccess;
+      result = -1;
+    }
+    else
+    {
+      int32 pkError;
+
+      pMap->base = PKMapFile(pFileState->pDescriptor, pMap->length, &pkError);
+      if ( pMap->base == NULL )
+      {
+        nError = KMapPlatformError(pkError);
+        result = -1;
+      }
+    }
+
+    PKSignalSemaphore (pDeviceState->pSema);
+  }
+  else if (opcode == DeviceIOCtl_UnmapFile)
+  {
+    DEVICE_FILEMAP *pMap = (DEVICE_FILEMAP *) arg;
+    int32 pkError;
+
+    if (! pMap || ! pMap->base)
+    {
+      nError = DeviceInvalidAccess;
+      result = -1;
+    }
+    else if ( ! PKUnmapFile(pMap->base, pMap->length, &pkError) )
+    {
+      nError = KMapPlatformError(pkError);
+      result = -1;
+    }
+    else
+      pMap->base = NULL;
+  }
   else if (opcode == DeviceIOCtl_PDFFilenameToPS)
   {
     /* DeviceIOCtl_PDFFilenameToPS converts a PDF file spec to a PS
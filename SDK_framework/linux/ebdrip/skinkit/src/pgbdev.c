@@ -273,6 +273,47 @@ typedef struct BandCache {
 } BandCache;
 
 
+/**
+ * \brief An entry in the slot table of a mapped band cache.
+ */
+typedef struct MappedBandSlot {
+  uint32 bandLength;  /**< Bytes stored in the slot, or NO_BAND_YET. */
+  uint32 flags;       /**< MAPPED_BAND_RAW if the band is not compressed. */
+  int32 y1;           /**< First line of a band retained for copies. */
+  int32 advance;      /**< Lines in a band retained for copies. */
+} MappedBandSlot;
+
+/**
+ * \brief A flag in MappedBandSlot to denote a band stored exactly as the
+ * RIP rendered it, rather than as the band cache stores it.
+ */
+#define MAPPED_BAND_RAW 1
+
+/**
+ * \brief A band cache held in a preallocated, memory-mapped file.
+ *
+ * The file starts with a table of nSlots MappedBandSlot entries, followed
+ * by nSlots fixed size slots each big enough for the largest band stored.
+ * Band \c b of separation \c s lives in slot <tt>s * numBands + b</tt>, so
+ * flushing and reading back bands only copies to and from the mapping;
+ * there is no index to maintain and the file never fragments.
+ */
+typedef struct MappedBandCache {
+  DEVICE_FILEMAP map;         /**< The mapping; base is NULL if not mapped. */
+  uint32 nSlots;              /**< Number of slots. */
+  size_t cbSlot;              /**< Size of each slot, in bytes. */
+  MappedBandSlot *pSlots;     /**< The slot table, at the start of the map. */
+  uint8 *pSlotData;           /**< The first slot. */
+} MappedBandCache;
+
+static MappedBandCache gMappedCache;
+
+/**
+ * \brief Alignment of the first slot in a mapped band cache.
+ */
+#define MAPPED_SLOT_ALIGN 64
+
+
 
 /**
  * \brief The PGBDescription structure contains a RasterDescription,
@@ -291,6 +332,8 @@ typedef struct {
   int32 n_frames_in_raster ;  /**< Number of frames per page */
   HqBool partial_painting;    /**< Is this a partial paint? */
   HqBool compositing;         /**< Is this a compositing paint? */
+  int32 replay_copies;        /**< Number of copies to deliver from the
+                                   mapped band cache, or 0 */
 } PGBDescription ;
 
 /**
@@ -368,6 +411,12 @@ static unsigned int guComponentsPerBand = 0;
  */
 static HqBool fUseFrameBuffer = FALSE;
 
+/**
+ * \brief Flag indicating whether to keep the band cache in a memory-mapped
+ * file. It is set by SwLePgbUseMappedBandCache.
+ */
+static HqBool fUseMappedBandCache = FALSE;
+
 #ifdef CHECKSUM
 
 /**
@@ -450,6 +499,11 @@ static HqBool getBand( PGBDescription *pPGB,
                        uint8 *pBuffer, uint32 *pExpectedLength );
 static HqBool initDiskCacheFileName( const char * pszLeafDiskCacheFileName );
 static HqBool updateDiskCache(void);
+static HqBool mapBandCache( uint32 nSlots, size_t cbSlot );
+static void unmapBandCache(void);
+static HqBool retainBandForCopies( PGBDescription *pPGB,
+                                   uint8 *pBuff, uint32 length );
+static HqBool replayCopies( PGBDescription *pPGB );
 
 static HqBool KInitializePGBDescription(PGBDescription * pgb,
                                        const char *filename);
@@ -1410,6 +1464,12 @@ void SwLePgbUseFrameBuffer( int32 fFlag )
   fUseFrameBuffer = fFlag;
 }
 
+
+void SwLePgbUseMappedBandCache( int32 fFlag )
+{
+  fUseMappedBandCache = fFlag;
+}
+
 /* ------------------------------------------------------------------------- */
 /* Timeline-end event handler. Used to detect end-of-job */
 static sw_event_result HQNCALL pgb_endjob(void *context, sw_event *event)
@@ -1430,6 +1490,8 @@ static sw_event_result HQNCALL pgb_endjob(void *context, sw_event *event)
     }
 #endif
     destroyBandMemory();
+    if ( gMappedCache.map.base != NULL )
+      deleteDiskCacheFile();
   }
   return SW_EVENT_CONTINUE;
 }
@@ -1637,6 +1699,11 @@ static DEVICE_FILEDESCRIPTOR RIPCALL pgb_open_file( DEVICELIST *dev ,
         /* Remove any existing cache file. */
         deleteDiskCacheFile();
         first_time = TRUE;
+        /* Try to map a slot for every band of every separation. If the
+           band cache device can't map files, the cache is streamed. */
+        if ( fUseMappedBandCache && !pgbinparams.PGBSysmem )
+          (void)mapBandCache(pBandCache->numSeparations * pBandCache->numBands,
+                             gg_compressBound(CAST_SIGNED_TO_UINT32(g_pgb->band_size)));
       } else {
         HQASSERT(pBandCache->numBands == (uint32)g_pgb->n_bands_in_page,
                  "Band cache number of bands mismatched");
@@ -1645,6 +1712,26 @@ static DEVICE_FILEDESCRIPTOR RIPCALL pgb_open_file( DEVICELIST *dev ,
       if ( pBandCache->separationIndex != g_pgb->rd.separation - 1 )
         initBandCache(g_pgb, first_time);
     }
+  } else if ( fUseMappedBandCache && pgboutparams.MultipleCopies &&
+              pgbinparams.NumCopies > 1 && !pgbinparams.PGBSysmem &&
+              !g_pgb->discard_data && !skin_has_framebuffer &&
+              !g_pgb->compositing && g_pgb->rd.nSeparations == 1 &&
+              (pBandCache == NULL || gMappedCache.map.base != NULL)
+#ifdef HAS_RLE
+              && !g_pgb->rd.runLength
+#endif
+              ) {
+    /* We told the RIP that we make copies, so it renders the page once.
+       Keep each band in the mapped cache as it is delivered, and deliver
+       the other copies from there when the page is closed. A partial
+       painted page's mapping already has a big enough slot for each band,
+       and each band is read back before it is overwritten. */
+    if ( initDiskCacheFileName((const char *)filename) &&
+         mapBandCache(CAST_SIGNED_TO_UINT32(g_pgb->n_bands_in_page),
+                      CAST_SIGNED_TO_UINT32(g_pgb->band_size)) ) {
+      g_pgb->replay_copies = pgbinparams.NumCopies;
+      g_pgb->rd.noCopies = 1;
+    }
   }
 
   if ( (pgb_tl = SwTimelineStart(SWTLT_PGB, SW_TL_REF_INVALID,
@@ -1775,7 +1862,11 @@ static int32 RIPCALL pgb_write_file( DEVICELIST *dev, DEVICE_FILEDESCRIPTOR desc
           return -1;
         }
     } else {
+      /* The band is retained before it is delivered, because the raster
+         callback may modify it in place (e.g. byte swapping it). */
       if ( pgb->seek_line != pgb->output_line ||
+           (pgb->replay_copies > 1 &&
+            !retainBandForCopies(pgb, buff, CAST_SIGNED_TO_UINT32(len))) ||
            !KCallRasterCallback(&pgb->rd, buff) ) {
         pgb_set_last_error( dev, DeviceIOError );
         return -1;
@@ -1845,6 +1936,20 @@ static int32 RIPCALL pgb_close_file( DEVICELIST *dev , DEVICE_FILEDESCRIPTOR des
       }
   }
 
+  if ( pgb->replay_copies > 1 ) {
+    HqBool fReplayed = replayCopies(pgb);
+
+    /* The RIP won't read this page back, so the mapping can go now. */
+    deleteDiskCacheFile();
+    if ( !fReplayed ) {
+      KFreePGBDescription(pgb);
+      (void)SwTimelineEnd(tl) ;
+      pgb_tl = SW_TL_REF_INVALID ;
+      pgb_set_last_error( dev, DeviceIOError );
+      return -1;
+    }
+  }
+
   if ( !pgb->partial_painting && ppMemPeak > 0 ) {
     static HqBool pgbdev_printmem = FALSE; /* patch in a debugger */
     if ( pgbdev_printmem )
@@ -3294,6 +3399,8 @@ static void deleteDiskCacheFile(void)
     }
     return;
   }
+  if ( gMappedCache.map.base != NULL )
+    unmapBandCache();
   if (pszDiskCacheFullFileName)
     (void) (*theIDeleteFile(KGetBandCacheDev())) (KGetBandCacheDev(), (uint8*)pszDiskCacheFullFileName);
 }
@@ -3325,7 +3432,7 @@ static int32 diskCacheFileExists(void)
 {
   struct STAT statusBuffer;
 
-  if ( pgbinparams.PGBSysmem ) {
+  if ( pgbinparams.PGBSysmem || gMappedCache.map.base != NULL ) {
     return TRUE;
   }
   HQASSERT(pszDiskCacheFullFileName != NULL, "No disk cache filename");
@@ -3546,6 +3653,34 @@ static HqBool updateDiskCache(void)
     return TRUE;
   }
 
+  if ( gMappedCache.map.base != NULL ) {
+    uint32 first;
+
+    HQASSERT(pBandCache->separationIndex >= 0, "No separation being cached");
+    first = (uint32)pBandCache->separationIndex * pBandCache->numBands;
+    HQASSERT(first + pBandCache->numBands <= gMappedCache.nSlots,
+             "Too few slots in mapped band cache");
+
+    for ( i = 0; i < pBandCache->numBands; i++ ) {
+      BandHolder *pBandHolder = &pBandCache->pBands[i];
+
+      if ( pBandHolder->pData != BAND_SLOT_EVACUATED &&
+           pBandHolder->pData != BAND_NOT_PRESENT_IN_TABLE ) {
+        MappedBandSlot *pSlot = &gMappedCache.pSlots[first + i];
+
+        HQASSERT(pBandHolder->bandLength <= gMappedCache.cbSlot,
+                 "Band too big for mapped band cache slot");
+        HqMemCpy(gMappedCache.pSlotData + (first + i) * gMappedCache.cbSlot,
+                 pBandHolder->pData, pBandHolder->bandLength);
+        pSlot->bandLength = pBandHolder->bandLength;
+        pSlot->flags = 0;
+        pBandHolder->pData = BAND_SLOT_EVACUATED;
+      }
+    }
+    pBandCache->totalMemoryCacheSize = 0;
+    return TRUE;
+  }
+
   /* Consider the current position in file to be the byte _after_
      where we will write the band location index, in a new file; or
      else at the end of an existing file.  The currentPosition
@@ -3934,13 +4069,36 @@ static HqBool readBytesFromDiskCache( uint8 *pBuffer, int32 length )
  * \param[in] bandIndex The index number of the band for which to get
  * information.
  *
+ * \param[out] pfRaw Set to TRUE if the band is stored exactly as rendered,
+ * even though band compression is on.
+ *
  * \return TRUE on success; FALSE otherwise.
  */
-static HqBool getBandFromDiskCache( BandHolder *pBandHolder, uint32 bandIndex )
+static HqBool getBandFromDiskCache( BandHolder *pBandHolder, uint32 bandIndex,
+                                    HqBool *pfRaw )
 {
   int32 bandLength = 0;
   HqBool fResult = FALSE;
 
+  *pfRaw = FALSE;
+
+  if ( gMappedCache.map.base != NULL ) {
+    MappedBandSlot *pSlot;
+
+    HQASSERT(bandIndex < gMappedCache.nSlots,
+             "Band index outside mapped band cache");
+    pSlot = &gMappedCache.pSlots[bandIndex];
+    if ( pSlot->bandLength == NO_BAND_YET ) {
+      pBandHolder->pData = NULL;
+    } else {
+      /* Decompress or copy straight from the mapping. */
+      pBandHolder->pData = gMappedCache.pSlotData + bandIndex * gMappedCache.cbSlot;
+      pBandHolder->bandLength = pSlot->bandLength;
+      *pfRaw = (pSlot->flags & MAPPED_BAND_RAW) != 0;
+    }
+    return TRUE;
+  }
+
   if ( pgbinparams.PGBSysmem ) {
     BandHolder *bh = &pBandCache->pBands[bandIndex];
     if ( bh->dc_in_mem ) {
@@ -4005,6 +4163,7 @@ static HqBool getBand( PGBDescription *pPGB,
   BandHolder bandHolder = { NULL, 0 };
   BandHolder * pBandHolder;
   HqBool fResult = FALSE;
+  HqBool fRaw = FALSE;
 
   /* Calculate bandIndex using pBandCache->numBands for the read back.
      Separation omission between render passes means the number of bands may
@@ -4025,7 +4184,7 @@ static HqBool getBand( PGBDescription *pPGB,
       if ( diskCacheFileExists() )
       {
         pBandHolder = &bandHolder;
-        if ( ! getBandFromDiskCache( pBandHolder, bandIndex ) )
+        if ( ! getBandFromDiskCache( pBandHolder, bandIndex, &fRaw ) )
           goto end;
       }
       else
@@ -4041,7 +4200,7 @@ static HqBool getBand( PGBDescription *pPGB,
   else
   { /* Band is not from the cached separation */
     pBandHolder = &bandHolder;
-    if ( ! getBandFromDiskCache( pBandHolder, bandIndex ) )
+    if ( ! getBandFromDiskCache( pBandHolder, bandIndex, &fRaw ) )
       goto end;
   }
 
@@ -4054,7 +4213,7 @@ static HqBool getBand( PGBDescription *pPGB,
     return TRUE;
   }
 
-  if ( pgbinparams.fAllowBandCompression ) {
+  if ( pgbinparams.fAllowBandCompression && !fRaw ) {
     /* Decompress the band data. */
     int32 uncompressResult = gg_uncompress( pBuff, pExpectedLength,
                                             pBandHolder->pData, pBandHolder->bandLength );
@@ -4092,6 +4251,159 @@ static HqBool getBand( PGBDescription *pPGB,
 }
 
 
+/**
+ * \brief Map a band cache file with at least the given number and size of
+ * slots, if the band cache device can map files. An existing mapping is
+ * used if it is big enough, and is never replaced.
+ *
+ * \param[in] nSlots The number of slots needed.
+ *
+ * \param[in] cbSlot The size of the largest band to be stored.
+ *
+ * \return TRUE if the mapped band cache can be used; FALSE otherwise.
+ */
+static HqBool mapBandCache( uint32 nSlots, size_t cbSlot )
+{
+  DEVICELIST *dev = KGetBandCacheDev();
+  DEVICE_FILEDESCRIPTOR fd;
+  DEVICE_FILEMAP map;
+  size_t cbTable;
+
+  /* An existing mapping holds bands the RIP has yet to read back. */
+  if ( gMappedCache.map.base != NULL )
+    return nSlots <= gMappedCache.nSlots && cbSlot <= gMappedCache.cbSlot;
+
+  if ( nSlots == 0 || cbSlot == 0 || pszDiskCacheFullFileName == NULL ||
+       theIIoctl(dev) == NULL )
+    return FALSE;
+
+  cbSlot = (cbSlot + 7) & ~(size_t)7;
+  cbTable = nSlots * sizeof(MappedBandSlot);
+  cbTable = (cbTable + MAPPED_SLOT_ALIGN - 1) & ~(size_t)(MAPPED_SLOT_ALIGN - 1);
+
+  fd = (*theIOpenFile(dev))(dev, (uint8*)pszDiskCacheFullFileName,
+                            SW_RDWR | SW_CREAT | SW_TRUNC);
+  if ( fd == BAND_CACHE_FD_UNSET )
+    return FALSE;
+
+  /* Devices that don't recognise the opcode leave the base unset. A new
+     file is zero filled, so every slot starts out empty. */
+  map.length = cbTable + nSlots * cbSlot;
+  map.base = NULL;
+  if ( (*theIIoctl(dev))(dev, fd, DeviceIOCtl_MapFile, (intptr_t)&map) != 0 )
+    map.base = NULL;
+  (void)(*theICloseFile(dev))(dev, fd);
+
+  if ( map.base == NULL ) {
+    (void)(*theIDeleteFile(dev))(dev, (uint8*)pszDiskCacheFullFileName);
+    return FALSE;
+  }
+
+  gMappedCache.map = map;
+  gMappedCache.nSlots = nSlots;
+  gMappedCache.cbSlot = cbSlot;
+  gMappedCache.pSlots = (MappedBandSlot *)map.base;
+  gMappedCache.pSlotData = map.base + cbTable;
+  return TRUE;
+}
+
+
+/**
+ * \brief Release the mapped band cache, if there is one. The file is
+ * deleted by deleteDiskCacheFile.
+ */
+static void unmapBandCache(void)
+{
+  DEVICELIST *dev;
+
+  if ( gMappedCache.map.base == NULL )
+    return;
+
+  dev = KGetBandCacheDev();
+  (void)(*theIIoctl(dev))(dev, BAND_CACHE_FD_UNSET, DeviceIOCtl_UnmapFile,
+                          (intptr_t)&gMappedCache.map);
+  HqMemZero(&gMappedCache, sizeof(gMappedCache));
+}
+
+
+/**
+ * \brief Keep a copy of a band delivered on the final paint in the mapped
+ * band cache, so that replayCopies can deliver it again.
+ *
+ * \param[in] pPGB The PGB descriptor whose seek band is stored.
+ *
+ * \param[in] pBuff The band, as it will be delivered to the raster callback.
+ *
+ * \param[in] length The number of bytes in the band.
+ *
+ * \return TRUE on success; FALSE otherwise.
+ */
+static HqBool retainBandForCopies( PGBDescription *pPGB,
+                                   uint8 *pBuff, uint32 length )
+{
+  MappedBandSlot *pSlot;
+  uint32 slot = CAST_SIGNED_TO_UINT32(pPGB->seek_band);
+
+  if ( gMappedCache.map.base == NULL || slot >= gMappedCache.nSlots ||
+       length > gMappedCache.cbSlot )
+    return FALSE;
+
+  HqMemCpy(gMappedCache.pSlotData + slot * gMappedCache.cbSlot, pBuff, length);
+  pSlot = &gMappedCache.pSlots[slot];
+  pSlot->bandLength = length;
+  pSlot->flags = MAPPED_BAND_RAW;
+  pSlot->y1 = pPGB->rd.band.y1;
+  pSlot->advance = pPGB->rd.band.advance;
+  return TRUE;
+}
+
+
+/**
+ * \brief Deliver the second and subsequent copies of a page to the raster
+ * callback straight from the mapped band cache. Each copy is delivered as
+ * if the RIP had rendered it again, so the backend sees every copy as a
+ * page with a copy count of one. The raster callback may modify the band
+ * data it is given, so each band is delivered from a copy of its slot.
+ *
+ * \param[in] pPGB The PGB descriptor for the final paint of the page.
+ *
+ * \return TRUE on success; FALSE otherwise.
+ */
+static HqBool replayCopies( PGBDescription *pPGB )
+{
+  int32 copy;
+  uint32 slot;
+  uint8 *pBand;
+  HqBool fOK = TRUE;
+
+  HQASSERT(gMappedCache.map.base != NULL, "No mapped band cache to replay");
+
+  pBand = (uint8 *) MemAlloc( gMappedCache.cbSlot, FALSE, FALSE );
+  if ( pBand == NULL )
+    return FALSE;
+
+  for ( copy = 1; fOK && copy < pPGB->replay_copies; copy++ ) {
+    for ( slot = 0; fOK && slot < (uint32)pPGB->n_bands_in_page; slot++ ) {
+      MappedBandSlot *pSlot = &gMappedCache.pSlots[slot];
+
+      /* Bands the RIP didn't deliver weren't delivered the first time. */
+      if ( (pSlot->flags & MAPPED_BAND_RAW) == 0 )
+        continue;
+
+      HqMemCpy(pBand, gMappedCache.pSlotData + slot * gMappedCache.cbSlot,
+               pSlot->bandLength);
+      pPGB->rd.band.y1 = pSlot->y1;
+      pPGB->rd.band.advance = pSlot->advance;
+      pPGB->rd.band.y2 = pSlot->y1 + pSlot->advance - 1;
+      fOK = KCallRasterCallback(&pPGB->rd, pBand);
+    }
+  }
+
+  MemFree( pBand );
+  return fOK;
+}
+
+
 void init_C_globals_pgbdev(void)
 {
   static PageBufferInParameters pgbinparams_save ;
@@ -4108,6 +4420,7 @@ void init_C_globals_pgbdev(void)
   }
 
   HqMemZero(&gBandMemory, sizeof(gBandMemory));
+  HqMemZero(&gMappedCache, sizeof(gMappedCache));
   bandCacheFD = BAND_CACHE_FD_UNSET;
   pszDiskCacheFullFileName = NULL;
   pBandCache = NULL;
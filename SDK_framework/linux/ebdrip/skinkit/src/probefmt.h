@@ -0,0 +1,58 @@
+/* Copyright (C) 2014 Global Graphics Software Ltd. All Rights Reserved.
+ *
+ * $HopeName: SWskinkit!src:probefmt.h(EBDSDK_P.1) $
+ *
+ * Binary probe log format
+ *
+ * This example is provided on an "as is" basis and without
+ * warranty of any kind. Global Graphics Software Ltd. does not
+ * warrant or make any representations regarding the use or results
+ * of use of this example.
+ */
+
+/**
+ * @file
+ * @brief Layout of binary probe logs.
+ *
+ * This header is shared by the probe log writer and the stand-alone
+ * probejson converter, so it only uses plain C types.
+ *
+ * A binary log starts with a header:
+ *
+ *   PROBELOG_MAGIC          (PROBELOG_MAGIC_BYTES bytes)
+ *   version                 (4 bytes)
+ *   record size             (4 bytes, PROBELOG_RECORD_BYTES)
+ *   ticks per second        (8 bytes)
+ *   number of trace names   (4 bytes)
+ *   number of type names    (4 bytes)
+ *
+ * followed by the trace names then the trace type names, each as a 2 byte
+ * length and the characters of the name without a terminator. Unused
+ * names have zero length. The rest of the log is a sequence of fixed size
+ * records:
+ *
+ *   timestamp               (8 bytes, in ticks)
+ *   designator              (8 bytes, sign extended)
+ *   thread number           (4 bytes, in order of each thread's first probe)
+ *   trace id                (2 bytes)
+ *   trace type              (2 bytes)
+ *
+ * All numbers are stored least significant byte first. Records are merged
+ * into timestamp order each time the write-behind thread runs, but may be
+ * slightly out of order between runs.
+ */
+
+#ifndef __PROBEFMT_H__
+#define __PROBEFMT_H__
+
+#define PROBELOG_MAGIC        "SWPROBE\n"
+#define PROBELOG_MAGIC_BYTES  8
+#define PROBELOG_VERSION      1
+
+/** Size of the fixed part of the header. */
+#define PROBELOG_HEADER_BYTES (PROBELOG_MAGIC_BYTES + 4 + 4 + 8 + 4 + 4)
+
+/** Size of each record. */
+#define PROBELOG_RECORD_BYTES 24
+
+#endif /* __PROBEFMT_H__ */
@@ -0,0 +1,221 @@
+/* Copyright (C) 2014 Global Graphics Software Ltd. All Rights Reserved.
+ *
+ * $HopeName: SWskinkit!src:probejson.c(EBDSDK_P.1) $
+ *
+ * Binary probe log converter
+ *
+ * This example is provided on an "as is" basis and without
+ * warranty of any kind. Global Graphics Software Ltd. does not
+ * warrant or make any representations regarding the use or results
+ * of use of this example.
+ */
+
+/**
+ * @file
+ * @brief Convert a binary probe log to Chrome trace JSON.
+ *
+ * This is a stand-alone program, built with just
+ *
+ *   cc -o probejson probejson.c
+ *
+ * and run as
+ *
+ *   probejson probe.log [trace.json]
+ *
+ * The output can be loaded into chrome://tracing or any viewer that reads
+ * the Trace Event format. ENTER and EXIT probes become duration events on
+ * the thread that logged them, AMOUNT and ADD probes become counters, and
+ * MARK and VALUE probes become instant events. Other probe types are not
+ * converted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "probefmt.h"
+
+/** Read a little-endian number of up to 8 bytes. */
+static unsigned long long load(const unsigned char *bytes, int length)
+{
+  unsigned long long value = 0 ;
+
+  while ( --length >= 0 )
+    value = (value << 8) | bytes[length] ;
+
+  return value ;
+}
+
+/** Read a counted name from the log header. */
+static char *read_name(FILE *in)
+{
+  unsigned char prefix[2] ;
+  size_t length ;
+  char *name ;
+
+  if ( fread(prefix, 1, 2, in) != 2 )
+    return NULL ;
+
+  length = (size_t)load(prefix, 2) ;
+  if ( (name = malloc(length + 1)) == NULL )
+    return NULL ;
+
+  if ( fread(name, 1, length, in) != length ) {
+    free(name) ;
+    return NULL ;
+  }
+  name[length] = '\0' ;
+
+  return name ;
+}
+
+/** Write a string as a JSON string. */
+static void write_string(FILE *out, const char *string)
+{
+  fputc('"', out) ;
+  for ( ; *string != '\0' ; ++string ) {
+    unsigned char c = (unsigned char)*string ;
+    if ( c == '"' || c == '\\' )
+      fprintf(out, "\\%c", c) ;
+    else if ( c < 0x20 )
+      fprintf(out, "\\u%04x", c) ;
+    else
+      fputc(c, out) ;
+  }
+  fputc('"', out) ;
+}
+
+int main(int argc, char *argv[])
+{
+  FILE *in, *out = stdout ;
+  unsigned char header[PROBELOG_HEADER_BYTES] ;
+  unsigned char *record ;
+  unsigned long version, record_bytes, ntraces, ntypes, i ;
+  unsigned long long ticks_per_second ;
+  char **names ;
+  long long *totals ;
+  const char *separator = "\n" ;
+  int result = EXIT_SUCCESS ;
+
+  if ( argc < 2 || argc > 3 ) {
+    fprintf(stderr, "Usage: %s probe.log [trace.json]\n", argv[0]) ;
+    return EXIT_FAILURE ;
+  }
+
+  if ( (in = fopen(argv[1], "rb")) == NULL ) {
+    fprintf(stderr, "%s: Cannot open %s\n", argv[0], argv[1]) ;
+    return EXIT_FAILURE ;
+  }
+
+  if ( fread(header, 1, sizeof(header), in) != sizeof(header) ||
+       memcmp(header, PROBELOG_MAGIC, PROBELOG_MAGIC_BYTES) != 0 ) {
+    fprintf(stderr, "%s: %s is not a binary probe log\n", argv[0], argv[1]) ;
+    return EXIT_FAILURE ;
+  }
+
+  version = (unsigned long)load(header + PROBELOG_MAGIC_BYTES, 4) ;
+  record_bytes = (unsigned long)load(header + PROBELOG_MAGIC_BYTES + 4, 4) ;
+  ticks_per_second = load(header + PROBELOG_MAGIC_BYTES + 8, 8) ;
+  ntraces = (unsigned long)load(header + PROBELOG_MAGIC_BYTES + 16, 4) ;
+  ntypes = (unsigned long)load(header + PROBELOG_MAGIC_BYTES + 20, 4) ;
+
+  /* Later versions may only add fields to the end of records. */
+  if ( version != PROBELOG_VERSION || record_bytes < PROBELOG_RECORD_BYTES ||
+       ticks_per_second == 0 || ntraces > 0xffff || ntypes > 0xffff ) {
+    fprintf(stderr, "%s: Unsupported probe log version %lu\n", argv[0],
+            version) ;
+    return EXIT_FAILURE ;
+  }
+
+  names = calloc(ntraces + ntypes, sizeof(char *)) ;
+  totals = calloc(ntraces + 1, sizeof(long long)) ;
+  record = malloc(record_bytes) ;
+  if ( names == NULL || totals == NULL || record == NULL ) {
+    fprintf(stderr, "%s: Out of memory\n", argv[0]) ;
+    return EXIT_FAILURE ;
+  }
+
+  for ( i = 0 ; i < ntraces + ntypes ; ++i ) {
+    if ( (names[i] = read_name(in)) == NULL ) {
+      fprintf(stderr, "%s: Probe log header is truncated\n", argv[0]) ;
+      return EXIT_FAILURE ;
+    }
+  }
+
+  if ( argc == 3 && (out = fopen(argv[2], "w")) == NULL ) {
+    fprintf(stderr, "%s: Cannot open %s\n", argv[0], argv[2]) ;
+    return EXIT_FAILURE ;
+  }
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") ;
+
+  while ( fread(record, 1, record_bytes, in) == record_bytes ) {
+    unsigned long long timestamp = load(record, 8) ;
+    long long designator = (long long)load(record + 8, 8) ;
+    unsigned long thread = (unsigned long)load(record + 16, 4) ;
+    unsigned long trace_id = (unsigned long)load(record + 20, 2) ;
+    unsigned long trace_type = (unsigned long)load(record + 22, 2) ;
+    const char *type, *phase ;
+    double micros ;
+
+    if ( trace_id >= ntraces || trace_type >= ntypes ||
+         names[trace_id][0] == '\0' ) {
+      fprintf(stderr, "%s: Bad probe id %lu type %lu\n", argv[0],
+              trace_id, trace_type) ;
+      result = EXIT_FAILURE ;
+      continue ;
+    }
+
+    type = names[ntraces + trace_type] ;
+    if ( strcmp(type, "ENTER") == 0 )
+      phase = "B" ;
+    else if ( strcmp(type, "EXIT") == 0 )
+      phase = "E" ;
+    else if ( strcmp(type, "AMOUNT") == 0 ) {
+      phase = "C" ;
+      totals[trace_id] = designator ;
+    } else if ( strcmp(type, "ADD") == 0 ) {
+      phase = "C" ;
+      totals[trace_id] += designator ;
+    } else if ( strcmp(type, "MARK") == 0 || strcmp(type, "VALUE") == 0 )
+      phase = "i" ;
+    else
+      continue ;
+
+    micros = (double)timestamp * 1000000.0 / (double)ticks_per_second ;
+
+    fprintf(out, "%s{\"name\":", separator) ;
+    write_string(out, names[trace_id]) ;
+    fprintf(out, ",\"cat\":\"probe\",\"ph\":\"%s\",\"ts\":%.3f,"
+            "\"pid\":1,\"tid\":%lu", phase, micros, thread) ;
+    if ( phase[0] == 'C' )
+      fprintf(out, ",\"args\":{\"value\":%lld}", totals[trace_id]) ;
+    else if ( phase[0] == 'i' )
+      fprintf(out, ",\"s\":\"t\",\"args\":{\"value\":%lld}", designator) ;
+    else
+      fprintf(out, ",\"args\":{\"designator\":\"%llx\"}",
+              (unsigned long long)designator) ;
+    fputc('}', out) ;
+    separator = ",\n" ;
+  }
+
+  fprintf(out, "\n]}\n") ;
+
+  if ( ferror(in) ) {
+    fprintf(stderr, "%s: Error reading %s\n", argv[0], argv[1]) ;
+    result = EXIT_FAILURE ;
+  }
+  if ( out != stdout && fclose(out) != 0 ) {
+    fprintf(stderr, "%s: Error writing %s\n", argv[0], argv[2]) ;
+    result = EXIT_FAILURE ;
+  }
+  (void)fclose(in) ;
+
+  for ( i = 0 ; i < ntraces + ntypes ; ++i )
+    free(names[i]) ;
+  free(names) ;
+  free(totals) ;
+  free(record) ;
+
+  return result ;
+}
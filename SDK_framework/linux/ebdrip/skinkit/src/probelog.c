@@ -83,6 +83,9 @@ char g_szProbeLog[260];
 /** @brief Probe logging command line arg
   * For usage display purposes only. */
 char g_szProbeArg[8];
+/** @brief Write the probe log in the binary format of probefmt.h, rather
+  * than as text. */
+int g_bProbeBinary = FALSE;
 
 /****************************************************************************/
 
@@ -192,6 +195,12 @@ HqBool KProbeOption(const char *arg)
     return TRUE ;
   }
 
+  /* Handle "binary" (or "-binary") to select the log format. */
+  if ( strcmp(arg, "binary") == 0 ) {
+    g_bProbeBinary = enable ;
+    return TRUE ;
+  }
+
   /* Handle "ALL" group specially, to get all probes enabled. */
   if ( strcmp(arg, "all") == 0 ) {
     for ( i = SW_TRACE_INVALID ; ++i < g_nTraceNames ; )
@@ -269,6 +278,8 @@ void SwLeProbeOptionUsage(void)
     "\t%s\tEnable timing probe. Timing information is logged to a textfile\n"
     "\t\tcalled \"%s\", which can be processed to extract detailed\n"
     "\t\tinformation about what the RIP is doing.\n"
+    "\t\tbinary\tWrite a compact binary log instead of text, which\n"
+    "\t\t\tcan be converted to Chrome trace JSON with probejson.\n"
     "\t\tProbes are usually enabled using these group names:\n"
     "\t\tall\tAll probes (use carefully, this may affect performance)\n",
     g_szProbeArg, g_szProbeLog );
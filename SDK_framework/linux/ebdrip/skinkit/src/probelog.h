@@ -35,4 +35,5 @@ extern const char **g_ppTraceTypeNames;
 extern int g_nTraceTypeNames;
 extern char g_szProbeLog[260];
 extern char g_szProbeArg[8];
+extern int g_bProbeBinary;
 
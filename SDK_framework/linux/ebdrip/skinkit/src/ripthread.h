@@ -76,6 +76,24 @@
 #define IOCTL_COMPRESSION_OFF 0
 #define IOCTL_COMPRESSION_ON 1
 
+/**
+ * \brief IOCTL opcodes for mapping an open file into memory. The argument
+ * is a pointer to a \c DEVICE_FILEMAP. DeviceIOCtl_MapFile extends the file
+ * to \c length bytes and sets \c base to the address of the mapping, which
+ * remains valid after the file is closed. DeviceIOCtl_UnmapFile releases the
+ * mapping described by the argument; the descriptor is not used. The file
+ * system device implements these opcodes; callers must check that \c base
+ * was set, because other devices ignore opcodes they do not recognise.
+ */
+#define DeviceIOCtl_MapFile ( OEM_NUMBER | 3 )
+#define DeviceIOCtl_UnmapFile ( OEM_NUMBER | 4 )
+
+/** \brief Argument for DeviceIOCtl_MapFile and DeviceIOCtl_UnmapFile. */
+typedef struct DEVICE_FILEMAP {
+  size_t length ; /**< Length of the file and its mapping, in bytes. */
+  uint8 *base ;   /**< Address of the mapping. */
+} DEVICE_FILEMAP ;
+
 /*
    OS_DEVICE_TYPE is predefined in swdevice.h
 
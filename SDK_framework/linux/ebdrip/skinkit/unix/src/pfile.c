@@ -34,6 +34,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <glob.h>
 
@@ -49,6 +50,8 @@
 #define LSEEKFN lseek64
 #define OPENFN open64
 #define STATFN stat64
+#define FALLOCATEFN posix_fallocate64
+#define FTRUNCATEFN ftruncate64
 #else
 /* The normal types and APIs are 64-bit capable so just use them,
  * or there are no 64-bit APIs.
@@ -59,6 +62,8 @@
 #define LSEEKFN lseek
 #define OPENFN open
 #define STATFN stat
+#define FALLOCATEFN posix_fallocate
+#define FTRUNCATEFN ftruncate
 #endif
 
 
@@ -396,6 +401,66 @@ int32 PKBytesFile(FileDesc* pDescriptor, Hq32x2 * bytes, int32 reason,
 }
 
 
+uint8 * PKMapFile(FileDesc* pDescriptor, size_t length, int32 * pError)
+{
+  OFF_T extent = (OFF_T)length;
+  void *base;
+  int rv;
+
+  HQASSERT(pDescriptor != NULL, "No file descriptor");
+  HQASSERT(length > 0, "Mapping nothing");
+
+  if ( extent < 0 || (size_t)extent != length )
+  {
+    *pError = PKErrorNumericRange;
+    return NULL;
+  }
+
+  /* Allocate the blocks now. A sparse file would be quicker to create, but
+     running out of disk space when a page of the mapping is first touched
+     raises SIGBUS rather than returning an error. Filesystems that cannot
+     allocate ahead fall back to setting the size. */
+  while ( (rv = FALLOCATEFN(pDescriptor->fd, 0, extent)) == EINTR )
+    /*NOSTATEMENT*/;
+  if ( rv == EINVAL || rv == EOPNOTSUPP )
+    rv = FTRUNCATEFN(pDescriptor->fd, extent) == 0 ? 0 : errno;
+  if ( rv != 0 )
+  {
+    PKRecordSystemError(rv, __LINE__, __FILE__, TRUE);
+    *pError = map_errno(rv);
+    return NULL;
+  }
+
+  base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+              pDescriptor->fd, 0);
+  if ( base == MAP_FAILED )
+  {
+    int32 errcode = errno ;
+    PKRecordSystemError(errcode, __LINE__, __FILE__, TRUE);
+    *pError = map_errno(errcode);
+    return NULL;
+  }
+
+  return (uint8 *)base;
+}
+
+
+int32 PKUnmapFile(uint8 * pBase, size_t length, int32 * pError)
+{
+  HQASSERT(pBase != NULL, "No mapping");
+
+  if ( munmap(pBase, length) != 0 )
+  {
+    int32 errcode = errno ;
+    PKRecordSystemError(errcode, __LINE__, __FILE__, TRUE);
+    *pError = map_errno(errcode);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+
 int32 PKStatusFile(uint8 * filename, STAT * statbuff, int32 * pError)
 {
   STATSTRUCT status;
@@ -21,6 +21,21 @@
  * threaded Windows builds explicitly load the pthreads DLL during RIP
  * initialisation; the logging API may be called by the skin before the RIP
  * is initialised.)
+ *
+ * Each thread that logs a probe gets its own ring of entries, which only
+ * that thread adds to and only the write-behind thread removes from. Adding
+ * an entry needs no lock, so enabling fine-grained probes does not serialise
+ * the RIP threads on the probe handler. The trace lock is only taken the
+ * first time a thread logs a probe, to add its ring to the list of rings.
+ * If a ring is full when a probe arrives, the probe is counted as lost and
+ * the count is logged when there is space again.
+ *
+ * The write-behind thread polls the rings, and is woken early when a ring
+ * passes half full. It merges the entries from all of the rings into
+ * timestamp order, and writes them either as text lines, or in the binary
+ * format described in probefmt.h if the "binary" probe option was given.
+ * Binary logs are much smaller and quicker to write, and can be converted
+ * to Chrome trace JSON by the probejson tool.
  */
 
 #define _POSIX_C_SOURCE 200112L
@@ -45,6 +60,7 @@
 #include "std.h"
 #include "swtrace.h"
 #include "probelog.h"
+#include "probefmt.h"
 
 #ifdef GPROF_BUILD
 void moncontrol(int) ; /* This prototype is missing from some glibc versions */
@@ -59,38 +75,88 @@ typedef unsigned long long timestamp_t ;
 typedef clock_t timestamp_t ;
 #endif
 
-/** A single entry in the memory resident log. */
+/** A single entry in the memory resident log. The thread that logged the
+    entry is recorded by the ring it is in. */
 typedef struct {
   timestamp_t timestamp ;
-  pthread_t thread_id ;
   int trace_id ;
   int trace_type ;
   intptr_t trace_designator ;
 } tracelog_entry ;
 
-/** Collect tracelog entries into approximately 64k chunks, so the malloc
-    of the chunk is quick. */
-#define ENTRIES_PER_CHUNK (65536 / sizeof(tracelog_entry))
-
-/** A chunk of entries in the memory resident log, to avoid having to malloc and write out each entry individually. */
-typedef struct tracelog_chunk {
-  tracelog_entry entries[ENTRIES_PER_CHUNK] ;
-  unsigned long nentries ;
-  struct tracelog_chunk *next ;
-} tracelog_chunk ;
+/** Number of entries in each thread's ring. This must be a power of two. */
+#define ENTRIES_PER_RING 8192
+
+/** The write-behind thread is woken as soon as a ring is this full, rather
+    than waiting for it to poll. */
+#define RING_WAKE_ENTRIES (ENTRIES_PER_RING / 2)
+
+/** The most entries a single probe adds to its ring: a count of lost
+    entries, the probe itself, and a pair of entries for wasted time. */
+#define ENTRIES_PER_PROBE 4
+
+/** Interval between polls of the rings by the write-behind thread, in
+    milliseconds. */
+#define WRITE_BEHIND_POLL_MS 100
+
+/** Separation between ring fields written by different threads, so they
+    do not share a cache line. */
+#define CACHE_LINE_BYTES 64
+
+/** Entry for a running count in a ring. */
+#define RING_ENTRY(ring_, count_) \
+  (&(ring_)->entries[(count_) & (ENTRIES_PER_RING - 1)])
+
+/** A ring of log entries for one thread. The head and tail are running
+    counts of the entries added and removed, so the ring is full when they
+    differ by ENTRIES_PER_RING. */
+typedef struct tracelog_ring {
+  /* Written only by the thread that owns the ring. */
+  unsigned long head ;          /**< Number of entries published. */
+  intptr_t entries_lost ;       /**< Probes dropped since the last report. */
+  timestamp_t wasted_time ;     /**< Probe handling time not yet logged. */
+  char owner_pad[CACHE_LINE_BYTES] ;
+
+  /* Written only by the write-behind thread. */
+  unsigned long tail ;          /**< Number of entries written out. */
+  unsigned long drain_end ;     /**< Head when the current merge started. */
+  char writer_pad[CACHE_LINE_BYTES] ;
+
+  pthread_t thread_id ;         /**< Thread that owns the ring. */
+  unsigned int thread_number ;  /**< Order of thread's first probe. */
+  int retired ;                 /**< Owning thread has exited. */
+  struct tracelog_ring *next ;  /**< Next ring, protected by trace_lock. */
+
+  tracelog_entry entries[ENTRIES_PER_RING] ;
+} tracelog_ring ;
+
+/* Ring counts are published by a release store and read with an acquire
+   load, so the entries they cover are visible to the reader. */
+#if defined(__ATOMIC_ACQUIRE)
+#define RING_LOAD(ptr_) __atomic_load_n((ptr_), __ATOMIC_ACQUIRE)
+#define RING_STORE(ptr_, val_) __atomic_store_n((ptr_), (val_), __ATOMIC_RELEASE)
+#else
+#define RING_LOAD(ptr_) __sync_fetch_and_add((ptr_), 0)
+#define RING_STORE(ptr_, val_) MACRO_START \
+  __sync_synchronize() ; \
+  *(ptr_) = (val_) ; \
+MACRO_END
+#endif
 
-static unsigned long entry_index = 0 ;
 static intptr_t entries_lost = 0 ;
 static int trace_capture = FALSE ;
 static int trace_quit = FALSE ;
-static int done_timebase = FALSE ;
+static int writer_done = FALSE ;
+static unsigned long flush_requests = 0 ;
+static unsigned long flushes_done = 0 ;
 
-static tracelog_chunk *current = NULL ;
-static tracelog_chunk *savelist = NULL ;
-static tracelog_chunk **savelist_end = &savelist ;
-static tracelog_chunk *freelist = NULL ;
+static tracelog_ring *rings = NULL ;
+static unsigned int thread_count = 0 ;
+static pthread_key_t ring_key ;
 
 static FILE *tracelog_file = NULL ;
+static int log_started = FALSE ;
+static int log_binary = FALSE ;
 static pthread_t wb_thread ;
 static pthread_cond_t wb_ready ;
 static pthread_cond_t wb_flushed ;
@@ -100,14 +166,15 @@ static int probe_ready = FALSE ;
 
 static SwWriteProbeLogFn *pfnWriteProbeLog;
 
+/** Output buffer for the write-behind thread. */
+static char log_buffer[65536] ;
+static size_t log_buffered = 0 ;
+
 /** \brief Write-behind thread function. */
 static void *probe_write_log(void *param) ;
 
-static tracelog_entry *probe_slot(timestamp_t now,
-                                  pthread_t thread,
-                                  int trace_id,
-                                  int trace_type,
-                                  intptr_t trace_designator) ;
+/** \brief Thread exit handler for a thread's ring. */
+static void probe_ring_retire(void *value) ;
 
 /** \brief Return values for \c probe_write_log. */
 enum {
@@ -122,7 +189,6 @@ static timestamp_t (*timestamp_now_fn)(void) = NULL ;
 static timestamp_t ticks_per_second ;
 static timestamp_t start_time ;
 static timestamp_t wasted_delta ;
-static timestamp_t wasted_time ;
 
 /* Time functions to catch non-Linux and non-MacOS X platforms, or
    when the time functions fail on Linux and MacOS X.
@@ -197,15 +263,15 @@ void PKProbeLogInit(SwWriteProbeLogFn *pfnWriteLog)
 
   trace_capture = FALSE ;
   trace_quit = FALSE ;
-  done_timebase = FALSE ;
-  entry_index = 0 ;
+  writer_done = FALSE ;
+  flush_requests = 0 ;
+  flushes_done = 0 ;
   entries_lost = 0 ;
-  wasted_time = 0 ;
-  current = NULL ;
-  savelist = NULL ;
-  savelist_end = &savelist ;
-  freelist = NULL ;
+  rings = NULL ;
+  thread_count = 0 ;
   tracelog_file = NULL ;
+  log_started = FALSE ;
+  log_buffered = 0 ;
   probe_ready = FALSE ;
   pfnWriteProbeLog = pfnWriteLog;
 
@@ -218,9 +284,12 @@ void PKProbeLogInit(SwWriteProbeLogFn *pfnWriteLog)
   if ( pthread_cond_init(&wb_flushed, NULL) != 0 )
     goto cond_destroy ;
 
-  if ( pthread_attr_init(&attr) != 0 )
+  if ( pthread_key_create(&ring_key, probe_ring_retire) != 0 )
     goto flush_destroy ;
 
+  if ( pthread_attr_init(&attr) != 0 )
+    goto key_destroy ;
+
   if ( pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE) != 0 )
     goto attr_destroy ;
 
@@ -275,6 +344,8 @@ void PKProbeLogInit(SwWriteProbeLogFn *pfnWriteLog)
 
  attr_destroy:
   (void)pthread_attr_destroy(&attr) ;
+ key_destroy:
+  (void)pthread_key_delete(ring_key) ;
  flush_destroy:
   (void)pthread_cond_destroy(&wb_flushed) ;
  cond_destroy:
@@ -292,44 +363,9 @@ void PKProbeLogFinish(void)
       /* Prevent any new probes from being logged. */
       trace_capture = FALSE ;
 
-      if ( wasted_time > 0 ) {
-        timestamp_t handled_at = (*timestamp_fn)() ;
-        pthread_t thread = pthread_self() ;
-        tracelog_entry *pbegin, *pend ;
-        if ( (pbegin = probe_slot(handled_at - wasted_time, thread,
-                                  SW_TRACE_PROBE, SW_TRACETYPE_ENTER,
-                                  0)) == NULL ) {
-          entries_lost += 2 ;
-        } else if ( (pend = probe_slot(handled_at, thread, SW_TRACE_PROBE,
-                                       SW_TRACETYPE_EXIT, 0)) == NULL ) {
-          /* Can't get second probe slot to record wasted time. We may
-             have wasted time trying to get the slot, so account for the
-             possible malloc() delay. We also need to fill in the
-             allocated probe slot with a no-op, our best bet is a probe
-             add with 1 extra lost entry. */
-          pbegin->trace_type = SW_TRACETYPE_ADD ;
-          pbegin->trace_designator = entries_lost + 1 ;
-          entries_lost = 0 ;
-        }
-      }
-
-      if ( entries_lost > 0 ) {
-        timestamp_t handled_at = (*timestamp_fn)() ;
-        pthread_t thread = pthread_self() ;
-        if ( probe_slot(handled_at, thread, SW_TRACE_PROBE,
-                        SW_TRACETYPE_ADD, entries_lost) != NULL )
-          entries_lost = 0 ;
-      }
-
-      /* Add the last block to the write-behind list. */
-      if ( current ) {
-        *savelist_end = current ;
-        savelist_end = &current->next ;
-        current = NULL ;
-      }
-
       /* Indicate to the write-behind thread that it should quit when it's
-         finished writing. */
+         finished writing. It reports any lost entries and wasted time left
+         in the rings. */
       trace_quit = TRUE ;
 
       /* Signal write-behind thread to do its work and then quit. */
@@ -344,21 +380,17 @@ void PKProbeLogFinish(void)
 
     probe_ready = FALSE ;
 
-  /* Ensure that the savelist is freed; the write-behind thread should have
-     done that, but there is a possibility that it didn't get to initialise
-     properly. */
+    /* Threads that are still running must not retire their rings after
+       they have been freed. */
+    (void)pthread_key_delete(ring_key) ;
+
 #define return DO_NOT_RETURN - IN_CRITICAL_SECTION
     if ( pthread_mutex_lock(&trace_lock) == 0 ) {
-      tracelog_chunk *chunk ;
-
-      while ( (chunk = savelist) != NULL ) {
-        savelist = chunk->next ;
-        free(chunk) ;
-      }
+      tracelog_ring *ring ;
 
-      while ( (chunk = freelist) != NULL ) {
-        freelist = chunk->next ;
-        free(chunk) ;
+      while ( (ring = rings) != NULL ) {
+        rings = ring->next ;
+        free(ring) ;
       }
 
       (void)pthread_mutex_unlock(&trace_lock) ;
@@ -372,93 +404,67 @@ void PKProbeLogFinish(void)
   }
 }
 
-static tracelog_entry *probe_slot(timestamp_t now,
-                                  pthread_t thread,
-                                  int trace_id,
-                                  int trace_type,
-                                  intptr_t trace_designator)
+/** Create the ring for the calling thread, and add it to the list of rings
+    for the write-behind thread. */
+static tracelog_ring *probe_ring_create(void)
 {
-  tracelog_entry *entry = NULL ;
-
-  if ( current == NULL ) {
-    /* This is the first entry in a chunk; we need to lazily allocate a chunk
-       for it. */
-    if ( (current = freelist) != NULL ) {
-      freelist = freelist->next ;
-      current->next = NULL ;
-      current->nentries = 0 ;
-    } else if ( (current = malloc(sizeof(tracelog_chunk))) != NULL ) {
-      current->next = NULL ;
-      current->nentries = 0 ;
-    } else { /* Can't capture this event. */
-      return NULL ;
+  tracelog_ring *ring = NULL ;
+
+#define return DO_NOT_RETURN - IN_CRITICAL_SECTION
+  if ( pthread_mutex_lock(&trace_lock) == 0 ) {
+    if ( trace_capture ) {
+      if ( (ring = malloc(sizeof(tracelog_ring))) != NULL ) {
+        ring->head = 0 ;
+        ring->entries_lost = 0 ;
+        ring->wasted_time = 0 ;
+        ring->tail = 0 ;
+        ring->drain_end = 0 ;
+        ring->thread_id = pthread_self() ;
+        ring->retired = FALSE ;
+
+        if ( pthread_setspecific(ring_key, ring) == 0 ) {
+          ring->thread_number = thread_count++ ;
+          ring->next = rings ;
+          rings = ring ;
+        } else {
+          free(ring) ;
+          ring = NULL ;
+        }
+      }
+
+      if ( ring == NULL ) /* Can't capture this event. */
+        ++entries_lost ;
     }
-    entry_index = 0 ;
+    (void)pthread_mutex_unlock(&trace_lock) ;
   }
+#undef return
 
-  if ( current != NULL ) {
-    entry = &current->entries[entry_index++] ;
-
-    if ( !done_timebase ) {
-      done_timebase = TRUE ;
-
-      /* Add the timebase into the log, high 32 bits first. This is only done
-         the first time we allocate a chunk, so there should be space for the
-         two entries. */
-      HQASSERT(entry_index < ENTRIES_PER_CHUNK,
-               "Not enough space for timebase entry") ;
-      entry->timestamp = now ;
-      entry->thread_id = thread ;
-      entry->trace_id = SW_TRACE_PROBE ;
-      entry->trace_type = SW_TRACETYPE_MARK ;
-      entry->trace_designator = (intptr_t)((ticks_per_second >> 16) >> 16) ;
-      entry = &current->entries[entry_index++] ;
-      HQASSERT(entry_index < ENTRIES_PER_CHUNK,
-               "Not enough space for timebase entry") ;
-      entry->timestamp = now ;
-      entry->thread_id = thread ;
-      entry->trace_id = SW_TRACE_PROBE ;
-      entry->trace_type = SW_TRACETYPE_MARK ;
-      entry->trace_designator = (intptr_t)(ticks_per_second & 0xffffffffu) ;
-      entry = &current->entries[entry_index++] ;
-    }
+  return ring ;
+}
 
-    if ( entries_lost != 0 ) {
-      /* We should only enter this case on the first time after a malloc
-         succeeded, so there should be space for a "lost entry" trace and
-         the trace we were called to do.  */
-      HQASSERT(entry_index < ENTRIES_PER_CHUNK,
-               "Not enough space for lost trace entry") ;
-      entry->timestamp = now ;
-      entry->thread_id = thread ;
-      entry->trace_id = SW_TRACE_PROBE ;
-      entry->trace_type = SW_TRACETYPE_ADD ;
-      entry->trace_designator = entries_lost ;
+/** The owning thread of a ring has exited. The write-behind thread frees
+    the ring when it has written out all of its entries. */
+static void probe_ring_retire(void *value)
+{
+  tracelog_ring *ring = value ;
 
-      entries_lost = 0 ;
-      entry = &current->entries[entry_index++] ;
-    }
+  RING_STORE(&ring->retired, TRUE) ;
+}
 
-    entry->timestamp = now ;
-    entry->thread_id = thread ;
-    entry->trace_id = trace_id ;
-    entry->trace_type = trace_type ;
-    entry->trace_designator = trace_designator ;
-    current->nentries = entry_index ;
-
-    if ( entry_index == ENTRIES_PER_CHUNK ) {
-      /* We've filled up that chunk. Add it to the savelist, clear the
-         current block. */
-      *savelist_end = current ;
-      savelist_end = &current->next ;
-      current = NULL ;
-
-      /* Signal write-behind thread to do its work. This won't actually get
-         scheduled until we're out of the critical section, which will be
-         after this entry is filled in by the caller. */
-      (void)pthread_cond_signal(&wb_ready) ;
-    }
-  }
+/** Fill in the entry for a running count in a ring. */
+static tracelog_entry *probe_fill(tracelog_ring *ring,
+                                  unsigned long count,
+                                  timestamp_t now,
+                                  int trace_id,
+                                  int trace_type,
+                                  intptr_t trace_designator)
+{
+  tracelog_entry *entry = RING_ENTRY(ring, count) ;
+
+  entry->timestamp = now ;
+  entry->trace_id = trace_id ;
+  entry->trace_type = trace_type ;
+  entry->trace_designator = trace_designator ;
 
   return entry ;
 }
@@ -491,81 +497,296 @@ void RIPFASTCALL PKProbeLog(int trace_id,
     return ;
   }
 
-  /* We'll check trace_capture both outside the mutex (as a fast test so we
-     don't have to take the mutex), and again inside (to verify we're not
-     shutting down the probe system). */
   if ( trace_capture ) {
     timestamp_t now = (*timestamp_fn)();
-    pthread_t thread = pthread_self() ;
+    tracelog_ring *ring = pthread_getspecific(ring_key) ;
+    tracelog_entry *entry ;
+    unsigned long start, head, used ;
+    timestamp_t handled_at, wasted_self ;
+
+    if ( ring == NULL && (ring = probe_ring_create()) == NULL )
+      return ;
+
+    /* Only this thread moves the head, so it can be read directly. The
+       tail may be moved by the write-behind thread at any time, but only
+       ever makes more space. */
+    start = head = ring->head ;
+    used = head - RING_LOAD(&ring->tail) ;
+    if ( used > ENTRIES_PER_RING - ENTRIES_PER_PROBE ) {
+      /* The write-behind thread hasn't kept up; we can't capture this
+         event. */
+      ++ring->entries_lost ;
+      return ;
+    }
 
-    /* Check how long the process of logging this event took, especially if we
-       had to wait for an event or the critical section lock. So long as the
-       timer returns a reasonable multiple of the processor cycles, we should
-       see zero cycles most of the time. */
-    if ( pthread_mutex_lock(&trace_lock) == 0 ) {
-      if ( trace_capture ) {
-        tracelog_entry *entry ;
-        if ( (entry = probe_slot(now, thread, trace_id, trace_type,
-                                 trace_designator)) != NULL ) {
-          timestamp_t handled_at = (*timestamp_fn)() ;
-          timestamp_t wasted_self = handled_at - now ;
-          wasted_time += wasted_self ;
-          if ( wasted_time >= wasted_delta ) {
-            /* Retrospectively account for wasted time */
-            tracelog_entry *pbegin, *pend ;
-            if ( (pbegin = probe_slot(handled_at - wasted_time, thread,
-                                      SW_TRACE_PROBE, SW_TRACETYPE_ENTER,
-                                      (intptr_t)wasted_self)) == NULL ) {
-              /* Can't get first probe slot to record wasted time. We may
-                 have wasted time trying to get the slot, so account for the
-                 possible malloc() delay. We'll note that we couldn't get the
-                 probes, even though we will account correctly for the wasted
-                 time at a later point. */
-              entries_lost += 2 ;
-              wasted_time += (*timestamp_fn)() - handled_at ;
-            } else if ( (pend = probe_slot(handled_at, thread, SW_TRACE_PROBE,
-                                           SW_TRACETYPE_EXIT,
-                                           (intptr_t)wasted_self)) == NULL ) {
-              /* Can't get second probe slot to record wasted time. We may
-                 have wasted time trying to get the slot, so account for the
-                 possible malloc() delay. We also need to fill in the
-                 allocated probe slot with a no-op, our best bet is a probe
-                 add with 1 extra lost entry. */
-              pbegin->timestamp = handled_at ;
-              pbegin->trace_type = SW_TRACETYPE_ADD ;
-              pbegin->trace_designator = entries_lost + 1 ;
-              entries_lost = 0 ;
-              wasted_time += (*timestamp_fn)() - handled_at ;
-            } else {
-              /* Got two probe slots. We want to account the delay in
-                 handling *this* probe to any section we were entering or
-                 exiting. We'll shuffle the entries if we're exiting a
-                 section, so the probe is entirely within the section. */
-              if ( trace_type == SW_TRACETYPE_EXIT ) {
-                tracelog_entry tmp = *entry ;
-                *entry = *pbegin ;
-                *pbegin = *pend ;
-                *pend = tmp ;
-              }
-              /* Backdate start of probe to count all wasted time. */
-              wasted_time = (*timestamp_fn)() - handled_at ;
-            }
-          }
-        } else {
-          ++entries_lost ;
+    if ( ring->entries_lost != 0 ) {
+      (void)probe_fill(ring, head++, now, SW_TRACE_PROBE, SW_TRACETYPE_ADD,
+                       ring->entries_lost) ;
+      ring->entries_lost = 0 ;
+    }
+
+    entry = probe_fill(ring, head++, now, trace_id, trace_type,
+                       trace_designator) ;
+
+    /* Check how long the process of logging this event took. So long as
+       the timer returns a reasonable multiple of the processor cycles, we
+       should see zero cycles most of the time. */
+    handled_at = (*timestamp_fn)() ;
+    wasted_self = handled_at - now ;
+    ring->wasted_time += wasted_self ;
+    if ( ring->wasted_time >= wasted_delta ) {
+      /* Retrospectively account for wasted time */
+      tracelog_entry *pbegin, *pend ;
+
+      pbegin = probe_fill(ring, head++, handled_at - ring->wasted_time,
+                          SW_TRACE_PROBE, SW_TRACETYPE_ENTER,
+                          (intptr_t)wasted_self) ;
+      pend = probe_fill(ring, head++, handled_at, SW_TRACE_PROBE,
+                        SW_TRACETYPE_EXIT, (intptr_t)wasted_self) ;
+
+      /* We want to account the delay in handling *this* probe to any
+         section we were entering or exiting. We'll shuffle the entries if
+         we're exiting a section, so the probe is entirely within the
+         section. */
+      if ( trace_type == SW_TRACETYPE_EXIT ) {
+        tracelog_entry tmp = *entry ;
+        *entry = *pbegin ;
+        *pbegin = *pend ;
+        *pend = tmp ;
+      }
+      /* Backdate start of probe to count all wasted time. */
+      ring->wasted_time = (*timestamp_fn)() - handled_at ;
+    }
+
+    /* Publish the new entries to the write-behind thread. */
+    RING_STORE(&ring->head, head) ;
+
+    /* Wake the write-behind thread when the ring passes half full. A
+       wakeup missed because we don't hold the lock is caught by the next
+       poll. */
+    if ( used < RING_WAKE_ENTRIES &&
+         used + (head - start) >= RING_WAKE_ENTRIES )
+      (void)pthread_cond_signal(&wb_ready) ;
+  }
+}
+
+/** Pass buffered log output to the log file or the write callback. */
+static void probe_write_flush(void)
+{
+  if ( log_buffered > 0 ) {
+    if ( pfnWriteProbeLog )
+      (void)pfnWriteProbeLog(log_buffer, log_buffered) ;
+    else if ( tracelog_file != NULL )
+      (void)fwrite(log_buffer, 1, log_buffered, tracelog_file) ;
+    log_buffered = 0 ;
+  }
+}
+
+/** Add bytes to the log output buffer. */
+static void probe_write(const void *data, size_t length)
+{
+  if ( log_buffered + length > sizeof(log_buffer) )
+    probe_write_flush() ;
+
+  HQASSERT(length <= sizeof(log_buffer), "Log output too long") ;
+  memcpy(&log_buffer[log_buffered], data, length) ;
+  log_buffered += length ;
+}
+
+/** Store a little-endian number of up to 8 bytes. */
+static void probe_store(unsigned char *bytes, uint64_t value, int length)
+{
+  int i ;
+
+  for ( i = 0 ; i < length ; ++i ) {
+    bytes[i] = (unsigned char)value ;
+    value >>= 8 ;
+  }
+}
+
+/** Write the header of a binary log, including the trace and trace type
+    names so the log can be read without the RIP. */
+static void probe_write_header(void)
+{
+  unsigned char header[PROBELOG_HEADER_BYTES] ;
+  unsigned char *bytes = header ;
+  int i ;
+
+  memcpy(bytes, PROBELOG_MAGIC, PROBELOG_MAGIC_BYTES) ;
+  bytes += PROBELOG_MAGIC_BYTES ;
+  probe_store(bytes, PROBELOG_VERSION, 4) ;
+  probe_store(bytes + 4, PROBELOG_RECORD_BYTES, 4) ;
+  probe_store(bytes + 8, (uint64_t)ticks_per_second, 8) ;
+  probe_store(bytes + 16, (uint64_t)g_nTraceNames, 4) ;
+  probe_store(bytes + 20, (uint64_t)g_nTraceTypeNames, 4) ;
+  probe_write(header, sizeof(header)) ;
+
+  for ( i = 0 ; i < g_nTraceNames + g_nTraceTypeNames ; ++i ) {
+    const char *name = i < g_nTraceNames ? g_ppTraceNames[i]
+                                         : g_ppTraceTypeNames[i - g_nTraceNames] ;
+    size_t length = name != NULL ? strlen(name) : 0 ;
+    unsigned char prefix[2] ;
+
+    if ( length > 0xffff )
+      length = 0xffff ;
+    probe_store(prefix, (uint64_t)length, 2) ;
+    probe_write(prefix, 2) ;
+    if ( length > 0 )
+      probe_write(name, length) ;
+  }
+}
+
+/** Write a single entry to the log. */
+static void probe_write_entry(const tracelog_ring *ring,
+                              const tracelog_entry *entry)
+{
+  if ( log_binary ) {
+    unsigned char record[PROBELOG_RECORD_BYTES] ;
+
+    probe_store(record, (uint64_t)entry->timestamp, 8) ;
+    probe_store(record + 8, (uint64_t)(int64_t)entry->trace_designator, 8) ;
+    probe_store(record + 16, (uint64_t)ring->thread_number, 4) ;
+    probe_store(record + 20, (uint64_t)entry->trace_id, 2) ;
+    probe_store(record + 22, (uint64_t)entry->trace_type, 2) ;
+    probe_write(record, sizeof(record)) ;
+  } else {
+    char szLine[256];
+    int length ;
+
+    length = sprintf(szLine,
+                     "Time=%f Thread=%3d Id=%s Type=%s Designator=%" PRIxPTR "\n",
+                     entry->timestamp / (double)ticks_per_second,
+                     (int)ring->thread_id, g_ppTraceNames[entry->trace_id],
+                     g_ppTraceTypeNames[entry->trace_type],
+                     entry->trace_designator) ;
+    probe_write(szLine, (size_t)length) ;
+  }
+}
+
+/** Start the log with the binary header, or with the timebase for a text
+    log, high 32 bits first. */
+static void probe_write_start(const tracelog_ring *ring, timestamp_t now)
+{
+  if ( (log_binary = g_bProbeBinary) ) {
+    probe_write_header() ;
+  } else {
+    tracelog_entry timebase ;
+
+    timebase.timestamp = now ;
+    timebase.trace_id = SW_TRACE_PROBE ;
+    timebase.trace_type = SW_TRACETYPE_MARK ;
+    timebase.trace_designator = (intptr_t)((ticks_per_second >> 16) >> 16) ;
+    probe_write_entry(ring, &timebase) ;
+    timebase.trace_designator = (intptr_t)(ticks_per_second & 0xffffffffu) ;
+    probe_write_entry(ring, &timebase) ;
+  }
+  log_started = TRUE ;
+}
+
+/** Write a probe made up by the write-behind thread on behalf of a ring's
+    thread. */
+static void probe_write_extra(const tracelog_ring *ring,
+                              timestamp_t now,
+                              int trace_id,
+                              int trace_type,
+                              intptr_t trace_designator)
+{
+  tracelog_entry entry ;
+
+  entry.timestamp = now ;
+  entry.trace_id = trace_id ;
+  entry.trace_type = trace_type ;
+  entry.trace_designator = trace_designator ;
+
+  if ( !log_started )
+    probe_write_start(ring, now) ;
+  probe_write_entry(ring, &entry) ;
+}
+
+/** Write out everything published in the rings, merging the entries of
+    all threads into timestamp order.
+
+    \param list     The rings to write.
+    \param lost     Number of probes lost by threads that could not get a
+                    ring.
+    \param final    If TRUE, report lost entries and wasted time remaining
+                    in every ring, because no more probes will be logged.
+    \return The number of entries written.
+ */
+static unsigned long probe_drain(tracelog_ring *list, intptr_t lost,
+                                 int final)
+{
+  tracelog_ring *ring ;
+  unsigned long written = 0 ;
+
+  /* Take a snapshot of the entries published so far. Entries published
+     after this will be merged on the next pass. */
+  for ( ring = list ; ring != NULL ; ring = ring->next )
+    ring->drain_end = RING_LOAD(&ring->head) ;
+
+  for (;;) {
+    tracelog_ring *first = NULL ;
+    tracelog_entry *entry = NULL ;
+
+    for ( ring = list ; ring != NULL ; ring = ring->next ) {
+      if ( ring->tail != ring->drain_end ) {
+        tracelog_entry *next = RING_ENTRY(ring, ring->tail) ;
+        if ( first == NULL || next->timestamp < entry->timestamp ) {
+          first = ring ;
+          entry = next ;
         }
       }
-      (void)pthread_mutex_unlock(&trace_lock) ;
-    } else {
-      /* Can't capture this entry, because we can't get the mutex. */
-      entries_lost++ ;
+    }
+
+    if ( first == NULL )
+      break ;
+
+    if ( !log_started )
+      probe_write_start(first, entry->timestamp) ;
+    probe_write_entry(first, entry) ;
+    ++written ;
+
+    /* Give the slot back to the owning thread. */
+    RING_STORE(&first->tail, first->tail + 1) ;
+  }
+
+  /* The owners of retired rings can no longer report their own lost
+     entries or wasted time, so do it for them. */
+  for ( ring = list ; ring != NULL ; ring = ring->next ) {
+    if ( final || RING_LOAD(&ring->retired) ) {
+      timestamp_t now = (*timestamp_fn)() ;
+
+      if ( ring->wasted_time > 0 ) {
+        probe_write_extra(ring, now - ring->wasted_time, SW_TRACE_PROBE,
+                          SW_TRACETYPE_ENTER, 0) ;
+        probe_write_extra(ring, now, SW_TRACE_PROBE, SW_TRACETYPE_EXIT, 0) ;
+        ring->wasted_time = 0 ;
+        written += 2 ;
+      }
+
+      if ( ring->entries_lost > 0 ) {
+        probe_write_extra(ring, now, SW_TRACE_PROBE, SW_TRACETYPE_ADD,
+                          ring->entries_lost) ;
+        ring->entries_lost = 0 ;
+        ++written ;
+      }
     }
   }
+
+  if ( lost > 0 && list != NULL ) {
+    probe_write_extra(list, (*timestamp_fn)(), SW_TRACE_PROBE,
+                      SW_TRACETYPE_ADD, lost) ;
+    ++written ;
+  }
+
+  probe_write_flush() ;
+
+  return written ;
 }
 
-/** The write-behind thread is a singleton. It waits to be woken, opens the
- * output trace file if necessary, writes the entries to the log file, and
- * then goes back to waiting.
+/** The write-behind thread is a singleton. It waits to be woken or for the
+ * poll interval to pass, opens the output trace file if necessary, writes
+ * the entries in the rings to the log file, and then goes back to waiting.
  */
 static void *probe_write_log(void *param)
 {
@@ -575,39 +796,38 @@ static void *probe_write_log(void *param)
   UNUSED_PARAM(void *, param) ;
 
   do {
-    tracelog_chunk *chunk = NULL, *willfree = NULL ;
+    tracelog_ring *list = NULL, **prev ;
+    unsigned long flush_target = 0 ;
+    intptr_t lost = 0 ;
     int timedout = FALSE ;
     struct timespec waketime ;
+    struct timeval now ;
+
+    /* MacOS X does not support clock_gettime(). Fill in the timespec
+       values from the time of day. */
+    (void)gettimeofday(&now, NULL) ;
+    waketime.tv_sec = now.tv_sec ;
+    waketime.tv_nsec = (now.tv_usec + WRITE_BEHIND_POLL_MS * 1000) * 1000 ;
+    if ( waketime.tv_nsec >= 1000000000 ) {
+      waketime.tv_sec += 1 ;
+      waketime.tv_nsec -= 1000000000 ;
+    }
 
-    /* MacOS X does not support clock_gettime(). Try filling in the timespec
-       values directly. */
-    waketime.tv_sec = time(NULL) + 10 ;
-    waketime.tv_nsec = 0 ;
-
-    /* Wait for either the savelist to be non-empty, or the quit flag to be
-       set. */
+    /* Wait for a ring to fill, a flush request, the quit flag to be set,
+       or the poll interval to pass. */
 #define return DO_NOT_RETURN - IN_CRITICAL_SECTION
     if ( pthread_mutex_lock(&trace_lock) == 0 ) {
-
-      if ( savelist == NULL && !trace_quit ) {
-        /* Wait for a full chunk to write; if nothing happens in 10 seconds,
-           see if we can poach an incomplete chunk. In the case of deadlock
-           in the RIP we may be able to use the log information to
-           reconstruct the timing sequence. */
-        if ( pthread_cond_timedwait(&wb_ready, &trace_lock, &waketime) == ETIMEDOUT ) {
+      if ( flush_requests == flushes_done && !trace_quit ) {
+        if ( pthread_cond_timedwait(&wb_ready, &trace_lock, &waketime) == ETIMEDOUT )
           timedout = TRUE ;
-          if ( current != NULL && current->nentries > 0 ) {
-            /* If we timed out, and there is anything in the current block,
-               move it to the savelist. */
-            *savelist_end = current ;
-            current = NULL ;
-          }
-        }
       }
 
-      chunk = savelist ;
-      savelist = NULL ;
-      savelist_end = &savelist ;
+      /* New rings are added at the head of the list, and only this thread
+         removes rings, so the list can be walked without the lock. */
+      list = rings ;
+      lost = entries_lost ;
+      entries_lost = 0 ;
+      flush_target = flush_requests ;
 
       looping = !trace_quit ;
 
@@ -615,67 +835,42 @@ static void *probe_write_log(void *param)
     }
 #undef return
 
-    if ( chunk != NULL ) {
-      /* Write out all pending chunks. */
-      if (!pfnWriteProbeLog && tracelog_file == NULL && result == WriteBehindOK) {
-        tracelog_file = fopen(g_szProbeLog, "w") ;
-        result = WriteBehindFailedOpen ;
+    if ( list != NULL ) {
+      if ( !pfnWriteProbeLog && tracelog_file == NULL &&
+           result == WriteBehindOK ) {
+        if ( (tracelog_file = fopen(g_szProbeLog, g_bProbeBinary ? "wb" : "w")) == NULL )
+          result = WriteBehindFailedOpen ;
       }
 
-      do {
-        unsigned long index ;
-        tracelog_chunk *next = chunk->next ;
-
-        /* We have a chunk. If the tracelog file is open, write details to the
-           file or if a callback has been supplied, call it.
-           Whatever happens, we should free the chunk when we're done. */
-        if (pfnWriteProbeLog) {
-          char szLine[256];
-
-          for ( index = 0 ; index < chunk->nentries ; ++index ) {
-            tracelog_entry *entry = &chunk->entries[index] ;
-            sprintf(szLine,
-                    "Time=%f Thread=%3d Id=%s Type=%s Designator=%" PRIxPTR "\n",
-                    entry->timestamp / (double)ticks_per_second,
-                    (int)entry->thread_id, g_ppTraceNames[entry->trace_id],
-                    g_ppTraceTypeNames[entry->trace_type],
-                    entry->trace_designator) ;
-            pfnWriteProbeLog(szLine, strlen(szLine));
-          }
-        }
-        else if ( tracelog_file != NULL) {
-          for ( index = 0 ; index < chunk->nentries ; ++index ) {
-            tracelog_entry *entry = &chunk->entries[index] ;
-            fprintf(tracelog_file,
-                    "Time=%f Thread=%3d Id=%s Type=%s Designator=%" PRIxPTR "\n",
-                    entry->timestamp / (double)ticks_per_second,
-                    (int)entry->thread_id, g_ppTraceNames[entry->trace_id],
-                    g_ppTraceTypeNames[entry->trace_type],
-                    entry->trace_designator) ;
-          }
-
-          /* If this wasn't a run of the mill chunk overflow, flush the trace
-             file, because it's likely we'll interrupt or crash this process. */
-          if ( tracelog_file && timedout )
-            fflush(tracelog_file) ;
-        }
-
-        chunk->next = willfree ;
-        willfree = chunk ;
-        chunk = next ;
-      } while ( chunk != NULL ) ;
+      /* If this wasn't a run of the mill poll, flush the trace file,
+         because it's likely we'll interrupt or crash this process. */
+      if ( probe_drain(list, lost, !looping) > 0 &&
+           !timedout && tracelog_file != NULL )
+        fflush(tracelog_file) ;
     }
 
 #define return DO_NOT_RETURN - IN_CRITICAL_SECTION
     if ( pthread_mutex_lock(&trace_lock) == 0 ) {
-      while ( willfree != NULL ) {
-        tracelog_chunk *next = willfree->next ;
-        willfree->next = freelist ;
-        freelist = willfree ;
-        willfree = next ;
+      /* Free the rings of threads that have exited, once they have been
+         written out. The retired flag must be read before the head, so no
+         entries can be published after the check. */
+      for ( prev = &rings ; *prev != NULL ; ) {
+        tracelog_ring *ring = *prev ;
+        if ( RING_LOAD(&ring->retired) &&
+             ring->tail == RING_LOAD(&ring->head) &&
+             ring->entries_lost == 0 && ring->wasted_time == 0 ) {
+          *prev = ring->next ;
+          free(ring) ;
+        } else {
+          prev = &ring->next ;
+        }
       }
+
       /* Signal flushed event in case flush call is waiting. */
-      (void)pthread_cond_signal(&wb_flushed) ;
+      flushes_done = flush_target ;
+      if ( !looping )
+        writer_done = TRUE ;
+      (void)pthread_cond_broadcast(&wb_flushed) ;
       (void)pthread_mutex_unlock(&trace_lock) ;
     }
 #undef return
@@ -694,30 +889,23 @@ static void *probe_write_log(void *param)
 
 void PKProbeLogFlush(void)
 {
+  if ( !probe_ready )
+    return ;
+
 #define return DO_NOT_RETURN - IN_CRITICAL_SECTION
   if ( pthread_mutex_lock(&trace_lock) == 0 ) {
-    /* Add the last block to the write-behind list. */
-    if ( current ) {
-      *savelist_end = current ;
-      savelist_end = &current->next ;
-      current = NULL ;
-    }
+    unsigned long request = ++flush_requests ;
 
     /* Signal write-behind thread to do its work. */
     (void)pthread_cond_signal(&wb_ready) ;
 
-    (void)pthread_mutex_unlock(&trace_lock) ;
-  }
-#undef return
+    /* Wait for flushed event */
+    while ( (long)(flushes_done - request) < 0 && !writer_done )
+      (void)pthread_cond_wait(&wb_flushed, &trace_lock) ;
 
-#define return DO_NOT_RETURN - IN_CRITICAL_SECTION
-  /* Wait for flushed event */
-  if ( pthread_mutex_lock(&trace_lock) == 0 ) {
-    (void)pthread_cond_wait(&wb_flushed, &trace_lock) ;
     (void)pthread_mutex_unlock(&trace_lock) ;
   }
 #undef return
-
 }
 /****************************************************************************/
 /* Probe handler for profiling control. This is used to handle the Quantify